@@ -17,6 +17,10 @@ struct BindData
 	uint luminanceTexture;
 	uint cameraBuffer;
 	uint cameraIndex;
+	uint cubeFace;  // First face of the dispatch.
+	// Boundary
+	float3 cameraPosition;  // Where the update started, overrides the camera's.
+	float padding;
 };
 
 ConstantBuffer<BindData> bindData : register(b0);
@@ -33,7 +37,8 @@ void Main(uint3 dispatchId : SV_DispatchThreadID)
 	
 	float2 uv = (dispatchId.xy + 0.5f) / width;
 	uv = uv * 2.f - 1.f;
-	float3 direction = normalize(ComputeDirection(uv, dispatchId.z));
+	uint face = bindData.cubeFace + dispatchId.z;
+	float3 direction = normalize(ComputeDirection(uv, face));
 	
 	Texture2D<float4> transmittanceLut = ResourceDescriptorHeap[bindData.transmissionTexture];
 	Texture3D<float4> scatteringLut = ResourceDescriptorHeap[bindData.scatteringTexture];
@@ -41,7 +46,8 @@ void Main(uint3 dispatchId : SV_DispatchThreadID)
 
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
 	Camera camera = cameraBuffer[bindData.cameraIndex];
+	camera.position.xyz = bindData.cameraPosition;
 	
 	float3 sample = SampleAtmosphere(bindData.atmosphere, camera, direction, sunDirection, false, transmittanceLut, scatteringLut, irradianceLut, bilinearClamp);
-	luminanceMap[dispatchId] = float4(sample, 0.f);
+	luminanceMap[uint3(dispatchId.xy, face)] = float4(sample, 0.f);
 }
\ No newline at end of file
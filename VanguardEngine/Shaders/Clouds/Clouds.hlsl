@@ -4,7 +4,6 @@
 #include "Camera.hlsli"
 #include "Geometry.hlsli"
 #include "Constants.hlsli"
-#include "Reprojection.hlsli"
 #include "Volumetrics/LightIntegration.hlsli"
 #include "Volumetrics/PhaseFunctions.hlsli"
 #include "Atmosphere/Atmosphere.hlsli"
@@ -17,15 +16,15 @@ struct BindData
 	uint cameraBuffer;
 	uint cameraIndex;
 	float solarZenithAngle;
-	uint timeSlice;
-	uint lastFrameTexture;
-	float2 outputResolution;
+	uint2 updateOffset;
+	float2 outputResolution;  // Cloud history.
 	uint depthTexture;
 	uint geometryDepthTexture;
 	uint blueNoiseTexture;
     uint atmosphereIrradianceBuffer;
 	float2 wind;
 	float time;
+	uint updateBlock;
 };
 
 ConstantBuffer<BindData> bindData : register(b0);
@@ -59,7 +58,10 @@ float RemapRange(float value, float inMin, float inMax, float outMin, float outM
 float3 SampleWeather(Texture2D<float3> weatherTexture, float3 position)
 {
 	const float frequency = 0.015;
-    return weatherTexture.Sample(bilinearWrap, position.xy * frequency + (0.5.xx));
+	// Scroll the weather with the wind, see Weather.hlsl.
+	const float timeDilation = 0.003;
+	const float2 scroll = bindData.wind * bindData.time * timeDilation;
+    return weatherTexture.Sample(bilinearWrap, position.xy * frequency + (0.5.xx) + scroll);
 }
 
 float SampleBaseShape(Texture3D<float> noiseTexture, float3 position, uint mip)
@@ -496,67 +498,38 @@ float4 PSMain(PixelIn input) : SV_Target
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
 	Camera camera = cameraBuffer[bindData.cameraIndex];
 
-	static const uint crossFilter[] = {
-		0, 8, 2, 10,
-		12, 4, 14, 6,
-		3, 11, 1, 9,
-		15, 7, 13, 5
-	};
-
-	int2 pixel = input.uv * bindData.outputResolution;
-	int index = (pixel.x + 4 * pixel.y) % 16;
 #ifdef CLOUDS_FULL_RESOLUTION
-	if (true)
+	float2 uv = input.uv;
 #else
-	if (index == crossFilter[bindData.timeSlice])
+	// One pixel of each block of the history is traced per frame, the render target only holds those pixels. See
+	// Reconstruction.hlsl for how the rest of the history is filled in.
+	float2 uv = (floor(input.positionCS.xy) * bindData.updateBlock + bindData.updateOffset + 0.5) / bindData.outputResolution;
 #endif
-	{
-		float3 sunDirection = float3(sin(bindData.solarZenithAngle), 0.f, cos(bindData.solarZenithAngle));
+
+	float3 sunDirection = float3(sin(bindData.solarZenithAngle), 0.f, cos(bindData.solarZenithAngle));
 #ifdef CLOUDS_RENDER_ORTHOGRAPHIC
-		// This is equivalent to -sunDirection.
-		float3 rayDirection = ComputeRayDirection(camera, 0.5.xx);
+	// This is equivalent to -sunDirection.
+	float3 rayDirection = ComputeRayDirection(camera, 0.5.xx);
 #else
-		float3 rayDirection = ComputeRayDirection(camera, input.uv);
+	float3 rayDirection = ComputeRayDirection(camera, uv);
 #endif
 
-		ComputeNoiseKernel(sunDirection);
+	ComputeNoiseKernel(sunDirection);
 
-		float3 scatteredLuminance;
-		float transmittance;
-		float depth;  // Kilometers.
-		RayMarch(camera, input.uv, rayDirection, sunDirection, scatteredLuminance, transmittance, depth);
+	float3 scatteredLuminance;
+	float transmittance;
+	float depth;  // Kilometers.
+	RayMarch(camera, uv, rayDirection, sunDirection, scatteredLuminance, transmittance, depth);
 
 #ifdef CLOUDS_ONLY_DEPTH
-		return depth;
+	return depth;
 #else
-		RWTexture2D<float> depthTexture = ResourceDescriptorHeap[bindData.depthTexture];
-		depthTexture[input.uv * bindData.outputResolution] = depth;
-
-		float4 output;
-		output.rgb = scatteredLuminance;
-		output.a = transmittance;
-		return output;
-#endif
-	}
-
-#ifndef CLOUDS_FULL_RESOLUTION
-	else
-	{
-		// Not rendering this pixel this frame, so reproject instead.
-		Texture2D<float4> lastFrameTexture = ResourceDescriptorHeap[bindData.lastFrameTexture];
-		RWTexture2D<float> depthTexture = ResourceDescriptorHeap[bindData.depthTexture];
-
-		float depth = depthTexture[input.uv * bindData.outputResolution];
-		depth *= 1000.0;  // Convert to meters.
-		float2 reprojectedUv = ReprojectUv(camera, input.uv, depth);
-
-		float4 lastFrame = 0.xxxx;
-		if (bindData.lastFrameTexture != 0)
-		{
-			lastFrame = lastFrameTexture.Sample(downsampleBorder, reprojectedUv);
-		}
+	RWTexture2D<float> depthTexture = ResourceDescriptorHeap[bindData.depthTexture];
+	depthTexture[input.positionCS.xy] = depth;
 
-		return lastFrame;
-	}
+	float4 output;
+	output.rgb = scatteredLuminance;
+	output.a = transmittance;
+	return output;
 #endif
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include "RootSignature.hlsli"
+#include "Camera.hlsli"
+#include "Reprojection.hlsli"
+
+// Builds the cloud history from the pixels traced this frame, and scales it up to the render resolution. Mirrored on the
+// CPU by CloudReconstruction.cpp.
+
+struct BindData
+{
+	uint cameraBuffer;
+	uint cameraIndex;
+	uint traceTexture;
+	uint traceDepthTexture;
+	uint historyTexture;
+	uint historyDepthTexture;
+	uint outputTexture;
+	uint outputDepthTexture;
+	uint2 updateOffset;
+	uint updateBlock;
+	uint historyValid;
+	uint geometryDepthTexture;
+	uint resolutionScale;
+};
+
+ConstantBuffer<BindData> bindData : register(b0);
+
+// Must match CloudReconstruction.h.
+static const float historyTolerance = 0.05;
+static const float motionThreshold = 0.25;
+static const float depthEpsilon = 0.01;
+
+[RootSignature(RS)]
+[numthreads(8, 8, 1)]
+void ReconstructMain(uint3 dispatchId : SV_DispatchThreadID)
+{
+	RWTexture2D<float4> outputTexture = ResourceDescriptorHeap[bindData.outputTexture];
+	RWTexture2D<float> outputDepthTexture = ResourceDescriptorHeap[bindData.outputDepthTexture];
+	Texture2D<float4> traceTexture = ResourceDescriptorHeap[bindData.traceTexture];
+	Texture2D<float> traceDepthTexture = ResourceDescriptorHeap[bindData.traceDepthTexture];
+
+	uint width, height;
+	outputTexture.GetDimensions(width, height);
+
+	uint2 pixel = dispatchId.xy;
+	if (any(pixel >= uint2(width, height)))
+	{
+		return;
+	}
+
+	if (all(pixel % bindData.updateBlock == bindData.updateOffset))
+	{
+		uint2 tracePixel = pixel / bindData.updateBlock;
+		outputTexture[pixel] = traceTexture[tracePixel];
+		outputDepthTexture[pixel] = traceDepthTexture[tracePixel];
+		return;
+	}
+
+	uint traceWidth, traceHeight;
+	traceTexture.GetDimensions(traceWidth, traceHeight);
+
+	// Traced pixels around this one, in trace texels.
+	float2 tracePosition = (float2(pixel) - float2(bindData.updateOffset)) / bindData.updateBlock;
+	float2 base = floor(tracePosition);
+	float2 fraction = tracePosition - base;
+
+	float4 taps[4];
+	float tapDepths[4];
+	for (uint i = 0; i < 4; ++i)
+	{
+		int2 texel = clamp(int2(base) + int2(i & 1, i >> 1), 0, int2(traceWidth, traceHeight) - 1);
+		taps[i] = traceTexture[texel];
+		tapDepths[i] = traceDepthTexture[texel];
+	}
+
+	float4 color = lerp(lerp(taps[0], taps[1], fraction.x), lerp(taps[2], taps[3], fraction.x), fraction.y);
+	// Depth isn't interpolated, pixels without clouds are far away.
+	float depth = tapDepths[(fraction.x > 0.5 ? 1 : 0) + (fraction.y > 0.5 ? 2 : 0)];
+
+	if (bindData.historyValid)
+	{
+		StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
+		Camera camera = cameraBuffer[bindData.cameraIndex];
+		Texture2D<float4> historyTexture = ResourceDescriptorHeap[bindData.historyTexture];
+		Texture2D<float> historyDepthTexture = ResourceDescriptorHeap[bindData.historyDepthTexture];
+
+		float2 resolution = float2(width, height);
+		float2 uv = (pixel + 0.5) / resolution;
+		float2 previousUv = ReprojectUv(camera, uv, historyDepthTexture[pixel] * 1000.0);  // Kilometers to meters.
+
+		if (all(previousUv >= 0.0) && all(previousUv <= 1.0))
+		{
+			// Bilinear, nearest samples would drift with every reprojection.
+			float4 previous = historyTexture.SampleLevel(bilinearClamp, previousUv, 0);
+			float previousDepth = historyDepthTexture[min(uint2(previousUv * resolution), uint2(width, height) - 1)];
+
+			// Moving history is only kept if it's plausible given the traced pixels around it, otherwise it would smear
+			// disoccluded clouds. Still history keeps details finer than the traced pixels.
+			float2 motion = abs(previousUv - uv) * resolution;
+			bool accepted = true;
+
+			if (max(motion.x, motion.y) > motionThreshold)
+			{
+				float4 minimum = min(min(taps[0], taps[1]), min(taps[2], taps[3]));
+				float4 maximum = max(max(taps[0], taps[1]), max(taps[2], taps[3]));
+				accepted = all(previous >= minimum - historyTolerance) && all(previous <= maximum + historyTolerance);
+			}
+
+			if (accepted)
+			{
+				color = previous;
+				depth = previousDepth;
+			}
+		}
+	}
+
+	outputTexture[pixel] = color;
+	outputDepthTexture[pixel] = depth;
+}
+
+[RootSignature(RS)]
+[numthreads(8, 8, 1)]
+void UpsampleMain(uint3 dispatchId : SV_DispatchThreadID)
+{
+	RWTexture2D<float4> outputTexture = ResourceDescriptorHeap[bindData.outputTexture];
+	RWTexture2D<float> outputDepthTexture = ResourceDescriptorHeap[bindData.outputDepthTexture];
+
+	uint width, height;
+	outputTexture.GetDimensions(width, height);
+
+	uint2 pixel = dispatchId.xy;
+	if (any(pixel >= uint2(width, height)))
+	{
+		return;
+	}
+
+	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
+	Camera camera = cameraBuffer[bindData.cameraIndex];
+	Texture2D<float4> historyTexture = ResourceDescriptorHeap[bindData.historyTexture];
+	Texture2D<float> historyDepthTexture = ResourceDescriptorHeap[bindData.historyDepthTexture];
+	Texture2D<float> geometryDepthTexture = ResourceDescriptorHeap[bindData.geometryDepthTexture];
+
+	uint historyWidth, historyHeight;
+	historyTexture.GetDimensions(historyWidth, historyHeight);
+
+	float depth = LinearizeDepth(camera, geometryDepthTexture[pixel]);
+
+	float2 historyPosition = (pixel + 0.5) / bindData.resolutionScale - 0.5;
+	float2 base = floor(historyPosition);
+	float2 fraction = historyPosition - base;
+
+	float4 color = 0.xxxx;
+	float totalWeight = 0.0;
+	float bestWeight = -1.0;
+	float cloudDepth = 0.0;
+
+	// Bilinear weights, reduced for history pixels whose geometry depth differs so that clouds don't bleed across edges.
+	for (uint i = 0; i < 4; ++i)
+	{
+		uint2 tap = clamp(int2(base) + int2(i & 1, i >> 1), 0, int2(historyWidth, historyHeight) - 1);
+
+		// Geometry depth at the center of the render pixels the history pixel covers.
+		uint2 center = min(tap * bindData.resolutionScale + bindData.resolutionScale / 2, uint2(width, height) - 1);
+		float tapDepth = LinearizeDepth(camera, geometryDepthTexture[center]);
+
+		float bilinear = ((i & 1) ? fraction.x : 1.0 - fraction.x) * ((i >> 1) ? fraction.y : 1.0 - fraction.y);
+		float weight = bilinear / (depthEpsilon + abs(depth - tapDepth) / max(depth, 1e-6));
+
+		color += historyTexture[tap] * weight;
+		totalWeight += weight;
+
+		if (weight > bestWeight)
+		{
+			bestWeight = weight;
+			cloudDepth = historyDepthTexture[tap];
+		}
+	}
+
+	outputTexture[pixel] = color / totalWeight;
+	outputDepthTexture[pixel] = cloudDepth;
+}
\ No newline at end of file
@@ -8,8 +8,6 @@ struct BindData
 	uint weatherTexture;
 	float globalCoverage;
 	float precipitation;
-	float time;
-	float2 wind;
 };
 
 ConstantBuffer<BindData> bindData : register(b0);
@@ -30,11 +28,9 @@ void Main(uint3 dispatchId : SV_DispatchThreadID)
 	weatherTexture.GetDimensions(width, height);
 	float weatherSize = float(width);
 
+	// Weather tiles, wind scrolls it while sampling so that it only needs to be generated when its parameters change.
 	float2 coord = float2(dispatchId.xy) * (1.0 / weatherSize);
 
-	const float timeDilation = 0.003;
-	coord += bindData.wind * bindData.time * timeDilation;
-
 	float coverage = PerlinNoise2D(coord, 8, 4);
 	coverage = saturate(RemapRange(coverage, 1.0 - bindData.globalCoverage, 1, 0, 1));
     
@@ -10,6 +10,7 @@ struct BindData
 {
 	uint batchId;
 	uint objectBuffer;
+	uint visibleInstanceBuffer;
 	uint cameraBuffer;
 	uint cameraIndex;
 	uint vertexPositionBuffer;
@@ -37,7 +38,8 @@ struct PSInput
 PSInput VSMain(VertexIn input)
 {
 	StructuredBuffer<ObjectData> objectBuffer = ResourceDescriptorHeap[bindData.objectBuffer];
-	ObjectData object = objectBuffer[bindData.batchId + input.instanceId];
+	uint objectId = LoadObjectId(bindData.visibleInstanceBuffer, bindData.batchId, input.instanceId);
+	ObjectData object = objectBuffer[objectId];
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
 	Camera camera = cameraBuffer[bindData.cameraIndex];
 
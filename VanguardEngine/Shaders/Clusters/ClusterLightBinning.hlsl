@@ -15,16 +15,29 @@ struct BindData
 	uint lightCounterBuffer;
 	uint lightListBuffer;
 	uint lightInfoBuffer;
+	uint lightListSize;
+	uint lightOrderBuffer;
+	uint lightNodesBuffer;
+	uint lightNodeCount;
 };
 
 ConstantBuffer<BindData> bindData : register(b0);
 
 static const uint threadGroupSize = 64;
+static const uint lightsPerNode = 32;  // Must match LightHierarchy::lightsPerNode.
+
+// How each entry point handles the lights of its froxel.
+static const uint binModeFixed = 0;  // Capped local list, copied into the global list afterwards.
+static const uint binModeCount = 1;  // Counting only.
+static const uint binModeFill = 2;  // Writes into the range found by the count and prefix sum passes.
 
 groupshared AABB froxelBounds;
 groupshared uint localLightCount;
 groupshared uint localLightList[MAX_LIGHTS_PER_FROXEL];
 groupshared uint globalLightListOffset;
+groupshared uint globalLightListCount;
+groupshared uint acceptedNodeCount;
+groupshared uint acceptedNodes[threadGroupSize];
 
 bool LightInFroxel(Camera camera, Light light, AABB aabb)
 {
@@ -43,6 +56,89 @@ bool LightInFroxel(Camera camera, Light light, AABB aabb)
 	return false;
 }
 
+void BinLight(uint mode, uint lightIndex)
+{
+	uint index;
+	InterlockedAdd(localLightCount, 1, index);
+
+	if (mode == binModeFixed && index < MAX_LIGHTS_PER_FROXEL)
+	{
+		localLightList[index] = lightIndex;
+	}
+
+	else if (mode == binModeFill && index < globalLightListCount)
+	{
+		RWStructuredBuffer<uint> lightList = ResourceDescriptorHeap[bindData.lightListBuffer];
+		lightList[globalLightListOffset + index] = lightIndex;
+	}
+}
+
+// Passes every light of the froxel to BinLight once, split between all threads in the group. Must be called by the whole group.
+void BinFroxelLights(uint mode, uint groupIndex, Camera camera)
+{
+	StructuredBuffer<Light> lights = ResourceDescriptorHeap[bindData.lightsBuffer];
+
+	if (bindData.lightNodeCount == 0)
+	{
+		// Interleaved iteration between all threads in the group. Divides the work evenly.
+		for (uint i = groupIndex; i < bindData.lightCount; i += threadGroupSize)
+		{
+			if (LightInFroxel(camera, lights[i], froxelBounds))
+			{
+				BinLight(mode, i);
+			}
+		}
+
+		return;
+	}
+
+	StructuredBuffer<uint> lightOrder = ResourceDescriptorHeap[bindData.lightOrderBuffer];
+	StructuredBuffer<LightNode> lightNodes = ResourceDescriptorHeap[bindData.lightNodesBuffer];
+
+	// Each thread tests one node of a batch, then the whole group tests the lights of the nodes that reach the froxel.
+	for (uint nodeBase = 0; nodeBase < bindData.lightNodeCount; nodeBase += threadGroupSize)
+	{
+		if (groupIndex == 0)
+		{
+			acceptedNodeCount = 0;
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+
+		uint node = nodeBase + groupIndex;
+		if (node < bindData.lightNodeCount)
+		{
+			// #TODO: Precompute view space node centers along with the light positions.
+			float4 viewSpace = mul(float4(lightNodes[node].center, 1.f), camera.view);
+			if (SphereAABBIntersection(viewSpace.xyz, lightNodes[node].radius, froxelBounds))
+			{
+				uint slot;
+				InterlockedAdd(acceptedNodeCount, 1, slot);
+				acceptedNodes[slot] = node;
+			}
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+
+		for (uint i = groupIndex; i < acceptedNodeCount * lightsPerNode; i += threadGroupSize)
+		{
+			LightNode lightNode = lightNodes[acceptedNodes[i / lightsPerNode]];
+			uint offset = i % lightsPerNode;
+			if (offset < lightNode.lightCount)
+			{
+				uint lightIndex = lightOrder[lightNode.firstLight + offset];
+				if (LightInFroxel(camera, lights[lightIndex], froxelBounds))
+				{
+					BinLight(mode, lightIndex);
+				}
+			}
+		}
+
+		// The accepted nodes are overwritten by the next batch.
+		GroupMemoryBarrierWithGroupSync();
+	}
+}
+
 // Bins all lights into froxels. One thread group per froxel.
 [RootSignature(RS)]
 [numthreads(threadGroupSize, 1, 1)]
@@ -52,7 +148,6 @@ void Main(uint3 dispatchId : SV_DispatchThreadID, uint3 groupId : SV_GroupID, ui
 	Camera camera = cameraBuffer[bindData.cameraIndex];
 	StructuredBuffer<uint> denseClusterList = ResourceDescriptorHeap[bindData.denseClusterListBuffer];
 	StructuredBuffer<AABB> clusterBounds = ResourceDescriptorHeap[bindData.clusterBoundsBuffer];
-	StructuredBuffer<Light> lights = ResourceDescriptorHeap[bindData.lightsBuffer];
 	RWStructuredBuffer<uint> lightCounter = ResourceDescriptorHeap[bindData.lightCounterBuffer];
 	RWStructuredBuffer<uint> lightList = ResourceDescriptorHeap[bindData.lightListBuffer];
 	RWStructuredBuffer<uint2> clusterLightInfo = ResourceDescriptorHeap[bindData.lightInfoBuffer];
@@ -68,19 +163,7 @@ void Main(uint3 dispatchId : SV_DispatchThreadID, uint3 groupId : SV_GroupID, ui
 	
 	GroupMemoryBarrierWithGroupSync();
 	
-	// Interleaved iteration between all threads in the group. Divides the work evenly.
-	for (uint i = groupIndex; i < bindData.lightCount; i += threadGroupSize)
-	{
-		if (LightInFroxel(camera, lights[i], froxelBounds))
-		{
-			uint index;
-			InterlockedAdd(localLightCount, 1, index);
-			if (index < MAX_LIGHTS_PER_FROXEL)
-			{
-				localLightList[index] = i;
-			}
-		}
-	}
+	BinFroxelLights(binModeFixed, groupIndex, camera);
 	
 	GroupMemoryBarrierWithGroupSync();
 	
@@ -99,4 +182,63 @@ void Main(uint3 dispatchId : SV_DispatchThreadID, uint3 groupId : SV_GroupID, ui
 	{
 		lightList[globalLightListOffset + i] = localLightList[i];
 	}
+}
+
+// Compact light lists are built in three passes instead, counting the lights of each froxel, packing the counts with a prefix
+// sum in ClusterLightOffsets.hlsl, then filling each froxel's range. Froxels have no light cap, and the list only needs room
+// for the lights that were binned.
+
+[RootSignature(RS)]
+[numthreads(threadGroupSize, 1, 1)]
+void CountMain(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
+	Camera camera = cameraBuffer[bindData.cameraIndex];
+	StructuredBuffer<uint> denseClusterList = ResourceDescriptorHeap[bindData.denseClusterListBuffer];
+	StructuredBuffer<AABB> clusterBounds = ResourceDescriptorHeap[bindData.clusterBoundsBuffer];
+	RWStructuredBuffer<uint2> clusterLightInfo = ResourceDescriptorHeap[bindData.lightInfoBuffer];
+
+	if (groupIndex == 0)
+	{
+		localLightCount = 0;
+		froxelBounds = clusterBounds[denseClusterList[groupId.x]];
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	BinFroxelLights(binModeCount, groupIndex, camera);
+
+	GroupMemoryBarrierWithGroupSync();
+
+	// The offset is filled in by the prefix sum.
+	if (groupIndex == 0)
+	{
+		clusterLightInfo[denseClusterList[groupId.x]] = uint2(0, localLightCount);
+	}
+}
+
+[RootSignature(RS)]
+[numthreads(threadGroupSize, 1, 1)]
+void FillMain(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
+	Camera camera = cameraBuffer[bindData.cameraIndex];
+	StructuredBuffer<uint> denseClusterList = ResourceDescriptorHeap[bindData.denseClusterListBuffer];
+	StructuredBuffer<AABB> clusterBounds = ResourceDescriptorHeap[bindData.clusterBoundsBuffer];
+	StructuredBuffer<uint2> clusterLightInfo = ResourceDescriptorHeap[bindData.lightInfoBuffer];
+
+	if (groupIndex == 0)
+	{
+		localLightCount = 0;
+		froxelBounds = clusterBounds[denseClusterList[groupId.x]];
+
+		uint2 lightInfo = clusterLightInfo[denseClusterList[groupId.x]];
+		globalLightListOffset = lightInfo.x;
+		globalLightListCount = lightInfo.y;
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	// Same test as the count pass, so exactly the counted lights are written. The count is only lower if the list ran out of room.
+	BinFroxelLights(binModeFill, groupIndex, camera);
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include "RootSignature.hlsli"
+
+struct BindData
+{
+	uint denseClusterListBuffer;
+	uint indirectBuffer;
+	uint lightInfoBuffer;
+	uint lightCounterBuffer;
+	uint lightListSize;
+};
+
+ConstantBuffer<BindData> bindData : register(b0);
+
+static const uint threadGroupSize = 1024;
+
+groupshared uint scanValues[threadGroupSize];
+groupshared uint chunkOffset;
+
+// Exclusive prefix sum of the light counts of every active froxel, giving each its range of the compact light list. A single
+// group walks the dense cluster list in chunks, carrying the running total between them.
+[RootSignature(RS)]
+[numthreads(threadGroupSize, 1, 1)]
+void Main(uint groupIndex : SV_GroupIndex)
+{
+	StructuredBuffer<uint> denseClusterList = ResourceDescriptorHeap[bindData.denseClusterListBuffer];
+	StructuredBuffer<uint3> indirectBuffer = ResourceDescriptorHeap[bindData.indirectBuffer];
+	RWStructuredBuffer<uint2> clusterLightInfo = ResourceDescriptorHeap[bindData.lightInfoBuffer];
+	RWStructuredBuffer<uint> lightCounter = ResourceDescriptorHeap[bindData.lightCounterBuffer];
+
+	uint activeClusters = indirectBuffer[0].x;  // One binning group was dispatched per active cluster.
+
+	if (groupIndex == 0)
+	{
+		chunkOffset = 0;
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint chunk = 0; chunk < activeClusters; chunk += threadGroupSize)
+	{
+		uint index = chunk + groupIndex;
+		uint cluster = 0;
+		uint count = 0;
+		if (index < activeClusters)
+		{
+			cluster = denseClusterList[index];
+			count = clusterLightInfo[cluster].y;
+		}
+
+		scanValues[groupIndex] = count;
+
+		GroupMemoryBarrierWithGroupSync();
+
+		// Inclusive scan within the chunk.
+		for (uint stride = 1; stride < threadGroupSize; stride <<= 1)
+		{
+			uint value = groupIndex >= stride ? scanValues[groupIndex - stride] : 0;
+
+			GroupMemoryBarrierWithGroupSync();
+
+			scanValues[groupIndex] += value;
+
+			GroupMemoryBarrierWithGroupSync();
+		}
+
+		if (index < activeClusters)
+		{
+			// The list is sized from a conservative estimate, clamp anyway so that a bad estimate drops lights instead of writing out of bounds.
+			uint offset = min(chunkOffset + scanValues[groupIndex] - count, bindData.lightListSize);
+			clusterLightInfo[cluster] = uint2(offset, min(count, bindData.lightListSize - offset));
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+
+		if (groupIndex == 0)
+		{
+			chunkOffset += scanValues[threadGroupSize - 1];
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (groupIndex == 0)
+	{
+		lightCounter[0] = min(chunkOffset, bindData.lightListSize);
+	}
+}
\ No newline at end of file
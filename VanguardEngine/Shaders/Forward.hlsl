@@ -33,6 +33,7 @@ struct BindData
 {
 	uint batchId;
 	uint objectBuffer;
+	uint visibleInstanceBuffer;
 	uint cameraBuffer;
 	uint cameraIndex;
     uint vertexPositionBuffer;
@@ -42,7 +43,7 @@ struct BindData
 	uint atmosphereIrradianceBuffer;
     uint cloudsShadowMap;
     float globalWeatherCoverage;
-    float padding;
+    uint sunCameraIndex;
 	ClusterData clusterData;
 	IblData iblData;
 };
@@ -65,14 +66,15 @@ struct PixelIn
 	float3 bitangent : BITANGENT;  // World space.
 	float depthVS : DEPTH;  // View space.
 	float4 color : COLOR;
-	uint instanceId : SV_InstanceID;
+	nointerpolation uint objectId : OBJECT;
 };
 
 [RootSignature(RS)]
 PixelIn VSMain(VertexIn input)
 {
 	StructuredBuffer<ObjectData> objectBuffer = ResourceDescriptorHeap[bindData.objectBuffer];
-	ObjectData object = objectBuffer[bindData.batchId + input.instanceId];
+	uint objectId = LoadObjectId(bindData.visibleInstanceBuffer, bindData.batchId, input.instanceId);
+	ObjectData object = objectBuffer[objectId];
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
 	Camera camera = cameraBuffer[bindData.cameraIndex];
 	
@@ -97,10 +99,10 @@ PixelIn VSMain(VertexIn input)
 	output.position = mul(position, object.worldMatrix).xyz;
 	output.normal = normalize(mul(normal, object.worldMatrix)).xyz;
 	output.uv = uv;
-	output.tangent = normalize(mul(tangent, object.worldMatrix)).xyz;
-	output.bitangent = normalize(mul(bitangent, object.worldMatrix)).xyz;
+	output.tangent = normalize(mul(float4(tangent.xyz, 0.f), object.worldMatrix)).xyz;  // Directions, w is the handedness.
+	output.bitangent = normalize(mul(float4(bitangent.xyz, 0.f), object.worldMatrix)).xyz;
 	output.color = color;
-	output.instanceId = input.instanceId;
+	output.objectId = objectId;
 	
 	return output;
 }
@@ -109,10 +111,10 @@ PixelIn VSMain(VertexIn input)
 float4 PSMain(PixelIn input) : SV_Target
 {
 	StructuredBuffer<ObjectData> objectBuffer = ResourceDescriptorHeap[bindData.objectBuffer];
-	ObjectData object = objectBuffer[bindData.batchId + input.instanceId];
+	ObjectData object = objectBuffer[input.objectId];
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
 	Camera camera = cameraBuffer[bindData.cameraIndex];
-    Camera sunCamera = cameraBuffer[2];  // #TODO: Remove this terrible hardcoding.
+    Camera sunCamera = cameraBuffer[bindData.sunCameraIndex];
 	StructuredBuffer<MaterialData> materialBuffer = ResourceDescriptorHeap[bindData.materialBuffer];
 	MaterialData material = materialBuffer[object.materialIndex];
 	
@@ -143,8 +145,9 @@ float4 PSMain(PixelIn input) : SV_Target
 		float3x3 TBN = float3x3(input.tangent, input.bitangent, input.normal);
 
 		Texture2D<float4> normalMap = ResourceDescriptorHeap[material.normal];
-		normal = normalMap.Sample(anisotropicWrap, input.uv).rgb;
-		normal = normal * 2.0 - 1.0;  // Remap from [0, 1] to [-1, 1].
+		normal.xy = normalMap.Sample(anisotropicWrap, input.uv).rg;
+		normal.xy = normal.xy * 2.0 - 1.0;  // Remap from [0, 1] to [-1, 1].
+		normal.z = sqrt(saturate(1.0 - dot(normal.xy, normal.xy)));  // Reconstruct Z, block compressed normal maps only store XY.
 		normal = normalize(mul(normal, TBN));  // Convert the normal vector from tangent space to world space.
 	}
 
@@ -11,9 +11,10 @@ struct BindData
 	uint luminanceTexture;
 	uint irradianceTexture;
 	uint brdfTexture;
-	uint cubeFace;
+	uint cubeFace;  // First face of the dispatch.
 	// Boundary
-	uint prefilterMips[PREFILTER_LEVELS];
+	uint prefilterTexture;  // Mip of the level being filtered.
+	uint prefilterLevel;
 };
 
 ConstantBuffer<BindData> bindData : register(b0);
@@ -33,7 +34,8 @@ void IrradianceMain(uint3 dispatchId : SV_DispatchThreadID)
 	float2 uv = (dispatchId.xy + 0.5f) / width;
 	uv = uv * 2.f - 1.f;
 	
-	float3 forward = normalize(ComputeDirection(uv, dispatchId.z));
+	uint face = bindData.cubeFace + dispatchId.z;
+	float3 forward = normalize(ComputeDirection(uv, face));
 	float3 up = float3(0.f, 0.f, 1.f);
 	float3 left = normalize(cross(up, forward));
 	up = normalize(cross(forward, left));
@@ -57,7 +59,7 @@ void IrradianceMain(uint3 dispatchId : SV_DispatchThreadID)
 	}
 	
 	const float samples = steps * steps;
-	irradianceMap[dispatchId] = float4(pi * irradianceSum / samples, 0.f);
+	irradianceMap[uint3(dispatchId.xy, face)] = float4(pi * irradianceSum / samples, 0.f);
 }
 
 [RootSignature(RS)]
@@ -66,68 +68,61 @@ void PrefilterMain(uint3 dispatchId : SV_DispatchThreadID)
 {
 	// Uses split sum approximation by Epic Games, see: https://blog.selfshadow.com/publications/s2013-shading-course/karis/s2013_pbs_epic_notes_v2.pdf
 	
-	RWTexture2DArray<float4> baseMip = ResourceDescriptorHeap[bindData.prefilterMips[0]];
+	// One level per dispatch, so that the threads of the small levels aren't idle.
+	RWTexture2DArray<float4> prefilterMap = ResourceDescriptorHeap[bindData.prefilterTexture];
 	float width, height, depth;
-	baseMip.GetDimensions(width, height, depth);
-	const float baseMipSize = width;
-	const float saTexel = (4.f * pi) / (6.f * baseMipSize * baseMipSize);
+	prefilterMap.GetDimensions(width, height, depth);
+	
+	if (dispatchId.x >= width || dispatchId.y >= height)
+	{
+		return;
+	}
 	
-	const uint maskShift = log2(width);
-	const uint xyIndex = dispatchId.y * width + dispatchId.x;
+	const float baseMipSize = width * (1u << bindData.prefilterLevel);
+	const float saTexel = (4.f * pi) / (6.f * baseMipSize * baseMipSize);
 	
 	TextureCube<float4> luminanceMap = ResourceDescriptorHeap[bindData.luminanceTexture];
 	
-	for (int i = 0; i < PREFILTER_LEVELS; ++i)
+	const float roughness = (float)bindData.prefilterLevel / (PREFILTER_LEVELS - 1.f);
+	const uint face = bindData.cubeFace + dispatchId.z;
+	
+	float2 uv = (dispatchId.xy + 0.5f) / width;
+	uv = uv * 2.f - 1.f;
+	
+	// Assuming normal = view results in reduced highlights at grazing angles.
+	float3 normal = normalize(ComputeDirection(uv, face));
+	float3 reflection = normal;
+	float3 view = reflection;
+	
+	// Sample count.
+	const int steps = roughness * 256 + 1;
+	float sumWeight = 0.f;
+	float3 sumSamples = 0.f;
+	
+	for (int j = 0; j < steps; ++j)
 	{
-		RWTexture2DArray<float4> prefilterMap = ResourceDescriptorHeap[bindData.prefilterMips[i]];
-		prefilterMap.GetDimensions(width, height, depth);
-		
-		uint groupMask = (1u << i) - 1;
-		groupMask |= groupMask << maskShift;
-		if ((xyIndex & groupMask) == 0)
+		float2 sequence = HammersleySet(j, steps);
+		float3 halfway = ImportanceSampledGGX(sequence, normal, roughness);
+		float3 light = normalize(2.f * dot(view, halfway) * halfway - view);
+		float normalDotLight = saturate(dot(normal, light));
+		if (normalDotLight > 0.f)
 		{
-			const float roughness = (float)i / (PREFILTER_LEVELS - 1.f);
-		
-			uint2 pixel = dispatchId.xy / pow(2, i);
-			float2 uv = (pixel + 0.5f) / width;
-			uv = uv * 2.f - 1.f;
-	
-			// Assuming normal = view results in reduced highlights at grazing angles.
-			float3 normal = normalize(ComputeDirection(uv, bindData.cubeFace));
-			float3 reflection = normal;
-			float3 view = reflection;
-		
-			// Sample count.
-			const int steps = roughness * 256 + 1;
-			float sumWeight = 0.f;
-			float3 sumSamples = 0.f;
-	
-			for (int j = 0; j < steps; ++j)
-			{
-				float2 sequence = HammersleySet(j, steps);
-				float3 halfway = ImportanceSampledGGX(sequence, normal, roughness);
-				float3 light = normalize(2.f * dot(view, halfway) * halfway - view);
-				float normalDotLight = saturate(dot(normal, light));
-				if (normalDotLight > 0.f)
-				{
-					// Reduce aliasing artifacts from the predictible sequence. Can also jitter the sequence to improve visual fidelity.
-					// See: https://chetanjags.wordpress.com/2015/08/26/image-based-lighting/
+			// Reduce aliasing artifacts from the predictible sequence. Can also jitter the sequence to improve visual fidelity.
+			// See: https://chetanjags.wordpress.com/2015/08/26/image-based-lighting/
 			
-					float D = TrowbridgeReitzGGX(normal, halfway, roughness);
-					float normalDotHalfway = saturate(dot(normal, halfway));
-					float halfwayDotView = saturate(dot(halfway, view));
-					float pdf = D * normalDotHalfway / (4.f * halfwayDotView) + 0.0001f;
-					float saSample = 1.f / ((float)steps * pdf + 0.0001f);
-					float mip = roughness == 0.f ? 0.f : 0.5f * log2(saSample / saTexel);
-					
-					sumWeight += normalDotLight;
-					sumSamples += luminanceMap.SampleLevel(bilinearClamp, light, mip).rgb * normalDotLight;
-				}
-			}
-	
-			prefilterMap[uint3(pixel, bindData.cubeFace)] = float4(sumSamples / sumWeight, 0.f);
+			float D = TrowbridgeReitzGGX(normal, halfway, roughness);
+			float normalDotHalfway = saturate(dot(normal, halfway));
+			float halfwayDotView = saturate(dot(halfway, view));
+			float pdf = D * normalDotHalfway / (4.f * halfwayDotView) + 0.0001f;
+			float saSample = 1.f / ((float)steps * pdf + 0.0001f);
+			float mip = roughness == 0.f ? 0.f : 0.5f * log2(saSample / saTexel);
+			
+			sumWeight += normalDotLight;
+			sumSamples += luminanceMap.SampleLevel(bilinearClamp, light, mip).rgb * normalDotLight;
 		}
 	}
+	
+	prefilterMap[uint3(dispatchId.xy, face)] = float4(sumSamples / sumWeight, 0.f);
 }
 
 [RootSignature(RS)]
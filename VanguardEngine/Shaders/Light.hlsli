@@ -24,6 +24,17 @@ struct Light
 	float padding;
 };
 
+// Consecutive lights of the Morton sorted light order, see LightHierarchy.h. The sphere encloses the influence of every light.
+struct LightNode
+{
+	float3 center;
+	float radius;
+	// Boundary
+	uint firstLight;  // Offset into the light order.
+	uint lightCount;
+	uint2 padding;
+};
+
 float ComputeLightRadius(Light light)
 {
 	// #TEMP
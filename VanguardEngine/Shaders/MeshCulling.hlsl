@@ -6,19 +6,36 @@
 
 struct BindData
 {
-	uint inputBuffer;
+	uint batchInstanceBuffer;
+	uint batchArgumentBuffer;
+	uint counterBuffer;
 	uint outputBuffer;
+	uint visibleInstanceBuffer;
 	uint objectBuffer;
 	uint cameraBuffer;
-	uint cameraIndex;
-	uint drawCount;
+	uint viewBuffer;
+	uint viewCount;
+	uint instanceCount;
+	uint batchCount;
 	uint cullingLevel;
 	uint hiZTexture;
 	uint hiZMipLevels;
+	uint meshletBuffer;
+	uint candidateBuffer;
+	uint meshletDrawCapacity;  // Zero when meshlet culling is disabled.
+	uint meshletGroupCount;
+	uint lodCount;
+	uint visibilityBuffer;
+	uint phase;
 };
 
 ConstantBuffer<BindData> bindData : register(b0);
 
+// Views with occlusion culling are culled in two phases. The early phase draws what was visible last frame, and its depth
+// builds the hi-z. The late phase tests everything against that hi-z and draws what the early phase missed.
+static const uint earlyPhase = 0;
+static const uint latePhase = 1;
+
 struct MeshIndirectArgument
 {
 	uint batchId;
@@ -27,9 +44,98 @@ struct MeshIndirectArgument
 	uint startIndexLocation;
 	int baseVertexLocation;
 	uint startInstanceLocation;
-	float2 padding;
+	float lodError;
+	float padding;
+};
+
+struct BatchedInstance
+{
+	uint objectId;
+	uint batchIndex;
+};
+
+struct MeshCullView
+{
+	uint cameraIndex;
+	uint occlusion;
+	float lodScale;
 };
 
+struct MeshletData
+{
+	float3 center;
+	float radius;
+	float3 coneApex;
+	float coneCutoff;
+	float3 coneAxis;
+	uint indexOffset;
+	uint indexCount;
+	float3 padding;
+};
+
+struct MeshletCandidate
+{
+	uint batchIndex;
+	uint view;
+};
+
+// Per-view buffer layout, must match ViewCullLayout.
+
+uint TemplateIndex(uint batch, uint lod)
+{
+	return batch * bindData.lodCount + lod;
+}
+
+uint TemplateCount()
+{
+	return bindData.batchCount * bindData.lodCount;
+}
+
+uint DrawCountIndex(uint view)
+{
+	return view;
+}
+
+uint MeshletDrawCountIndex(uint view)
+{
+	return bindData.viewCount + view;
+}
+
+uint CandidateCountIndex()
+{
+	return 2 * bindData.viewCount;
+}
+
+uint InstanceCountIndex(uint view, uint batch, uint lod)
+{
+	return 2 * bindData.viewCount + 1 + view * TemplateCount() + TemplateIndex(batch, lod);
+}
+
+uint ArgumentIndex(uint view)
+{
+	return view * (TemplateCount() + bindData.meshletDrawCapacity);
+}
+
+uint MeshletArgumentIndex(uint view)
+{
+	return ArgumentIndex(view) + TemplateCount();
+}
+
+uint VisibleInstanceIndex(uint view, uint lod)
+{
+	return (view * bindData.lodCount + lod) * bindData.instanceCount;
+}
+
+uint CandidateInstanceIndex(uint candidate)
+{
+	return bindData.viewCount * bindData.lodCount * bindData.instanceCount + candidate;
+}
+
+float MaxScale(ObjectData object)
+{
+	return sqrt(max(max(dot(object.worldMatrix[0].xyz, object.worldMatrix[0].xyz), dot(object.worldMatrix[1].xyz, object.worldMatrix[1].xyz)), dot(object.worldMatrix[2].xyz, object.worldMatrix[2].xyz)));
+}
+
 // Credit: 2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere
 bool ProjectSphere(float3 center, float radius, Camera camera, out float4 aabb)
 {
@@ -47,19 +153,17 @@ bool ProjectSphere(float3 center, float radius, Camera camera, out float4 aabb)
 	float2 miny = mul(cy, float2x2(vy.x, vy.y, -vy.y, vy.x));
 	float2 maxy = mul(cy, float2x2(vy.x, -vy.y, vy.y, vy.x));
 
-	float p00 = camera.lastFrameProjection._m00;
-	float p11 = camera.lastFrameProjection._m11;
+	float p00 = camera.projection._m00;
+	float p11 = camera.projection._m11;
 	aabb = float4(minx.x / minx.y * p00, miny.x / miny.y * p11, maxx.x / maxx.y * p00, maxy.x / maxy.y * p11);
 	aabb = aabb.xwzy * float4(0.5, -0.5, 0.5, -0.5) + 0.5.xxxx;
 
 	return true;
 }
 
-bool IsVisible(ObjectData object, Camera camera)
+// Center in world space.
+bool IsSphereInFrustum(float3 center, float radius, Camera camera)
 {
-	float3 center = float3(object.worldMatrix._m30, object.worldMatrix._m31, object.worldMatrix._m32);
-	float radius = object.boundingSphereRadius * 4.f;  // #TODO: Something weird with bounding sphere size...
-
 	// Project sphere into view space.
 	float4 viewSpace = mul(float4(center, 1.f), camera.view);
 	center = (viewSpace / viewSpace.w).xyz;  // Perspective division.
@@ -85,54 +189,289 @@ bool IsVisible(ObjectData object, Camera camera)
 	visible = visible && -radius <= mul(center, r3);  // Near plane
 	visible = visible && -radius <= mul(center, r3 - r2);  // Far plane
 
-	if (visible && bindData.cullingLevel > 1)
+	return visible;
+}
+
+// Center in world space. Spheres crossing the near plane are considered unoccluded.
+bool IsSphereUnoccluded(float3 center, float radius, Camera camera)
+{
+	float4 viewSpace = mul(float4(center, 1.f), camera.view);
+	center = (viewSpace / viewSpace.w).xyz;
+
+	// Convention here is +Z going outwards from camera.
+	center.z *= -1;
+
+	float4 aabb;
+	if (ProjectSphere(center, radius, camera, aabb))
 	{
-		// Convention here is +Z going outwards from camera.
-		center.z *= -1;
-		radius *= 0.25;  // Revert the weird 4x scaling above.
-		radius += 2;  // Add buffering zone to reduce artifacts from 1-frame delay.
+		Texture2D<float> hiZTexture = ResourceDescriptorHeap[bindData.hiZTexture];
+		uint width, height, mipCount;
+		hiZTexture.GetDimensions(0, width, height, mipCount);
+		mipCount = min(mipCount, bindData.hiZMipLevels) - 1;
 
-		float4 aabb;
-		if (ProjectSphere(center, radius, camera, aabb))
-		{
-			Texture2D<float> hiZTexture = ResourceDescriptorHeap[bindData.hiZTexture];
-			uint width, height, mipCount;
-			hiZTexture.GetDimensions(0, width, height, mipCount);
-			mipCount = min(mipCount, bindData.hiZMipLevels) - 1;
+		float projectedWidth = (aabb.z - aabb.x) * width;
+		float projectedHeight = (aabb.w - aabb.y) * height;
 
-			float projectedWidth = (aabb.z - aabb.x) * width;
-			float projectedHeight = (aabb.w - aabb.y) * height;
+		float level = min(floor(log2(max(projectedWidth, projectedHeight))), mipCount);
+		float2 uv = (aabb.xy + aabb.zw) * 0.5;
+		float depth = hiZTexture.SampleLevel(linearMipPointClampMinimum, uv, level);
+		float depthSphere = camera.nearPlane / (center.z - radius);
 
-			float level = min(floor(log2(max(projectedWidth, projectedHeight))), mipCount);
-			float2 uv = (aabb.xy + aabb.zw) * 0.5;
-			float depth = hiZTexture.SampleLevel(linearMipPointClampMinimum, uv, level);
-			float depthSphere = camera.nearPlane / (center.z - radius);
+		return depthSphere >= depth;  // Inverse Z.
+	}
 
-			visible = visible && depthSphere >= depth;  // Inverse Z.
-		}
+	return true;
+}
+
+// Views that build the hi-z are culled in two phases, only the late phase can test occlusion.
+bool UsesOcclusion(MeshCullView cullView)
+{
+	return cullView.occlusion > 0 && bindData.cullingLevel > 1;
+}
+
+bool IsVisible(ObjectData object, Camera camera, bool occlusion)
+{
+	if (bindData.cullingLevel == 0)
+		return true;
+
+	bool visible = IsSphereInFrustum(object.boundingSphereCenter, object.boundingSphereRadius, camera);
+
+	if (visible && occlusion)
+	{
+		visible = IsSphereUnoccluded(object.boundingSphereCenter, object.boundingSphereRadius, camera);
 	}
 
 	return visible;
 }
 
+// Must match Meshlets::IsConeCulled().
+bool IsConeCulled(MeshletData meshlet, ObjectData object, float3 cameraPosition)
+{
+	// Degenerate cones have a cutoff of one, the triangles face too many directions.
+	if (meshlet.coneCutoff >= 1.f)
+		return false;
+
+	// Test in object space, with the inverse built from the cofactors of the upper 3x3.
+	float3 row0 = object.worldMatrix[0].xyz;
+	float3 row1 = object.worldMatrix[1].xyz;
+	float3 row2 = object.worldMatrix[2].xyz;
+	float3 cofactor0 = cross(row1, row2);
+	float3 cofactor1 = cross(row2, row0);
+	float3 cofactor2 = cross(row0, row1);
+	float determinant = dot(row0, cofactor0);
+
+	// Mirroring transforms flip the winding, the cone would describe the back faces.
+	if (determinant <= 0.f)
+		return false;
+
+	float3 relativeCamera = cameraPosition - object.worldMatrix[3].xyz;
+	float3 objectCamera = float3(dot(relativeCamera, cofactor0), dot(relativeCamera, cofactor1), dot(relativeCamera, cofactor2)) / determinant;
+
+	return dot(normalize(meshlet.coneApex - objectCamera), meshlet.coneAxis) >= meshlet.coneCutoff;
+}
+
+bool IsMeshletVisible(MeshletData meshlet, ObjectData object, Camera camera, bool occlusion)
+{
+	float3 center = mul(float4(meshlet.center, 1.f), object.worldMatrix).xyz;
+	float radius = meshlet.radius * MaxScale(object);
+
+	if (!IsSphereInFrustum(center, radius, camera))
+		return false;
+
+	if (IsConeCulled(meshlet, object, camera.position.xyz))
+		return false;
+
+	if (occlusion)
+		return IsSphereUnoccluded(center, radius, camera);
+
+	return true;
+}
+
+// Must match MeshLods::Select(). The coarsest level whose error covers at most a pixel, after the view's lod scale.
+uint SelectLod(ObjectData object, uint batchIndex, Camera camera, MeshCullView cullView)
+{
+	StructuredBuffer<MeshIndirectArgument> batchArgumentBuffer = ResourceDescriptorHeap[bindData.batchArgumentBuffer];
+
+	if (cullView.lodScale <= 0.f)
+		return 0;
+
+	// Distance to the nearest point of the bounding sphere, full detail once the camera is inside.
+	float distance = length(object.boundingSphereCenter - camera.position.xyz) - object.boundingSphereRadius;
+	if (distance <= camera.nearPlane)
+		return 0;
+
+	float pixelsPerUnit = MaxScale(object) * cullView.lodScale / distance;
+
+	uint lod = 0;
+	for (uint i = 1; i < bindData.lodCount; ++i)
+	{
+		if (batchArgumentBuffer[TemplateIndex(batchIndex, i)].lodError * pixelsPerUnit <= 1.f)
+			lod = i;
+	}
+
+	return lod;
+}
+
 [RootSignature(RS)]
 [numthreads(64, 1, 1)]
 void Main(uint dispatchId : SV_DispatchThreadID)
 {
-	StructuredBuffer<MeshIndirectArgument> inputBuffer = ResourceDescriptorHeap[bindData.inputBuffer];
-	AppendStructuredBuffer<MeshIndirectArgument> outputBuffer = ResourceDescriptorHeap[bindData.outputBuffer];
+	StructuredBuffer<BatchedInstance> batchInstanceBuffer = ResourceDescriptorHeap[bindData.batchInstanceBuffer];
+	StructuredBuffer<MeshIndirectArgument> batchArgumentBuffer = ResourceDescriptorHeap[bindData.batchArgumentBuffer];
+	RWBuffer<uint> counterBuffer = ResourceDescriptorHeap[bindData.counterBuffer];
+	RWStructuredBuffer<uint> visibleInstanceBuffer = ResourceDescriptorHeap[bindData.visibleInstanceBuffer];
 	StructuredBuffer<ObjectData> objectBuffer = ResourceDescriptorHeap[bindData.objectBuffer];
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
-	Camera camera = cameraBuffer[bindData.cameraIndex];
+	StructuredBuffer<MeshCullView> viewBuffer = ResourceDescriptorHeap[bindData.viewBuffer];
+	RWStructuredBuffer<MeshletCandidate> candidateBuffer = ResourceDescriptorHeap[bindData.candidateBuffer];
+	RWStructuredBuffer<uint> visibilityBuffer = ResourceDescriptorHeap[bindData.visibilityBuffer];
 
 	uint index = dispatchId.x;
-	if (index < bindData.drawCount)
+	if (index < bindData.instanceCount)
 	{
-		uint objectId = inputBuffer[index].batchId;  // #TODO: Sufficient for now, won't work with instancing.
+		BatchedInstance instance = batchInstanceBuffer[index];
+		ObjectData object = objectBuffer[instance.objectId];
+		uint firstInstance = batchArgumentBuffer[TemplateIndex(instance.batchIndex, 0)].batchId;
+
+		// The instance is loaded once and tested against every view.
+		for (uint view = 0; view < bindData.viewCount; ++view)
+		{
+			MeshCullView cullView = viewBuffer[view];
+			Camera camera = cameraBuffer[cullView.cameraIndex];
+
+			bool visible;
+			if (UsesOcclusion(cullView))
+			{
+				// One bit per instance, only the view that builds the hi-z uses occlusion.
+				uint visibilityMask = 1u << (index % 32);
+				bool wasVisible = (visibilityBuffer[index / 32] & visibilityMask) != 0;
+
+				if (bindData.phase == earlyPhase)
+				{
+					visible = wasVisible && IsVisible(object, camera, false);
+				}
+
+				else
+				{
+					bool unoccluded = IsVisible(object, camera, true);
+					if (unoccluded)
+						InterlockedOr(visibilityBuffer[index / 32], visibilityMask);
+					else
+						InterlockedAnd(visibilityBuffer[index / 32], ~visibilityMask);
+
+					visible = unoccluded && !wasVisible;  // Already drawn by the early phase otherwise.
+				}
+			}
+
+			else
+			{
+				// Without occlusion everything is drawn in the early phase.
+				visible = bindData.phase == earlyPhase && IsVisible(object, camera, false);
+			}
+
+			if (visible)
+			{
+				uint lod = SelectLod(object, instance.batchIndex, camera, cullView);
+
+				// Full detail instances made of several meshlets are drawn per meshlet, after culling each of them.
+				if (bindData.meshletDrawCapacity > 0 && bindData.cullingLevel > 0 && object.meshletCount > 1 && lod == 0)
+				{
+					uint candidate;
+					InterlockedAdd(counterBuffer[CandidateCountIndex()], 1, candidate);
+
+					MeshletCandidate meshletCandidate;
+					meshletCandidate.batchIndex = instance.batchIndex;
+					meshletCandidate.view = view;
+					candidateBuffer[candidate] = meshletCandidate;
+					visibleInstanceBuffer[CandidateInstanceIndex(candidate)] = instance.objectId;
+
+					continue;
+				}
+
+				// Compact the visible instances to the front of the batch's range in the view's copy for the level.
+				uint slot;
+				InterlockedAdd(counterBuffer[InstanceCountIndex(view, instance.batchIndex, lod)], 1, slot);
+				visibleInstanceBuffer[VisibleInstanceIndex(view, lod) + firstInstance + slot] = instance.objectId;
+			}
+		}
+	}
+}
+
+[RootSignature(RS)]
+[numthreads(64, 1, 1)]
+void CompactionMain(uint dispatchId : SV_DispatchThreadID)
+{
+	StructuredBuffer<MeshIndirectArgument> batchArgumentBuffer = ResourceDescriptorHeap[bindData.batchArgumentBuffer];
+	RWBuffer<uint> counterBuffer = ResourceDescriptorHeap[bindData.counterBuffer];
+	RWStructuredBuffer<MeshIndirectArgument> outputBuffer = ResourceDescriptorHeap[bindData.outputBuffer];
+
+	uint index = dispatchId.x;
+	if (index < bindData.viewCount * TemplateCount())
+	{
+		uint view = index / TemplateCount();
+		uint batch = index % TemplateCount() / bindData.lodCount;
+		uint lod = index % bindData.lodCount;
+		uint instanceCount = counterBuffer[InstanceCountIndex(view, batch, lod)];
+		if (instanceCount > 0)
+		{
+			MeshIndirectArgument argument = batchArgumentBuffer[TemplateIndex(batch, lod)];
+			argument.batchId += VisibleInstanceIndex(view, lod);  // Point the draw at the view's instance range for the level.
+			argument.instanceCount = instanceCount;
+
+			uint slot;
+			InterlockedAdd(counterBuffer[DrawCountIndex(view)], 1, slot);
+			outputBuffer[ArgumentIndex(view) + slot] = argument;
+		}
+	}
+}
+
+// Persistent groups, each walking the candidate instances with one thread per meshlet.
+static const uint meshletGroupSize = 64;
+
+[RootSignature(RS)]
+[numthreads(meshletGroupSize, 1, 1)]
+void MeshletMain(uint groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	StructuredBuffer<MeshIndirectArgument> batchArgumentBuffer = ResourceDescriptorHeap[bindData.batchArgumentBuffer];
+	RWBuffer<uint> counterBuffer = ResourceDescriptorHeap[bindData.counterBuffer];
+	RWStructuredBuffer<MeshIndirectArgument> outputBuffer = ResourceDescriptorHeap[bindData.outputBuffer];
+	RWStructuredBuffer<uint> visibleInstanceBuffer = ResourceDescriptorHeap[bindData.visibleInstanceBuffer];
+	StructuredBuffer<ObjectData> objectBuffer = ResourceDescriptorHeap[bindData.objectBuffer];
+	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
+	StructuredBuffer<MeshCullView> viewBuffer = ResourceDescriptorHeap[bindData.viewBuffer];
+	StructuredBuffer<MeshletData> meshletBuffer = ResourceDescriptorHeap[bindData.meshletBuffer];
+	RWStructuredBuffer<MeshletCandidate> candidateBuffer = ResourceDescriptorHeap[bindData.candidateBuffer];
+
+	uint groupCount = bindData.meshletGroupCount;
+	uint candidateCount = counterBuffer[CandidateCountIndex()];
+
+	for (uint candidate = groupId; candidate < candidateCount; candidate += groupCount)
+	{
+		MeshletCandidate meshletCandidate = candidateBuffer[candidate];
+		uint objectId = visibleInstanceBuffer[CandidateInstanceIndex(candidate)];
 		ObjectData object = objectBuffer[objectId];
-		if (IsVisible(object, camera))
+		MeshCullView cullView = viewBuffer[meshletCandidate.view];
+		Camera camera = cameraBuffer[cullView.cameraIndex];
+		MeshIndirectArgument batchArgument = batchArgumentBuffer[TemplateIndex(meshletCandidate.batchIndex, 0)];
+
+		for (uint i = groupIndex; i < object.meshletCount; i += meshletGroupSize)
 		{
-			outputBuffer.Append(inputBuffer[index]);
+			MeshletData meshlet = meshletBuffer[object.meshletOffset + i];
+			if (IsMeshletVisible(meshlet, object, camera, UsesOcclusion(cullView) && bindData.phase == latePhase))
+			{
+				MeshIndirectArgument argument = batchArgument;
+				argument.batchId = CandidateInstanceIndex(candidate);  // Single instance, reads the candidate's object.
+				argument.indexCountPerInstance = meshlet.indexCount;
+				argument.instanceCount = 1;
+				argument.startIndexLocation += meshlet.indexOffset;
+
+				uint slot;
+				InterlockedAdd(counterBuffer[MeshletDrawCountIndex(meshletCandidate.view)], 1, slot);
+				if (slot < bindData.meshletDrawCapacity)
+				{
+					outputBuffer[MeshletArgumentIndex(meshletCandidate.view) + slot] = argument;
+				}
+			}
 		}
 	}
 }
\ No newline at end of file
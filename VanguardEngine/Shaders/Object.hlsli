@@ -11,9 +11,19 @@ struct ObjectData
 {
 	matrix worldMatrix;
 	VertexMetadata vertexMetadata;
+	float3 boundingSphereCenter;  // World space.
+	float boundingSphereRadius;  // World space.
 	uint materialIndex;
-	float boundingSphereRadius;
-	float2 padding;
+	uint meshletOffset;
+	uint meshletCount;
+	uint padding;
 };
 
+// Instanced draws cover a range of the visible instance buffer starting at the batch ID, which holds object indices.
+uint LoadObjectId(uint visibleInstanceBuffer, uint batchId, uint instanceId)
+{
+	StructuredBuffer<uint> visibleInstances = ResourceDescriptorHeap[visibleInstanceBuffer];
+	return visibleInstances[batchId + instanceId];
+}
+
 #endif  // __OBJECT_HLSLI__
\ No newline at end of file
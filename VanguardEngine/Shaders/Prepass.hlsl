@@ -9,6 +9,7 @@ struct BindData
 {
 	uint batchId;
 	uint objectBuffer;
+	uint visibleInstanceBuffer;
 	uint cameraBuffer;
 	uint cameraIndex;
 	uint vertexPositionBuffer;
@@ -31,7 +32,8 @@ struct Output
 Output VSMain(Input input)
 {
 	StructuredBuffer<ObjectData> objectBuffer = ResourceDescriptorHeap[bindData.objectBuffer];
-	ObjectData object = objectBuffer[bindData.batchId + input.instanceId];
+	uint objectId = LoadObjectId(bindData.visibleInstanceBuffer, bindData.batchId, input.instanceId);
+	ObjectData object = objectBuffer[objectId];
 	StructuredBuffer<Camera> cameraBuffer = ResourceDescriptorHeap[bindData.cameraBuffer];
 	Camera camera = cameraBuffer[bindData.cameraIndex];
 
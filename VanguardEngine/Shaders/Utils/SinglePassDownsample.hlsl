@@ -0,0 +1,245 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include "RootSignature.hlsli"
+#include "Color.hlsli"
+
+// Builds a mip chain in a single dispatch. Each group reduces a 64x64 tile of the first level down to a single texel, six
+// levels below. The last group to finish then reduces the texels of every tile through the remaining levels. Must match
+// SinglePassDownsampler.cpp, which validates the mapping on the CPU.
+// See: https://gpuopen.com/fidelityfx-spd/
+
+// REDUCTION: 0=minimum, 1=maximum, 2=average, 3=Karis average on the first level, average after.
+// RESAMPLE_SOURCE: 0=the source is the first level, 1=the source is resampled to the first level's size and written to it.
+
+#define REDUCTION_MINIMUM 0
+#define REDUCTION_MAXIMUM 1
+#define REDUCTION_AVERAGE 2
+#define REDUCTION_KARIS_AVERAGE 3
+
+struct BindData
+{
+	uint sourceTexture;
+	uint counterBuffer;  // Zero between dispatches, the last group resets it.
+	uint groupCount;
+	uint levelCount;  // Including the first level.
+	// Boundary
+	uint2 size;  // Of the first level.
+	uint2 groups;
+	// Boundary
+	uint4 levelTextures[4];  // UAV of each level, the first is only written when resampling.
+};
+
+ConstantBuffer<BindData> bindData : register(b0);
+
+static const uint tileSize = 64;
+static const uint groupLevels = 6;
+
+// Ping-pong between the levels reduced in group memory.
+groupshared float4 groupLevelA[256];
+groupshared float4 groupLevelB[64];
+groupshared uint groupPreviousCount;
+
+uint LevelTexture(uint level)
+{
+	return bindData.levelTextures[level / 4][level % 4];
+}
+
+uint2 LevelSize(uint level)
+{
+	return max(bindData.size >> level, 1);
+}
+
+float4 Reduce(float4 a, float4 b, float4 c, float4 d, uint level)
+{
+#if REDUCTION == REDUCTION_MINIMUM
+	return min(min(a, b), min(c, d));
+#elif REDUCTION == REDUCTION_MAXIMUM
+	return max(max(a, b), max(c, d));
+#else
+#if REDUCTION == REDUCTION_KARIS_AVERAGE
+	if (level == 1)
+	{
+		// See: https://graphicrants.blogspot.com/2013/12/tone-mapping.html
+		float weightA = 1.f / (1.f + LinearToLuminance(a.rgb));
+		float weightB = 1.f / (1.f + LinearToLuminance(b.rgb));
+		float weightC = 1.f / (1.f + LinearToLuminance(c.rgb));
+		float weightD = 1.f / (1.f + LinearToLuminance(d.rgb));
+
+		return (a * weightA + b * weightB + c * weightC + d * weightD) / (weightA + weightB + weightC + weightD);
+	}
+#endif
+
+	return (a + b + c + d) * 0.25f;
+#endif
+}
+
+void WriteLevel(uint level, uint2 texel, float4 value)
+{
+	if (all(texel < LevelSize(level)))
+	{
+		if (level == groupLevels)
+		{
+			// Read by the last group.
+			globallycoherent RWTexture2D<float4> output = ResourceDescriptorHeap[LevelTexture(level)];
+			output[texel] = value;
+		}
+
+		else
+		{
+			RWTexture2D<float4> output = ResourceDescriptorHeap[LevelTexture(level)];
+			output[texel] = value;
+		}
+	}
+}
+
+// Texel of the tile's base level, clamped to the level.
+float4 LoadBase(uint baseLevel, uint2 texel)
+{
+	const uint2 clampedTexel = min(texel, LevelSize(baseLevel) - 1);
+
+	if (baseLevel > 0)
+	{
+		// Written by the other groups during this dispatch.
+		globallycoherent RWTexture2D<float4> input = ResourceDescriptorHeap[LevelTexture(baseLevel)];
+		return input[clampedTexel];
+	}
+
+	Texture2D<float4> source = ResourceDescriptorHeap[bindData.sourceTexture];
+
+#if RESAMPLE_SOURCE
+	float2 uv = (clampedTexel + 0.5f) / (float2)bindData.size;
+#if REDUCTION == REDUCTION_MINIMUM
+	float4 value = source.SampleLevel(linearMipPointClampMinimum, uv, 0);
+#else
+	float4 value = source.SampleLevel(linearMipPointClamp, uv, 0);
+#endif
+	WriteLevel(0, texel, value);  // Clamped loads aren't written again.
+	return value;
+#else
+	return source[clampedTexel];
+#endif
+}
+
+// Tile local texel of a level, clamped to the level. Only levels one texel wide need clamping, the children of every other
+// texel are inside the level.
+uint2 ClampToLevel(uint level, uint2 tileOrigin, uint2 texel)
+{
+	const uint2 last = LevelSize(level) - 1;
+	return min(texel, last - min(tileOrigin, last));
+}
+
+// Reduces the tile of the base level at the tile coordinate, through the next six levels or until the last level.
+void DownsampleTile(uint baseLevel, uint2 tile, uint threadIndex)
+{
+	const uint lastLevel = min(baseLevel + groupLevels, bindData.levelCount - 1);
+	const uint2 thread = uint2(threadIndex % 16, threadIndex / 16);
+
+	// Each thread reduces 4x4 texels of the base level to 2x2 texels of the next level, then to one texel of the level after.
+	float4 quad[4];
+	for (uint i = 0; i < 4; ++i)
+	{
+		const uint2 offset = uint2(i % 2, i / 2);
+		const uint2 base = tile * tileSize + thread * 4 + offset * 2;
+
+		float4 a = LoadBase(baseLevel, base);
+		float4 b = LoadBase(baseLevel, base + uint2(1, 0));
+		float4 c = LoadBase(baseLevel, base + uint2(0, 1));
+		float4 d = LoadBase(baseLevel, base + uint2(1, 1));
+
+		quad[i] = Reduce(a, b, c, d, baseLevel + 1);
+		WriteLevel(baseLevel + 1, tile * (tileSize / 2) + thread * 2 + offset, quad[i]);
+	}
+
+	if (lastLevel < baseLevel + 2)
+	{
+		return;
+	}
+
+	const uint2 quadClamp = ClampToLevel(baseLevel + 1, tile * (tileSize / 2) + thread * 2, 1);
+	const float4 value = Reduce(quad[0], quad[quadClamp.x], quad[2 * quadClamp.y], quad[quadClamp.x + 2 * quadClamp.y], baseLevel + 2);
+	WriteLevel(baseLevel + 2, tile * (tileSize / 4) + thread, value);
+	groupLevelA[threadIndex] = value;
+
+	// The remaining levels are reduced in group memory, 8x8, 4x4, 2x2 and 1x1 texels per tile.
+	uint width = 16;
+	for (uint level = baseLevel + 3; level <= lastLevel; ++level)
+	{
+		GroupMemoryBarrierWithGroupSync();
+
+		const uint levelWidth = width / 2;
+		if (threadIndex < levelWidth * levelWidth)
+		{
+			const uint2 texel = uint2(threadIndex % levelWidth, threadIndex / levelWidth);
+			const uint2 child = texel * 2;
+			const uint2 clampChild = ClampToLevel(level - 1, tile * width, child + 1);
+			const bool fromA = (level - baseLevel) % 2 == 1;
+
+			float4 a, b, c, d;
+			if (fromA)
+			{
+				a = groupLevelA[child.y * width + child.x];
+				b = groupLevelA[child.y * width + clampChild.x];
+				c = groupLevelA[clampChild.y * width + child.x];
+				d = groupLevelA[clampChild.y * width + clampChild.x];
+			}
+			else
+			{
+				a = groupLevelB[child.y * width + child.x];
+				b = groupLevelB[child.y * width + clampChild.x];
+				c = groupLevelB[clampChild.y * width + child.x];
+				d = groupLevelB[clampChild.y * width + clampChild.x];
+			}
+
+			const float4 reduced = Reduce(a, b, c, d, level);
+			WriteLevel(level, tile * levelWidth + texel, reduced);
+
+			if (fromA)
+			{
+				groupLevelB[threadIndex] = reduced;
+			}
+			else
+			{
+				groupLevelA[threadIndex] = reduced;
+			}
+		}
+
+		width = levelWidth;
+	}
+}
+
+[RootSignature(RS)]
+[numthreads(256, 1, 1)]
+void Main(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	DownsampleTile(0, groupId.xy, groupIndex);
+
+	if (bindData.levelCount <= groupLevels + 1)
+	{
+		return;
+	}
+
+	// Make this group's last level visible to the group that finishes the chain.
+	AllMemoryBarrierWithGroupSync();
+
+	if (groupIndex == 0)
+	{
+		RWStructuredBuffer<uint> counter = ResourceDescriptorHeap[bindData.counterBuffer];
+		InterlockedAdd(counter[0], 1, groupPreviousCount);
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	if (groupPreviousCount != bindData.groupCount - 1)
+	{
+		return;
+	}
+
+	// Last group to finish, every tile has been reduced.
+	if (groupIndex == 0)
+	{
+		RWStructuredBuffer<uint> counter = ResourceDescriptorHeap[bindData.counterBuffer];
+		counter[0] = 0;
+	}
+
+	DownsampleTile(groupLevels, uint2(0, 0), groupIndex);
+}
\ No newline at end of file
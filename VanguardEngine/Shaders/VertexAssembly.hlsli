@@ -11,10 +11,18 @@ static const uint vertexChannelBitangent = 4;
 static const uint vertexChannelColor = 5;
 static const uint vertexChannels = 6;
 
+// Encodings of vertex channels in the extras buffer, quantized formats are 4 bytes.
+static const uint vertexFormatFloat = 0;
+static const uint vertexFormatOctahedral = 1;  // Unit vector, octahedral snorm16x2.
+static const uint vertexFormatOctahedralSign = 2;  // Octahedral unit vector, the sign is the lowest bit of y.
+static const uint vertexFormatHalf = 3;
+static const uint vertexFormatUnorm8 = 4;
+
 struct VertexMetadata
 {
 	uint activeChannels;  // Bit mask of vertex attributes.
-	float3 padding;
+	uint channelFormats;  // 4 bits per channel, vertex formats.
+	float2 padding;
 	// Tightly packed.
 	uint4 channelStrides[vertexChannels / 4 + 1];
 	uint4 channelOffsets[vertexChannels / 4 + 1];
@@ -45,11 +53,48 @@ uint GetVertexChannelOffset(VertexMetadata metadata, uint channel)
 	return metadata.channelOffsets[channel / 4][channel % 4];
 }
 
+uint GetVertexChannelFormat(VertexMetadata metadata, uint channel)
+{
+	return (metadata.channelFormats >> (channel * 4)) & 0xF;
+}
+
 uint GetVertexChannelIndex(VertexMetadata metadata, uint vertexId, uint channel)
 {
 	return vertexId * GetVertexChannelStride(metadata, channel) + GetVertexChannelOffset(metadata, channel);
 }
 
+float2 UnpackSnorm16x2(uint packed)
+{
+	int2 value = int2(asint(packed << 16) >> 16, asint(packed) >> 16);
+	return max(value / 32767.f, -1.f);
+}
+
+float3 DecodeOctahedral(uint packed)
+{
+	float2 encoded = UnpackSnorm16x2(packed);
+	float3 vector = float3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+	// Unfold the lower hemisphere.
+	float fold = saturate(-vector.z);
+	vector.x += vector.x >= 0.f ? -fold : fold;
+	vector.y += vector.y >= 0.f ? -fold : fold;
+	return normalize(vector);
+}
+
+float4 DecodeTangent(uint packed)
+{
+	return float4(DecodeOctahedral(packed), (packed & (1u << 16)) ? -1.f : 1.f);
+}
+
+float2 DecodeHalf(uint packed)
+{
+	return f16tof32(uint2(packed, packed >> 16));
+}
+
+float4 DecodeUnorm8(uint packed)
+{
+	return float4(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF, packed >> 24) / 255.f;
+}
+
 float4 LoadVertexPosition(VertexAssemblyData assembly, uint vertexId)
 {
 	ByteAddressBuffer positions = ResourceDescriptorHeap[assembly.positionBuffer];
@@ -61,29 +106,47 @@ float4 LoadVertexPosition(VertexAssemblyData assembly, uint vertexId)
 
 float3 LoadVertexNormal(VertexAssemblyData assembly, uint vertexId)
 {
+	if (!HasVertexAttribute(assembly.metadata, vertexChannelNormal))
+	{
+		return float3(0, 0, 0);
+	}
+	
 	ByteAddressBuffer extras = ResourceDescriptorHeap[assembly.extraBuffer];
+	uint index = GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelNormal);
 	
-	return HasVertexAttribute(assembly.metadata, vertexChannelNormal) ?
-		extras.Load<float3>(GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelNormal)) :
-		float3(0, 0, 0);
+	return GetVertexChannelFormat(assembly.metadata, vertexChannelNormal) == vertexFormatOctahedral ?
+		DecodeOctahedral(extras.Load(index)) :
+		extras.Load<float3>(index);
 }
 
 float2 LoadVertexTexcoord(VertexAssemblyData assembly, uint vertexId)
 {
+	if (!HasVertexAttribute(assembly.metadata, vertexChannelTexcoord))
+	{
+		return float2(0, 0);
+	}
+	
 	ByteAddressBuffer extras = ResourceDescriptorHeap[assembly.extraBuffer];
+	uint index = GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelTexcoord);
 	
-	return HasVertexAttribute(assembly.metadata, vertexChannelTexcoord) ?
-		extras.Load<float2>(GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelTexcoord)) :
-		float2(0, 0);
+	return GetVertexChannelFormat(assembly.metadata, vertexChannelTexcoord) == vertexFormatHalf ?
+		DecodeHalf(extras.Load(index)) :
+		extras.Load<float2>(index);
 }
 
 float4 LoadVertexTangent(VertexAssemblyData assembly, uint vertexId)
 {
+	if (!HasVertexAttribute(assembly.metadata, vertexChannelTangent))
+	{
+		return float4(0, 0, 0, 0);
+	}
+	
 	ByteAddressBuffer extras = ResourceDescriptorHeap[assembly.extraBuffer];
+	uint index = GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelTangent);
 	
-	return HasVertexAttribute(assembly.metadata, vertexChannelTangent) ?
-		extras.Load<float4>(GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelTangent)) :
-		float4(0, 0, 0, 0);
+	return GetVertexChannelFormat(assembly.metadata, vertexChannelTangent) == vertexFormatOctahedralSign ?
+		DecodeTangent(extras.Load(index)) :
+		extras.Load<float4>(index);
 }
 
 float4 LoadVertexBitangent(VertexAssemblyData assembly, uint vertexId)
@@ -97,19 +160,27 @@ float4 LoadVertexBitangent(VertexAssemblyData assembly, uint vertexId)
 	
 	else
 	{
+		// The tangent's w is the handedness, for float tangents as imported and quantized ones alike.
 		float3 normal = LoadVertexNormal(assembly, vertexId);
-		float3 tangent = LoadVertexTangent(assembly, vertexId).xyz;
-		return float4(cross(normal, tangent), 1.f);
+		float4 tangent = LoadVertexTangent(assembly, vertexId);
+		float handedness = tangent.w < 0.f ? -1.f : 1.f;
+		return float4(cross(normal, tangent.xyz) * handedness, 1.f);
 	}
 }
 
 float4 LoadVertexColor(VertexAssemblyData assembly, uint vertexId)
 {
+	if (!HasVertexAttribute(assembly.metadata, vertexChannelColor))
+	{
+		return float4(0, 0, 0, 1);
+	}
+	
 	ByteAddressBuffer extras = ResourceDescriptorHeap[assembly.extraBuffer];
+	uint index = GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelColor);
 	
-	return HasVertexAttribute(assembly.metadata, vertexChannelColor) ?
-		extras.Load<float4>(GetVertexChannelIndex(assembly.metadata, vertexId, vertexChannelColor)) :
-		float4(0, 0, 0, 1);
+	return GetVertexChannelFormat(assembly.metadata, vertexChannelColor) == vertexFormatUnorm8 ?
+		DecodeUnorm8(extras.Load(index)) :
+		extras.Load<float4>(index);
 }
 
 #endif  // __VERTEXASSEMBLY_HLSLI__
\ No newline at end of file
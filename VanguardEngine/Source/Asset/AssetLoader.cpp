@@ -9,7 +9,16 @@
 #include <Rendering/MeshFactory.h>
 #include <Rendering/Resource.h>
 #include <Rendering/ShaderStructs.h>
+#include <Rendering/Meshlets.h>
+#include <Rendering/MeshLods.h>
+#include <Rendering/MeshBounds.h>
+#include <Rendering/MeshOrder.h>
+#include <Rendering/TextureMips.h>
+#include <Rendering/BlockCompression.h>
 #include <Utility/StringTools.h>
+#include <Utility/Math.h>
+#include <Utility/MappedFile.h>
+#include <Core/Config.h>
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -19,15 +28,18 @@
 #include <list>
 #include <utility>
 #include <algorithm>
+#include <optional>
+#include <numeric>
+#include <execution>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
 
 namespace AssetLoader
 {
-	size_t CreateMaterial(RenderDevice& device, const tinygltf::Material& material, const tinygltf::Model& model)
-	{
-		size_t result = AssetManager::Get().EnqueueMaterialLoad(material);
-		return result;
-	}
-
 	template <typename T, typename U, typename V>
 	auto FindVertexAttribute(const char* name, U&& model, V&& primitive) -> std::pair<const T*, size_t>
 	{
@@ -47,15 +59,263 @@ namespace AssetLoader
 		return { nullptr, 0 };
 	}
 
-	MeshComponent LoadMesh(RenderDevice& device, MeshFactory& factory, const std::filesystem::path& path)
+	// Mip content of each texture, by the first mipmapped material slot using it, and whether any material uses it for occlusion.
+	// Occlusion and emissive textures aren't mipmapped.
+	struct TextureUsage
 	{
-		VGScopedCPUStat("Load Mesh");
+		std::optional<TextureMips::Content> content;
+		bool occlusion = false;
+	};
+
+	std::vector<TextureUsage> GetTextureUsages(const tinygltf::Model& model)
+	{
+		std::vector<TextureUsage> usages(model.textures.size());
+		const auto Use = [&](int index, TextureMips::Content content)
+		{
+			if (index >= 0 && !usages[index].content)
+			{
+				usages[index].content = content;
+			}
+		};
+
+		for (const auto& material : model.materials)
+		{
+			Use(material.pbrMetallicRoughness.baseColorTexture.index, TextureMips::Content::SRGB);
+			Use(material.pbrMetallicRoughness.metallicRoughnessTexture.index, TextureMips::Content::Linear);
+			Use(material.normalTexture.index, TextureMips::Content::Normal);
+
+			if (material.occlusionTexture.index >= 0)
+			{
+				usages[material.occlusionTexture.index].occlusion = true;
+			}
+		}
+
+		return usages;
+	}
+
+	// Mip chains of the mipmapped material textures, by texture index, so that loading the materials only uploads them.
+	std::vector<std::vector<TextureMips::Image>> GenerateTextureMips(const tinygltf::Model& model, const std::vector<TextureUsage>& usages, const CookedModel::Settings& settings)
+	{
+		VGScopedCPUStat("Generate Texture Mips");
+
+		std::vector<std::vector<TextureMips::Image>> result(model.textures.size());
+
+		const auto filter = settings.textureMipFilter;
+		if (filter <= 0)
+		{
+			return result;  // Generated on the GPU at load.
+		}
+
+		for (size_t i = 0; i < model.textures.size(); ++i)
+		{
+			const auto& image = model.images[model.textures[i].source];
+			if (usages[i].content && image.component == 4 && image.bits == 8)
+			{
+				result[i] = TextureMips::Generate(image.image.data(), image.width, image.height, *usages[i].content, filter == 1 ? TextureMips::Filter::Box : TextureMips::Filter::Kaiser);
+			}
+		}
+
+		return result;
+	}
+
+	// Block compresses the material textures with a format for each usage, by texture index. Textures are compressed in parallel,
+	// mipmapped textures need their chain from import, since block compressed mips can't be generated on the GPU. Compressed
+	// textures release their uncompressed mips.
+	std::vector<BlockCompression::Texture> CompressTextures(const tinygltf::Model& model, const std::vector<TextureUsage>& usages, std::vector<std::vector<TextureMips::Image>>& textureMips, const CookedModel::Settings& settings)
+	{
+		VGScopedCPUStat("Compress Textures");
+
+		std::vector<BlockCompression::Texture> result(model.textures.size());
+
+		const auto compression = settings.textureCompression;
+		if (compression <= 0)
+		{
+			return result;
+		}
+
+		std::vector<size_t> indices(model.textures.size());
+		std::iota(indices.begin(), indices.end(), 0);
+		std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i)
+		{
+			const auto& image = model.images[model.textures[i].source];
+			auto& mips = textureMips[i];
+
+			// The base level of block compressed textures must be a whole number of blocks.
+			if (image.component != 4 || image.bits != 8 || image.width % 4 != 0 || image.height % 4 != 0 || (usages[i].content && mips.empty()))
+			{
+				return;
+			}
+
+			BlockCompression::Format format;
+			bool sRGB = false;
+			if (!usages[i].content)
+			{
+				if (!usages[i].occlusion)
+				{
+					return;  // Emissive.
+				}
+
+				format = BlockCompression::Format::BC4;  // Occlusion is only red.
+			}
+
+			else if (*usages[i].content == TextureMips::Content::SRGB)
+			{
+				// The fast path encodes opaque base colors as BC1, at half the size.
+				bool opaque = true;
+				for (size_t j = 3; j < image.image.size(); j += 4)
+				{
+					opaque &= image.image[j] == 255;
+				}
+
+				format = compression == 1 ? (opaque ? BlockCompression::Format::BC1 : BlockCompression::Format::BC3) : BlockCompression::Format::BC7;
+				sRGB = true;
+			}
+
+			else if (*usages[i].content == TextureMips::Content::Normal)
+			{
+				format = BlockCompression::Format::BC5;  // Z is reconstructed when sampling.
+			}
+
+			else
+			{
+				format = BlockCompression::Format::BC1;  // Metalness and roughness in blue and green, and occlusion in red if it's packed in.
+			}
+
+			auto& texture = result[i];
+			texture.format = BlockCompression::GetResourceFormat(format, sRGB);
+			texture.levels.reserve(mips.size() + 1);
+			texture.levels.emplace_back(BlockCompression::Compress(image.image.data(), image.width, image.height, format));
+			for (const auto& mip : mips)
+			{
+				texture.levels.emplace_back(BlockCompression::Compress(mip.data.data(), mip.width, mip.height, format));
+			}
+
+			mips = {};
+		});
+
+		return result;
+	}
+
+	// Moves the levels of each texture out of the glTF images, so the glTF model can be released after importing. Images shared by
+	// multiple textures are copied.
+	void ConvertTextures(tinygltf::Model& model, std::vector<std::vector<TextureMips::Image>>& textureMips, std::vector<BlockCompression::Texture>& compressedTextures, CookedModel::Model& output)
+	{
+		VGScopedCPUStat("Convert Textures");
+
+		std::vector<uint32_t> imageUses(model.images.size());
+		for (const auto& texture : model.textures)
+		{
+			++imageUses[texture.source];
+		}
+
+		output.textures.reserve(model.textures.size());
+
+		for (size_t i = 0; i < model.textures.size(); ++i)
+		{
+			const auto source = model.textures[i].source;
+			auto& image = model.images[source];
+			auto& compressed = compressedTextures[i];
+
+			CookedModel::Texture texture{
+				.width = static_cast<uint32_t>(image.width),
+				.height = static_cast<uint32_t>(image.height),
+				.format = compressed.levels.size() > 0 ? compressed.format : DXGI_FORMAT_UNKNOWN,
+				.firstLevel = static_cast<uint32_t>(output.levels.size())
+			};
+
+			if (compressed.levels.size() > 0)
+			{
+				std::move(compressed.levels.begin(), compressed.levels.end(), std::back_inserter(output.levels));
+			}
+
+			else if (image.image.size() > 0)
+			{
+				// The last texture using the image takes its data.
+				if (--imageUses[source] > 0)
+					output.levels.emplace_back(image.image);
+				else
+					output.levels.emplace_back(std::move(image.image));
+
+				for (auto& mip : textureMips[i])
+				{
+					output.levels.emplace_back(std::move(mip.data));
+				}
+			}
+
+			texture.levelCount = static_cast<uint32_t>(output.levels.size()) - texture.firstLevel;
+			output.textures.emplace_back(texture);
+		}
+	}
+
+	CookedModel::Material ConvertMaterial(const tinygltf::Material& material)
+	{
+		const auto& pbr = material.pbrMetallicRoughness;
+
+		return {
+			.baseColor = pbr.baseColorTexture.index,
+			.metallicRoughness = pbr.metallicRoughnessTexture.index,
+			.normal = material.normalTexture.index,
+			.occlusion = material.occlusionTexture.index,
+			.emissive = material.emissiveTexture.index,
+			.baseColorFactor = { static_cast<float>(pbr.baseColorFactor[0]), static_cast<float>(pbr.baseColorFactor[1]), static_cast<float>(pbr.baseColorFactor[2]), static_cast<float>(pbr.baseColorFactor[3]) },
+			.emissiveFactor = { static_cast<float>(material.emissiveFactor[0]), static_cast<float>(material.emissiveFactor[1]), static_cast<float>(material.emissiveFactor[2]) },
+			.metallicFactor = static_cast<float>(pbr.metallicFactor),
+			.roughnessFactor = static_cast<float>(pbr.roughnessFactor)
+		};
+	}
+
+	TransformComponent ConvertNodeTransform(const tinygltf::Node& node)
+	{
+		XMVECTOR scale = XMVectorSplatOne();
+		XMVECTOR rotation = XMQuaternionIdentity();
+		XMVECTOR translation = XMVectorZero();
+
+		if (node.matrix.size() == 16)
+		{
+			// Column major with column vectors has the same memory layout as row major with row vectors.
+			float values[16];
+			std::transform(node.matrix.begin(), node.matrix.end(), values, [](auto value) { return static_cast<float>(value); });
+
+			if (!XMMatrixDecompose(&scale, &rotation, &translation, XMMATRIX{ values }))
+			{
+				VGLogWarning(logAsset, "Failed to decompose transform of node '{}'.", Str2WideStr(node.name));
+			}
+		}
+
+		else
+		{
+			if (node.scale.size() == 3) scale = XMVectorSet(static_cast<float>(node.scale[0]), static_cast<float>(node.scale[1]), static_cast<float>(node.scale[2]), 0.f);
+			if (node.rotation.size() == 4) rotation = XMVectorSet(static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2]), static_cast<float>(node.rotation[3]));
+			if (node.translation.size() == 3) translation = XMVectorSet(static_cast<float>(node.translation[0]), static_cast<float>(node.translation[1]), static_cast<float>(node.translation[2]), 0.f);
+		}
+
+		TransformComponent result;
+		XMStoreFloat3(&result.scale, scale);
+		result.rotation = DecomposeRotationMatrix(XMMatrixRotationQuaternion(rotation));
+		XMStoreFloat3(&result.translation, translation);
+
+		return result;
+	}
+
+	CookedModel::Settings GetImportSettings()
+	{
+		return {
+			.textureMipFilter = *CvarGet("textureMipFilter", int),
+			.textureCompression = *CvarGet("textureCompression", int),
+			.lodLevels = static_cast<uint32_t>(std::clamp(*CvarGet("lodLevels", int), 1, static_cast<int>(maxMeshLods))),
+			.lodBaseError = *CvarGet("lodBaseError", float),
+			.vertexQuantization = *CvarGet("vertexQuantization", int)
+		};
+	}
+
+	std::optional<CookedModel::Model> ImportModel(const std::filesystem::path& path, const CookedModel::Settings& settings)
+	{
+		VGScopedCPUStat("Import Model");
 
 		std::string error;
 		std::string warning;
 
-		tinygltf::Model& model = AssetManager::Get().models.emplace_back();
-		AssetManager::Get().newModel = true;
+		tinygltf::Model model;
 		tinygltf::TinyGLTF loader;
 
 		bool result = false;
@@ -92,18 +352,11 @@ namespace AssetLoader
 		if (!result)
 		{
 			VGLogError(logAsset, "Failed to load asset '{}'.", path.filename().generic_wstring());
-		}
 
-		else
-		{
-			VGLog(logAsset, "Loaded asset '{}'.", path.filename().generic_wstring());
+			return std::nullopt;
 		}
 
-		std::vector<PrimitiveAssembly> assemblies;
-		std::vector<size_t> materials;
-		std::vector<uint32_t> materialIndices;
-		std::vector<float> boundingSpheres;
-		std::list<std::vector<uint32_t>> indices;  // We convert indices instead of using TinyGLTF's stream. One buffer per assembly. Stable buffers.
+		VGLog(logAsset, "Loaded asset '{}'.", path.filename().generic_wstring());
 
 		if (model.scenes.size() > 1)
 		{
@@ -114,26 +367,44 @@ namespace AssetLoader
 		if (scene.nodes.size() == 0)
 		{
 			VGLogWarning(logAsset, "Asset '{}' does not contain any nodes in the scene.", path.filename().generic_wstring());
-			return {};
+			return std::nullopt;
 		}
 
+		CookedModel::Model output;
+		output.settings = settings;
+
+		const auto textureUsages = GetTextureUsages(model);
+		auto textureMips = GenerateTextureMips(model, textureUsages, settings);
+		auto compressedTextures = CompressTextures(model, textureUsages, textureMips, settings);
+		ConvertTextures(model, textureMips, compressedTextures, output);
+
+		output.materials.reserve(model.materials.size());
 		for (const auto& material : model.materials)
 		{
-			materials.emplace_back(CreateMaterial(device, material, model));
+			output.materials.emplace_back(ConvertMaterial(material));
 		}
 
-		//for (const auto nodeIndex : scene.nodes)
-		for (const auto& mesh : model.meshes)
-		{
-			//const auto& node = model.nodes[nodeIndex];
+		std::vector<PrimitiveAssembly> assemblies;
+		std::vector<uint32_t> materialIndices;
+		std::vector<BoundingVolume> bounds;
+		std::vector<std::vector<MeshletData>> meshlets;
+		std::vector<std::vector<MeshLod>> lods;
+		std::list<std::vector<uint32_t>> indices;  // We convert indices instead of using TinyGLTF's stream. One buffer per assembly. Stable buffers.
+		std::list<std::vector<uint8_t>> vertices;  // Vertex streams reordered for fetching, replacing TinyGLTF's streams. Stable buffers.
+		MeshOrder::Statistics orderBefore;
+		MeshOrder::Statistics orderAfter;
+		size_t floatExtraSize = 0;  // Of the vertex extras if they weren't quantized.
 
-			// Process the node's mesh.
-			//if (node.mesh >= 0)
-			//model.meshes[node.mesh]
+		MeshLods::Settings lodSettings{};
+		lodSettings.levels = settings.lodLevels;
+		lodSettings.baseError = settings.lodBaseError;
 
-			// Process all the node's children.
-			//for (const auto child : node.children)
-			//model.nodes[child]
+		std::vector<std::pair<size_t, size_t>> meshSubsets;  // Subset range of each mesh, nodes can share meshes.
+		meshSubsets.reserve(model.meshes.size());
+
+		for (const auto& mesh : model.meshes)
+		{
+			meshSubsets.emplace_back(assemblies.size(), mesh.primitives.size());
 
 			for (const auto& primitive : mesh.primitives)
 			{
@@ -189,25 +460,60 @@ namespace AssetLoader
 
 				const auto* positionStream = reinterpret_cast<XMFLOAT3*>(assembly.GetAttributeData("POSITION"));
 				const auto positionCount = assembly.GetAttributeCount("POSITION");
-				float radius = 0.f;
 
-				for (int i = 0; i < positionCount; ++i)
+				size_t vertexSize = 0;
+				assembly.ForEachVertexStream([&vertexSize](auto, const auto& stream) { vertexSize += sizeof(stream[0]); });
+
+				orderBefore += MeshOrder::Analyze(indices.back(), positionCount, vertexSize);
+
+				// Meshlets and levels are built from triangles in cache order, so they inherit it.
+				MeshOrder::OptimizeTriangles(indices.back(), positionStream, positionCount);
+
+				bounds.emplace_back(MeshBounds::Compute(positionStream, positionCount));
+
+				// Meshlets are built while the winding is still counter-clockwise, the reordered indices replace the originals.
+				Meshlets::BuildOutput meshletOutput;
+				Meshlets::Build(indices.back(), positionStream, positionCount, meshletOutput);
+
+				// Meshlets must stay contiguous, so the cache order is restored within each of them.
+				for (const auto& meshlet : meshletOutput.meshlets)
+				{
+					MeshOrder::OptimizeVertexCache(std::span{ meshletOutput.indices }.subspan(meshlet.indexOffset, meshlet.indexCount));
+				}
+				meshlets.emplace_back(std::move(meshletOutput.meshlets));
+
+				// Simplified levels are appended after the full detail indices.
+				MeshLods::BuildOutput lodOutput;
+				MeshLods::Build(meshletOutput.indices, positionStream, positionCount, lodSettings, lodOutput);
+				indices.back() = std::move(lodOutput.indices);
+				lods.emplace_back(std::move(lodOutput.lods));
+
+				for (size_t level = 1; level < lods.back().size(); ++level)
 				{
-					radius = std::max(
-						std::max(
-							std::max(radius, positionStream[i].x),
-							positionStream[i].y
-						),
-						positionStream[i].z
-					);
+					const auto& lod = lods.back()[level];
+					MeshOrder::OptimizeVertexCache(std::span{ indices.back() }.subspan(lod.indexOffset, lod.indexCount));
 				}
 
-				// Can't use since it's too large for a single meshlet...
-				//auto bounds = meshopt_computeClusterBounds(assembly.GetIndexStream().data(), assembly.GetIndexStream().size(), positionStream, assembly.GetAttributeCount("POSITION"), sizeof(XMFLOAT3));
+				// Vertices are ordered by first use across every level, full detail first. Every stream is remapped the same way.
+				std::vector<uint32_t> remap;
+				const auto vertexCount = MeshOrder::OptimizeVertexFetch(indices.back(), positionCount, remap);
+				assembly.ForEachVertexStream([&](auto, auto& stream)
+				{
+					using Element = std::remove_reference_t<decltype(stream[0])>;
+
+					VGAssert(stream.size() == positionCount, "Vertex streams have mismatched counts.");
+					auto& buffer = vertices.emplace_back(vertexCount * sizeof(Element));
+					MeshOrder::RemapVertices(buffer.data(), stream.data(), stream.size(), sizeof(Element), remap);
+					stream = std::span{ reinterpret_cast<Element*>(buffer.data()), vertexCount };
+				});
+
+				assembly.AddIndexStream(std::span{ indices.back().data(), indices.back().size() });
+
+				orderAfter += MeshOrder::Analyze(std::span{ indices.back() }.first(lods.back()[0].indexCount), vertexCount, vertexSize);
+				floatExtraSize += vertexCount * (vertexSize - sizeof(XMFLOAT3));
 
-				boundingSpheres.emplace_back(radius);
 				assemblies.emplace_back(std::move(assembly));
-				materialIndices.emplace_back(primitive.material);
+				materialIndices.emplace_back(static_cast<uint32_t>(primitive.material));
 			}
 		}
 
@@ -220,6 +526,369 @@ namespace AssetLoader
 			}
 		}
 
-		return factory.CreateMeshComponent(assemblies, materials, materialIndices, boundingSpheres);
+		VGLog(logAsset, "Reordered '{}' for the GPU: ACMR {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}.", path.filename().generic_wstring(),
+			orderBefore.GetAcmr(), orderAfter.GetAcmr(), orderBefore.GetOverfetch(), orderAfter.GetOverfetch());
+
+		output.mesh = MeshFactory::BuildMeshData(assemblies, materialIndices, bounds, meshlets, lods, settings.vertexQuantization > 0);
+
+		if (settings.vertexQuantization > 0 && floatExtraSize > 0)
+		{
+			const auto extraSize = output.mesh.vertexExtraData.size();
+			VGLog(logAsset, "Quantized vertex extras of '{}': {:.1f} MB -> {:.1f} MB, {:.0f}% saved.", path.filename().generic_wstring(),
+				floatExtraSize / (1024.f * 1024.f), extraSize / (1024.f * 1024.f), 100.f * (1.f - static_cast<float>(extraSize) / floatExtraSize));
+		}
+
+		// Depth-first walk of the scene graph, nodes are emitted before their children.
+		std::vector<std::pair<int, int32_t>> stack;  // Node index, parent index in the output.
+		for (auto it = scene.nodes.rbegin(); it != scene.nodes.rend(); ++it)
+		{
+			stack.emplace_back(*it, -1);
+		}
+
+		while (stack.size() > 0)
+		{
+			const auto [nodeIndex, parentIndex] = stack.back();
+			stack.pop_back();
+
+			const auto& node = model.nodes[nodeIndex];
+			const auto outputIndex = static_cast<int32_t>(output.nodes.size());
+			const auto transform = ConvertNodeTransform(node);
+
+			CookedModel::Node outputNode{
+				.nameOffset = static_cast<uint32_t>(output.names.size()),
+				.nameSize = static_cast<uint32_t>(node.name.size()),
+				.parent = parentIndex,
+				.firstSubset = 0,
+				.subsetCount = 0,
+				.scale = transform.scale,
+				.rotation = transform.rotation,
+				.translation = transform.translation
+			};
+
+			if (node.mesh >= 0)
+			{
+				const auto [first, count] = meshSubsets[node.mesh];
+				outputNode.firstSubset = static_cast<uint32_t>(first);
+				outputNode.subsetCount = static_cast<uint32_t>(count);
+			}
+
+			output.names += node.name;
+			output.nodes.emplace_back(outputNode);
+
+			for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+			{
+				stack.emplace_back(*it, outputIndex);
+			}
+		}
+
+		return output;
+	}
+
+	bool CookModel(const std::filesystem::path& source, const std::filesystem::path& output, const CookedModel::Settings& settings)
+	{
+		VGScopedCPUStat("Cook Model");
+
+		const auto model = ImportModel(source, settings);
+		if (!model)
+		{
+			return false;
+		}
+
+		return CookedModel::Save(output, source, *model);
+	}
+
+	std::unique_ptr<ModelData> ReadModel(const std::filesystem::path& path, const CookedModel::Settings& settings, bool useCooked)
+	{
+		VGScopedCPUStat("Read Model");
+
+		const auto cooked = path.extension() == CookedModel::extension;
+		const auto cookedPath = cooked ? path : CookedModel::GetPath(path);
+		useCooked |= cooked;
+
+		auto data = std::make_unique<ModelData>();
+
+		if (useCooked && data->cooked.Open(cookedPath))
+		{
+			// Cooked models read directly aren't checked against their source.
+			if (auto view = CookedModel::GetView(data->cooked, cooked ? std::filesystem::path{} : path, settings))
+			{
+				data->view = std::move(*view);
+
+				VGLog(logAsset, "Loaded cooked asset '{}'.", cookedPath.filename().generic_wstring());
+
+				return data;
+			}
+
+			data->cooked.Close();
+		}
+
+		auto model = cooked ? std::nullopt : ImportModel(path, settings);
+		if (!model)
+		{
+			if (cooked)
+			{
+				VGLogError(logAsset, "Failed to load cooked asset '{}'.", path.filename().generic_wstring());
+			}
+
+			return nullptr;
+		}
+
+		data->imported = std::move(*model);
+		data->view = CookedModel::GetView(data->imported);
+
+		if (useCooked)
+		{
+			// Later loads map the cooked model instead of importing.
+			CookedModel::Save(cookedPath, path, data->imported);
+		}
+
+		return data;
+	}
+
+	MeshComponent CreateMesh(MeshFactory& factory, std::unique_ptr<ModelData> data, std::vector<MeshNode>* nodes)
+	{
+		VGScopedCPUStat("Create Mesh");
+
+		std::vector<size_t> materials;
+		materials.reserve(data->view.materials.size());
+		for (uint32_t i = 0; i < data->view.materials.size(); ++i)
+		{
+			materials.emplace_back(AssetManager::Get().EnqueueMaterialLoad(*data, i));
+		}
+
+		auto subsets = data->view.subsets;
+		for (auto& subset : subsets)
+		{
+			subset.materialIndex = subset.materialIndex < materials.size() ? materials[subset.materialIndex] : 0;
+		}
+
+		if (nodes)
+		{
+			nodes->reserve(data->view.nodes.size());
+			for (const auto& node : data->view.nodes)
+			{
+				auto& output = nodes->emplace_back();
+				output.name = data->view.names.substr(node.nameOffset, node.nameSize);
+				output.parent = node.parent;
+				output.transform = { node.scale, node.rotation, node.translation };
+				for (uint32_t i = 0; i < node.subsetCount; ++i)
+				{
+					output.subsets.emplace_back(node.firstSubset + i);
+				}
+			}
+		}
+
+		auto result = factory.CreateMeshComponent(data->view.metadata, subsets, data->view.vertexPositionData, data->view.vertexExtraData, data->view.indexData, data->view.meshletData);
+
+		// Materials only read the texture levels, release the imported geometry.
+		data->imported.mesh = {};
+		data->view.subsets = {};
+		data->view.vertexPositionData = {};
+		data->view.vertexExtraData = {};
+		data->view.indexData = {};
+		data->view.meshletData = {};
+
+		if (data->materialQueue.size() > 0)
+		{
+			AssetManager::Get().models.emplace_back(std::move(data));
+		}
+
+		return result;
+	}
+
+	MeshComponent LoadMesh(RenderDevice& device, MeshFactory& factory, const std::filesystem::path& path, std::vector<MeshNode>* nodes)
+	{
+		VGScopedCPUStat("Load Mesh");
+
+		auto data = ReadModel(path, GetImportSettings(), *CvarGet("cookedModels", int) > 0);
+		if (!data)
+		{
+			return {};
+		}
+
+		return CreateMesh(factory, std::move(data), nodes);
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Model Load Benchmark");
+
+		const std::filesystem::path models[] = {
+			Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb",
+			Config::shadersPath / "../Assets/Models/Sponza/glTF/Sponza.gltf",
+			Config::shadersPath / "../Assets/Models/Bistro/Bistro2.gltf"
+		};
+
+		const auto settings = GetImportSettings();
+
+		// Both paths end by copying every byte the upload would into a staging buffer, which faults in the mapped pages. The cooked
+		// model was just written, so it's mapped from the file cache.
+		std::vector<uint8_t> staging;
+		const auto Upload = [&staging](const CookedModel::View& view)
+		{
+			std::vector<std::span<const uint8_t>> blocks = { view.vertexPositionData, view.vertexExtraData, view.indexData,
+				{ reinterpret_cast<const uint8_t*>(view.meshletData.data()), view.meshletData.size_bytes() } };
+			blocks.insert(blocks.end(), view.levels.begin(), view.levels.end());
+
+			size_t offset = 0;
+			for (const auto block : blocks)
+			{
+				std::memcpy(staging.data() + offset, block.data(), block.size());
+				offset += block.size();
+			}
+		};
+
+		const auto Matches = [](const CookedModel::View& left, const CookedModel::View& right)
+		{
+			const auto Equal = [](auto a, auto b)
+			{
+				return a.size_bytes() == b.size_bytes() && std::memcmp(a.data(), b.data(), a.size_bytes()) == 0;
+			};
+
+			bool result = std::memcmp(&left.metadata, &right.metadata, sizeof(VertexMetadata)) == 0 && left.names == right.names;
+			result &= Equal(left.vertexPositionData, right.vertexPositionData) && Equal(left.vertexExtraData, right.vertexExtraData);
+			result &= Equal(left.indexData, right.indexData) && Equal(left.meshletData, right.meshletData);
+			result &= Equal(left.nodes, right.nodes) && Equal(left.materials, right.materials) && Equal(left.textures, right.textures);
+			result &= left.subsets.size() == right.subsets.size() && left.levels.size() == right.levels.size();
+
+			for (size_t i = 0; result && i < left.subsets.size(); ++i)
+			{
+				result &= std::memcmp(&left.subsets[i].localOffset, &right.subsets[i].localOffset, sizeof(PrimitiveOffset)) == 0;
+				result &= left.subsets[i].indices == right.subsets[i].indices && left.subsets[i].meshlets == right.subsets[i].meshlets;
+				result &= left.subsets[i].lodCount == right.subsets[i].lodCount;
+				// Any out of range material means none.
+				result &= std::min(left.subsets[i].materialIndex, left.materials.size()) == std::min(right.subsets[i].materialIndex, right.materials.size());
+			}
+
+			for (size_t i = 0; result && i < left.levels.size(); ++i)
+			{
+				result &= Equal(left.levels[i], right.levels[i]);
+			}
+
+			return result;
+		};
+
+		for (const auto& path : models)
+		{
+			if (!std::filesystem::exists(path))
+			{
+				VGLogWarning(logAsset, "Model load benchmark: '{}' is missing, skipping.", path.filename().generic_wstring());
+				continue;
+			}
+
+			const auto importBegin = std::chrono::high_resolution_clock::now();
+			const auto model = ImportModel(path, settings);
+			if (!model)
+			{
+				continue;
+			}
+			const auto importedView = CookedModel::GetView(*model);
+			const auto importEnd = std::chrono::high_resolution_clock::now();
+
+			size_t uploadSize = model->mesh.vertexPositionData.size() + model->mesh.vertexExtraData.size() + model->mesh.indexData.size() + model->mesh.meshletData.size() * sizeof(MeshletData);
+			for (const auto& level : model->levels)
+			{
+				uploadSize += level.size();
+			}
+			staging.resize(uploadSize);
+
+			const auto importUploadBegin = std::chrono::high_resolution_clock::now();
+			Upload(importedView);
+			const auto importUploadEnd = std::chrono::high_resolution_clock::now();
+
+			const auto cookedPath = Config::engineRootPath / "Cache" / path.filename().replace_extension(CookedModel::extension);
+			std::error_code error;
+			std::filesystem::create_directories(cookedPath.parent_path(), error);
+			if (!CookedModel::Save(cookedPath, path, *model))
+			{
+				continue;
+			}
+
+			const auto mapBegin = std::chrono::high_resolution_clock::now();
+			MappedFile file;
+			file.Open(cookedPath);
+			const auto cookedView = CookedModel::GetView(file, path, settings);
+			const auto mapEnd = std::chrono::high_resolution_clock::now();
+
+			if (!cookedView)
+			{
+				VGLogError(logAsset, "Model load benchmark: failed to map the cooked model of '{}'.", path.filename().generic_wstring());
+				continue;
+			}
+
+			const auto cookedUploadBegin = std::chrono::high_resolution_clock::now();
+			Upload(*cookedView);
+			const auto cookedUploadEnd = std::chrono::high_resolution_clock::now();
+
+			const auto Milliseconds = [](auto begin, auto end) { return std::chrono::duration<double, std::milli>(end - begin).count(); };
+			const auto importTime = Milliseconds(importBegin, importEnd) + Milliseconds(importUploadBegin, importUploadEnd);
+			const auto cookedTime = Milliseconds(mapBegin, mapEnd) + Milliseconds(cookedUploadBegin, cookedUploadEnd);
+
+			VGLog(logAsset, "Model load benchmark ({}): {:.1f} MB uploaded, {:.1f} MB cooked, cooked data {}.", path.filename().generic_wstring(),
+				uploadSize / (1024.0 * 1024.0), file.GetData().size() / (1024.0 * 1024.0), Matches(importedView, *cookedView) ? VGText("matches the import") : VGText("DIFFERS from the import"));
+			VGLog(logAsset, "  Import: {:.1f} ms parse and process, {:.1f} ms upload copy.", Milliseconds(importBegin, importEnd), Milliseconds(importUploadBegin, importUploadEnd));
+			VGLog(logAsset, "  Cooked: {:.3f} ms map, {:.1f} ms upload copy, {:.1f}x faster.", Milliseconds(mapBegin, mapEnd), Milliseconds(cookedUploadBegin, cookedUploadEnd), importTime / cookedTime);
+
+			file.Close();
+			std::filesystem::remove(cookedPath, error);
+		}
+	}
+
+	void BenchmarkParallel()
+	{
+		VGScopedCPUStat("Parallel Model Load Benchmark");
+
+		std::vector<std::filesystem::path> models;
+		for (const auto& path : {
+			Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb",
+			Config::shadersPath / "../Assets/Models/Sponza/glTF/Sponza.gltf",
+			Config::shadersPath / "../Assets/Models/Bistro/Bistro2.gltf" })
+		{
+			if (std::filesystem::exists(path))
+			{
+				models.emplace_back(path);
+			}
+
+			else
+			{
+				VGLogWarning(logAsset, "Parallel model load benchmark: '{}' is missing, skipping.", path.filename().generic_wstring());
+			}
+		}
+
+		if (models.size() == 0)
+		{
+			return;
+		}
+
+		// Imports without cooking, which is the work asynchronous loads move off the main thread.
+		const auto settings = GetImportSettings();
+
+		const auto serialBegin = std::chrono::high_resolution_clock::now();
+		size_t serialLoaded = 0;
+		for (const auto& path : models)
+		{
+			serialLoaded += ReadModel(path, settings, false) != nullptr;
+		}
+		const auto serialEnd = std::chrono::high_resolution_clock::now();
+
+		const auto parallelBegin = std::chrono::high_resolution_clock::now();
+		std::vector<std::future<std::unique_ptr<ModelData>>> pending;
+		for (const auto& path : models)
+		{
+			pending.emplace_back(std::async(std::launch::async, &ReadModel, path, settings, false));
+		}
+		size_t parallelLoaded = 0;
+		for (auto& future : pending)
+		{
+			parallelLoaded += future.get() != nullptr;
+		}
+		const auto parallelEnd = std::chrono::high_resolution_clock::now();
+
+		const auto serialTime = std::chrono::duration<double, std::milli>(serialEnd - serialBegin).count();
+		const auto parallelTime = std::chrono::duration<double, std::milli>(parallelEnd - parallelBegin).count();
+
+		VGLog(logAsset, "Parallel model load benchmark ({} models, {} hardware threads):", models.size(), std::thread::hardware_concurrency());
+		VGLog(logAsset, "  Serial: {:.1f} ms, {} loaded.", serialTime, serialLoaded);
+		VGLog(logAsset, "  Parallel: {:.1f} ms, {} loaded, {:.2f}x faster.", parallelTime, parallelLoaded, serialTime / parallelTime);
 	}
 }
\ No newline at end of file
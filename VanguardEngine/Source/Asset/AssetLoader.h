@@ -3,13 +3,60 @@
 #pragma once
 
 #include <Rendering/RenderComponents.h>
+#include <Core/CoreComponents.h>
+#include <Asset/CookedModel.h>
+#include <Utility/MappedFile.h>
 
 #include <filesystem>
+#include <optional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <string>
 
 class RenderDevice;
 class MeshFactory;
 
 namespace AssetLoader
 {
-	MeshComponent LoadMesh(RenderDevice& device, MeshFactory& factory, const std::filesystem::path& path);
+	// Node of a model's scene graph, parents always precede their children.
+	struct MeshNode
+	{
+		std::string name;
+		int32_t parent;  // Index into the node list, -1 for scene roots.
+		TransformComponent transform;  // Relative to the parent.
+		std::vector<size_t> subsets;  // Indices into the loaded mesh component's subsets.
+	};
+
+	// A read model, with materials still queued once it's created. The view references the imported model or the mapped cooked
+	// model, so the data is never moved.
+	struct ModelData
+	{
+		CookedModel::Model imported;
+		MappedFile cooked;
+		CookedModel::View view;
+		std::queue<std::pair<uint32_t, size_t>> materialQueue;  // Material index in the model, material buffer index.
+	};
+
+	// Import settings from the cvars.
+	CookedModel::Settings GetImportSettings();
+	// Parses and processes a glTF model, doesn't need a device.
+	std::optional<CookedModel::Model> ImportModel(const std::filesystem::path& path, const CookedModel::Settings& settings);
+	bool CookModel(const std::filesystem::path& source, const std::filesystem::path& output, const CookedModel::Settings& settings);
+
+	// Maps the cooked model of glTF sources if it's up to date, otherwise imports the source, and cooks it if useCooked is set.
+	// Cooked models can be read directly. Doesn't touch the device or the cvars, so it's safe on worker threads. Null on failure.
+	std::unique_ptr<ModelData> ReadModel(const std::filesystem::path& path, const CookedModel::Settings& settings, bool useCooked);
+	// Main thread only. Uploads the mesh and hands the data to the asset manager to load the materials. If nodes is provided,
+	// it's filled with the scene graph of the default scene.
+	MeshComponent CreateMesh(MeshFactory& factory, std::unique_ptr<ModelData> data, std::vector<MeshNode>* nodes = nullptr);
+
+	// Blocking ReadModel and CreateMesh, with settings from the cvars.
+	MeshComponent LoadMesh(RenderDevice& device, MeshFactory& factory, const std::filesystem::path& path, std::vector<MeshNode>* nodes = nullptr);
+
+	// Headless time to upload ready data of the engine's models, importing against mapping the cooked model.
+	void Benchmark();
+	// Headless time to import the engine's models one after another, against all at once on worker threads.
+	void BenchmarkParallel();
 }
\ No newline at end of file
@@ -5,76 +5,198 @@
 #include <Rendering/Renderer.h>
 #include <Rendering/ShaderStructs.h>
 
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
 MeshComponent AssetManager::LoadModel(const std::filesystem::path& path)
 {
 	return AssetLoader::LoadMesh(*device, *Renderer::Get().meshFactory, path);
 }
 
-size_t AssetManager::EnqueueMaterialLoad(const tinygltf::Material& material)
+entt::entity AssetManager::LoadModelHierarchy(entt::registry& registry, const std::filesystem::path& path, const TransformComponent& transform)
 {
-	VGAssert(models.size() > 0, "No models available to queue materials for.");
+	std::vector<AssetLoader::MeshNode> nodes;
+	const auto mesh = AssetLoader::LoadMesh(*device, *Renderer::Get().meshFactory, path, &nodes);
 
-	const auto index = Renderer::Get().materialFactory->Create();
+	const auto root = registry.create();
+	registry.emplace<NameComponent>(root, path.stem().generic_string());
+	registry.emplace<TransformComponent>(root, transform);
+
+	CreateHierarchy(registry, root, mesh, nodes);
+
+	return root;
+}
+
+ModelLoadHandle AssetManager::LoadModelAsync(entt::registry& registry, entt::entity entity, const std::filesystem::path& path, bool hierarchy)
+{
+	auto state = std::make_shared<ModelLoadState>(ModelLoadState::Pending);
 
-	if (newModel)
+	auto iterator = std::find_if(pendingLoads.begin(), pendingLoads.end(), [&path](const auto& load) { return load.path == path; });
+	if (iterator == pendingLoads.end())
 	{
-		modelMaterialQueues.emplace_back();
-		newModel = false;
+		// Settings are read here, cvars aren't safe to read from the worker.
+		auto& load = pendingLoads.emplace_back();
+		load.path = path;
+		load.data = std::async(std::launch::async, &AssetLoader::ReadModel, path, AssetLoader::GetImportSettings(), *CvarGet("cookedModels", int) > 0);
+		iterator = std::prev(pendingLoads.end());
 	}
-	modelMaterialQueues.back().emplace(std::make_pair(material, index));
 
-	return index;
+	iterator->requests.emplace_back(ModelRequest{ &registry, entity, hierarchy, state });
+
+	return state;
 }
 
-void AssetManager::Update()
+void AssetManager::CreateHierarchy(entt::registry& registry, entt::entity root, const MeshComponent& mesh, const std::vector<AssetLoader::MeshNode>& nodes)
 {
-	tinygltf::Model* model = nullptr;
-	MaterialQueue* queue = nullptr;
+	std::vector<entt::entity> nodeEntities;
+	nodeEntities.reserve(nodes.size());
 
-	while (models.size() > 0)
+	for (const auto& node : nodes)
 	{
-		queue = &modelMaterialQueues.front();
-		if (queue->size() == 0)
+		const auto entity = registry.create();
+		registry.emplace<NameComponent>(entity, node.name);
+		registry.emplace<TransformComponent>(entity, node.transform);
+		registry.emplace<RelationshipComponent>(entity, node.parent >= 0 ? nodeEntities[node.parent] : root);
+
+		if (node.subsets.size() > 0)
 		{
-			models.pop_front();
-			modelMaterialQueues.pop_front();
+			// Nodes share the mesh allocation, each only draws the subsets of its own glTF mesh.
+			auto& nodeMesh = registry.emplace<MeshComponent>(entity);
+			nodeMesh.globalOffset = mesh.globalOffset;
+			nodeMesh.metadata = mesh.metadata;
+			nodeMesh.subsets.reserve(node.subsets.size());
+
+			for (const auto subset : node.subsets)
+			{
+				nodeMesh.subsets.emplace_back(mesh.subsets[subset]);
+			}
 		}
 
-		else
+		nodeEntities.emplace_back(entity);
+	}
+}
+
+void AssetManager::UpdateLoads()
+{
+	VGScopedCPUStat("Update Model Loads");
+
+	// Create at most one model per frame, like materials, to bound the upload.
+	const auto iterator = std::find_if(pendingLoads.begin(), pendingLoads.end(), [](const auto& load)
+	{
+		return load.data.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+	});
+
+	if (iterator == pendingLoads.end())
+	{
+		return;
+	}
+
+	auto data = iterator->data.get();
+	const auto loaded = data != nullptr;
+	if (!loaded)
+	{
+		VGLogError(logAsset, "Failed to load model '{}'.", iterator->path.generic_wstring());
+	}
+
+	else
+	{
+		std::vector<AssetLoader::MeshNode> nodes;
+		const auto mesh = AssetLoader::CreateMesh(*Renderer::Get().meshFactory, std::move(data), &nodes);
+
+		for (const auto& request : iterator->requests)
 		{
-			model = &models.front();
-			break;
+			// The entity may have been destroyed while the model was loading.
+			if (!request.registry->valid(request.entity))
+			{
+				continue;
+			}
+
+			if (request.hierarchy)
+			{
+				CreateHierarchy(*request.registry, request.entity, mesh, nodes);
+			}
+
+			else
+			{
+				request.registry->emplace_or_replace<MeshComponent>(request.entity, mesh);
+			}
 		}
 	}
 
-	if (!model)
+	for (const auto& request : iterator->requests)
+	{
+		*request.state = loaded ? ModelLoadState::Loaded : ModelLoadState::Failed;
+	}
+
+	pendingLoads.erase(iterator);
+}
+
+size_t AssetManager::EnqueueMaterialLoad(AssetLoader::ModelData& model, uint32_t material)
+{
+	const auto index = Renderer::Get().materialFactory->Create();
+
+	model.materialQueue.emplace(material, index);
+
+	return index;
+}
+
+void AssetManager::Update()
+{
+	UpdateLoads();
+
+	while (models.size() > 0 && models.front()->materialQueue.size() == 0)
+	{
+		models.pop_front();
+	}
+
+	if (models.size() == 0)
 		return;
-	
-	auto [material, bufferIndex] = queue->front();
-	queue->pop();
+
+	auto& model = *models.front();
+	const auto [materialIndex, bufferIndex] = model.materialQueue.front();
+	model.materialQueue.pop();
+
+	const auto& material = model.view.materials[materialIndex];
 
 	// Create a single material and upload it to the GPU.
 
-	const auto CreateTexture = [&](int index, std::wstring_view name, DXGI_FORMAT format, bool mipmap) -> uint32_t
+	const auto CreateTexture = [&](int32_t index, std::wstring_view name, DXGI_FORMAT format, bool mipmap) -> uint32_t
 	{
 		if (index < 0)
 		{
 			return 0;
 		}
 
-		const auto& texture = model->images[model->textures[index].source];
+		const auto& texture = model.view.textures[index];
+		const auto levels = std::span{ model.view.levels }.subspan(texture.firstLevel, texture.levelCount);
+		if (levels.size() == 0)
+		{
+			return 0;
+		}
+
+		// Compressed at import, block compressed mips can't be generated on the GPU.
+		const auto compressed = texture.format != DXGI_FORMAT_UNKNOWN;
+		const auto mipmapped = mipmap && (levels.size() > 1 || !compressed);
 
 		TextureDescription description{
 			.bindFlags = BindFlag::ShaderResource,
 			.accessFlags = AccessFlag::CPUWrite,
-			.width = (uint32_t)texture.width,
-			.height = (uint32_t)texture.height,
-			.format = format,
-			.mipMapping = mipmap
+			.width = texture.width,
+			.height = texture.height,
+			.format = compressed ? texture.format : format,
+			.mipMapping = mipmapped
 		};
 		auto resource = device->GetResourceManager().Create(description, name);
-		device->GetResourceManager().Write(resource, texture.image);
-		if (mipmap)
+
+		// Upload the chain from import, if there is one.
+		const auto uploadLevels = mipmapped ? levels.size() : 1;
+		for (uint32_t i = 0; i < uploadLevels; ++i)
+		{
+			device->GetResourceManager().Write(resource, levels[i], i);
+		}
+
+		if (mipmapped && levels.size() == 1)
 		{
 			device->GetResourceManager().GenerateMipmaps(device->GetDirectList(), resource);
 		}
@@ -85,20 +207,15 @@ void AssetManager::Update()
 
 	MaterialData materialData;
 	// #TODO: Include asset name in texture name.
-	materialData.baseColor = CreateTexture(material.pbrMetallicRoughness.baseColorTexture.index, VGText("Base color asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, true);
-	materialData.metallicRoughness = CreateTexture(material.pbrMetallicRoughness.metallicRoughnessTexture.index, VGText("Metallic roughness asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM, true);
-	materialData.normal = CreateTexture(material.normalTexture.index, VGText("Normal asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM, true);
-	materialData.occlusion = CreateTexture(material.occlusionTexture.index, VGText("Occlusion asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM, false);
-	materialData.emissive = CreateTexture(material.emissiveTexture.index, VGText("Emissive asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, false);
-	materialData.emissiveFactor.x = static_cast<float>(material.emissiveFactor[0]);
-	materialData.emissiveFactor.y = static_cast<float>(material.emissiveFactor[1]);
-	materialData.emissiveFactor.z = static_cast<float>(material.emissiveFactor[2]);
-	materialData.baseColorFactor.x = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[0]);
-	materialData.baseColorFactor.y = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[1]);
-	materialData.baseColorFactor.z = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[2]);
-	materialData.baseColorFactor.w = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[3]);
-	materialData.metallicFactor = static_cast<float>(material.pbrMetallicRoughness.metallicFactor);
-	materialData.roughnessFactor = static_cast<float>(material.pbrMetallicRoughness.roughnessFactor);
+	materialData.baseColor = CreateTexture(material.baseColor, VGText("Base color asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, true);
+	materialData.metallicRoughness = CreateTexture(material.metallicRoughness, VGText("Metallic roughness asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM, true);
+	materialData.normal = CreateTexture(material.normal, VGText("Normal asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM, true);
+	materialData.occlusion = CreateTexture(material.occlusion, VGText("Occlusion asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM, false);
+	materialData.emissive = CreateTexture(material.emissive, VGText("Emissive asset texture"), DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, false);
+	materialData.emissiveFactor = material.emissiveFactor;
+	materialData.baseColorFactor = material.baseColorFactor;
+	materialData.metallicFactor = material.metallicFactor;
+	materialData.roughnessFactor = material.roughnessFactor;
 
 	const auto materialBuffer = Renderer::Get().materialFactory->materialBuffer;
 
@@ -5,37 +5,78 @@
 #include <Utility/Singleton.h>
 #include <Rendering/RenderComponents.h>
 #include <Rendering/ResourceHandle.h>
-
-#include <tiny_gltf.h>
+#include <Core/CoreComponents.h>
+#include <Asset/AssetLoader.h>
 
 #include <filesystem>
+#include <future>
 #include <list>
-#include <queue>
-#include <utility>
+#include <memory>
+#include <vector>
 
 class RenderDevice;
 
-class AssetManager : public Singleton<AssetManager>
+enum class ModelLoadState
 {
-	using MaterialQueue = std::queue<std::pair<tinygltf::Material, size_t>>;
+	Pending,
+	Loaded,
+	Failed
+};
+
+// Shared with the load until it completes, so states are freed once neither side needs them.
+using ModelLoadHandle = std::shared_ptr<const ModelLoadState>;
 
+class AssetManager : public Singleton<AssetManager>
+{
 private:
+	// Entity waiting on an asynchronous load.
+	struct ModelRequest
+	{
+		entt::registry* registry;
+		entt::entity entity;
+		bool hierarchy;
+		std::shared_ptr<ModelLoadState> state;
+	};
+
+	// Model read on a worker thread, created on the main thread once it's ready.
+	struct ModelLoad
+	{
+		std::filesystem::path path;
+		std::future<std::unique_ptr<AssetLoader::ModelData>> data;
+		std::vector<ModelRequest> requests;
+	};
+
 	RenderDevice* device;
-	std::list<MaterialQueue> modelMaterialQueues;
+
+	std::list<ModelLoad> pendingLoads;
 
 public:
 	// #TODO: Poor solution, should rework this.
-	std::list<tinygltf::Model> models;
-	bool newModel = false;
+	std::list<std::unique_ptr<AssetLoader::ModelData>> models;
+
+private:
+	ModelLoadHandle LoadModelAsync(entt::registry& registry, entt::entity entity, const std::filesystem::path& path, bool hierarchy);
+	void CreateHierarchy(entt::registry& registry, entt::entity root, const MeshComponent& mesh, const std::vector<AssetLoader::MeshNode>& nodes);
+	void UpdateLoads();
 
 public:
 	void Initialize(RenderDevice* inDevice) { device = inDevice; }
 
 	// Blocking load of the mesh data, will load materials over time.
 	MeshComponent LoadModel(const std::filesystem::path& path);
+	// Same as LoadModel, but mirrors the model's scene graph with one entity per node. Returns the root entity, which owns the given transform.
+	entt::entity LoadModelHierarchy(entt::registry& registry, const std::filesystem::path& path, const TransformComponent& transform);
+
+	// Reads the model on a worker thread, the mesh is uploaded and attached to the entity in a later Update. Loads of a model
+	// that's still pending share its data and mesh, so models are only read once.
+	ModelLoadHandle LoadModelAsync(entt::registry& registry, entt::entity entity, const std::filesystem::path& path) { return LoadModelAsync(registry, entity, path, false); }
+	// Asynchronous LoadModelHierarchy, the node entities are created under the given root once the model is ready.
+	ModelLoadHandle LoadModelHierarchyAsync(entt::registry& registry, entt::entity root, const std::filesystem::path& path) { return LoadModelAsync(registry, root, path, true); }
+	ModelLoadState GetLoadState(const ModelLoadHandle& handle) const { return *handle; }
 
-	// Instead of loading all model materials in one frame, stagger loading out over multiple frames.
-	size_t EnqueueMaterialLoad(const tinygltf::Material& material);
+	// Instead of loading all model materials in one frame, stagger loading out over multiple frames. Queues a material of the
+	// model, returns its material buffer index.
+	size_t EnqueueMaterialLoad(AssetLoader::ModelData& model, uint32_t material);
 
 	void Update();
 };
\ No newline at end of file
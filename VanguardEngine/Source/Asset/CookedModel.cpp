@@ -0,0 +1,327 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Asset/CookedModel.h>
+#include <Utility/AlignedSize.h>
+
+#include <fstream>
+#include <limits>
+#include <cstring>
+
+namespace CookedModel
+{
+	namespace
+	{
+		constexpr uint32_t magic = 0x444D4756;  // "VGMD"
+		constexpr size_t blockAlignment = 16;
+
+		// In bytes, from the start of the file.
+		struct Block
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		// Texture level, relative to the texel block.
+		struct Level
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		// Offsets are relative to the start of each mesh block, materials are -1 for none.
+		struct Subset
+		{
+			uint64_t indexOffset;
+			uint64_t positionOffset;
+			uint64_t extraOffset;
+			uint64_t meshletOffset;  // In meshlets.
+			uint32_t indexCount;
+			uint32_t meshletCount;
+			int32_t material;
+			uint32_t lodCount;
+			MeshLod lods[maxMeshLods];
+			BoundingVolume bounds;
+		};
+
+		// Followed by the blocks, in order.
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			Settings settings;
+			VertexMetadata metadata;
+			Block subsets;
+			Block nodes;
+			Block names;
+			Block materials;
+			Block textures;
+			Block levels;
+			Block texels;
+			Block vertexPositions;
+			Block vertexExtras;
+			Block indices;
+			Block meshlets;
+		};
+
+		// Size and last write time, zero if the source is missing.
+		std::pair<uint64_t, int64_t> GetSourceStamp(const std::filesystem::path& source)
+		{
+			std::error_code error;
+			const auto size = std::filesystem::file_size(source, error);
+			if (error)
+			{
+				return { 0, 0 };
+			}
+
+			const auto time = std::filesystem::last_write_time(source, error);
+			if (error)
+			{
+				return { 0, 0 };
+			}
+
+			return { size, time.time_since_epoch().count() };
+		}
+
+		template <typename T>
+		std::span<const T> GetBlock(std::span<const uint8_t> file, const Block& block, bool& valid)
+		{
+			if (block.offset > file.size() || block.size > file.size() - block.offset || block.size % sizeof(T) != 0 || block.offset % alignof(T) != 0)
+			{
+				valid = false;
+				return {};
+			}
+
+			return { reinterpret_cast<const T*>(file.data() + block.offset), block.size / sizeof(T) };
+		}
+	}
+
+	std::filesystem::path GetPath(const std::filesystem::path& source)
+	{
+		auto result = source;
+		result.replace_extension(extension);
+
+		return result;
+	}
+
+	View GetView(const Model& model)
+	{
+		View result;
+		result.metadata = model.mesh.metadata;
+		result.subsets = model.mesh.subsets;
+		result.nodes = model.nodes;
+		result.names = model.names;
+		result.materials = model.materials;
+		result.textures = model.textures;
+		result.levels.assign(model.levels.begin(), model.levels.end());
+		result.vertexPositionData = model.mesh.vertexPositionData;
+		result.vertexExtraData = model.mesh.vertexExtraData;
+		result.indexData = model.mesh.indexData;
+		result.meshletData = model.mesh.meshletData;
+
+		return result;
+	}
+
+	std::optional<View> GetView(const MappedFile& file, const std::filesystem::path& source, const Settings& settings)
+	{
+		VGScopedCPUStat("Get Cooked Model View");
+
+		const auto data = file.GetData();
+		if (data.size() < sizeof(Header))
+		{
+			VGLogWarning(logAsset, "Cooked model is truncated.");
+
+			return std::nullopt;
+		}
+
+		const auto& header = *reinterpret_cast<const Header*>(data.data());
+		if (header.magic != magic || header.version != version)
+		{
+			VGLog(logAsset, "Cooked model is out of date.");
+
+			return std::nullopt;
+		}
+
+		if (!source.empty())
+		{
+			const auto [sourceSize, sourceTime] = GetSourceStamp(source);
+			if (header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.settings != settings)
+			{
+				VGLog(logAsset, "Cooked model of '{}' is out of date.", source.filename().generic_wstring());
+
+				return std::nullopt;
+			}
+		}
+
+		bool valid = true;
+		const auto subsets = GetBlock<Subset>(data, header.subsets, valid);
+		const auto levels = GetBlock<Level>(data, header.levels, valid);
+		const auto names = GetBlock<char>(data, header.names, valid);
+		const auto texels = GetBlock<uint8_t>(data, header.texels, valid);
+
+		View result;
+		result.metadata = header.metadata;
+		result.nodes = GetBlock<Node>(data, header.nodes, valid);
+		result.names = { names.data(), names.size() };
+		result.materials = GetBlock<Material>(data, header.materials, valid);
+		result.textures = GetBlock<Texture>(data, header.textures, valid);
+		result.vertexPositionData = GetBlock<uint8_t>(data, header.vertexPositions, valid);
+		result.vertexExtraData = GetBlock<uint8_t>(data, header.vertexExtras, valid);
+		result.indexData = GetBlock<uint8_t>(data, header.indices, valid);
+		result.meshletData = GetBlock<MeshletData>(data, header.meshlets, valid);
+
+		for (const auto& level : levels)
+		{
+			valid &= level.offset <= texels.size() && level.size <= texels.size() - level.offset;
+			if (valid)
+			{
+				result.levels.emplace_back(texels.subspan(level.offset, level.size));
+			}
+		}
+
+		for (const auto& node : result.nodes)
+		{
+			valid &= node.nameOffset + (uint64_t)node.nameSize <= result.names.size() && node.firstSubset + (uint64_t)node.subsetCount <= subsets.size();
+		}
+
+		for (const auto& texture : result.textures)
+		{
+			valid &= texture.firstLevel + (uint64_t)texture.levelCount <= levels.size();
+		}
+
+		for (const auto& material : result.materials)
+		{
+			for (const auto index : { material.baseColor, material.metallicRoughness, material.normal, material.occlusion, material.emissive })
+			{
+				valid &= index < (int64_t)result.textures.size();
+			}
+		}
+
+		if (!valid)
+		{
+			VGLogWarning(logAsset, "Cooked model is truncated or corrupt.");
+
+			return std::nullopt;
+		}
+
+		result.subsets.reserve(subsets.size());
+		for (const auto& subset : subsets)
+		{
+			auto& output = result.subsets.emplace_back();
+			output.localOffset = { subset.indexOffset, subset.positionOffset, subset.extraOffset, subset.meshletOffset };
+			output.indices = subset.indexCount;
+			output.materialIndex = subset.material >= 0 ? static_cast<size_t>(subset.material) : std::numeric_limits<size_t>::max();
+			output.bounds = subset.bounds;
+			output.meshlets = subset.meshletCount;
+			output.lodCount = std::min<size_t>(subset.lodCount, maxMeshLods);
+			std::copy(subset.lods, subset.lods + output.lodCount, output.lods.begin());
+		}
+
+		return result;
+	}
+
+	bool Save(const std::filesystem::path& path, const std::filesystem::path& source, const Model& model)
+	{
+		VGScopedCPUStat("Save Cooked Model");
+
+		std::vector<Subset> subsets;
+		subsets.reserve(model.mesh.subsets.size());
+		for (const auto& subset : model.mesh.subsets)
+		{
+			auto& output = subsets.emplace_back();
+			output.indexOffset = subset.localOffset.index;
+			output.positionOffset = subset.localOffset.position;
+			output.extraOffset = subset.localOffset.extra;
+			output.meshletOffset = subset.localOffset.meshlet;
+			output.indexCount = static_cast<uint32_t>(subset.indices);
+			output.meshletCount = static_cast<uint32_t>(subset.meshlets);
+			output.material = subset.materialIndex < model.materials.size() ? static_cast<int32_t>(subset.materialIndex) : -1;
+			output.lodCount = static_cast<uint32_t>(subset.lodCount);
+			std::copy(subset.lods.begin(), subset.lods.end(), output.lods);
+			output.bounds = subset.bounds;
+		}
+
+		std::vector<Level> levels;
+		levels.reserve(model.levels.size());
+		uint64_t texelSize = 0;
+		for (const auto& level : model.levels)
+		{
+			levels.push_back({ texelSize, level.size() });
+			texelSize = AlignedSize(texelSize + level.size(), blockAlignment);
+		}
+
+		const auto [sourceSize, sourceTime] = GetSourceStamp(source);
+
+		Header header{};
+		header.magic = magic;
+		header.version = version;
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+		header.settings = model.settings;
+		header.metadata = model.mesh.metadata;
+
+		uint64_t offset = sizeof(Header);
+		const auto Place = [&offset](Block& block, uint64_t size)
+		{
+			offset = AlignedSize(offset, blockAlignment);
+			block = { offset, size };
+			offset += size;
+		};
+
+		Place(header.subsets, subsets.size() * sizeof(Subset));
+		Place(header.nodes, model.nodes.size() * sizeof(Node));
+		Place(header.names, model.names.size());
+		Place(header.materials, model.materials.size() * sizeof(Material));
+		Place(header.textures, model.textures.size() * sizeof(Texture));
+		Place(header.levels, levels.size() * sizeof(Level));
+		Place(header.texels, texelSize);
+		Place(header.vertexPositions, model.mesh.vertexPositionData.size());
+		Place(header.vertexExtras, model.mesh.vertexExtraData.size());
+		Place(header.indices, model.mesh.indexData.size());
+		Place(header.meshlets, model.mesh.meshletData.size() * sizeof(MeshletData));
+
+		std::ofstream stream{ path, std::ios::binary | std::ios::trunc };
+		if (!stream.is_open())
+		{
+			VGLogWarning(logAsset, "Failed to open cooked model '{}' for writing.", path.generic_wstring());
+
+			return false;
+		}
+
+		uint64_t position = 0;
+		const auto Write = [&](uint64_t target, const void* source, size_t size)
+		{
+			static constexpr char padding[blockAlignment] = {};
+			stream.write(padding, target - position);
+			stream.write(static_cast<const char*>(source), size);
+			position = target + size;
+		};
+
+		Write(0, &header, sizeof(header));
+		Write(header.subsets.offset, subsets.data(), header.subsets.size);
+		Write(header.nodes.offset, model.nodes.data(), header.nodes.size);
+		Write(header.names.offset, model.names.data(), header.names.size);
+		Write(header.materials.offset, model.materials.data(), header.materials.size);
+		Write(header.textures.offset, model.textures.data(), header.textures.size);
+		Write(header.levels.offset, levels.data(), header.levels.size);
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			Write(header.texels.offset + levels[i].offset, model.levels[i].data(), levels[i].size);
+		}
+		Write(header.texels.offset + header.texels.size, nullptr, 0);  // Pad out the last level.
+		Write(header.vertexPositions.offset, model.mesh.vertexPositionData.data(), header.vertexPositions.size);
+		Write(header.vertexExtras.offset, model.mesh.vertexExtraData.data(), header.vertexExtras.size);
+		Write(header.indices.offset, model.mesh.indexData.data(), header.indices.size);
+		Write(header.meshlets.offset, model.mesh.meshletData.data(), header.meshlets.size);
+
+		if (!stream)
+		{
+			VGLogWarning(logAsset, "Failed to write cooked model '{}'.", path.generic_wstring());
+
+			return false;
+		}
+
+		return true;
+	}
+}
\ No newline at end of file
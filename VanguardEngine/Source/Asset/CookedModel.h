@@ -0,0 +1,114 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/RenderComponents.h>
+#include <Rendering/ShaderStructs.h>
+#include <Rendering/MeshFactory.h>
+#include <Utility/MappedFile.h>
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Import output of a model, stored so that loading is a file mapping. The vertex position, vertex extra, index and meshlet blocks
+// are the mesh factory's layout byte for byte, and texture levels are stored as they're uploaded, so loads hand spans of the
+// mapping straight to the upload. Models are cooked next to their source when they're imported, or offline with -cookModel.
+namespace CookedModel
+{
+	constexpr uint32_t version = 3;  // Bump when the import or the mesh buffer layout changes.
+	inline const std::filesystem::path extension{ ".vgmodel" };
+
+	// Import settings, cooked models are only loaded if they were cooked with the current settings. Defaults match the cvars.
+	struct Settings
+	{
+		int32_t textureMipFilter = 2;
+		int32_t textureCompression = 2;
+		uint32_t lodLevels = 4;
+		float lodBaseError = 0.01f;
+		int32_t vertexQuantization = 1;
+
+		bool operator==(const Settings&) const = default;
+	};
+
+	// Node of the default scene's graph, parents precede their children.
+	struct Node
+	{
+		uint32_t nameOffset;  // Into the names.
+		uint32_t nameSize;
+		int32_t parent;  // -1 for scene roots.
+		uint32_t firstSubset;  // Subsets of the node's glTF mesh.
+		uint32_t subsetCount;
+		XMFLOAT3 scale;  // Relative to the parent.
+		XMFLOAT3 rotation;
+		XMFLOAT3 translation;
+	};
+
+	// Texture indices are into the model's textures, -1 if the slot is unused.
+	struct Material
+	{
+		int32_t baseColor;
+		int32_t metallicRoughness;
+		int32_t normal;
+		int32_t occlusion;
+		int32_t emissive;
+		XMFLOAT4 baseColorFactor;
+		XMFLOAT3 emissiveFactor;
+		float metallicFactor;
+		float roughnessFactor;
+	};
+
+	// Levels start at the base. Uncompressed textures are R8G8B8A8 in the color space of the material slot, mipmapped slots
+	// generate the chain on the GPU if only the base is stored.
+	struct Texture
+	{
+		uint32_t width;
+		uint32_t height;
+		DXGI_FORMAT format;  // Unknown if uncompressed.
+		uint32_t firstLevel;  // Into the model's levels.
+		uint32_t levelCount;
+	};
+
+	// Owned import output. Subset material indices are into the materials, out of range for none.
+	struct Model
+	{
+		Settings settings;
+		MeshData mesh;
+		std::vector<Node> nodes;
+		std::string names;
+		std::vector<Material> materials;
+		std::vector<Texture> textures;
+		std::vector<std::vector<uint8_t>> levels;  // Tightly packed rows, or rows of blocks.
+	};
+
+	// Model data referencing an owned model or a mapped cooked model, which must outlive the view.
+	struct View
+	{
+		VertexMetadata metadata;
+		std::vector<MeshComponent::Subset> subsets;
+		std::span<const Node> nodes;
+		std::string_view names;
+		std::span<const Material> materials;
+		std::span<const Texture> textures;
+		std::vector<std::span<const uint8_t>> levels;
+		std::span<const uint8_t> vertexPositionData;
+		std::span<const uint8_t> vertexExtraData;
+		std::span<const uint8_t> indexData;
+		std::span<const MeshletData> meshletData;
+	};
+
+	// Sibling of the source with the cooked extension.
+	std::filesystem::path GetPath(const std::filesystem::path& source);
+
+	View GetView(const Model& model);
+	// Fails if the file isn't a cooked model of this version or is truncated. If a source is given, also fails if the model was
+	// cooked from a different version of the source or with different settings. Table ranges are checked, contents are trusted.
+	std::optional<View> GetView(const MappedFile& file, const std::filesystem::path& source, const Settings& settings);
+
+	bool Save(const std::filesystem::path& path, const std::filesystem::path& source, const Model& model);
+}
\ No newline at end of file
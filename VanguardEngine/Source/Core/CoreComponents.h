@@ -3,6 +3,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <entt/entt.hpp>
 
 #include <string>
 
@@ -20,5 +21,18 @@ struct TransformComponent
 	XMFLOAT3 translation{ 0.f, 0.f, 0.f };
 };
 
+// Places the entity's transform in the space of its parent. Change the parent through the registry (emplace, replace, patch)
+// so that the transform hierarchy is notified and rebuilt.
+struct RelationshipComponent
+{
+	entt::entity parent = entt::null;
+};
+
+// Written by the transform system for every entity in a hierarchy, read-only for everything else.
+struct WorldTransformComponent
+{
+	XMMATRIX worldMatrix;
+};
+
 // Empty for now, used to tag entities that are being controlled.
 struct ControlComponent {};
\ No newline at end of file
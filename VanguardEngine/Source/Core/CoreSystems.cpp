@@ -2,6 +2,7 @@
 
 #include <Core/CoreSystems.h>
 #include <Core/CoreComponents.h>
+#include <Core/TransformHierarchy.h>
 #include <Rendering/Renderer.h>
 #include <Window/WindowFrame.h>
 
@@ -29,4 +30,17 @@ void ControlSystem::Update(entt::registry& registry)
 		Renderer::Get().window->RestrainCursor(CursorRestraint::None);
 		Renderer::Get().window->ShowCursor(true);
 	}
+}
+
+void TransformSystem::Update(entt::registry& registry)
+{
+	VGScopedCPUStat("Transform System");
+
+	auto* hierarchy = registry.try_ctx<TransformHierarchy>();
+	if (!hierarchy)
+	{
+		hierarchy = &registry.set<TransformHierarchy>(registry);
+	}
+
+	hierarchy->Update(registry);
 }
\ No newline at end of file
@@ -5,6 +5,11 @@
 #include <entt/entt.hpp>
 
 struct ControlSystem
+{
+	static void Update(entt::registry& registry);
+};
+
+struct TransformSystem
 {
 	static void Update(entt::registry& registry);
 };
\ No newline at end of file
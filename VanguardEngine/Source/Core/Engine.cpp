@@ -3,8 +3,11 @@
 #include <Core/Engine.h>
 #include <Core/Base.h>
 #include <Core/Config.h>
+#include <Core/Globals.h>
 #include <Rendering/Device.h>
 #include <Rendering/Renderer.h>
+#include <Rendering/AtmosphereReference.h>
+#include <Rendering/AtmosphereLutCache.h>
 #include <Window/WindowFrame.h>
 #include <Core/Input.h>
 #include <Core/CoreComponents.h>
@@ -17,8 +20,10 @@
 #include <spdlog/sinks/msvc_sink.h>
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <chrono>
+#include <algorithm>
 
 // #TEMP
 #include <Rendering/RenderComponents.h>
@@ -47,9 +52,9 @@ void OnSizeChanged(uint32_t width, uint32_t height)
 	Renderer::Get().SetResolution(width, height, false);
 }
 
-void EngineBoot()
+void EngineBootCore()
 {
-	VGScopedCPUStat("Engine Boot");
+	VGScopedCPUStat("Engine Boot Core");
 
 	auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("Log.txt", true);
 	auto msvcSink = std::make_shared<spdlog::sinks::msvc_sink_mt>();
@@ -78,6 +83,46 @@ void EngineBoot()
 	//});
 
 	Config::Initialize();
+}
+
+// Tools for build machines, these run without a window or device. Returns true if a tool ran.
+bool RunOfflineTools(int32_t& exitCode)
+{
+	const auto HasArgument = [](std::wstring_view argument)
+	{
+		return std::find(GCommandLineArgs.begin(), GCommandLineArgs.end(), argument) != GCommandLineArgs.end();
+	};
+
+	if (HasArgument(L"-bakeAtmosphereLuts"))
+	{
+		VGLog(logCore, "Baking atmosphere LUT cache.");
+
+		exitCode = AtmosphereReference::BakeLutCache(Atmosphere::CreateDefaultModel(), AtmosphereLutCache::GetPath()) ? 0 : 1;
+		return true;
+	}
+
+	// -cookModel <source>, repeatable. Cooks next to the source with the default import settings.
+	bool cooked = false;
+	for (auto it = std::find(GCommandLineArgs.begin(), GCommandLineArgs.end(), L"-cookModel"); it != GCommandLineArgs.end() && it + 1 != GCommandLineArgs.end();
+		it = std::find(it + 2, GCommandLineArgs.end(), L"-cookModel"))
+	{
+		const std::filesystem::path source{ *(it + 1) };
+		VGLog(logCore, "Cooking model '{}'.", source.generic_wstring());
+
+		if (!AssetLoader::CookModel(source, CookedModel::GetPath(source), CookedModel::Settings{}))
+		{
+			exitCode = 1;
+		}
+
+		cooked = true;
+	}
+
+	return cooked;
+}
+
+void EngineBoot()
+{
+	VGScopedCPUStat("Engine Boot");
 
 	Input::EnableDPIAwareness();
 
@@ -111,7 +156,7 @@ void EngineLoop()
 		const auto entity = registry.create();
 		registry.emplace<NameComponent>(entity, "Helmet");
 		registry.emplace<TransformComponent>(entity, transform);
-		registry.emplace<MeshComponent>(entity, AssetManager::Get().LoadModel(Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb"));
+		AssetManager::Get().LoadModelAsync(registry, entity, Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb");
 
 		return entity;
 	};
@@ -121,7 +166,7 @@ void EngineLoop()
 		const auto entity = registry.create();
 		registry.emplace<NameComponent>(entity, "Sponza");
 		registry.emplace<TransformComponent>(entity, transform);
-		registry.emplace<MeshComponent>(entity, AssetManager::Get().LoadModel(Config::shadersPath / "../Assets/Models/Sponza/glTF/Sponza.gltf"));
+		AssetManager::Get().LoadModelHierarchyAsync(registry, entity, Config::shadersPath / "../Assets/Models/Sponza/glTF/Sponza.gltf");
 
 		return entity;
 	};
@@ -131,7 +176,7 @@ void EngineLoop()
 		const auto entity = registry.create();
 		registry.emplace<NameComponent>(entity, "Bistro");
 		registry.emplace<TransformComponent>(entity, transform);
-		registry.emplace<MeshComponent>(entity, AssetManager::Get().LoadModel(Config::shadersPath / "../Assets/Models/Bistro/Bistro2.gltf"));
+		AssetManager::Get().LoadModelHierarchyAsync(registry, entity, Config::shadersPath / "../Assets/Models/Bistro/Bistro2.gltf");
 
 		return entity;
 	};
@@ -151,7 +196,6 @@ void EngineLoop()
 	//	.rotation = { -169.5f * 3.14159f / 180.f, 0.f, 121.5f * 3.14159f / 180.f },
 	//	.translation = { 78.f, 0.f, -5.f }
 	//});
-	const auto h = AssetManager::Get().LoadModel(Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb");
 	for (int i = 0; i < 6; i++)
 	{
 		float s = i*i * 19.f + 5;
@@ -164,7 +208,7 @@ void EngineLoop()
 
 		const auto entity = registry.create();
 		registry.emplace<TransformComponent>(entity, transform);
-		registry.emplace<MeshComponent>(entity, h);
+		AssetManager::Get().LoadModelAsync(registry, entity, Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb");  // Pending loads share the mesh.
 	}
 	//
 	//AddHelmet({
@@ -180,7 +224,6 @@ void EngineLoop()
 	//	.translation = { 120.f, -3.f, -3500.f }
 	//});
 
-	const auto helmetMesh = AssetManager::Get().LoadModel(Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb");
 	int perAxis = 0;
 	float spacing = 50.f;
 	for (int i = 0; i < perAxis; i++)
@@ -201,7 +244,7 @@ void EngineLoop()
 
 				const auto entity = registry.create();
 				registry.emplace<TransformComponent>(entity, transform);
-				registry.emplace<MeshComponent>(entity, helmetMesh);
+				AssetManager::Get().LoadModelAsync(registry, entity, Config::shadersPath / "../Assets/Models/DamagedHelmet/HelmetTangents.glb");
 			}
 		}
 	}
@@ -261,6 +304,8 @@ void EngineLoop()
 		ControlSystem::Update(registry);
 		CameraSystem::Update(registry, lastDeltaTime);
 		TimeOfDaySystem::Update(registry, lastDeltaTime);
+		TransformSystem::Update(registry);
+		SceneBvhSystem::Update(registry);  // World bounds depend on the transform hierarchy.
 
 		Renderer::Get().Render(registry);
 
@@ -287,9 +332,16 @@ int32_t EngineMain()
 {
 	RegisterCrashHandlers();
 
-	EngineBoot();
-	EngineLoop();
+	EngineBootCore();
+
+	int32_t exitCode = 0;
+	if (!RunOfflineTools(exitCode))
+	{
+		EngineBoot();
+		EngineLoop();
+	}
+
 	EngineShutdown();
 
-	return 0;
+	return exitCode;
 }
\ No newline at end of file
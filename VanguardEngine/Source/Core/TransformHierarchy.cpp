@@ -0,0 +1,276 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Core/TransformHierarchy.h>
+#include <Core/Base.h>
+#include <Utility/Math.h>
+
+#include <unordered_map>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+void TransformHierarchy::OnStructureChanged(entt::registry& registry, entt::entity entity)
+{
+	registry.ctx<TransformHierarchy>().structureDirty = true;
+}
+
+void TransformHierarchy::Rebuild(entt::registry& registry)
+{
+	VGScopedCPUStat("Rebuild Transform Hierarchy");
+
+	entities.clear();
+	parents.clear();
+	partitions.clear();
+	registry.clear<WorldTransformComponent>();
+
+	const auto HasParent = [&registry](entt::entity entity)
+	{
+		const auto* relationship = registry.try_get<RelationshipComponent>(entity);
+		return relationship && registry.valid(relationship->parent) && registry.all_of<TransformComponent>(relationship->parent);
+	};
+
+	std::unordered_map<entt::entity, std::vector<entt::entity>> children;
+	registry.view<const RelationshipComponent, const TransformComponent>().each([&](auto entity, const auto& relationship, const auto&)
+	{
+		if (HasParent(entity))
+		{
+			children[relationship.parent].emplace_back(entity);
+		}
+	});
+
+	std::vector<std::pair<uint32_t, uint32_t>> trees;
+	size_t childCount = 0;
+
+	for (const auto& [parent, parentChildren] : children)
+	{
+		childCount += parentChildren.size();
+
+		if (HasParent(parent))
+		{
+			continue;  // Not a root, reached through the breadth-first walk.
+		}
+
+		// Breadth-first walk, the node array itself serves as the queue.
+		const auto treeBegin = static_cast<uint32_t>(entities.size());
+		entities.emplace_back(parent);
+		parents.emplace_back(invalidIndex);
+
+		for (auto i = treeBegin; i < entities.size(); ++i)
+		{
+			if (const auto it = children.find(entities[i]); it != children.end())
+			{
+				for (const auto child : it->second)
+				{
+					entities.emplace_back(child);
+					parents.emplace_back(i);
+				}
+			}
+		}
+
+		trees.emplace_back(treeBegin, static_cast<uint32_t>(entities.size()));
+	}
+
+	// Every child that isn't reachable from a root is part of a cycle.
+	if (entities.size() - trees.size() != childCount)
+	{
+		VGLogWarning(logCore, "Transform hierarchy contains {} entities in parent cycles, ignoring them.", childCount - (entities.size() - trees.size()));
+	}
+
+	// Group whole trees into partitions of roughly equal node counts.
+	const auto partitionTarget = std::max<size_t>(entities.size() / (std::max<size_t>(std::thread::hardware_concurrency(), 1) * 4), 1);
+	for (const auto& [begin, end] : trees)
+	{
+		if (partitions.empty() || partitions.back().second - partitions.back().first >= partitionTarget)
+		{
+			partitions.emplace_back(begin, end);
+		}
+
+		else
+		{
+			partitions.back().second = end;
+		}
+	}
+
+	locals.resize(entities.size());
+	worlds.resize(entities.size());
+	dirty.resize(entities.size());
+
+	for (const auto entity : entities)
+	{
+		registry.emplace<WorldTransformComponent>(entity, XMMatrixIdentity());
+	}
+
+	structureDirty = false;
+	forceUpdate = true;
+}
+
+size_t TransformHierarchy::Propagate(entt::registry& registry, uint32_t begin, uint32_t end)
+{
+	const auto transformView = registry.view<const TransformComponent>();
+	const auto worldView = registry.view<WorldTransformComponent>();
+
+	size_t updated = 0;
+
+	for (auto i = begin; i < end; ++i)
+	{
+		const auto& local = transformView.get<const TransformComponent>(entities[i]);
+		const auto parent = parents[i];
+
+		const bool parentDirty = parent != invalidIndex && dirty[parent];
+		dirty[i] = forceUpdate || parentDirty || std::memcmp(&local, &locals[i], sizeof(TransformComponent)) != 0;
+
+		if (dirty[i])
+		{
+			locals[i] = local;
+
+			auto world = ComposeTransformMatrix(local.scale, local.rotation, local.translation);
+			if (parent != invalidIndex)
+			{
+				world = XMMatrixMultiply(world, worlds[parent]);
+			}
+
+			worlds[i] = world;
+			worldView.get<WorldTransformComponent>(entities[i]).worldMatrix = world;
+
+			++updated;
+		}
+	}
+
+	return updated;
+}
+
+TransformHierarchy::TransformHierarchy(entt::registry& registry)
+{
+	registry.on_construct<RelationshipComponent>().connect<&TransformHierarchy::OnStructureChanged>();
+	registry.on_update<RelationshipComponent>().connect<&TransformHierarchy::OnStructureChanged>();
+	registry.on_destroy<RelationshipComponent>().connect<&TransformHierarchy::OnStructureChanged>();
+	registry.on_destroy<TransformComponent>().connect<&TransformHierarchy::OnStructureChanged>();  // Parents without a relationship.
+}
+
+void TransformHierarchy::Update(entt::registry& registry)
+{
+	VGScopedCPUStat("Update Transform Hierarchy");
+
+	if (structureDirty)
+	{
+		Rebuild(registry);
+	}
+
+	std::vector<size_t> updatedCounts(partitions.size());
+
+	std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](const auto& partition)
+	{
+		const auto index = &partition - partitions.data();
+		updatedCounts[index] = Propagate(registry, partition.first, partition.second);
+	});
+
+	updatedNodes = std::accumulate(updatedCounts.begin(), updatedCounts.end(), size_t{ 0 });
+	forceUpdate = false;
+}
+
+void TransformHierarchy::Benchmark()
+{
+	VGScopedCPUStat("Transform Hierarchy Benchmark");
+
+	struct Shape
+	{
+		const wchar_t* name;
+		size_t trees;
+		size_t depth;
+		size_t branching;  // Children per node, the last level is a leaf.
+	};
+
+	// Between 65,535 and 100,100 nodes each.
+	constexpr Shape shapes[] = {
+		{ VGText("deep"), 100, 1000, 1 },  // Long chains.
+		{ VGText("wide"), 100, 2, 1000 },  // Roots with a thousand leaves each.
+		{ VGText("bushy"), 1, 16, 2 }  // Single binary tree.
+	};
+
+	constexpr int iterations = 10;
+
+	const auto Time = [](auto&& function)
+	{
+		const auto begin = std::chrono::high_resolution_clock::now();
+		function();
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	};
+
+	for (const auto& shape : shapes)
+	{
+		entt::registry registry;
+		auto& hierarchy = registry.set<TransformHierarchy>(registry);
+
+		std::vector<entt::entity> roots;
+		std::vector<entt::entity> nodes;
+
+		for (size_t i = 0; i < shape.trees; ++i)
+		{
+			std::vector<entt::entity> level{ registry.create() };
+			registry.emplace<TransformComponent>(level.back());
+			roots.emplace_back(level.back());
+
+			for (size_t j = 1; j < shape.depth; ++j)
+			{
+				std::vector<entt::entity> nextLevel;
+				for (const auto parent : level)
+				{
+					for (size_t k = 0; k < shape.branching; ++k)
+					{
+						const auto entity = registry.create();
+						registry.emplace<TransformComponent>(entity, TransformComponent{
+							.scale = { 1.f, 1.f, 1.f },
+							.rotation = { 0.01f * k, 0.f, 0.02f * j },
+							.translation = { 1.f, 0.f, 0.f }
+						});
+						registry.emplace<RelationshipComponent>(entity, parent);
+						nextLevel.emplace_back(entity);
+						nodes.emplace_back(entity);
+					}
+				}
+
+				level = std::move(nextLevel);
+			}
+		}
+
+		const auto rebuildTime = Time([&]() { hierarchy.Update(registry); });
+
+		double fullTime = 0.0;
+		double rootTime = 0.0;
+		double leafTime = 0.0;
+		size_t rootNodes = 0;
+		size_t leafNodes = 0;
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			// Moving every root dirties everything.
+			for (const auto root : roots)
+			{
+				registry.get<TransformComponent>(root).translation.x += 1.f;
+			}
+
+			fullTime += Time([&]() { hierarchy.Update(registry); });
+
+			// Moving one root dirties a single tree.
+			registry.get<TransformComponent>(roots[i % roots.size()]).translation.y += 1.f;
+			rootTime += Time([&]() { hierarchy.Update(registry); });
+			rootNodes = hierarchy.updatedNodes;
+
+			// Moving 1% of the nodes, the dirty subtrees are mostly small.
+			for (size_t j = i; j < nodes.size(); j += 100)
+			{
+				registry.get<TransformComponent>(nodes[j]).translation.z += 1.f;
+			}
+
+			leafTime += Time([&]() { hierarchy.Update(registry); });
+			leafNodes = hierarchy.updatedNodes;
+		}
+
+		VGLog(logCore, "Transform hierarchy benchmark ({}): {} nodes, rebuild {:.3f} ms, full update {:.3f} ms, single tree {:.3f} ms ({} nodes), 1% nodes {:.3f} ms ({} nodes).",
+			shape.name, hierarchy.GetNodeCount(), rebuildTime, fullTime / iterations, rootTime / iterations, rootNodes, leafTime / iterations, leafNodes);
+	}
+}
\ No newline at end of file
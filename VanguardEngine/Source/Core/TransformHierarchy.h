@@ -0,0 +1,49 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Core/CoreComponents.h>
+
+#include <entt/entt.hpp>
+
+#include <vector>
+#include <utility>
+#include <limits>
+#include <cstdint>
+
+// Flattened scene graph of every entity that has a parent or children. Each tree is stored contiguously in breadth-first
+// order, so parents always precede their children and propagation is a single linear sweep. Lives in the registry context.
+class TransformHierarchy
+{
+private:
+	static constexpr uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+
+	bool structureDirty = true;
+	bool forceUpdate = true;
+
+	std::vector<entt::entity> entities;
+	std::vector<uint32_t> parents;  // Node index of the parent, invalid for roots.
+	std::vector<TransformComponent> locals;  // Local transforms as of the last update, used to detect changes.
+	std::vector<XMMATRIX> worlds;
+	std::vector<uint8_t> dirty;
+	std::vector<std::pair<uint32_t, uint32_t>> partitions;  // Node ranges containing whole trees, balanced by node count.
+
+	static void OnStructureChanged(entt::registry& registry, entt::entity entity);
+
+	void Rebuild(entt::registry& registry);
+	size_t Propagate(entt::registry& registry, uint32_t begin, uint32_t end);
+
+public:
+	size_t updatedNodes = 0;  // Nodes recomputed during the last update.
+
+	// Connects to the registry's signals, the hierarchy needs to outlive them.
+	TransformHierarchy(entt::registry& registry);
+
+	// Recomputes world transforms of dirty subtrees. Trees are processed in parallel.
+	void Update(entt::registry& registry);
+
+	size_t GetNodeCount() const { return entities.size(); }
+
+	// CPU-only measurement of rebuilds, full updates and partial updates for deep and wide synthetic hierarchies.
+	static void Benchmark();
+};
\ No newline at end of file
@@ -55,6 +55,24 @@ void ComponentProperties::RenderControlComponent(entt::registry& registry, entt:
 	ImGui::Text("This entity has control.");
 }
 
+void ComponentProperties::RenderRelationshipComponent(entt::registry& registry, entt::entity entity)
+{
+	auto& component = registry.get<RelationshipComponent>(entity);
+
+	ImGui::Text("Relationship");
+
+	if (registry.valid(component.parent))
+	{
+		const auto* name = registry.try_get<NameComponent>(component.parent);
+		ImGui::Text("Parent: %s (%i)", name ? name->name.c_str() : "Unnamed", static_cast<int>(entt::to_integral(component.parent)));
+	}
+
+	else
+	{
+		ImGui::Text("Parent: None");
+	}
+}
+
 void ComponentProperties::RenderMeshComponent(entt::registry& registry, entt::entity entity)
 {
 	auto& component = registry.get<MeshComponent>(entity);
@@ -14,6 +14,7 @@ namespace ComponentProperties
 	void RenderNameComponent(entt::registry& registry, entt::entity entity);
 	void RenderTransformComponent(entt::registry& registry, entt::entity entity);
 	void RenderControlComponent(entt::registry& registry, entt::entity entity);
+	void RenderRelationshipComponent(entt::registry& registry, entt::entity entity);
 
 	// Rendering components.
 
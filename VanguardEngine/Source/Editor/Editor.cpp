@@ -67,7 +67,7 @@ void Editor::Render(RenderGraph& graph, RenderDevice& device, Renderer& renderer
 		case RenderOverlay::None: break;
 		case RenderOverlay::Clusters:
 		{
-			activeOverlayTag = renderer.clusteredCulling.RenderDebugOverlay(graph, clusterResources.lightInfo, clusterResources.lightVisibility);
+			activeOverlayTag = renderer.clusteredCulling.RenderDebugOverlay(graph, clusterResources.view, clusterResources.lightInfo, clusterResources.lightVisibility);
 			break;
 		}
 		case RenderOverlay::HiZ:
@@ -110,7 +110,7 @@ void Editor::Render(RenderGraph& graph, RenderDevice& device, Renderer& renderer
 			ui->DrawEntityPropertyViewer(registry);
 			ui->DrawMetrics(&device, renderer.lastFrameTime);
 			ui->DrawRenderGraph(&device, resourceManager, resources.GetTexture(depthStencil), resources.GetTexture(outputLDR));
-			ui->DrawAtmosphereControls(&device, registry, renderer.atmosphere, renderer.clouds, resources.GetTexture(weather));
+			ui->DrawAtmosphereControls(&device, registry, renderer.atmosphere, renderer.clouds, resources.GetTexture(weather), renderer.environmentSchedule.stats);
 			ui->DrawBloomControls(renderer.bloom);
 			ui->DrawRenderVisualizer(&device, renderer.clusteredCulling, overlayHandle);
 
@@ -1065,7 +1065,8 @@ void EditorUI::DrawRenderGraph(RenderDevice* device, RenderGraphResourceManager&
 	}
 }
 
-void EditorUI::DrawAtmosphereControls(RenderDevice* device, entt::registry& registry, Atmosphere& atmosphere, Clouds& clouds, TextureHandle weather)
+void EditorUI::DrawAtmosphereControls(RenderDevice* device, entt::registry& registry, Atmosphere& atmosphere, Clouds& clouds, TextureHandle weather,
+	const EnvironmentUpdateStats& environmentStats)
 {
 	if (atmosphereControlsOpen)
 	{
@@ -1134,6 +1135,12 @@ void EditorUI::DrawAtmosphereControls(RenderDevice* device, entt::registry& regi
 				CvarSet("cloudShadowMapScale", shadowMapScale);
 			}
 
+			ImGui::Text("Weather reused for %u frames (%llu total)", clouds.updateStats.weatherFramesSkipped, clouds.updateStats.weatherSkips);
+			ImGui::Text("Shadow map reused for %u frames (%llu total)", clouds.updateStats.shadowMapFramesSkipped, clouds.updateStats.shadowMapSkips);
+			ImGui::Text("Environment maps reused for %u frames (%llu total), %llu updates", environmentStats.framesSkipped, environmentStats.skips, environmentStats.updates);
+			ImGui::Text("Environment thread groups per frame: %.0f average, %llu peak", environmentStats.frames > 0 ? (double)environmentStats.cost.Total() / environmentStats.frames : 0.0,
+				environmentStats.peakCost.Total());
+
 			ImGui::Separator();
 
 			ImGui::Text("Atmosphere");
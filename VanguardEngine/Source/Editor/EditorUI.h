@@ -23,6 +23,7 @@ class Atmosphere;
 class Clouds;
 class Bloom;
 class ClusteredLightCulling;
+struct EnvironmentUpdateStats;
 
 class EditorUI
 {
@@ -91,7 +92,8 @@ public:
 	void DrawEntityPropertyViewer(entt::registry& registry);
 	void DrawMetrics(RenderDevice* device, float frameTimeMs);
 	void DrawRenderGraph(RenderDevice* device, RenderGraphResourceManager& resourceManager, TextureHandle depthStencil, TextureHandle scene);
-	void DrawAtmosphereControls(RenderDevice* device, entt::registry& registry, Atmosphere& atmosphere, Clouds& clouds, TextureHandle weather);
+	void DrawAtmosphereControls(RenderDevice* device, entt::registry& registry, Atmosphere& atmosphere, Clouds& clouds, TextureHandle weather,
+		const EnvironmentUpdateStats& environmentStats);
 	void DrawBloomControls(Bloom& bloom);
 	void DrawRenderVisualizer(RenderDevice* device, ClusteredLightCulling& clusteredCulling, TextureHandle overlay);
 
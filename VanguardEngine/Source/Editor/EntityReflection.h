@@ -18,6 +18,7 @@ namespace EntityReflection
 		{ entt::type_id<NameComponent>().hash(), &ComponentProperties::RenderNameComponent },
 		{ entt::type_id<TransformComponent>().hash(), &ComponentProperties::RenderTransformComponent },
 		{ entt::type_id<ControlComponent>().hash(), &ComponentProperties::RenderControlComponent },
+		{ entt::type_id<RelationshipComponent>().hash(), &ComponentProperties::RenderRelationshipComponent },
 		{ entt::type_id<MeshComponent>().hash(), &ComponentProperties::RenderMeshComponent },
 		{ entt::type_id<CameraComponent>().hash(), &ComponentProperties::RenderCameraComponent },
 		{ entt::type_id<LightComponent>().hash(), &ComponentProperties::RenderLightComponent },
@@ -8,14 +8,28 @@
 #include <Rendering/ShaderStructs.h>
 #include <Core/CoreComponents.h>
 #include <Rendering/RenderComponents.h>
+#include <Rendering/ResourceFormat.h>
+#include <Rendering/AtmosphereLutCache.h>
+#include <Rendering/AtmosphereReference.h>
 
 #include <vector>
 #include <cmath>
+#include <array>
+#include <memory>
+
+namespace
+{
+	AtmosphereLutCache::Texture CreateLutCacheTexture(const TextureDescription& description)
+	{
+		const auto size = (size_t)description.width * description.height * description.depth * (GetResourceFormatSize(description.format) / 8);
+		return { description.width, description.height, description.depth, description.format, std::vector<uint8_t>(size) };
+	}
+}
 
 void Atmosphere::Precompute(CommandList& list, TextureHandle transmittanceHandle, TextureHandle scatteringHandle, TextureHandle irradianceHandle)
 {
 	constexpr auto groupSize = 8;
-	constexpr auto scatteringOrder = 4;
+	constexpr auto scatteringOrder = AtmosphereReference::scatteringOrders;
 
 	const auto& transmittanceComponent = device->GetResourceManager().Get(transmittanceHandle);
 	const auto& scatteringComponent = device->GetResourceManager().Get(scatteringHandle);
@@ -271,16 +285,163 @@ void Atmosphere::Precompute(CommandList& list, TextureHandle transmittanceHandle
 	device->GetResourceManager().AddFrameDescriptor(device->GetFrameIndex(), std::move(deltaIrradianceUAV));
 }
 
+void Atmosphere::CreateDeltaTextures()
+{
+	if (deltaRayleighTexture.handle != entt::null)
+	{
+		return;
+	}
+
+	auto scatteringDesc = device->GetResourceManager().Get(scatteringTexture).description;
+	auto irradianceDesc = device->GetResourceManager().Get(irradianceTexture).description;
+	scatteringDesc.accessFlags = AccessFlag::GPUWrite;
+	irradianceDesc.accessFlags = AccessFlag::GPUWrite;
+
+	deltaRayleighTexture = device->GetResourceManager().Create(scatteringDesc, VGText("Atmosphere delta rayleigh"));
+	deltaMieTexture = device->GetResourceManager().Create(scatteringDesc, VGText("Atmosphere delta mie"));
+	deltaScatteringDensityTexture = device->GetResourceManager().Create(scatteringDesc, VGText("Atmosphere delta scattering density"));
+	deltaIrradianceTexture = device->GetResourceManager().Create(irradianceDesc, VGText("Atmosphere delta irradiance"));
+}
+
+void Atmosphere::ReleaseDeltaTextures()
+{
+	if (deltaRayleighTexture.handle == entt::null)
+	{
+		return;
+	}
+
+	// Still in use by the precompute this frame.
+	device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), deltaRayleighTexture);
+	device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), deltaMieTexture);
+	device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), deltaScatteringDensityTexture);
+	device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), deltaIrradianceTexture);
+
+	deltaRayleighTexture = {};
+	deltaMieTexture = {};
+	deltaScatteringDensityTexture = {};
+	deltaIrradianceTexture = {};
+}
+
+bool Atmosphere::LoadLutCache(size_t modelHash)
+{
+	const std::array textures = { transmittanceTexture, scatteringTexture, irradianceTexture };
+	std::vector<AtmosphereLutCache::Texture> cacheTextures;
+
+	for (const auto texture : textures)
+	{
+		cacheTextures.emplace_back(CreateLutCacheTexture(device->GetResourceManager().Get(texture).description));
+	}
+
+	if (!AtmosphereLutCache::Load(AtmosphereLutCache::GetPath(), modelHash, cacheTextures))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		device->GetResourceManager().Write(textures[i], cacheTextures[i].data);
+	}
+
+	return true;
+}
+
+void Atmosphere::SaveLutCache(CommandList& list, size_t modelHash)
+{
+	ReadLuts(list, [modelHash](std::vector<AtmosphereLutCache::Texture>&& textures)
+	{
+		if (AtmosphereLutCache::Save(AtmosphereLutCache::GetPath(), modelHash, textures))
+		{
+			VGLog(logRendering, "Saved atmosphere LUT cache.");
+		}
+	});
+}
+
+void Atmosphere::ReadLuts(CommandList& list, std::function<void(std::vector<AtmosphereLutCache::Texture>&&)> callback)
+{
+	struct PendingReadback
+	{
+		std::vector<AtmosphereLutCache::Texture> textures;
+		std::function<void(std::vector<AtmosphereLutCache::Texture>&&)> callback;
+		size_t received = 0;
+	};
+
+	auto pending = std::make_shared<PendingReadback>();
+	pending->callback = std::move(callback);
+
+	const std::array textures = { transmittanceTexture, scatteringTexture, irradianceTexture };
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		pending->textures.emplace_back(CreateLutCacheTexture(device->GetResourceManager().Get(textures[i]).description));
+	}
+
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		device->GetResourceManager().Read(list, textures[i], [pending, i](std::vector<uint8_t>&& data)
+		{
+			VGAssert(data.size() == pending->textures[i].data.size(), "Mismatched atmosphere LUT readback size.");
+
+			pending->textures[i].data = std::move(data);
+
+			if (++pending->received == pending->textures.size())
+			{
+				pending->callback(std::move(pending->textures));
+			}
+		});
+	}
+}
+
+AtmosphereData Atmosphere::CreateDefaultModel()
+{
+	AtmosphereData model{};
+
+	XMFLOAT3 rayleighScattering = { 0.005802f, 0.013558f, 0.0331f };
+	float mieScattering = 0.003996f * 1.2f;
+	float mieExtinction = 1.11f * mieScattering;
+	XMFLOAT3 ozoneAbsorption = { 0.0020556f, 0.0049788f, 0.0002136f };  // Frostbite's.
+	//XMFLOAT3 ozoneAbsorption = { 0.00065f, 0.001881f, 0.000085f };  // Bruneton's.
+
+	model.radiusBottom = 6360.f;  // Kilometers.
+	model.radiusTop = 6420.f;  // Kilometers.
+	model.rayleighDensity.width = 0.f;
+	model.rayleighDensity.exponentialCoefficient = 1.f;
+	model.rayleighDensity.exponentialScale = -1.f / 8.f;
+	model.rayleighDensity.heightScale = 0.f;
+	model.rayleighDensity.offset = 0.f;
+	model.rayleighScattering = rayleighScattering;
+	model.mieDensity.width = 0.f;
+	model.mieDensity.exponentialCoefficient = 1.f;
+	model.mieDensity.exponentialScale = -1.f / 1.2f;
+	model.mieDensity.heightScale = 0.f;
+	model.mieDensity.offset = 0.f;
+	model.mieScattering = { mieScattering, mieScattering, mieScattering };
+	model.mieExtinction = { mieExtinction, mieExtinction, mieExtinction };
+	model.absorptionDensity.width = 25.f;
+	model.absorptionDensity.exponentialCoefficient = 0.f;
+	model.absorptionDensity.exponentialScale = 0.f;
+	model.absorptionDensity.heightScale = 1.f / 15.f;
+	model.absorptionDensity.offset = -2.f / 3.f;
+	model.absorptionExtinction = ozoneAbsorption;
+	model.surfaceColor = { 0.1f, 0.1f, 0.1f };
+	model.solarIrradiance = { 1.474f, 1.8504f, 1.91198f };
+
+	return model;
+}
+
 Atmosphere::~Atmosphere()
 {
 	device->GetResourceManager().Destroy(transmittanceTexture);
 	device->GetResourceManager().Destroy(scatteringTexture);
 	device->GetResourceManager().Destroy(irradianceTexture);
-	device->GetResourceManager().Destroy(deltaRayleighTexture);
-	device->GetResourceManager().Destroy(deltaMieTexture);
-	device->GetResourceManager().Destroy(deltaScatteringDensityTexture);
-	device->GetResourceManager().Destroy(deltaIrradianceTexture);
 	device->GetResourceManager().Destroy(luminanceTexture);
+
+	if (deltaRayleighTexture.handle != entt::null)
+	{
+		device->GetResourceManager().Destroy(deltaRayleighTexture);
+		device->GetResourceManager().Destroy(deltaMieTexture);
+		device->GetResourceManager().Destroy(deltaScatteringDensityTexture);
+		device->GetResourceManager().Destroy(deltaIrradianceTexture);
+	}
 }
 
 void Atmosphere::Initialize(RenderDevice* inDevice, entt::registry& registry)
@@ -289,6 +450,7 @@ void Atmosphere::Initialize(RenderDevice* inDevice, entt::registry& registry)
 
 	CvarCreate("renderCloudShadowMap", "Projects the cloud shadow map onto the planet surface, for debugging purposes. 0=off, 1=on", 0);
 	CvarCreate("renderLightShafts", "Controls rendering of volumetric light shafts, currently only cast by clouds. 0=off, 1=on", 1);
+	CvarCreate("atmosphereLutCache", "Loads the precomputed atmosphere LUTs from disk when the model matches, and saves them after precomputing. 0=off, 1=on", 1);
 
 	transmissionPrecomputeLayout = RenderPipelineLayout{}
 		.ComputeShader({ "Atmosphere/AtmospherePrecompute", "TransmittanceLutMain" });
@@ -316,10 +478,10 @@ void Atmosphere::Initialize(RenderDevice* inDevice, entt::registry& registry)
 
 	TextureDescription transmittanceDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
-		.accessFlags = AccessFlag::GPUWrite,
-		.width = 256,
-		.height = 64,
-		.depth = 1,
+		.accessFlags = AccessFlag::CPUWrite | AccessFlag::GPUWrite,  // CPU write for loading from the LUT cache.
+		.width = AtmosphereReference::transmittanceLutSize.x,
+		.height = AtmosphereReference::transmittanceLutSize.y,
+		.depth = AtmosphereReference::transmittanceLutSize.z,
 		.format = DXGI_FORMAT_R32G32B32A32_FLOAT,
 		.mipMapping = false
 	};
@@ -328,10 +490,10 @@ void Atmosphere::Initialize(RenderDevice* inDevice, entt::registry& registry)
 
 	TextureDescription scatteringDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
-		.accessFlags = AccessFlag::GPUWrite,
-		.width = 256,
-		.height = 128,
-		.depth = 32,
+		.accessFlags = AccessFlag::CPUWrite | AccessFlag::GPUWrite,  // CPU write for loading from the LUT cache.
+		.width = AtmosphereReference::scatteringLutSize.x,
+		.height = AtmosphereReference::scatteringLutSize.y,
+		.depth = AtmosphereReference::scatteringLutSize.z,
 		.format = DXGI_FORMAT_R32G32B32A32_FLOAT,
 		.mipMapping = false
 	};
@@ -340,21 +502,16 @@ void Atmosphere::Initialize(RenderDevice* inDevice, entt::registry& registry)
 
 	TextureDescription irradianceDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
-		.accessFlags = AccessFlag::GPUWrite,
-		.width = 64,
-		.height = 16,
-		.depth = 1,
+		.accessFlags = AccessFlag::CPUWrite | AccessFlag::GPUWrite,  // CPU write for loading from the LUT cache.
+		.width = AtmosphereReference::irradianceLutSize.x,
+		.height = AtmosphereReference::irradianceLutSize.y,
+		.depth = AtmosphereReference::irradianceLutSize.z,
 		.format = DXGI_FORMAT_R32G32B32A32_FLOAT,
 		.mipMapping = false
 	};
 
 	irradianceTexture = device->GetResourceManager().Create(irradianceDesc, VGText("Atmosphere precomputed irradiance"));
 
-	deltaRayleighTexture = device->GetResourceManager().Create(scatteringDesc, VGText("Atmosphere delta rayleigh"));
-	deltaMieTexture = device->GetResourceManager().Create(scatteringDesc, VGText("Atmosphere delta mie"));
-	deltaScatteringDensityTexture = device->GetResourceManager().Create(scatteringDesc, VGText("Atmosphere delta scattering density"));
-	deltaIrradianceTexture = device->GetResourceManager().Create(irradianceDesc, VGText("Atmosphere delta irradiance"));
-
 	TextureDescription luminanceDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
 		.accessFlags = AccessFlag::GPUWrite,
@@ -368,35 +525,7 @@ void Atmosphere::Initialize(RenderDevice* inDevice, entt::registry& registry)
 
 	luminanceTexture = device->GetResourceManager().Create(luminanceDesc, VGText("Atmosphere luminance"));
 
-	XMFLOAT3 rayleighScattering = { 0.005802f, 0.013558f, 0.0331f };
-	float mieScattering = 0.003996f * 1.2f;
-	float mieExtinction = 1.11f * mieScattering;
-	XMFLOAT3 ozoneAbsorption = { 0.0020556f, 0.0049788f, 0.0002136f };  // Frostbite's.
-	//XMFLOAT3 ozoneAbsorption = { 0.00065f, 0.001881f, 0.000085f };  // Bruneton's.
-
-	model.radiusBottom = 6360.f;  // Kilometers.
-	model.radiusTop = 6420.f;  // Kilometers.
-	model.rayleighDensity.width = 0.f;
-	model.rayleighDensity.exponentialCoefficient = 1.f;
-	model.rayleighDensity.exponentialScale = -1.f / 8.f;
-	model.rayleighDensity.heightScale = 0.f;
-	model.rayleighDensity.offset = 0.f;
-	model.rayleighScattering = rayleighScattering;
-	model.mieDensity.width = 0.f;
-	model.mieDensity.exponentialCoefficient = 1.f;
-	model.mieDensity.exponentialScale = -1.f / 1.2f;
-	model.mieDensity.heightScale = 0.f;
-	model.mieDensity.offset = 0.f;
-	model.mieScattering = { mieScattering, mieScattering, mieScattering };
-	model.mieExtinction = { mieExtinction, mieExtinction, mieExtinction };
-	model.absorptionDensity.width = 25.f;
-	model.absorptionDensity.exponentialCoefficient = 0.f;
-	model.absorptionDensity.exponentialScale = 0.f;
-	model.absorptionDensity.heightScale = 1.f / 15.f;
-	model.absorptionDensity.offset = -2.f / 3.f;
-	model.absorptionExtinction = ozoneAbsorption;
-	model.surfaceColor = { 0.1f, 0.1f, 0.1f };
-	model.solarIrradiance = { 1.474f, 1.8504f, 1.91198f };
+	model = CreateDefaultModel();
 
 	sunLight = registry.create();
 	registry.emplace<NameComponent>(sunLight, "Sun");
@@ -415,21 +544,94 @@ AtmosphereResources Atmosphere::ImportResources(RenderGraph& graph)
 	return { transmittanceTag, scatteringTag, irradianceTag };
 }
 
+void Atmosphere::UpdateLuts(RenderGraph& graph, AtmosphereResources resourceHandles)
+{
+	if (dirty)
+	{
+		const auto modelHash = AtmosphereLutCache::ComputeModelHash(model);
+		const auto useCache = *CvarGet("atmosphereLutCache", int) > 0;
+
+		if (useCache && LoadLutCache(modelHash))
+		{
+			VGLog(logRendering, "Loaded atmosphere LUTs from cache.");
+		}
+
+		else
+		{
+			CreateDeltaTextures();
+
+			auto& precomputePass = graph.AddPass("Atmosphere Precompute Pass", ExecutionQueue::Compute);
+			precomputePass.Write(resourceHandles.transmittanceHandle, ResourceBind::UAV);
+			precomputePass.Write(resourceHandles.scatteringHandle, ResourceBind::UAV);
+			precomputePass.Write(resourceHandles.irradianceHandle, ResourceBind::UAV);
+			precomputePass.Bind([&, resourceHandles, modelHash, useCache](CommandList& list, RenderPassResources& resources)
+			{
+				Precompute(list, resources.GetTexture(resourceHandles.transmittanceHandle), resources.GetTexture(resourceHandles.scatteringHandle), resources.GetTexture(resourceHandles.irradianceHandle));
+
+				if (useCache)
+				{
+					SaveLutCache(list, modelHash);
+				}
+
+				// The deltas are only intermediates, don't keep them resident.
+				ReleaseDeltaTextures();
+			});
+		}
+
+		dirty = false;
+		++lutVersion;
+	}
+}
+
 void Atmosphere::Render(RenderGraph& graph, Clouds& clouds, AtmosphereResources resourceHandles, CloudResources cloudResources, RenderResource cameraBuffer,
 	RenderResource depthStencil, RenderResource outputHDR, entt::registry& registry)
 {
-	if (dirty)
+	if (validateLuts)
 	{
-		auto& precomputePass = graph.AddPass("Atmosphere Precompute Pass", ExecutionQueue::Compute);
-		precomputePass.Write(resourceHandles.transmittanceHandle, ResourceBind::UAV);
-		precomputePass.Write(resourceHandles.scatteringHandle, ResourceBind::UAV);
-		precomputePass.Write(resourceHandles.irradianceHandle, ResourceBind::UAV);
-		precomputePass.Bind([&, resourceHandles](CommandList& list, RenderPassResources& resources)
+		auto& validationPass = graph.AddPass("Atmosphere LUT Validation Pass", ExecutionQueue::Compute);
+		validationPass.Read(resourceHandles.transmittanceHandle, ResourceBind::SRV);
+		validationPass.Read(resourceHandles.scatteringHandle, ResourceBind::SRV);
+		validationPass.Read(resourceHandles.irradianceHandle, ResourceBind::SRV);
+		validationPass.Bind([&, atmosphere = model](CommandList& list, RenderPassResources&)
 		{
-			Precompute(list, resources.GetTexture(resourceHandles.transmittanceHandle), resources.GetTexture(resourceHandles.scatteringHandle), resources.GetTexture(resourceHandles.irradianceHandle));
+			ReadLuts(list, [atmosphere](std::vector<AtmosphereLutCache::Texture>&& textures)
+			{
+				VGScopedCPUStat("Validate Atmosphere LUTs");
+
+				AtmosphereReference::Luts reference;
+				AtmosphereReference::Precompute(atmosphere, AtmosphereReference::Settings{}, reference);
+
+				const std::pair<const char*, const AtmosphereReference::Lut*> luts[] = {
+					{ "transmittance", &reference.transmittance },
+					{ "scattering", &reference.scattering },
+					{ "irradiance", &reference.irradiance }
+				};
+
+				bool passed = true;
+
+				for (size_t i = 0; i < textures.size(); ++i)
+				{
+					const auto error = AtmosphereReference::Compare(*luts[i].second, textures[i].data);
+					const auto withinTolerance = error.meanRelative <= AtmosphereReference::validationMeanTolerance && error.maxRelative <= AtmosphereReference::validationMaxTolerance;
+					passed = passed && withinTolerance;
+
+					VGLog(logRendering, "Atmosphere {} LUT: max absolute error {:.3e}, max relative error {:.3e}, mean relative error {:.3e}.", luts[i].first,
+						error.maxAbsolute, error.maxRelative, error.meanRelative);
+				}
+
+				if (passed)
+				{
+					VGLog(logRendering, "Atmosphere LUTs match the CPU reference.");
+				}
+
+				else
+				{
+					VGLogError(logRendering, "Atmosphere LUTs differ from the CPU reference beyond tolerance.");
+				}
+			});
 		});
-		
-		dirty = false;
+
+		validateLuts = false;
 	}
 
 	const auto solarZenithAngle = registry.get<TimeOfDayComponent>(sunLight).solarZenithAngle;
@@ -504,54 +706,69 @@ void Atmosphere::Render(RenderGraph& graph, Clouds& clouds, AtmosphereResources
 }
 
 std::pair<RenderResource, RenderResource> Atmosphere::RenderEnvironmentMap(RenderGraph& graph, AtmosphereResources resourceHandles, RenderResource cameraBuffer,
-	entt::registry& registry)
+	entt::registry& registry, const EnvironmentUpdate& update)
 {
 	const auto luminanceTag = graph.Import(luminanceTexture);
 
 	const auto solarZenithAngle = registry.get<TimeOfDayComponent>(sunLight).solarZenithAngle;
+	const auto& slice = update.slice;
 
-	TextureView luminanceView{};
-	luminanceView.UAV("", 0);
-
-	auto& luminancePass = graph.AddPass("Atmosphere Luminance Pass", ExecutionQueue::Compute);
-	luminancePass.Read(cameraBuffer, ResourceBind::SRV);
-	luminancePass.Read(resourceHandles.transmittanceHandle, ResourceBind::SRV);
-	luminancePass.Read(resourceHandles.scatteringHandle, ResourceBind::SRV);
-	luminancePass.Read(resourceHandles.irradianceHandle, ResourceBind::SRV);
-	luminancePass.Write(luminanceTag, luminanceView);
-	luminancePass.Bind([&, cameraBuffer, resourceHandles, luminanceTag, solarZenithAngle](CommandList& list, RenderPassResources& resources)
+	if (slice.luminanceFaceCount > 0 || slice.luminanceMips)
 	{
-		struct BindData
+		TextureView luminanceView{};
+		luminanceView.UAV("", 0);
+
+		auto& luminancePass = graph.AddPass("Atmosphere Luminance Pass", ExecutionQueue::Compute);
+		luminancePass.Read(cameraBuffer, ResourceBind::SRV);
+		luminancePass.Read(resourceHandles.transmittanceHandle, ResourceBind::SRV);
+		luminancePass.Read(resourceHandles.scatteringHandle, ResourceBind::SRV);
+		luminancePass.Read(resourceHandles.irradianceHandle, ResourceBind::SRV);
+		luminancePass.Write(luminanceTag, luminanceView);
+		luminancePass.Bind([&, cameraBuffer, resourceHandles, luminanceTag, slice, updateAngle = update.solarZenithAngle, updateCamera = update.cameraPosition](CommandList& list, RenderPassResources& resources)
 		{
-			AtmosphereData atmosphere;
-			uint32_t transmissionTexture;
-			uint32_t scatteringTexture;
-			uint32_t irradianceTexture;
-			float solarZenithAngle;
-			uint32_t luminanceTexture;
-			uint32_t cameraBuffer;
-			uint32_t cameraIndex;
-		} bindData;
-
-		bindData.atmosphere = model;
-		bindData.transmissionTexture = resources.Get(resourceHandles.transmittanceHandle);
-		bindData.scatteringTexture = resources.Get(resourceHandles.scatteringHandle);
-		bindData.irradianceTexture = resources.Get(resourceHandles.irradianceHandle);
-		bindData.solarZenithAngle = solarZenithAngle;
-		bindData.luminanceTexture = resources.Get(luminanceTag);
-		bindData.cameraBuffer = resources.Get(cameraBuffer);
-		bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
-
-		list.BindPipeline(luminancePrecomputeLayout);
-		list.BindConstants("bindData", bindData);
-
-		list.Dispatch(luminanceTextureSize / 8, luminanceTextureSize / 8, 6);
-
-		list.UAVBarrier(luminanceTexture);
-		list.FlushBarriers();
-
-		device->GetResourceManager().GenerateMipmaps(list, luminanceTexture);
-	});
+			if (slice.luminanceFaceCount > 0)
+			{
+				struct BindData
+				{
+					AtmosphereData atmosphere;
+					uint32_t transmissionTexture;
+					uint32_t scatteringTexture;
+					uint32_t irradianceTexture;
+					float solarZenithAngle;
+					uint32_t luminanceTexture;
+					uint32_t cameraBuffer;
+					uint32_t cameraIndex;
+					uint32_t cubeFace;
+					XMFLOAT3 cameraPosition;
+					float padding;
+				} bindData;
+
+				bindData.atmosphere = model;
+				bindData.transmissionTexture = resources.Get(resourceHandles.transmittanceHandle);
+				bindData.scatteringTexture = resources.Get(resourceHandles.scatteringHandle);
+				bindData.irradianceTexture = resources.Get(resourceHandles.irradianceHandle);
+				bindData.solarZenithAngle = updateAngle;  // Every face of an update is rendered with the same sun.
+				bindData.luminanceTexture = resources.Get(luminanceTag);
+				bindData.cameraBuffer = resources.Get(cameraBuffer);
+				bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
+				bindData.cubeFace = slice.luminanceFaceBegin;
+				bindData.cameraPosition = updateCamera;  // From the same point as well, the camera keeps moving during the update.
+
+				list.BindPipeline(luminancePrecomputeLayout);
+				list.BindConstants("bindData", bindData);
+
+				list.Dispatch(luminanceTextureSize / 8, luminanceTextureSize / 8, slice.luminanceFaceCount);
+			}
+
+			if (slice.luminanceMips)
+			{
+				list.UAVBarrier(luminanceTexture);
+				list.FlushBarriers();
+
+				device->GetResourceManager().GenerateMipmaps(list, luminanceTexture);
+			}
+		});
+	}
 
 	auto& irradiancePass = graph.AddPass("Atmosphere Separable Irradiance Pass", ExecutionQueue::Compute);
 	irradiancePass.Read(cameraBuffer, ResourceBind::SRV);
@@ -7,10 +7,14 @@
 #include <Rendering/RenderGraphResource.h>
 #include <Rendering/RenderPipeline.h>
 #include <Rendering/Clouds.h>
+#include <Rendering/AtmosphereLutCache.h>
+#include <Rendering/EnvironmentSchedule.h>
 
 #include <entt/entt.hpp>
 
 #include <utility>
+#include <functional>
+#include <vector>
 
 class PipelineBuilder;
 class RenderDevice;
@@ -65,17 +69,19 @@ struct AtmosphereResources
 class Atmosphere
 {
 public:
-	AtmosphereData model;
+	AtmosphereData model{};  // Value initialized, the padding is part of the LUT cache hash.
 	entt::entity sunLight;  // Directional light entity for direct solar illumination.
 
 private:
 	RenderDevice* device = nullptr;
 
 	bool dirty = true;  // Needs to recompute LUTs.
+	uint32_t lutVersion = 0;  // Incremented whenever the LUTs are recomputed or loaded.
 	TextureHandle transmittanceTexture;
 	TextureHandle scatteringTexture;
 	TextureHandle irradianceTexture;
 
+	// Only resident while precomputing.
 	TextureHandle deltaRayleighTexture;
 	TextureHandle deltaMieTexture;
 	TextureHandle deltaScatteringDensityTexture;
@@ -89,23 +95,42 @@ private:
 	RenderPipelineLayout multipleScatteringPrecomputeLayout;
 
 	void Precompute(CommandList& list, TextureHandle transmittanceHandle, TextureHandle scatteringHandle, TextureHandle irradianceHandle);
+	void CreateDeltaTextures();
+	void ReleaseDeltaTextures();
 
-	RenderPipelineLayout separableIrradianceLayout;
+	// Precomputed LUTs are cached on disk, keyed by the model.
+	bool LoadLutCache(size_t modelHash);
+	void SaveLutCache(CommandList& list, size_t modelHash);
 
-	static constexpr uint32_t luminanceTextureSize = 1024;
-	static_assert(luminanceTextureSize % 8 == 0, "luminanceTextureSize must be evenly divisible by 8.");
+	// Reads back the transmittance, scattering, and irradiance LUTs, the callback runs once all three have arrived.
+	void ReadLuts(CommandList& list, std::function<void(std::vector<AtmosphereLutCache::Texture>&&)> callback);
+	bool validateLuts = false;
+
+	RenderPipelineLayout separableIrradianceLayout;
 
 	TextureHandle luminanceTexture;
 	RenderPipelineLayout luminancePrecomputeLayout;
 
 public:
+	static constexpr uint32_t luminanceTextureSize = 1024;
+	static_assert(luminanceTextureSize % 8 == 0, "luminanceTextureSize must be evenly divisible by 8.");
+
+	// Earth-like atmosphere the renderer starts with, also used when baking the LUT cache offline.
+	static AtmosphereData CreateDefaultModel();
+
 	~Atmosphere();
 	void Initialize(RenderDevice* inDevice, entt::registry& registry);
 
 	AtmosphereResources ImportResources(RenderGraph& graph);
+	// Precomputes the LUTs if the model changed. Must be declared before the passes reading them.
+	void UpdateLuts(RenderGraph& graph, AtmosphereResources resourceHandles);
 	void Render(RenderGraph& graph, Clouds& clouds, AtmosphereResources resourceHandles, CloudResources cloudResources, RenderResource cameraBuffer,
 		RenderResource depthStencil, RenderResource outputHDRs, entt::registry& registry);
+	// Renders the luminance faces of the update's slice, the luminance map is only complete once an update has rendered its mips.
 	std::pair<RenderResource, RenderResource> RenderEnvironmentMap(RenderGraph& graph, AtmosphereResources resourceHandles, RenderResource cameraBuffer,
-		entt::registry& registry);
+		entt::registry& registry, const EnvironmentUpdate& update);
 	void MarkModelDirty() { dirty = true; }
+	uint32_t GetLutVersion() const { return lutVersion; }
+	// Compares the GPU LUTs against the CPU reference next frame.
+	void ValidateLuts() { validateLuts = true; }
 };
\ No newline at end of file
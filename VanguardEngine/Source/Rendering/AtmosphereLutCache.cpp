@@ -0,0 +1,145 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/AtmosphereLutCache.h>
+#include <Rendering/Atmosphere.h>
+#include <Core/Config.h>
+#include <Utility/HashCombine.h>
+
+#include <fstream>
+
+namespace AtmosphereLutCache
+{
+	namespace
+	{
+		constexpr uint32_t magic = 0x43544156;  // "VATC"
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t modelHash;
+		};
+
+		// Followed by the texture data.
+		struct Entry
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t depth;
+			uint32_t format;
+			uint64_t size;
+		};
+	}
+
+	std::filesystem::path GetPath()
+	{
+		return Config::engineRootPath / "Cache" / "AtmosphereLuts.bin";
+	}
+
+	size_t ComputeModelHash(const AtmosphereData& model)
+	{
+		static_assert(sizeof(AtmosphereData) % sizeof(float) == 0, "Atmosphere model is expected to only contain floats.");
+
+		size_t hash = version;
+
+		const auto* values = reinterpret_cast<const float*>(&model);
+		for (size_t i = 0; i < sizeof(AtmosphereData) / sizeof(float); ++i)
+		{
+			HashCombine(hash, values[i]);
+		}
+
+		return hash;
+	}
+
+	bool Load(const std::filesystem::path& path, size_t modelHash, std::span<Texture> textures)
+	{
+		VGScopedCPUStat("Load Atmosphere LUT Cache");
+
+		std::ifstream stream{ path, std::ios::binary };
+		if (!stream.is_open())
+		{
+			return false;
+		}
+
+		Header header;
+		stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		if (!stream || header.magic != magic || header.version != version || header.modelHash != modelHash)
+		{
+			VGLog(logRendering, "Atmosphere LUT cache is out of date.");
+
+			return false;
+		}
+
+		std::vector<std::vector<uint8_t>> data(textures.size());
+
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			const auto& texture = textures[i];
+
+			Entry entry;
+			stream.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+
+			if (!stream || entry.width != texture.width || entry.height != texture.height || entry.depth != texture.depth ||
+				entry.format != (uint32_t)texture.format || entry.size != texture.data.size())
+			{
+				VGLogWarning(logRendering, "Atmosphere LUT cache has mismatched textures.");
+
+				return false;
+			}
+
+			data[i].resize(entry.size);
+			stream.read(reinterpret_cast<char*>(data[i].data()), entry.size);
+
+			if (!stream)
+			{
+				VGLogWarning(logRendering, "Atmosphere LUT cache is truncated.");
+
+				return false;
+			}
+		}
+
+		// Only hand out the data once every texture is known to be valid.
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			textures[i].data = std::move(data[i]);
+		}
+
+		return true;
+	}
+
+	bool Save(const std::filesystem::path& path, size_t modelHash, std::span<const Texture> textures)
+	{
+		VGScopedCPUStat("Save Atmosphere LUT Cache");
+
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+
+		std::ofstream stream{ path, std::ios::binary | std::ios::trunc };
+		if (!stream.is_open())
+		{
+			VGLogWarning(logRendering, "Failed to open atmosphere LUT cache '{}' for writing.", path.generic_string());
+
+			return false;
+		}
+
+		const Header header{ magic, version, modelHash };
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		for (const auto& texture : textures)
+		{
+			const Entry entry{ texture.width, texture.height, texture.depth, (uint32_t)texture.format, texture.data.size() };
+			stream.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			stream.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+		}
+
+		if (!stream)
+		{
+			VGLogWarning(logRendering, "Failed to write atmosphere LUT cache '{}'.", path.generic_string());
+
+			return false;
+		}
+
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <vector>
+#include <span>
+#include <filesystem>
+#include <cstdint>
+
+struct AtmosphereData;
+
+// On-disk cache of the precomputed atmosphere LUTs, keyed by the atmosphere model. Written after precomputing on the GPU,
+// or baked offline by the CPU reference.
+namespace AtmosphereLutCache
+{
+	constexpr uint32_t version = 1;  // Bump when the precompute shaders or LUT layouts change.
+
+	struct Texture
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		DXGI_FORMAT format;
+		std::vector<uint8_t> data;  // Tightly packed rows of the first mip.
+	};
+
+	std::filesystem::path GetPath();
+	size_t ComputeModelHash(const AtmosphereData& model);
+
+	// Textures must have their dimensions, format, and data size set, the data is filled in. Fails without modifying the
+	// data if the cache is missing, out of date, or holds different textures.
+	bool Load(const std::filesystem::path& path, size_t modelHash, std::span<Texture> textures);
+	bool Save(const std::filesystem::path& path, size_t modelHash, std::span<const Texture> textures);
+}
\ No newline at end of file
@@ -0,0 +1,1180 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/AtmosphereReference.h>
+#include <Rendering/Atmosphere.h>
+#include <Rendering/AtmosphereLutCache.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace AtmosphereReference
+{
+	namespace
+	{
+		// Ports of the functions in Atmosphere.hlsli and PhaseFunctions.hlsli, kept as close to the shaders as possible so that
+		// changes can be mirrored line by line. Texture reads emulate the bilinearClamp sampler.
+
+		XMVECTOR Load(const XMFLOAT3& value)
+		{
+			return XMLoadFloat3(&value);
+		}
+
+		float Saturate(float value)
+		{
+			return std::clamp(value, 0.f, 1.f);
+		}
+
+		float SmoothStep(float edge0, float edge1, float x)
+		{
+			const auto t = Saturate((x - edge0) / (edge1 - edge0));
+			return t * t * (3.f - 2.f * t);
+		}
+
+		XMVECTOR Fetch(const Lut& lut, int32_t x, int32_t y, int32_t z)
+		{
+			x = std::clamp(x, 0, (int32_t)lut.width - 1);
+			y = std::clamp(y, 0, (int32_t)lut.height - 1);
+			z = std::clamp(z, 0, (int32_t)lut.depth - 1);
+
+			return XMLoadFloat4(&lut.texels[lut.Index(x, y, z)]);
+		}
+
+		XMVECTOR Sample(const Lut& lut, float u, float v)
+		{
+			const auto x = u * lut.width - 0.5f;
+			const auto y = v * lut.height - 0.5f;
+			const auto x0 = std::floor(x);
+			const auto y0 = std::floor(y);
+			const auto ix = (int32_t)x0;
+			const auto iy = (int32_t)y0;
+
+			const auto row0 = XMVectorLerp(Fetch(lut, ix, iy, 0), Fetch(lut, ix + 1, iy, 0), x - x0);
+			const auto row1 = XMVectorLerp(Fetch(lut, ix, iy + 1, 0), Fetch(lut, ix + 1, iy + 1, 0), x - x0);
+
+			return XMVectorLerp(row0, row1, y - y0);
+		}
+
+		XMVECTOR Sample(const Lut& lut, float u, float v, float w)
+		{
+			const auto x = u * lut.width - 0.5f;
+			const auto y = v * lut.height - 0.5f;
+			const auto z = w * lut.depth - 0.5f;
+			const auto x0 = std::floor(x);
+			const auto y0 = std::floor(y);
+			const auto z0 = std::floor(z);
+			const auto ix = (int32_t)x0;
+			const auto iy = (int32_t)y0;
+			const auto iz = (int32_t)z0;
+
+			const auto SampleSlice = [&](int32_t slice)
+			{
+				const auto row0 = XMVectorLerp(Fetch(lut, ix, iy, slice), Fetch(lut, ix + 1, iy, slice), x - x0);
+				const auto row1 = XMVectorLerp(Fetch(lut, ix, iy + 1, slice), Fetch(lut, ix + 1, iy + 1, slice), x - x0);
+
+				return XMVectorLerp(row0, row1, y - y0);
+			};
+
+			return XMVectorLerp(SampleSlice(iz), SampleSlice(iz + 1), z - z0);
+		}
+
+		float RayleighPhase(float nu)
+		{
+			constexpr float k = 3.f / (16.f * XM_PI);
+			return k * (1.f + nu * nu);
+		}
+
+		float MiePhase(float nu, float g)
+		{
+			const float gSquared = g * g;
+			const float k = 3.f / (8.f * XM_PI) * (1.f - gSquared) / (2.f + gSquared);
+			return k * (1.f + nu * nu) / std::pow(1.f + gSquared - 2.f * g * nu, 1.5f);
+		}
+
+		float DistanceToAtmosphereTop(const AtmosphereData& atmosphere, float radius, float mu)
+		{
+			const float discriminant = radius * radius * (mu * mu - 1.f) + atmosphere.radiusTop * atmosphere.radiusTop;
+			return std::max(-radius * mu + std::sqrt(std::max(discriminant, 0.f)), 0.f);
+		}
+
+		float DistanceToAtmosphereBottom(const AtmosphereData& atmosphere, float radius, float mu)
+		{
+			const float discriminant = radius * radius * (mu * mu - 1.f) + atmosphere.radiusBottom * atmosphere.radiusBottom;
+			return std::max(-radius * mu - std::sqrt(std::max(discriminant, 0.f)), 0.f);
+		}
+
+		float DistanceToNearestAtmosphereEdge(const AtmosphereData& atmosphere, float radius, float mu, bool rayIntersectsGround)
+		{
+			return rayIntersectsGround ? DistanceToAtmosphereBottom(atmosphere, radius, mu) : DistanceToAtmosphereTop(atmosphere, radius, mu);
+		}
+
+		bool RayIntersectsGround(const AtmosphereData& atmosphere, float radius, float mu)
+		{
+			return mu < 0.f && radius * radius * (mu * mu - 1.f) + atmosphere.radiusBottom * atmosphere.radiusBottom >= 0.f;
+		}
+
+		float GetAtmosphereLayerDensity(const DensityLayer& layer, float height)
+		{
+			return Saturate(layer.exponentialCoefficient * std::exp(layer.exponentialScale * height) + layer.heightScale * height + layer.offset);
+		}
+
+		float ComputeOpticalLengthToAtmosphereTop(const AtmosphereData& atmosphere, const DensityLayer& layer, float radius, float mu)
+		{
+			constexpr int32_t steps = 500;
+
+			const float dx = DistanceToAtmosphereTop(atmosphere, radius, mu) / steps;
+			float result = 0.f;
+
+			for (int32_t i = 0; i <= steps; ++i)
+			{
+				const float d_i = i * dx;
+				const float r_i = std::sqrt(d_i * d_i + 2.f * radius * mu * d_i + radius * radius);
+				const float y_i = GetAtmosphereLayerDensity(layer, r_i - atmosphere.radiusBottom);
+				const float weight_i = (i == 0 || i == steps) ? 0.5f : 1.f;
+
+				result += y_i * weight_i * dx;
+			}
+
+			return result;
+		}
+
+		XMVECTOR ComputeTransmittanceToAtmosphereTop(const AtmosphereData& atmosphere, float radius, float mu)
+		{
+			const auto rayleigh = Load(atmosphere.rayleighScattering) * ComputeOpticalLengthToAtmosphereTop(atmosphere, atmosphere.rayleighDensity, radius, mu);
+			const auto mie = Load(atmosphere.mieExtinction) * ComputeOpticalLengthToAtmosphereTop(atmosphere, atmosphere.mieDensity, radius, mu);
+			const auto absorption = Load(atmosphere.absorptionExtinction) * ComputeOpticalLengthToAtmosphereTop(atmosphere, atmosphere.absorptionDensity, radius, mu);
+
+			return XMVectorExpE(-(rayleigh + mie + absorption));
+		}
+
+		float UnitRangeToTextureCoord(float x, int32_t textureSize)
+		{
+			return 0.5f / textureSize + x * (1.f - 1.f / textureSize);
+		}
+
+		float TextureCoordToUnitRange(float u, int32_t textureSize)
+		{
+			return (u - 0.5f / textureSize) / (1.f - 1.f / textureSize);
+		}
+
+		XMFLOAT2 GetTransmittanceLutCoord(const AtmosphereData& atmosphere, float radius, float mu, const XMFLOAT2& textureSize)
+		{
+			const float atmosphereBottomRadiusSquared = atmosphere.radiusBottom * atmosphere.radiusBottom;
+
+			const float h = std::sqrt(atmosphere.radiusTop * atmosphere.radiusTop - atmosphereBottomRadiusSquared);
+			const float rho = std::sqrt(std::max(radius * radius - atmosphereBottomRadiusSquared, 0.f));
+			const float d = DistanceToAtmosphereTop(atmosphere, radius, mu);
+			const float dMin = atmosphere.radiusTop - radius;
+			const float dMax = h + rho;
+			const float xMu = (d - dMin) / (dMax - dMin);
+			const float xRadius = rho / h;
+
+			return { UnitRangeToTextureCoord(xMu, (int32_t)textureSize.x), UnitRangeToTextureCoord(xRadius, (int32_t)textureSize.y) };
+		}
+
+		XMFLOAT2 GetTransmittanceLutData(const AtmosphereData& atmosphere, const XMFLOAT2& uv, const XMFLOAT2& textureSize)
+		{
+			const float xMu = TextureCoordToUnitRange(uv.x, (int32_t)textureSize.x);
+			const float xRadius = TextureCoordToUnitRange(uv.y, (int32_t)textureSize.y);
+
+			const float atmosphereRadiusSquared = atmosphere.radiusBottom * atmosphere.radiusBottom;
+
+			const float h = std::sqrt(atmosphere.radiusTop * atmosphere.radiusTop - atmosphereRadiusSquared);
+			const float rho = h * xRadius;
+			const float radius = std::sqrt(rho * rho + atmosphereRadiusSquared);
+			const float dMin = atmosphere.radiusTop - radius;
+			const float dMax = h + rho;
+			const float d = dMin + xMu * (dMax - dMin);
+			const float mu = d == 0.f ? 1.f : std::clamp((h * h - rho * rho - d * d) / (2.f * radius * d), -1.f, 1.f);
+
+			return { radius, mu };
+		}
+
+		XMVECTOR GetTransmittanceToAtmosphereTop(const AtmosphereData& atmosphere, const Lut& transmittanceLut, float radius, float mu)
+		{
+			const auto uv = GetTransmittanceLutCoord(atmosphere, radius, mu, { (float)transmittanceLut.width, (float)transmittanceLut.height });
+
+			return Sample(transmittanceLut, uv.x, uv.y);
+		}
+
+		XMVECTOR GetTransmittance(const AtmosphereData& atmosphere, const Lut& transmittanceLut, float radius, float mu, float d, bool rayIntersectsGround)
+		{
+			const float radius_d = std::clamp(std::sqrt(d * d + 2.f * radius * mu * d + radius * radius), atmosphere.radiusBottom, atmosphere.radiusTop);
+			const float mu_d = std::clamp((radius * mu + d) / radius_d, -1.f, 1.f);
+
+			if (rayIntersectsGround)
+			{
+				return XMVectorMin(GetTransmittanceToAtmosphereTop(atmosphere, transmittanceLut, radius_d, -mu_d) / GetTransmittanceToAtmosphereTop(atmosphere, transmittanceLut, radius, -mu), XMVectorSplatOne());
+			}
+
+			else
+			{
+				return XMVectorMin(GetTransmittanceToAtmosphereTop(atmosphere, transmittanceLut, radius, mu) / GetTransmittanceToAtmosphereTop(atmosphere, transmittanceLut, radius_d, mu_d), XMVectorSplatOne());
+			}
+		}
+
+		XMVECTOR GetTransmittanceToSun(const AtmosphereData& atmosphere, const Lut& transmittanceLut, float radius, float muS)
+		{
+			const float sinThetaH = atmosphere.radiusBottom / radius;
+			const float cosThetaH = -std::sqrt(std::max(1.f - sinThetaH * sinThetaH, 0.f));
+
+			return GetTransmittanceToAtmosphereTop(atmosphere, transmittanceLut, radius, muS) * SmoothStep(-sinThetaH * sunAngularRadius, sinThetaH * sunAngularRadius, muS - cosThetaH);
+		}
+
+		void ComputeSingleScatteringIntegrand(const AtmosphereData& atmosphere, const Lut& transmittanceLut, float radius, float mu, float muS, float nu, float d,
+			bool rayIntersectsGround, XMVECTOR& rayleigh, XMVECTOR& mie)
+		{
+			const float radius_d = std::clamp(std::sqrt(d * d + 2.f * radius * mu * d + radius * radius), atmosphere.radiusBottom, atmosphere.radiusTop);
+			const float muS_d = std::clamp((radius * muS + d * nu) / radius_d, -1.f, 1.f);
+			const auto transmittance = GetTransmittance(atmosphere, transmittanceLut, radius, mu, d, rayIntersectsGround) * GetTransmittanceToSun(atmosphere, transmittanceLut, radius_d, muS_d);
+
+			rayleigh = transmittance * GetAtmosphereLayerDensity(atmosphere.rayleighDensity, radius_d - atmosphere.radiusBottom);
+			mie = transmittance * GetAtmosphereLayerDensity(atmosphere.mieDensity, radius_d - atmosphere.radiusBottom);
+		}
+
+		void ComputeSingleScattering(const AtmosphereData& atmosphere, const Lut& transmittanceLut, float radius, float mu, float muS, float nu, bool rayIntersectsGround,
+			XMVECTOR& rayleigh, XMVECTOR& mie)
+		{
+			constexpr int32_t steps = 50;
+
+			const float dx = DistanceToNearestAtmosphereEdge(atmosphere, radius, mu, rayIntersectsGround) / steps;
+			auto rayleighSum = XMVectorZero();
+			auto mieSum = XMVectorZero();
+
+			for (int32_t i = 0; i <= steps; ++i)
+			{
+				const float d_i = i * dx;
+				XMVECTOR rayleigh_i;
+				XMVECTOR mie_i;
+				ComputeSingleScatteringIntegrand(atmosphere, transmittanceLut, radius, mu, muS, nu, d_i, rayIntersectsGround, rayleigh_i, mie_i);
+				const float weight_i = (i == 0 || i == steps) ? 0.5f : 1.f;
+
+				rayleighSum += rayleigh_i * weight_i;
+				mieSum += mie_i * weight_i;
+			}
+
+			rayleigh = rayleighSum * dx * Load(atmosphere.solarIrradiance) * Load(atmosphere.rayleighScattering);
+			mie = mieSum * dx * Load(atmosphere.solarIrradiance) * Load(atmosphere.mieScattering);
+		}
+
+		// Radius, mu, muS, nu.
+		XMFLOAT4 GetScatteringLutDimensions4D(const XMFLOAT3& textureSize)
+		{
+			constexpr float nuSize = 8.f;
+
+			return { textureSize.z, textureSize.y, textureSize.x / nuSize, nuSize };
+		}
+
+		XMFLOAT4 GetScatteringLutDimensions4D(const Lut& lut)
+		{
+			return GetScatteringLutDimensions4D(XMFLOAT3{ (float)lut.width, (float)lut.height, (float)lut.depth });
+		}
+
+		XMFLOAT4 GetScatteringLutCoord(const AtmosphereData& atmosphere, float radius, float mu, float muS, float nu, bool rayIntersectsGround, const XMFLOAT4& textureSize)
+		{
+			const float atmosphereRadiusSquared = atmosphere.radiusBottom * atmosphere.radiusBottom;
+			const float radiusSquared = radius * radius;
+
+			const float h = std::sqrt(atmosphere.radiusTop * atmosphere.radiusTop - atmosphereRadiusSquared);
+			const float rho = std::sqrt(std::max(radiusSquared - atmosphereRadiusSquared, 0.f));
+			const float uRadius = UnitRangeToTextureCoord(rho / h, (int32_t)textureSize.x);
+			const float radiusMu = radius * mu;
+			const float discriminant = radiusMu * radiusMu - radiusSquared + atmosphereRadiusSquared;
+
+			float uMu;
+			if (rayIntersectsGround)
+			{
+				const float d = -radiusMu - std::sqrt(std::max(discriminant, 0.f));
+				const float dMin = radius - atmosphere.radiusBottom;
+				const float dMax = rho;
+				uMu = 0.5f - 0.5f * UnitRangeToTextureCoord(dMax == dMin ? 0.f : (d - dMin) / (dMax - dMin), (int32_t)(textureSize.y / 2.f));
+			}
+
+			else
+			{
+				const float d = -radiusMu + std::sqrt(std::max(discriminant + h * h, 0.f));
+				const float dMin = atmosphere.radiusTop - radius;
+				const float dMax = h + rho;
+				uMu = 0.5f + 0.5f * UnitRangeToTextureCoord((d - dMin) / (dMax - dMin), (int32_t)(textureSize.y / 2.f));
+			}
+
+			const float d = DistanceToAtmosphereTop(atmosphere, atmosphere.radiusBottom, muS);
+			const float dMin = atmosphere.radiusTop - atmosphere.radiusBottom;
+			const float dMax = h;
+			const float a = (d - dMin) / (dMax - dMin);
+			const float D = DistanceToAtmosphereTop(atmosphere, atmosphere.radiusBottom, minMuS);
+			const float A = (D - dMin) / (dMax - dMin);
+			const float uMuS = UnitRangeToTextureCoord(std::max(1.f - a / A, 0.f) / (1.f + a), (int32_t)textureSize.z);
+			const float uNu = (nu + 1.f) / 2.f;
+
+			return { uNu, uMuS, uMu, uRadius };
+		}
+
+		struct ScatteringLutData
+		{
+			float radius;
+			float mu;
+			float muS;
+			float nu;
+			bool rayIntersectsGround;
+		};
+
+		ScatteringLutData GetScatteringLutData(const AtmosphereData& atmosphere, const XMFLOAT4& uvwz, const XMFLOAT4& textureSize)
+		{
+			const float atmosphereRadiusSquared = atmosphere.radiusBottom * atmosphere.radiusBottom;
+
+			const float h = std::sqrt(atmosphere.radiusTop * atmosphere.radiusTop - atmosphereRadiusSquared);
+			const float rho = h * TextureCoordToUnitRange(uvwz.w, (int32_t)textureSize.x);
+
+			ScatteringLutData lutData;
+			lutData.radius = std::sqrt(rho * rho + atmosphereRadiusSquared);
+
+			if (uvwz.z < 0.5f)
+			{
+				const float dMin = lutData.radius - atmosphere.radiusBottom;
+				const float dMax = rho;
+				const float d = dMin + (dMax - dMin) * TextureCoordToUnitRange(1.f - 2.f * uvwz.z, (int32_t)(textureSize.y / 2.f));
+				lutData.mu = d == 0.f ? -1.f : std::clamp(-(rho * rho + d * d) / (2.f * lutData.radius * d), -1.f, 1.f);
+				lutData.rayIntersectsGround = true;
+			}
+
+			else
+			{
+				const float dMin = atmosphere.radiusTop - lutData.radius;
+				const float dMax = h + rho;
+				const float d = dMin + (dMax - dMin) * TextureCoordToUnitRange(2.f * uvwz.z - 1.f, (int32_t)(textureSize.y / 2.f));
+				lutData.mu = d == 0.f ? 1.f : std::clamp((h * h - rho * rho - d * d) / (2.f * lutData.radius * d), -1.f, 1.f);
+				lutData.rayIntersectsGround = false;
+			}
+
+			const float xMuS = TextureCoordToUnitRange(uvwz.y, (int32_t)textureSize.z);
+			const float dMin = atmosphere.radiusTop - atmosphere.radiusBottom;
+			const float dMax = h;
+			const float D = DistanceToAtmosphereTop(atmosphere, atmosphere.radiusBottom, minMuS);
+			const float A = (D - dMin) / (dMax - dMin);
+			const float a = (A - xMuS * A) / (1.f + xMuS * A);
+			const float d = dMin + std::min(a, A) * (dMax - dMin);
+			lutData.muS = d == 0.f ? 1.f : std::clamp((h * h - d * d) / (2.f * atmosphere.radiusBottom * d), -1.f, 1.f);
+			lutData.nu = std::clamp(uvwz.x * 2.f - 1.f, -1.f, 1.f);
+
+			return lutData;
+		}
+
+		// Texel coordinates of the 3D texture, with the nu and muS axes packed along x.
+		ScatteringLutData GetScatteringLutData(const AtmosphereData& atmosphere, const XMFLOAT3& uvw, const XMFLOAT4& textureSize)
+		{
+			const float nuCoord = std::floor(uvw.x / textureSize.z);
+			const float muSCoord = std::fmod(uvw.x, textureSize.z);
+			const XMFLOAT4 uvwz = { nuCoord / (textureSize.w - 1.f), muSCoord / textureSize.z, uvw.y / textureSize.y, uvw.z / textureSize.x };
+
+			auto lutData = GetScatteringLutData(atmosphere, uvwz, textureSize);
+			const float muSquared = lutData.mu * lutData.mu;
+			const float muSSquared = lutData.muS * lutData.muS;
+			lutData.nu = std::clamp(lutData.nu, lutData.mu * lutData.muS - std::sqrt((1.f - muSquared) * (1.f - muSSquared)), lutData.mu * lutData.muS + std::sqrt((1.f - muSquared) * (1.f - muSSquared)));
+
+			return lutData;
+		}
+
+		// Position of a 4D lookup in the 3D texture, shared between LUTs of the same size so the coordinate math runs once.
+		struct ScatteringLookup
+		{
+			float u0;
+			float u1;
+			float v;
+			float w;
+			float lerp;
+		};
+
+		ScatteringLookup GetScatteringLookup(const AtmosphereData& atmosphere, const Lut& scatteringLut, float radius, float mu, float muS, float nu, bool rayIntersectsGround)
+		{
+			const auto textureSize = GetScatteringLutDimensions4D(scatteringLut);
+
+			const auto uvwz = GetScatteringLutCoord(atmosphere, radius, mu, muS, nu, rayIntersectsGround, textureSize);
+			const float lutCoordX = uvwz.x * (textureSize.w - 1.f);
+			const float lutX = std::floor(lutCoordX);
+
+			return { (lutX + uvwz.y) / textureSize.w, (lutX + 1.f + uvwz.y) / textureSize.w, uvwz.z, uvwz.w, lutCoordX - lutX };
+		}
+
+		XMVECTOR GetScattering(const Lut& scatteringLut, const ScatteringLookup& lookup)
+		{
+			const auto sample0 = Sample(scatteringLut, lookup.u0, lookup.v, lookup.w);
+			const auto sample1 = Sample(scatteringLut, lookup.u1, lookup.v, lookup.w);
+
+			return sample0 * (1.f - lookup.lerp) + sample1 * lookup.lerp;
+		}
+
+		XMVECTOR GetScattering(const AtmosphereData& atmosphere, const Lut& scatteringLut, float radius, float mu, float muS, float nu, bool rayIntersectsGround)
+		{
+			return GetScattering(scatteringLut, GetScatteringLookup(atmosphere, scatteringLut, radius, mu, muS, nu, rayIntersectsGround));
+		}
+
+		XMVECTOR GetScattering(const AtmosphereData& atmosphere, const Lut& singleRayleighScatteringLut, const Lut& singleMieScatteringLut, const Lut& multipleScatteringLut,
+			float radius, float mu, float muS, float nu, bool rayIntersectsGround, int32_t scatteringOrder)
+		{
+			if (scatteringOrder == 1)
+			{
+				// Both single scattering LUTs have the same dimensions.
+				const auto lookup = GetScatteringLookup(atmosphere, singleRayleighScatteringLut, radius, mu, muS, nu, rayIntersectsGround);
+				const auto rayleigh = GetScattering(singleRayleighScatteringLut, lookup);
+				const auto mie = GetScattering(singleMieScatteringLut, lookup);
+
+				return rayleigh * RayleighPhase(nu) + mie * MiePhase(nu, mieAnisotropy);
+			}
+
+			else
+			{
+				return GetScattering(atmosphere, multipleScatteringLut, radius, mu, muS, nu, rayIntersectsGround);
+			}
+		}
+
+		XMVECTOR ComputeDirectIrradiance(const AtmosphereData& atmosphere, const Lut& transmittanceLut, float radius, float muS)
+		{
+			const float alphaS = sunAngularRadius;
+			const float avgCosFactor = muS < -alphaS ? 0.f : (muS > alphaS ? muS : (muS + alphaS) * (muS + alphaS) / (4.f * alphaS));
+
+			return Load(atmosphere.solarIrradiance) * GetTransmittanceToAtmosphereTop(atmosphere, transmittanceLut, radius, muS) * avgCosFactor;
+		}
+
+		XMVECTOR ComputeIndirectIrradiance(const AtmosphereData& atmosphere, const Lut& singleRayleighScatteringLut, const Lut& singleMieScatteringLut, const Lut& multipleScatteringLut,
+			float radius, float muS, int32_t scatteringOrder)
+		{
+			constexpr int32_t steps = 32;
+
+			const float dTheta = XM_PI / steps;
+			const float dPhi = XM_PI / steps;
+
+			auto result = XMVectorZero();
+			const auto omegaS = XMVectorSet(std::sqrt(1.f - muS * muS), 0.f, muS, 0.f);
+
+			for (int32_t i = 0; i < steps / 2; ++i)
+			{
+				const float theta = (i + 0.5f) * dTheta;
+
+				for (int32_t j = 0; j < steps * 2; ++j)
+				{
+					const float phi = (j + 0.5f) * dPhi;
+					const auto omega = XMVectorSet(std::cos(phi) * std::sin(theta), std::sin(phi) * std::sin(theta), std::cos(theta), 0.f);
+					const float dOmega = dTheta * dPhi * std::sin(theta);
+					const float nu = XMVectorGetX(XMVector3Dot(omega, omegaS));
+					const float omegaZ = XMVectorGetZ(omega);
+
+					result += GetScattering(atmosphere, singleRayleighScatteringLut, singleMieScatteringLut, multipleScatteringLut, radius, omegaZ, muS, nu, false, scatteringOrder) * omegaZ * dOmega;
+				}
+			}
+
+			return result;
+		}
+
+		XMFLOAT2 GetIrradianceLutCoord(const AtmosphereData& atmosphere, float radius, float muS, const XMFLOAT2& textureSize)
+		{
+			const float xRadius = (radius - atmosphere.radiusBottom) / (atmosphere.radiusTop - atmosphere.radiusBottom);
+			const float xMuS = muS * 0.5f + 0.5f;
+
+			return { UnitRangeToTextureCoord(xMuS, (int32_t)textureSize.x), UnitRangeToTextureCoord(xRadius, (int32_t)textureSize.y) };
+		}
+
+		XMFLOAT2 GetIrradianceLutData(const AtmosphereData& atmosphere, const XMFLOAT2& uv, const XMFLOAT2& textureSize)
+		{
+			const float xMuS = TextureCoordToUnitRange(uv.x, (int32_t)textureSize.x);
+			const float xRadius = TextureCoordToUnitRange(uv.y, (int32_t)textureSize.y);
+
+			return { atmosphere.radiusBottom + xRadius * (atmosphere.radiusTop - atmosphere.radiusBottom), std::clamp(2.f * xMuS - 1.f, -1.f, 1.f) };
+		}
+
+		XMVECTOR GetIrradiance(const AtmosphereData& atmosphere, const Lut& irradianceLut, float radius, float muS)
+		{
+			const auto uv = GetIrradianceLutCoord(atmosphere, radius, muS, { (float)irradianceLut.width, (float)irradianceLut.height });
+
+			return Sample(irradianceLut, uv.x, uv.y);
+		}
+
+		XMVECTOR ComputeScatteringDensity(const AtmosphereData& atmosphere, const Lut& transmittanceLut, const Lut& singleRayleighScatteringLut, const Lut& singleMieScatteringLut,
+			const Lut& multipleScatteringLut, const Lut& irradianceLut, float radius, float mu, float muS, float nu, int32_t scatteringOrder)
+		{
+			const auto zenithDirection = XMVectorSet(0.f, 0.f, 1.f, 0.f);
+			const auto omega = XMVectorSet(std::sqrt(1.f - mu * mu), 0.f, mu, 0.f);
+			const float omegaX = XMVectorGetX(omega);
+			const float sunDirectionX = omegaX == 0.f ? 0.f : (nu - mu * muS) / omegaX;
+			const float sunDirectionY = std::sqrt(std::max(1.f - sunDirectionX * sunDirectionX - muS * muS, 0.f));
+			const auto omegaS = XMVectorSet(sunDirectionX, sunDirectionY, muS, 0.f);
+
+			constexpr int32_t steps = 16;
+
+			const float dTheta = XM_PI / steps;
+			const float dPhi = XM_PI / steps;
+			auto rayleighMie = XMVectorZero();
+
+			// Constant along the integration, hoisted out of the loop unlike the shader.
+			const float rayleighDensity = GetAtmosphereLayerDensity(atmosphere.rayleighDensity, radius - atmosphere.radiusBottom);
+			const float mieDensity = GetAtmosphereLayerDensity(atmosphere.mieDensity, radius - atmosphere.radiusBottom);
+			const auto rayleighScattering = Load(atmosphere.rayleighScattering) * rayleighDensity;
+			const auto mieScattering = Load(atmosphere.mieScattering) * mieDensity;
+
+			// The integration directions are the same for every texel.
+			static const auto directions = [&]
+			{
+				std::vector<XMFLOAT4> result;  // Direction and solid angle.
+				result.reserve(steps * steps * 2);
+
+				for (int32_t i = 0; i < steps; ++i)
+				{
+					const float theta = (i + 0.5f) * dTheta;
+					const float cosTheta = std::cos(theta);
+					const float sinTheta = std::sin(theta);
+
+					for (int32_t j = 0; j < steps * 2; ++j)
+					{
+						const float phi = (j + 0.5f) * dPhi;
+						result.emplace_back(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta, dTheta * dPhi * sinTheta);
+					}
+				}
+
+				return result;
+			}();
+
+			for (int32_t i = 0; i < steps; ++i)
+			{
+				const float cosTheta = directions[i * steps * 2].z;
+				const bool rayIntersectsGround = RayIntersectsGround(atmosphere, radius, cosTheta);
+
+				float distanceToGround = 0.f;
+				auto transmittanceToGround = XMVectorZero();
+				auto groundAlbedo = XMVectorZero();
+
+				if (rayIntersectsGround)
+				{
+					distanceToGround = DistanceToAtmosphereBottom(atmosphere, radius, cosTheta);
+					transmittanceToGround = GetTransmittance(atmosphere, transmittanceLut, radius, cosTheta, distanceToGround, true);
+					groundAlbedo = Load(atmosphere.surfaceColor);
+				}
+
+				for (int32_t j = 0; j < steps * 2; ++j)
+				{
+					const auto& direction = directions[i * steps * 2 + j];
+					const auto omegaI = XMVectorSet(direction.x, direction.y, direction.z, 0.f);
+					const float dOmegaI = direction.w;
+
+					const float nu1 = XMVectorGetX(XMVector3Dot(omegaS, omegaI));
+					auto incidentRadiance = GetScattering(atmosphere, singleRayleighScatteringLut, singleMieScatteringLut, multipleScatteringLut, radius, cosTheta, muS, nu1,
+						rayIntersectsGround, scatteringOrder - 1);
+
+					// The shader weights the ground term by a zero transmittance when the ray misses the ground, skip the lookup instead.
+					if (rayIntersectsGround)
+					{
+						const auto groundNormal = XMVector3Normalize(zenithDirection * radius + omegaI * distanceToGround);
+						const auto groundIrradiance = GetIrradiance(atmosphere, irradianceLut, atmosphere.radiusBottom, XMVectorGetX(XMVector3Dot(groundNormal, omegaS)));
+						incidentRadiance += transmittanceToGround * groundAlbedo * groundIrradiance / XM_PI;
+					}
+
+					const float nu2 = XMVectorGetX(XMVector3Dot(omega, omegaI));
+
+					rayleighMie += incidentRadiance * (rayleighScattering * RayleighPhase(nu2) + mieScattering * MiePhase(nu2, mieAnisotropy)) * dOmegaI;
+				}
+			}
+
+			return rayleighMie;
+		}
+
+		XMVECTOR ComputeMultipleScattering(const AtmosphereData& atmosphere, const Lut& transmittanceLut, const Lut& scatteringDensityLut, float radius, float mu, float muS, float nu,
+			bool rayIntersectsGround)
+		{
+			constexpr int32_t steps = 50;
+
+			const float dx = DistanceToNearestAtmosphereEdge(atmosphere, radius, mu, rayIntersectsGround) / steps;
+			auto sum = XMVectorZero();
+
+			for (int32_t i = 0; i <= steps; ++i)
+			{
+				const float dI = i * dx;
+				const float radiusI = std::clamp(std::sqrt(dI * dI + 2.f * radius * mu * dI + radius * radius), atmosphere.radiusBottom, atmosphere.radiusTop);
+				const float muI = std::clamp((radius * mu + dI) / radiusI, -1.f, 1.f);
+				const float muSI = std::clamp((radius * muS + dI * nu) / radiusI, -1.f, 1.f);
+
+				const auto rayleighMieI = GetScattering(atmosphere, scatteringDensityLut, radiusI, muI, muSI, nu, rayIntersectsGround) *
+					GetTransmittance(atmosphere, transmittanceLut, radius, mu, dI, rayIntersectsGround) * dx;
+				const float weightI = (i == 0 || i == steps) ? 0.5f : 1.f;
+
+				sum += rayleighMieI * weightI;
+			}
+
+			return sum;
+		}
+
+		// Equivalent of a dispatch over every texel, rows are distributed across threads. The function receives the texel
+		// coordinates and normalized texel center, like DispatchToLutCoords.
+		template <typename Function>
+		void ForEachTexel(const Lut& lut, bool parallel, Function&& function)
+		{
+			std::vector<uint32_t> rows(lut.height * lut.depth);
+			std::iota(rows.begin(), rows.end(), 0);
+
+			const auto ProcessRow = [&](uint32_t row)
+			{
+				const auto y = row % lut.height;
+				const auto z = row / lut.height;
+
+				for (uint32_t x = 0; x < lut.width; ++x)
+				{
+					const XMFLOAT3 uvw = { (x + 0.5f) / lut.width, (y + 0.5f) / lut.height, (z + 0.5f) / lut.depth };
+					function(x, y, z, uvw);
+				}
+			};
+
+			if (parallel)
+			{
+				std::for_each(std::execution::par, rows.begin(), rows.end(), ProcessRow);
+			}
+
+			else
+			{
+				std::for_each(rows.begin(), rows.end(), ProcessRow);
+			}
+		}
+
+		// Texel coordinates of a texel center, as computed by the shaders from the normalized coordinates.
+		XMFLOAT3 ToTexels(const XMFLOAT3& uvw, const Lut& lut)
+		{
+			return { uvw.x * lut.width, uvw.y * lut.height, uvw.z * lut.depth };
+		}
+
+		double MeanRadiance(const Lut& lut)
+		{
+			double sum = 0.0;
+			for (const auto& texel : lut.texels)
+			{
+				sum += texel.x;
+			}
+
+			return lut.texels.empty() ? 0.0 : sum / lut.texels.size();
+		}
+
+		std::vector<uint8_t> ToBytes(const Lut& lut)
+		{
+			std::vector<uint8_t> data(lut.texels.size() * sizeof(XMFLOAT4));
+			std::memcpy(data.data(), lut.texels.data(), data.size());
+
+			return data;
+		}
+
+		double Elapsed(std::chrono::high_resolution_clock::time_point& begin)
+		{
+			const auto end = std::chrono::high_resolution_clock::now();
+			const auto elapsed = std::chrono::duration<double, std::milli>(end - begin).count();
+			begin = end;
+
+			return elapsed;
+		}
+	}
+
+	void Lut::Resize(const XMUINT3& size)
+	{
+		width = size.x;
+		height = size.y;
+		depth = size.z;
+		texels.assign((size_t)width * height * depth, XMFLOAT4{ 0.f, 0.f, 0.f, 0.f });
+	}
+
+	void Precompute(const AtmosphereData& atmosphere, const Settings& settings, Luts& output, PrecomputeStats* stats)
+	{
+		VGScopedCPUStat("Atmosphere Reference Precompute");
+
+		VGAssert(settings.scatteringSize.x % 8 == 0, "Scattering LUT width must be a multiple of the nu size.");
+
+		auto& transmittance = output.transmittance;
+		auto& scattering = output.scattering;
+		auto& irradiance = output.irradiance;
+
+		Lut deltaRayleigh;
+		Lut deltaMie;
+		Lut deltaScatteringDensity;
+		Lut deltaIrradiance;
+
+		transmittance.Resize(settings.transmittanceSize);
+		scattering.Resize(settings.scatteringSize);
+		irradiance.Resize(settings.irradianceSize);
+		deltaRayleigh.Resize(settings.scatteringSize);
+		deltaMie.Resize(settings.scatteringSize);
+		deltaScatteringDensity.Resize(settings.scatteringSize);
+		deltaIrradiance.Resize(settings.irradianceSize);
+
+		PrecomputeStats localStats;
+		auto& result = stats ? *stats : localStats;
+		result = {};
+
+		auto begin = std::chrono::high_resolution_clock::now();
+
+		// Transmission.
+
+		ForEachTexel(transmittance, settings.parallel, [&](uint32_t x, uint32_t y, uint32_t z, const XMFLOAT3& uvw)
+		{
+			const XMFLOAT2 dimensions = { (float)transmittance.width, (float)transmittance.height };
+			const auto radiusMu = GetTransmittanceLutData(atmosphere, { uvw.x, uvw.y }, dimensions);
+
+			XMStoreFloat4(&transmittance.texels[transmittance.Index(x, y, z)], XMVectorSetW(ComputeTransmittanceToAtmosphereTop(atmosphere, radiusMu.x, radiusMu.y), 1.f));
+		});
+
+		result.transmittance = Elapsed(begin);
+
+		// Direct irradiance.
+
+		ForEachTexel(irradiance, settings.parallel, [&](uint32_t x, uint32_t y, uint32_t z, const XMFLOAT3& uvw)
+		{
+			const XMFLOAT2 dimensions = { (float)irradiance.width, (float)irradiance.height };
+			const auto lutData = GetIrradianceLutData(atmosphere, { uvw.x, uvw.y }, dimensions);
+
+			XMStoreFloat4(&deltaIrradiance.texels[deltaIrradiance.Index(x, y, z)], XMVectorSetW(ComputeDirectIrradiance(atmosphere, transmittance, lutData.x, lutData.y), 0.f));
+			irradiance.texels[irradiance.Index(x, y, z)] = { 0.f, 0.f, 0.f, 0.f };
+		});
+
+		result.directIrradiance = Elapsed(begin);
+
+		// Single scattering.
+
+		ForEachTexel(scattering, settings.parallel, [&](uint32_t x, uint32_t y, uint32_t z, const XMFLOAT3& uvw)
+		{
+			const auto lutData = GetScatteringLutData(atmosphere, ToTexels(uvw, scattering), GetScatteringLutDimensions4D(scattering));
+
+			XMVECTOR rayleigh;
+			XMVECTOR mie;
+			ComputeSingleScattering(atmosphere, transmittance, lutData.radius, lutData.mu, lutData.muS, lutData.nu, lutData.rayIntersectsGround, rayleigh, mie);
+
+			const auto index = scattering.Index(x, y, z);
+			XMStoreFloat4(&deltaRayleigh.texels[index], XMVectorSetW(rayleigh, 0.f));
+			XMStoreFloat4(&deltaMie.texels[index], XMVectorSetW(mie, 0.f));
+			XMStoreFloat4(&scattering.texels[index], XMVectorSetW(rayleigh, XMVectorGetX(mie)));
+		});
+
+		result.singleScattering = Elapsed(begin);
+		result.orderRadiance.emplace_back(MeanRadiance(deltaRayleigh));
+
+		for (int32_t order = 2; order <= settings.scatteringOrders; ++order)
+		{
+			// Scattering density.
+
+			ForEachTexel(deltaScatteringDensity, settings.parallel, [&](uint32_t x, uint32_t y, uint32_t z, const XMFLOAT3& uvw)
+			{
+				const auto lutData = GetScatteringLutData(atmosphere, ToTexels(uvw, deltaRayleigh), GetScatteringLutDimensions4D(deltaRayleigh));
+				const auto density = ComputeScatteringDensity(atmosphere, transmittance, deltaRayleigh, deltaMie, deltaRayleigh, deltaIrradiance, lutData.radius, lutData.mu,
+					lutData.muS, lutData.nu, order);
+
+				XMStoreFloat4(&deltaScatteringDensity.texels[deltaScatteringDensity.Index(x, y, z)], XMVectorSetW(density, 0.f));
+			});
+
+			result.scatteringDensity.emplace_back(Elapsed(begin));
+
+			// Indirect irradiance.
+
+			ForEachTexel(irradiance, settings.parallel, [&](uint32_t x, uint32_t y, uint32_t z, const XMFLOAT3& uvw)
+			{
+				const XMFLOAT2 dimensions = { (float)irradiance.width, (float)irradiance.height };
+				const auto lutData = GetIrradianceLutData(atmosphere, { uvw.x, uvw.y }, dimensions);
+				const auto indirectIrradiance = XMVectorSetW(ComputeIndirectIrradiance(atmosphere, deltaRayleigh, deltaMie, deltaRayleigh, lutData.x, lutData.y, order - 1), 0.f);
+
+				const auto index = irradiance.Index(x, y, z);
+				XMStoreFloat4(&deltaIrradiance.texels[index], indirectIrradiance);
+				XMStoreFloat4(&irradiance.texels[index], XMLoadFloat4(&irradiance.texels[index]) + indirectIrradiance);  // Accumulate irradiance.
+			});
+
+			result.indirectIrradiance.emplace_back(Elapsed(begin));
+
+			// Multiple scattering.
+
+			ForEachTexel(scattering, settings.parallel, [&](uint32_t x, uint32_t y, uint32_t z, const XMFLOAT3& uvw)
+			{
+				const auto lutData = GetScatteringLutData(atmosphere, ToTexels(uvw, deltaScatteringDensity), GetScatteringLutDimensions4D(deltaScatteringDensity));
+				const auto multipleScattering = ComputeMultipleScattering(atmosphere, transmittance, deltaScatteringDensity, lutData.radius, lutData.mu, lutData.muS, lutData.nu,
+					lutData.rayIntersectsGround);
+
+				const auto index = scattering.Index(x, y, z);
+				XMStoreFloat4(&deltaRayleigh.texels[index], XMVectorSetW(multipleScattering, 0.f));
+				XMStoreFloat4(&scattering.texels[index], XMLoadFloat4(&scattering.texels[index]) + XMVectorSetW(multipleScattering / RayleighPhase(lutData.nu), 0.f));  // Accumulate scattering.
+			});
+
+			result.multipleScattering.emplace_back(Elapsed(begin));
+			result.orderRadiance.emplace_back(MeanRadiance(deltaRayleigh));
+		}
+	}
+
+	bool SaveLutCache(const AtmosphereData& atmosphere, const Luts& luts, const std::filesystem::path& path)
+	{
+		const auto CreateTexture = [](const Lut& lut)
+		{
+			return AtmosphereLutCache::Texture{ lut.width, lut.height, lut.depth, DXGI_FORMAT_R32G32B32A32_FLOAT, ToBytes(lut) };
+		};
+
+		const std::vector<AtmosphereLutCache::Texture> textures = { CreateTexture(luts.transmittance), CreateTexture(luts.scattering), CreateTexture(luts.irradiance) };
+
+		return AtmosphereLutCache::Save(path, AtmosphereLutCache::ComputeModelHash(atmosphere), textures);
+	}
+
+	bool BakeLutCache(const AtmosphereData& atmosphere, const std::filesystem::path& path)
+	{
+		VGScopedCPUStat("Bake Atmosphere LUT Cache");
+
+		const auto begin = std::chrono::high_resolution_clock::now();
+
+		Luts luts;
+		Precompute(atmosphere, Settings{}, luts);
+
+		if (!SaveLutCache(atmosphere, luts, path))
+		{
+			VGLogError(logRendering, "Failed to bake atmosphere LUT cache '{}'.", path.generic_string());
+
+			return false;
+		}
+
+		const auto end = std::chrono::high_resolution_clock::now();
+		VGLog(logRendering, "Baked atmosphere LUT cache '{}' in {:.1f} ms.", path.generic_string(), std::chrono::duration<double, std::milli>(end - begin).count());
+
+		return true;
+	}
+
+	LutError Compare(const Lut& reference, const std::vector<uint8_t>& data, float absoluteFloor)
+	{
+		if (data.size() != reference.texels.size() * sizeof(XMFLOAT4))
+		{
+			constexpr auto infinity = std::numeric_limits<float>::infinity();
+			return { infinity, infinity, infinity };
+		}
+
+		const auto* values = reinterpret_cast<const float*>(data.data());
+		const auto* referenceValues = reinterpret_cast<const float*>(reference.texels.data());
+
+		LutError error;
+		double relativeSum = 0.0;
+		size_t relativeCount = 0;
+
+		for (size_t i = 0; i < reference.texels.size() * 4; ++i)
+		{
+			const auto difference = std::abs(values[i] - referenceValues[i]);
+			const auto magnitude = std::max(std::abs(values[i]), std::abs(referenceValues[i]));
+
+			// Also catches non-finite values, which fail every comparison.
+			if (!(difference <= error.maxAbsolute))
+			{
+				error.maxAbsolute = difference;
+			}
+
+			if (magnitude > absoluteFloor)
+			{
+				const auto relative = difference / magnitude;
+				error.maxRelative = std::max(error.maxRelative, relative);
+				relativeSum += relative;
+				++relativeCount;
+			}
+		}
+
+		error.meanRelative = relativeCount > 0 ? (float)(relativeSum / relativeCount) : 0.f;
+
+		return error;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Atmosphere Reference Test");
+
+		Seed({ 4242 });
+
+		TestReport report{ logRendering, VGText("Atmosphere reference") };
+
+		const auto atmosphere = Atmosphere::CreateDefaultModel();
+
+		// Parameterizations, texel centers must map back onto themselves.
+		{
+			const XMFLOAT2 dimensions = { (float)transmittanceLutSize.x, (float)transmittanceLutSize.y };
+			float maxError = 0.f;
+
+			for (uint32_t y = 0; y < transmittanceLutSize.y; ++y)
+			{
+				for (uint32_t x = 0; x < transmittanceLutSize.x; ++x)
+				{
+					const XMFLOAT2 uv = { (x + 0.5f) / dimensions.x, (y + 0.5f) / dimensions.y };
+					const auto radiusMu = GetTransmittanceLutData(atmosphere, uv, dimensions);
+					const auto roundTrip = GetTransmittanceLutCoord(atmosphere, radiusMu.x, radiusMu.y, dimensions);
+
+					maxError = std::max({ maxError, std::abs(roundTrip.x - uv.x) * dimensions.x, std::abs(roundTrip.y - uv.y) * dimensions.y });
+				}
+			}
+
+			report.Check(maxError < 0.05f, "transmittance parameterization doesn't round trip");
+		}
+
+		{
+			const XMFLOAT2 dimensions = { (float)irradianceLutSize.x, (float)irradianceLutSize.y };
+			float maxError = 0.f;
+
+			for (uint32_t y = 0; y < irradianceLutSize.y; ++y)
+			{
+				for (uint32_t x = 0; x < irradianceLutSize.x; ++x)
+				{
+					const XMFLOAT2 uv = { (x + 0.5f) / dimensions.x, (y + 0.5f) / dimensions.y };
+					const auto lutData = GetIrradianceLutData(atmosphere, uv, dimensions);
+					const auto roundTrip = GetIrradianceLutCoord(atmosphere, lutData.x, lutData.y, dimensions);
+
+					maxError = std::max({ maxError, std::abs(roundTrip.x - uv.x) * dimensions.x, std::abs(roundTrip.y - uv.y) * dimensions.y });
+				}
+			}
+
+			report.Check(maxError < 0.05f, "irradiance parameterization doesn't round trip");
+		}
+
+		{
+			const auto textureSize = GetScatteringLutDimensions4D(XMFLOAT3{ (float)scatteringLutSize.x, (float)scatteringLutSize.y, (float)scatteringLutSize.z });
+			float maxError = 0.f;
+			bool groundFlags = true;
+
+			// The ground slice and the horizon are degenerate, rays there can't be mapped back uniquely.
+			for (uint32_t z = 1; z < scatteringLutSize.z; ++z)
+			{
+				for (uint32_t y = 0; y < scatteringLutSize.y; ++y)
+				{
+					for (uint32_t muS = 0; muS < (uint32_t)textureSize.z; ++muS)
+					{
+						const XMFLOAT4 uvwz = { 0.5f, (muS + 0.5f) / textureSize.z, (y + 0.5f) / textureSize.y, (z + 0.5f) / textureSize.x };
+						const auto lutData = GetScatteringLutData(atmosphere, uvwz, textureSize);
+						const auto horizonMu = -std::sqrt(1.f - (atmosphere.radiusBottom / lutData.radius) * (atmosphere.radiusBottom / lutData.radius));
+
+						if (std::abs(lutData.mu - horizonMu) < 1e-3f)
+						{
+							continue;
+						}
+
+						const auto roundTrip = GetScatteringLutCoord(atmosphere, lutData.radius, lutData.mu, lutData.muS, lutData.nu, lutData.rayIntersectsGround, textureSize);
+
+						maxError = std::max({ maxError, std::abs(roundTrip.y - uvwz.y) * textureSize.z, std::abs(roundTrip.z - uvwz.z) * textureSize.y,
+							std::abs(roundTrip.w - uvwz.w) * textureSize.x });
+
+						// Rays in the lower half of the mu axis hit the ground.
+						groundFlags = groundFlags && lutData.rayIntersectsGround == RayIntersectsGround(atmosphere, lutData.radius, lutData.mu);
+					}
+				}
+			}
+
+			// Float precision of the distance based mapping is lowest close to the horizon.
+			report.Check(maxError < 0.25f, "scattering parameterization doesn't round trip");
+			report.Check(groundFlags, "scattering parameterization disagrees on ground intersections");
+		}
+
+		// Reduced LUTs keep the test fast, the math doesn't depend on the resolution.
+		Settings settings{};
+		settings.scatteringSize = { 128, 64, 16 };
+
+		Luts single;
+		Settings singleSettings = settings;
+		singleSettings.scatteringOrders = 1;
+		Precompute(atmosphere, singleSettings, single);
+
+		Luts multiple;
+		PrecomputeStats stats;
+		Precompute(atmosphere, settings, multiple, &stats);
+
+		const auto Valid = [](const Lut& lut, float maxValue)
+		{
+			return std::all_of(lut.texels.begin(), lut.texels.end(), [maxValue](const XMFLOAT4& texel)
+			{
+				const float values[] = { texel.x, texel.y, texel.z, texel.w };
+				return std::all_of(std::begin(values), std::end(values), [maxValue](float value) { return std::isfinite(value) && value >= 0.f && value <= maxValue; });
+			});
+		};
+
+		report.Check(Valid(multiple.transmittance, 1.f), "transmittance must be within [0, 1]");
+		report.Check(Valid(multiple.scattering, 1e3f), "scattering must be finite and non-negative");
+		report.Check(Valid(multiple.irradiance, 1e3f), "irradiance must be finite and non-negative");
+
+		// Looking straight up from the top of the atmosphere passes through nothing.
+		const auto topTransmittance = GetTransmittanceToAtmosphereTop(atmosphere, multiple.transmittance, atmosphere.radiusTop, 1.f);
+		report.Check(XMVector3NearEqual(topTransmittance, XMVectorSplatOne(), XMVectorReplicate(1e-4f)), "transmittance at the top of the atmosphere should be one");
+
+		// Rays further from the zenith are longer, so along the ground row transmittance only decreases.
+		{
+			bool monotonic = true;
+			for (uint32_t x = 1; x < multiple.transmittance.width; ++x)
+			{
+				const auto& previous = multiple.transmittance.texels[multiple.transmittance.Index(x - 1, 0)];
+				const auto& current = multiple.transmittance.texels[multiple.transmittance.Index(x, 0)];
+				monotonic = monotonic && current.x <= previous.x * (1.f + 1e-5f) && current.y <= previous.y * (1.f + 1e-5f) && current.z <= previous.z * (1.f + 1e-5f);
+			}
+
+			report.Check(monotonic, "transmittance should decrease away from the zenith");
+		}
+
+		// The LUT is only an interpolation of the integral.
+		{
+			float maxError = 0.f;
+			for (int i = 0; i < 200; ++i)
+			{
+				const auto radius = (float)Rand(atmosphere.radiusBottom, atmosphere.radiusTop);
+				const auto mu = (float)Rand(0.1, 1.0);
+
+				const auto lutValue = GetTransmittanceToAtmosphereTop(atmosphere, multiple.transmittance, radius, mu);
+				const auto integrated = ComputeTransmittanceToAtmosphereTop(atmosphere, radius, mu);
+				maxError = std::max(maxError, XMVectorGetX(XMVector3LengthEst(lutValue - integrated)));
+			}
+
+			report.Check(maxError < 0.01f, "transmittance LUT doesn't match the integral");
+		}
+
+		{
+			float maxError = 0.f;
+			for (int i = 0; i < 200; ++i)
+			{
+				// Radiance falls off too steeply near the top of the atmosphere for the reduced radius resolution.
+				const auto radius = (float)Rand(atmosphere.radiusBottom, atmosphere.radiusBottom + 40.0);
+				const auto mu = (float)Rand(0.2, 1.0);
+				const auto muS = (float)Rand(0.2, 1.0);
+				const auto nu = mu * muS + std::sqrt((1.f - mu * mu) * (1.f - muS * muS)) * (float)Rand(-1.0, 1.0);
+
+				const auto lutValue = GetScattering(atmosphere, single.scattering, radius, mu, muS, nu, false);
+
+				XMVECTOR rayleigh;
+				XMVECTOR mie;
+				ComputeSingleScattering(atmosphere, single.transmittance, radius, mu, muS, nu, false, rayleigh, mie);
+
+				const auto relative = XMVectorGetX(XMVector3Length(lutValue - rayleigh)) / XMVectorGetX(XMVector3Length(rayleigh));
+				maxError = std::max(maxError, relative);
+			}
+
+			report.Check(maxError < 0.1f, "single scattering LUT doesn't match the integral");
+		}
+
+		// Every order adds light, and without multiple scattering there is no indirect irradiance.
+		{
+			bool increasing = true;
+			for (size_t i = 0; i < multiple.scattering.texels.size(); ++i)
+			{
+				const auto& singleTexel = single.scattering.texels[i];
+				const auto& multipleTexel = multiple.scattering.texels[i];
+				increasing = increasing && multipleTexel.x >= singleTexel.x && multipleTexel.y >= singleTexel.y && multipleTexel.z >= singleTexel.z && multipleTexel.w == singleTexel.w;
+			}
+
+			report.Check(increasing, "multiple scattering should only add to single scattering");
+			report.Check(std::all_of(single.irradiance.texels.begin(), single.irradiance.texels.end(), [](const XMFLOAT4& texel) { return texel.x == 0.f && texel.y == 0.f && texel.z == 0.f; }),
+				"single scattering shouldn't produce indirect irradiance");
+
+			// Noon on the ground is lit by the sky.
+			const auto& noon = multiple.irradiance.texels[multiple.irradiance.Index(multiple.irradiance.width - 1, 0)];
+			report.Check(noon.x > 0.f && noon.y > 0.f && noon.z > 0.f, "ground should receive indirect irradiance at noon");
+
+			bool decaying = stats.orderRadiance.size() == (size_t)settings.scatteringOrders;
+			for (size_t i = 1; decaying && i < stats.orderRadiance.size(); ++i)
+			{
+				decaying = stats.orderRadiance[i] > 0.0 && stats.orderRadiance[i] < stats.orderRadiance[i - 1];
+			}
+
+			report.Check(decaying, "each scattering order should carry less energy than the previous");
+		}
+
+		// Threading must not change the result.
+		{
+			Settings small{};
+			small.transmittanceSize = { 64, 16, 1 };
+			small.scatteringSize = { 32, 16, 4 };
+			small.irradianceSize = { 16, 4, 1 };
+			small.scatteringOrders = 2;
+
+			Luts parallel;
+			Precompute(atmosphere, small, parallel);
+
+			small.parallel = false;
+			Luts serial;
+			Precompute(atmosphere, small, serial);
+
+			report.Check(ToBytes(parallel.transmittance) == ToBytes(serial.transmittance) && ToBytes(parallel.scattering) == ToBytes(serial.scattering) &&
+				ToBytes(parallel.irradiance) == ToBytes(serial.irradiance), "parallel and serial precompute differ");
+
+			const auto comparison = Compare(serial.scattering, ToBytes(parallel.scattering));
+			report.Check(comparison.maxAbsolute == 0.f && comparison.maxRelative == 0.f, "comparison of identical LUTs reports an error");
+
+			// Cache round trip, through the loader the renderer uses.
+			const auto path = std::filesystem::temp_directory_path() / "VanguardAtmosphereReferenceTest.bin";
+			report.Check(SaveLutCache(atmosphere, serial, path), "failed to save the LUT cache");
+
+			const auto modelHash = AtmosphereLutCache::ComputeModelHash(atmosphere);
+			const auto CreateTexture = [](const Lut& lut)
+			{
+				return AtmosphereLutCache::Texture{ lut.width, lut.height, lut.depth, DXGI_FORMAT_R32G32B32A32_FLOAT, std::vector<uint8_t>(lut.texels.size() * sizeof(XMFLOAT4)) };
+			};
+
+			std::vector<AtmosphereLutCache::Texture> textures = { CreateTexture(serial.transmittance), CreateTexture(serial.scattering), CreateTexture(serial.irradiance) };
+			report.Check(AtmosphereLutCache::Load(path, modelHash, textures), "failed to load the LUT cache");
+			report.Check(textures[0].data == ToBytes(serial.transmittance) && textures[1].data == ToBytes(serial.scattering) && textures[2].data == ToBytes(serial.irradiance),
+				"LUT cache round trip changed the data");
+
+			auto otherModel = atmosphere;
+			otherModel.surfaceColor.x += 0.1f;
+			report.Check(!AtmosphereLutCache::Load(path, AtmosphereLutCache::ComputeModelHash(otherModel), textures), "LUT cache loaded for a different model");
+
+			textures[1].width *= 2;
+			report.Check(!AtmosphereLutCache::Load(path, modelHash, textures), "LUT cache loaded into mismatched textures");
+
+			std::error_code error;
+			std::filesystem::remove(path, error);
+		}
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Atmosphere Reference Benchmark");
+
+		const auto atmosphere = Atmosphere::CreateDefaultModel();
+
+		VGLog(logRendering, "Atmosphere reference benchmark: {} hardware threads.", std::thread::hardware_concurrency());
+
+		// Full resolution, as baked into the cache.
+		{
+			Luts luts;
+			PrecomputeStats stats;
+			Precompute(atmosphere, Settings{}, luts, &stats);
+
+			auto total = stats.transmittance + stats.directIrradiance + stats.singleScattering;
+
+			VGLog(logRendering, "  Transmittance {:.1f} ms, direct irradiance {:.1f} ms, single scattering {:.1f} ms.", stats.transmittance, stats.directIrradiance, stats.singleScattering);
+
+			for (size_t i = 0; i < stats.scatteringDensity.size(); ++i)
+			{
+				const auto orderTotal = stats.scatteringDensity[i] + stats.indirectIrradiance[i] + stats.multipleScattering[i];
+				total += orderTotal;
+
+				// Contribution relative to single scattering, shows where more orders stop being worth their cost.
+				VGLog(logRendering, "  Order {}: {:.1f} ms (density {:.1f} ms, indirect irradiance {:.1f} ms, multiple scattering {:.1f} ms), adds {:.2f}% of single scattering radiance.",
+					i + 2, orderTotal, stats.scatteringDensity[i], stats.indirectIrradiance[i], stats.multipleScattering[i], 100.0 * stats.orderRadiance[i + 1] / stats.orderRadiance[0]);
+			}
+
+			VGLog(logRendering, "  Total {:.1f} ms for {} orders.", total, scatteringOrders);
+		}
+
+		// Threading scalability, at a reduced scattering resolution to keep the serial run short.
+		{
+			Settings settings{};
+			settings.scatteringSize = { 64, 32, 8 };
+
+			const auto Run = [&](bool parallel)
+			{
+				settings.parallel = parallel;
+
+				const auto begin = std::chrono::high_resolution_clock::now();
+				Luts luts;
+				Precompute(atmosphere, settings, luts);
+				const auto end = std::chrono::high_resolution_clock::now();
+
+				return std::chrono::duration<double, std::milli>(end - begin).count();
+			};
+
+			const auto serial = Run(false);
+			const auto parallel = Run(true);
+
+			VGLog(logRendering, "  Reduced {}x{}x{} scattering: serial {:.1f} ms, parallel {:.1f} ms, {:.1f}x speedup.", settings.scatteringSize.x, settings.scatteringSize.y,
+				settings.scatteringSize.z, serial, parallel, serial / parallel);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+struct AtmosphereData;
+
+// CPU implementation of the atmosphere LUT precompute in AtmospherePrecompute.hlsl, multithreaded across texel rows with
+// the shader math in DirectXMath vectors. Produces the same LUTs as the GPU within filtering precision, so that the LUT
+// cache can be baked on machines without a device, and GPU results can be validated.
+namespace AtmosphereReference
+{
+	// Must match Atmosphere.hlsli.
+	constexpr float sunAngularRadius = 0.004675f;
+	constexpr float minMuS = -0.5f;
+	constexpr float mieAnisotropy = 0.8f;
+
+	// Dimensions of the precomputed LUTs, the GPU textures are created with the same sizes.
+	constexpr XMUINT3 transmittanceLutSize = { 256, 64, 1 };
+	constexpr XMUINT3 scatteringLutSize = { 256, 128, 32 };  // Nu and muS packed along x, mu along y, radius along z.
+	constexpr XMUINT3 irradianceLutSize = { 64, 16, 1 };
+	constexpr int32_t scatteringOrders = 4;
+
+	// Four float texels, the layout of an R32G32B32A32_FLOAT texture.
+	struct Lut
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t depth = 0;
+		std::vector<XMFLOAT4> texels;
+
+		void Resize(const XMUINT3& size);
+		size_t Index(uint32_t x, uint32_t y, uint32_t z = 0) const { return ((size_t)z * height + y) * width + x; }
+	};
+
+	struct Luts
+	{
+		Lut transmittance;
+		Lut scattering;  // Rayleigh and multiple scattering in rgb, single mie red channel in alpha.
+		Lut irradiance;  // Indirect ground irradiance only, direct irradiance is computed at runtime.
+	};
+
+	struct Settings
+	{
+		XMUINT3 transmittanceSize = transmittanceLutSize;
+		XMUINT3 scatteringSize = scatteringLutSize;
+		XMUINT3 irradianceSize = irradianceLutSize;
+		int32_t scatteringOrders = AtmosphereReference::scatteringOrders;
+		bool parallel = true;
+	};
+
+	struct PrecomputeStats
+	{
+		// Wall time of each stage, in milliseconds.
+		double transmittance = 0.0;
+		double directIrradiance = 0.0;
+		double singleScattering = 0.0;
+
+		// Per scattering order, starting at the second.
+		std::vector<double> scatteringDensity;
+		std::vector<double> indirectIrradiance;
+		std::vector<double> multipleScattering;
+
+		// Mean rayleigh channel radiance of each order's scattering, starting at single scattering.
+		std::vector<double> orderRadiance;
+	};
+
+	// Equivalent of Atmosphere::Precompute, runs the same stages in the same order.
+	void Precompute(const AtmosphereData& atmosphere, const Settings& settings, Luts& output, PrecomputeStats* stats = nullptr);
+
+	// Writes LUTs to the cache in the format the renderer loads, they must have the sizes of the GPU textures to be used.
+	bool SaveLutCache(const AtmosphereData& atmosphere, const Luts& luts, const std::filesystem::path& path);
+	// Precomputes the LUTs of the model at the GPU texture sizes and saves them to the cache.
+	bool BakeLutCache(const AtmosphereData& atmosphere, const std::filesystem::path& path);
+
+	struct LutError
+	{
+		float maxAbsolute = 0.f;
+		float maxRelative = 0.f;  // Relative to the larger of the two values, ignoring values below the absolute floor.
+		float meanRelative = 0.f;
+	};
+
+	// GPU readbacks differ from the reference by the fixed point weights of hardware filtering, and by the precision of GPU
+	// transcendentals. Errors are relative, see LutError.
+	constexpr float validationMeanTolerance = 1e-3f;
+	constexpr float validationMaxTolerance = 5e-2f;
+
+	// Compares packed R32G32B32A32_FLOAT texture data, such as a GPU readback, against a reference LUT.
+	LutError Compare(const Lut& reference, const std::vector<uint8_t>& data, float absoluteFloor = 1e-6f);
+
+	// Headless checks of the LUT parameterizations, physical bounds of the precomputed LUTs, and the cache round trip.
+	void Test();
+	// CPU-only measurement of each precompute stage and scattering order, and of their contribution to the sky radiance.
+	void Benchmark();
+}
\ No newline at end of file
@@ -0,0 +1,1397 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/BlockCompression.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <execution>
+#include <random>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace BlockCompression
+{
+	namespace
+	{
+		constexpr uint32_t blockTexels = 16;
+		constexpr uint32_t refinements = 2;  // Least squares refits of the endpoints to the chosen indices.
+
+		// BC7 interpolation weights of 4 bit indices, out of 64.
+		constexpr std::array<int32_t, 16> bc7Weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// Texels of a block, clamped to the level.
+		struct Block
+		{
+			uint8_t texels[blockTexels][4];
+		};
+
+		// Interpolation of each texel between the two endpoints of a block, in [0, 1] towards the second.
+		using BlockWeights = std::array<float, blockTexels>;
+
+		Block LoadBlock(const uint8_t* texels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY)
+		{
+			Block block;
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				const auto x = std::min(blockX * 4 + i % 4, width - 1);
+				const auto y = std::min(blockY * 4 + i / 4, height - 1);
+				std::memcpy(block.texels[i], texels + (x + y * width) * 4, 4);
+			}
+
+			return block;
+		}
+
+		// Little endian bit stream of a block, which must be zeroed before writing.
+		struct BitStream
+		{
+			uint8_t* data;
+			uint32_t position = 0;
+
+			void Write(uint32_t value, uint32_t bits)
+			{
+				for (uint32_t i = 0; i < bits; ++i, ++position)
+				{
+					data[position / 8] |= ((value >> i) & 1) << (position % 8);
+				}
+			}
+
+			uint32_t Read(uint32_t bits)
+			{
+				uint32_t value = 0;
+				for (uint32_t i = 0; i < bits; ++i, ++position)
+				{
+					value |= ((data[position / 8] >> (position % 8)) & 1) << i;
+				}
+
+				return value;
+			}
+		};
+
+		uint32_t GetChannels(Format format)
+		{
+			switch (format)
+			{
+			case Format::BC1: return 3;
+			case Format::BC4: return 1;
+			case Format::BC5: return 2;
+			default: return 4;
+			}
+		}
+
+		// Principal axis of the first channels of the block's texels, through their mean. Returns false for constant blocks.
+		bool FitAxis(const Block& block, uint32_t channels, float mean[4], float axis[4])
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				mean[c] = 0.f;
+				axis[c] = c < channels ? 1.f : 0.f;
+			}
+
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					mean[c] += block.texels[i][c] / static_cast<float>(blockTexels);
+				}
+			}
+
+			float covariance[4][4] = {};
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				for (uint32_t a = 0; a < channels; ++a)
+				{
+					for (uint32_t b = 0; b < channels; ++b)
+					{
+						covariance[a][b] += (block.texels[i][a] - mean[a]) * (block.texels[i][b] - mean[b]);
+					}
+				}
+			}
+
+			// Power iteration, starting from the channel with the largest variance so that the start isn't orthogonal to the axis.
+			uint32_t largest = 0;
+			for (uint32_t c = 1; c < channels; ++c)
+			{
+				largest = covariance[c][c] > covariance[largest][largest] ? c : largest;
+			}
+
+			if (covariance[largest][largest] < 1e-4f)
+			{
+				return false;
+			}
+
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				axis[c] = covariance[largest][c];
+			}
+
+			for (uint32_t iteration = 0; iteration < 8; ++iteration)
+			{
+				float next[4] = {};
+				float length = 0.f;
+				for (uint32_t a = 0; a < channels; ++a)
+				{
+					for (uint32_t b = 0; b < channels; ++b)
+					{
+						next[a] += covariance[a][b] * axis[b];
+					}
+
+					length += next[a] * next[a];
+				}
+
+				if (length < 1e-12f)
+				{
+					return false;
+				}
+
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					axis[c] = next[c] / std::sqrt(length);
+				}
+			}
+
+			return true;
+		}
+
+		// Endpoints at the extremes of the texels projected on the axis.
+		void ProjectEndpoints(const Block& block, uint32_t channels, const float mean[4], const float axis[4], float first[4], float second[4])
+		{
+			float minimum = std::numeric_limits<float>::max();
+			float maximum = std::numeric_limits<float>::lowest();
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				float projection = 0.f;
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					projection += (block.texels[i][c] - mean[c]) * axis[c];
+				}
+
+				minimum = std::min(minimum, projection);
+				maximum = std::max(maximum, projection);
+			}
+
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				first[c] = mean[c] + axis[c] * minimum;
+				second[c] = mean[c] + axis[c] * maximum;
+			}
+		}
+
+		// Least squares endpoints of the first channels, given each texel's interpolation weight. Returns false if every texel has
+		// the same weight, which leaves the endpoints underdetermined.
+		bool RefitEndpoints(const Block& block, uint32_t channels, const BlockWeights& weights, float first[4], float second[4])
+		{
+			float aa = 0.f;
+			float ab = 0.f;
+			float bb = 0.f;
+			float ax[4] = {};
+			float bx[4] = {};
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				const float b = weights[i];
+				const float a = 1.f - b;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					ax[c] += a * block.texels[i][c];
+					bx[c] += b * block.texels[i][c];
+				}
+			}
+
+			const float determinant = aa * bb - ab * ab;
+			if (std::abs(determinant) < 1e-6f)
+			{
+				return false;
+			}
+
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				first[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.f, 255.f);
+				second[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.f, 255.f);
+			}
+
+			return true;
+		}
+
+		uint32_t SquaredError(const uint8_t* texel, const int32_t* value, uint32_t channels)
+		{
+			uint32_t error = 0;
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				const int32_t difference = texel[c] - value[c];
+				error += difference * difference;
+			}
+
+			return error;
+		}
+
+		// BC1 color blocks.
+
+		uint16_t PackColor(const float color[4])
+		{
+			const auto Quantize = [](float value, int32_t maximum)
+			{
+				return static_cast<uint16_t>(std::clamp(static_cast<int32_t>(std::round(value * maximum / 255.f)), 0, maximum));
+			};
+
+			return (Quantize(color[0], 31) << 11) | (Quantize(color[1], 63) << 5) | Quantize(color[2], 31);
+		}
+
+		void UnpackColor(uint16_t packed, int32_t color[4])
+		{
+			const int32_t r = (packed >> 11) & 31;
+			const int32_t g = (packed >> 5) & 63;
+			const int32_t b = packed & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+			color[3] = 255;
+		}
+
+		// Three color mode with a transparent black when the first endpoint isn't larger, unless the block is always four color.
+		void ColorPalette(uint16_t first, uint16_t second, bool fourColor, int32_t palette[4][4])
+		{
+			UnpackColor(first, palette[0]);
+			UnpackColor(second, palette[1]);
+
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				if (fourColor || first > second)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+
+				else
+				{
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+					palette[3][c] = 0;
+				}
+			}
+
+			palette[2][3] = 255;
+			palette[3][3] = fourColor || first > second ? 255 : 0;
+		}
+
+		struct ColorCandidate
+		{
+			uint16_t first = 0;
+			uint16_t second = 0;
+			uint32_t indices = 0;
+			uint32_t error = std::numeric_limits<uint32_t>::max();
+			BlockWeights weights{};
+		};
+
+		// Always four color, the first endpoint is ordered to be the larger.
+		ColorCandidate EvaluateColor(const Block& block, const float first[4], const float second[4])
+		{
+			constexpr std::array<float, 4> indexWeights = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+			ColorCandidate candidate;
+			candidate.first = PackColor(first);
+			candidate.second = PackColor(second);
+			candidate.error = 0;
+
+			const bool swapped = candidate.first < candidate.second;
+			if (swapped)
+			{
+				std::swap(candidate.first, candidate.second);
+			}
+
+			int32_t palette[4][4];
+			ColorPalette(candidate.first, candidate.second, true, palette);
+
+			// Equal endpoints would decode as three color, only the first index is valid.
+			const uint32_t paletteSize = candidate.first == candidate.second ? 1 : 4;
+
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				uint32_t best = 0;
+				uint32_t bestError = std::numeric_limits<uint32_t>::max();
+				for (uint32_t j = 0; j < paletteSize; ++j)
+				{
+					const auto error = SquaredError(block.texels[i], palette[j], 3);
+					if (error < bestError)
+					{
+						best = j;
+						bestError = error;
+					}
+				}
+
+				candidate.indices |= best << (i * 2);
+				candidate.error += bestError;
+				candidate.weights[i] = swapped ? 1.f - indexWeights[best] : indexWeights[best];  // Relative to the unswapped endpoints.
+			}
+
+			return candidate;
+		}
+
+		void EncodeColorBlock(const Block& block, uint8_t* output)
+		{
+			float mean[4];
+			float axis[4];
+			float first[4];
+			float second[4];
+
+			ColorCandidate best;
+			if (FitAxis(block, 3, mean, axis))
+			{
+				ProjectEndpoints(block, 3, mean, axis, first, second);
+				best = EvaluateColor(block, first, second);
+
+				for (uint32_t i = 0; i < refinements && best.error > 0; ++i)
+				{
+					if (!RefitEndpoints(block, 3, best.weights, first, second))
+					{
+						break;
+					}
+
+					const auto candidate = EvaluateColor(block, first, second);
+					if (candidate.error >= best.error)
+					{
+						break;
+					}
+
+					best = candidate;
+				}
+			}
+
+			else
+			{
+				best = EvaluateColor(block, mean, mean);
+			}
+
+			std::memcpy(output, &best.first, 2);
+			std::memcpy(output + 2, &best.second, 2);
+			std::memcpy(output + 4, &best.indices, 4);
+		}
+
+		void DecodeColorBlock(const uint8_t* input, bool fourColor, Block& block)
+		{
+			uint16_t first;
+			uint16_t second;
+			uint32_t indices;
+			std::memcpy(&first, input, 2);
+			std::memcpy(&second, input + 2, 2);
+			std::memcpy(&indices, input + 4, 4);
+
+			int32_t palette[4][4];
+			ColorPalette(first, second, fourColor, palette);
+
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				const auto* value = palette[(indices >> (i * 2)) & 3];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					block.texels[i][c] = static_cast<uint8_t>(value[c]);
+				}
+			}
+		}
+
+		// BC4 value blocks, also the alpha of BC3 and both channels of BC5.
+
+		// Eight interpolated values when the first endpoint is larger, otherwise six and the extremes.
+		void ValuePalette(uint8_t first, uint8_t second, int32_t palette[8])
+		{
+			palette[0] = first;
+			palette[1] = second;
+
+			if (first > second)
+			{
+				for (int32_t i = 1; i < 7; ++i)
+				{
+					palette[i + 1] = ((7 - i) * first + i * second + 3) / 7;
+				}
+			}
+
+			else
+			{
+				for (int32_t i = 1; i < 5; ++i)
+				{
+					palette[i + 1] = ((5 - i) * first + i * second + 2) / 5;
+				}
+
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+		}
+
+		uint32_t EvaluateValues(const uint8_t values[blockTexels], uint8_t first, uint8_t second, uint64_t& indices)
+		{
+			int32_t palette[8];
+			ValuePalette(first, second, palette);
+
+			uint32_t total = 0;
+			indices = 0;
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				uint32_t best = 0;
+				uint32_t bestError = std::numeric_limits<uint32_t>::max();
+				for (uint32_t j = 0; j < 8; ++j)
+				{
+					const auto error = static_cast<uint32_t>((values[i] - palette[j]) * (values[i] - palette[j]));
+					if (error < bestError)
+					{
+						best = j;
+						bestError = error;
+					}
+				}
+
+				indices |= static_cast<uint64_t>(best) << (i * 3);
+				total += bestError;
+			}
+
+			return total;
+		}
+
+		void EncodeValueBlock(const Block& block, uint32_t channel, uint8_t* output)
+		{
+			uint8_t values[blockTexels];
+			uint8_t minimum = 255;
+			uint8_t maximum = 0;
+			uint8_t innerMinimum = 255;  // Excluding the extremes, which the six value palette has exactly.
+			uint8_t innerMaximum = 0;
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				values[i] = block.texels[i][channel];
+				minimum = std::min(minimum, values[i]);
+				maximum = std::max(maximum, values[i]);
+
+				if (values[i] != 0 && values[i] != 255)
+				{
+					innerMinimum = std::min(innerMinimum, values[i]);
+					innerMaximum = std::max(innerMaximum, values[i]);
+				}
+			}
+
+			uint8_t first = maximum;
+			uint8_t second = minimum;
+			uint64_t indices;
+			auto error = EvaluateValues(values, first, second, indices);
+
+			if (error > 0 && innerMinimum <= innerMaximum && (minimum == 0 || maximum == 255))
+			{
+				uint64_t innerIndices;
+				const auto innerError = EvaluateValues(values, innerMinimum, innerMaximum, innerIndices);
+				if (innerError < error)
+				{
+					first = innerMinimum;
+					second = innerMaximum;
+					indices = innerIndices;
+				}
+			}
+
+			output[0] = first;
+			output[1] = second;
+			std::memcpy(output + 2, &indices, 6);
+		}
+
+		void DecodeValueBlock(const uint8_t* input, uint32_t channel, Block& block)
+		{
+			int32_t palette[8];
+			ValuePalette(input[0], input[1], palette);
+
+			uint64_t indices = 0;
+			std::memcpy(&indices, input + 2, 6);
+
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				block.texels[i][channel] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+			}
+		}
+
+		// BC7 mode 6 blocks, endpoints are 7 bits per channel with a shared lowest bit per endpoint.
+
+		struct Bc7Candidate
+		{
+			uint8_t endpoints[2][4] = {};  // 7 bit.
+			uint8_t bits[2] = {};
+			uint8_t indices[blockTexels] = {};
+			uint64_t error = std::numeric_limits<uint64_t>::max();
+			BlockWeights weights{};
+		};
+
+		void Bc7Palette(const Bc7Candidate& candidate, int32_t palette[16][4])
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const int32_t first = (candidate.endpoints[0][c] << 1) | candidate.bits[0];
+				const int32_t second = (candidate.endpoints[1][c] << 1) | candidate.bits[1];
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					palette[i][c] = ((64 - bc7Weights[i]) * first + bc7Weights[i] * second + 32) >> 6;
+				}
+			}
+		}
+
+		// Tries every combination of shared bits, texels take the nearest of the indices around their projection on the endpoints.
+		Bc7Candidate EvaluateBc7(const Block& block, const float first[4], const float second[4])
+		{
+			Bc7Candidate best;
+			for (uint32_t bits = 0; bits < 4; ++bits)
+			{
+				Bc7Candidate candidate;
+				candidate.bits[0] = bits & 1;
+				candidate.bits[1] = bits >> 1;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					candidate.endpoints[0][c] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(std::round((first[c] - candidate.bits[0]) * 0.5f)), 0, 127));
+					candidate.endpoints[1][c] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(std::round((second[c] - candidate.bits[1]) * 0.5f)), 0, 127));
+				}
+
+				int32_t palette[16][4];
+				Bc7Palette(candidate, palette);
+
+				float direction[4];
+				float lengthSquared = 0.f;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					direction[c] = static_cast<float>(palette[15][c] - palette[0][c]);
+					lengthSquared += direction[c] * direction[c];
+				}
+
+				candidate.error = 0;
+				for (uint32_t i = 0; i < blockTexels; ++i)
+				{
+					float projection = 0.f;
+					for (uint32_t c = 0; c < 4; ++c)
+					{
+						projection += (block.texels[i][c] - palette[0][c]) * direction[c];
+					}
+
+					const auto nearest = lengthSquared > 0.f ? static_cast<int32_t>(std::round(std::clamp(projection / lengthSquared, 0.f, 1.f) * 15.f)) : 0;
+
+					uint32_t bestIndex = 0;
+					uint32_t bestError = std::numeric_limits<uint32_t>::max();
+					for (int32_t j = std::max(nearest - 1, 0); j <= std::min(nearest + 1, 15); ++j)
+					{
+						const auto error = SquaredError(block.texels[i], palette[j], 4);
+						if (error < bestError)
+						{
+							bestIndex = j;
+							bestError = error;
+						}
+					}
+
+					candidate.indices[i] = static_cast<uint8_t>(bestIndex);
+					candidate.weights[i] = bc7Weights[bestIndex] / 64.f;
+					candidate.error += bestError;
+				}
+
+				if (candidate.error < best.error)
+				{
+					best = candidate;
+				}
+			}
+
+			return best;
+		}
+
+		Bc7Candidate EncodeBc7Mode6(const Block& block)
+		{
+			float mean[4];
+			float axis[4];
+			float first[4];
+			float second[4];
+
+			Bc7Candidate best;
+			if (FitAxis(block, 4, mean, axis))
+			{
+				ProjectEndpoints(block, 4, mean, axis, first, second);
+				best = EvaluateBc7(block, first, second);
+
+				for (uint32_t i = 0; i < refinements && best.error > 0; ++i)
+				{
+					if (!RefitEndpoints(block, 4, best.weights, first, second))
+					{
+						break;
+					}
+
+					const auto candidate = EvaluateBc7(block, first, second);
+					if (candidate.error >= best.error)
+					{
+						break;
+					}
+
+					best = candidate;
+				}
+			}
+
+			else
+			{
+				best = EvaluateBc7(block, mean, mean);
+			}
+
+			// The highest index bit of the first texel is implied to be zero, so flip the block if it's set. The weights are symmetric.
+			if (best.indices[0] >= 8)
+			{
+				std::swap(best.endpoints[0], best.endpoints[1]);
+				std::swap(best.bits[0], best.bits[1]);
+				for (auto& index : best.indices)
+				{
+					index = 15 - index;
+				}
+			}
+
+			return best;
+		}
+
+		// BC7 mode 5 blocks, 7 bit color and 8 bit alpha endpoints with separate 2 bit indices, for alpha that doesn't follow color.
+
+		constexpr std::array<int32_t, 4> bc7AlphaWeights = { 0, 21, 43, 64 };  // Of 2 bit indices, out of 64.
+
+		struct Bc7SplitCandidate
+		{
+			uint8_t colors[2][4] = {};  // 7 bit.
+			uint8_t alphas[2][4] = {};  // 8 bit, in the first channel.
+			uint8_t colorIndices[blockTexels] = {};
+			uint8_t alphaIndices[blockTexels] = {};
+			uint64_t error = 0;
+		};
+
+		// Fits the first channels of the block with endpoints of the given precision and 2 bit indices, the first index's highest
+		// bit is zero.
+		uint32_t FitSplitChannels(const Block& block, uint32_t channels, uint32_t precision, uint8_t endpoints[2][4], uint8_t indices[blockTexels])
+		{
+			const auto Expand = [&](uint8_t value)
+			{
+				return precision == 7 ? (value << 1) | (value >> 6) : value;
+			};
+
+			const auto Evaluate = [&](const float first[4], const float second[4], uint8_t candidate[2][4], uint8_t candidateIndices[blockTexels], BlockWeights& weights)
+			{
+				const auto maximum = (1 << precision) - 1;
+				int32_t palette[4][4] = {};
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					candidate[0][c] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(std::round(first[c] * maximum / 255.f)), 0, maximum));
+					candidate[1][c] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(std::round(second[c] * maximum / 255.f)), 0, maximum));
+					for (uint32_t i = 0; i < 4; ++i)
+					{
+						palette[i][c] = ((64 - bc7AlphaWeights[i]) * Expand(candidate[0][c]) + bc7AlphaWeights[i] * Expand(candidate[1][c]) + 32) >> 6;
+					}
+				}
+
+				uint32_t total = 0;
+				for (uint32_t i = 0; i < blockTexels; ++i)
+				{
+					uint32_t bestError = std::numeric_limits<uint32_t>::max();
+					for (uint32_t j = 0; j < 4; ++j)
+					{
+						const auto error = SquaredError(block.texels[i], palette[j], channels);
+						if (error < bestError)
+						{
+							candidateIndices[i] = static_cast<uint8_t>(j);
+							bestError = error;
+						}
+					}
+
+					weights[i] = bc7AlphaWeights[candidateIndices[i]] / 64.f;
+					total += bestError;
+				}
+
+				return total;
+			};
+
+			float mean[4];
+			float axis[4];
+			float first[4];
+			float second[4];
+			BlockWeights weights;
+
+			uint32_t error;
+			if (FitAxis(block, channels, mean, axis))
+			{
+				ProjectEndpoints(block, channels, mean, axis, first, second);
+				error = Evaluate(first, second, endpoints, indices, weights);
+
+				for (uint32_t i = 0; i < refinements && error > 0; ++i)
+				{
+					if (!RefitEndpoints(block, channels, weights, first, second))
+					{
+						break;
+					}
+
+					uint8_t candidate[2][4] = {};
+					uint8_t candidateIndices[blockTexels];
+					BlockWeights candidateWeights;
+					const auto candidateError = Evaluate(first, second, candidate, candidateIndices, candidateWeights);
+					if (candidateError >= error)
+					{
+						break;
+					}
+
+					error = candidateError;
+					weights = candidateWeights;
+					std::memcpy(endpoints, candidate, sizeof(candidate));
+					std::memcpy(indices, candidateIndices, sizeof(candidateIndices));
+				}
+			}
+
+			else
+			{
+				error = Evaluate(mean, mean, endpoints, indices, weights);
+			}
+
+			if (indices[0] >= 2)
+			{
+				std::swap(endpoints[0], endpoints[1]);
+				for (uint32_t i = 0; i < blockTexels; ++i)
+				{
+					indices[i] = 3 - indices[i];
+				}
+			}
+
+			return error;
+		}
+
+		Bc7SplitCandidate EncodeBc7Mode5(const Block& block)
+		{
+			Block alpha;
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				alpha.texels[i][0] = block.texels[i][3];
+			}
+
+			Bc7SplitCandidate candidate;
+			candidate.error = FitSplitChannels(block, 3, 7, candidate.colors, candidate.colorIndices);
+			candidate.error += FitSplitChannels(alpha, 1, 8, candidate.alphas, candidate.alphaIndices);
+
+			return candidate;
+		}
+
+		// Opaque blocks always use mode 6, which has twice the color precision. Blocks with alpha use whichever mode is closer.
+		void EncodeBc7Block(const Block& block, uint8_t* output)
+		{
+			std::memset(output, 0, 16);
+			BitStream stream{ output };
+
+			const auto mode6 = EncodeBc7Mode6(block);
+
+			bool opaque = true;
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				opaque &= block.texels[i][3] == 255;
+			}
+
+			if (!opaque)
+			{
+				const auto mode5 = EncodeBc7Mode5(block);
+				if (mode5.error < mode6.error)
+				{
+					stream.Write(1 << 5, 6);  // Mode 5.
+					stream.Write(0, 2);  // No channel rotation.
+					for (uint32_t c = 0; c < 3; ++c)
+					{
+						stream.Write(mode5.colors[0][c], 7);
+						stream.Write(mode5.colors[1][c], 7);
+					}
+
+					stream.Write(mode5.alphas[0][0], 8);
+					stream.Write(mode5.alphas[1][0], 8);
+
+					for (const auto* indices : { mode5.colorIndices, mode5.alphaIndices })
+					{
+						stream.Write(indices[0], 1);
+						for (uint32_t i = 1; i < blockTexels; ++i)
+						{
+							stream.Write(indices[i], 2);
+						}
+					}
+
+					return;
+				}
+			}
+
+			stream.Write(1 << 6, 7);  // Mode 6.
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				stream.Write(mode6.endpoints[0][c], 7);
+				stream.Write(mode6.endpoints[1][c], 7);
+			}
+
+			stream.Write(mode6.bits[0], 1);
+			stream.Write(mode6.bits[1], 1);
+			stream.Write(mode6.indices[0], 3);
+			for (uint32_t i = 1; i < blockTexels; ++i)
+			{
+				stream.Write(mode6.indices[i], 4);
+			}
+		}
+
+		void DecodeBc7Block(const uint8_t* input, Block& block)
+		{
+			BitStream stream{ const_cast<uint8_t*>(input) };
+
+			// Modes are the number of zero bits before the first set bit.
+			uint32_t mode = 0;
+			while (mode < 8 && stream.Read(1) == 0)
+			{
+				++mode;
+			}
+
+			if (mode == 5)
+			{
+				const auto rotation = stream.Read(2);
+
+				int32_t endpoints[2][4];
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					for (uint32_t e = 0; e < 2; ++e)
+					{
+						const auto value = stream.Read(7);
+						endpoints[e][c] = static_cast<int32_t>((value << 1) | (value >> 6));
+					}
+				}
+
+				endpoints[0][3] = static_cast<int32_t>(stream.Read(8));
+				endpoints[1][3] = static_cast<int32_t>(stream.Read(8));
+
+				uint32_t colorIndices[blockTexels];
+				uint32_t alphaIndices[blockTexels];
+				for (auto* indices : { colorIndices, alphaIndices })
+				{
+					for (uint32_t i = 0; i < blockTexels; ++i)
+					{
+						indices[i] = stream.Read(i == 0 ? 1 : 2);
+					}
+				}
+
+				for (uint32_t i = 0; i < blockTexels; ++i)
+				{
+					for (uint32_t c = 0; c < 4; ++c)
+					{
+						const auto weight = bc7AlphaWeights[c < 3 ? colorIndices[i] : alphaIndices[i]];
+						block.texels[i][c] = static_cast<uint8_t>(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+					}
+
+					if (rotation > 0)
+					{
+						std::swap(block.texels[i][3], block.texels[i][rotation - 1]);
+					}
+				}
+
+				return;
+			}
+
+			if (mode != 6)
+			{
+				std::memset(block.texels, 0, sizeof(block.texels));
+				return;
+			}
+
+			Bc7Candidate candidate;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				candidate.endpoints[0][c] = static_cast<uint8_t>(stream.Read(7));
+				candidate.endpoints[1][c] = static_cast<uint8_t>(stream.Read(7));
+			}
+
+			candidate.bits[0] = static_cast<uint8_t>(stream.Read(1));
+			candidate.bits[1] = static_cast<uint8_t>(stream.Read(1));
+
+			int32_t palette[16][4];
+			Bc7Palette(candidate, palette);
+
+			for (uint32_t i = 0; i < blockTexels; ++i)
+			{
+				const auto* value = palette[stream.Read(i == 0 ? 3 : 4)];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					block.texels[i][c] = static_cast<uint8_t>(value[c]);
+				}
+			}
+		}
+
+		void EncodeBlock(const Block& block, Format format, uint8_t* output)
+		{
+			switch (format)
+			{
+			case Format::BC1:
+				EncodeColorBlock(block, output);
+				break;
+			case Format::BC3:
+				EncodeValueBlock(block, 3, output);
+				EncodeColorBlock(block, output + 8);
+				break;
+			case Format::BC4:
+				EncodeValueBlock(block, 0, output);
+				break;
+			case Format::BC5:
+				EncodeValueBlock(block, 0, output);
+				EncodeValueBlock(block, 1, output + 8);
+				break;
+			case Format::BC7:
+				EncodeBc7Block(block, output);
+				break;
+			}
+		}
+
+		void DecodeBlock(const uint8_t* input, Format format, Block& block)
+		{
+			std::memset(block.texels, 0, sizeof(block.texels));
+			for (auto& texel : block.texels)
+			{
+				texel[3] = 255;
+			}
+
+			switch (format)
+			{
+			case Format::BC1:
+				DecodeColorBlock(input, false, block);
+				break;
+			case Format::BC3:
+				DecodeColorBlock(input + 8, true, block);
+				DecodeValueBlock(input, 3, block);
+				break;
+			case Format::BC4:
+				DecodeValueBlock(input, 0, block);
+				break;
+			case Format::BC5:
+				DecodeValueBlock(input, 0, block);
+				DecodeValueBlock(input + 8, 1, block);
+				break;
+			case Format::BC7:
+				DecodeBc7Block(input, block);
+				break;
+			}
+		}
+
+		template <typename Function>
+		void ForEachRow(uint32_t rows, bool parallel, Function&& function)
+		{
+			if (parallel)
+			{
+				std::vector<uint32_t> indices(rows);
+				std::iota(indices.begin(), indices.end(), 0);
+				std::for_each(std::execution::par, indices.begin(), indices.end(), function);
+			}
+
+			else
+			{
+				for (uint32_t i = 0; i < rows; ++i)
+				{
+					function(i);
+				}
+			}
+		}
+
+		// Over the channels of the format.
+		double ComputePsnr(const std::vector<uint8_t>& reference, const std::vector<uint8_t>& decoded, Format format)
+		{
+			const auto channels = GetChannels(format);
+
+			double error = 0.0;
+			for (size_t i = 0; i < reference.size(); i += 4)
+			{
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					const double difference = static_cast<double>(reference[i + c]) - decoded[i + c];
+					error += difference * difference;
+				}
+			}
+
+			const auto meanError = error / (reference.size() / 4 * channels);
+			return meanError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanError) : std::numeric_limits<double>::infinity();
+		}
+
+		// Synthetic content for the test and benchmark: smooth gradients and detail with noise in color and alpha, tangent space
+		// normals of a rolling height field, and a mask of smooth occlusion, roughness and hard edged metalness.
+		enum class Content
+		{
+			Color,
+			Normal,
+			Mask
+		};
+
+		std::vector<uint8_t> CreateImage(uint32_t width, uint32_t height, Content content, uint32_t seed)
+		{
+			std::mt19937 engine{ seed };
+			std::normal_distribution<float> noise{ 0.f, 2.f };
+
+			const auto Quantize = [](float value)
+			{
+				return static_cast<uint8_t>(std::clamp(std::round(value), 0.f, 255.f));
+			};
+
+			std::vector<uint8_t> image(width * height * 4);
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					const float u = static_cast<float>(x) / width;
+					const float v = static_cast<float>(y) / height;
+					auto* texel = image.data() + (x + y * width) * 4;
+
+					if (content == Content::Color)
+					{
+						const float detail = 30.f * std::sin(x * 0.31f) * std::cos(y * 0.17f);
+						texel[0] = Quantize(40.f + 170.f * u + detail + noise(engine));
+						texel[1] = Quantize(200.f - 120.f * v + 0.5f * detail + noise(engine));
+						texel[2] = Quantize(90.f + 80.f * std::sin(6.f * u + 4.f * v) + noise(engine));
+						texel[3] = Quantize(255.f * (0.5f + 0.5f * std::sin(9.f * v)));
+					}
+
+					else if (content == Content::Normal)
+					{
+						// Derivatives of h = 0.08 sin(0.2 x) sin(0.13 y) + 0.04 sin(0.05 (x + y)).
+						const float dx = 0.016f * std::cos(0.2f * x) * std::sin(0.13f * y) + 0.002f * std::cos(0.05f * (x + y));
+						const float dy = 0.0104f * std::sin(0.2f * x) * std::cos(0.13f * y) + 0.002f * std::cos(0.05f * (x + y));
+						const float length = std::sqrt(dx * dx * 100.f + dy * dy * 100.f + 1.f);
+						texel[0] = Quantize((-dx * 10.f / length * 0.5f + 0.5f) * 255.f);
+						texel[1] = Quantize((-dy * 10.f / length * 0.5f + 0.5f) * 255.f);
+						texel[2] = Quantize((1.f / length * 0.5f + 0.5f) * 255.f);
+						texel[3] = 255;
+					}
+
+					else
+					{
+						texel[0] = Quantize(255.f * (0.6f + 0.4f * std::sin(3.f * u) * std::sin(5.f * v)) + noise(engine));
+						texel[1] = Quantize(128.f + 100.f * std::sin(11.f * u + 2.f * v) + noise(engine));
+						texel[2] = (std::sin(0.05f * x) * std::sin(0.07f * y)) > 0.f ? 255 : 0;
+						texel[3] = 255;
+					}
+				}
+			}
+
+			return image;
+		}
+	}
+
+	uint32_t GetBlockSize(Format format)
+	{
+		return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+	}
+
+	DXGI_FORMAT GetResourceFormat(Format format, bool sRGB)
+	{
+		switch (format)
+		{
+		case Format::BC1: return sRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case Format::BC3: return sRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+		case Format::BC4: return DXGI_FORMAT_BC4_UNORM;
+		case Format::BC5: return DXGI_FORMAT_BC5_UNORM;
+		case Format::BC7: return sRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	size_t ComputeSize(Format format, uint32_t width, uint32_t height)
+	{
+		return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+	}
+
+	std::vector<uint8_t> Compress(const uint8_t* texels, uint32_t width, uint32_t height, Format format, bool parallel)
+	{
+		VGScopedCPUStat("Block Compress");
+
+		const auto blocksX = (width + 3) / 4;
+		const auto blocksY = (height + 3) / 4;
+		const auto blockSize = GetBlockSize(format);
+
+		std::vector<uint8_t> blocks(ComputeSize(format, width, height));
+		ForEachRow(blocksY, parallel, [&](uint32_t y)
+		{
+			for (uint32_t x = 0; x < blocksX; ++x)
+			{
+				EncodeBlock(LoadBlock(texels, width, height, x, y), format, blocks.data() + (x + y * blocksX) * blockSize);
+			}
+		});
+
+		return blocks;
+	}
+
+	std::vector<uint8_t> Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, Format format)
+	{
+		const auto blocksX = (width + 3) / 4;
+		const auto blocksY = (height + 3) / 4;
+		const auto blockSize = GetBlockSize(format);
+
+		std::vector<uint8_t> texels(width * height * 4);
+		for (uint32_t y = 0; y < blocksY; ++y)
+		{
+			for (uint32_t x = 0; x < blocksX; ++x)
+			{
+				Block block;
+				DecodeBlock(blocks + (x + y * blocksX) * blockSize, format, block);
+
+				for (uint32_t i = 0; i < blockTexels; ++i)
+				{
+					const auto texelX = x * 4 + i % 4;
+					const auto texelY = y * 4 + i / 4;
+					if (texelX < width && texelY < height)
+					{
+						std::memcpy(texels.data() + (texelX + texelY * width) * 4, block.texels[i], 4);
+					}
+				}
+			}
+		}
+
+		return texels;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Block Compression Test");
+
+		TestReport report{ logRendering, VGText("Block compression") };
+
+		constexpr Format formats[] = { Format::BC1, Format::BC3, Format::BC4, Format::BC5, Format::BC7 };
+
+		// Maximum channel difference over the channels of the format.
+		const auto MaximumError = [](const std::vector<uint8_t>& reference, const std::vector<uint8_t>& decoded, Format format)
+		{
+			int32_t maximum = 0;
+			for (size_t i = 0; i < reference.size(); i += 4)
+			{
+				for (uint32_t c = 0; c < GetChannels(format); ++c)
+				{
+					maximum = std::max(maximum, std::abs(reference[i + c] - decoded[i + c]));
+				}
+			}
+
+			return maximum;
+		};
+
+		// Sizes of levels smaller than a block and of partial blocks, which are padded by clamping.
+		{
+			for (const auto format : formats)
+			{
+				bool sizes = true;
+				for (const auto [width, height] : { std::pair{ 1u, 1u }, std::pair{ 2u, 2u }, std::pair{ 6u, 10u }, std::pair{ 64u, 4u } })
+				{
+					std::vector<uint8_t> image(width * height * 4);
+					for (size_t i = 0; i < image.size(); ++i)
+					{
+						image[i] = static_cast<uint8_t>(i * 37 % 256);
+					}
+
+					const auto blocks = Compress(image.data(), width, height, format);
+					sizes &= blocks.size() == ((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+					sizes &= Decompress(blocks.data(), width, height, format).size() == image.size();
+				}
+
+				report.Check(sizes, "sizes: compressed size isn't a whole number of blocks");
+			}
+		}
+
+		// Constant blocks decode to within the endpoint precision of each format: 5:6:5 color, 8 bit values and 7 bit plus a
+		// shared bit for BC7.
+		{
+			std::mt19937 engine{ 97 };
+			std::uniform_int_distribution<int32_t> distribution{ 0, 255 };
+
+			for (const auto format : formats)
+			{
+				const auto tolerance = format == Format::BC1 || format == Format::BC3 ? 4 : (format == Format::BC7 ? 1 : 0);
+
+				bool constant = true;
+				for (int32_t i = 0; i < 64; ++i)
+				{
+					const std::array<uint8_t, 4> value = { (uint8_t)distribution(engine), (uint8_t)distribution(engine), (uint8_t)distribution(engine), (uint8_t)distribution(engine) };
+					std::vector<uint8_t> image(16 * 4);
+					for (size_t j = 0; j < image.size(); ++j)
+					{
+						image[j] = value[j % 4];
+					}
+
+					const auto blocks = Compress(image.data(), 4, 4, format);
+					constant &= MaximumError(image, Decompress(blocks.data(), 4, 4, format), format) <= tolerance;
+
+					if (format == Format::BC3)
+					{
+						// Alpha of BC3 is a value block, exact.
+						const auto decoded = Decompress(blocks.data(), 4, 4, format);
+						constant &= decoded[3] == value[3];
+					}
+				}
+
+				report.Check(constant, "constant: constant block changed beyond the endpoint precision");
+			}
+		}
+
+		// Blocks of two values are exact in value blocks, since both are endpoints. Extremes mixed with other values use the six value
+		// palette, which has both exactly.
+		{
+			bool exact = true;
+			for (const auto [low, high] : { std::pair{ 0, 255 }, std::pair{ 17, 201 }, std::pair{ 100, 101 } })
+			{
+				std::vector<uint8_t> image(16 * 4);
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					image[i * 4] = static_cast<uint8_t>((i * 7) % 3 == 0 ? low : high);
+					image[i * 4 + 1] = static_cast<uint8_t>((i * 5) % 2 == 0 ? high : low);
+				}
+
+				for (const auto format : { Format::BC4, Format::BC5 })
+				{
+					const auto blocks = Compress(image.data(), 4, 4, format);
+					exact &= MaximumError(image, Decompress(blocks.data(), 4, 4, format), format) == 0;
+				}
+			}
+
+			std::vector<uint8_t> image(16 * 4);
+			const uint8_t values[] = { 0, 255, 60, 70, 80, 90, 0, 255, 65, 75, 85, 0, 255, 62, 88, 0 };
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				image[i * 4] = values[i];
+			}
+
+			const auto blocks = Compress(image.data(), 4, 4, Format::BC4);
+			exact &= blocks[0] <= blocks[1];
+			exact &= MaximumError(image, Decompress(blocks.data(), 4, 4, Format::BC4), Format::BC4) <= 3;
+
+			report.Check(exact, "values: value blocks aren't exact on their endpoints");
+		}
+
+		// BC7 blocks are mode 5 or 6, with the highest index bit of the first texel implied by flipping the endpoints. Opaque blocks
+		// are always mode 6.
+		{
+			auto image = CreateImage(64, 64, Content::Color, 5);
+			const auto Modes = [&]
+			{
+				uint32_t mode5 = 0;
+				uint32_t mode6 = 0;
+				const auto blocks = Compress(image.data(), 64, 64, Format::BC7);
+				for (size_t i = 0; i < blocks.size(); i += 16)
+				{
+					mode5 += (blocks[i] & 0x3f) == 1 << 5;  // Higher bits are the rotation.
+					mode6 += (blocks[i] & 0x7f) == 1 << 6;  // The highest bit is the first endpoint's.
+				}
+
+				return std::pair{ mode5, mode6 };
+			};
+
+			const auto [translucentMode5, translucentMode6] = Modes();
+			report.Check(translucentMode5 + translucentMode6 == 256 && translucentMode5 > 0, "BC7: translucent blocks aren't mode 5 or 6");
+
+			for (size_t i = 3; i < image.size(); i += 4)
+			{
+				image[i] = 255;
+			}
+
+			report.Check(Modes().second == 256, "BC7: opaque blocks aren't mode 6");
+
+			// Gradients across the endpoints of every texel would lose the index bit if the anchor wasn't flipped.
+			std::vector<uint8_t> gradient(16 * 4);
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					gradient[i * 4 + c] = static_cast<uint8_t>(255 - i * 17);
+				}
+			}
+
+			const auto gradientBlocks = Compress(gradient.data(), 4, 4, Format::BC7);
+			report.Check(MaximumError(gradient, Decompress(gradientBlocks.data(), 4, 4, Format::BC7), Format::BC7) <= 2, "BC7: gradient starting at the second endpoint isn't preserved");
+
+			// Two colors with two alphas that don't follow them aren't on a line, but are endpoints of the separate color and alpha
+			// indices, starting at either endpoint.
+			bool separate = true;
+			for (uint32_t phase = 0; phase < 4; ++phase)
+			{
+				std::vector<uint8_t> block(16 * 4);
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					const bool color = ((i + phase) % 3) == 0;
+					const bool alpha = ((i / 2 + phase / 2) % 2) == 0;
+					block[i * 4] = color ? 30 : 220;
+					block[i * 4 + 1] = color ? 200 : 10;
+					block[i * 4 + 2] = color ? 90 : 140;
+					block[i * 4 + 3] = alpha ? 16 : 240;
+				}
+
+				const auto blocks = Compress(block.data(), 4, 4, Format::BC7);
+				separate &= MaximumError(block, Decompress(blocks.data(), 4, 4, Format::BC7), Format::BC7) <= 1;
+			}
+
+			report.Check(separate, "BC7: separate color and alpha aren't preserved");
+		}
+
+		// Encode quality of smooth content with noise, well below the quality of a production encoder, but enough to catch broken
+		// endpoint fitting or index selection.
+		{
+			const std::pair<Format, double> thresholds[] = { { Format::BC1, 32.0 }, { Format::BC3, 32.0 }, { Format::BC4, 38.0 }, { Format::BC5, 38.0 }, { Format::BC7, 38.0 } };
+			const auto color = CreateImage(128, 128, Content::Color, 11);
+			const auto normal = CreateImage(128, 128, Content::Normal, 11);
+			const auto mask = CreateImage(128, 128, Content::Mask, 11);
+
+			for (const auto [format, threshold] : thresholds)
+			{
+				const auto& image = format == Format::BC5 ? normal : (format == Format::BC4 ? mask : color);
+				const auto blocks = Compress(image.data(), 128, 128, format);
+				const auto psnr = ComputePsnr(image, Decompress(blocks.data(), 128, 128, format), format);
+
+				report.Check(psnr >= threshold, "quality: PSNR below threshold");
+			}
+		}
+
+		// Rows are independent, so parallel compression matches serial.
+		{
+			const auto image = CreateImage(96, 40, Content::Color, 3);
+
+			bool deterministic = true;
+			for (const auto format : formats)
+			{
+				deterministic &= Compress(image.data(), 96, 40, format, true) == Compress(image.data(), 96, 40, format, false);
+			}
+
+			report.Check(deterministic, "parallel: parallel compression doesn't match serial");
+		}
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Block Compression Benchmark");
+
+		constexpr uint32_t size = 1024;
+		constexpr double sourceMegabytes = size * size * 4 / (1024.0 * 1024.0);
+
+		VGLog(logRendering, "Block compression benchmark: {}x{} images, {} hardware threads.", size, size, std::thread::hardware_concurrency());
+
+		const auto color = CreateImage(size, size, Content::Color, 1);
+		const auto normal = CreateImage(size, size, Content::Normal, 2);
+		const auto mask = CreateImage(size, size, Content::Mask, 3);
+
+		// Each format on the content it's chosen for at import, and BC1 and BC3 as the fast alternatives for color.
+		const std::tuple<const char*, Format, const std::vector<uint8_t>*> runs[] = {
+			{ "BC7 color", Format::BC7, &color },
+			{ "BC3 color", Format::BC3, &color },
+			{ "BC1 color", Format::BC1, &color },
+			{ "BC5 normal", Format::BC5, &normal },
+			{ "BC1 mask", Format::BC1, &mask },
+			{ "BC4 mask", Format::BC4, &mask }
+		};
+
+		for (const auto& [name, format, image] : runs)
+		{
+			const auto Run = [&](bool parallel, std::vector<uint8_t>& blocks)
+			{
+				const auto begin = std::chrono::high_resolution_clock::now();
+				blocks = Compress(image->data(), size, size, format, parallel);
+				const auto end = std::chrono::high_resolution_clock::now();
+
+				return std::chrono::duration<double, std::milli>(end - begin).count();
+			};
+
+			std::vector<uint8_t> blocks;
+			const auto serial = Run(false, blocks);
+			const auto parallel = Run(true, blocks);
+			const auto psnr = ComputePsnr(*image, Decompress(blocks.data(), size, size, format), format);
+
+			VGLog(logRendering, "  {}: {:.2f} dB PSNR, serial {:.1f} ms ({:.1f} MB/s), parallel {:.1f} ms ({:.1f} MB/s), {:.1f}x speedup, {}:1 ratio.", name, psnr,
+				serial, sourceMegabytes * 1000.0 / serial, parallel, sourceMegabytes * 1000.0 / parallel, serial / parallel, 64 / GetBlockSize(format));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <dxgiformat.h>
+
+#include <vector>
+#include <cstdint>
+
+// CPU block compression of imported textures, so that materials are uploaded and sampled compressed. Each 4x4 block of texels
+// is encoded independently, rows of blocks are compressed in parallel. Inputs are tightly packed R8G8B8A8 texels, levels smaller
+// than a block are padded by clamping to their edge texels. Error is minimized in the stored space, sRGB images aren't linearized.
+namespace BlockCompression
+{
+	enum class Format : uint32_t
+	{
+		BC1,  // RGB, 5:6:5 endpoints and four colors per block. 4 bits per texel.
+		BC3,  // RGBA, a BC1 color block with a BC4 alpha block. 8 bits per texel.
+		BC4,  // R, 8 bit endpoints and eight values per block. 4 bits per texel.
+		BC5,  // RG, two BC4 blocks. 8 bits per texel.
+		BC7  // RGBA, one subset in mode 6 with sixteen colors on a line, or mode 5 with separate color and alpha. 8 bits per texel.
+	};
+
+	// Compressed levels of a texture, including the base.
+	struct Texture
+	{
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		std::vector<std::vector<uint8_t>> levels;
+	};
+
+	// Bytes of a 4x4 block.
+	uint32_t GetBlockSize(Format format);
+	DXGI_FORMAT GetResourceFormat(Format format, bool sRGB);
+	// Bytes of a level, rows of blocks are tightly packed.
+	size_t ComputeSize(Format format, uint32_t width, uint32_t height);
+
+	std::vector<uint8_t> Compress(const uint8_t* texels, uint32_t width, uint32_t height, Format format, bool parallel = true);
+	// Returns R8G8B8A8 texels, channels missing from the format are zero, and alpha is opaque. Only decodes blocks this encoder
+	// writes, BC7 blocks in modes other than 5 and 6 decode as zero.
+	std::vector<uint8_t> Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, Format format);
+
+	// Headless checks of the block layouts and encode quality against the decoder, on synthetic images.
+	void Test();
+	// Headless quality (PSNR) and throughput of each format, on synthetic color, normal and mask images.
+	void Benchmark();
+}
\ No newline at end of file
@@ -18,8 +18,7 @@ void Bloom::Initialize(RenderDevice* inDevice)
 	extractLayout = RenderPipelineLayout{}
 		.ComputeShader({ "Bloom/Extract.hlsl", "Main" });
 
-	downsampleLayout = RenderPipelineLayout{}
-		.ComputeShader({ "Bloom/Downsample.hlsl", "Main" });
+	downsampler.Initialize(device, DownsampleReduction::KarisAverage, false);
 
 	upsampleLayout = RenderPipelineLayout{}
 		.ComputeShader({ "Bloom/Upsample.hlsl", "Main" });
@@ -64,48 +63,35 @@ void Bloom::Render(RenderGraph& graph, const RenderResource hdrSource)
 	const auto mipLevels = (int)std::floor(std::log2(std::max(width, height)));
 	bloomPasses = std::min(bloomDownsamples, mipLevels - 1);
 
+	static_assert(bloomDownsamples <= (int)SinglePassDownsampler::groupLevels, "Bloom downsamples must be finished by a single thread group, they don't use the counter.");
+
 	TextureView downsampleExtractView{};
-	std::vector<std::pair<std::string, std::string>> downsampleExtractViewNames;
+	downsampleExtractView.SRV("srv", 0, 1);  // The extracted mip acts as the base level.
+	std::vector<std::string> downsampleExtractViewNames;
 	downsampleExtractViewNames.resize(bloomPasses);
 	for (int i = 0; i < bloomPasses; ++i)
 	{
-		downsampleExtractViewNames[i] = std::make_pair(std::string{ "srv_" } + std::to_string(i), std::string{ "uav_" } + std::to_string(i));
-		downsampleExtractView.SRV(downsampleExtractViewNames[i].first, i, 1);  // The input mip acts as the base level.
-		downsampleExtractView.UAV(downsampleExtractViewNames[i].second, i + 1);
+		downsampleExtractViewNames[i] = std::string{ "uav_" } + std::to_string(i + 1);
+		downsampleExtractView.UAV(downsampleExtractViewNames[i], i + 1);
 	}
 
 	auto& downsamplePass = graph.AddPass("Bloom Downsample Pass", ExecutionQueue::Compute);
 	downsamplePass.Write(extractTexture, downsampleExtractView);
 	downsamplePass.Bind([this, extractTexture, downsampleExtractViewNames](CommandList& list, RenderPassResources& resources)
 	{
-		list.BindPipeline(downsampleLayout);
-
 		auto& extractTextureComponent = device->GetResourceManager().Get(resources.GetTexture(extractTexture));
 
-		struct BindData
+		// Every mip in one dispatch. The first level isn't written without resampling.
+		std::vector<uint32_t> levelTextures;
+		levelTextures.reserve(bloomPasses + 1);
+		levelTextures.emplace_back(0);
+		for (const auto& viewName : downsampleExtractViewNames)
 		{
-			uint32_t inputTexture;
-			uint32_t outputTexture;
-		} bindData;
-
-		for (int i = 0; i < bloomPasses; ++i)
-		{
-			std::string zoneName = "Downsample pass " + std::to_string(i + 1);
-			VGScopedGPUTransientStat(zoneName.c_str(), device->GetDirectContext(), list.Native());
-
-			bindData.inputTexture = resources.Get(extractTexture, downsampleExtractViewNames[i].first);
-			bindData.outputTexture = resources.Get(extractTexture, downsampleExtractViewNames[i].second);
-			list.BindConstants("bindData", bindData);
-
-			const auto sizeFactor = std::pow(2.f, i + 1);  // Add one to dispatch in the dimensions of the output.
-			uint32_t dispatchX = std::ceil(extractTextureComponent.description.width / (8.f * sizeFactor));
-			uint32_t dispatchY = std::ceil(extractTextureComponent.description.height / (8.f * sizeFactor));
-
-			list.Dispatch(dispatchX, dispatchY, 1);
-
-			list.UAVBarrier(resources.GetTexture(extractTexture));
-			list.FlushBarriers();
+			levelTextures.emplace_back(resources.Get(extractTexture, viewName));
 		}
+
+		const XMUINT2 size = { extractTextureComponent.description.width, extractTextureComponent.description.height };
+		downsampler.Downsample(list, resources.Get(extractTexture, "srv"), 0, size, levelTextures);
 	});
 
 	TextureView upsampleExtractView{};
@@ -4,6 +4,7 @@
 
 #include <Rendering/RenderPipeline.h>
 #include <Rendering/RenderGraphResource.h>
+#include <Rendering/SinglePassDownsampler.h>
 
 class RenderDevice;
 class RenderGraph;
@@ -14,7 +15,7 @@ private:
 	RenderDevice* device;
 
 	RenderPipelineLayout extractLayout;
-	RenderPipelineLayout downsampleLayout;
+	SinglePassDownsampler downsampler;
 	RenderPipelineLayout upsampleLayout;
 
 	uint32_t bloomPasses = 0;
@@ -0,0 +1,521 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/CloudReconstruction.h>
+#include <Rendering/RenderView.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace CloudReconstruction
+{
+	namespace
+	{
+		uint32_t BayerIndex(uint32_t x, uint32_t y, uint32_t bits)
+		{
+			// Lower coordinate bits select the coarser levels of the matrix.
+			constexpr uint32_t digits[2][2] = { { 0, 3 }, { 2, 1 } };  // Indexed by x, then y.
+
+			uint32_t index = 0;
+			for (uint32_t bit = 0; bit < bits; ++bit)
+			{
+				index = index * 4 + digits[(x >> bit) & 1][(y >> bit) & 1];
+			}
+
+			return index;
+		}
+
+		XMFLOAT4 Lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+		{
+			return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+		}
+
+		// Matches sampling with bilinearClamp.
+		XMFLOAT4 SampleBilinear(const Image& image, const XMFLOAT2& uv)
+		{
+			const auto x = uv.x * image.width - 0.5f;
+			const auto y = uv.y * image.height - 0.5f;
+			const auto baseX = std::floor(x);
+			const auto baseY = std::floor(y);
+
+			const auto Texel = [&](float texelX, float texelY)
+			{
+				return image.color[image.Index(static_cast<uint32_t>(std::clamp(texelX, 0.f, (float)image.width - 1.f)), static_cast<uint32_t>(std::clamp(texelY, 0.f, (float)image.height - 1.f)))];
+			};
+
+			return Lerp(Lerp(Texel(baseX, baseY), Texel(baseX + 1.f, baseY), x - baseX), Lerp(Texel(baseX, baseY + 1.f), Texel(baseX + 1.f, baseY + 1.f), x - baseX), y - baseY);
+		}
+
+		XMVECTOR UvToClipSpace(const XMFLOAT2& uv)
+		{
+			return XMVectorSet(uv.x * 2.f - 1.f, (1.f - uv.y) * 2.f - 1.f, 0.f, 1.f);
+		}
+
+		// Synthetic cloud layer for the tests, a horizontal plane above the camera with a pattern of transmittance.
+		void TraceCloudLayer(const Camera& camera, const XMFLOAT2& uv, XMFLOAT4& color, float& depth)
+		{
+			constexpr float layerHeight = 2000.f;  // Meters.
+			constexpr float featureSize = 150.f;
+
+			const auto viewSpace = XMVectorSetW(XMVector4Transform(UvToClipSpace(uv), camera.inverseProjection), 0.f);
+			const auto direction = XMVector3Normalize(XMVector4Transform(viewSpace, camera.inverseView));
+
+			color = { 0.f, 0.f, 0.f, 1.f };
+			depth = noCloudDepth;
+
+			const auto height = XMVectorGetZ(direction);
+			if (height <= 0.01f)
+			{
+				return;
+			}
+
+			const auto distance = (layerHeight - camera.position.z) / height;
+			const auto x = camera.position.x + XMVectorGetX(direction) * distance;
+			const auto y = camera.position.y + XMVectorGetY(direction) * distance;
+			const auto transmittance = 0.5f + 0.5f * std::sin(x / featureSize) * std::sin(y / featureSize);
+
+			color = { 1.f - transmittance, 1.f - transmittance, 1.f - transmittance, transmittance };
+			depth = distance * 0.001f;
+		}
+
+		// Traces the pixels of the history updated this frame, or every pixel if the block is 1.
+		void TraceFrame(const Camera& camera, const XMUINT2& historySize, const XMUINT2& offset, uint32_t updateBlock, Image& trace)
+		{
+			const auto traceSize = TraceSize(historySize, updateBlock);
+			trace.Resize(traceSize.x, traceSize.y);
+
+			for (uint32_t y = 0; y < traceSize.y; ++y)
+			{
+				for (uint32_t x = 0; x < traceSize.x; ++x)
+				{
+					// Matches the trace pass, pixels past the edge of the history are traced but never used.
+					const XMFLOAT2 uv{ (x * updateBlock + offset.x + 0.5f) / historySize.x, (y * updateBlock + offset.y + 0.5f) / historySize.y };
+					const auto index = trace.Index(x, y);
+					TraceCloudLayer(camera, uv, trace.color[index], trace.depth[index]);
+				}
+			}
+		}
+	}
+
+	void Image::Resize(uint32_t inWidth, uint32_t inHeight)
+	{
+		width = inWidth;
+		height = inHeight;
+		color.resize(width * height);
+		depth.resize(width * height);
+	}
+
+	XMUINT2 HistorySize(uint32_t width, uint32_t height, uint32_t resolutionScale)
+	{
+		return { (width + resolutionScale - 1) / resolutionScale, (height + resolutionScale - 1) / resolutionScale };
+	}
+
+	XMUINT2 TraceSize(const XMUINT2& historySize, uint32_t updateBlock)
+	{
+		return { (historySize.x + updateBlock - 1) / updateBlock, (historySize.y + updateBlock - 1) / updateBlock };
+	}
+
+	XMUINT2 UpdateOffset(uint32_t frame, uint32_t updateBlock)
+	{
+		VGAssert(std::has_single_bit(updateBlock), "Update blocks must be a power of two.");
+
+		const auto bits = static_cast<uint32_t>(std::countr_zero(updateBlock));
+		const auto index = frame % (updateBlock * updateBlock);
+
+		for (uint32_t y = 0; y < updateBlock; ++y)
+		{
+			for (uint32_t x = 0; x < updateBlock; ++x)
+			{
+				if (BayerIndex(x, y, bits) == index)
+				{
+					return { x, y };
+				}
+			}
+		}
+
+		return { 0, 0 };
+	}
+
+	XMFLOAT2 ReprojectUv(const Camera& camera, const XMFLOAT2& uv, float depth)
+	{
+		const auto viewProjection = XMMatrixMultiply(camera.view, camera.projection);
+		const auto inverseViewProjection = XMMatrixMultiply(camera.lastFrameInverseProjection, camera.lastFrameInverseView);
+
+		auto worldSpace = XMVector4Transform(UvToClipSpace(uv), inverseViewProjection);
+		worldSpace = XMVectorDivide(worldSpace, XMVectorSplatW(worldSpace));
+
+		const auto cameraPosition = XMVectorSet(camera.position.x, camera.position.y, camera.position.z, 1.f);
+		const auto ray = XMVector3Normalize(XMVectorSubtract(worldSpace, cameraPosition));
+		worldSpace = XMVectorSetW(XMVectorAdd(cameraPosition, XMVectorScale(ray, depth)), 1.f);
+
+		auto reprojected = XMVector4Transform(worldSpace, viewProjection);
+		reprojected = XMVectorDivide(reprojected, XMVectorSplatW(reprojected));
+
+		const XMFLOAT2 reprojectedUv{ (XMVectorGetX(reprojected) + 1.f) * 0.5f, 1.f - (XMVectorGetY(reprojected) + 1.f) * 0.5f };
+
+		return { uv.x * 2.f - reprojectedUv.x, uv.y * 2.f - reprojectedUv.y };
+	}
+
+	void Reconstruct(const Image& trace, const Image* history, const Camera& camera, const XMUINT2& updateOffset, uint32_t updateBlock, Image& output,
+		std::vector<Source>* sources)
+	{
+		VGScopedCPUStat("Cloud Reconstruction");
+
+		if (sources)
+		{
+			sources->resize(output.width * output.height);
+		}
+
+		for (uint32_t y = 0; y < output.height; ++y)
+		{
+			for (uint32_t x = 0; x < output.width; ++x)
+			{
+				const auto index = output.Index(x, y);
+				auto source = Source::Fallback;
+
+				if (x % updateBlock == updateOffset.x && y % updateBlock == updateOffset.y)
+				{
+					const auto traceIndex = trace.Index(x / updateBlock, y / updateBlock);
+					output.color[index] = trace.color[traceIndex];
+					output.depth[index] = trace.depth[traceIndex];
+					source = Source::Traced;
+				}
+
+				else
+				{
+					// Traced pixels around this one, in trace texels.
+					const auto traceX = ((float)x - (float)updateOffset.x) / updateBlock;
+					const auto traceY = ((float)y - (float)updateOffset.y) / updateBlock;
+					const auto baseX = std::floor(traceX);
+					const auto baseY = std::floor(traceY);
+					const auto fractionX = traceX - baseX;
+					const auto fractionY = traceY - baseY;
+
+					const auto Tap = [&](float tapX, float tapY)
+					{
+						return trace.Index(static_cast<uint32_t>(std::clamp(tapX, 0.f, (float)trace.width - 1.f)), static_cast<uint32_t>(std::clamp(tapY, 0.f, (float)trace.height - 1.f)));
+					};
+
+					const size_t taps[] = { Tap(baseX, baseY), Tap(baseX + 1.f, baseY), Tap(baseX, baseY + 1.f), Tap(baseX + 1.f, baseY + 1.f) };
+
+					output.color[index] = Lerp(Lerp(trace.color[taps[0]], trace.color[taps[1]], fractionX), Lerp(trace.color[taps[2]], trace.color[taps[3]], fractionX), fractionY);
+					// Depth isn't interpolated, pixels without clouds are far away.
+					output.depth[index] = trace.depth[taps[(fractionX > 0.5f ? 1 : 0) + (fractionY > 0.5f ? 2 : 0)]];
+
+					if (history)
+					{
+						const XMFLOAT2 uv{ (x + 0.5f) / output.width, (y + 0.5f) / output.height };
+						const auto previousUv = ReprojectUv(camera, uv, history->depth[index] * 1000.f);
+
+						if (previousUv.x >= 0.f && previousUv.x <= 1.f && previousUv.y >= 0.f && previousUv.y <= 1.f)
+						{
+							// Bilinear like the history sampler, nearest samples would drift with every reprojection.
+							const auto previous = SampleBilinear(*history, previousUv);
+							const auto previousDepth = history->depth[history->Index(std::min(static_cast<uint32_t>(previousUv.x * output.width), output.width - 1),
+								std::min(static_cast<uint32_t>(previousUv.y * output.height), output.height - 1))];
+
+							// Moving history is only kept if it's plausible given the traced pixels around it, otherwise it would
+							// smear disoccluded clouds. Still history keeps details finer than the traced pixels.
+							const auto motion = std::max(std::abs(previousUv.x - uv.x) * output.width, std::abs(previousUv.y - uv.y) * output.height);
+							auto accepted = true;
+
+							if (motion > motionThreshold)
+							{
+								auto minimum = XMLoadFloat4(&trace.color[taps[0]]);
+								auto maximum = minimum;
+								for (const auto tap : taps)
+								{
+									minimum = XMVectorMin(minimum, XMLoadFloat4(&trace.color[tap]));
+									maximum = XMVectorMax(maximum, XMLoadFloat4(&trace.color[tap]));
+								}
+
+								const auto value = XMLoadFloat4(&previous);
+								const auto tolerance = XMVectorReplicate(historyTolerance);
+								accepted = XMVector4GreaterOrEqual(value, XMVectorSubtract(minimum, tolerance)) && XMVector4LessOrEqual(value, XMVectorAdd(maximum, tolerance));
+							}
+
+							if (accepted)
+							{
+								output.color[index] = previous;
+								output.depth[index] = previousDepth;
+								source = Source::History;
+							}
+						}
+					}
+				}
+
+				if (sources)
+				{
+					(*sources)[index] = source;
+				}
+			}
+		}
+	}
+
+	void Upsample(const Image& history, const Image& geometryDepth, uint32_t resolutionScale, Image& output)
+	{
+		VGScopedCPUStat("Cloud Upsample");
+
+		output.Resize(geometryDepth.width, geometryDepth.height);
+
+		for (uint32_t y = 0; y < output.height; ++y)
+		{
+			for (uint32_t x = 0; x < output.width; ++x)
+			{
+				const auto index = output.Index(x, y);
+				const auto depth = geometryDepth.depth[index];
+
+				const auto historyX = (x + 0.5f) / resolutionScale - 0.5f;
+				const auto historyY = (y + 0.5f) / resolutionScale - 0.5f;
+				const auto baseX = std::floor(historyX);
+				const auto baseY = std::floor(historyY);
+				const auto fractionX = historyX - baseX;
+				const auto fractionY = historyY - baseY;
+
+				auto color = XMVectorZero();
+				auto totalWeight = 0.f;
+				auto bestWeight = -1.f;
+
+				for (uint32_t tap = 0; tap < 4; ++tap)
+				{
+					const auto tapX = static_cast<uint32_t>(std::clamp(baseX + (tap & 1), 0.f, (float)history.width - 1.f));
+					const auto tapY = static_cast<uint32_t>(std::clamp(baseY + (tap >> 1), 0.f, (float)history.height - 1.f));
+
+					// Geometry depth at the center of the render pixels the history pixel covers.
+					const auto centerX = std::min(tapX * resolutionScale + resolutionScale / 2, output.width - 1);
+					const auto centerY = std::min(tapY * resolutionScale + resolutionScale / 2, output.height - 1);
+					const auto tapDepth = geometryDepth.depth[geometryDepth.Index(centerX, centerY)];
+
+					const auto bilinear = ((tap & 1) ? fractionX : 1.f - fractionX) * ((tap >> 1) ? fractionY : 1.f - fractionY);
+					const auto weight = bilinear / (depthEpsilon + std::abs(depth - tapDepth) / std::max(depth, 1e-6f));
+					const auto historyIndex = history.Index(tapX, tapY);
+
+					color = XMVectorMultiplyAdd(XMLoadFloat4(&history.color[historyIndex]), XMVectorReplicate(weight), color);
+					totalWeight += weight;
+
+					if (weight > bestWeight)
+					{
+						bestWeight = weight;
+						output.depth[index] = history.depth[historyIndex];
+					}
+				}
+
+				XMStoreFloat4(&output.color[index], XMVectorScale(color, 1.f / totalWeight));
+			}
+		}
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Cloud Reconstruction Test");
+
+		TestReport report{ logRendering, VGText("Cloud reconstruction") };
+
+		report.Check(HistorySize(1920, 1080, 2).x == 960 && HistorySize(1920, 1080, 2).y == 540 && HistorySize(1921, 1081, 2).x == 961, "sizes: history doesn't cover the render resolution");
+		report.Check(TraceSize({ 960, 540 }, 4).x == 240 && TraceSize({ 961, 541 }, 4).y == 136, "sizes: trace target doesn't cover the history");
+
+		// Every pixel of a block is traced exactly once per cycle, and consecutive frames don't trace neighboring pixels.
+		for (const uint32_t block : { 1u, 2u, 4u, 8u })
+		{
+			std::vector<uint32_t> traced(block * block, 0);
+			bool spread = true;
+			auto previous = UpdateOffset(block * block - 1, block);
+
+			for (uint32_t frame = 0; frame < block * block * 2; ++frame)
+			{
+				const auto offset = UpdateOffset(frame, block);
+				++traced[offset.x + offset.y * block];
+
+				const auto distance = std::abs((int)offset.x - (int)previous.x) + std::abs((int)offset.y - (int)previous.y);
+				spread = spread && (block < 4 || distance > 1);
+				previous = offset;
+			}
+
+			report.Check(std::all_of(traced.begin(), traced.end(), [](auto count) { return count == 2; }), "pattern: pixels aren't traced once per cycle");
+			report.Check(spread, "pattern: consecutive frames trace neighboring pixels");
+		}
+
+		report.Check(UpdateOffset(1, 4).x == 2 && UpdateOffset(1, 4).y == 2, "pattern: 4x4 pattern doesn't follow the Bayer matrix");
+
+		const auto CreateCamera = [](float yaw, float lastYaw, const XMUINT2& size)
+		{
+			const auto View = [](float angle)
+			{
+				const auto target = XMVectorSet(std::cos(angle), std::sin(angle), 0.6f, 1.f);
+				return XMMatrixLookAtRH(XMVectorSet(0.f, 0.f, 0.f, 1.f), target, XMVectorSet(0.f, 0.f, 1.f, 0.f));
+			};
+
+			const auto aspectRatio = size.x / (float)size.y;
+			const auto projection = XMMatrixPerspectiveFovRH(XM_PIDIV2 / 2.f, aspectRatio, 100000.f, 0.1f);
+
+			return RenderViewSet::CreateCamera({ 0.f, 0.f, 0.f }, View(yaw), projection, View(lastYaw), projection, 0.1f, 100000.f, XM_PIDIV2, aspectRatio);
+		};
+
+		const auto MeanError = [](const Image& image, const Image& reference)
+		{
+			double error = 0.0;
+			for (size_t i = 0; i < image.color.size(); ++i)
+			{
+				error += std::abs(image.color[i].w - reference.color[i].w);
+			}
+
+			return error / image.color.size();
+		};
+
+		const XMUINT2 historySize{ 160, 90 };
+
+		for (const uint32_t block : { 1u, 2u, 4u })
+		{
+			const auto cycle = block * block;
+
+			// Still camera, the history converges to a full trace after one cycle.
+			{
+				const auto camera = CreateCamera(0.f, 0.f, historySize);
+
+				Image full;
+				TraceFrame(camera, historySize, { 0, 0 }, 1, full);
+
+				Image history;
+				Image output;
+				Image trace;
+				std::vector<Source> sources;
+				bool pattern = true;
+
+				for (uint32_t frame = 0; frame < cycle; ++frame)
+				{
+					const auto offset = UpdateOffset(frame, block);
+					TraceFrame(camera, historySize, offset, block, trace);
+
+					output.Resize(historySize.x, historySize.y);
+					Reconstruct(trace, frame > 0 ? &history : nullptr, camera, offset, block, output, &sources);
+
+					for (uint32_t y = 0; y < historySize.y; ++y)
+					{
+						for (uint32_t x = 0; x < historySize.x; ++x)
+						{
+							const auto traced = x % block == offset.x && y % block == offset.y;
+							const auto expected = traced ? Source::Traced : (frame > 0 ? Source::History : Source::Fallback);
+							pattern = pattern && sources[output.Index(x, y)] == expected;
+						}
+					}
+
+					std::swap(history, output);
+				}
+
+				report.Check(pattern, "still: pixels don't come from the expected source");
+				// Reprojecting with an unchanged camera isn't exact in floating point, bilinear history picks up a little of its neighbors.
+				report.Check(MeanError(history, full) < 1e-4, "still: history doesn't converge to a full trace");
+				report.Check(history.depth == full.depth, "still: history depth doesn't converge to a full trace");
+			}
+
+			if (block == 1)
+			{
+				continue;
+			}
+
+			// Panning camera, history must beat interpolating the traced pixels alone, and pixels moving on screen are rejected.
+			{
+				constexpr float yawSpeed = 0.004f;
+
+				Image history;
+				Image output;
+				Image spatialOnly;
+				Image trace;
+				Image full;
+				std::vector<Source> sources;
+				double historyError = 0.0;
+				double spatialError = 0.0;
+				size_t offscreen = 0;
+
+				for (uint32_t frame = 0; frame < cycle * 4; ++frame)
+				{
+					const auto camera = CreateCamera(frame * yawSpeed, (frame > 0 ? frame - 1 : 0) * yawSpeed, historySize);
+					const auto offset = UpdateOffset(frame, block);
+					TraceFrame(camera, historySize, offset, block, trace);
+
+					output.Resize(historySize.x, historySize.y);
+					Reconstruct(trace, frame > 0 ? &history : nullptr, camera, offset, block, output, &sources);
+
+					spatialOnly.Resize(historySize.x, historySize.y);
+					Reconstruct(trace, nullptr, camera, offset, block, spatialOnly);
+
+					if (frame >= cycle)
+					{
+						TraceFrame(camera, historySize, { 0, 0 }, 1, full);
+						historyError += MeanError(output, full);
+						spatialError += MeanError(spatialOnly, full);
+
+						// Pixels on the edge the view turns towards have no history.
+						for (uint32_t y = 0; y < historySize.y; ++y)
+						{
+							offscreen += sources[output.Index(0, y)] == Source::Fallback ? 1 : 0;
+							offscreen += sources[output.Index(historySize.x - 1, y)] == Source::Fallback ? 1 : 0;
+						}
+					}
+
+					std::swap(history, output);
+				}
+
+				report.Check(historyError < spatialError, "panning: history is worse than interpolating traced pixels");
+				report.Check(offscreen > 0, "panning: history entering the view wasn't rejected");
+
+				VGLog(logRendering, "Cloud reconstruction test, {}x{} blocks while panning: mean transmittance error {:.4f} with history, {:.4f} without.", block, block,
+					historyError / (cycle * 3), spatialError / (cycle * 3));
+			}
+		}
+
+		// Upsampling, the history must not bleed across depth edges.
+		{
+			constexpr uint32_t scale = 2;
+
+			Image history;
+			history.Resize(8, 8);
+			Image geometryDepth;
+			geometryDepth.Resize(16, 16);
+
+			for (uint32_t y = 0; y < 8; ++y)
+			{
+				for (uint32_t x = 0; x < 8; ++x)
+				{
+					// Left half is in front of a near object, right half sees the sky.
+					const auto near = x < 4;
+					history.color[history.Index(x, y)] = near ? XMFLOAT4{ 0.f, 0.f, 0.f, 1.f } : XMFLOAT4{ 0.5f, 0.5f, 0.5f, 0.2f };
+					history.depth[history.Index(x, y)] = near ? noCloudDepth : 3.f;
+				}
+			}
+
+			for (uint32_t y = 0; y < 16; ++y)
+			{
+				for (uint32_t x = 0; x < 16; ++x)
+				{
+					geometryDepth.depth[geometryDepth.Index(x, y)] = x < 8 ? 10.f : 10000.f;
+				}
+			}
+
+			Image output;
+			Upsample(history, geometryDepth, scale, output);
+
+			bool constant = true;
+			bool edges = true;
+			for (uint32_t y = 0; y < 16; ++y)
+			{
+				for (uint32_t x = 0; x < 16; ++x)
+				{
+					const auto& color = output.color[output.Index(x, y)];
+					const auto expected = x < 8 ? 1.f : 0.2f;
+
+					// Pixels next to the edge get a little from across it, far less than bilinear weighting would give.
+					edges = edges && std::abs(color.w - expected) < 0.02f;
+					constant = constant && (x == 7 || x == 8 || std::abs(color.w - expected) < 1e-5f);
+				}
+			}
+
+			report.Check(constant, "upsample: uniform regions don't upsample to themselves");
+			report.Check(edges, "upsample: clouds bleed across geometry edges");
+			report.Check(output.depth[output.Index(7, 5)] == noCloudDepth && output.depth[output.Index(8, 5)] == 3.f, "upsample: depth doesn't come from the matching side of the edge");
+		}
+
+		report.Log();
+	}
+}
\ No newline at end of file
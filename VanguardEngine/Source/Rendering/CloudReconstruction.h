@@ -0,0 +1,62 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+
+#include <vector>
+#include <cstdint>
+
+// CPU implementation of the reduced resolution cloud update, see Clouds/Reconstruction.hlsl. Clouds are ray marched into a
+// history that is scaled down from the render resolution, and only one pixel of each block of the history is traced per frame.
+// The remaining pixels reproject the previous history, falling back to the traced pixels around them when it's rejected.
+namespace CloudReconstruction
+{
+	// Must match Reconstruction.hlsl.
+	constexpr float historyTolerance = 0.05f;  // Widening of the traced neighborhood that moving history must fall within.
+	constexpr float motionThreshold = 0.25f;  // History pixels of movement before history is clamped to the neighborhood.
+	constexpr float depthEpsilon = 0.01f;  // Relative depth difference at which upsampling weights start to fall off.
+	constexpr float noCloudDepth = 1000000.f;  // Kilometers, depth of pixels without clouds.
+
+	struct Image
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<XMFLOAT4> color;  // Scattering and transmittance.
+		std::vector<float> depth;  // Cloud depth in kilometers, or linear geometry depth.
+
+		void Resize(uint32_t inWidth, uint32_t inHeight);
+		size_t Index(uint32_t x, uint32_t y) const { return x + y * width; }
+	};
+
+	enum class Source : uint8_t
+	{
+		Traced,  // Ray marched this frame.
+		History,  // Reprojected from the previous history.
+		Fallback  // Interpolated from the traced pixels around it.
+	};
+
+	// The history covers each block of resolution scale by resolution scale render pixels with one pixel.
+	XMUINT2 HistorySize(uint32_t width, uint32_t height, uint32_t resolutionScale);
+	// The trace target holds one pixel per update block of the history.
+	XMUINT2 TraceSize(const XMUINT2& historySize, uint32_t updateBlock);
+	// Pixel of each block traced in a frame. Every pixel is traced once per updateBlock squared frames, in the order of a Bayer
+	// matrix so that consecutive frames are spread across the block.
+	XMUINT2 UpdateOffset(uint32_t frame, uint32_t updateBlock);
+
+	// Equivalent of ReprojectUv in Reprojection.hlsli, depth is in meters.
+	XMFLOAT2 ReprojectUv(const Camera& camera, const XMFLOAT2& uv, float depth);
+
+	// Equivalent of ReconstructMain, builds the history of this frame. Without a previous history every pixel that wasn't traced
+	// falls back to its traced neighbors.
+	void Reconstruct(const Image& trace, const Image* history, const Camera& camera, const XMUINT2& updateOffset, uint32_t updateBlock, Image& output,
+		std::vector<Source>* sources = nullptr);
+
+	// Equivalent of UpsampleMain, scales the history up to the geometry depth's resolution. Neighbors whose geometry depth differs
+	// from the pixel's are weighted down, so that clouds don't bleed across the edges of geometry.
+	void Upsample(const Image& history, const Image& geometryDepth, uint32_t resolutionScale, Image& output);
+
+	// Headless checks of the update pattern, history reprojection and rejection, and upsampling, on a synthetic cloud layer.
+	void Test();
+}
\ No newline at end of file
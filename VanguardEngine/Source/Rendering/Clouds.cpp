@@ -6,8 +6,12 @@
 #include <Rendering/RenderPass.h>
 #include <Rendering/Atmosphere.h>
 #include <Rendering/RenderUtils.h>
+#include <Rendering/CloudReconstruction.h>
 #include <Utility/Math.h>
 
+#include <algorithm>
+#include <bit>
+
 // #TEMP
 #include <Rendering/Renderer.h>
 
@@ -19,15 +23,11 @@ void Clouds::GenerateWeather(CommandList& list, uint32_t weatherTexture)
 		uint32_t weatherTexture;
 		float globalCoverage;
 		float precipitation;
-		float time;
-		XMFLOAT2 wind;
 	} bindData;
 
 	bindData.weatherTexture = weatherTexture;
 	bindData.globalCoverage = coverage;
 	bindData.precipitation = precipitation;
-	bindData.wind = { windDirection.x * windStrength, windDirection.y * windStrength };
-	bindData.time = Renderer::Get().GetAppTime();
 
 	list.BindConstants("bindData", bindData);
 
@@ -58,6 +58,50 @@ Clouds::~Clouds()
 {
 	device->GetResourceManager().Destroy(baseShapeNoise);
 	device->GetResourceManager().Destroy(detailShapeNoise);
+	device->GetResourceManager().Destroy(weather);
+
+	if (shadowMap.handle != entt::null)
+	{
+		device->GetResourceManager().Destroy(shadowMap);
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (history[i].handle != entt::null)
+		{
+			device->GetResourceManager().Destroy(history[i]);
+			device->GetResourceManager().Destroy(historyDepth[i]);
+		}
+	}
+}
+
+void Clouds::CreateHistory(const XMUINT2& size)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		if (history[i].handle != entt::null)
+		{
+			// The old history may still be in use by frames in flight.
+			device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), history[i]);
+			device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), historyDepth[i]);
+		}
+
+		TextureDescription historyDesc{
+			.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
+			.accessFlags = AccessFlag::GPUWrite,
+			.width = size.x,
+			.height = size.y,
+			.depth = 1,
+			.format = DXGI_FORMAT_R16G16B16A16_FLOAT
+		};
+		history[i] = device->GetResourceManager().Create(historyDesc, VGText("Clouds history"));
+
+		historyDesc.format = DXGI_FORMAT_R32_FLOAT;
+		historyDepth[i] = device->GetResourceManager().Create(historyDesc, VGText("Clouds history depth"));
+	}
+
+	historySize = size;
+	historyValid = false;
 }
 
 void Clouds::Initialize(RenderDevice* inDevice)
@@ -67,6 +111,10 @@ void Clouds::Initialize(RenderDevice* inDevice)
 	CvarCreate("cloudShadowMapResolution", "Defines the width and height of the sun shadow map for clouds", 2048);
 	CvarCreate("cloudShadowMapScale", "Multiplier for the scale of the cloud shadow map. Larger values increase scope but reduce fidelity", 0.05f);
 	CvarCreate("cloudRayMarchQuality", "Controls the ray march quality of the clouds. Increasing quality degrades performance. 0=default, 1=groundTruth", 0);
+	CvarCreate("cloudShadowMapInterval", "Frames between cloud shadow map updates while the sun and shadow map settings are unchanged. 1=every frame", 4);
+	CvarCreate("cloudShadowMapSunThreshold", "Change in solar zenith angle, in radians, that updates the cloud shadow map before its interval ends", 0.002f);
+	CvarCreate("cloudResolutionScale", "Divides the render resolution that clouds are reconstructed at, the result is upsampled with geometry depth. 1=full resolution", 2);
+	CvarCreate("cloudUpdateBlock", "Width and height of the blocks of which one cloud pixel is ray marched each frame, rounded down to a power of two. 1=every pixel", 2);
 
 	weatherLayout = RenderPipelineLayout{}
 		.ComputeShader({ "Clouds/Weather", "Main" });
@@ -77,6 +125,12 @@ void Clouds::Initialize(RenderDevice* inDevice)
 	detailNoiseLayout = RenderPipelineLayout{}
 		.ComputeShader({ "Clouds/Shapes", "DetailShapeMain" });
 
+	reconstructLayout = RenderPipelineLayout{}
+		.ComputeShader({ "Clouds/Reconstruction", "ReconstructMain" });
+
+	upsampleLayout = RenderPipelineLayout{}
+		.ComputeShader({ "Clouds/Reconstruction", "UpsampleMain" });
+
 	TextureDescription weatherDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
 		.accessFlags = AccessFlag::GPUWrite,
@@ -117,8 +171,55 @@ void Clouds::Initialize(RenderDevice* inDevice)
 	//	.format = DXGI_FORMAT_R11G11B10_FLOAT
 	//};
 	//distortionNoise = device->GetResourceManager().Create(distortionNoiseDesc, VGText("Clouds distortion noise"));
+}
+
+float Clouds::ScheduleUpdates(float solarZenithAngle)
+{
+	updateWeather = !weatherValid || coverage != weatherCoverage || precipitation != weatherPrecipitation;
+
+	if (updateWeather)
+	{
+		weatherValid = true;
+		weatherCoverage = coverage;
+		weatherPrecipitation = precipitation;
+		updateStats.weatherFramesSkipped = 0;
+	}
+
+	else
+	{
+		++updateStats.weatherFramesSkipped;
+		++updateStats.weatherSkips;
+	}
+
+	const auto resolution = *CvarGet("cloudShadowMapResolution", int);
+	const auto scale = *CvarGet("cloudShadowMapScale", float);
+	const auto quality = *CvarGet("cloudRayMarchQuality", int);
+	const auto interval = static_cast<uint32_t>(std::max(*CvarGet("cloudShadowMapInterval", int), 1));
+	const auto sunThreshold = *CvarGet("cloudShadowMapSunThreshold", float);
+
+	// New weather or settings that change the sun camera invalidate the shadow map immediately. Otherwise it's only refreshed
+	// periodically, to follow the wind.
+	updateShadowMap = !shadowMapValid || updateWeather || resolution != shadowMapResolution || scale != shadowMapScale ||
+		quality != shadowMapQuality || std::abs(solarZenithAngle - shadowMapZenithAngle) > sunThreshold ||
+		updateStats.shadowMapFramesSkipped + 1 >= interval;
+
+	if (updateShadowMap)
+	{
+		shadowMapValid = true;
+		shadowMapZenithAngle = solarZenithAngle;
+		shadowMapResolution = resolution;
+		shadowMapScale = scale;
+		shadowMapQuality = quality;
+		updateStats.shadowMapFramesSkipped = 0;
+	}
 
-	lastFrameClouds.id = 0;
+	else
+	{
+		++updateStats.shadowMapFramesSkipped;
+		++updateStats.shadowMapSkips;
+	}
+
+	return shadowMapZenithAngle;
 }
 
 CloudResources Clouds::Render(RenderGraph& graph, entt::registry& registry, const Atmosphere& atmosphere, const RenderResource cameraBuffer, const RenderResource depthStencil, const RenderResource atmosphereIrradiance)
@@ -148,41 +249,58 @@ CloudResources Clouds::Render(RenderGraph& graph, entt::registry& registry, cons
 		dirty = false;
 	}
 
-	auto& weatherPass = graph.AddPass("Weather Pass", ExecutionQueue::Compute);
-	weatherPass.Write(weatherTag, TextureView{}.UAV("", 0));
-	weatherPass.Bind([this, weatherTag](CommandList& list, RenderPassResources& resources)
+	if (updateWeather)
 	{
-		GenerateWeather(list, resources.Get(weatherTag));
-	});
+		auto& weatherPass = graph.AddPass("Weather Pass", ExecutionQueue::Compute);
+		weatherPass.Write(weatherTag, TextureView{}.UAV("", 0));
+		weatherPass.Bind([this, weatherTag](CommandList& list, RenderPassResources& resources)
+		{
+			GenerateWeather(list, resources.Get(weatherTag));
+		});
+	}
+
+	const auto resolutionScale = static_cast<uint32_t>(std::max(*CvarGet("cloudResolutionScale", int), 1));
+	const auto updateBlock = std::bit_floor(static_cast<uint32_t>(std::max(*CvarGet("cloudUpdateBlock", int), 1)));
+
+	const auto newHistorySize = CloudReconstruction::HistorySize(device->renderWidth, device->renderHeight, resolutionScale);
+	if (newHistorySize.x != historySize.x || newHistorySize.y != historySize.y)
+	{
+		CreateHistory(newHistorySize);
+	}
+
+	const auto traceSize = CloudReconstruction::TraceSize(historySize, updateBlock);
+	const auto updateOffset = CloudReconstruction::UpdateOffset(frame++, updateBlock);
+
+	const auto previousHistoryTag = graph.Import(history[historyIndex ^ 1]);
+	const auto previousHistoryDepthTag = graph.Import(historyDepth[historyIndex ^ 1]);
+	const auto historyTag = graph.Import(history[historyIndex]);
+	const auto historyDepthTag = graph.Import(historyDepth[historyIndex]);
 
 	auto& cloudsPass = graph.AddPass("Clouds Pass", ExecutionQueue::Graphics);
-	const auto cloudOutput = cloudsPass.Create(TransientTextureDescription{
-		.width = 0,
-		.height = 0,
+	const auto traceOutput = cloudsPass.Create(TransientTextureDescription{
+		.width = traceSize.x,
+		.height = traceSize.y,
 		.depth = 1,
-		.resolutionScale = 1.f,
 		.format = DXGI_FORMAT_R16G16B16A16_FLOAT
-	}, VGText("Clouds scattering transmittance"));
+	}, VGText("Clouds trace scattering transmittance"));
 	cloudsPass.Read(cameraBuffer, ResourceBind::SRV);
 	cloudsPass.Read(weatherTag, ResourceBind::SRV);
 	cloudsPass.Read(baseShapeNoiseTag, ResourceBind::SRV);
 	cloudsPass.Read(detailShapeNoiseTag, ResourceBind::SRV);
 	cloudsPass.Read(depthStencil, ResourceBind::SRV);
-	cloudsPass.Output(cloudOutput, OutputBind::RTV, LoadType::Preserve);
-	cloudsPass.Read(lastFrameClouds, ResourceBind::SRV);
+	cloudsPass.Output(traceOutput, OutputBind::RTV, LoadType::Preserve);
 	cloudsPass.Read(blueNoiseTag, ResourceBind::SRV);
 	cloudsPass.Read(atmosphereIrradiance, ResourceBind::SRV);
-	const auto cloudDepth = cloudsPass.Create(TransientTextureDescription{
-		.width = 0,
-		.height = 0,
+	const auto traceDepth = cloudsPass.Create(TransientTextureDescription{
+		.width = traceSize.x,
+		.height = traceSize.y,
 		.depth = 1,
-		.resolutionScale = 1.f,
 		.format = DXGI_FORMAT_R32_FLOAT
-	}, VGText("Clouds depth"));
-	cloudsPass.Write(cloudDepth, TextureView{}.UAV("", 0));
+	}, VGText("Clouds trace depth"));
+	cloudsPass.Write(traceDepth, TextureView{}.UAV("", 0));
 	cloudsPass.Bind([this, weatherTag, baseShapeNoiseTag, detailShapeNoiseTag, solarZenithAngle,
-		cameraBuffer, depthStencil, cloudOutput, lastFrame=lastFrameClouds, blueNoiseTag, cloudDepth,
-		atmosphereIrradiance](CommandList& list, RenderPassResources& resources)
+		cameraBuffer, depthStencil, blueNoiseTag, traceDepth, atmosphereIrradiance, updateOffset, updateBlock,
+		outputResolution=historySize](CommandList& list, RenderPassResources& resources)
 	{
 		auto cloudsLayout = RenderPipelineLayout{}
 			.VertexShader({ "Clouds/Clouds", "VSMain" })
@@ -204,8 +322,7 @@ CloudResources Clouds::Render(RenderGraph& graph, entt::registry& registry, cons
 			uint32_t cameraBuffer;
 			uint32_t cameraIndex;
 			float solarZenithAngle;
-			uint32_t timeSlice;
-			uint32_t lastFrameTexture;
+			XMUINT2 updateOffset;
 			XMFLOAT2 outputResolution;
 			uint32_t depthTexture;
 			uint32_t geometryDepthTexture;
@@ -213,6 +330,7 @@ CloudResources Clouds::Render(RenderGraph& graph, entt::registry& registry, cons
 			uint32_t atmosphereIrradianceBuffer;
 			XMFLOAT2 wind;
 			float time;
+			uint32_t updateBlock;
 		} bindData;
 
 		bindData.weatherTexture = resources.Get(weatherTag);
@@ -221,95 +339,207 @@ CloudResources Clouds::Render(RenderGraph& graph, entt::registry& registry, cons
 		bindData.cameraBuffer = resources.Get(cameraBuffer);
 		bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
 		bindData.solarZenithAngle = solarZenithAngle;
-
-		static int time = 0;
-		time++;
-		bindData.timeSlice = time % 16;
-		
-		const auto& cloudOutputComponent = device->GetResourceManager().Get(resources.GetTexture(cloudOutput));
-		bindData.outputResolution.x = cloudOutputComponent.description.width;
-		bindData.outputResolution.y = cloudOutputComponent.description.height;
-
-		bindData.lastFrameTexture = 0;
-		if (lastFrame.id != 0)
-			bindData.lastFrameTexture = resources.Get(lastFrame);
-
-		bindData.depthTexture = resources.Get(cloudDepth);
+		bindData.updateOffset = updateOffset;
+		bindData.outputResolution = { (float)outputResolution.x, (float)outputResolution.y };
+		bindData.depthTexture = resources.Get(traceDepth);
 		bindData.geometryDepthTexture = resources.Get(depthStencil);
 		bindData.blueNoiseTexture = resources.Get(blueNoiseTag);
 		bindData.atmosphereIrradianceBuffer = resources.Get(atmosphereIrradiance);
 		bindData.wind = { windDirection.x * windStrength, windDirection.y * windStrength };
 		bindData.time = Renderer::Get().GetAppTime();
+		bindData.updateBlock = updateBlock;
 
 		list.BindConstants("bindData", bindData);
 		list.DrawFullscreenQuad();
 	});
 
-	auto& shadowPass = graph.AddPass("Clouds Shadow Map Pass", ExecutionQueue::Graphics);
-	const auto shadowMapSize = *CvarGet("cloudShadowMapResolution", int);
-	const auto shadowMapTag = shadowPass.Create(TransientTextureDescription{
-		.width = (uint32_t)shadowMapSize,
-		.height = (uint32_t)shadowMapSize,
-		.depth = 1,
-		.format = DXGI_FORMAT_R16_FLOAT
-	}, VGText("Clouds shadow map"));
-	shadowPass.Read(cameraBuffer, ResourceBind::SRV);
-	shadowPass.Read(weatherTag, ResourceBind::SRV);
-	shadowPass.Read(baseShapeNoiseTag, ResourceBind::SRV);
-	shadowPass.Output(shadowMapTag, OutputBind::RTV, LoadType::Preserve);
-	shadowPass.Bind([this, cameraBuffer, weatherTag, baseShapeNoiseTag, shadowMapTag, solarZenithAngle](CommandList& list, RenderPassResources& resources)
+	// Shared by both reconstruction entry points.
+	struct ReconstructionBindData
 	{
-		const auto orthographicScale = *CvarGet("cloudShadowMapResolution", int) * *CvarGet("cloudShadowMapScale", float);
-		auto shadowMapLayout = RenderPipelineLayout{}
-			.VertexShader({ "Clouds/Clouds", "VSMain" })
-			.PixelShader({ "Clouds/Clouds", "PSMain" })
-			.BlendMode(false, BlendMode{})
-			.DepthEnabled(false)
-			.Macro({ "CLOUDS_LOW_DETAIL" })
-			.Macro({ "CLOUDS_FULL_RESOLUTION" })
-			.Macro({ "CLOUDS_ONLY_DEPTH" })
-			.Macro({ "CLOUDS_RENDER_ORTHOGRAPHIC" })
-			.Macro({ "CLOUDS_CAMERA_IN_KILOMETERS" })
-			.Macro({ "CLOUDS_ORTHOGRAPHIC_SCALE", orthographicScale });  // Scale is in kilometers.
-
-		if (*CvarGet("cloudRayMarchQuality", int) > 0)
-		{
-			shadowMapLayout.Macro({ "CLOUDS_MARCH_GROUND_TRUTH_DETAIL" });
-		}
-
-		list.BindPipeline(shadowMapLayout);
+		uint32_t cameraBuffer;
+		uint32_t cameraIndex;
+		uint32_t traceTexture;
+		uint32_t traceDepthTexture;
+		uint32_t historyTexture;
+		uint32_t historyDepthTexture;
+		uint32_t outputTexture;
+		uint32_t outputDepthTexture;
+		XMUINT2 updateOffset;
+		uint32_t updateBlock;
+		uint32_t historyValid;
+		uint32_t geometryDepthTexture;
+		uint32_t resolutionScale;
+	};
 
-		struct {
-			uint32_t weatherTexture;
-			uint32_t baseShapeNoiseTexture;
-			uint32_t detailShapeNoiseTexture;
-			uint32_t cameraBuffer;
-			uint32_t cameraIndex;
-			float solarZenithAngle;
-			uint32_t timeSlice;
-			uint32_t lastFrameTexture;
-			XMFLOAT2 outputResolution;
-			uint32_t depthTexture;
-			uint32_t geometryDepthTexture;
-			uint32_t blueNoiseTexture;
-			uint32_t atmosphereIrradianceBuffer;
-			XMFLOAT2 wind;
-			float time;
-		} bindData;
+	auto& reconstructPass = graph.AddPass("Clouds Reconstruction Pass", ExecutionQueue::Compute);
+	reconstructPass.Read(cameraBuffer, ResourceBind::SRV);
+	reconstructPass.Read(traceOutput, ResourceBind::SRV);
+	reconstructPass.Read(traceDepth, ResourceBind::SRV);
+	reconstructPass.Read(previousHistoryTag, ResourceBind::SRV);
+	reconstructPass.Read(previousHistoryDepthTag, ResourceBind::SRV);
+	reconstructPass.Write(historyTag, TextureView{}.UAV("", 0));
+	reconstructPass.Write(historyDepthTag, TextureView{}.UAV("", 0));
+	reconstructPass.Bind([this, cameraBuffer, traceOutput, traceDepth, previousHistoryTag, previousHistoryDepthTag, historyTag, historyDepthTag,
+		updateOffset, updateBlock, valid=historyValid, size=historySize](CommandList& list, RenderPassResources& resources)
+	{
+		list.BindPipeline(reconstructLayout);
 
-		bindData.weatherTexture = resources.Get(weatherTag);
-		bindData.baseShapeNoiseTexture = resources.Get(baseShapeNoiseTag);
+		ReconstructionBindData bindData{};
 		bindData.cameraBuffer = resources.Get(cameraBuffer);
-		bindData.cameraIndex = 2;  // #TODO: This is awful.
-		bindData.solarZenithAngle = solarZenithAngle;
-		bindData.wind = { windDirection.x * windStrength, windDirection.y * windStrength };
-		bindData.time = Renderer::Get().GetAppTime();
+		bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
+		bindData.traceTexture = resources.Get(traceOutput);
+		bindData.traceDepthTexture = resources.Get(traceDepth);
+		bindData.historyTexture = resources.Get(previousHistoryTag);
+		bindData.historyDepthTexture = resources.Get(previousHistoryDepthTag);
+		bindData.outputTexture = resources.Get(historyTag);
+		bindData.outputDepthTexture = resources.Get(historyDepthTag);
+		bindData.updateOffset = updateOffset;
+		bindData.updateBlock = updateBlock;
+		bindData.historyValid = valid;
 
 		list.BindConstants("bindData", bindData);
-		list.DrawFullscreenQuad();
+
+		auto dispatchX = std::ceil((float)size.x / 8);
+		auto dispatchY = std::ceil((float)size.y / 8);
+
+		list.Dispatch((uint32_t)dispatchX, (uint32_t)dispatchY, 1);
 	});
 
-	lastFrameClouds = cloudOutput;
+	// Without any scaling the history is already at render resolution.
+	auto cloudOutput = historyTag;
+	auto cloudDepth = historyDepthTag;
+
+	if (resolutionScale > 1)
+	{
+		auto& upsamplePass = graph.AddPass("Clouds Upsample Pass", ExecutionQueue::Compute);
+		cloudOutput = upsamplePass.Create(TransientTextureDescription{
+			.width = 0,
+			.height = 0,
+			.depth = 1,
+			.resolutionScale = 1.f,
+			.format = DXGI_FORMAT_R16G16B16A16_FLOAT
+		}, VGText("Clouds scattering transmittance"));
+		cloudDepth = upsamplePass.Create(TransientTextureDescription{
+			.width = 0,
+			.height = 0,
+			.depth = 1,
+			.resolutionScale = 1.f,
+			.format = DXGI_FORMAT_R32_FLOAT
+		}, VGText("Clouds depth"));
+		upsamplePass.Read(cameraBuffer, ResourceBind::SRV);
+		upsamplePass.Read(historyTag, ResourceBind::SRV);
+		upsamplePass.Read(historyDepthTag, ResourceBind::SRV);
+		upsamplePass.Read(depthStencil, ResourceBind::SRV);
+		upsamplePass.Write(cloudOutput, TextureView{}.UAV("", 0));
+		upsamplePass.Write(cloudDepth, TextureView{}.UAV("", 0));
+		upsamplePass.Bind([this, cameraBuffer, historyTag, historyDepthTag, depthStencil, cloudOutput, cloudDepth,
+			resolutionScale](CommandList& list, RenderPassResources& resources)
+		{
+			list.BindPipeline(upsampleLayout);
+
+			ReconstructionBindData bindData{};
+			bindData.cameraBuffer = resources.Get(cameraBuffer);
+			bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
+			bindData.historyTexture = resources.Get(historyTag);
+			bindData.historyDepthTexture = resources.Get(historyDepthTag);
+			bindData.outputTexture = resources.Get(cloudOutput);
+			bindData.outputDepthTexture = resources.Get(cloudDepth);
+			bindData.geometryDepthTexture = resources.Get(depthStencil);
+			bindData.resolutionScale = resolutionScale;
+
+			list.BindConstants("bindData", bindData);
+
+			auto dispatchX = std::ceil((float)device->renderWidth / 8);
+			auto dispatchY = std::ceil((float)device->renderHeight / 8);
+
+			list.Dispatch((uint32_t)dispatchX, (uint32_t)dispatchY, 1);
+		});
+	}
+
+	historyIndex ^= 1;
+	historyValid = true;
+
+	// The shadow map persists between updates, see ScheduleUpdates.
+	if (shadowMap.handle == entt::null || shadowMapSize != (uint32_t)shadowMapResolution)
+	{
+		if (shadowMap.handle != entt::null)
+		{
+			device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), shadowMap);
+		}
+
+		TextureDescription shadowMapDesc{
+			.bindFlags = BindFlag::ShaderResource | BindFlag::RenderTarget,
+			.accessFlags = AccessFlag::GPUWrite,
+			.width = (uint32_t)shadowMapResolution,
+			.height = (uint32_t)shadowMapResolution,
+			.depth = 1,
+			.format = DXGI_FORMAT_R16_FLOAT
+		};
+		shadowMap = device->GetResourceManager().Create(shadowMapDesc, VGText("Clouds shadow map"));
+		shadowMapSize = (uint32_t)shadowMapResolution;
+	}
+
+	const auto shadowMapTag = graph.Import(shadowMap);
+
+	if (updateShadowMap)
+	{
+		auto& shadowPass = graph.AddPass("Clouds Shadow Map Pass", ExecutionQueue::Graphics);
+		shadowPass.Read(cameraBuffer, ResourceBind::SRV);
+		shadowPass.Read(weatherTag, ResourceBind::SRV);
+		shadowPass.Read(baseShapeNoiseTag, ResourceBind::SRV);
+		shadowPass.Output(shadowMapTag, OutputBind::RTV, LoadType::Preserve);
+		shadowPass.Bind([this, cameraBuffer, weatherTag, baseShapeNoiseTag, shadowMapTag, zenithAngle=shadowMapZenithAngle](CommandList& list, RenderPassResources& resources)
+		{
+			const auto orthographicScale = *CvarGet("cloudShadowMapResolution", int) * *CvarGet("cloudShadowMapScale", float);
+			auto shadowMapLayout = RenderPipelineLayout{}
+				.VertexShader({ "Clouds/Clouds", "VSMain" })
+				.PixelShader({ "Clouds/Clouds", "PSMain" })
+				.BlendMode(false, BlendMode{})
+				.DepthEnabled(false)
+				.Macro({ "CLOUDS_LOW_DETAIL" })
+				.Macro({ "CLOUDS_FULL_RESOLUTION" })
+				.Macro({ "CLOUDS_ONLY_DEPTH" })
+				.Macro({ "CLOUDS_RENDER_ORTHOGRAPHIC" })
+				.Macro({ "CLOUDS_CAMERA_IN_KILOMETERS" })
+				.Macro({ "CLOUDS_ORTHOGRAPHIC_SCALE", orthographicScale });  // Scale is in kilometers.
+
+			if (*CvarGet("cloudRayMarchQuality", int) > 0)
+			{
+				shadowMapLayout.Macro({ "CLOUDS_MARCH_GROUND_TRUTH_DETAIL" });
+			}
+
+			list.BindPipeline(shadowMapLayout);
+
+			struct {
+				uint32_t weatherTexture;
+				uint32_t baseShapeNoiseTexture;
+				uint32_t detailShapeNoiseTexture;
+				uint32_t cameraBuffer;
+				uint32_t cameraIndex;
+				float solarZenithAngle;
+				XMUINT2 updateOffset;
+				XMFLOAT2 outputResolution;
+				uint32_t depthTexture;
+				uint32_t geometryDepthTexture;
+				uint32_t blueNoiseTexture;
+				uint32_t atmosphereIrradianceBuffer;
+				XMFLOAT2 wind;
+				float time;
+				uint32_t updateBlock;
+			} bindData;
+
+			bindData.weatherTexture = resources.Get(weatherTag);
+			bindData.baseShapeNoiseTexture = resources.Get(baseShapeNoiseTag);
+			bindData.cameraBuffer = resources.Get(cameraBuffer);
+			bindData.cameraIndex = Renderer::Get().views.Find(RenderViewType::Shadow)->cameraIndex;
+			bindData.solarZenithAngle = zenithAngle;
+			bindData.wind = { windDirection.x * windStrength, windDirection.y * windStrength };
+			bindData.time = Renderer::Get().GetAppTime();
+
+			list.BindConstants("bindData", bindData);
+			list.DrawFullscreenQuad();
+		});
+	}
 
 	return { cloudOutput, cloudDepth, shadowMapTag, weatherTag };
 }
\ No newline at end of file
@@ -11,6 +11,15 @@ class RenderGraph;
 class CommandList;
 class Atmosphere;
 
+// Cached cloud resources are only regenerated when needed, these count the frames they were reused.
+struct CloudUpdateStats
+{
+	uint32_t weatherFramesSkipped = 0;  // Since the weather was last generated.
+	uint32_t shadowMapFramesSkipped = 0;  // Since the shadow map was last rendered.
+	uint64_t weatherSkips = 0;  // Total.
+	uint64_t shadowMapSkips = 0;  // Total.
+};
+
 struct CloudResources
 {
 	RenderResource cloudsScatteringTransmittance;
@@ -27,6 +36,8 @@ public:
 	float windStrength = 0.2f;
 	XMFLOAT2 windDirection = { 1, 0 };
 
+	CloudUpdateStats updateStats;
+
 private:
 	RenderDevice* device;
 
@@ -38,6 +49,8 @@ private:
 	RenderPipelineLayout weatherLayout;
 	RenderPipelineLayout baseNoiseLayout;
 	RenderPipelineLayout detailNoiseLayout;
+	RenderPipelineLayout reconstructLayout;
+	RenderPipelineLayout upsampleLayout;
 
 	TextureHandle weather;  // 2D, channels: coverage, type, precipitation.
 	// Schneider separates density noise into FBM components and composes them while
@@ -47,8 +60,31 @@ private:
 	TextureHandle detailShapeNoise;  // 3D, single channel.
 
 	TextureHandle shadowMap;
+	uint32_t shadowMapSize = 0;
+
+	// Parameters the weather and shadow map were last generated with.
+	bool weatherValid = false;
+	float weatherCoverage = 0.f;
+	float weatherPrecipitation = 0.f;
+	bool updateWeather = true;
+
+	bool shadowMapValid = false;
+	float shadowMapZenithAngle = 0.f;
+	int shadowMapResolution = 0;
+	float shadowMapScale = 0.f;
+	int shadowMapQuality = 0;
+	bool updateShadowMap = true;
+
+	// Clouds are traced at reduced resolution, one pixel of each update block per frame, and accumulated into a history that
+	// alternates between frames. See CloudReconstruction.h.
+	TextureHandle history[2];
+	TextureHandle historyDepth[2];
+	XMUINT2 historySize = { 0, 0 };
+	uint32_t historyIndex = 0;  // History written this frame.
+	bool historyValid = false;
+	uint32_t frame = 0;
 
-	RenderResource lastFrameClouds;
+	void CreateHistory(const XMUINT2& size);
 
 	void GenerateWeather(CommandList& list, uint32_t weatherTexture);
 	void GenerateNoise(CommandList& list, uint32_t baseShapeTexture, uint32_t detailShapeTexture);
@@ -57,5 +93,8 @@ public:
 	~Clouds();
 
 	void Initialize(RenderDevice* inDevice);
+	// Decides which of the weather and shadow map are regenerated this frame, must be called before the views are built. Returns
+	// the solar zenith angle to build the sun camera with, which is the angle the shadow map was rendered at.
+	float ScheduleUpdates(float solarZenithAngle);
 	CloudResources Render(RenderGraph& graph, entt::registry& registry, const Atmosphere& atmosphere, const RenderResource cameraBuffer, const RenderResource depthStencil, const RenderResource atmosphereIrradiance);
 };
\ No newline at end of file
@@ -0,0 +1,768 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/ClusterReference.h>
+#include <Rendering/RenderComponents.h>
+#include <Rendering/RenderView.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace ClusterReference
+{
+	namespace
+	{
+		constexpr size_t partitionsPerThread = 4;  // Froxels near the camera bin far more lights, smaller partitions balance better.
+		constexpr float rangeTolerance = 1e-3f;  // Relative widening of the cluster ranges in light list estimates.
+
+		// Point on the far plane behind a screen position, matches UvToClipSpace and ClipToViewSpace in Camera.hlsli.
+		XMVECTOR UvToViewSpace(const Camera& camera, float u, float v)
+		{
+			const auto clipSpace = XMVectorSet(u * 2.f - 1.f, (1.f - v) * 2.f - 1.f, 0.f, 1.f);
+			const auto viewSpace = XMVector4Transform(clipSpace, camera.inverseProjection);
+
+			return XMVectorDivide(viewSpace, XMVectorSplatW(viewSpace));
+		}
+
+		// Intersection of the ray from the view origin through the point with a plane of constant depth, matches LinePlaneIntersection.
+		XMVECTOR IntersectDepthPlane(FXMVECTOR point, float depth)
+		{
+			const auto t = depth / XMVectorGetZ(point);
+			if (t >= 0.f && t <= 1.f)
+			{
+				return XMVectorScale(point, t);
+			}
+
+			return XMVectorZero();
+		}
+	}
+
+	bool SphereBoxIntersection(const XMFLOAT3& center, float radius, const FroxelBounds& box)
+	{
+		const auto x = std::max(box.min.x - center.x, 0.f) + std::max(center.x - box.max.x, 0.f);
+		const auto y = std::max(box.min.y - center.y, 0.f) + std::max(center.y - box.max.y, 0.f);
+		const auto z = std::max(box.min.z - center.z, 0.f) + std::max(center.z - box.max.z, 0.f);
+
+		return x * x + y * y + z * z <= radius * radius;
+	}
+
+	Camera CreateTestCamera(const XMMATRIX& view, float fieldOfView, float aspectRatio, float nearPlane, float farPlane)
+	{
+		const auto projection = XMMatrixPerspectiveFovRH(fieldOfView / 2.f, aspectRatio, farPlane, nearPlane);
+
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMMatrixInverse(nullptr, view).r[3]);
+
+		return RenderViewSet::CreateCamera(position, view, projection, view, projection, nearPlane, farPlane, fieldOfView, aspectRatio);
+	}
+
+	std::vector<Light> CreateTestLights(const Camera& camera, size_t count, float maxDepth, LightDistribution distribution)
+	{
+		constexpr size_t hotspotCount = 16;
+
+		const auto RandomViewPoint = [&]()
+		{
+			const auto direction = UvToViewSpace(camera, (float)Rand(0.0, 1.0), (float)Rand(0.0, 1.0));
+			const auto depth = (float)Rand((double)camera.nearPlane, (double)maxDepth);
+
+			return XMVectorScale(direction, -depth / XMVectorGetZ(direction));
+		};
+
+		std::vector<XMVECTOR> hotspots;
+		for (size_t i = 0; i < hotspotCount; ++i)
+		{
+			hotspots.emplace_back(RandomViewPoint());
+		}
+
+		const auto spread = maxDepth * 0.02f;
+
+		std::vector<Light> lights(count);
+		for (auto& light : lights)
+		{
+			auto position = RandomViewPoint();
+			if (distribution == LightDistribution::Clustered)
+			{
+				const auto offset = XMVectorSet((float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), 0.f);
+				position = XMVectorMultiplyAdd(offset, XMVectorReplicate(spread), hotspots[Rand(0, (int)hotspotCount - 1)]);
+			}
+
+			XMStoreFloat3(&light.position, XMVector3Transform(position, camera.inverseView));
+			light.type = static_cast<uint32_t>(LightType::Point);
+			light.color = { 1.f, 1.f, 1.f };
+			light.luminance = 1.f;
+			light.direction = { 0.f, 0.f, -1.f };
+			light.padding = 0.f;
+		}
+
+		return lights;
+	}
+
+	uint32_t ClusterIndex(const ClusterGridInfo& gridInfo, uint32_t froxelSize, const Camera& camera, float screenX, float screenY, float viewDepth)
+	{
+		const auto logY = 1.f / std::log(gridInfo.depthFactor);
+
+		// Clamped to the grid, the GPU indexes past the last slice for depths between it and the far plane.
+		const auto x = std::min(static_cast<uint32_t>(std::max(screenX, 0.f) / froxelSize), gridInfo.x - 1);
+		const auto y = std::min(static_cast<uint32_t>(std::max(screenY, 0.f) / froxelSize), gridInfo.y - 1);
+		const auto z = std::min(static_cast<uint32_t>(std::max(std::log(-viewDepth / camera.nearPlane) * logY, 0.f)), gridInfo.z - 1);
+
+		return x + gridInfo.x * (y + gridInfo.y * z);
+	}
+
+	void ComputeBounds(const ClusterGridInfo& gridInfo, uint32_t width, uint32_t height, uint32_t froxelSize, const Camera& camera, std::vector<FroxelBounds>& bounds)
+	{
+		VGScopedCPUStat("Cluster Reference Bounds");
+
+		bounds.resize(gridInfo.x * gridInfo.y * gridInfo.z);
+
+		std::vector<uint32_t> slices(gridInfo.z);
+		std::iota(slices.begin(), slices.end(), 0);
+
+		std::for_each(std::execution::par, slices.begin(), slices.end(), [&](auto slice)
+		{
+			const auto nearDepth = -camera.nearPlane * std::pow(std::abs(gridInfo.depthFactor), (float)slice);
+			const auto farDepth = -camera.nearPlane * std::pow(std::abs(gridInfo.depthFactor), (float)(slice + 1));
+
+			for (uint32_t y = 0; y < gridInfo.y; ++y)
+			{
+				for (uint32_t x = 0; x < gridInfo.x; ++x)
+				{
+					const auto topLeft = UvToViewSpace(camera, x * froxelSize / (float)width, y * froxelSize / (float)height);
+					const auto bottomRight = UvToViewSpace(camera, (x + 1) * froxelSize / (float)width, (y + 1) * froxelSize / (float)height);
+
+					const auto minNear = IntersectDepthPlane(topLeft, nearDepth);
+					const auto maxNear = IntersectDepthPlane(bottomRight, nearDepth);
+					const auto minFar = IntersectDepthPlane(topLeft, farDepth);
+					const auto maxFar = IntersectDepthPlane(bottomRight, farDepth);
+
+					const auto minBound = XMVectorMin(minNear, XMVectorMin(maxNear, XMVectorMin(minFar, maxFar)));
+					const auto maxBound = XMVectorMax(minNear, XMVectorMax(maxNear, XMVectorMax(minFar, maxFar)));
+
+					auto& box = bounds[x + gridInfo.x * (y + gridInfo.y * slice)];
+					XMStoreFloat4(&box.min, XMVectorSetW(minBound, 1.f));
+					XMStoreFloat4(&box.max, XMVectorSetW(maxBound, 1.f));
+				}
+			}
+		});
+	}
+
+	void BinLights(const ClusterGridInfo& gridInfo, std::span<const FroxelBounds> bounds, std::span<const uint32_t> denseClusters, const Camera& camera,
+		std::span<const Light> lights, uint32_t maxLightsPerFroxel, BinningOutput& output, float lightRadius)
+	{
+		VGScopedCPUStat("Cluster Reference Binning");
+
+		output.lightInfo.assign(gridInfo.x * gridInfo.y * gridInfo.z, XMUINT2{ 0, 0 });
+		output.lightList.clear();
+		output.lightCounter = 0;
+		output.overflowingClusters = 0;
+		output.maxClusterLights = 0;
+
+		if (denseClusters.empty())
+		{
+			return;
+		}
+
+		// View space light spheres in structure of arrays form, padded to whole vectors. Directional lights reach every
+		// froxel, unknown types and padding lanes have a negative squared radius so that they never pass.
+		const auto paddedCount = (lights.size() + 3) & ~size_t{ 3 };
+		std::vector<XMFLOAT4> viewPositions(lights.size());
+		if (lights.size() > 0)
+		{
+			XMVector3TransformStream(viewPositions.data(), sizeof(XMFLOAT4), &lights[0].position, sizeof(Light), lights.size(), camera.view);
+		}
+
+		std::vector<float> lightX(paddedCount, 0.f);
+		std::vector<float> lightY(paddedCount, 0.f);
+		std::vector<float> lightZ(paddedCount, 0.f);
+		std::vector<float> radiusSquared(paddedCount, -1.f);
+		for (size_t i = 0; i < lights.size(); ++i)
+		{
+			lightX[i] = viewPositions[i].x;
+			lightY[i] = viewPositions[i].y;
+			lightZ[i] = viewPositions[i].z;
+
+			switch (static_cast<LightType>(lights[i].type))
+			{
+			case LightType::Point: radiusSquared[i] = lightRadius * lightRadius; break;
+			case LightType::Directional: radiusSquared[i] = std::numeric_limits<float>::max(); break;
+			}
+		}
+
+		struct Partition
+		{
+			std::vector<uint32_t> lights;
+			uint32_t overflowingClusters = 0;
+			uint32_t maxClusterLights = 0;
+		};
+
+		const auto partitionCount = std::min(std::max<size_t>(std::thread::hardware_concurrency(), 1) * partitionsPerThread, denseClusters.size());
+		std::vector<Partition> partitions(partitionCount);
+		std::vector<size_t> partitionIndices(partitionCount);
+		std::iota(partitionIndices.begin(), partitionIndices.end(), 0);
+		std::vector<uint32_t> counts(denseClusters.size());
+
+		const auto PartitionBegin = [&](size_t partition) { return denseClusters.size() * partition / partitionCount; };
+
+		std::for_each(std::execution::par, partitionIndices.begin(), partitionIndices.end(), [&](auto index)
+		{
+			auto& partition = partitions[index];
+
+			for (size_t cluster = PartitionBegin(index); cluster < PartitionBegin(index + 1); ++cluster)
+			{
+				const auto& box = bounds[denseClusters[cluster]];
+				const auto minX = XMVectorReplicate(box.min.x);
+				const auto minY = XMVectorReplicate(box.min.y);
+				const auto minZ = XMVectorReplicate(box.min.z);
+				const auto maxX = XMVectorReplicate(box.max.x);
+				const auto maxY = XMVectorReplicate(box.max.y);
+				const auto maxZ = XMVectorReplicate(box.max.z);
+				const auto zero = XMVectorZero();
+
+				uint32_t count = 0;
+
+				// Four lights per iteration, matches SphereAABBIntersection in Geometry.hlsli.
+				for (size_t i = 0; i < paddedCount; i += 4)
+				{
+					const auto x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&lightX[i]));
+					const auto y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&lightY[i]));
+					const auto z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&lightZ[i]));
+
+					const auto distanceX = XMVectorAdd(XMVectorMax(XMVectorSubtract(minX, x), zero), XMVectorMax(XMVectorSubtract(x, maxX), zero));
+					const auto distanceY = XMVectorAdd(XMVectorMax(XMVectorSubtract(minY, y), zero), XMVectorMax(XMVectorSubtract(y, maxY), zero));
+					const auto distanceZ = XMVectorAdd(XMVectorMax(XMVectorSubtract(minZ, z), zero), XMVectorMax(XMVectorSubtract(z, maxZ), zero));
+					const auto distanceSquared = XMVectorAdd(XMVectorAdd(XMVectorMultiply(distanceX, distanceX), XMVectorMultiply(distanceY, distanceY)), XMVectorMultiply(distanceZ, distanceZ));
+
+					const auto inside = XMVectorLessOrEqual(distanceSquared, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&radiusSquared[i])));
+					if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+					{
+						continue;
+					}
+
+					alignas(16) uint32_t lanes[4];
+					XMStoreInt4A(lanes, inside);
+
+					for (uint32_t lane = 0; lane < 4; ++lane)
+					{
+						if (lanes[lane])
+						{
+							if (count < maxLightsPerFroxel)
+							{
+								partition.lights.emplace_back(static_cast<uint32_t>(i + lane));
+							}
+
+							++count;
+						}
+					}
+				}
+
+				counts[cluster] = std::min(count, maxLightsPerFroxel);
+				partition.overflowingClusters += count > maxLightsPerFroxel ? 1 : 0;
+				partition.maxClusterLights = std::max(partition.maxClusterLights, count);
+			}
+		});
+
+		// Bins are packed in dense list order, so each partition's lights are one contiguous range of the light list.
+		std::vector<uint32_t> offsets(denseClusters.size());
+		std::exclusive_scan(counts.begin(), counts.end(), offsets.begin(), 0u);
+
+		for (size_t cluster = 0; cluster < denseClusters.size(); ++cluster)
+		{
+			output.lightInfo[denseClusters[cluster]] = XMUINT2{ offsets[cluster], counts[cluster] };
+		}
+
+		output.lightCounter = offsets.back() + counts.back();
+		output.lightList.resize(output.lightCounter);
+
+		std::for_each(std::execution::par, partitionIndices.begin(), partitionIndices.end(), [&](auto index)
+		{
+			const auto& partitionLights = partitions[index].lights;
+			std::copy(partitionLights.begin(), partitionLights.end(), output.lightList.begin() + offsets[PartitionBegin(index)]);
+		});
+
+		for (const auto& partition : partitions)
+		{
+			output.overflowingClusters += partition.overflowingClusters;
+			output.maxClusterLights = std::max(output.maxClusterLights, partition.maxClusterLights);
+		}
+	}
+
+	uint64_t EstimateLightListSize(const ClusterGridInfo& gridInfo, uint32_t width, uint32_t height, uint32_t froxelSize, const Camera& camera,
+		std::span<const Light> lights, float lightRadius)
+	{
+		VGScopedCPUStat("Estimate Light List Size");
+
+		const uint64_t clusterCount = gridInfo.x * gridInfo.y * gridInfo.z;
+		if (clusterCount == 0)
+		{
+			return 0;
+		}
+
+		const auto lastSliceDepth = camera.nearPlane * std::pow(gridInfo.depthFactor, (float)gridInfo.z);
+		const auto logY = 1.f / std::log(gridInfo.depthFactor);
+
+		// View space x and y scale to clip space by these, before the division by depth.
+		const auto scaleX = XMVectorGetX(camera.projection.r[0]);
+		const auto scaleY = XMVectorGetY(camera.projection.r[1]);
+
+		// Froxel bounds span the ray intersections at both depths of their slice, so they reach past the froxel's own columns
+		// and rows. The box edge facing away from the view axis is at the far depth, the edge facing it is at the near depth.
+		const auto TileRange = [&](float boxMin, float boxMax, float scale, float nearDepth, float farDepth, float tileSize, uint32_t tiles, bool flip)
+		{
+			// Clip space limits of the froxel edges for the froxel bounds to still reach the box.
+			const auto maxLowerEdge = boxMax * scale / (boxMax >= 0.f ? nearDepth : farDepth);
+			const auto minUpperEdge = boxMin * scale / (boxMin >= 0.f ? farDepth : nearDepth);
+
+			// Rows count downwards from the top of the screen, columns rightwards. Widened slightly to absorb rounding.
+			const auto first = std::max(std::ceil((flip ? 1.f - maxLowerEdge : minUpperEdge + 1.f) / tileSize - 1.f - rangeTolerance), 0.f);
+			const auto last = std::min(std::floor((flip ? 1.f - minUpperEdge : maxLowerEdge + 1.f) / tileSize + rangeTolerance), (float)tiles - 1.f);
+
+			return last >= first ? static_cast<uint64_t>(last - first) + 1 : uint64_t{ 0 };
+		};
+
+		// Froxel sizes in clip space.
+		const auto tileWidth = 2.f * froxelSize / width;
+		const auto tileHeight = 2.f * froxelSize / height;
+
+		const auto Slice = [&](float depth)
+		{
+			return static_cast<int64_t>(std::floor(std::log(std::max(depth, camera.nearPlane) / camera.nearPlane) * logY));
+		};
+
+		uint64_t total = 0;
+		for (const auto& light : lights)
+		{
+			if (light.type == static_cast<uint32_t>(LightType::Directional))
+			{
+				total += clusterCount;
+				continue;
+			}
+
+			if (light.type != static_cast<uint32_t>(LightType::Point))
+			{
+				continue;
+			}
+
+			XMFLOAT3 center;
+			XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&light.position), camera.view));
+
+			const auto nearest = -center.z - lightRadius;
+			const auto farthest = -center.z + lightRadius;
+			if (farthest < camera.nearPlane || nearest > lastSliceDepth)
+			{
+				continue;
+			}
+
+			const auto firstSlice = std::max<int64_t>(Slice(nearest * (1.f - rangeTolerance)), 0);
+			const auto lastSlice = std::min<int64_t>(Slice(farthest * (1.f + rangeTolerance)), gridInfo.z - 1);
+
+			for (auto slice = firstSlice; slice <= lastSlice; ++slice)
+			{
+				const auto nearDepth = camera.nearPlane * std::pow(gridInfo.depthFactor, (float)slice);
+				const auto farDepth = nearDepth * gridInfo.depthFactor;
+
+				const auto columns = TileRange(center.x - lightRadius, center.x + lightRadius, scaleX, nearDepth, farDepth, tileWidth, gridInfo.x, false);
+				const auto rows = TileRange(center.y - lightRadius, center.y + lightRadius, scaleY, nearDepth, farDepth, tileHeight, gridInfo.y, true);
+				total += columns * rows;
+			}
+		}
+
+		return std::min(total, clusterCount * lights.size());
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Cluster Reference Test");
+
+		Seed({ 2468 });
+
+		TestReport report{ logRendering, VGText("Cluster reference") };
+
+		struct Config
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t froxelSize;
+			float fieldOfView;
+			float nearPlane;
+			float farPlane;
+		};
+
+		const auto view = XMMatrixLookAtRH(XMVectorSet(10.f, 5.f, -20.f, 1.f), XMVectorSet(0.f, 0.f, 0.f, 1.f), XMVectorSet(0.f, 1.f, 0.f, 0.f));
+
+		// Grid math and bounds, on common resolutions and an odd one that leaves partial froxels.
+		const Config configs[] = {
+			{ 1920, 1080, 64, XM_PIDIV2, 0.1f, 10000.f },
+			{ 3840, 2160, 64, XM_PIDIV2, 0.1f, 10000.f },
+			{ 1280, 720, 32, 1.2f, 0.5f, 500.f },
+			{ 1000, 613, 48, 2.f, 0.1f, 100.f }
+		};
+
+		for (const auto& config : configs)
+		{
+			const auto camera = CreateTestCamera(view, config.fieldOfView, config.width / (float)config.height, config.nearPlane, config.farPlane);
+			const auto grid = ClusteredLightCulling::ComputeGridInfo(config.width, config.height, camera, config.froxelSize);
+
+			report.Check(grid.x * config.froxelSize >= config.width && (grid.x - 1) * config.froxelSize < config.width, "grid: froxel columns don't cover the view");
+			report.Check(grid.y * config.froxelSize >= config.height && (grid.y - 1) * config.froxelSize < config.height, "grid: froxel rows don't cover the view");
+
+			const auto lastSliceDepth = config.nearPlane * std::pow(grid.depthFactor, (float)grid.z);
+			report.Check(grid.z > 0 && lastSliceDepth <= config.farPlane * 1.001f && lastSliceDepth * grid.depthFactor > config.farPlane * 0.999f, "grid: depth slices don't end at the far plane");
+
+			std::vector<FroxelBounds> bounds;
+			ComputeBounds(grid, config.width, config.height, config.froxelSize, camera, bounds);
+			report.Check(bounds.size() == grid.x * grid.y * grid.z, "bounds: box count doesn't match the grid");
+
+			bool ordered = true;
+			for (const auto& box : bounds)
+			{
+				ordered = ordered && box.min.x <= box.max.x && box.min.y <= box.max.y && box.min.z <= box.max.z;
+			}
+
+			report.Check(ordered, "bounds: box minimum exceeds its maximum");
+
+			// Points anywhere in the sliced part of the frustum must be inside the box of the cluster they're shaded with.
+			size_t outside = 0;
+			for (int i = 0; i < 10'000; ++i)
+			{
+				const auto u = (float)Rand(0.0, 1.0);
+				const auto v = (float)Rand(0.0, 1.0);
+				const auto depth = config.nearPlane * std::pow(grid.depthFactor, (float)Rand(0.0, (double)grid.z));
+
+				const auto direction = UvToViewSpace(camera, u, v);
+				XMFLOAT3 point;
+				XMStoreFloat3(&point, XMVectorScale(direction, -depth / XMVectorGetZ(direction)));
+
+				const auto& box = bounds[ClusterIndex(grid, config.froxelSize, camera, u * config.width, v * config.height, point.z)];
+				const auto tolerance = depth * 1e-4f;
+
+				if (point.x < box.min.x - tolerance || point.y < box.min.y - tolerance || point.z < box.min.z - tolerance ||
+					point.x > box.max.x + tolerance || point.y > box.max.y + tolerance || point.z > box.max.z + tolerance)
+				{
+					++outside;
+				}
+			}
+
+			report.Check(outside == 0, "bounds: point outside of the box of its cluster");
+		}
+
+		// Compact light lists are sized from the estimate, it must cover every cluster binning every light it reaches.
+		for (const auto& config : { configs[0], configs[2], configs[3] })
+		{
+			const auto camera = CreateTestCamera(view, config.fieldOfView, config.width / (float)config.height, config.nearPlane, config.farPlane);
+			const auto grid = ClusteredLightCulling::ComputeGridInfo(config.width, config.height, camera, config.froxelSize);
+
+			std::vector<FroxelBounds> bounds;
+			ComputeBounds(grid, config.width, config.height, config.froxelSize, camera, bounds);
+
+			std::vector<uint32_t> denseClusters(bounds.size());
+			std::iota(denseClusters.begin(), denseClusters.end(), 0);
+
+			for (const auto distribution : { LightDistribution::Uniform, LightDistribution::Clustered })
+			{
+				for (const auto lightRadius : { 0.5f, 5.f, pointLightRadius })
+				{
+					auto lights = CreateTestLights(camera, 100, config.farPlane * 0.5f, distribution);
+
+					// Lights behind and around the camera still reach into the view.
+					for (size_t i = 0; i < 10; ++i)
+					{
+						const auto offset = XMVectorSet((float)Rand(-2.0, 2.0), (float)Rand(-2.0, 2.0), (float)Rand(-2.0, 2.0), 0.f);
+						XMStoreFloat3(&lights[i].position, XMVector3Transform(XMVectorScale(offset, lightRadius), camera.inverseView));
+					}
+
+					BinningOutput output;
+					BinLights(grid, bounds, denseClusters, camera, lights, static_cast<uint32_t>(lights.size()), output, lightRadius);
+
+					report.Check(EstimateLightListSize(grid, config.width, config.height, config.froxelSize, camera, lights, lightRadius) >= output.lightCounter, "estimate: light list estimate is below the binned light count");
+				}
+			}
+		}
+
+		{
+			const auto camera = CreateTestCamera(view, XM_PIDIV2, 16.f / 9.f, 0.f, 100.f);
+			const auto grid = ClusteredLightCulling::ComputeGridInfo(1920, 1080, camera, 64);
+			report.Check(grid.x == 0 && grid.y == 0 && grid.z == 0, "grid: camera without a valid projection should have an empty grid");
+		}
+
+		const Config config{ 640, 360, 32, XM_PIDIV2, 0.1f, 1000.f };
+		const auto camera = CreateTestCamera(view, config.fieldOfView, config.width / (float)config.height, config.nearPlane, config.farPlane);
+		const auto grid = ClusteredLightCulling::ComputeGridInfo(config.width, config.height, camera, config.froxelSize);
+		const auto clusterCount = grid.x * grid.y * grid.z;
+
+		std::vector<FroxelBounds> bounds;
+		ComputeBounds(grid, config.width, config.height, config.froxelSize, camera, bounds);
+
+		// Binning of a random subset of clusters, like the depth culled dense list, against a scalar brute force.
+		{
+			constexpr float lightRadius = 5.f;
+
+			auto lights = CreateTestLights(camera, 500, 200.f, LightDistribution::Clustered);
+			for (auto index : { 17, 250 })
+			{
+				lights[index].type = static_cast<uint32_t>(LightType::Directional);
+			}
+
+			std::vector<XMFLOAT3> viewPositions(lights.size());
+			for (size_t i = 0; i < lights.size(); ++i)
+			{
+				XMStoreFloat3(&viewPositions[i], XMVector3Transform(XMLoadFloat3(&lights[i].position), camera.view));
+			}
+
+			std::vector<uint32_t> denseClusters;
+			std::vector<bool> listed(clusterCount, false);
+			for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+			{
+				if (Rand(0, 1) == 1)
+				{
+					denseClusters.emplace_back(cluster);
+					listed[cluster] = true;
+				}
+			}
+
+			for (const auto maxLights : { 256u, 4u })
+			{
+				BinningOutput output;
+				BinLights(grid, bounds, denseClusters, camera, lights, maxLights, output, lightRadius);
+
+				bool matches = true;
+				bool packed = true;
+				uint32_t counter = 0;
+				uint32_t overflowing = 0;
+
+				for (const auto cluster : denseClusters)
+				{
+					std::vector<uint32_t> expected;
+					for (uint32_t i = 0; i < lights.size(); ++i)
+					{
+						if (lights[i].type == static_cast<uint32_t>(LightType::Directional) || SphereBoxIntersection(viewPositions[i], lightRadius, bounds[cluster]))
+						{
+							expected.emplace_back(i);
+						}
+					}
+
+					overflowing += expected.size() > maxLights ? 1 : 0;
+					expected.resize(std::min<size_t>(expected.size(), maxLights));
+
+					const auto info = output.lightInfo[cluster];
+					packed = packed && info.x == counter;
+					matches = matches && info.y == expected.size() && info.x + info.y <= output.lightList.size() &&
+						std::equal(expected.begin(), expected.end(), output.lightList.begin() + info.x);
+					counter += static_cast<uint32_t>(expected.size());
+				}
+
+				bool unlistedEmpty = true;
+				for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+				{
+					unlistedEmpty = unlistedEmpty && (listed[cluster] || (output.lightInfo[cluster].x == 0 && output.lightInfo[cluster].y == 0));
+				}
+
+				report.Check(output.lightInfo.size() == clusterCount, "binning: light info doesn't have an entry per cluster");
+				report.Check(matches, "binning: bins differ from the brute force reference");
+				report.Check(packed && output.lightCounter == counter && output.lightList.size() == counter, "binning: light list isn't packed in dense list order");
+				report.Check(unlistedEmpty, "binning: clusters outside of the dense list have lights");
+				report.Check(output.overflowingClusters == overflowing, "binning: overflowing cluster count is wrong");
+				report.Check(maxLights > 4 || overflowing > 0, "binning: bin capacity was never exceeded, the clamp is untested");
+			}
+		}
+
+		// Every point within a light's radius must be shaded with a cluster that lists the light.
+		{
+			constexpr float lightRadius = 3.f;
+			constexpr uint32_t lightCount = 200;
+
+			const auto lights = CreateTestLights(camera, lightCount, 100.f, LightDistribution::Uniform);
+
+			std::vector<uint32_t> denseClusters(clusterCount);
+			std::iota(denseClusters.begin(), denseClusters.end(), 0);
+
+			BinningOutput output;
+			BinLights(grid, bounds, denseClusters, camera, lights, lightCount, output, lightRadius);
+
+			const auto lastSliceDepth = config.nearPlane * std::pow(grid.depthFactor, (float)grid.z);
+
+			size_t sampled = 0;
+			size_t missing = 0;
+			for (uint32_t i = 0; i < lightCount; ++i)
+			{
+				const auto center = XMVector3Transform(XMLoadFloat3(&lights[i].position), camera.view);
+
+				for (int sample = 0; sample < 50; ++sample)
+				{
+					auto offset = XMVectorSet((float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), 0.f);
+					if (XMVectorGetX(XMVector3LengthSq(offset)) > 1.f)
+					{
+						continue;
+					}
+
+					XMFLOAT3 point;
+					XMStoreFloat3(&point, XMVectorMultiplyAdd(offset, XMVectorReplicate(lightRadius * 0.99f), center));
+					if (-point.z < config.nearPlane || -point.z >= lastSliceDepth)
+					{
+						continue;
+					}
+
+					XMFLOAT3 clip;
+					XMStoreFloat3(&clip, XMVector3TransformCoord(XMLoadFloat3(&point), camera.projection));
+					const auto u = clip.x * 0.5f + 0.5f;
+					const auto v = 0.5f - clip.y * 0.5f;
+					if (u < 0.f || u >= 1.f || v < 0.f || v >= 1.f)
+					{
+						continue;
+					}
+
+					const auto info = output.lightInfo[ClusterIndex(grid, config.froxelSize, camera, u * config.width, v * config.height, point.z)];
+					const auto begin = output.lightList.begin() + info.x;
+					if (std::find(begin, begin + info.y, i) == begin + info.y)
+					{
+						++missing;
+					}
+
+					++sampled;
+				}
+			}
+
+			report.Check(output.overflowingClusters == 0, "coverage: bins overflowed with a capacity of every light");
+			report.Check(EstimateLightListSize(grid, config.width, config.height, config.froxelSize, camera, lights, lightRadius) >= output.lightCounter, "coverage: light list estimate is below the binned light count");
+			report.Check(sampled > 0, "coverage: no sample points landed in the view");
+			report.Check(missing == 0, "coverage: point inside a light's radius is shaded with a cluster that doesn't list it");
+		}
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Cluster Reference Benchmark");
+
+		constexpr int iterations = 3;
+		constexpr uint32_t occupancyCapacity = 4096;  // Large enough that bins keep every light, so occupancy can be measured.
+		constexpr float cameraHeight = 2.f;
+
+		Seed({ 8642 });
+
+		// A level camera above an endless ground plane, the dense cluster list holds every cluster the ground passes through,
+		// standing in for the depth culling pass.
+		const auto view = XMMatrixLookAtRH(XMVectorSet(0.f, cameraHeight, 0.f, 1.f), XMVectorSet(0.f, cameraHeight, -1.f, 1.f), XMVectorSet(0.f, 1.f, 0.f, 0.f));
+
+		const auto GroundClusters = [&](const ClusterGridInfo& grid, uint32_t width, uint32_t height, uint32_t froxelSize, const Camera& camera)
+		{
+			const auto lastSliceDepth = camera.nearPlane * std::pow(grid.depthFactor, (float)grid.z);
+
+			// Depth of the ground behind a row of pixels, the last slice if the row is above the horizon.
+			const auto GroundDepth = [&](float v)
+			{
+				const auto direction = UvToViewSpace(camera, 0.5f, std::min(v, 1.f));
+				const auto slope = XMVectorGetY(direction) / -XMVectorGetZ(direction);
+
+				return slope < 0.f ? std::clamp(cameraHeight / -slope, camera.nearPlane, lastSliceDepth) : lastSliceDepth;
+			};
+
+			std::vector<uint32_t> clusters;
+			for (uint32_t y = 0; y < grid.y; ++y)
+			{
+				const auto pixelY = (float)(y * froxelSize);
+				const auto farthest = GroundDepth(pixelY / height);
+				const auto nearest = GroundDepth((pixelY + froxelSize) / height);
+				if (nearest >= lastSliceDepth)
+				{
+					continue;  // Sky.
+				}
+
+				const auto firstSlice = ClusterIndex(grid, froxelSize, camera, 0.f, pixelY, -nearest) / (grid.x * grid.y);
+				const auto lastSlice = ClusterIndex(grid, froxelSize, camera, 0.f, pixelY, -farthest) / (grid.x * grid.y);
+
+				for (auto slice = firstSlice; slice <= lastSlice; ++slice)
+				{
+					for (uint32_t x = 0; x < grid.x; ++x)
+					{
+						clusters.emplace_back(x + grid.x * (y + grid.y * slice));
+					}
+				}
+			}
+
+			std::sort(clusters.begin(), clusters.end());  // Compaction produces ascending cluster indices.
+
+			return clusters;
+		};
+
+		const std::pair<uint32_t, uint32_t> resolutions[] = { { 1920, 1080 }, { 3840, 2160 } };
+		const std::pair<const char*, LightDistribution> distributions[] = { { "uniform", LightDistribution::Uniform }, { "clustered", LightDistribution::Clustered } };
+		const size_t lightCounts[] = { 1'000, 10'000 };
+		const uint32_t froxelSizes[] = { 32, 64, 128 };
+		const uint32_t binCapacities[] = { 64, 128, 256 };
+
+		const CameraComponent cameraSettings{};  // Defaults of scene cameras.
+
+		for (const auto [width, height] : resolutions)
+		{
+			const auto camera = CreateTestCamera(view, cameraSettings.fieldOfView, width / (float)height, cameraSettings.nearPlane, cameraSettings.farPlane);
+
+			for (const auto& [distributionName, distribution] : distributions)
+			{
+				for (const auto lightCount : lightCounts)
+				{
+					const auto lights = CreateTestLights(camera, lightCount, 1000.f, distribution);
+
+					VGLog(logRendering, "Cluster reference benchmark, {}x{} with {} {} lights:", width, height, lightCount, distributionName);
+
+					for (const auto froxelSize : froxelSizes)
+					{
+						const auto grid = ClusteredLightCulling::ComputeGridInfo(width, height, camera, froxelSize);
+
+						std::vector<FroxelBounds> bounds;
+						const auto boundsBegin = std::chrono::high_resolution_clock::now();
+						ComputeBounds(grid, width, height, froxelSize, camera, bounds);
+						const auto boundsEnd = std::chrono::high_resolution_clock::now();
+
+						const auto denseClusters = GroundClusters(grid, width, height, froxelSize, camera);
+
+						BinningOutput output;
+						double binningTime = 0.0;
+						for (int i = 0; i < iterations; ++i)
+						{
+							const auto begin = std::chrono::high_resolution_clock::now();
+							BinLights(grid, bounds, denseClusters, camera, lights, occupancyCapacity, output);
+							const auto end = std::chrono::high_resolution_clock::now();
+
+							binningTime += std::chrono::duration<double, std::milli>(end - begin).count();
+						}
+
+						constexpr double megabyte = 1024.0 * 1024.0;
+
+						VGLog(logRendering, "  {}px froxels, {}x{}x{} grid, {} clusters binned: bounds {:.3f} ms, binning {:.3f} ms, {:.1f} lights per cluster on average, {} at most.",
+							froxelSize, grid.x, grid.y, grid.z, denseClusters.size(), std::chrono::duration<double, std::milli>(boundsEnd - boundsBegin).count(),
+							binningTime / iterations, (double)output.lightCounter / std::max<size_t>(denseClusters.size(), 1), output.maxClusterLights);
+
+						const auto estimateBegin = std::chrono::high_resolution_clock::now();
+						const auto estimate = EstimateLightListSize(grid, width, height, froxelSize, camera, lights);
+						const auto estimateEnd = std::chrono::high_resolution_clock::now();
+
+						VGLog(logRendering, "    Compact light list: {:.1f} MB estimated in {:.3f} ms, {:.1f} MB used.", estimate * sizeof(uint32_t) / megabyte,
+							std::chrono::duration<double, std::milli>(estimateEnd - estimateBegin).count(), output.lightCounter * sizeof(uint32_t) / megabyte);
+
+						for (const auto capacity : binCapacities)
+						{
+							size_t overflowing = 0;
+							size_t packedLights = 0;
+							for (const auto cluster : denseClusters)
+							{
+								overflowing += output.lightInfo[cluster].y > capacity ? 1 : 0;
+								packedLights += std::min(output.lightInfo[cluster].y, capacity);
+							}
+
+							VGLog(logRendering, "    {} lights per froxel: {} clusters overflow ({:.2f}%), fixed light list {:.1f} MB, packed light list {:.1f} MB.", capacity, overflowing,
+								100.0 * overflowing / std::max<size_t>(denseClusters.size(), 1), (double)grid.x * grid.y * grid.z * capacity * sizeof(uint32_t) / megabyte,
+								packedLights * sizeof(uint32_t) / megabyte);
+						}
+					}
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+#include <Rendering/ClusteredLightCulling.h>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// CPU implementation of the clustered light culling compute passes, froxel bounds and light binning. Produces the same
+// layout as the GPU, so that it can validate the grid math, compare against readbacks, and tune the froxel size and bin
+// capacity without a device.
+namespace ClusterReference
+{
+	constexpr float pointLightRadius = 150.f;  // Must match ComputeLightRadius in Light.hlsli.
+
+	// View space box of a froxel, matches the AABB layout of the cluster bounds buffer.
+	struct FroxelBounds
+	{
+		XMFLOAT4 min;
+		XMFLOAT4 max;
+	};
+
+	struct BinningOutput
+	{
+		std::vector<uint32_t> lightList;  // Light indices of every binned froxel, only the entries below the light counter.
+		std::vector<XMUINT2> lightInfo;  // Offset into the light list and light count, per cluster. Zero for clusters that weren't binned.
+		uint32_t lightCounter = 0;  // Final value of the global light counter.
+		uint32_t overflowingClusters = 0;  // Clusters with more lights than the bin capacity, the excess lights are dropped.
+		uint32_t maxClusterLights = 0;  // Largest light count of a cluster before clamping to the bin capacity.
+	};
+
+	// Index of the cluster containing a screen space position and view space depth, matches DrawToClusterId in Clusters.hlsli.
+	uint32_t ClusterIndex(const ClusterGridInfo& gridInfo, uint32_t froxelSize, const Camera& camera, float screenX, float screenY, float viewDepth);
+
+	// Equivalent of ClusterBounds.hlsl, one box per cluster of the grid.
+	void ComputeBounds(const ClusterGridInfo& gridInfo, uint32_t width, uint32_t height, uint32_t froxelSize, const Camera& camera, std::vector<FroxelBounds>& bounds);
+
+	// Equivalent of ClusterLightBinning.hlsl, bins the lights of each cluster in the dense cluster list. Offsets are packed in the
+	// order of the dense list, and lights within a bin are in ascending order. The GPU packs in the order bins finish and keeps
+	// whichever lights arrive first in overflowing bins, so readbacks match after sorting each bin.
+	void BinLights(const ClusterGridInfo& gridInfo, std::span<const FroxelBounds> bounds, std::span<const uint32_t> denseClusters, const Camera& camera,
+		std::span<const Light> lights, uint32_t maxLightsPerFroxel, BinningOutput& output, float lightRadius = pointLightRadius);
+
+	// Upper bound of the packed light list size, for sizing compact light lists before the GPU has binned anything. Counts the
+	// clusters whose bounds each light's view space box overlaps, ignoring depth culling.
+	uint64_t EstimateLightListSize(const ClusterGridInfo& gridInfo, uint32_t width, uint32_t height, uint32_t froxelSize, const Camera& camera,
+		std::span<const Light> lights, float lightRadius = pointLightRadius);
+
+	// Matches LightInFroxel in ClusterLightBinning.hlsl, the center is in view space.
+	bool SphereBoxIntersection(const XMFLOAT3& center, float radius, const FroxelBounds& box);
+
+	// Test scene helpers, shared with other light culling tests.
+
+	// Matches the camera system, the horizontal field of view is halved and the depth range is inverted.
+	Camera CreateTestCamera(const XMMATRIX& view, float fieldOfView, float aspectRatio, float nearPlane, float farPlane);
+
+	enum class LightDistribution
+	{
+		Uniform,  // Evenly spread across the screen and depth range.
+		Clustered  // Dense groups around a few hotspots, like light fixtures in rooms.
+	};
+
+	// Point lights inside the view frustum, up to a maximum depth. Positions are in world space.
+	std::vector<Light> CreateTestLights(const Camera& camera, size_t count, float maxDepth, LightDistribution distribution);
+
+	// Headless checks of the grid, bounds and binning against brute force references.
+	void Test();
+	// CPU-only measurement of binning cost and bin occupancy across froxel sizes, bin capacities and synthetic light distributions.
+	void Benchmark();
+}
\ No newline at end of file
@@ -13,42 +13,52 @@
 #include <Rendering/RenderSystems.h>
 #include <Core/CoreComponents.h>
 #include <Rendering/RenderUtils.h>
+#include <Rendering/RenderView.h>
+#include <Rendering/ClusterReference.h>
 
-ClusterGridInfo ClusteredLightCulling::ComputeGridInfo(const entt::registry& registry) const
+#include <bit>
+
+namespace
 {
-	// Make sure there's at least one camera.
-	if (!registry.size<CameraComponent>())
+	// Shared by every entry point of ClusterLightBinning.hlsl.
+	struct LightBinningBindData
 	{
-		return { 0, 0, 0, 0.f };
-	}
-
-	const auto& backBufferComponent = device->GetResourceManager().Get(device->GetBackBuffer());
+		uint32_t cameraBuffer;
+		uint32_t cameraIndex;
+		uint32_t denseClusterListBuffer;
+		uint32_t clusterBoundsBuffer;
+		uint32_t lightsBuffer;
+		uint32_t lightCount;
+		uint32_t lightCounterBuffer;
+		uint32_t lightListBuffer;
+		uint32_t lightInfoBuffer;
+		uint32_t lightListSize;
+		uint32_t lightOrderBuffer;
+		uint32_t lightNodesBuffer;
+		uint32_t lightNodeCount;
+	};
+}
 
-	float cameraNearPlane;
-	float cameraFarPlane;
-	float cameraFOV;
-	registry.view<const CameraComponent>().each([&](auto entity, const auto& camera)
+ClusterGridInfo ClusteredLightCulling::ComputeGridInfo(uint32_t width, uint32_t height, const Camera& camera, uint32_t froxelSize)
+{
+	// Views without a valid perspective camera don't have a grid.
+	if (camera.nearPlane <= 0.f || camera.fieldOfView <= 0.f)
 	{
-		cameraNearPlane = camera.nearPlane;
-		cameraFarPlane = camera.farPlane;
-		cameraFOV = camera.fieldOfView;
-	});
+		return { 0, 0, 0, 0.f };
+	}
 
-	const auto froxelSize = *CvarGet("clusteredFroxelSize", int);
-	const auto x = static_cast<uint32_t>(std::ceil(backBufferComponent.description.width / (float)froxelSize));
-	const auto y = static_cast<uint32_t>(std::ceil(backBufferComponent.description.height / (float)froxelSize));
-	const float depthFactor = 1.f + (2.f * std::tan(cameraFOV / 4.f) / (float)y);
-	const auto z = static_cast<uint32_t>(std::floor(std::log(cameraFarPlane / cameraNearPlane) / std::log(depthFactor)));
+	const auto x = static_cast<uint32_t>(std::ceil(width / (float)froxelSize));
+	const auto y = static_cast<uint32_t>(std::ceil(height / (float)froxelSize));
+	const float depthFactor = 1.f + (2.f * std::tan(camera.fieldOfView / 4.f) / (float)y);
+	const auto z = static_cast<uint32_t>(std::floor(std::log(camera.farPlane / camera.nearPlane) / std::log(depthFactor)));
 
 	return { x, y, z, depthFactor };
 }
 
-void ClusteredLightCulling::ComputeClusterGrid(CommandList& list, const RenderPipelineLayout& boundsLayout, uint32_t cameraBuffer, uint32_t clusterBoundsBuffer) const
+void ClusteredLightCulling::ComputeClusterGrid(CommandList& list, const RenderPipelineLayout& boundsLayout, const RenderView& view, const ClusterGridInfo& gridInfo, uint32_t cameraBuffer, uint32_t clusterBoundsBuffer) const
 {
 	constexpr auto groupSize = 8;
 
-	const auto& backBufferComponent = device->GetResourceManager().Get(device->GetBackBuffer());
-
 	struct BindData
 	{
 		int32_t gridDimensionsX;
@@ -66,10 +76,10 @@ void ClusteredLightCulling::ComputeClusterGrid(CommandList& list, const RenderPi
 	bindData.gridDimensionsY = gridInfo.y;
 	bindData.gridDimensionsZ = gridInfo.z;
 	bindData.nearK = gridInfo.depthFactor;
-	bindData.resolutionX = backBufferComponent.description.width;
-	bindData.resolutionY = backBufferComponent.description.height;
+	bindData.resolutionX = view.width;
+	bindData.resolutionY = view.height;
 	bindData.cameraBuffer = cameraBuffer;
-	bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
+	bindData.cameraIndex = view.cameraIndex;
 	bindData.boundsBuffer = clusterBoundsBuffer;
 
 	list.BindPipeline(boundsLayout);
@@ -79,7 +89,13 @@ void ClusteredLightCulling::ComputeClusterGrid(CommandList& list, const RenderPi
 
 ClusteredLightCulling::~ClusteredLightCulling()
 {
-	device->GetResourceManager().Destroy(clusterBounds);
+	for (const auto& clusters : viewClusters)
+	{
+		if (clusters.clusterBounds.handle != entt::null)
+		{
+			device->GetResourceManager().Destroy(clusters.clusterBounds);
+		}
+	}
 }
 
 void ClusteredLightCulling::Initialize(RenderDevice* inDevice)
@@ -88,23 +104,10 @@ void ClusteredLightCulling::Initialize(RenderDevice* inDevice)
 
 	CvarCreate("maxLightsPerFroxel", "Max number of lights per froxel bin in light culling", 256);  // Can reduce this to save memory.
 	CvarCreate("clusteredFroxelSize", "Width and height of a froxel bin in light culling, in pixels", 64);
+	CvarCreate("clusteredCompactLightList", "Builds the light list with separate count, prefix sum and fill passes, sized for the lights that are binned instead of maxLightsPerFroxel per froxel. Froxels have no light cap, 0=fixed, 1=compact", 0);
 
 	device = inDevice;
 
-	// #TODO: Dynamically reallocate.
-	constexpr auto maxDivisionsX = 60;
-	constexpr auto maxDivisionsY = 34;
-	constexpr auto maxDivisionsZ = 200;
-
-	BufferDescription clusterBoundsDesc{};
-	clusterBoundsDesc.updateRate = ResourceFrequency::Static;
-	clusterBoundsDesc.bindFlags = BindFlag::UnorderedAccess | BindFlag::ShaderResource;
-	clusterBoundsDesc.accessFlags = AccessFlag::GPUWrite;
-	clusterBoundsDesc.size = maxDivisionsX * maxDivisionsY * maxDivisionsZ;
-	clusterBoundsDesc.stride = 32;
-
-	clusterBounds = device->GetResourceManager().Create(clusterBoundsDesc, VGText("Cluster bounds"));
-
 	std::vector<D3D12_INDIRECT_ARGUMENT_DESC> binningIndirectArgDescs;
 	binningIndirectArgDescs.emplace_back(D3D12_INDIRECT_ARGUMENT_DESC{
 		.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH
@@ -123,33 +126,80 @@ void ClusteredLightCulling::Initialize(RenderDevice* inDevice)
 	}
 }
 
-ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::registry& registry, RenderResource cameraBuffer, RenderResource depthStencil, RenderResource lightsBuffer, RenderResource instanceBuffer, MeshResources meshResources, RenderResource meshIndirectRenderArgs)
+ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::registry& registry, uint32_t view, RenderResource cameraBuffer, RenderResource depthStencil, const LightResources& lightResources, RenderResource instanceBuffer, MeshResources meshResources, const MeshCullPhases& meshCullPhases)
 {
 	VGScopedCPUStat("Clustered Light Culling");
 
-	gridInfo = ComputeGridInfo(registry);
+	const auto renderView = Renderer::Get().views.Get(view);
+	const auto& camera = Renderer::Get().views.GetCameras()[renderView.cameraIndex];
+
+	if (view >= viewClusters.size())
+	{
+		viewClusters.resize(view + 1);
+	}
+
+	auto& clusters = viewClusters[view];
+	const auto froxelSize = static_cast<uint32_t>(*CvarGet("clusteredFroxelSize", int));
+	clusters.gridInfo = ComputeGridInfo(renderView.width, renderView.height, camera, froxelSize);
+	const auto gridInfo = clusters.gridInfo;
 	if (gridInfo.x == 0 || gridInfo.y == 0 || gridInfo.z == 0)
 	{
 		return {};
 	}
 
-	const auto clusterBoundsTag = graph.Import(clusterBounds);
+	if (clusters.width != renderView.width || clusters.height != renderView.height || clusters.nearPlane != camera.nearPlane ||
+		clusters.farPlane != camera.farPlane || clusters.fieldOfView != camera.fieldOfView || clusters.froxelSize != froxelSize)
+	{
+		clusters.width = renderView.width;
+		clusters.height = renderView.height;
+		clusters.nearPlane = camera.nearPlane;
+		clusters.farPlane = camera.farPlane;
+		clusters.fieldOfView = camera.fieldOfView;
+		clusters.froxelSize = froxelSize;
+		clusters.dirty = true;
+	}
+
+	const auto clusterCount = gridInfo.x * gridInfo.y * gridInfo.z;
 
-	if (dirty)
+	// Sized for the current grid, reallocated when the resolution, projection or froxel size changes its size.
+	if (clusters.boundsCapacity != clusterCount)
+	{
+		clusters.dirty = true;
+
+		if (clusters.clusterBounds.handle != entt::null)
+		{
+			// The old buffer may still be in use by frames in flight.
+			device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), clusters.clusterBounds);
+		}
+
+		BufferDescription clusterBoundsDesc{};
+		clusterBoundsDesc.updateRate = ResourceFrequency::Static;
+		clusterBoundsDesc.bindFlags = BindFlag::UnorderedAccess | BindFlag::ShaderResource;
+		clusterBoundsDesc.accessFlags = AccessFlag::GPUWrite;
+		clusterBoundsDesc.size = clusterCount;
+		clusterBoundsDesc.stride = 32;
+
+		clusters.clusterBounds = device->GetResourceManager().Create(clusterBoundsDesc, VGText("Cluster bounds"));
+		clusters.boundsCapacity = clusterCount;
+	}
+
+	const auto clusterBoundsTag = graph.Import(clusters.clusterBounds);
+
+	if (clusters.dirty)
 	{
 		auto& computeClusterGridPass = graph.AddPass("Compute Cluster Grid", ExecutionQueue::Compute);
 		computeClusterGridPass.Read(cameraBuffer, ResourceBind::SRV);
 		computeClusterGridPass.Write(clusterBoundsTag, ResourceBind::UAV);
-		computeClusterGridPass.Bind([&, cameraBuffer, clusterBoundsTag](CommandList& list, RenderPassResources& resources)
+		computeClusterGridPass.Bind([&, renderView, gridInfo, cameraBuffer, clusterBoundsTag](CommandList& list, RenderPassResources& resources)
 		{
 			const auto boundsLayout = RenderPipelineLayout{}
 				.ComputeShader({ "Clusters/ClusterBounds.hlsl", "Main" })
 				.Macro({ "FROXEL_SIZE", *CvarGet("clusteredFroxelSize", int) });
 
-			ComputeClusterGrid(list, boundsLayout, resources.Get(cameraBuffer), resources.Get(clusterBoundsTag));
+			ComputeClusterGrid(list, boundsLayout, renderView, gridInfo, resources.Get(cameraBuffer), resources.Get(clusterBoundsTag));
 		});
 
-		dirty = false;
+		clusters.dirty = false;
 	}
 
 	BufferView clusterVisibilityView{};
@@ -161,14 +211,19 @@ ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::r
 	clusterDepthCullingPass.Read(depthStencil, ResourceBind::DSV);
 	clusterDepthCullingPass.Read(instanceBuffer, ResourceBind::SRV);
 	clusterDepthCullingPass.Read(meshResources.positionTag, ResourceBind::SRV);
-	clusterDepthCullingPass.Read(meshIndirectRenderArgs, ResourceBind::Indirect);
+	for (const auto& phase : { meshCullPhases.early, meshCullPhases.late })
+	{
+		clusterDepthCullingPass.Read(phase.visibleInstances, ResourceBind::SRV);
+		clusterDepthCullingPass.Read(phase.arguments, ResourceBind::Indirect);
+		clusterDepthCullingPass.Read(phase.counters, ResourceBind::Indirect);
+	}
 	const auto clusterVisibilityTag = clusterDepthCullingPass.Create(TransientBufferDescription{
 		.updateRate = ResourceFrequency::Static,  // Must be static for UAVs.
-		.size = gridInfo.x * gridInfo.y * gridInfo.z,
+		.size = clusterCount,
 		.format = DXGI_FORMAT_R8_UINT
 	}, VGText("Cluster visibility"));
 	clusterDepthCullingPass.Write(clusterVisibilityTag, clusterVisibilityView);
-	clusterDepthCullingPass.Bind([&, cameraBuffer, instanceBuffer, meshResources, meshIndirectRenderArgs, clusterVisibilityTag](CommandList& list, RenderPassResources& resources)
+	clusterDepthCullingPass.Bind([&, view, gridInfo, cameraBuffer, instanceBuffer, meshResources, meshCullPhases, clusterVisibilityTag](CommandList& list, RenderPassResources& resources)
 	{
 		const auto depthCullLayout = RenderPipelineLayout{}
 			.VertexShader({ "Clusters/ClusterDepthCulling.hlsl", "VSMain" })
@@ -185,6 +240,7 @@ ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::r
 		struct {
 			uint32_t batchId;
 			uint32_t objectBuffer;
+			uint32_t visibleInstanceBuffer;
 			uint32_t cameraBuffer;
 			uint32_t cameraIndex;
 			uint32_t vertexPositionBuffer;
@@ -205,14 +261,14 @@ ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::r
 
 		list.BindPipeline(depthCullLayout);
 
-		MeshSystem::Render(Renderer::Get(), registry, list, bindData, resources.GetBuffer(meshIndirectRenderArgs));
+		MeshSystem::Render(Renderer::Get(), registry, list, bindData, view, resources, meshCullPhases);
 	});
 
 	auto& clusterCompaction = graph.AddPass("Visible Cluster Compaction", ExecutionQueue::Compute);
 	clusterCompaction.Read(clusterVisibilityTag, ResourceBind::SRV);
 	const auto denseClustersTag = clusterCompaction.Create(TransientBufferDescription{
 		.updateRate = ResourceFrequency::Static,  // UAVs.
-		.size = gridInfo.x * gridInfo.y * gridInfo.z,  // Worst case.
+		.size = clusterCount,  // Worst case.
 		.stride = sizeof(uint32_t),
 		.uavCounter = true
 	}, VGText("Compacted cluster list"));
@@ -223,7 +279,7 @@ ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::r
 		.stride = sizeof(D3D12_DISPATCH_ARGUMENTS)
 	}, VGText("Cluster binning indirect argument buffer"));
 	clusterCompaction.Write(indirectBufferTag, ResourceBind::UAV);
-	clusterCompaction.Bind([&, clusterVisibilityTag, denseClustersTag, indirectBufferTag](CommandList& list, RenderPassResources& resources)
+	clusterCompaction.Bind([&, gridInfo, clusterVisibilityTag, denseClustersTag, indirectBufferTag](CommandList& list, RenderPassResources& resources)
 	{
 		const auto compactionLayout = RenderPipelineLayout{}
 			.ComputeShader({ "Clusters/ClusterCompaction.hlsl", "Main" });
@@ -274,6 +330,42 @@ ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::r
 		list.Dispatch(1, 1, 1);
 	});
 
+	const auto lights = lightResources.data;
+	const auto lightCount = static_cast<uint32_t>(lights.size());  // Live lights, the persistent buffer can hold more.
+	const auto maxLightsPerFroxel = static_cast<uint64_t>(*CvarGet("maxLightsPerFroxel", int));
+	const auto compactLightList = *CvarGet("clusteredCompactLightList", int) > 0;
+
+	// Fixed lists reserve a full bin for every cluster. Compact lists only need room for the lights that get binned, which is
+	// bounded by the clusters each light can reach, and never take more memory than a fixed list. The estimate changes as the
+	// camera and lights move, but transient buffers are only reused for identical descriptions, so it's rounded up to a power of
+	// two to keep the size stable across frames.
+	const auto fixedLightListSize = clusterCount * maxLightsPerFroxel;
+	const auto lightListSize = static_cast<uint32_t>(std::max<uint64_t>(compactLightList ?
+		std::min(std::bit_ceil(ClusterReference::EstimateLightListSize(gridInfo, renderView.width, renderView.height, froxelSize, camera, lights)), fixedLightListSize) :
+		fixedLightListSize, 1));
+
+	const auto lightsBuffer = lightResources.lights;
+	const auto lightOrderBuffer = lightResources.order;
+	const auto lightNodesBuffer = lightResources.nodes;
+	const auto lightNodeCount = lightResources.nodeCount;
+
+	const auto BinningBindData = [renderView, denseClustersTag, clusterBoundsTag, lightsBuffer, lightOrderBuffer, lightNodesBuffer, lightNodeCount, lightCount, lightListSize, cameraBuffer](RenderPassResources& resources)
+	{
+		LightBinningBindData bindData{};
+		bindData.cameraBuffer = resources.Get(cameraBuffer);
+		bindData.cameraIndex = renderView.cameraIndex;
+		bindData.denseClusterListBuffer = resources.Get(denseClustersTag);
+		bindData.clusterBoundsBuffer = resources.Get(clusterBoundsTag);
+		bindData.lightsBuffer = resources.Get(lightsBuffer);
+		bindData.lightCount = lightCount;
+		bindData.lightListSize = lightListSize;
+		bindData.lightOrderBuffer = resources.Get(lightOrderBuffer);
+		bindData.lightNodesBuffer = resources.Get(lightNodesBuffer);
+		bindData.lightNodeCount = lightNodeCount;
+
+		return bindData;
+	};
+
 	BufferView lightCounterView;
 	lightCounterView.UAV("uav_visible");
 	lightCounterView.UAV("uav_nonvisible", 0, 0, HeapType::NonVisible);
@@ -281,83 +373,175 @@ ClusterResources ClusteredLightCulling::Render(RenderGraph& graph, const entt::r
 	lightInfoView.UAV("uav_visible");
 	lightInfoView.UAV("uav_nonvisible", 0, 0, HeapType::NonVisible);
 
-	auto& binningPass = graph.AddPass("Light Binning", ExecutionQueue::Compute);
-	binningPass.Read(denseClustersTag, ResourceBind::SRV);
-	binningPass.Read(clusterBoundsTag, ResourceBind::SRV);
-	binningPass.Read(lightsBuffer, ResourceBind::SRV);
-	const auto lightCounterTag = binningPass.Create(TransientBufferDescription{
+	const auto lightCounterDescription = TransientBufferDescription{
 		.updateRate = ResourceFrequency::Static,
 		.size = 1,
 		.stride = sizeof(uint32_t)
-	}, VGText("Cluster binning light counter"));
-	binningPass.Write(lightCounterTag, lightCounterView);
-	const auto lightListTag = binningPass.Create(TransientBufferDescription{
+	};
+	const auto lightListDescription = TransientBufferDescription{
 		.updateRate = ResourceFrequency::Static,
-		.size = gridInfo.x * gridInfo.y * gridInfo.z * *CvarGet("maxLightsPerFroxel", int),
+		.size = lightListSize,
 		.stride = sizeof(uint32_t)
-	}, VGText("Cluster binning light list"));
-	binningPass.Write(lightListTag, ResourceBind::UAV);
-	const auto lightInfoTag = binningPass.Create(TransientBufferDescription{
+	};
+	const auto lightInfoDescription = TransientBufferDescription{
 		.updateRate = ResourceFrequency::Static,
-		.size = gridInfo.x * gridInfo.y * gridInfo.z,
+		.size = clusterCount,
 		.stride = sizeof(uint32_t) * 2
-	}, VGText("Cluster grid light info"));
-	binningPass.Write(lightInfoTag, lightInfoView);
-	binningPass.Read(indirectBufferTag, ResourceBind::Indirect);
-	binningPass.Read(cameraBuffer, ResourceBind::SRV);  // #TODO: Precompute view space light positions.
-	binningPass.Bind([&, denseClustersTag, clusterBoundsTag, lightsBuffer, lightCounterTag,
-		lightListTag, lightInfoTag, indirectBufferTag, cameraBuffer](CommandList& list, RenderPassResources& resources)
+	};
+
+	RenderResource lightListTag;
+	RenderResource lightInfoTag;
+
+	if (compactLightList)
 	{
-		const auto binningLayout = RenderPipelineLayout{}
-			.ComputeShader({ "Clusters/ClusterLightBinning.hlsl", "Main" })
-			.Macro({ "MAX_LIGHTS_PER_FROXEL", *CvarGet("maxLightsPerFroxel", int) });
+		auto& countPass = graph.AddPass("Light Counting", ExecutionQueue::Compute);
+		countPass.Read(denseClustersTag, ResourceBind::SRV);
+		countPass.Read(clusterBoundsTag, ResourceBind::SRV);
+		countPass.Read(lightsBuffer, ResourceBind::SRV);
+		countPass.Read(lightOrderBuffer, ResourceBind::SRV);
+		countPass.Read(lightNodesBuffer, ResourceBind::SRV);
+		countPass.Read(indirectBufferTag, ResourceBind::Indirect);
+		countPass.Read(cameraBuffer, ResourceBind::SRV);
+		lightInfoTag = countPass.Create(lightInfoDescription, VGText("Cluster grid light info"));
+		countPass.Write(lightInfoTag, lightInfoView);
+		countPass.Bind([&, BinningBindData, lightInfoTag, indirectBufferTag](CommandList& list, RenderPassResources& resources)
+		{
+			const auto countLayout = RenderPipelineLayout{}
+				.ComputeShader({ "Clusters/ClusterLightBinning.hlsl", "CountMain" })
+				.Macro({ "MAX_LIGHTS_PER_FROXEL", *CvarGet("maxLightsPerFroxel", int) });
 
-		RenderUtils::Get().ClearUAV(list, resources.GetBuffer(lightCounterTag), resources.Get(lightCounterTag, "uav_visible"), resources.GetDescriptor(lightCounterTag, "uav_nonvisible"));
-		RenderUtils::Get().ClearUAV(list, resources.GetBuffer(lightInfoTag), resources.Get(lightInfoTag, "uav_visible"), resources.GetDescriptor(lightInfoTag, "uav_nonvisible"));
+			// Clusters that aren't active must read as empty.
+			RenderUtils::Get().ClearUAV(list, resources.GetBuffer(lightInfoTag), resources.Get(lightInfoTag, "uav_visible"), resources.GetDescriptor(lightInfoTag, "uav_nonvisible"));
 
-		list.UAVBarrier(resources.GetBuffer(lightCounterTag));
-		list.UAVBarrier(resources.GetBuffer(lightInfoTag));
-		list.FlushBarriers();
+			list.UAVBarrier(resources.GetBuffer(lightInfoTag));
+			list.FlushBarriers();
 
-		list.BindPipeline(binningLayout);
+			list.BindPipeline(countLayout);
 
-		auto& lightComponent = device->GetResourceManager().Get(resources.GetBuffer(lightsBuffer));
+			auto bindData = BinningBindData(resources);
+			bindData.lightInfoBuffer = resources.Get(lightInfoTag, "uav_visible");
 
-		struct BindData
+			list.BindConstants("bindData", bindData);
+
+			auto& indirectComponent = device->GetResourceManager().Get(resources.GetBuffer(indirectBufferTag));
+			list.Native()->ExecuteIndirect(binningIndirectSignature.Get(), 1, indirectComponent.allocation->GetResource(), 0, nullptr, 0);
+		});
+
+		auto& offsetPass = graph.AddPass("Light List Offsets", ExecutionQueue::Compute);
+		offsetPass.Read(denseClustersTag, ResourceBind::SRV);
+		offsetPass.Read(indirectBufferTag, ResourceBind::SRV);
+		offsetPass.Write(lightInfoTag, ResourceBind::UAV);
+		const auto lightCounterTag = offsetPass.Create(lightCounterDescription, VGText("Cluster binning light counter"));
+		offsetPass.Write(lightCounterTag, ResourceBind::UAV);
+		offsetPass.Bind([&, denseClustersTag, indirectBufferTag, lightInfoTag, lightCounterTag, lightListSize](CommandList& list, RenderPassResources& resources)
 		{
-			uint32_t cameraBuffer;
-			uint32_t cameraIndex;
-			uint32_t denseClusterListBuffer;
-			uint32_t clusterBoundsBuffer;
-			uint32_t lightsBuffer;
-			uint32_t lightCount;
-			uint32_t lightCounterBuffer;
-			uint32_t lightListBuffer;
-			uint32_t lightInfoBuffer;
-		} bindData;
+			const auto offsetLayout = RenderPipelineLayout{}
+				.ComputeShader({ "Clusters/ClusterLightOffsets.hlsl", "Main" });
+
+			list.BindPipeline(offsetLayout);
+
+			struct BindData
+			{
+				uint32_t denseClusterListBuffer;
+				uint32_t indirectBuffer;
+				uint32_t lightInfoBuffer;
+				uint32_t lightCounterBuffer;
+				uint32_t lightListSize;
+			} bindData;
+
+			bindData.denseClusterListBuffer = resources.Get(denseClustersTag);
+			bindData.indirectBuffer = resources.Get(indirectBufferTag);
+			bindData.lightInfoBuffer = resources.Get(lightInfoTag);
+			bindData.lightCounterBuffer = resources.Get(lightCounterTag);
+			bindData.lightListSize = lightListSize;
+
+			list.BindConstants("bindData", bindData);
+
+			// A single group scans every active cluster.
+			list.Dispatch(1, 1, 1);
+		});
 
-		bindData.cameraBuffer = resources.Get(cameraBuffer);
-		bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
-		bindData.denseClusterListBuffer = resources.Get(denseClustersTag);
-		bindData.clusterBoundsBuffer = resources.Get(clusterBoundsTag);
-		bindData.lightsBuffer = resources.Get(lightsBuffer);
-		bindData.lightCount = lightComponent.description.size;
-		bindData.lightCounterBuffer = resources.Get(lightCounterTag, "uav_visible");
-		bindData.lightListBuffer = resources.Get(lightListTag);
-		bindData.lightInfoBuffer = resources.Get(lightInfoTag, "uav_visible");
+		auto& fillPass = graph.AddPass("Light List Filling", ExecutionQueue::Compute);
+		fillPass.Read(denseClustersTag, ResourceBind::SRV);
+		fillPass.Read(clusterBoundsTag, ResourceBind::SRV);
+		fillPass.Read(lightsBuffer, ResourceBind::SRV);
+		fillPass.Read(lightOrderBuffer, ResourceBind::SRV);
+		fillPass.Read(lightNodesBuffer, ResourceBind::SRV);
+		fillPass.Read(lightInfoTag, ResourceBind::SRV);
+		fillPass.Read(indirectBufferTag, ResourceBind::Indirect);
+		fillPass.Read(cameraBuffer, ResourceBind::SRV);
+		lightListTag = fillPass.Create(lightListDescription, VGText("Cluster binning light list"));
+		fillPass.Write(lightListTag, ResourceBind::UAV);
+		fillPass.Bind([&, BinningBindData, lightInfoTag, lightListTag, indirectBufferTag](CommandList& list, RenderPassResources& resources)
+		{
+			const auto fillLayout = RenderPipelineLayout{}
+				.ComputeShader({ "Clusters/ClusterLightBinning.hlsl", "FillMain" })
+				.Macro({ "MAX_LIGHTS_PER_FROXEL", *CvarGet("maxLightsPerFroxel", int) });
 
-		list.BindConstants("bindData", bindData);
+			list.BindPipeline(fillLayout);
 
-		auto& indirectComponent = device->GetResourceManager().Get(resources.GetBuffer(indirectBufferTag));
-		list.Native()->ExecuteIndirect(binningIndirectSignature.Get(), 1, indirectComponent.allocation->GetResource(), 0, nullptr, 0);
-	});
+			auto bindData = BinningBindData(resources);
+			bindData.lightListBuffer = resources.Get(lightListTag);
+			bindData.lightInfoBuffer = resources.Get(lightInfoTag);
+
+			list.BindConstants("bindData", bindData);
 
-	return { lightListTag, lightInfoTag, clusterVisibilityTag };
+			auto& indirectComponent = device->GetResourceManager().Get(resources.GetBuffer(indirectBufferTag));
+			list.Native()->ExecuteIndirect(binningIndirectSignature.Get(), 1, indirectComponent.allocation->GetResource(), 0, nullptr, 0);
+		});
+	}
+
+	else
+	{
+		auto& binningPass = graph.AddPass("Light Binning", ExecutionQueue::Compute);
+		binningPass.Read(denseClustersTag, ResourceBind::SRV);
+		binningPass.Read(clusterBoundsTag, ResourceBind::SRV);
+		binningPass.Read(lightsBuffer, ResourceBind::SRV);
+		binningPass.Read(lightOrderBuffer, ResourceBind::SRV);
+		binningPass.Read(lightNodesBuffer, ResourceBind::SRV);
+		const auto lightCounterTag = binningPass.Create(lightCounterDescription, VGText("Cluster binning light counter"));
+		binningPass.Write(lightCounterTag, lightCounterView);
+		lightListTag = binningPass.Create(lightListDescription, VGText("Cluster binning light list"));
+		binningPass.Write(lightListTag, ResourceBind::UAV);
+		lightInfoTag = binningPass.Create(lightInfoDescription, VGText("Cluster grid light info"));
+		binningPass.Write(lightInfoTag, lightInfoView);
+		binningPass.Read(indirectBufferTag, ResourceBind::Indirect);
+		binningPass.Read(cameraBuffer, ResourceBind::SRV);  // #TODO: Precompute view space light positions.
+		binningPass.Bind([&, BinningBindData, lightCounterTag, lightListTag, lightInfoTag, indirectBufferTag](CommandList& list, RenderPassResources& resources)
+		{
+			const auto binningLayout = RenderPipelineLayout{}
+				.ComputeShader({ "Clusters/ClusterLightBinning.hlsl", "Main" })
+				.Macro({ "MAX_LIGHTS_PER_FROXEL", *CvarGet("maxLightsPerFroxel", int) });
+
+			RenderUtils::Get().ClearUAV(list, resources.GetBuffer(lightCounterTag), resources.Get(lightCounterTag, "uav_visible"), resources.GetDescriptor(lightCounterTag, "uav_nonvisible"));
+			RenderUtils::Get().ClearUAV(list, resources.GetBuffer(lightInfoTag), resources.Get(lightInfoTag, "uav_visible"), resources.GetDescriptor(lightInfoTag, "uav_nonvisible"));
+
+			list.UAVBarrier(resources.GetBuffer(lightCounterTag));
+			list.UAVBarrier(resources.GetBuffer(lightInfoTag));
+			list.FlushBarriers();
+
+			list.BindPipeline(binningLayout);
+
+			auto bindData = BinningBindData(resources);
+			bindData.lightCounterBuffer = resources.Get(lightCounterTag, "uav_visible");
+			bindData.lightListBuffer = resources.Get(lightListTag);
+			bindData.lightInfoBuffer = resources.Get(lightInfoTag, "uav_visible");
+
+			list.BindConstants("bindData", bindData);
+
+			auto& indirectComponent = device->GetResourceManager().Get(resources.GetBuffer(indirectBufferTag));
+			list.Native()->ExecuteIndirect(binningIndirectSignature.Get(), 1, indirectComponent.allocation->GetResource(), 0, nullptr, 0);
+		});
+	}
+
+	return { lightListTag, lightInfoTag, clusterVisibilityTag, view };
 }
 
-RenderResource ClusteredLightCulling::RenderDebugOverlay(RenderGraph& graph, RenderResource lightInfoBuffer, RenderResource clusterVisibilityBuffer)
+RenderResource ClusteredLightCulling::RenderDebugOverlay(RenderGraph& graph, uint32_t view, RenderResource lightInfoBuffer, RenderResource clusterVisibilityBuffer)
 {
 #if ENABLE_EDITOR
+	const auto gridInfo = viewClusters[view].gridInfo;
+
 	auto& overlayPass = graph.AddPass("Cluster Debug Overlay", ExecutionQueue::Graphics);
 	overlayPass.Read(lightInfoBuffer, ResourceBind::SRV);
 	overlayPass.Read(clusterVisibilityBuffer, ResourceBind::SRV);
@@ -365,7 +549,7 @@ RenderResource ClusteredLightCulling::RenderDebugOverlay(RenderGraph& graph, Ren
 		.format = DXGI_FORMAT_R16G16B16A16_FLOAT
 	}, VGText("Cluster debug overlay"));
 	overlayPass.Output(clusterDebugOverlayTag, OutputBind::RTV, LoadType::Preserve);
-	overlayPass.Bind([&, lightInfoBuffer, clusterVisibilityBuffer](CommandList& list, RenderPassResources& resources)
+	overlayPass.Bind([&, gridInfo, lightInfoBuffer, clusterVisibilityBuffer](CommandList& list, RenderPassResources& resources)
 	{
 		const auto debugOverlayLayout = RenderPipelineLayout{}
 			.VertexShader({ "Clusters/ClusterDebugOverlay.hlsl", "VSMain" })
@@ -402,4 +586,12 @@ RenderResource ClusteredLightCulling::RenderDebugOverlay(RenderGraph& graph, Ren
 #else
 	return {};
 #endif
+}
+
+void ClusteredLightCulling::MarkDirty()
+{
+	for (auto& clusters : viewClusters)
+	{
+		clusters.dirty = true;
+	}
 }
\ No newline at end of file
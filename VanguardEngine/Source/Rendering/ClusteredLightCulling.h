@@ -6,9 +6,13 @@
 #include <Rendering/ResourceHandle.h>
 #include <Rendering/RenderGraphResource.h>
 #include <Rendering/RenderPipeline.h>
+#include <Rendering/ShaderStructs.h>
 
 #include <entt/entt.hpp>
 
+#include <vector>
+#include <span>
+
 // #TEMP
 struct MeshResources
 {
@@ -16,9 +20,25 @@ struct MeshResources
 	RenderResource extraTag;
 };
 
+// Output of the mesh culling pass, every view's draws live in the same buffers.
+struct MeshCullResources
+{
+	RenderResource visibleInstances;
+	RenderResource arguments;
+	RenderResource counters;
+};
+
+// Occlusion culling splits the draws in two phases, passes that see the whole scene draw both.
+struct MeshCullPhases
+{
+	MeshCullResources early;  // Visible last frame, drawn before the hi-z is built.
+	MeshCullResources late;  // Newly visible after testing against the hi-z.
+};
+
 class RenderDevice;
 class CommandList;
 class RenderGraph;
+struct RenderView;
 
 struct ClusterGridInfo
 {
@@ -28,11 +48,22 @@ struct ClusterGridInfo
 	float depthFactor;
 };
 
+// Light buffer with its Morton ordered hierarchy, see LightHierarchy.h.
+struct LightResources
+{
+	RenderResource lights;
+	RenderResource order;
+	RenderResource nodes;
+	uint32_t nodeCount;  // Zero without a hierarchy, every light is tested.
+	std::span<const Light> data;  // CPU copy of the light buffer.
+};
+
 struct ClusterResources
 {
 	RenderResource lightList;
 	RenderResource lightInfo;
 	RenderResource lightVisibility;
+	uint32_t view;
 };
 
 class ClusteredLightCulling
@@ -40,9 +71,22 @@ class ClusteredLightCulling
 private:
 	RenderDevice* device = nullptr;
 
-	bool dirty = true;
-	ClusterGridInfo gridInfo;
-	BufferHandle clusterBounds;
+	struct ViewClusters
+	{
+		bool dirty = true;
+		ClusterGridInfo gridInfo;
+		BufferHandle clusterBounds;
+		uint32_t boundsCapacity = 0;  // Clusters the bounds buffer was allocated for, follows the grid size.
+		// Parameters the bounds were computed with, changing any requires recomputing them.
+		uint32_t width = 0;
+		uint32_t height = 0;
+		float nearPlane = 0.f;
+		float farPlane = 0.f;
+		float fieldOfView = 0.f;
+		uint32_t froxelSize = 0;
+	};
+
+	std::vector<ViewClusters> viewClusters;  // Indexed by view, grids are built on first use.
 
 #if ENABLE_EDITOR
 	// Debugging visualizations.
@@ -51,17 +95,21 @@ private:
 
 	ResourcePtr<ID3D12CommandSignature> binningIndirectSignature;
 
-	ClusterGridInfo ComputeGridInfo(const entt::registry& registry) const;
-	// Needs to be called every time the camera resolution or FOV changes.
-	void ComputeClusterGrid(CommandList& list, const RenderPipelineLayout& boundsLayout, uint32_t cameraBuffer, uint32_t clusterBoundsBuffer) const;
+	// Needs to be called every time the view resolution or camera projection changes.
+	void ComputeClusterGrid(CommandList& list, const RenderPipelineLayout& boundsLayout, const RenderView& view, const ClusterGridInfo& gridInfo, uint32_t cameraBuffer, uint32_t clusterBoundsBuffer) const;
 
 public:
+	// Grid dimensions of a view, zero if the camera has no valid perspective projection. Shared with the CPU reference.
+	static ClusterGridInfo ComputeGridInfo(uint32_t width, uint32_t height, const Camera& camera, uint32_t froxelSize);
+
 	~ClusteredLightCulling();
 
 	void Initialize(RenderDevice* inDevice);
-	const ClusterGridInfo& GetGridInfo() const { return gridInfo; }
-	ClusterResources Render(RenderGraph& graph, const entt::registry& registry, RenderResource cameraBuffer, RenderResource depthStencil, RenderResource lightsBuffer, RenderResource instanceBuffer, MeshResources meshResources, RenderResource meshIndirectRenderArgs);
-	RenderResource RenderDebugOverlay(RenderGraph& graph, RenderResource lightInfoBuffer, RenderResource clusterVisibilityBuffer);
+	const ClusterGridInfo& GetGridInfo(uint32_t view) const { return viewClusters[view].gridInfo; }
+	// Builds the light lists of a view that draws meshes, using its depth buffer.
+	ClusterResources Render(RenderGraph& graph, const entt::registry& registry, uint32_t view, RenderResource cameraBuffer, RenderResource depthStencil, const LightResources& lightResources, RenderResource instanceBuffer, MeshResources meshResources, const MeshCullPhases& meshCullPhases);
+	RenderResource RenderDebugOverlay(RenderGraph& graph, uint32_t view, RenderResource lightInfoBuffer, RenderResource clusterVisibilityBuffer);
 
-	void MarkDirty() { dirty = true; };
+	// Recomputes the bounds of every view, reallocating them if the grid size changed.
+	void MarkDirty();
 };
\ No newline at end of file
@@ -0,0 +1,417 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/EnvironmentSchedule.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+namespace
+{
+	uint64_t GroupsPerFace(uint32_t size)
+	{
+		const uint64_t groups = (size + 7) / 8;  // 8x8 thread groups.
+		return groups * groups;
+	}
+
+	float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMVectorGetX(XMVector3Length(XMLoadFloat3(&a) - XMLoadFloat3(&b)));
+	}
+}
+
+EnvironmentCost& EnvironmentCost::operator+=(const EnvironmentCost& other)
+{
+	luminanceGroups += other.luminanceGroups;
+	irradianceGroups += other.irradianceGroups;
+	prefilterGroups += other.prefilterGroups;
+
+	return *this;
+}
+
+std::vector<EnvironmentSlice> EnvironmentSchedule::BuildSlices(EnvironmentUpdateGranularity granularity, uint32_t prefilterLevels)
+{
+	std::vector<EnvironmentSlice> result;
+
+	if (granularity == EnvironmentUpdateGranularity::Frame)
+	{
+		result.emplace_back(EnvironmentSlice{
+			.luminanceFaceBegin = 0,
+			.luminanceFaceCount = faces,
+			.luminanceMips = true,
+			.irradianceFaceBegin = 0,
+			.irradianceFaceCount = faces,
+			.prefilterFaceBegin = 0,
+			.prefilterFaceCount = faces,
+			.prefilterLevelBegin = 0,
+			.prefilterLevelCount = prefilterLevels
+		});
+
+		return result;
+	}
+
+	// The luminance faces are the most expensive part of an update, they're always spread over frames.
+	for (uint32_t face = 0; face < faces; ++face)
+	{
+		result.emplace_back(EnvironmentSlice{
+			.luminanceFaceBegin = face,
+			.luminanceFaceCount = 1,
+			.luminanceMips = face == faces - 1
+		});
+	}
+
+	if (granularity == EnvironmentUpdateGranularity::Face)
+	{
+		for (uint32_t face = 0; face < faces; ++face)
+		{
+			result.emplace_back(EnvironmentSlice{
+				.irradianceFaceBegin = face,
+				.irradianceFaceCount = 1,
+				.prefilterFaceBegin = face,
+				.prefilterFaceCount = 1,
+				.prefilterLevelBegin = 0,
+				.prefilterLevelCount = prefilterLevels
+			});
+		}
+	}
+
+	else
+	{
+		// The irradiance map has a single mip.
+		result.emplace_back(EnvironmentSlice{
+			.irradianceFaceBegin = 0,
+			.irradianceFaceCount = faces
+		});
+
+		for (uint32_t level = 0; level < prefilterLevels; ++level)
+		{
+			result.emplace_back(EnvironmentSlice{
+				.prefilterFaceBegin = 0,
+				.prefilterFaceCount = faces,
+				.prefilterLevelBegin = level,
+				.prefilterLevelCount = 1
+			});
+		}
+	}
+
+	return result;
+}
+
+EnvironmentCost EnvironmentSchedule::ComputeCost(const EnvironmentSlice& slice, const EnvironmentMapLayout& layout)
+{
+	EnvironmentCost cost;
+	cost.luminanceGroups = GroupsPerFace(layout.luminanceSize) * slice.luminanceFaceCount;
+	cost.irradianceGroups = GroupsPerFace(layout.irradianceSize) * slice.irradianceFaceCount;
+
+	for (uint32_t level = slice.prefilterLevelBegin; level < slice.prefilterLevelBegin + slice.prefilterLevelCount; ++level)
+	{
+		cost.prefilterGroups += GroupsPerFace(std::max(layout.prefilterSize >> level, 1u)) * slice.prefilterFaceCount;
+	}
+
+	return cost;
+}
+
+void EnvironmentSchedule::Initialize(const EnvironmentMapLayout& inLayout)
+{
+	layout = inLayout;
+}
+
+EnvironmentUpdate EnvironmentSchedule::Update(const EnvironmentInputs& inputs, const EnvironmentUpdateSettings& settings)
+{
+	const auto& latestInputs = Updating() ? updateInputs : displayedInputs;
+
+	// Maps from other LUTs are wrong rather than outdated, replace them at once.
+	if (!valid || inputs.lutVersion != latestInputs.lutVersion)
+	{
+		updateInputs = inputs;
+		slices = BuildSlices(EnvironmentUpdateGranularity::Frame, layout.prefilterLevels);
+		nextSlice = 0;
+	}
+
+	else if (!Updating())
+	{
+		const auto sunMoved = std::abs(inputs.solarZenithAngle - displayedInputs.solarZenithAngle) > settings.sunThreshold;
+		const auto cameraMoved = Distance(inputs.cameraPosition, displayedInputs.cameraPosition) > settings.cameraThreshold;
+
+		if (sunMoved || cameraMoved)
+		{
+			updateInputs = inputs;
+			slices = BuildSlices(settings.granularity, layout.prefilterLevels);
+			nextSlice = 0;
+		}
+	}
+
+	EnvironmentUpdate result;
+	result.writeSet = 1 - readSet;
+	result.solarZenithAngle = updateInputs.solarZenithAngle;
+	result.cameraPosition = updateInputs.cameraPosition;
+
+	if (Updating())
+	{
+		result.slice = slices[nextSlice++];
+
+		if (!Updating())
+		{
+			readSet = result.writeSet;
+			displayedInputs = updateInputs;
+			valid = true;
+			++stats.updates;
+		}
+	}
+
+	result.readSet = readSet;
+
+	++stats.frames;
+
+	if (result.slice.Empty())
+	{
+		++stats.framesSkipped;
+		++stats.skips;
+	}
+
+	else
+	{
+		stats.framesSkipped = 0;
+
+		const auto cost = ComputeCost(result.slice, layout);
+		stats.cost += cost;
+		if (cost.Total() > stats.peakCost.Total())
+		{
+			stats.peakCost = cost;
+		}
+	}
+
+	return result;
+}
+
+void EnvironmentSchedule::Test()
+{
+	VGScopedCPUStat("Environment Schedule Test");
+
+	TestReport report{ logRendering, VGText("Environment schedule") };
+
+	constexpr EnvironmentMapLayout layout = { 1024, 32, 128, 6 };
+	constexpr EnvironmentUpdateGranularity granularities[] = { EnvironmentUpdateGranularity::Frame, EnvironmentUpdateGranularity::Face, EnvironmentUpdateGranularity::Mip };
+
+	const auto fullCost = ComputeCost(BuildSlices(EnvironmentUpdateGranularity::Frame, layout.prefilterLevels)[0], layout);
+	const auto Once = [](const std::vector<uint32_t>& counts) { return std::all_of(counts.begin(), counts.end(), [](auto count) { return count == 1; }); };
+
+	// Every face and level is rendered exactly once, and the convolutions only start once the luminance mips exist.
+	for (const auto granularity : granularities)
+	{
+		for (const uint32_t levels : { 1u, layout.prefilterLevels })
+		{
+			const auto slices = BuildSlices(granularity, levels);
+
+			std::vector<uint32_t> luminance(faces, 0);
+			std::vector<uint32_t> irradiance(faces, 0);
+			std::vector<uint32_t> prefilter(faces * levels, 0);
+			uint32_t mips = 0;
+			bool ordered = true;
+			bool amortized = true;
+			EnvironmentCost cost;
+
+			for (const auto& slice : slices)
+			{
+				for (uint32_t face = slice.luminanceFaceBegin; face < slice.luminanceFaceBegin + slice.luminanceFaceCount; ++face)
+				{
+					++luminance[face];
+					ordered = ordered && mips == 0;
+				}
+
+				if (slice.luminanceMips)
+				{
+					++mips;
+					ordered = ordered && Once(luminance);
+				}
+
+				for (uint32_t face = slice.irradianceFaceBegin; face < slice.irradianceFaceBegin + slice.irradianceFaceCount; ++face)
+				{
+					++irradiance[face];
+					ordered = ordered && mips == 1;
+				}
+
+				for (uint32_t face = slice.prefilterFaceBegin; face < slice.prefilterFaceBegin + slice.prefilterFaceCount; ++face)
+				{
+					for (uint32_t level = slice.prefilterLevelBegin; level < slice.prefilterLevelBegin + slice.prefilterLevelCount; ++level)
+					{
+						++prefilter[face * levels + level];
+						ordered = ordered && mips == 1;
+					}
+				}
+
+				if (granularity == EnvironmentUpdateGranularity::Face)
+				{
+					amortized = amortized && slice.luminanceFaceCount + slice.irradianceFaceCount <= 1 && slice.prefilterFaceCount <= 1;
+				}
+
+				else if (granularity == EnvironmentUpdateGranularity::Mip)
+				{
+					amortized = amortized && slice.luminanceFaceCount <= 1 && slice.prefilterLevelCount <= 1 && (slice.irradianceFaceCount == 0 || slice.prefilterLevelCount == 0);
+				}
+
+				cost += ComputeCost(slice, { layout.luminanceSize, layout.irradianceSize, layout.prefilterSize, levels });
+			}
+
+			report.Check(Once(luminance) && mips == 1, "slices: luminance faces or mips aren't rendered exactly once");
+			report.Check(Once(irradiance), "slices: irradiance faces aren't rendered exactly once");
+			report.Check(Once(prefilter), "slices: prefilter faces and levels aren't rendered exactly once");
+			report.Check(ordered, "slices: a convolution samples the luminance map before its mips are generated");
+			report.Check(amortized, "slices: a slice renders more than its granularity allows");
+			report.Check(std::none_of(slices.begin(), slices.end(), [](const auto& slice) { return slice.Empty(); }), "slices: empty slice in an update");
+
+			if (levels == layout.prefilterLevels)
+			{
+				// Slicing doesn't add or remove work.
+				report.Check(cost.Total() == fullCost.Total(), "slices: amortized update dispatches a different amount of work than a full update");
+			}
+		}
+	}
+
+	report.Check(BuildSlices(EnvironmentUpdateGranularity::Face, 6).size() == 12 && BuildSlices(EnvironmentUpdateGranularity::Mip, 6).size() == 13, "slices: unexpected update length");
+	report.Check(fullCost.luminanceGroups == 6 * 128 * 128 && fullCost.irradianceGroups == 6 * 4 * 4 && fullCost.prefilterGroups == 6 * (256 + 64 + 16 + 4 + 1 + 1), "cost: thread groups don't match the dispatches");
+
+	// Update policy.
+	{
+		EnvironmentSchedule schedule;
+		schedule.Initialize(layout);
+
+		EnvironmentUpdateSettings settings;
+		settings.granularity = EnvironmentUpdateGranularity::Face;
+		const auto updateLength = (uint32_t)BuildSlices(settings.granularity, layout.prefilterLevels).size();
+
+		EnvironmentInputs inputs;
+		inputs.solarZenithAngle = 0.5f;
+		inputs.lutVersion = 1;
+
+		// Nothing to display yet, the first update is rendered at once and displayed the same frame.
+		auto update = schedule.Update(inputs, settings);
+		report.Check(update.slice.luminanceFaceCount == faces && update.slice.prefilterLevelCount == layout.prefilterLevels && update.readSet == update.writeSet && !schedule.Updating(),
+			"policy: first update isn't rendered and displayed in a single frame");
+		const auto firstSet = update.readSet;
+
+		bool idle = true;
+		for (int i = 0; i < 10; ++i)
+		{
+			inputs.solarZenithAngle += settings.sunThreshold * 0.05f;  // Stays below the threshold.
+			update = schedule.Update(inputs, settings);
+			idle = idle && update.slice.Empty() && update.readSet == firstSet;
+		}
+
+		report.Check(idle, "policy: maps are updated while the sun is below the threshold");
+		report.Check(schedule.stats.skips == 10 && schedule.stats.framesSkipped == 10 && schedule.stats.updates == 1, "stats: skipped frames aren't counted");
+
+		// Crossing the threshold starts an amortized update, which keeps the angle and camera it started with while both keep moving.
+		inputs.solarZenithAngle = 0.5f + settings.sunThreshold * 1.5f;
+		const auto startAngle = inputs.solarZenithAngle;
+		const auto startCamera = inputs.cameraPosition;
+		bool consistent = true;
+		bool buffered = true;
+		uint32_t frames = 0;
+
+		do
+		{
+			update = schedule.Update(inputs, settings);
+			inputs.solarZenithAngle += settings.sunThreshold * 0.5f;
+			inputs.cameraPosition.x += settings.cameraThreshold * 0.01f;  // Stays below the threshold.
+			++frames;
+
+			consistent = consistent && update.solarZenithAngle == startAngle && update.cameraPosition.x == startCamera.x && !update.slice.Empty();
+			buffered = buffered && update.writeSet != firstSet && (schedule.Updating() ? update.readSet == firstSet : update.readSet == update.writeSet);
+		} while (schedule.Updating() && frames < 100);
+
+		report.Check(frames == updateLength, "policy: amortized update doesn't take one frame per slice");
+		report.Check(consistent, "policy: slices of an update are rendered with different sun angles or camera positions");
+		report.Check(buffered, "policy: displayed maps are written to, or sets swap before the update completes");
+
+		// The sun moved past the threshold during the update, the next one starts right away.
+		update = schedule.Update(inputs, settings);
+		report.Check(schedule.Updating() && update.writeSet == firstSet && update.solarZenithAngle == inputs.solarZenithAngle, "policy: update isn't restarted after the sun moved during the previous one");
+
+		// New LUTs replace the maps at once, abandoning the update in progress.
+		inputs.lutVersion = 2;
+		update = schedule.Update(inputs, settings);
+		report.Check(update.slice.luminanceFaceCount == faces && update.readSet == update.writeSet && !schedule.Updating(), "policy: LUT change doesn't replace the maps in a single frame");
+
+		// Camera movement.
+		inputs.cameraPosition.z += settings.cameraThreshold * 0.5f;
+		update = schedule.Update(inputs, settings);
+		report.Check(update.slice.Empty(), "policy: small camera movement starts an update");
+		inputs.cameraPosition.z += settings.cameraThreshold;
+		update = schedule.Update(inputs, settings);
+		report.Check(!update.slice.Empty(), "policy: camera movement past the threshold doesn't start an update");
+	}
+
+	report.Log();
+}
+
+void EnvironmentSchedule::Benchmark()
+{
+	VGScopedCPUStat("Environment Schedule Benchmark");
+
+	constexpr EnvironmentMapLayout layout = { 1024, 32, 128, 6 };
+	constexpr uint32_t frames = 60 * 600;  // Ten minutes at 60 fps.
+	constexpr float deltaTime = 1.f / 60.f;
+
+	const auto fullCost = ComputeCost(BuildSlices(EnvironmentUpdateGranularity::Frame, layout.prefilterLevels)[0], layout);
+	VGLog(logRendering, "Environment schedule benchmark, updating every frame dispatches {} thread groups per frame ({} luminance, {} irradiance, {} prefilter).",
+		fullCost.Total(), fullCost.luminanceGroups, fullCost.irradianceGroups, fullCost.prefilterGroups);
+
+	constexpr std::pair<EnvironmentUpdateGranularity, const char*> granularities[] = {
+		{ EnvironmentUpdateGranularity::Frame, "frame" },
+		{ EnvironmentUpdateGranularity::Face, "face" },
+		{ EnvironmentUpdateGranularity::Mip, "mip" }
+	};
+
+	for (const float speed : { 0.1f, 1.f, 10.f })
+	{
+		for (const auto& [granularity, name] : granularities)
+		{
+			EnvironmentSchedule schedule;
+			schedule.Initialize(layout);
+
+			EnvironmentUpdateSettings settings;
+			settings.granularity = granularity;
+
+			EnvironmentInputs inputs;
+			inputs.lutVersion = 1;
+			float direction = 1.f;
+			float displayedAngle = 0.f;
+			float lagSum = 0.f;
+			float maxLag = 0.f;
+			uint64_t peakGroups = 0;  // After the first frame, which always renders a full update.
+
+			for (uint32_t frame = 0; frame < frames; ++frame)
+			{
+				// Matches the oscillating animation of the time of day system.
+				inputs.solarZenithAngle += (0.25f * std::cos(2.f * inputs.solarZenithAngle) + 0.3f) * speed * direction * deltaTime * 0.3f;
+				if (std::abs(inputs.solarZenithAngle) > XM_PIDIV2 - 0.0001f)
+				{
+					direction *= -1.f;
+					inputs.solarZenithAngle += 0.0001f * direction;
+				}
+
+				const auto update = schedule.Update(inputs, settings);
+				if (!schedule.Updating() && !update.slice.Empty())
+				{
+					displayedAngle = update.solarZenithAngle;
+				}
+
+				if (frame > 0)
+				{
+					peakGroups = std::max(peakGroups, ComputeCost(update.slice, layout).Total());
+				}
+
+				const auto lag = std::abs(inputs.solarZenithAngle - displayedAngle);
+				lagSum += lag;
+				maxLag = std::max(maxLag, lag);
+			}
+
+			const auto& stats = schedule.stats;
+			VGLog(logRendering, "Environment schedule benchmark, {}x speed, one {} per frame: {:.0f} thread groups per frame on average ({:.1f}% of every frame), {} at peak, "
+				"{:.1f}% of frames idle, {} updates, sun lags the lighting by {:.4f} radians on average and {:.4f} at most.", speed, name, (double)stats.cost.Total() / frames,
+				100.0 * stats.cost.Total() / ((double)fullCost.Total() * frames), peakGroups, 100.0 * stats.skips / frames, stats.updates, lagSum / frames, maxLag);
+		}
+	}
+}
\ No newline at end of file
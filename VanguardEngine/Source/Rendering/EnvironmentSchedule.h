@@ -0,0 +1,126 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <vector>
+#include <cstdint>
+
+// Sizes of the maps an environment update renders.
+struct EnvironmentMapLayout
+{
+	uint32_t luminanceSize;  // Sky luminance cube map, every mip is generated.
+	uint32_t irradianceSize;
+	uint32_t prefilterSize;  // Resolution of the base mip.
+	uint32_t prefilterLevels;
+};
+
+enum class EnvironmentUpdateGranularity : uint32_t
+{
+	Frame,  // The whole update in one frame.
+	Face,  // One cube face per frame, of the luminance map, then of the irradiance and all prefilter levels together.
+	Mip  // One luminance face per frame, then the irradiance map, then one prefilter level of every face per frame.
+};
+
+// Work of an update rendered in one frame. Ranges with a count of zero are skipped.
+struct EnvironmentSlice
+{
+	uint32_t luminanceFaceBegin = 0;
+	uint32_t luminanceFaceCount = 0;
+	bool luminanceMips = false;  // Generates the luminance mip chain, after the last face.
+	uint32_t irradianceFaceBegin = 0;
+	uint32_t irradianceFaceCount = 0;
+	uint32_t prefilterFaceBegin = 0;
+	uint32_t prefilterFaceCount = 0;
+	uint32_t prefilterLevelBegin = 0;
+	uint32_t prefilterLevelCount = 0;
+
+	bool Empty() const { return luminanceFaceCount == 0 && !luminanceMips && irradianceFaceCount == 0 && (prefilterFaceCount == 0 || prefilterLevelCount == 0); }
+};
+
+// Thread groups of the convolution and luminance dispatches, the mip chain generation isn't included.
+struct EnvironmentCost
+{
+	uint64_t luminanceGroups = 0;
+	uint64_t irradianceGroups = 0;
+	uint64_t prefilterGroups = 0;
+
+	uint64_t Total() const { return luminanceGroups + irradianceGroups + prefilterGroups; }
+	EnvironmentCost& operator+=(const EnvironmentCost& other);
+};
+
+struct EnvironmentUpdateSettings
+{
+	EnvironmentUpdateGranularity granularity = EnvironmentUpdateGranularity::Face;
+	float sunThreshold = 0.004f;  // Radians of solar zenith angle change that start an update.
+	float cameraThreshold = 100.f;  // Meters of camera movement that start an update.
+};
+
+// Scene state the environment maps are rendered from.
+struct EnvironmentInputs
+{
+	float solarZenithAngle = 0.f;
+	XMFLOAT3 cameraPosition = { 0.f, 0.f, 0.f };
+	uint32_t lutVersion = 0;  // Changes whenever the atmosphere LUTs are recomputed.
+};
+
+struct EnvironmentUpdate
+{
+	EnvironmentSlice slice;  // Rendered into the write set this frame, empty while no update is in progress.
+	float solarZenithAngle = 0.f;  // The update renders every slice with the angle it started at, so that its faces agree.
+	XMFLOAT3 cameraPosition = { 0.f, 0.f, 0.f };  // Likewise the camera position it started at.
+	uint32_t writeSet = 1;
+	uint32_t readSet = 0;  // Lights the frame, becomes the write set on the frame its last slice is rendered.
+};
+
+// Reused maps are counted by frames, the work of updates by dispatched thread groups.
+struct EnvironmentUpdateStats
+{
+	uint32_t framesSkipped = 0;  // Since the last frame with update work.
+	uint64_t skips = 0;  // Total frames without update work.
+	uint64_t frames = 0;
+	uint64_t updates = 0;  // Completed.
+	EnvironmentCost cost;  // Total.
+	EnvironmentCost peakCost;  // Most expensive frame.
+};
+
+// Amortizes updates of the sky luminance cube map and the image based lighting maps convolved from it. The maps only change
+// with the sun, the camera and the atmosphere LUTs, so an update starts once they moved past a threshold from where the
+// displayed maps were rendered, and is spread over several frames. Lighting maps are double buffered, updates render into
+// the set that isn't displayed and the sets swap once it's complete. The luminance map is only an input of the convolutions,
+// it isn't buffered.
+class EnvironmentSchedule
+{
+public:
+	static constexpr uint32_t faces = 6;
+
+	EnvironmentUpdateStats stats;
+
+private:
+	EnvironmentMapLayout layout{};
+
+	bool valid = false;  // The read set has been rendered.
+	EnvironmentInputs displayedInputs;  // The read set was rendered with.
+	EnvironmentInputs updateInputs;
+	std::vector<EnvironmentSlice> slices;  // Of the update in progress.
+	uint32_t nextSlice = 0;
+	uint32_t readSet = 0;
+
+public:
+	// Slices of a complete update, in order. Every face of the luminance map is rendered and its mips generated before the
+	// convolutions sample it.
+	static std::vector<EnvironmentSlice> BuildSlices(EnvironmentUpdateGranularity granularity, uint32_t prefilterLevels);
+	static EnvironmentCost ComputeCost(const EnvironmentSlice& slice, const EnvironmentMapLayout& layout);
+
+	void Initialize(const EnvironmentMapLayout& inLayout);
+	// Returns this frame's work and the sets to render into and light with. Until the maps have been rendered once, and after
+	// the LUTs change, updates are rendered in a single frame.
+	EnvironmentUpdate Update(const EnvironmentInputs& inputs, const EnvironmentUpdateSettings& settings);
+	bool Updating() const { return nextSlice < slices.size(); }
+
+	// Headless checks of the slice plans and the update policy.
+	static void Test();
+	// Measures the work per frame of each granularity over a simulated day cycle, against updating every frame. Results are logged.
+	static void Benchmark();
+};
\ No newline at end of file
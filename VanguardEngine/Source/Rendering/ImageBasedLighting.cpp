@@ -7,10 +7,20 @@
 #include <Rendering/Resource.h>
 #include <Rendering/ShaderStructs.h>
 
+#include <algorithm>
+
 ImageBasedLighting::~ImageBasedLighting()
 {
-	device->GetResourceManager().Destroy(irradianceTexture);
-	device->GetResourceManager().Destroy(prefilterTexture);
+	for (auto texture : irradianceTextures)
+	{
+		device->GetResourceManager().Destroy(texture);
+	}
+
+	for (auto texture : prefilterTextures)
+	{
+		device->GetResourceManager().Destroy(texture);
+	}
+
 	device->GetResourceManager().Destroy(brdfTexture);
 }
 
@@ -41,7 +51,8 @@ void ImageBasedLighting::Initialize(RenderDevice* inDevice)
 		.array = true
 	};
 
-	irradianceTexture = device->GetResourceManager().Create(irradianceDesc, VGText("IBL irradiance"));
+	irradianceTextures[0] = device->GetResourceManager().Create(irradianceDesc, VGText("IBL irradiance 0"));
+	irradianceTextures[1] = device->GetResourceManager().Create(irradianceDesc, VGText("IBL irradiance 1"));
 
 	TextureDescription prefilterDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
@@ -54,7 +65,8 @@ void ImageBasedLighting::Initialize(RenderDevice* inDevice)
 		.array = true
 	};
 
-	prefilterTexture = device->GetResourceManager().Create(prefilterDesc, VGText("IBL prefilter"));
+	prefilterTextures[0] = device->GetResourceManager().Create(prefilterDesc, VGText("IBL prefilter 0"));
+	prefilterTextures[1] = device->GetResourceManager().Create(prefilterDesc, VGText("IBL prefilter 1"));
 
 	TextureDescription brdfDesc{
 		.bindFlags = BindFlag::ShaderResource | BindFlag::UnorderedAccess,
@@ -69,12 +81,23 @@ void ImageBasedLighting::Initialize(RenderDevice* inDevice)
 	brdfTexture = device->GetResourceManager().Create(brdfDesc, VGText("IBL BRDF"));
 }
 
-IBLResources ImageBasedLighting::UpdateLuts(RenderGraph& graph, RenderResource luminanceTexture, RenderResource cameraBuffer)
+IBLResources ImageBasedLighting::UpdateLuts(RenderGraph& graph, RenderResource luminanceTexture, const EnvironmentUpdate& update)
 {
-	const auto irradianceTag = graph.Import(irradianceTexture);
-	const auto prefilterTag = graph.Import(prefilterTexture);
+	const auto irradianceTag = graph.Import(irradianceTextures[update.readSet]);
+	const auto prefilterTag = graph.Import(prefilterTextures[update.readSet]);
 	const auto brdfTag = graph.Import(brdfTexture);
 
+	// Bind data is shared by all convolution shaders.
+	struct BindData
+	{
+		uint32_t luminanceTexture;
+		uint32_t irradianceTexture;
+		uint32_t brdfTexture;
+		uint32_t cubeFace;
+		uint32_t prefilterTexture;
+		uint32_t prefilterLevel;
+	};
+
 	if (!brdfRendered)
 	{
 		auto& brdfPass = graph.AddPass("IBL BRDF Pass", ExecutionQueue::Compute);
@@ -84,15 +107,7 @@ IBLResources ImageBasedLighting::UpdateLuts(RenderGraph& graph, RenderResource l
 		{
 			list.BindPipeline(brdfPrecomputeLayout);
 
-			struct BindData
-			{
-				uint32_t luminanceTexture;
-				uint32_t convolutionTexture;
-				uint32_t brdfTexture;
-				uint32_t cubeFace;
-				uint128_t prefilterMips[prefilterLevels];
-			} bindData;
-
+			BindData bindData;
 			bindData.brdfTexture = resources.Get(brdfTag);
 			list.BindConstants("bindData", bindData);
 
@@ -102,67 +117,72 @@ IBLResources ImageBasedLighting::UpdateLuts(RenderGraph& graph, RenderResource l
 		brdfRendered = true;
 	}
 
-	auto& irradiancePass = graph.AddPass("IBL Irradiance Pass", ExecutionQueue::Compute);
-	irradiancePass.Read(luminanceTexture, ResourceBind::SRV);
-	irradiancePass.Write(irradianceTag, TextureView{}
-		.UAV("array", 0));
-	irradiancePass.Bind([&, luminanceTexture, irradianceTag](CommandList& list, RenderPassResources& resources)
+	const auto& slice = update.slice;
+
+	// The set completed this frame is lit with as well, importing it again would hide the dependency on the convolutions.
+	const auto ImportWriteSet = [&](const std::array<TextureHandle, 2>& textures, RenderResource readTag)
 	{
-		list.BindPipeline(irradiancePrecomputeLayout);
+		return update.writeSet == update.readSet ? readTag : graph.Import(textures[update.writeSet]);
+	};
 
-		struct BindData
-		{
-			uint32_t luminanceTexture;
-			uint32_t irradianceTexture;
-			uint32_t brdfTexture;
-			uint32_t cubeFace;
-			uint128_t prefilterMips[prefilterLevels];
-		} bindData;
-		
-		bindData.luminanceTexture = resources.Get(luminanceTexture);
-		bindData.irradianceTexture = resources.Get(irradianceTag, "array");
-		list.BindConstants("bindData", bindData);
-
-		list.Dispatch(irradianceTextureSize / 8, irradianceTextureSize / 8, 6);
-	});
-
-	TextureView prefilterView{};
-	std::vector<std::string> prefilterViewNames;
-	prefilterViewNames.resize(prefilterLevels);
-	for (int i = 0; i < prefilterLevels; ++i)
+	if (slice.irradianceFaceCount > 0)
 	{
-		prefilterViewNames[i] = std::to_string(i);
-		prefilterView.UAV(prefilterViewNames[i], i);
+		const auto irradianceWriteTag = ImportWriteSet(irradianceTextures, irradianceTag);
+
+		auto& irradiancePass = graph.AddPass("IBL Irradiance Pass", ExecutionQueue::Compute);
+		irradiancePass.Read(luminanceTexture, ResourceBind::SRV);
+		irradiancePass.Write(irradianceWriteTag, TextureView{}
+			.UAV("array", 0));
+		irradiancePass.Bind([&, luminanceTexture, irradianceWriteTag, slice](CommandList& list, RenderPassResources& resources)
+		{
+			list.BindPipeline(irradiancePrecomputeLayout);
+
+			BindData bindData;
+			bindData.luminanceTexture = resources.Get(luminanceTexture);
+			bindData.irradianceTexture = resources.Get(irradianceWriteTag, "array");
+			bindData.cubeFace = slice.irradianceFaceBegin;
+			list.BindConstants("bindData", bindData);
+
+			list.Dispatch(irradianceTextureSize / 8, irradianceTextureSize / 8, slice.irradianceFaceCount);
+		});
 	}
 
-	auto& prefilterPass = graph.AddPass("IBL Prefilter Pass", ExecutionQueue::Compute);
-	prefilterPass.Read(luminanceTexture, ResourceBind::SRV);
-	prefilterPass.Write(prefilterTag, prefilterView);
-	prefilterPass.Bind([&, luminanceTexture, prefilterTag, prefilterViewNames](CommandList& list, RenderPassResources& resources)
+	if (slice.prefilterFaceCount > 0 && slice.prefilterLevelCount > 0)
 	{
-		list.BindPipeline(prefilterPrecomputeLayout);
-			
-		struct BindData
-		{
-			uint32_t luminanceTexture;
-			uint32_t irradianceTexture;
-			uint32_t brdfTexture;
-			uint32_t cubeFace;
-			uint128_t prefilterMips[prefilterLevels];
-		} bindData;
-		
-		bindData.luminanceTexture = resources.Get(luminanceTexture);
-		bindData.cubeFace = slice;
-		slice = (slice + 1) % 6;
-		for (int i = 0; i < prefilterLevels; ++i)
+		const auto prefilterWriteTag = ImportWriteSet(prefilterTextures, prefilterTag);
+
+		TextureView prefilterView{};
+		std::vector<std::string> prefilterViewNames;
+		for (uint32_t i = slice.prefilterLevelBegin; i < slice.prefilterLevelBegin + slice.prefilterLevelCount; ++i)
 		{
-			bindData.prefilterMips[i] = resources.Get(prefilterTag, prefilterViewNames[i]);
+			prefilterViewNames.emplace_back(std::to_string(i));
+			prefilterView.UAV(prefilterViewNames.back(), i);
 		}
 
-		list.BindConstants("bindData", bindData);
+		auto& prefilterPass = graph.AddPass("IBL Prefilter Pass", ExecutionQueue::Compute);
+		prefilterPass.Read(luminanceTexture, ResourceBind::SRV);
+		prefilterPass.Write(prefilterWriteTag, prefilterView);
+		prefilterPass.Bind([&, luminanceTexture, prefilterWriteTag, prefilterViewNames, slice](CommandList& list, RenderPassResources& resources)
+		{
+			list.BindPipeline(prefilterPrecomputeLayout);
 
-		list.Dispatch(prefilterTextureSize / 8, prefilterTextureSize / 8, 6);
-	});
+			// One dispatch per level, sized to the level.
+			for (uint32_t i = 0; i < slice.prefilterLevelCount; ++i)
+			{
+				const auto level = slice.prefilterLevelBegin + i;
+				const auto levelSize = std::max(prefilterTextureSize >> level, 1u);
+
+				BindData bindData;
+				bindData.luminanceTexture = resources.Get(luminanceTexture);
+				bindData.cubeFace = slice.prefilterFaceBegin;
+				bindData.prefilterTexture = resources.Get(prefilterWriteTag, prefilterViewNames[i]);
+				bindData.prefilterLevel = level;
+				list.BindConstants("bindData", bindData);
+
+				list.Dispatch((levelSize + 7) / 8, (levelSize + 7) / 8, slice.prefilterFaceCount);
+			}
+		});
+	}
 
 	return { irradianceTag, prefilterTag, brdfTag };
 }
\ No newline at end of file
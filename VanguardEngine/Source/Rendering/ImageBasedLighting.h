@@ -6,6 +6,9 @@
 #include <Rendering/ResourceHandle.h>
 #include <Rendering/RenderPipeline.h>
 #include <Rendering/RenderGraphResource.h>
+#include <Rendering/EnvironmentSchedule.h>
+
+#include <array>
 
 class RenderDevice;
 class RenderGraph;
@@ -20,7 +23,7 @@ struct IBLResources
 
 class ImageBasedLighting
 {
-private:
+public:
 	static constexpr uint32_t irradianceTextureSize = 32;
 	static constexpr uint32_t prefilterTextureSize = 128;  // Resolution of base mip.
 	static constexpr uint32_t prefilterLevels = 6;  // Roughness bins, must be <= lg(prefilterTextureSize).
@@ -30,9 +33,9 @@ private:
 	static_assert(prefilterTextureSize % 8 == 0, "prefilterTextureSize must be evenly divisible by 8.");
 	static_assert(brdfTextureSize % 8 == 0, "brdfTextureSize must be evenly divisible by 8.");
 
-public:
-	TextureHandle irradianceTexture;
-	TextureHandle prefilterTexture;
+	// Double buffered, see EnvironmentSchedule.
+	std::array<TextureHandle, 2> irradianceTextures;
+	std::array<TextureHandle, 2> prefilterTextures;
 	TextureHandle brdfTexture;
 
 private:
@@ -43,12 +46,11 @@ private:
 	RenderDevice* device = nullptr;
 	bool brdfRendered = false;
 
-	uint32_t slice = 0;
-
 public:
 	~ImageBasedLighting();
 	void Initialize(RenderDevice* inDevice);
-	IBLResources UpdateLuts(RenderGraph& graph, RenderResource luminanceTexture, RenderResource cameraBuffer);
+	// Convolves the luminance map into the write set for the update's slice, the returned resources are the read set.
+	IBLResources UpdateLuts(RenderGraph& graph, RenderResource luminanceTexture, const EnvironmentUpdate& update);
 
 	uint32_t GetPrefilterLevels() const { return prefilterLevels; }
 };
\ No newline at end of file
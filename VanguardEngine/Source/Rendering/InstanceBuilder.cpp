@@ -0,0 +1,238 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/InstanceBuilder.h>
+#include <Rendering/RenderComponents.h>
+#include <Rendering/MeshBounds.h>
+#include <Core/CoreComponents.h>
+#include <Utility/Math.h>
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <chrono>
+#include <tuple>
+
+namespace InstanceBuilder
+{
+	// Enough partitions to balance uneven subset counts without making the scheduling overhead noticeable.
+	constexpr size_t partitionsPerThread = 4;
+	constexpr size_t transformBatchSize = 4;
+
+	void BuildSubsets(const MeshComponent& mesh, const XMMATRIX& worldMatrix, size_t slot, InstanceBuildOutput& output)
+	{
+		for (const auto& subset : mesh.subsets)
+		{
+			auto& renderable = output.renderables[slot];
+			renderable.positionOffset = (uint32_t)(mesh.globalOffset.position + subset.localOffset.position);
+			renderable.extraOffset = (uint32_t)(mesh.globalOffset.extra + subset.localOffset.extra);
+			renderable.indexOffset = (uint32_t)((mesh.globalOffset.index + subset.localOffset.index) / sizeof(uint32_t));
+			renderable.indexCount = (uint32_t)subset.indices;
+			renderable.materialIndex = (uint32_t)subset.materialIndex;
+			renderable.objectId = (uint32_t)slot;
+			renderable.lodCount = (uint32_t)subset.lodCount;
+			for (size_t i = 0; i < subset.lodCount; ++i)
+			{
+				renderable.lods[i] = MeshLod{ renderable.indexOffset + subset.lods[i].indexOffset, subset.lods[i].indexCount, subset.lods[i].error };
+			}
+
+			auto& object = output.objects[slot];
+			object.worldMatrix = worldMatrix;
+			object.vertexMetadata = mesh.metadata;
+			object.materialIndex = renderable.materialIndex;
+			MeshBounds::TransformSphere(subset.bounds, worldMatrix, object.boundingSphereCenter, object.boundingSphereRadius);
+			object.meshletOffset = (uint32_t)(mesh.globalOffset.meshlet + subset.localOffset.meshlet);
+			object.meshletCount = (uint32_t)subset.meshlets;
+
+			// Apply offsets. Every channel is relative to the extras buffer, except for the position channel.
+			const auto extraOffsets = XMVectorReplicateInt(renderable.extraOffset);
+			const auto firstOffsets = XMVectorSetIntX(extraOffsets, renderable.positionOffset);
+			auto* channelOffsets = object.vertexMetadata.channelOffsets;
+			XMStoreInt4(channelOffsets[0].values, XMVectorAddInt(XMLoadInt4(channelOffsets[0].values), firstOffsets));
+			for (int i = 1; i < vertexChannels / 4 + 1; ++i)
+			{
+				XMStoreInt4(channelOffsets[i].values, XMVectorAddInt(XMLoadInt4(channelOffsets[i].values), extraOffsets));
+			}
+
+			++slot;
+		}
+	}
+
+	void Build(const entt::registry& registry, InstanceBuildOutput& output)
+	{
+		VGScopedCPUStat("Build Instances");
+
+		const auto instanceView = registry.view<const TransformComponent, const MeshComponent>();
+
+		std::vector<const TransformComponent*> transforms;
+		std::vector<const MeshComponent*> meshes;
+		std::vector<const WorldTransformComponent*> worldTransforms;  // Only entities in a hierarchy, composed here otherwise.
+		std::vector<size_t> slots;  // Exclusive prefix sum of subset counts, one extra entry for the total.
+		transforms.reserve(instanceView.size_hint());
+		meshes.reserve(instanceView.size_hint());
+		worldTransforms.reserve(instanceView.size_hint());
+		slots.reserve(instanceView.size_hint() + 1);
+
+		{
+			VGScopedCPUStat("Assign Slots");
+
+			size_t subsetCount = 0;
+			instanceView.each([&](auto entity, const auto& transform, const auto& mesh)
+			{
+				transforms.emplace_back(&transform);
+				meshes.emplace_back(&mesh);
+				worldTransforms.emplace_back(registry.try_get<WorldTransformComponent>(entity));
+				slots.emplace_back(subsetCount);
+				subsetCount += mesh.subsets.size();
+			});
+			slots.emplace_back(subsetCount);
+		}
+
+		const auto entityCount = transforms.size();
+
+		output.renderables.resize(slots.back());
+		output.objects.resize(slots.back());
+
+		const auto partitionCount = std::max<size_t>(std::thread::hardware_concurrency(), 1) * partitionsPerThread;
+		std::vector<size_t> partitions(partitionCount);
+		std::iota(partitions.begin(), partitions.end(), 0);
+
+		std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](auto partition)
+		{
+			// Batch aligned ranges so that only the final partition has a partial batch.
+			const auto batchCount = (entityCount + transformBatchSize - 1) / transformBatchSize;
+			const auto begin = std::min(batchCount * partition / partitionCount * transformBatchSize, entityCount);
+			const auto end = std::min(batchCount * (partition + 1) / partitionCount * transformBatchSize, entityCount);
+
+			const TransformComponent identity{};
+
+			for (size_t i = begin; i < end; i += transformBatchSize)
+			{
+				const TransformComponent* batch[transformBatchSize];
+				for (size_t j = 0; j < transformBatchSize; ++j)
+				{
+					batch[j] = i + j < end ? transforms[i + j] : &identity;  // Pad the tail with throwaway lanes.
+				}
+
+				const XMMATRIX scales{ XMLoadFloat3(&batch[0]->scale), XMLoadFloat3(&batch[1]->scale), XMLoadFloat3(&batch[2]->scale), XMLoadFloat3(&batch[3]->scale) };
+				const XMMATRIX rotations{ XMLoadFloat3(&batch[0]->rotation), XMLoadFloat3(&batch[1]->rotation), XMLoadFloat3(&batch[2]->rotation), XMLoadFloat3(&batch[3]->rotation) };
+				const XMMATRIX translations{ XMLoadFloat3(&batch[0]->translation), XMLoadFloat3(&batch[1]->translation), XMLoadFloat3(&batch[2]->translation), XMLoadFloat3(&batch[3]->translation) };
+
+				XMMATRIX worldMatrices[transformBatchSize];
+				ComposeTransformMatricesX4(scales, rotations, translations, worldMatrices);
+
+				for (size_t j = 0; j < transformBatchSize && i + j < end; ++j)
+				{
+					const auto* worldTransform = worldTransforms[i + j];
+					BuildSubsets(*meshes[i + j], worldTransform ? worldTransform->worldMatrix : worldMatrices[j], slots[i + j], output);
+				}
+			}
+		});
+	}
+
+	void Batch(const std::vector<MeshRenderable>& renderables, InstanceBatchOutput& output)
+	{
+		VGScopedCPUStat("Batch Instances");
+
+		const auto BatchKey = [](const MeshRenderable& renderable)
+		{
+			return std::tie(renderable.indexOffset, renderable.indexCount, renderable.materialIndex);
+		};
+
+		// Sorting by key then object keeps the batch and instance order stable across calls.
+		std::vector<uint32_t> order(renderables.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(std::execution::par, order.begin(), order.end(), [&](auto left, auto right)
+		{
+			const auto leftKey = BatchKey(renderables[left]);
+			const auto rightKey = BatchKey(renderables[right]);
+			return leftKey < rightKey || (leftKey == rightKey && left < right);
+		});
+
+		output.batches.clear();
+		output.instances.resize(renderables.size());
+
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			const auto& renderable = renderables[order[i]];
+
+			if (output.batches.empty() || BatchKey(renderables[order[output.batches.back().firstInstance]]) != BatchKey(renderable))
+			{
+				auto& batch = output.batches.emplace_back(InstanceBatch{
+					.indexOffset = renderable.indexOffset,
+					.indexCount = renderable.indexCount,
+					.materialIndex = renderable.materialIndex,
+					.firstInstance = (uint32_t)i,
+					.instanceCount = 0,
+					.lodCount = renderable.lodCount
+				});
+				std::copy(renderable.lods, renderable.lods + renderable.lodCount, batch.lods);
+			}
+
+			++output.batches.back().instanceCount;
+			output.instances[i] = BatchedInstance{ renderable.objectId, (uint32_t)(output.batches.size() - 1) };
+		}
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Instance Build Benchmark");
+
+		constexpr size_t instanceCounts[] = { 10'000, 100'000, 1'000'000 };
+		constexpr int iterations = 5;
+
+		for (const auto instanceCount : instanceCounts)
+		{
+			entt::registry registry;
+
+			// A handful of distinct meshes, repeated like props in a scene.
+			constexpr size_t meshCount = 64;
+			std::vector<MeshComponent> meshes(meshCount);
+			for (size_t i = 0; i < meshCount; ++i)
+			{
+				auto& mesh = meshes[i];
+				mesh.globalOffset.index = i * 36 * sizeof(uint32_t);
+				mesh.subsets.emplace_back(PrimitiveOffset{}, 36, i % 4, MeshBounds::FromRadius(1.f));
+				mesh.metadata.activeChannels = 0b11;
+				mesh.metadata.channelStrides[0][0] = sizeof(XMFLOAT3);
+				mesh.metadata.channelStrides[0][1] = sizeof(XMFLOAT3);
+			}
+
+			for (size_t i = 0; i < instanceCount; ++i)
+			{
+				const auto entity = registry.create();
+				const auto value = static_cast<float>(i);
+				registry.emplace<TransformComponent>(entity, TransformComponent{
+					.scale = { 1.f + value * 0.001f, 1.f, 1.f },
+					.rotation = { value * 0.1f, value * 0.2f, value * 0.3f },
+					.translation = { value, -value, value * 0.5f }
+				});
+				registry.emplace<MeshComponent>(entity, meshes[i % meshCount]);
+			}
+
+			InstanceBuildOutput output;
+			Build(registry, output);  // Warm up, allocates the output storage.
+
+			const auto begin = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; ++i)
+			{
+				Build(registry, output);
+			}
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			const auto milliseconds = std::chrono::duration<double, std::milli>(end - begin).count() / iterations;
+			VGLog(logRendering, "Instance build benchmark: {} instances in {:.3f} ms, {:.1f} instances/ms.", instanceCount, milliseconds, instanceCount / milliseconds);
+
+			InstanceBatchOutput batchOutput;
+			const auto batchBegin = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; ++i)
+			{
+				Batch(output.renderables, batchOutput);
+			}
+			const auto batchEnd = std::chrono::high_resolution_clock::now();
+
+			const auto batchMilliseconds = std::chrono::duration<double, std::milli>(batchEnd - batchBegin).count() / iterations;
+			VGLog(logRendering, "Instance batch benchmark: {} draws reduced to {} in {:.3f} ms.", output.renderables.size(), batchOutput.batches.size(), batchMilliseconds);
+		}
+	}
+}
\ No newline at end of file
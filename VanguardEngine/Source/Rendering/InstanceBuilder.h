@@ -0,0 +1,69 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+#include <Rendering/RenderComponents.h>
+
+#include <entt/entt.hpp>
+
+#include <vector>
+
+struct MeshRenderable
+{
+	uint32_t positionOffset;
+	uint32_t extraOffset;
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	uint32_t materialIndex;
+	uint32_t objectId;
+	uint32_t lodCount;  // Zero if the subset only has full detail.
+	MeshLod lods[maxMeshLods];  // Index offsets are absolute.
+};
+
+// One entry per mesh subset, renderables[i] describes the draw for objects[i].
+struct InstanceBuildOutput
+{
+	std::vector<MeshRenderable> renderables;
+	std::vector<ObjectData> objects;
+};
+
+// Renderables sharing a mesh subset and material, drawn with a single instanced draw.
+struct InstanceBatch
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	uint32_t materialIndex;
+	uint32_t firstInstance;  // Offset into the batch's instances, also the draw's batchId.
+	uint32_t instanceCount;
+	uint32_t lodCount;
+	MeshLod lods[maxMeshLods];
+};
+
+// Mirrors the culling shader's input, one per object.
+struct BatchedInstance
+{
+	uint32_t objectId;
+	uint32_t batchIndex;
+};
+
+// Instances are sorted by batch, so each batch owns a contiguous range.
+struct InstanceBatchOutput
+{
+	std::vector<InstanceBatch> batches;
+	std::vector<BatchedInstance> instances;
+};
+
+namespace InstanceBuilder
+{
+	// Builds renderables and per-object shader data for every entity with a transform and mesh. Entities are partitioned
+	// across worker threads, each subset writes into a slot assigned up front. Output storage is reused between calls.
+	void Build(const entt::registry& registry, InstanceBuildOutput& output);
+
+	// Groups renderables by mesh subset and material. Pure function of the renderables, batch order is deterministic.
+	void Batch(const std::vector<MeshRenderable>& renderables, InstanceBatchOutput& output);
+
+	// CPU-only throughput measurement of Build() and Batch() over synthetic registries, results and draw count reduction are logged.
+	void Benchmark();
+}
\ No newline at end of file
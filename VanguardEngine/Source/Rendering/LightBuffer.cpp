@@ -0,0 +1,388 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/LightBuffer.h>
+#include <Rendering/Device.h>
+#include <Rendering/ClusterReference.h>
+#include <Utility/Random.h>
+
+#include <algorithm>
+#include <span>
+#include <chrono>
+#include <cstring>
+
+Light LightBuffer::CreateLight(const TransformComponent& transform, const LightComponent& light)
+{
+	const auto direction = XMVector3Rotate(XMVectorSet(1.f, 0.f, 0.f, 0.f), XMQuaternionRotationRollPitchYaw(transform.rotation.x, transform.rotation.y, -transform.rotation.z));
+	XMFLOAT3 directionUnpacked;
+	XMStoreFloat3(&directionUnpacked, direction);
+
+	return Light{
+		.position = transform.translation,
+		.type = static_cast<uint32_t>(light.type),
+		.color = light.color,
+		.luminance = 1.f,  // #TEMP
+		.direction = directionUnpacked
+	};
+}
+
+void LightBuffer::RemoveSlot(uint32_t slot)
+{
+	const auto last = static_cast<uint32_t>(lights.size() - 1);
+
+	// A recycled entity index may already point to a newer slot.
+	auto& removedSlot = entitySlots[entt::entt_traits<entt::entity>::to_entity(entities[slot])];
+	if (removedSlot == slot)
+	{
+		removedSlot = invalidSlot;
+	}
+
+	if (slot != last)
+	{
+		entities[slot] = entities[last];
+		transforms[slot] = transforms[last];
+		components[slot] = components[last];
+		lights[slot] = lights[last];
+		lastSeen[slot] = lastSeen[last];
+		entitySlots[entt::entt_traits<entt::entity>::to_entity(entities[slot])] = slot;
+		dirtySlots.emplace_back(slot);
+	}
+
+	slotsChanged = true;
+
+	entities.pop_back();
+	transforms.pop_back();
+	components.pop_back();
+	lights.pop_back();
+	lastSeen.pop_back();
+}
+
+size_t LightBuffer::Collect(const entt::registry& registry)
+{
+	VGScopedCPUStat("Collect Lights");
+
+	++updateIndex;
+	dirtySlots.clear();
+	uploadRuns.clear();
+	slotsChanged = false;
+
+	registry.view<const TransformComponent, const LightComponent>().each([&](auto entity, const auto& transform, const auto& light)
+	{
+		const auto index = entt::entt_traits<entt::entity>::to_entity(entity);
+		if (index >= entitySlots.size())
+		{
+			entitySlots.resize(index + 1, invalidSlot);
+		}
+
+		auto slot = entitySlots[index];
+		if (slot == invalidSlot || entities[slot] != entity)
+		{
+			slot = static_cast<uint32_t>(lights.size());
+			entitySlots[index] = slot;
+			entities.emplace_back(entity);
+			transforms.emplace_back(transform);
+			components.emplace_back(light);
+			lights.emplace_back(CreateLight(transform, light));
+			lastSeen.emplace_back(updateIndex);
+			dirtySlots.emplace_back(slot);
+			slotsChanged = true;
+
+			return;
+		}
+
+		lastSeen[slot] = updateIndex;
+
+		if (std::memcmp(&transform, &transforms[slot], sizeof(TransformComponent)) != 0 || std::memcmp(&light, &components[slot], sizeof(LightComponent)) != 0)
+		{
+			slotsChanged = slotsChanged || light.type != components[slot].type;
+			transforms[slot] = transform;
+			components[slot] = light;
+			lights[slot] = CreateLight(transform, light);
+			dirtySlots.emplace_back(slot);
+		}
+	});
+
+	// Walk backwards so that the light moved into a freed slot has already been visited.
+	for (auto slot = static_cast<uint32_t>(lights.size()); slot-- > 0;)
+	{
+		if (lastSeen[slot] != updateIndex)
+		{
+			RemoveSlot(slot);
+		}
+	}
+
+	std::sort(dirtySlots.begin(), dirtySlots.end());
+	dirtySlots.erase(std::unique(dirtySlots.begin(), dirtySlots.end()), dirtySlots.end());
+
+	updatedLights = 0;
+
+	for (const auto slot : dirtySlots)
+	{
+		if (slot >= lights.size())
+		{
+			break;  // Freed by a removal at the end.
+		}
+
+		++updatedLights;
+
+		if (!uploadRuns.empty() && slot <= uploadRuns.back().second + mergeDistance)
+		{
+			uploadRuns.back().second = slot + 1;
+		}
+
+		else
+		{
+			uploadRuns.emplace_back(slot, slot + 1);
+		}
+	}
+
+	return lights.size();
+}
+
+bool LightBuffer::UpdateHierarchy()
+{
+	// Moves keep the order, so only the nodes of changed lights are refit while they stay tight.
+	const auto refit = hierarchyValid && !slotsChanged && LightHierarchy::Refit(lights, ClusterReference::pointLightRadius, dirtySlots, hierarchy, refitNodes);
+	hierarchyValid = true;
+
+	if (refit)
+	{
+		return false;
+	}
+
+	refitNodes.clear();
+	LightHierarchy::Build(lights, ClusterReference::pointLightRadius, hierarchy);
+
+	return true;
+}
+
+void LightBuffer::CreateBuffers()
+{
+	buffer = device->GetResourceManager().Create(BufferDescription{
+		.updateRate = ResourceFrequency::Static,
+		.bindFlags = BindFlag::ShaderResource,
+		.accessFlags = AccessFlag::CPUWrite,
+		.size = capacity,
+		.stride = sizeof(Light)
+	}, VGText("Light buffer"));
+
+	orderBuffer = device->GetResourceManager().Create(BufferDescription{
+		.updateRate = ResourceFrequency::Static,
+		.bindFlags = BindFlag::ShaderResource,
+		.accessFlags = AccessFlag::CPUWrite,
+		.size = capacity,
+		.stride = sizeof(uint32_t)
+	}, VGText("Light order buffer"));
+
+	nodeBuffer = device->GetResourceManager().Create(BufferDescription{
+		.updateRate = ResourceFrequency::Static,
+		.bindFlags = BindFlag::ShaderResource,
+		.accessFlags = AccessFlag::CPUWrite,
+		.size = NodeCapacity(capacity),
+		.stride = sizeof(LightNode)
+	}, VGText("Light node buffer"));
+}
+
+void LightBuffer::Initialize(RenderDevice* inDevice)
+{
+	device = inDevice;
+	capacity = minimumCapacity;
+
+	CvarCreate("lightHierarchy", "Groups Morton sorted lights into bounded nodes so that light binning can reject whole groups per froxel, 0=disabled, 1=enabled", 1);
+
+	CreateBuffers();
+}
+
+void LightBuffer::Update(const entt::registry& registry)
+{
+	VGScopedCPUStat("Update Light Buffer");
+
+	const auto requiredCapacity = Collect(registry);
+
+	if (requiredCapacity > capacity)
+	{
+		// The old buffers may still be in use by frames in flight.
+		device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), buffer);
+		device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), orderBuffer);
+		device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), nodeBuffer);
+
+		capacity = std::max(requiredCapacity, capacity * 2);
+		CreateBuffers();
+
+		uploadRuns.clear();
+		uploadRuns.emplace_back(0, static_cast<uint32_t>(lights.size()));
+		hierarchyValid = false;
+	}
+
+	uploadedBytes = 0;
+
+	for (const auto [begin, end] : uploadRuns)
+	{
+		device->GetResourceManager().Write(buffer, std::span<const Light>{ lights.data() + begin, end - begin }, begin * sizeof(Light));
+		uploadedBytes += (end - begin) * sizeof(Light);
+	}
+
+	if (*CvarGet("lightHierarchy", int) <= 0)
+	{
+		hierarchyValid = false;
+		return;
+	}
+
+	if (UpdateHierarchy())
+	{
+		if (!lights.empty())
+		{
+			device->GetResourceManager().Write(orderBuffer, hierarchy.order);
+			device->GetResourceManager().Write(nodeBuffer, hierarchy.nodes);
+			uploadedBytes += hierarchy.order.size() * sizeof(uint32_t) + hierarchy.nodes.size() * sizeof(LightNode);
+		}
+
+		return;
+	}
+
+	// Refit nodes, the order is unchanged. Adjacent nodes are uploaded together.
+	for (size_t begin = 0; begin < refitNodes.size();)
+	{
+		auto end = begin + 1;
+		while (end < refitNodes.size() && refitNodes[end] == refitNodes[end - 1] + 1)
+		{
+			++end;
+		}
+
+		const auto first = refitNodes[begin];
+		device->GetResourceManager().Write(nodeBuffer, std::span<const LightNode>{ hierarchy.nodes.data() + first, end - begin }, first * sizeof(LightNode));
+		uploadedBytes += (end - begin) * sizeof(LightNode);
+
+		begin = end;
+	}
+}
+
+void LightBuffer::Benchmark()
+{
+	VGScopedCPUStat("Light Buffer Benchmark");
+
+	constexpr size_t lightCount = 20'000;
+	constexpr int iterations = 20;
+
+	Seed({ 4321 });
+
+	entt::registry registry;
+	std::vector<entt::entity> entities;
+
+	const auto CreateLightEntity = [&registry]()
+	{
+		const auto entity = registry.create();
+		registry.emplace<TransformComponent>(entity, TransformComponent{
+			.scale = { 1.f, 1.f, 1.f },
+			.rotation = { 0.f, (float)Rand(-1.5, 1.5), (float)Rand(-3.1, 3.1) },
+			.translation = { (float)Rand(-500.0, 500.0), (float)Rand(-500.0, 500.0), (float)Rand(0.0, 100.0) }
+		});
+		registry.emplace<LightComponent>(entity, LightComponent{ .type = LightType::Point, .color = { 1.f, 1.f, 1.f } });
+
+		return entity;
+	};
+
+	for (size_t i = 0; i < lightCount; ++i)
+	{
+		entities.emplace_back(CreateLightEntity());
+	}
+
+	LightBuffer lightBuffer;  // CPU half only, no device.
+	lightBuffer.Collect(registry);
+
+	const auto Time = [&](bool withHierarchy, auto&& mutate)
+	{
+		double total = 0.0;
+		size_t updated = 0;
+		size_t runs = 0;
+		size_t refitNodes = 0;
+		int rebuilds = 0;
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			mutate(i);
+
+			const auto begin = std::chrono::high_resolution_clock::now();
+			lightBuffer.Collect(registry);
+			if (withHierarchy)
+			{
+				rebuilds += lightBuffer.UpdateHierarchy() ? 1 : 0;
+				refitNodes += lightBuffer.refitNodes.size();
+			}
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			total += std::chrono::duration<double, std::milli>(end - begin).count();
+			updated += lightBuffer.updatedLights;
+			runs += lightBuffer.uploadRuns.size();
+		}
+
+		VGLog(logRendering, "  {:.3f} ms, {} lights rewritten in {} uploads on average.", total / iterations, updated / iterations, runs / iterations);
+
+		if (withHierarchy)
+		{
+			VGLog(logRendering, "  {} of {} nodes refit on average, the hierarchy was built {} of {} times.", refitNodes / iterations, lightBuffer.hierarchy.nodes.size(),
+				rebuilds, iterations);
+		}
+	};
+
+	VGLog(logRendering, "Light buffer benchmark, {} lights:", lightCount);
+
+	const auto MoveLights = [&](int iteration)
+	{
+		for (size_t i = iteration; i < entities.size(); i += 100)
+			registry.get<TransformComponent>(entities[i]).translation.z += 1.f;
+	};
+
+	VGLog(logRendering, "Static scene:");
+	Time(false, [](int) {});
+
+	VGLog(logRendering, "1% of lights moved:");
+	Time(false, MoveLights);
+
+	VGLog(logRendering, "1% of lights replaced:");
+	Time(false, [&](int iteration)
+	{
+		for (size_t i = iteration; i < entities.size(); i += 100)
+		{
+			registry.destroy(entities[i]);
+			entities[i] = CreateLightEntity();
+		}
+	});
+
+	VGLog(logRendering, "Every light moved:");
+	Time(false, [&](int)
+	{
+		for (const auto entity : entities)
+			registry.get<TransformComponent>(entity).rotation.z += 0.01f;
+	});
+
+	// Moves refit the nodes of the moved lights, instead of building the whole hierarchy again.
+	lightBuffer.UpdateHierarchy();
+
+	VGLog(logRendering, "1% of lights moved, with the light hierarchy:");
+	Time(true, MoveLights);
+
+	LightHierarchy::BuildOutput hierarchy;
+	const auto buildBegin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		LightHierarchy::Build(lightBuffer.lights, ClusterReference::pointLightRadius, hierarchy);
+	}
+	const auto buildEnd = std::chrono::high_resolution_clock::now();
+
+	VGLog(logRendering, "Full hierarchy build: {:.3f} ms, {} nodes.", std::chrono::duration<double, std::milli>(buildEnd - buildBegin).count() / iterations, hierarchy.nodes.size());
+
+	// The previous approach, rebuilding every light each frame.
+	std::vector<Light> lights;
+	const auto rebuildBegin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		lights.clear();
+		registry.view<const TransformComponent, const LightComponent>().each([&](auto entity, const auto& transform, const auto& light)
+		{
+			lights.emplace_back(CreateLight(transform, light));
+		});
+	}
+	const auto rebuildEnd = std::chrono::high_resolution_clock::now();
+
+	VGLog(logRendering, "Full rebuild: {:.3f} ms, {} lights rewritten.", std::chrono::duration<double, std::milli>(rebuildEnd - rebuildBegin).count() / iterations, lights.size());
+}
\ No newline at end of file
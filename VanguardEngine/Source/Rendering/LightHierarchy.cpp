@@ -0,0 +1,642 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/LightHierarchy.h>
+#include <Rendering/ClusterReference.h>
+#include <Rendering/RenderComponents.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace LightHierarchy
+{
+	namespace
+	{
+		constexpr size_t partitionsPerThread = 2;
+		constexpr size_t minimumPartitionSize = 4096;  // Smaller partitions spend more time scanning histograms than scattering.
+		constexpr uint32_t digitBits = 8;
+		constexpr uint32_t digitCount = 1 << digitBits;
+
+		// Spreads the low 10 bits so that two zero bits separate each of them.
+		uint32_t SpreadBits(uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+
+			return value;
+		}
+
+		bool IsPointLight(const Light& light)
+		{
+			return light.type == static_cast<uint32_t>(LightType::Point);
+		}
+
+		// Bounding sphere of a point node's lights, extended by the light radius.
+		void FitNode(std::span<const Light> lights, float lightRadius, const BuildOutput& hierarchy, LightNode& node)
+		{
+			const auto begin = node.firstLight;
+			const auto end = node.firstLight + node.lightCount;
+
+			auto nodeMin = XMVectorReplicate(std::numeric_limits<float>::max());
+			auto nodeMax = XMVectorReplicate(-std::numeric_limits<float>::max());
+			for (auto i = begin; i < end; ++i)
+			{
+				const auto position = XMLoadFloat3(&lights[hierarchy.order[i]].position);
+				nodeMin = XMVectorMin(nodeMin, position);
+				nodeMax = XMVectorMax(nodeMax, position);
+			}
+
+			const auto center = XMVectorScale(XMVectorAdd(nodeMin, nodeMax), 0.5f);
+			auto radius = 0.f;
+			for (auto i = begin; i < end; ++i)
+			{
+				radius = std::max(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&lights[hierarchy.order[i]].position), center))));
+			}
+
+			XMStoreFloat3(&node.center, center);
+			node.radius = radius + lightRadius;
+		}
+
+		struct BinningStats
+		{
+			uint64_t nodeTests = 0;
+			uint64_t acceptedNodes = 0;
+			uint64_t lightTests = 0;
+			uint64_t binnedLights = 0;
+		};
+
+		// Mirrors BinFroxelLights in ClusterLightBinning.hlsl. Light and node centers are in view space.
+		void BinHierarchical(const ClusterReference::FroxelBounds& box, std::span<const XMFLOAT3> viewLights, std::span<const XMFLOAT3> viewNodes,
+			const BuildOutput& hierarchy, std::span<const Light> lights, float lightRadius, std::vector<uint32_t>& binned, BinningStats& stats)
+		{
+			for (size_t node = 0; node < hierarchy.nodes.size(); ++node)
+			{
+				const auto& lightNode = hierarchy.nodes[node];
+
+				++stats.nodeTests;
+				if (!ClusterReference::SphereBoxIntersection(viewNodes[node], lightNode.radius, box))
+				{
+					continue;
+				}
+
+				++stats.acceptedNodes;
+				for (auto i = lightNode.firstLight; i < lightNode.firstLight + lightNode.lightCount; ++i)
+				{
+					const auto light = hierarchy.order[i];
+
+					++stats.lightTests;
+					if (!IsPointLight(lights[light]) || ClusterReference::SphereBoxIntersection(viewLights[light], lightRadius, box))
+					{
+						++stats.binnedLights;
+						binned.emplace_back(light);
+					}
+				}
+			}
+		}
+
+		void TransformToView(const Camera& camera, std::span<const Light> lights, const BuildOutput& hierarchy, std::vector<XMFLOAT3>& viewLights, std::vector<XMFLOAT3>& viewNodes)
+		{
+			viewLights.resize(lights.size());
+			for (size_t i = 0; i < lights.size(); ++i)
+			{
+				XMStoreFloat3(&viewLights[i], XMVector3Transform(XMLoadFloat3(&lights[i].position), camera.view));
+			}
+
+			viewNodes.resize(hierarchy.nodes.size());
+			for (size_t i = 0; i < hierarchy.nodes.size(); ++i)
+			{
+				XMStoreFloat3(&viewNodes[i], XMVector3Transform(XMLoadFloat3(&hierarchy.nodes[i].center), camera.view));
+			}
+		}
+	}
+
+	uint32_t MortonCode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+	}
+
+	void RadixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+	{
+		VGScopedCPUStat("Light Radix Sort");
+
+		VGAssert(keys.size() == values.size(), "Every key needs a value.");
+
+		const auto count = keys.size();
+		const auto partitionCount = std::clamp<size_t>(count / minimumPartitionSize, 1, std::max(std::thread::hardware_concurrency(), 1u) * partitionsPerThread);
+		const auto partitionSize = (count + partitionCount - 1) / partitionCount;
+
+		std::vector<size_t> partitions(partitionCount);
+		std::iota(partitions.begin(), partitions.end(), 0);
+
+		std::vector<std::array<uint32_t, digitCount>> histograms(partitionCount);
+		std::vector<uint32_t> scratchKeys(count);
+		std::vector<uint32_t> scratchValues(count);
+
+		for (uint32_t shift = 0; shift < 32; shift += digitBits)
+		{
+			std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](auto partition)
+			{
+				auto& histogram = histograms[partition];
+				histogram.fill(0);
+
+				const auto end = std::min(count, (partition + 1) * partitionSize);
+				for (auto i = partition * partitionSize; i < end; ++i)
+				{
+					++histogram[(keys[i] >> shift) & (digitCount - 1)];
+				}
+			});
+
+			// Digit major prefix sum, each partition writes after the earlier partitions' keys of the same digit, keeping the sort stable.
+			uint32_t offset = 0;
+			bool sharedDigit = false;
+			for (uint32_t digit = 0; digit < digitCount; ++digit)
+			{
+				const auto digitBegin = offset;
+				for (auto& histogram : histograms)
+				{
+					const auto keysWithDigit = histogram[digit];
+					histogram[digit] = offset;
+					offset += keysWithDigit;
+				}
+
+				sharedDigit = sharedDigit || offset - digitBegin == count;
+			}
+
+			if (sharedDigit)
+			{
+				continue;  // Scattering would keep the current order.
+			}
+
+			std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](auto partition)
+			{
+				auto& histogram = histograms[partition];
+
+				const auto end = std::min(count, (partition + 1) * partitionSize);
+				for (auto i = partition * partitionSize; i < end; ++i)
+				{
+					const auto target = histogram[(keys[i] >> shift) & (digitCount - 1)]++;
+					scratchKeys[target] = keys[i];
+					scratchValues[target] = values[i];
+				}
+			});
+
+			keys.swap(scratchKeys);
+			values.swap(scratchValues);
+		}
+	}
+
+	void Build(std::span<const Light> lights, float lightRadius, BuildOutput& output)
+	{
+		VGScopedCPUStat("Build Light Hierarchy");
+
+		// Quantize point light positions within their bounds.
+		auto boundsMin = XMVectorReplicate(std::numeric_limits<float>::max());
+		auto boundsMax = XMVectorReplicate(-std::numeric_limits<float>::max());
+		size_t pointLights = 0;
+
+		for (const auto& light : lights)
+		{
+			if (IsPointLight(light))
+			{
+				const auto position = XMLoadFloat3(&light.position);
+				boundsMin = XMVectorMin(boundsMin, position);
+				boundsMax = XMVectorMax(boundsMax, position);
+				++pointLights;
+			}
+		}
+
+		constexpr auto maxCoordinate = static_cast<float>((1 << mortonAxisBits) - 1);
+		const auto extent = XMVectorMax(XMVectorSubtract(boundsMax, boundsMin), XMVectorReplicate(1e-6f));
+		const auto scale = XMVectorDivide(XMVectorReplicate(maxCoordinate), extent);
+
+		std::vector<uint32_t> keys(lights.size());
+		output.order.resize(lights.size());
+		std::iota(output.order.begin(), output.order.end(), 0);
+
+		for (size_t i = 0; i < lights.size(); ++i)
+		{
+			if (!IsPointLight(lights[i]))
+			{
+				keys[i] = unboundedKey;
+				continue;
+			}
+
+			XMFLOAT3 coordinates;
+			const auto quantized = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&lights[i].position), boundsMin), scale);
+			XMStoreFloat3(&coordinates, XMVectorMin(quantized, XMVectorReplicate(maxCoordinate)));  // Rounding can overshoot the last cell.
+			keys[i] = MortonCode(static_cast<uint32_t>(coordinates.x), static_cast<uint32_t>(coordinates.y), static_cast<uint32_t>(coordinates.z));
+		}
+
+		RadixSort(keys, output.order);
+
+		output.positions.resize(lights.size());
+		for (size_t i = 0; i < output.order.size(); ++i)
+		{
+			output.positions[output.order[i]] = static_cast<uint32_t>(i);
+		}
+
+		output.pointLights = pointLights;
+
+		// Point lights are sorted before every unbounded light, so each node is one kind or the other.
+		const auto pointNodes = (pointLights + lightsPerNode - 1) / lightsPerNode;
+		const auto unboundedNodes = (lights.size() - pointLights + lightsPerNode - 1) / lightsPerNode;
+		output.nodes.resize(pointNodes + unboundedNodes);
+
+		std::vector<size_t> nodeIndices(output.nodes.size());
+		std::iota(nodeIndices.begin(), nodeIndices.end(), 0);
+
+		std::for_each(std::execution::par, nodeIndices.begin(), nodeIndices.end(), [&](auto node)
+		{
+			auto& lightNode = output.nodes[node];
+			const auto begin = node < pointNodes ? node * lightsPerNode : pointLights + (node - pointNodes) * lightsPerNode;
+			const auto end = std::min(node < pointNodes ? pointLights : lights.size(), begin + lightsPerNode);
+
+			lightNode.firstLight = static_cast<uint32_t>(begin);
+			lightNode.lightCount = static_cast<uint32_t>(end - begin);
+			lightNode.padding[0] = 0;
+			lightNode.padding[1] = 0;
+
+			if (node >= pointNodes)
+			{
+				lightNode.center = { 0.f, 0.f, 0.f };
+				lightNode.radius = std::numeric_limits<float>::max();
+				return;
+			}
+
+			FitNode(lights, lightRadius, output, lightNode);
+		});
+
+		output.builtCost = 0.0;
+		for (size_t node = 0; node < pointNodes; ++node)
+		{
+			output.builtCost += static_cast<double>(output.nodes[node].radius) * output.nodes[node].radius;
+		}
+
+		output.cost = output.builtCost;
+	}
+
+	bool Refit(std::span<const Light> lights, float lightRadius, std::span<const uint32_t> movedLights, BuildOutput& output, std::vector<uint32_t>& refitNodes)
+	{
+		VGScopedCPUStat("Refit Light Hierarchy");
+
+		VGAssert(lights.size() == output.order.size(), "Refitting a hierarchy built from different lights.");
+
+		refitNodes.clear();
+		for (const auto light : movedLights)
+		{
+			// Unbounded nodes have no bounds to refit.
+			const auto position = output.positions[light];
+			if (position < output.pointLights)
+			{
+				refitNodes.emplace_back(position / lightsPerNode);
+			}
+		}
+
+		std::sort(refitNodes.begin(), refitNodes.end());
+		refitNodes.erase(std::unique(refitNodes.begin(), refitNodes.end()), refitNodes.end());
+
+		for (const auto node : refitNodes)
+		{
+			auto& lightNode = output.nodes[node];
+			output.cost -= static_cast<double>(lightNode.radius) * lightNode.radius;
+			FitNode(lights, lightRadius, output, lightNode);
+			output.cost += static_cast<double>(lightNode.radius) * lightNode.radius;
+		}
+
+		return output.cost <= output.builtCost * rebuildThreshold;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Light Hierarchy Test");
+
+		Seed({ 8642 });
+
+		TestReport report{ logRendering, VGText("Light hierarchy") };
+
+		report.Check(MortonCode(1, 0, 0) == 1 && MortonCode(0, 1, 0) == 2 && MortonCode(0, 0, 1) == 4, "morton: axes aren't interleaved in x, y, z order");
+		report.Check(MortonCode(1023, 1023, 1023) == (1u << 30) - 1 && MortonCode(1024, 0, 0) == 0, "morton: codes aren't limited to 10 bits per axis");
+		report.Check(MortonCode(3, 5, 6) == 0b110101011, "morton: bits are interleaved incorrectly");
+
+		// Sorting, against a stable sort. Narrow keys exercise skipped digits, duplicates exercise stability.
+		for (const auto [count, keyRange] : { std::pair{ 0, 1 }, std::pair{ 1, 1 }, std::pair{ 37, 4 }, std::pair{ 5000, 1 << 12 }, std::pair{ 100'000, 1 << 30 }, std::pair{ 100'000, 1000 } })
+		{
+			std::vector<uint32_t> keys(count);
+			std::vector<uint32_t> values(count);
+			std::vector<std::pair<uint32_t, uint32_t>> expected(count);
+
+			for (int i = 0; i < count; ++i)
+			{
+				keys[i] = static_cast<uint32_t>(Rand(0, keyRange - 1));
+				if (i % 7 == 0)
+				{
+					keys[i] = unboundedKey;
+				}
+
+				values[i] = i;
+				expected[i] = { keys[i], values[i] };
+			}
+
+			std::stable_sort(expected.begin(), expected.end(), [](const auto& left, const auto& right) { return left.first < right.first; });
+			RadixSort(keys, values);
+
+			bool matches = true;
+			for (int i = 0; i < count; ++i)
+			{
+				matches = matches && keys[i] == expected[i].first && values[i] == expected[i].second;
+			}
+
+			report.Check(matches, "sort: radix sort doesn't match a stable sort");
+		}
+
+		const auto view = XMMatrixLookAtRH(XMVectorSet(10.f, 5.f, -20.f, 1.f), XMVectorSet(0.f, 0.f, 0.f, 1.f), XMVectorSet(0.f, 1.f, 0.f, 0.f));
+		const auto camera = ClusterReference::CreateTestCamera(view, XM_PIDIV2, 16.f / 9.f, 0.1f, 1000.f);
+
+		for (const auto distribution : { ClusterReference::LightDistribution::Uniform, ClusterReference::LightDistribution::Clustered })
+		{
+			// Small radius so that the hierarchy can reject something, and a few directional lights scattered between the point lights.
+			constexpr float lightRadius = 10.f;
+
+			auto lights = ClusterReference::CreateTestLights(camera, 2000, 500.f, distribution);
+			for (size_t i = 0; i < lights.size(); i += 97)
+			{
+				lights[i].type = static_cast<uint32_t>(LightType::Directional);
+			}
+
+			BuildOutput hierarchy;
+			Build(lights, lightRadius, hierarchy);
+
+			auto sortedOrder = hierarchy.order;
+			std::sort(sortedOrder.begin(), sortedOrder.end());
+			bool permutation = sortedOrder.size() == lights.size();
+			for (size_t i = 0; permutation && i < sortedOrder.size(); ++i)
+			{
+				permutation = sortedOrder[i] == i;
+			}
+
+			report.Check(permutation, "build: light order isn't a permutation of the lights");
+
+			uint32_t nextLight = 0;
+			bool contiguous = true;
+			bool homogeneous = true;
+			bool enclosing = true;
+			for (const auto& node : hierarchy.nodes)
+			{
+				contiguous = contiguous && node.firstLight == nextLight && node.lightCount > 0 && node.lightCount <= lightsPerNode;
+				nextLight = node.firstLight + node.lightCount;
+
+				const auto pointNode = IsPointLight(lights[hierarchy.order[node.firstLight]]);
+				homogeneous = homogeneous && (pointNode || node.radius == std::numeric_limits<float>::max());
+
+				for (auto i = node.firstLight; contiguous && i < nextLight; ++i)
+				{
+					const auto& light = lights[hierarchy.order[i]];
+					homogeneous = homogeneous && IsPointLight(light) == pointNode;
+
+					if (pointNode)
+					{
+						const auto distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&light.position), XMLoadFloat3(&node.center))));
+						enclosing = enclosing && distance + lightRadius <= node.radius * 1.0001f;
+					}
+				}
+			}
+
+			report.Check(contiguous && nextLight == lights.size(), "build: nodes don't partition the light order");
+			report.Check(homogeneous, "build: nodes mix point lights with unbounded lights");
+			report.Check(enclosing, "build: node bounds don't enclose their lights");
+
+			// Hierarchical binning must bin exactly the lights that flat binning does.
+			constexpr uint32_t froxelSize = 64;
+			const auto grid = ClusteredLightCulling::ComputeGridInfo(1280, 720, camera, froxelSize);
+
+			std::vector<ClusterReference::FroxelBounds> bounds;
+			ClusterReference::ComputeBounds(grid, 1280, 720, froxelSize, camera, bounds);
+
+			std::vector<XMFLOAT3> viewLights;
+			std::vector<XMFLOAT3> viewNodes;
+			TransformToView(camera, lights, hierarchy, viewLights, viewNodes);
+
+			BinningStats stats;
+			std::vector<uint32_t> flat;
+			std::vector<uint32_t> binned;
+			bool matches = true;
+			for (size_t cluster = 0; cluster < bounds.size(); cluster += 7)
+			{
+				flat.clear();
+				for (uint32_t i = 0; i < lights.size(); ++i)
+				{
+					if (!IsPointLight(lights[i]) || ClusterReference::SphereBoxIntersection(viewLights[i], lightRadius, bounds[cluster]))
+					{
+						flat.emplace_back(i);
+					}
+				}
+
+				binned.clear();
+				BinHierarchical(bounds[cluster], viewLights, viewNodes, hierarchy, lights, lightRadius, binned, stats);
+				std::sort(binned.begin(), binned.end());
+
+				matches = matches && binned == flat;
+			}
+
+			report.Check(matches, "binning: hierarchical binning doesn't match flat binning");
+			report.Check(stats.acceptedNodes < stats.nodeTests, "binning: no node was rejected");
+		}
+
+		// Small moves are refit in place, scattering every light loosens the nodes enough to build again.
+		{
+			constexpr float lightRadius = 10.f;
+
+			auto lights = ClusterReference::CreateTestLights(camera, 2000, 500.f, ClusterReference::LightDistribution::Clustered);
+			lights[50].type = static_cast<uint32_t>(LightType::Directional);
+
+			BuildOutput hierarchy;
+			Build(lights, lightRadius, hierarchy);
+
+			const auto Encloses = [&]()
+			{
+				for (size_t node = 0; node * lightsPerNode < hierarchy.pointLights; ++node)
+				{
+					const auto& lightNode = hierarchy.nodes[node];
+					for (auto i = lightNode.firstLight; i < lightNode.firstLight + lightNode.lightCount; ++i)
+					{
+						const auto distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&lights[hierarchy.order[i]].position), XMLoadFloat3(&lightNode.center))));
+						if (distance + lightRadius > lightNode.radius * 1.0001f)
+						{
+							return false;
+						}
+					}
+				}
+
+				return true;
+			};
+
+			std::vector<uint32_t> moved;
+			for (uint32_t i = 0; i < lights.size(); i += 50)
+			{
+				lights[i].position.y += 1.f;
+				moved.emplace_back(i);
+			}
+
+			std::vector<uint32_t> refitNodes;
+			report.Check(Refit(lights, lightRadius, moved, hierarchy, refitNodes), "refit: small moves loosened the nodes past the threshold");
+			report.Check(Encloses(), "refit: refit node bounds don't enclose their lights");
+
+			bool movedOnly = refitNodes.size() < moved.size();  // The moved directional light has no node to refit.
+			for (const auto node : refitNodes)
+			{
+				const auto& lightNode = hierarchy.nodes[node];
+				movedOnly = movedOnly && std::any_of(hierarchy.order.begin() + lightNode.firstLight, hierarchy.order.begin() + lightNode.firstLight + lightNode.lightCount,
+					[](auto light) { return light % 50 == 0; });
+			}
+
+			report.Check(movedOnly, "refit: nodes without moved lights were refit");
+
+			for (auto& light : lights)
+			{
+				light.position = { (float)Rand(-5000.0, 5000.0), (float)Rand(-5000.0, 5000.0), (float)Rand(-5000.0, 5000.0) };
+			}
+
+			moved.resize(lights.size());
+			std::iota(moved.begin(), moved.end(), 0);
+
+			report.Check(!Refit(lights, lightRadius, moved, hierarchy, refitNodes), "refit: scattered lights didn't loosen the nodes past the threshold");
+			report.Check(Encloses(), "refit: scattered node bounds don't enclose their lights");
+		}
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Light Hierarchy Benchmark");
+
+		constexpr int iterations = 10;
+
+		Seed({ 2864 });
+
+		const size_t sortCounts[] = { 1'000, 10'000, 100'000, 1'000'000 };
+		for (const auto count : sortCounts)
+		{
+			std::vector<uint32_t> sourceKeys(count);
+			for (auto& key : sourceKeys)
+			{
+				key = MortonCode(static_cast<uint32_t>(Rand(0, 1023)), static_cast<uint32_t>(Rand(0, 1023)), static_cast<uint32_t>(Rand(0, 1023)));
+			}
+
+			double radixTime = 0.0;
+			double standardTime = 0.0;
+			for (int i = 0; i < iterations; ++i)
+			{
+				auto keys = sourceKeys;
+				std::vector<uint32_t> values(count);
+				std::iota(values.begin(), values.end(), 0);
+
+				const auto radixBegin = std::chrono::high_resolution_clock::now();
+				RadixSort(keys, values);
+				const auto radixEnd = std::chrono::high_resolution_clock::now();
+
+				// The same pairs packed into one integer, so that std::sort is also stable.
+				std::vector<uint64_t> pairs(count);
+				for (size_t j = 0; j < count; ++j)
+				{
+					pairs[j] = (static_cast<uint64_t>(sourceKeys[j]) << 32) | j;
+				}
+
+				const auto standardBegin = std::chrono::high_resolution_clock::now();
+				std::sort(pairs.begin(), pairs.end());
+				const auto standardEnd = std::chrono::high_resolution_clock::now();
+
+				radixTime += std::chrono::duration<double, std::milli>(radixEnd - radixBegin).count();
+				standardTime += std::chrono::duration<double, std::milli>(standardEnd - standardBegin).count();
+			}
+
+			VGLog(logRendering, "Light hierarchy benchmark, sorting {} lights: radix sort {:.3f} ms, std::sort {:.3f} ms.", count, radixTime / iterations, standardTime / iterations);
+		}
+
+		// Rejection rates of the default binning setup, over the clusters in front of the farthest light.
+		constexpr uint32_t width = 1920;
+		constexpr uint32_t height = 1080;
+		constexpr uint32_t froxelSize = 64;
+		constexpr float maxDepth = 1000.f;
+
+		const CameraComponent cameraSettings{};
+		const auto view = XMMatrixLookAtRH(XMVectorSet(10.f, 5.f, -20.f, 1.f), XMVectorSet(0.f, 0.f, 0.f, 1.f), XMVectorSet(0.f, 1.f, 0.f, 0.f));
+		const auto camera = ClusterReference::CreateTestCamera(view, cameraSettings.fieldOfView, width / (float)height, cameraSettings.nearPlane, cameraSettings.farPlane);
+		const auto grid = ClusteredLightCulling::ComputeGridInfo(width, height, camera, froxelSize);
+
+		std::vector<ClusterReference::FroxelBounds> bounds;
+		ClusterReference::ComputeBounds(grid, width, height, froxelSize, camera, bounds);
+
+		const auto sliceSize = grid.x * grid.y;
+		const auto clusterCount = (ClusterReference::ClusterIndex(grid, froxelSize, camera, 0.f, 0.f, -maxDepth) / sliceSize + 1) * sliceSize;
+
+		const std::pair<const char*, ClusterReference::LightDistribution> distributions[] = {
+			{ "uniform", ClusterReference::LightDistribution::Uniform },
+			{ "clustered", ClusterReference::LightDistribution::Clustered }
+		};
+		const size_t lightCounts[] = { 1'000, 10'000 };
+		const float lightRadii[] = { 10.f, ClusterReference::pointLightRadius };
+
+		const auto partitionCount = std::max(std::thread::hardware_concurrency(), 1u) * partitionsPerThread;
+		std::vector<size_t> partitions(partitionCount);
+		std::iota(partitions.begin(), partitions.end(), 0);
+
+		for (const auto& [distributionName, distribution] : distributions)
+		{
+			for (const auto lightCount : lightCounts)
+			{
+				const auto lights = ClusterReference::CreateTestLights(camera, lightCount, maxDepth, distribution);
+
+				for (const auto lightRadius : lightRadii)
+				{
+					BuildOutput hierarchy;
+					const auto buildBegin = std::chrono::high_resolution_clock::now();
+					Build(lights, lightRadius, hierarchy);
+					const auto buildEnd = std::chrono::high_resolution_clock::now();
+
+					std::vector<XMFLOAT3> viewLights;
+					std::vector<XMFLOAT3> viewNodes;
+					TransformToView(camera, lights, hierarchy, viewLights, viewNodes);
+
+					std::vector<BinningStats> partitionStats(partitionCount);
+					std::for_each(std::execution::par, partitions.begin(), partitions.end(), [&](auto partition)
+					{
+						std::vector<uint32_t> binned;
+						for (auto cluster = partition; cluster < clusterCount; cluster += partitionCount)
+						{
+							binned.clear();
+							BinHierarchical(bounds[cluster], viewLights, viewNodes, hierarchy, lights, lightRadius, binned, partitionStats[partition]);
+						}
+					});
+
+					BinningStats stats;
+					for (const auto& partition : partitionStats)
+					{
+						stats.nodeTests += partition.nodeTests;
+						stats.acceptedNodes += partition.acceptedNodes;
+						stats.lightTests += partition.lightTests;
+						stats.binnedLights += partition.binnedLights;
+					}
+
+					const auto testsPerCluster = (double)(stats.nodeTests + stats.lightTests) / clusterCount;
+
+					VGLog(logRendering, "Light hierarchy benchmark, {} {} lights with radius {}: {} nodes built in {:.3f} ms.", lightCount, distributionName, lightRadius,
+						hierarchy.nodes.size(), std::chrono::duration<double, std::milli>(buildEnd - buildBegin).count());
+					VGLog(logRendering, "  {} clusters: {:.1f}% of nodes rejected, {:.1f} tests per cluster instead of {} ({:.1f}x fewer), {:.1f} lights binned per cluster.",
+						clusterCount, 100.0 * (stats.nodeTests - stats.acceptedNodes) / std::max<uint64_t>(stats.nodeTests, 1), testsPerCluster, lightCount,
+						lightCount / std::max(testsPerCluster, 1.0), (double)stats.binnedLights / clusterCount);
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Orders lights along a 3D Morton curve and groups runs of the order into nodes with a bounding sphere, so that light binning
+// can reject whole groups of nearby lights per froxel. The light buffer itself keeps its slots, nodes reference the order.
+// Moved lights are refit in place, keeping the order, until refitting has loosened the nodes enough to build again.
+namespace LightHierarchy
+{
+	constexpr uint32_t lightsPerNode = 32;  // Must match ClusterLightBinning.hlsl.
+	constexpr uint32_t mortonAxisBits = 10;
+	constexpr uint32_t unboundedKey = 0xFFFFFFFF;  // Key of lights without a position, sorted after every point light.
+	constexpr double rebuildThreshold = 1.5;  // Refit cost relative to the built cost that triggers a rebuild.
+
+	struct BuildOutput
+	{
+		std::vector<uint32_t> order;  // Light indices, sorted by Morton code.
+		std::vector<uint32_t> positions;  // Inverse of the order, each light's position in it.
+		std::vector<LightNode> nodes;  // Point light nodes first, then nodes of unbounded lights with an infinite radius.
+		size_t pointLights = 0;
+		double builtCost = 0.0;  // Sum of squared point node radii when built.
+		double cost = 0.0;  // Grows as refitting loosens the nodes.
+	};
+
+	// Interleaves the low 10 bits of each coordinate.
+	uint32_t MortonCode(uint32_t x, uint32_t y, uint32_t z);
+
+	// Stable least significant digit radix sort, values are permuted alongside their keys. Digits are counted and scattered in
+	// parallel partitions, passes over digits that every key shares are skipped.
+	void RadixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values);
+
+	// Node radii extend each light's position by the light radius.
+	void Build(std::span<const Light> lights, float lightRadius, BuildOutput& output);
+	// Recomputes the bounds of the nodes holding the moved lights, refitNodes receives their indices in ascending order. The
+	// lights must be the ones the hierarchy was built from, a light changing between point and unbounded also needs a build.
+	// Returns false once the nodes are loose enough that they should be built again.
+	bool Refit(std::span<const Light> lights, float lightRadius, std::span<const uint32_t> movedLights, BuildOutput& output, std::vector<uint32_t>& refitNodes);
+
+	// Headless checks of the sort, the hierarchy and its refits, and that hierarchical binning matches flat binning.
+	void Test();
+	// CPU-only measurement of sort throughput against std::sort, and of node rejection rates during binning, results are logged.
+	void Benchmark();
+}
\ No newline at end of file
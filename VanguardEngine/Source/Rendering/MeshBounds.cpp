@@ -0,0 +1,314 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/MeshBounds.h>
+#include <Rendering/TestMeshes.h>
+#include <Utility/Math.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <vector>
+#include <cmath>
+
+namespace MeshBounds
+{
+	namespace
+	{
+		float DistanceSquared(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			const auto x = a.x - b.x;
+			const auto y = a.y - b.y;
+			const auto z = a.z - b.z;
+
+			return x * x + y * y + z * z;
+		}
+
+		// Moves the sphere towards the point just enough to contain it. The new sphere contains the old one, so points
+		// that were inside stay inside.
+		void Grow(XMFLOAT3& center, float& radius, const XMFLOAT3& point)
+		{
+			const auto distanceSquared = DistanceSquared(center, point);
+			if (distanceSquared <= radius * radius)
+			{
+				return;
+			}
+
+			const auto distance = std::sqrt(distanceSquared);
+			const auto grownRadius = (radius + distance) * 0.5f;
+			const auto shift = (grownRadius - radius) / distance;
+
+			center.x += (point.x - center.x) * shift;
+			center.y += (point.y - center.y) * shift;
+			center.z += (point.z - center.z) * shift;
+			radius = grownRadius;
+		}
+
+		// Distance to the farthest position, never larger than the radius that growing the sphere produced.
+		float EnclosingRadius(const XMFLOAT3& center, const XMFLOAT3* positions, size_t count)
+		{
+			float radiusSquared = 0.f;
+			for (size_t i = 0; i < count; ++i)
+			{
+				radiusSquared = std::max(radiusSquared, DistanceSquared(center, positions[i]));
+			}
+
+			return std::sqrt(radiusSquared);
+		}
+	}
+
+	BoundingVolume Compute(const XMFLOAT3* positions, size_t count)
+	{
+		VGScopedCPUStat("Compute Mesh Bounds");
+
+		if (count == 0)
+		{
+			return FromRadius(0.f);
+		}
+
+		BoundingVolume bounds;
+		bounds.boxMin = positions[0];
+		bounds.boxMax = positions[0];
+
+		size_t extremes[6] = {};  // Minimum and maximum position along each axis.
+		for (size_t i = 1; i < count; ++i)
+		{
+			const auto& position = positions[i];
+			if (position.x < bounds.boxMin.x) { bounds.boxMin.x = position.x; extremes[0] = i; }
+			if (position.x > bounds.boxMax.x) { bounds.boxMax.x = position.x; extremes[1] = i; }
+			if (position.y < bounds.boxMin.y) { bounds.boxMin.y = position.y; extremes[2] = i; }
+			if (position.y > bounds.boxMax.y) { bounds.boxMax.y = position.y; extremes[3] = i; }
+			if (position.z < bounds.boxMin.z) { bounds.boxMin.z = position.z; extremes[4] = i; }
+			if (position.z > bounds.boxMax.z) { bounds.boxMax.z = position.z; extremes[5] = i; }
+		}
+
+		// Ritter's sphere, starting from the most separated pair of axis extremes.
+		int axis = 0;
+		for (int i = 1; i < 3; ++i)
+		{
+			if (DistanceSquared(positions[extremes[i * 2]], positions[extremes[i * 2 + 1]]) > DistanceSquared(positions[extremes[axis * 2]], positions[extremes[axis * 2 + 1]]))
+			{
+				axis = i;
+			}
+		}
+
+		const auto& first = positions[extremes[axis * 2]];
+		const auto& second = positions[extremes[axis * 2 + 1]];
+		XMFLOAT3 center = { (first.x + second.x) * 0.5f, (first.y + second.y) * 0.5f, (first.z + second.z) * 0.5f };
+		auto radius = std::sqrt(DistanceSquared(first, second)) * 0.5f;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			Grow(center, radius, positions[i]);
+		}
+
+		radius = EnclosingRadius(center, positions, count);
+
+		// The box center is optimal for symmetric meshes, where Ritter's sphere tends to drift.
+		const XMFLOAT3 boxCenter = { (bounds.boxMin.x + bounds.boxMax.x) * 0.5f, (bounds.boxMin.y + bounds.boxMax.y) * 0.5f, (bounds.boxMin.z + bounds.boxMax.z) * 0.5f };
+		const auto boxRadius = EnclosingRadius(boxCenter, positions, count);
+		if (boxRadius < radius)
+		{
+			center = boxCenter;
+			radius = boxRadius;
+		}
+
+		// Shrink the best sphere and regrow it over the positions in a new order, keeping any improvement. Every pass visits
+		// all positions, so the result stays conservative.
+		std::vector<uint32_t> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		std::minstd_rand generator{ static_cast<uint32_t>(count) };  // Deterministic, imports produce the same bounds every time.
+
+		for (int i = 0; i < sphereIterations; ++i)
+		{
+			std::shuffle(order.begin(), order.end(), generator);
+
+			auto trialCenter = center;
+			auto trialRadius = radius * 0.95f;
+			for (const auto index : order)
+			{
+				Grow(trialCenter, trialRadius, positions[index]);
+			}
+
+			trialRadius = EnclosingRadius(trialCenter, positions, count);
+			if (trialRadius < radius)
+			{
+				center = trialCenter;
+				radius = trialRadius;
+			}
+		}
+
+		bounds.sphereCenter = center;
+		bounds.sphereRadius = radius;
+
+		return bounds;
+	}
+
+	BoundingVolume FromRadius(float radius)
+	{
+		return BoundingVolume{
+			.boxMin = { -radius, -radius, -radius },
+			.boxMax = { radius, radius, radius },
+			.sphereCenter = { 0.f, 0.f, 0.f },
+			.sphereRadius = radius
+		};
+	}
+
+	float MaxScale(const XMMATRIX& worldMatrix)
+	{
+		const auto scaleSquared = XMVectorMax(XMVectorMax(XMVector3LengthSq(worldMatrix.r[0]), XMVector3LengthSq(worldMatrix.r[1])), XMVector3LengthSq(worldMatrix.r[2]));
+		return XMVectorGetX(XMVectorSqrt(scaleSquared));
+	}
+
+	void TransformSphere(const BoundingVolume& bounds, const XMMATRIX& worldMatrix, XMFLOAT3& center, float& radius)
+	{
+		XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&bounds.sphereCenter), worldMatrix));
+		radius = bounds.sphereRadius * MaxScale(worldMatrix);
+	}
+
+	void TransformBox(const BoundingVolume& bounds, const XMMATRIX& worldMatrix, XMFLOAT3& min, XMFLOAT3& max)
+	{
+		const auto boxMin = XMLoadFloat3(&bounds.boxMin);
+		const auto boxMax = XMLoadFloat3(&bounds.boxMax);
+		const auto center = XMVector3Transform(XMVectorScale(XMVectorAdd(boxMin, boxMax), 0.5f), worldMatrix);
+		const auto extent = XMVectorScale(XMVectorSubtract(boxMax, boxMin), 0.5f);
+
+		// Each world axis receives the absolute contribution of every object axis.
+		auto worldExtent = XMVectorMultiply(XMVectorAbs(worldMatrix.r[0]), XMVectorSplatX(extent));
+		worldExtent = XMVectorMultiplyAdd(XMVectorAbs(worldMatrix.r[1]), XMVectorSplatY(extent), worldExtent);
+		worldExtent = XMVectorMultiplyAdd(XMVectorAbs(worldMatrix.r[2]), XMVectorSplatZ(extent), worldExtent);
+
+		XMStoreFloat3(&min, XMVectorSubtract(center, worldExtent));
+		XMStoreFloat3(&max, XMVectorAdd(center, worldExtent));
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Mesh Bounds Test");
+
+		Seed({ 4681 });
+
+		TestReport report{ logRendering, VGText("Mesh bounds") };
+
+		const auto Translated = [](TestMeshes::Mesh mesh, float scale, const XMFLOAT3& offset)
+		{
+			for (auto& position : mesh.positions)
+			{
+				position = { position.x * scale + offset.x, position.y * scale + offset.y, position.z * scale + offset.z };
+			}
+
+			return mesh;
+		};
+
+		TestMeshes::Mesh cube;
+		for (int i = 0; i < 8; ++i)
+		{
+			cube.positions.emplace_back(i & 1 ? 6.f : 4.f, i & 2 ? 6.f : 4.f, i & 4 ? 6.f : 4.f);
+		}
+
+		TestMeshes::Mesh pair;
+		pair.positions = { { -3.f, 1.f, 2.f }, { 5.f, 1.f, 2.f } };
+
+		TestMeshes::Mesh point;
+		point.positions = { { 7.f, -2.f, 3.f } };
+
+		// Expected radius of the minimal sphere where it's known, zero otherwise.
+		const std::tuple<const char*, TestMeshes::Mesh, float> meshes[] = {
+			{ "sphere", TestMeshes::Sphere(32, 64), 1.f },
+			{ "offset sphere", Translated(TestMeshes::Sphere(32, 64), 3.f, { 100.f, -50.f, 25.f }), 3.f },
+			{ "flat", TestMeshes::Terrain(32, 0.f), 16.f * XM_SQRT2 },
+			{ "terrain", TestMeshes::Terrain(64, 2.f), 0.f },
+			{ "soup", TestMeshes::Soup(2000, 1), 0.f },
+			{ "offset soup", Translated(TestMeshes::Soup(500, 1), 0.5f, { -20.f, 0.f, 40.f }), 0.f },
+			{ "cube", cube, std::sqrt(3.f) },
+			{ "pair", pair, 4.f },
+			{ "point", point, 0.f }
+		};
+
+		double radiusRatio = 0.0;  // Against the sphere centered on the box, summed.
+
+		for (const auto& [name, mesh, expectedRadius] : meshes)
+		{
+			const auto bounds = Compute(mesh.positions.data(), mesh.positions.size());
+			const auto tolerance = 1e-5f * std::max(bounds.sphereRadius, 1.f);
+
+			bool sphereContains = true;
+			bool boxContains = true;
+			bool touchesMin[3] = {};
+			bool touchesMax[3] = {};
+			for (const auto& position : mesh.positions)
+			{
+				sphereContains = sphereContains && std::sqrt(DistanceSquared(position, bounds.sphereCenter)) <= bounds.sphereRadius + tolerance;
+				boxContains = boxContains && position.x >= bounds.boxMin.x && position.y >= bounds.boxMin.y && position.z >= bounds.boxMin.z &&
+					position.x <= bounds.boxMax.x && position.y <= bounds.boxMax.y && position.z <= bounds.boxMax.z;
+
+				touchesMin[0] = touchesMin[0] || position.x == bounds.boxMin.x;
+				touchesMin[1] = touchesMin[1] || position.y == bounds.boxMin.y;
+				touchesMin[2] = touchesMin[2] || position.z == bounds.boxMin.z;
+				touchesMax[0] = touchesMax[0] || position.x == bounds.boxMax.x;
+				touchesMax[1] = touchesMax[1] || position.y == bounds.boxMax.y;
+				touchesMax[2] = touchesMax[2] || position.z == bounds.boxMax.z;
+			}
+
+			report.Check(sphereContains, "{}: sphere doesn't contain every position", name);
+			report.Check(boxContains, "{}: box doesn't contain every position", name);
+			report.Check(std::all_of(std::begin(touchesMin), std::end(touchesMin), std::identity{}) && std::all_of(std::begin(touchesMax), std::end(touchesMax), std::identity{}), "{}: box isn't tight", name);
+
+			// Any enclosing sphere is at least as wide as the box along each axis.
+			const auto widestAxis = std::max({ bounds.boxMax.x - bounds.boxMin.x, bounds.boxMax.y - bounds.boxMin.y, bounds.boxMax.z - bounds.boxMin.z });
+			report.Check(bounds.sphereRadius >= widestAxis * 0.5f - tolerance, "{}: sphere is smaller than the box allows", name);
+
+			const XMFLOAT3 boxCenter = { (bounds.boxMin.x + bounds.boxMax.x) * 0.5f, (bounds.boxMin.y + bounds.boxMax.y) * 0.5f, (bounds.boxMin.z + bounds.boxMax.z) * 0.5f };
+			const auto boxRadius = EnclosingRadius(boxCenter, mesh.positions.data(), mesh.positions.size());
+			report.Check(bounds.sphereRadius <= boxRadius + tolerance, "{}: sphere is looser than the sphere around the box center", name);
+			radiusRatio += boxRadius > 0.f ? bounds.sphereRadius / boxRadius : 1.0;
+
+			if (expectedRadius > 0.f || mesh.positions.size() == 1)
+			{
+				report.Check(bounds.sphereRadius <= expectedRadius * 1.01f + tolerance, "{}: sphere is more than 1% larger than the minimal sphere", name);
+			}
+
+			// Transformed bounds must still contain the transformed geometry, including under non-uniform scale.
+			for (int i = 0; i < 16; ++i)
+			{
+				const auto worldMatrix = ComposeTransformMatrix(
+					{ (float)Rand(0.1, 4.0), (float)Rand(0.1, 4.0), (float)Rand(0.1, 4.0) },
+					{ (float)Rand(-XM_PI, XM_PI), (float)Rand(-XM_PI, XM_PI), (float)Rand(-XM_PI, XM_PI) },
+					{ (float)Rand(-100.0, 100.0), (float)Rand(-100.0, 100.0), (float)Rand(-100.0, 100.0) });
+
+				XMFLOAT3 worldCenter;
+				float worldRadius;
+				TransformSphere(bounds, worldMatrix, worldCenter, worldRadius);
+
+				XMFLOAT3 worldMin;
+				XMFLOAT3 worldMax;
+				TransformBox(bounds, worldMatrix, worldMin, worldMax);
+
+				const auto worldTolerance = 1e-4f * std::max({ worldRadius, 1.f, std::abs(worldCenter.x), std::abs(worldCenter.y), std::abs(worldCenter.z) });
+
+				bool transformedSphereContains = true;
+				bool transformedBoxContains = true;
+				for (const auto& position : mesh.positions)
+				{
+					XMFLOAT3 worldPosition;
+					XMStoreFloat3(&worldPosition, XMVector3Transform(XMLoadFloat3(&position), worldMatrix));
+
+					transformedSphereContains = transformedSphereContains && std::sqrt(DistanceSquared(worldPosition, worldCenter)) <= worldRadius + worldTolerance;
+					transformedBoxContains = transformedBoxContains &&
+						worldPosition.x >= worldMin.x - worldTolerance && worldPosition.y >= worldMin.y - worldTolerance && worldPosition.z >= worldMin.z - worldTolerance &&
+						worldPosition.x <= worldMax.x + worldTolerance && worldPosition.y <= worldMax.y + worldTolerance && worldPosition.z <= worldMax.z + worldTolerance;
+				}
+
+				report.Check(transformedSphereContains, "{}: transformed sphere doesn't contain the transformed positions", name);
+				report.Check(transformedBoxContains, "{}: transformed box doesn't contain the transformed positions", name);
+			}
+		}
+
+		report.Log(fmt::format(", spheres average {:.1f}% of the radius of spheres around the box center",
+			100.0 * radiusRatio / std::size(meshes)));
+	}
+}
\ No newline at end of file
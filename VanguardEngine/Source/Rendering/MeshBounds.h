@@ -0,0 +1,29 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/RenderComponents.h>
+
+#include <cstddef>
+
+// Bounding volumes of mesh subsets, computed once at import. Culling tests the sphere, the scene BVH uses the box.
+namespace MeshBounds
+{
+	constexpr int sphereIterations = 8;  // Shrink and regrow passes refining the initial Ritter sphere.
+
+	// Exact box, and a sphere within a few percent of the minimal enclosing sphere. Every position is contained.
+	BoundingVolume Compute(const XMFLOAT3* positions, size_t count);
+	// Sphere and box around the object origin, for procedural meshes without geometry to fit.
+	BoundingVolume FromRadius(float radius);
+
+	// Largest axis scale of the matrix, so that scale inherited from parents is included.
+	float MaxScale(const XMMATRIX& worldMatrix);
+	// World space sphere, conservative under non-uniform scale.
+	void TransformSphere(const BoundingVolume& bounds, const XMMATRIX& worldMatrix, XMFLOAT3& center, float& radius);
+	// World space box enclosing the transformed object space box.
+	void TransformBox(const BoundingVolume& bounds, const XMMATRIX& worldMatrix, XMFLOAT3& min, XMFLOAT3& max);
+
+	// Headless checks that the bounds contain their geometry and how tight they are, on procedural meshes.
+	void Test();
+}
\ No newline at end of file
@@ -4,47 +4,122 @@
 #include <Rendering/Device.h>
 
 #include <string>
+#include <span>
+#include <cmath>
 
 uint32_t MeshFactory::SearchVertexChannel(const std::string& name)
 {
 	if (name.find("POSITION") != std::string::npos) return 0;
 	if (name.find("NORMAL") != std::string::npos) return 1;
 	if (name.find("TEXCOORD") != std::string::npos) return 2;
+	if (name.find("BITANGENT") != std::string::npos) return 4;  // Before tangents, which it contains.
 	if (name.find("TANGENT") != std::string::npos) return 3;
-	if (name.find("BITANGENT") != std::string::npos) return 4;
 	if (name.find("COLOR") != std::string::npos) return 5;
 	return std::numeric_limits<uint32_t>::max();
 }
 
-PrimitiveOffset MeshFactory::AllocateMesh(const std::vector<uint8_t>& vertexPositionData, const std::vector<uint8_t>& vertexExtraData, const std::vector<uint8_t>& indexData)
+uint32_t MeshFactory::SelectVertexFormats(const std::vector<PrimitiveAssembly>& assemblies, uint32_t* formats)
 {
+	const auto& front = assemblies.front();
+	const auto Size = [&front](const std::string& name)
+	{
+		return front.vertexStream.contains(name) ? front.GetAttributeSize(name) : 0;
+	};
+
+	uint32_t derived = 0;
+
+	if (Size("NORMAL") == sizeof(XMFLOAT3))
+	{
+		formats[vertexChannelNormal] = vertexFormatOctahedral;
+	}
+
+	if (Size("TANGENT") >= sizeof(XMFLOAT3))
+	{
+		formats[vertexChannelTangent] = vertexFormatOctahedralSign;
+
+		// The bitangent follows from the normal and the tangent's sign.
+		if (formats[vertexChannelNormal] == vertexFormatOctahedral && Size("BITANGENT") == sizeof(XMFLOAT3))
+		{
+			derived |= 1 << vertexChannelBitangent;
+		}
+	}
+
+	// Tiled texcoords would lose precision as halfs.
+	if (Size("TEXCOORD_0") == sizeof(XMFLOAT2))
+	{
+		bool inRange = true;
+		for (const auto& assembly : assemblies)
+		{
+			const auto* texcoords = reinterpret_cast<const XMFLOAT2*>(assembly.GetAttributeData("TEXCOORD_0"));
+			for (size_t i = 0; i < assembly.GetAttributeCount("TEXCOORD_0") && inRange; ++i)
+			{
+				inRange = std::abs(texcoords[i].x) <= VertexQuantization::maxHalfTexcoord && std::abs(texcoords[i].y) <= VertexQuantization::maxHalfTexcoord;
+			}
+		}
+
+		if (inRange)
+		{
+			formats[vertexChannelTexcoord] = vertexFormatHalf;
+		}
+	}
+
+	if (Size("COLOR_0") == sizeof(XMFLOAT3) || Size("COLOR_0") == sizeof(XMFLOAT4))
+	{
+		formats[vertexChannelColor] = vertexFormatUnorm8;
+	}
+
+	return derived;
+}
+
+PrimitiveOffset MeshFactory::AllocateMesh(std::span<const uint8_t> vertexPositionData, std::span<const uint8_t> vertexExtraData, std::span<const uint8_t> indexData, std::span<const MeshletData> meshletData)
+{
+	VGAssert(meshletOffset + meshletData.size() <= maxMeshlets, "Exceeded the meshlet buffer capacity.");
+
 	device->GetResourceManager().Write(vertexPositionBuffer, vertexPositionData, vertexPositionOffset);
 	device->GetResourceManager().Write(vertexExtraBuffer, vertexExtraData, vertexExtrasOffset);
 	device->GetResourceManager().Write(indexBuffer, indexData, indexOffset);
+	if (meshletData.size() > 0)
+		device->GetResourceManager().Write(meshletBuffer, std::span{ reinterpret_cast<const uint8_t*>(meshletData.data()), meshletData.size_bytes() }, meshletOffset * sizeof(MeshletData));
 
 	device->GetDirectList().TransitionBarrier(vertexPositionBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	device->GetDirectList().TransitionBarrier(vertexExtraBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	device->GetDirectList().TransitionBarrier(indexBuffer, D3D12_RESOURCE_STATE_INDEX_BUFFER);
+	device->GetDirectList().TransitionBarrier(meshletBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	device->GetDirectList().FlushBarriers();
 
 	auto result = PrimitiveOffset{
 		.index = indexOffset,
 		.position = vertexPositionOffset,
-		.extra = vertexExtrasOffset
+		.extra = vertexExtrasOffset,
+		.meshlet = meshletOffset
 	};
 
 	vertexPositionOffset += vertexPositionData.size();
 	vertexExtrasOffset += vertexExtraData.size();
 	indexOffset += indexData.size();
+	meshletOffset += meshletData.size();
 
 	return result;
 }
 
-MeshFactory::MeshFactory(RenderDevice* inDevice, size_t maxVertices, size_t maxIndices)
+MeshComponent MeshFactory::CreateMeshComponent(const VertexMetadata& metadata, std::span<const MeshComponent::Subset> subsets, std::span<const uint8_t> vertexPositionData, std::span<const uint8_t> vertexExtraData, std::span<const uint8_t> indexData, std::span<const MeshletData> meshletData)
+{
+	VGScopedCPUStat("Create Mesh Component");
+
+	MeshComponent component;
+	component.metadata = metadata;
+	component.subsets.assign(subsets.begin(), subsets.end());
+	component.globalOffset = AllocateMesh(vertexPositionData, vertexExtraData, indexData, meshletData);
+
+	return component;
+}
+
+MeshFactory::MeshFactory(RenderDevice* inDevice, size_t maxVertices, size_t maxIndices, size_t inMaxMeshlets)
 {
 	VGScopedCPUStat("Create Mesh Factory");
 
 	device = inDevice;
+	maxMeshlets = inMaxMeshlets;
 
 	BufferDescription vertexDescription{};
 	vertexDescription.size = maxVertices;
@@ -64,6 +139,14 @@ MeshFactory::MeshFactory(RenderDevice* inDevice, size_t maxVertices, size_t maxI
 	indexDescription.bindFlags = BindFlag::IndexBuffer;
 	indexDescription.accessFlags = AccessFlag::CPUWrite;
 	indexBuffer = device->GetResourceManager().Create(indexDescription, VGText("Index buffer"));
+
+	BufferDescription meshletDescription{};
+	meshletDescription.size = maxMeshlets;
+	meshletDescription.stride = sizeof(MeshletData);
+	meshletDescription.updateRate = ResourceFrequency::Static;
+	meshletDescription.bindFlags = BindFlag::ShaderResource;
+	meshletDescription.accessFlags = AccessFlag::CPUWrite;
+	meshletBuffer = device->GetResourceManager().Create(meshletDescription, VGText("Meshlet buffer"));
 }
 
 MeshFactory::~MeshFactory()
@@ -71,4 +154,5 @@ MeshFactory::~MeshFactory()
 	device->GetResourceManager().Destroy(vertexPositionBuffer);
 	device->GetResourceManager().Destroy(vertexExtraBuffer);
 	device->GetResourceManager().Destroy(indexBuffer);
+	device->GetResourceManager().Destroy(meshletBuffer);
 }
\ No newline at end of file
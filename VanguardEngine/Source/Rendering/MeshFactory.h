@@ -5,12 +5,28 @@
 #include <Rendering/Base.h>
 #include <Rendering/PrimitiveAssembly.h>
 #include <Rendering/RenderComponents.h>
+#include <Rendering/VertexQuantization.h>
 
 #include <vector>
+#include <span>
+#include <string>
 #include <utility>
+#include <algorithm>
 
 class RenderDevice;
 
+// CPU copy of a mesh allocation, laid out as it's stored in the mesh buffers. Subset offsets are relative to the start of each
+// block, and subset material indices are into the model's materials.
+struct MeshData
+{
+	VertexMetadata metadata;
+	std::vector<MeshComponent::Subset> subsets;
+	std::vector<uint8_t> vertexPositionData;
+	std::vector<uint8_t> vertexExtraData;
+	std::vector<uint8_t> indexData;
+	std::vector<MeshletData> meshletData;
+};
+
 class MeshFactory
 {
 private:
@@ -20,74 +36,105 @@ public:
 	BufferHandle indexBuffer;
 	BufferHandle vertexPositionBuffer;  // Stores vertex positions.
 	BufferHandle vertexExtraBuffer;  // Stores all other vertex attributes.
+	BufferHandle meshletBuffer;  // Stores the meshlets of every subset, index offsets are relative to the subset.
 
 private:
 	size_t indexOffset = 0;
 	size_t vertexPositionOffset = 0;
 	size_t vertexExtrasOffset = 0;
+	size_t meshletOffset = 0;
+	size_t maxMeshlets = 0;
 
-	uint32_t SearchVertexChannel(const std::string& name);
-	PrimitiveOffset AllocateMesh(const std::vector<uint8_t>& vertexPositionData, const std::vector<uint8_t>& vertexExtraData, const std::vector<uint8_t>& indexData);
+	static uint32_t SearchVertexChannel(const std::string& name);
+	// Quantized formats of the mesh's channels, subsets share the vertex layout. Returns the mask of channels derived instead of stored.
+	static uint32_t SelectVertexFormats(const std::vector<PrimitiveAssembly>& assemblies, uint32_t* formats);
+	PrimitiveOffset AllocateMesh(std::span<const uint8_t> vertexPositionData, std::span<const uint8_t> vertexExtraData, std::span<const uint8_t> indexData, std::span<const MeshletData> meshletData);
 
 public:
-	MeshFactory(RenderDevice* inDevice, size_t maxVertices, size_t maxIndices);
+	MeshFactory(RenderDevice* inDevice, size_t maxVertices, size_t maxIndices, size_t inMaxMeshlets);
 	~MeshFactory();
 
-	inline MeshComponent CreateMeshComponent(const std::vector<PrimitiveAssembly>& assemblies, const std::vector<size_t>& materials, const std::vector<uint32_t>& materialIndices, const std::vector<float>& boundingSpheres);
+	// Doesn't need a device, so meshes can be laid out offline. Extras are stored as floats unless quantized.
+	static inline MeshData BuildMeshData(const std::vector<PrimitiveAssembly>& assemblies, const std::vector<uint32_t>& materialIndices, const std::vector<BoundingVolume>& bounds, const std::vector<std::vector<MeshletData>>& meshlets, const std::vector<std::vector<MeshLod>>& lods, bool quantize);
+	// Uploads a mesh laid out by BuildMeshData. Subset material indices must already be into the material buffer.
+	MeshComponent CreateMeshComponent(const VertexMetadata& metadata, std::span<const MeshComponent::Subset> subsets, std::span<const uint8_t> vertexPositionData, std::span<const uint8_t> vertexExtraData, std::span<const uint8_t> indexData, std::span<const MeshletData> meshletData);
 };
 
-inline MeshComponent MeshFactory::CreateMeshComponent(const std::vector<PrimitiveAssembly>& assemblies, const std::vector<size_t>& materials, const std::vector<uint32_t>& materialIndices, const std::vector<float>& boundingSpheres)
+inline MeshData MeshFactory::BuildMeshData(const std::vector<PrimitiveAssembly>& assemblies, const std::vector<uint32_t>& materialIndices, const std::vector<BoundingVolume>& bounds, const std::vector<std::vector<MeshletData>>& meshlets, const std::vector<std::vector<MeshLod>>& lods, bool quantize)
 {
-	VGScopedCPUStat("Create Mesh Component");
+	VGScopedCPUStat("Build Mesh Data");
 
-	MeshComponent component;
-	std::vector<uint8_t> vertexPositionData{};
-	std::vector<uint8_t> vertexExtraData{};
-	std::vector<uint8_t> indexData{};
+	MeshData result;
+	auto& vertexPositionData = result.vertexPositionData;
+	auto& vertexExtraData = result.vertexExtraData;
+	auto& indexData = result.indexData;
+	auto& meshletData = result.meshletData;
 
 	// Create the bitmask of active channels and compute the strides/offsets for just the first assembly.
 	// This implies the assumption that all mesh subsets within a mesh component have the same vertex layout.
+	uint32_t formats[vertexChannels] = { 0 };
+	const auto derivedChannels = quantize ? SelectVertexFormats(assemblies, formats) : 0;
+
+	// Extra streams in the order they're interleaved, streams without a channel or after the first of their channel are kept as floats.
+	struct ExtraStream
+	{
+		std::string name;
+		uint32_t format;
+	};
+	std::vector<ExtraStream> extraStreams;
+
 	uint32_t channelMask = 1 << vertexChannelPosition;
+	uint32_t formatMask = 0;
 	uint32_t strides[vertexChannels] = { 0 };
 	uint32_t offsets[vertexChannels] = { 0 };
 	size_t offset = 0;
 	for (const auto& [name, stream] : assemblies.front().vertexStream)
 	{
 		const auto channelIndex = SearchVertexChannel(name);
-		channelMask |= 1 << channelIndex;
-		const auto attributeSize = assemblies.front().GetAttributeSize(name);
-		offsets[channelIndex] = offset;
-		// The position channel offset doesn't affect the extras buffer.
-		if (channelIndex > 0)
+		const auto attributeSize = static_cast<uint32_t>(assemblies.front().GetAttributeSize(name));
+		if (channelIndex == vertexChannelPosition)
 		{
-			offset += attributeSize;
+			// Position channel has an isolated stride, its offset doesn't affect the extras buffer.
+			strides[channelIndex] = attributeSize;
+			continue;
 		}
-	}
 
-	for (const auto& [name, stream] : assemblies.front().vertexStream)
-	{
-		const auto channelIndex = SearchVertexChannel(name);
-		if (channelIndex > 0)
+		if (channelIndex < vertexChannels && (derivedChannels & (1 << channelIndex)))
 		{
-			strides[channelIndex] = offset;
+			continue;
 		}
 
-		else
+		const auto stored = channelIndex < vertexChannels && !(channelMask & (1 << channelIndex));
+		const auto format = stored ? formats[channelIndex] : vertexFormatFloat;
+		extraStreams.emplace_back(ExtraStream{ name, format });
+
+		if (stored)
 		{
-			// Position channel has an isolated stride.
-			strides[channelIndex] = assemblies.front().GetAttributeSize(name);
+			channelMask |= 1 << channelIndex;
+			formatMask |= format << (channelIndex * 4);
+			offsets[channelIndex] = offset;
 		}
+
+		offset += VertexQuantization::GetSize(format, attributeSize);
+	}
+
+	for (uint32_t i = 1; i < vertexChannels; ++i)
+	{
+		strides[i] = channelMask & (1 << i) ? offset : 0;
 	}
 
 	VGAssert(offsets[vertexChannelPosition] == 0, "Incorrect vertex position offset.");
-	component.metadata.activeChannels = channelMask;
+	result.metadata.activeChannels = channelMask;
+	result.metadata.channelFormats = formatMask;
 	for (int i = 0; i < vertexChannels; ++i)
 	{
-		component.metadata.channelStrides[i / 4][i % 4] = strides[i];
-		component.metadata.channelOffsets[i / 4][i % 4] = offsets[i];
+		result.metadata.channelStrides[i / 4][i % 4] = strides[i];
+		result.metadata.channelOffsets[i / 4][i % 4] = offsets[i];
 	}
 
-	component.subsets.reserve(assemblies.size());
+	const auto extraSize = offset;
+
+	result.subsets.reserve(assemblies.size());
 
 	uint32_t index = 0;
 	for (const auto& assembly : assemblies)
@@ -95,7 +142,8 @@ inline MeshComponent MeshFactory::CreateMeshComponent(const std::vector<Primitiv
 		PrimitiveOffset localOffset{
 			.index = indexData.size(),
 			.position = vertexPositionData.size(),
-			.extra = vertexExtraData.size()
+			.extra = vertexExtraData.size(),
+			.meshlet = meshletData.size()
 		};
 
 		const std::string positionName = "POSITION";
@@ -107,29 +155,40 @@ inline MeshComponent MeshFactory::CreateMeshComponent(const std::vector<Primitiv
 		vertexPositionData.resize(vertexPositionData.size() + vertexCount * assembly.GetAttributeSize(positionName));
 		std::memcpy(vertexPositionData.data() + localOffset.position, assembly.GetAttributeData(positionName), vertexPositionData.size() - localOffset.position);
 
-		size_t extraSize = 0;
-		for (const auto& [name, stream] : assembly.vertexStream)
-		{
-			if (name != positionName)
-			{
-				VGAssert(assembly.GetAttributeCount(name) == vertexCount, "Mismatched vertex attribute counts.");
-				extraSize += assembly.GetAttributeSize(name);
-			}
-		}
-
 		vertexExtraData.resize(vertexExtraData.size() + vertexCount * extraSize);
 
+		// The stored bitangent only provides the sign once it's derived.
+		const auto* normals = assembly.vertexStream.contains("NORMAL") ? reinterpret_cast<const XMFLOAT3*>(assembly.GetAttributeData("NORMAL")) : nullptr;
+		const auto* bitangents = (derivedChannels & (1 << vertexChannelBitangent)) && assembly.vertexStream.contains("BITANGENT") ?
+			reinterpret_cast<const XMFLOAT3*>(assembly.GetAttributeData("BITANGENT")) : nullptr;
+		const auto bitangentSize = bitangents ? assembly.GetAttributeSize("BITANGENT") : 0;
+
 		// Interleave attributes.
+		for (const auto& stream : extraStreams)
+		{
+			VGAssert(assembly.GetAttributeCount(stream.name) == vertexCount, "Mismatched vertex attribute counts.");
+		}
+
 		for (size_t i = 0; i < vertexCount; ++i)
 		{
-			size_t attributeOffset = 0;
-			for (const auto& [name, stream] : assembly.vertexStream)
+			auto* vertex = vertexExtraData.data() + localOffset.extra + i * extraSize;
+			for (const auto& stream : extraStreams)
 			{
-				if (name != positionName)
+				const auto attributeSize = static_cast<uint32_t>(assembly.GetAttributeSize(stream.name));
+				const auto* attribute = reinterpret_cast<const float*>(assembly.GetAttributeData(stream.name) + i * attributeSize);
+
+				if (stream.format == vertexFormatOctahedralSign && bitangents && normals)
+				{
+					const auto& bitangent = *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const uint8_t*>(bitangents) + i * bitangentSize);
+					const auto derived = XMVector3Cross(XMLoadFloat3(&normals[i]), XMVectorSet(attribute[0], attribute[1], attribute[2], 0.f));
+					const auto sign = XMVectorGetX(XMVector3Dot(derived, XMLoadFloat3(&bitangent))) < 0.f ? -1.f : 1.f;
+					const float tangent[] = { attribute[0], attribute[1], attribute[2], sign };
+					vertex += VertexQuantization::Encode(stream.format, tangent, sizeof(tangent), vertex);
+				}
+
+				else
 				{
-					const size_t attributeSize = assembly.GetAttributeSize(name);
-					std::memcpy(vertexExtraData.data() + localOffset.extra + i * extraSize + attributeOffset, assembly.GetAttributeData(name) + i * attributeSize, attributeSize);
-					attributeOffset += attributeSize;
+					vertex += VertexQuantization::Encode(stream.format, attribute, attributeSize, vertex);
 				}
 			}
 		}
@@ -137,15 +196,20 @@ inline MeshComponent MeshFactory::CreateMeshComponent(const std::vector<Primitiv
 		indexData.resize(indexData.size() + assembly.indexStream.size_bytes());
 		std::memcpy(indexData.data() + localOffset.index, assembly.indexStream.data(), indexData.size() - localOffset.index);
 
-		if (materials.size() > 0)
-			component.subsets.emplace_back(localOffset, assembly.indexStream.size(), materials[materialIndices[index]], boundingSpheres[index]);
-		else
-			component.subsets.emplace_back(localOffset, assembly.indexStream.size(), 0, boundingSpheres[index]);
+		meshletData.insert(meshletData.end(), meshlets[index].begin(), meshlets[index].end());
+
+		// Simplified levels are stored after the full detail indices, which are all the subset draws by default.
+		const auto& subsetLods = lods[index];
+		VGAssert(subsetLods.size() <= maxMeshLods, "Too many mesh LODs.");
+		const auto indexCount = subsetLods.size() > 0 ? subsetLods[0].indexCount : assembly.indexStream.size();
+
+		result.subsets.emplace_back(localOffset, indexCount, materialIndices[index], bounds[index], meshlets[index].size());
+
+		std::copy(subsetLods.begin(), subsetLods.end(), result.subsets.back().lods.begin());
+		result.subsets.back().lodCount = subsetLods.size();
 
 		++index;
 	}
 
-	component.globalOffset = AllocateMesh(vertexPositionData, vertexExtraData, indexData);
-
-	return component;
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,267 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/MeshLods.h>
+#include <Rendering/TestMeshes.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string_view>
+
+namespace MeshLods
+{
+	void Build(std::span<const uint32_t> indices, const XMFLOAT3* positions, size_t vertexCount, const Settings& settings, BuildOutput& output)
+	{
+		VGScopedCPUStat("Build Mesh LODs");
+
+		VGAssert(indices.size() % 3 == 0, "LODs can only be built from triangle lists.");
+
+		output.indices.assign(indices.begin(), indices.end());
+		output.lods.clear();
+		output.lods.emplace_back(MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.f });
+
+		if (indices.empty())
+		{
+			return;
+		}
+
+		// Simplification errors are relative to the mesh extent.
+		const auto scale = meshopt_simplifyScale(&positions->x, vertexCount, sizeof(XMFLOAT3));
+		const auto levels = std::min<uint32_t>(settings.levels, maxMeshLods);
+
+		std::vector<uint32_t> simplified(indices.size());
+		auto targetError = settings.baseError;
+
+		for (uint32_t level = 1; level < levels; ++level)
+		{
+			// Each level simplifies the previous one, which is much cheaper than starting over from full detail.
+			const auto previous = output.lods.back();
+			const auto targetCount = static_cast<size_t>(previous.indexCount * settings.ratio) / 3 * 3;
+
+			float resultError = 0.f;
+			const auto count = meshopt_simplify(simplified.data(), output.indices.data() + previous.indexOffset, previous.indexCount, &positions->x,
+				vertexCount, sizeof(XMFLOAT3), targetCount, targetError, &resultError);
+
+			// Stop once simplification stalls, the level wouldn't be worth its memory.
+			if (count == 0 || count > previous.indexCount * settings.minimumReduction)
+			{
+				break;
+			}
+
+			// Errors of successive simplifications accumulate.
+			output.lods.emplace_back(MeshLod{ static_cast<uint32_t>(output.indices.size()), static_cast<uint32_t>(count), previous.error + resultError * scale });
+			output.indices.insert(output.indices.end(), simplified.begin(), simplified.begin() + count);
+
+			targetError *= settings.errorGrowth;
+		}
+	}
+
+	float ComputeLodScale(float viewWidth, float fieldOfView, float pixelError)
+	{
+		if (pixelError <= 0.f)
+		{
+			return 0.f;
+		}
+
+		return viewWidth / (2.f * std::tan(fieldOfView * 0.5f)) / pixelError;
+	}
+
+	uint32_t Select(std::span<const MeshLod> lods, float distance, float maxScale, float lodScale)
+	{
+		if (lodScale <= 0.f)
+		{
+			return 0;
+		}
+
+		const auto pixelsPerUnit = maxScale * lodScale / distance;
+
+		uint32_t lod = 0;
+		for (uint32_t i = 1; i < lods.size(); ++i)
+		{
+			if (lods[i].error * pixelsPerUnit <= 1.f)
+			{
+				lod = i;
+			}
+		}
+
+		return lod;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Mesh LOD Test");
+
+		Seed({ 9753 });
+
+		TestReport report{ logRendering, VGText("Mesh LOD") };
+
+		const Settings settings{};
+
+		const std::pair<const char*, TestMeshes::Mesh> meshes[] = {
+			{ "sphere", TestMeshes::Sphere(64, 128) },
+			{ "terrain", TestMeshes::Terrain(96, 2.f) },
+			{ "flat", TestMeshes::Terrain(64, 0.f) },
+			{ "soup", TestMeshes::Soup(2000, 3000) }
+		};
+
+		for (const auto& [name, mesh] : meshes)
+		{
+			BuildOutput output;
+			Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), settings, output);
+
+			report.Check(output.lods.size() >= 1 && output.lods.size() <= settings.levels, "{}: level count out of range", name);
+			report.Check(output.lods[0].indexOffset == 0 && output.lods[0].indexCount == mesh.indices.size() && output.lods[0].error == 0.f, "{}: first level isn't the full detail mesh", name);
+			report.Check(std::equal(mesh.indices.begin(), mesh.indices.end(), output.indices.begin()), "{}: full detail indices were modified", name);
+
+			for (size_t level = 1; level < output.lods.size(); ++level)
+			{
+				const auto& previous = output.lods[level - 1];
+				const auto& lod = output.lods[level];
+
+				report.Check(lod.indexOffset == previous.indexOffset + previous.indexCount && lod.indexOffset + lod.indexCount <= output.indices.size(), "{}: levels aren't contiguous", name);
+				report.Check(lod.indexCount % 3 == 0 && lod.indexCount > 0, "{}: level isn't a triangle list", name);
+				report.Check(lod.indexCount <= previous.indexCount * settings.minimumReduction, "{}: level doesn't reduce the previous level enough", name);
+				report.Check(lod.error >= previous.error, "{}: level errors must not decrease", name);
+
+				bool valid = true;
+				bool outwards = true;
+				for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i += 3)
+				{
+					valid = valid && output.indices[i] < mesh.positions.size() && output.indices[i + 1] < mesh.positions.size() && output.indices[i + 2] < mesh.positions.size();
+					if (!valid)
+						break;
+
+					const auto pointA = XMLoadFloat3(&mesh.positions[output.indices[i]]);
+					const auto pointB = XMLoadFloat3(&mesh.positions[output.indices[i + 1]]);
+					const auto pointC = XMLoadFloat3(&mesh.positions[output.indices[i + 2]]);
+					const auto normal = XMVector3Cross(pointB - pointA, pointC - pointA);
+
+					// The sphere is centered on the origin, simplification must not flip its triangles inwards.
+					outwards = outwards && XMVectorGetX(XMVector3Dot(normal, pointA + pointB + pointC)) >= -1e-6f;
+				}
+
+				report.Check(valid, "{}: level references vertices outside of the mesh", name);
+				report.Check(outwards || std::string_view{ name } != "sphere", "{}: level flipped triangles", name);
+			}
+
+			if (std::string_view{ name } == "sphere")
+			{
+				report.Check(output.lods.size() == settings.levels, "{}: smooth mesh should produce every level", name);
+			}
+
+			if (std::string_view{ name } == "flat")
+			{
+				// Removing vertices from a plane doesn't move the surface.
+				report.Check(output.lods.size() > 1 && output.lods.back().error < 1e-3f, "{}: flat grid should simplify without error", name);
+			}
+		}
+
+		{
+			Settings singleLevel{};
+			singleLevel.levels = 1;
+
+			BuildOutput output;
+			const auto& sphere = meshes[0].second;
+			Build(sphere.indices, sphere.positions.data(), sphere.positions.size(), singleLevel, output);
+			report.Check(output.lods.size() == 1 && output.indices.size() == sphere.indices.size(), "sphere: single level settings produced simplified levels");
+		}
+
+		// Selection, against a hand made chain with an unusable last level.
+		const MeshLod lods[] = {
+			{ 0, 300, 0.f },
+			{ 300, 150, 0.01f },
+			{ 450, 75, 0.04f },
+			{ 525, 36, std::numeric_limits<float>::max() }
+		};
+
+		const auto lodScale = ComputeLodScale(1000.f, XM_PIDIV2, 1.f);
+		report.Check(std::abs(lodScale - 500.f) < 1e-2f, "selection: lod scale of a 90 degree view");
+		report.Check(ComputeLodScale(1000.f, XM_PIDIV2, 0.f) == 0.f, "selection: zero pixel error should disable simplified levels");
+		report.Check(Select(lods, 1.f, 1.f, 0.f) == 0, "selection: zero lod scale should select full detail");
+		report.Check(Select(lods, 1e6f, 1.f, lodScale) == 2, "selection: distant instances should select the coarsest usable level");
+
+		uint32_t previousLod = 0;
+		bool monotonic = true;
+		bool bounded = true;
+		for (float distance = 0.1f; distance < 100.f; distance *= 1.1f)
+		{
+			const auto maxScale = 2.f;
+			const auto lod = Select(lods, distance, maxScale, lodScale);
+			const auto pixelsPerUnit = maxScale * lodScale / distance;
+
+			monotonic = monotonic && lod >= previousLod;
+			bounded = bounded && lods[lod].error * pixelsPerUnit <= 1.f && (lod == 2 || lods[lod + 1].error * pixelsPerUnit > 1.f);
+			previousLod = lod;
+		}
+
+		report.Check(monotonic, "selection: levels must get coarser with distance");
+		report.Check(bounded, "selection: selected level isn't the coarsest within the pixel error");
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Mesh LOD Benchmark");
+
+		constexpr size_t instanceCount = 10'000;
+
+		Seed({ 3579 });
+
+		const std::pair<const char*, TestMeshes::Mesh> meshes[] = {
+			{ "sphere", TestMeshes::Sphere(512, 512) },
+			{ "terrain", TestMeshes::Terrain(512, 2.f) }
+		};
+
+		const Settings settings{};
+
+		// Instances spread out in front of a 1080p camera with a 90 degree field of view, like props scattered across a level.
+		const auto lodScale = ComputeLodScale(1920.f, XM_PIDIV2, 1.f);
+
+		for (const auto& [name, mesh] : meshes)
+		{
+			BuildOutput output;
+
+			const auto buildBegin = std::chrono::high_resolution_clock::now();
+			Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), settings, output);
+			const auto buildEnd = std::chrono::high_resolution_clock::now();
+
+			const auto fullTriangles = output.lods[0].indexCount / 3;
+			VGLog(logRendering, "Mesh LOD benchmark ({}): {} levels from {} triangles in {:.3f} ms.", name, output.lods.size(), fullTriangles,
+				std::chrono::duration<double, std::milli>(buildEnd - buildBegin).count());
+
+			for (size_t level = 1; level < output.lods.size(); ++level)
+			{
+				const auto triangles = output.lods[level].indexCount / 3;
+				VGLog(logRendering, "  Level {}: {} triangles ({:.1f}% of full detail), error {:.5f}.", level, triangles, 100.0 * triangles / fullTriangles, output.lods[level].error);
+			}
+
+			const auto extent = meshopt_simplifyScale(&mesh.positions[0].x, mesh.positions.size(), sizeof(XMFLOAT3));
+
+			size_t selectedTriangles = 0;
+			std::vector<size_t> histogram(output.lods.size(), 0);
+			for (size_t i = 0; i < instanceCount; ++i)
+			{
+				const auto maxScale = (float)Rand(0.5, 2.0);
+				const auto distance = std::max((float)Rand(1.0, 200.0) * extent - extent * 0.5f * maxScale, 0.1f);
+				const auto lod = Select(output.lods, distance, maxScale, lodScale);
+
+				selectedTriangles += output.lods[lod].indexCount / 3;
+				++histogram[lod];
+			}
+
+			VGLog(logRendering, "  {} instances at 1 to 200 extents away draw {:.1f}% of the full detail triangles.", instanceCount,
+				100.0 * selectedTriangles / (fullTriangles * instanceCount));
+
+			for (size_t level = 0; level < histogram.size(); ++level)
+			{
+				VGLog(logRendering, "  Level {}: {} instances.", level, histogram[level]);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/RenderComponents.h>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Simplified levels of detail for mesh subsets. Every level indexes the full detail vertices, only the index buffer grows.
+// Levels are picked per instance and view in the culling shader, from how large the level's error appears on screen.
+namespace MeshLods
+{
+	struct Settings
+	{
+		uint32_t levels = maxMeshLods;  // Including the full detail level.
+		float baseError = 0.01f;  // Target error of the first simplified level, relative to the mesh extent.
+		float errorGrowth = 4.f;  // Each further level may deviate this much more.
+		float ratio = 0.5f;  // Target index count of each level relative to the previous one.
+		float minimumReduction = 0.85f;  // Levels keeping more of the previous level's indices than this are discarded, ending the chain.
+	};
+
+	struct BuildOutput
+	{
+		std::vector<uint32_t> indices;  // Every level back to back, starting with the unmodified input.
+		std::vector<MeshLod> lods;
+	};
+
+	void Build(std::span<const uint32_t> indices, const XMFLOAT3* positions, size_t vertexCount, const Settings& settings, BuildOutput& output);
+
+	// Pixels per world unit at a distance of one, divided by the error in pixels that is allowed. Zero disables simplified levels.
+	// The field of view is horizontal, like the camera's.
+	float ComputeLodScale(float viewWidth, float fieldOfView, float pixelError);
+
+	// CPU reference of the culling shader's selection. The coarsest level whose error covers at most a pixel (after the lod
+	// scale), at the distance to the nearest point of the instance's bounding sphere.
+	uint32_t Select(std::span<const MeshLod> lods, float distance, float maxScale, float lodScale);
+
+	// Headless checks of the simplification chain and level selection, on procedural meshes.
+	void Test();
+	// CPU-only measurement of simplification throughput, triangle reduction per level and the triangles saved by selection
+	// over a field of instances, results are logged.
+	void Benchmark();
+}
\ No newline at end of file
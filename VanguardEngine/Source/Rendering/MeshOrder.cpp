@@ -0,0 +1,293 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/MeshOrder.h>
+#include <Rendering/TestMeshes.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <numeric>
+#include <string_view>
+
+namespace MeshOrder
+{
+	Statistics& Statistics::operator+=(const Statistics& other)
+	{
+		triangles += other.triangles;
+		vertices += other.vertices;
+		transformedVertices += other.transformedVertices;
+		fetchedBytes += other.fetchedBytes;
+		vertexBytes += other.vertexBytes;
+
+		return *this;
+	}
+
+	Statistics Analyze(std::span<const uint32_t> indices, size_t vertexCount, size_t vertexSize)
+	{
+		Statistics result;
+		if (indices.empty())
+		{
+			return result;
+		}
+
+		// meshoptimizer's ratios are relative to the vertex count, which includes unused vertices.
+		std::vector<bool> used(vertexCount, false);
+		for (const auto index : indices)
+		{
+			used[index] = true;
+		}
+
+		const auto cache = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize, 0, 0);
+		const auto fetch = meshopt_analyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexSize);
+
+		result.triangles = indices.size() / 3;
+		result.vertices = std::count(used.begin(), used.end(), true);
+		result.transformedVertices = cache.vertices_transformed;
+		result.fetchedBytes = fetch.bytes_fetched;
+		result.vertexBytes = result.vertices * vertexSize;
+
+		return result;
+	}
+
+	void OptimizeTriangles(std::span<uint32_t> indices, const XMFLOAT3* positions, size_t vertexCount)
+	{
+		VGScopedCPUStat("Optimize Triangle Order");
+
+		VGAssert(indices.size() % 3 == 0, "Triangle order can only be optimized for triangle lists.");
+
+		if (indices.empty())
+		{
+			return;
+		}
+
+		meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+		meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(), &positions->x, vertexCount, sizeof(XMFLOAT3), overdrawThreshold);
+	}
+
+	void OptimizeVertexCache(std::span<uint32_t> indices)
+	{
+		VGAssert(indices.size() % 3 == 0, "Triangle order can only be optimized for triangle lists.");
+
+		if (indices.empty())
+		{
+			return;
+		}
+
+		// meshoptimizer's cost scales with the vertex count, renumber the range's vertices so that small ranges stay cheap.
+		std::vector<uint32_t> vertices{ indices.begin(), indices.end() };
+		std::sort(vertices.begin(), vertices.end());
+		vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+		std::vector<uint32_t> localIndices;
+		localIndices.reserve(indices.size());
+		for (const auto index : indices)
+		{
+			localIndices.emplace_back(static_cast<uint32_t>(std::lower_bound(vertices.begin(), vertices.end(), index) - vertices.begin()));
+		}
+
+		meshopt_optimizeVertexCache(localIndices.data(), localIndices.data(), localIndices.size(), vertices.size());
+
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			indices[i] = vertices[localIndices[i]];
+		}
+	}
+
+	size_t OptimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount, std::vector<uint32_t>& remap)
+	{
+		VGScopedCPUStat("Optimize Vertex Fetch");
+
+		remap.resize(vertexCount);
+		if (indices.empty())
+		{
+			std::fill(remap.begin(), remap.end(), ~0u);
+
+			return 0;
+		}
+
+		const auto usedCount = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
+		meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+
+		return usedCount;
+	}
+
+	void RemapVertices(void* output, const void* input, size_t vertexCount, size_t vertexSize, std::span<const uint32_t> remap)
+	{
+		VGAssert(remap.size() == vertexCount, "Remap table doesn't match the vertex stream.");
+
+		meshopt_remapVertexBuffer(output, input, vertexCount, vertexSize, remap.data());
+	}
+
+	// Triangles and vertices in random order, like assets exported without any optimization. Adds unused vertices.
+	TestMeshes::Mesh Shuffle(const TestMeshes::Mesh& mesh, size_t unusedVertices)
+	{
+		TestMeshes::Mesh result;
+
+		std::vector<uint32_t> vertexOrder(mesh.positions.size() + unusedVertices);
+		std::iota(vertexOrder.begin(), vertexOrder.end(), 0);
+		for (size_t i = vertexOrder.size() - 1; i > 0; --i)
+		{
+			std::swap(vertexOrder[i], vertexOrder[Rand(0, static_cast<int>(i))]);
+		}
+
+		result.positions.resize(vertexOrder.size());
+		for (size_t i = 0; i < vertexOrder.size(); ++i)
+		{
+			result.positions[vertexOrder[i]] = i < mesh.positions.size() ? mesh.positions[i] : XMFLOAT3{ (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0) };
+		}
+
+		std::vector<uint32_t> triangleOrder(mesh.indices.size() / 3);
+		std::iota(triangleOrder.begin(), triangleOrder.end(), 0);
+		for (size_t i = triangleOrder.size() - 1; i > 0; --i)
+		{
+			std::swap(triangleOrder[i], triangleOrder[Rand(0, static_cast<int>(i))]);
+		}
+
+		result.indices.reserve(mesh.indices.size());
+		for (const auto triangle : triangleOrder)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				result.indices.emplace_back(vertexOrder[mesh.indices[triangle * 3 + corner]]);
+			}
+		}
+
+		return result;
+	}
+
+	// Corner positions of each triangle, rotated so that the smallest corner leads, sorted. Equal if the same triangles are
+	// drawn with the same winding, whatever the vertex order.
+	std::vector<std::array<std::array<float, 3>, 3>> Canonicalize(std::span<const uint32_t> indices, const XMFLOAT3* positions)
+	{
+		std::vector<std::array<std::array<float, 3>, 3>> triangles;
+		triangles.reserve(indices.size() / 3);
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			auto& triangle = triangles.emplace_back();
+			for (size_t corner = 0; corner < 3; ++corner)
+			{
+				const auto& position = positions[indices[i + corner]];
+				triangle[corner] = { position.x, position.y, position.z };
+			}
+
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+
+		return triangles;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Mesh Order Test");
+
+		Seed({ 2468 });
+
+		TestReport report{ logRendering, VGText("Mesh order") };
+
+		const std::pair<const char*, TestMeshes::Mesh> meshes[] = {
+			{ "sphere", Shuffle(TestMeshes::Sphere(48, 96), 100) },
+			{ "terrain", Shuffle(TestMeshes::Terrain(96, 2.f), 100) },
+			{ "soup", Shuffle(TestMeshes::Soup(4000, 6000), 100) }
+		};
+
+		for (const auto& [name, mesh] : meshes)
+		{
+			const auto vertexCount = mesh.positions.size();
+			const auto before = Analyze(mesh.indices, vertexCount, sizeof(XMFLOAT3));
+
+			auto cacheIndices = mesh.indices;
+			OptimizeVertexCache(cacheIndices);
+			const auto cacheOnly = Analyze(cacheIndices, vertexCount, sizeof(XMFLOAT3));
+
+			auto indices = mesh.indices;
+			OptimizeTriangles(indices, mesh.positions.data(), vertexCount);
+			const auto triangleOrder = Analyze(indices, vertexCount, sizeof(XMFLOAT3));
+
+			report.Check(Canonicalize(indices, mesh.positions.data()) == Canonicalize(mesh.indices, mesh.positions.data()), "{}: reordered triangles don't match the input", name);
+			report.Check(Canonicalize(cacheIndices, mesh.positions.data()) == Canonicalize(mesh.indices, mesh.positions.data()), "{}: cache ordered triangles don't match the input", name);
+			report.Check(cacheOnly.GetAcmr() < before.GetAcmr(), "{}: vertex cache order didn't lower the ACMR", name);
+			// Overdraw clustering only splits the cache order at a threshold per cluster, allow some slack on the whole mesh.
+			report.Check(triangleOrder.GetAcmr() <= cacheOnly.GetAcmr() * overdrawThreshold * 1.05f, "{}: overdraw clustering raised the ACMR past its threshold", name);
+
+			// Connected meshes reach close to one transform per vertex.
+			report.Check(std::string_view{ name } == "soup" || triangleOrder.GetAtvr() < 1.5f, "{}: vertex cache order is far from optimal", name);
+
+			std::vector<uint32_t> remap;
+			const auto usedCount = OptimizeVertexFetch(indices, vertexCount, remap);
+
+			std::vector<XMFLOAT3> positions(usedCount);
+			RemapVertices(positions.data(), mesh.positions.data(), vertexCount, sizeof(XMFLOAT3), remap);
+
+			report.Check(usedCount == before.vertices && usedCount + 100 <= vertexCount, "{}: unused vertices weren't dropped", name);
+			report.Check(Canonicalize(indices, positions.data()) == Canonicalize(mesh.indices, mesh.positions.data()), "{}: remapped vertices don't match the input", name);
+
+			// Vertices are numbered by first use.
+			uint32_t nextVertex = 0;
+			bool firstUseOrder = true;
+			for (const auto index : indices)
+			{
+				firstUseOrder = firstUseOrder && index <= nextVertex;
+				nextVertex = std::max(nextVertex, index + 1);
+			}
+			report.Check(firstUseOrder, "{}: vertices aren't ordered by first use", name);
+
+			const auto after = Analyze(indices, usedCount, sizeof(XMFLOAT3));
+			report.Check(after.GetOverfetch() < before.GetOverfetch(), "{}: vertex fetch order didn't lower the overfetch", name);
+			report.Check(after.transformedVertices == triangleOrder.transformedVertices, "{}: vertex fetch order changed the cache behavior", name);
+		}
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Mesh Order Benchmark");
+
+		Seed({ 9753 });
+
+		// Position with the extras of a typical imported vertex, normal, texcoord and tangent.
+		constexpr size_t vertexSize = sizeof(XMFLOAT3) * 2 + sizeof(XMFLOAT2) + sizeof(XMFLOAT4);
+
+		const std::pair<const char*, TestMeshes::Mesh> meshes[] = {
+			{ "sphere", TestMeshes::Sphere(512, 512) },
+			{ "shuffled sphere", Shuffle(TestMeshes::Sphere(512, 512), 0) },
+			{ "shuffled terrain", Shuffle(TestMeshes::Terrain(512, 2.f), 0) }
+		};
+
+		for (const auto& [name, mesh] : meshes)
+		{
+			const auto vertexCount = mesh.positions.size();
+			const auto before = Analyze(mesh.indices, vertexCount, vertexSize);
+
+			auto indices = mesh.indices;
+			std::vector<uint32_t> remap;
+			std::vector<uint8_t> vertices(vertexCount * vertexSize);
+			std::vector<uint8_t> remapped(vertexCount * vertexSize);
+
+			const auto trianglesBegin = std::chrono::high_resolution_clock::now();
+			OptimizeTriangles(indices, mesh.positions.data(), vertexCount);
+			const auto trianglesEnd = std::chrono::high_resolution_clock::now();
+			const auto usedCount = OptimizeVertexFetch(indices, vertexCount, remap);
+			RemapVertices(remapped.data(), vertices.data(), vertexCount, vertexSize, remap);
+			const auto fetchEnd = std::chrono::high_resolution_clock::now();
+
+			const auto after = Analyze(indices, usedCount, vertexSize);
+			const auto overdrawBefore = meshopt_analyzeOverdraw(mesh.indices.data(), mesh.indices.size(), &mesh.positions[0].x, vertexCount, sizeof(XMFLOAT3));
+			std::vector<XMFLOAT3> positions(usedCount);
+			RemapVertices(positions.data(), mesh.positions.data(), vertexCount, sizeof(XMFLOAT3), remap);
+			const auto overdrawAfter = meshopt_analyzeOverdraw(indices.data(), indices.size(), &positions[0].x, usedCount, sizeof(XMFLOAT3));
+
+			VGLog(logRendering, "Mesh order benchmark ({}): {} triangles, triangle order in {:.3f} ms, vertex fetch order in {:.3f} ms.", name, before.triangles,
+				std::chrono::duration<double, std::milli>(trianglesEnd - trianglesBegin).count(), std::chrono::duration<double, std::milli>(fetchEnd - trianglesEnd).count());
+			VGLog(logRendering, "  ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}, overdraw {:.3f} -> {:.3f}.", before.GetAcmr(), after.GetAcmr(),
+				before.GetAtvr(), after.GetAtvr(), before.GetOverfetch(), after.GetOverfetch(), overdrawBefore.overdraw, overdrawAfter.overdraw);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Reorders mesh subsets at import so that the GPU does less work drawing them, without changing what's drawn. Triangles are
+// ordered for the post-transform vertex cache, then clustered to reduce overdraw where that costs little cache efficiency.
+// Vertices are ordered by first use, so that vertex fetches are close to sequential, and unused vertices are dropped.
+namespace MeshOrder
+{
+	constexpr uint32_t cacheSize = 16;  // FIFO post-transform cache modeled by the statistics.
+	constexpr float overdrawThreshold = 1.05f;  // Overdraw clustering may raise the ACMR by this factor.
+
+	struct Statistics
+	{
+		size_t triangles = 0;
+		size_t vertices = 0;  // Referenced by the triangles.
+		size_t transformedVertices = 0;  // Vertex shader invocations under the modeled cache.
+		size_t fetchedBytes = 0;  // Whole cache lines, under meshoptimizer's fetch model.
+		size_t vertexBytes = 0;  // Of the referenced vertices.
+
+		// Average cache miss ratio, vertices transformed per triangle. Between 0.5 and 3, lower is better.
+		float GetAcmr() const { return triangles > 0 ? static_cast<float>(transformedVertices) / triangles : 0.f; }
+		// Average transformed vertex ratio, vertices transformed per referenced vertex. 1 at best.
+		float GetAtvr() const { return vertices > 0 ? static_cast<float>(transformedVertices) / vertices : 0.f; }
+		// Bytes fetched per byte of vertex data. 1 at best.
+		float GetOverfetch() const { return vertexBytes > 0 ? static_cast<float>(fetchedBytes) / vertexBytes : 0.f; }
+
+		Statistics& operator+=(const Statistics& other);
+	};
+
+	// Vertex size is the bytes of all vertex streams of one vertex.
+	Statistics Analyze(std::span<const uint32_t> indices, size_t vertexCount, size_t vertexSize);
+
+	// Vertex cache order, then overdraw clustering. In place, the winding of each triangle is kept.
+	void OptimizeTriangles(std::span<uint32_t> indices, const XMFLOAT3* positions, size_t vertexCount);
+	// Vertex cache order only, for index ranges whose clustering must be kept, like meshlets. In place, the cost scales with
+	// the range rather than the mesh.
+	void OptimizeVertexCache(std::span<uint32_t> indices);
+	// Orders vertices by first use in the indices, which are remapped in place. Fills the remap table from old to new vertices for
+	// RemapVertices, unused vertices map to ~0u. Returns the number of used vertices.
+	size_t OptimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount, std::vector<uint32_t>& remap);
+	// Reorders a vertex stream with a table from OptimizeVertexFetch, the output holds the used vertices.
+	void RemapVertices(void* output, const void* input, size_t vertexCount, size_t vertexSize, std::span<const uint32_t> remap);
+
+	// Headless checks that reordering keeps the drawn triangles and vertex data, and improves the cache and fetch statistics.
+	void Test();
+	// CPU-only measurement of reordering throughput and the ACMR and overfetch before and after, on procedural meshes in
+	// random order, results are logged.
+	void Benchmark();
+}
\ No newline at end of file
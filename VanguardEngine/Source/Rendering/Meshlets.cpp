@@ -0,0 +1,288 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/Meshlets.h>
+#include <Rendering/TestMeshes.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string_view>
+
+namespace Meshlets
+{
+	void Build(std::span<const uint32_t> indices, const XMFLOAT3* positions, size_t vertexCount, BuildOutput& output)
+	{
+		VGScopedCPUStat("Build Meshlets");
+
+		VGAssert(indices.size() % 3 == 0, "Meshlets can only be built from triangle lists.");
+
+		output.meshlets.clear();
+		output.indices.clear();
+
+		if (indices.empty())
+		{
+			return;
+		}
+
+		const auto maxMeshlets = meshopt_buildMeshletsBound(indices.size(), maxVertices, maxTriangles);
+		std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+		std::vector<uint32_t> meshletVertices(maxMeshlets * maxVertices);
+		std::vector<uint8_t> meshletTriangles(maxMeshlets * maxTriangles * 3);
+
+		const auto meshletCount = meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices.data(), indices.size(),
+			&positions->x, vertexCount, sizeof(XMFLOAT3), maxVertices, maxTriangles, coneWeight);
+
+		output.meshlets.reserve(meshletCount);
+		output.indices.reserve(indices.size());
+
+		for (size_t i = 0; i < meshletCount; ++i)
+		{
+			const auto& meshlet = meshlets[i];
+			const auto bounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset], &meshletTriangles[meshlet.triangle_offset],
+				meshlet.triangle_count, &positions->x, vertexCount, sizeof(XMFLOAT3));
+
+			output.meshlets.emplace_back(MeshletData{
+				.center = { bounds.center[0], bounds.center[1], bounds.center[2] },
+				.radius = bounds.radius,
+				.coneApex = { bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2] },
+				.coneCutoff = bounds.cone_cutoff,
+				.coneAxis = { bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2] },
+				.indexOffset = static_cast<uint32_t>(output.indices.size()),
+				.indexCount = meshlet.triangle_count * 3
+			});
+
+			for (uint32_t j = 0; j < meshlet.triangle_count * 3; ++j)
+			{
+				output.indices.emplace_back(meshletVertices[meshlet.vertex_offset + meshletTriangles[meshlet.triangle_offset + j]]);
+			}
+		}
+	}
+
+	bool IsConeCulled(const MeshletData& meshlet, const XMMATRIX& worldMatrix, const XMFLOAT3& cameraPosition)
+	{
+		// Degenerate cones have a cutoff of one, the triangles face too many directions.
+		if (meshlet.coneCutoff >= 1.f)
+		{
+			return false;
+		}
+
+		// Test in object space, which side of a triangle the camera is on doesn't change under affine transforms. The inverse
+		// is built from the cofactors of the upper 3x3, matching the shader.
+		const auto cofactor0 = XMVector3Cross(worldMatrix.r[1], worldMatrix.r[2]);
+		const auto cofactor1 = XMVector3Cross(worldMatrix.r[2], worldMatrix.r[0]);
+		const auto cofactor2 = XMVector3Cross(worldMatrix.r[0], worldMatrix.r[1]);
+		const auto determinant = XMVectorGetX(XMVector3Dot(worldMatrix.r[0], cofactor0));
+
+		// Mirroring transforms flip the winding, the cone would describe the back faces.
+		if (determinant <= 0.f)
+		{
+			return false;
+		}
+
+		const auto relativeCamera = XMVectorSubtract(XMLoadFloat3(&cameraPosition), worldMatrix.r[3]);
+		const auto objectCamera = XMVectorScale(XMVectorSet(
+			XMVectorGetX(XMVector3Dot(relativeCamera, cofactor0)),
+			XMVectorGetX(XMVector3Dot(relativeCamera, cofactor1)),
+			XMVectorGetX(XMVector3Dot(relativeCamera, cofactor2)),
+			0.f), 1.f / determinant);
+
+		const auto direction = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&meshlet.coneApex), objectCamera));
+
+		return XMVectorGetX(XMVector3Dot(direction, XMLoadFloat3(&meshlet.coneAxis))) >= meshlet.coneCutoff;
+	}
+
+	XMMATRIX RandomTransform(bool mirrored)
+	{
+		const auto scale = XMMatrixScaling((float)Rand(0.25, 4.0) * (mirrored ? -1.f : 1.f), (float)Rand(0.25, 4.0), (float)Rand(0.25, 4.0));
+		const auto rotation = XMMatrixRotationRollPitchYaw((float)Rand(-XM_PI, XM_PI), (float)Rand(-XM_PI, XM_PI), (float)Rand(-XM_PI, XM_PI));
+		const auto translation = XMMatrixTranslation((float)Rand(-50.0, 50.0), (float)Rand(-50.0, 50.0), (float)Rand(-50.0, 50.0));
+
+		return scale * rotation * translation;
+	}
+
+	XMFLOAT3 RandomDirection()
+	{
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet((float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), 0.f)));
+
+		return direction;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Meshlet Test");
+
+		Seed({ 1357 });
+
+		TestReport report{ logRendering, VGText("Meshlet") };
+
+		const std::pair<const char*, TestMeshes::Mesh> meshes[] = {
+			{ "sphere", TestMeshes::Sphere(48, 96) },
+			{ "terrain", TestMeshes::Terrain(96, 2.f) },
+			{ "soup", TestMeshes::Soup(4000, 6000) }
+		};
+
+		for (const auto& [name, mesh] : meshes)
+		{
+			BuildOutput output;
+			Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), output);
+
+			report.Check(output.indices.size() == mesh.indices.size(), "{}: meshlet indices don't cover the input", name);
+
+			uint32_t nextIndex = 0;
+			for (const auto& meshlet : output.meshlets)
+			{
+				report.Check(meshlet.indexOffset == nextIndex && meshlet.indexCount % 3 == 0, "{}: meshlet index ranges aren't contiguous triangles", name);
+				report.Check(meshlet.indexCount / 3 <= maxTriangles, "{}: meshlet exceeds the triangle limit", name);
+				nextIndex = meshlet.indexOffset + meshlet.indexCount;
+
+				std::vector<uint32_t> vertices{ output.indices.begin() + meshlet.indexOffset, output.indices.begin() + meshlet.indexOffset + meshlet.indexCount };
+				std::sort(vertices.begin(), vertices.end());
+				vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+				report.Check(vertices.size() <= maxVertices, "{}: meshlet exceeds the vertex limit", name);
+
+				bool contained = true;
+				const auto center = XMLoadFloat3(&meshlet.center);
+				for (const auto vertex : vertices)
+				{
+					const auto distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&mesh.positions[vertex]) - center));
+					contained = contained && distance <= meshlet.radius * 1.001f + 1e-4f;
+				}
+				report.Check(contained, "{}: meshlet bounding sphere doesn't contain its vertices", name);
+			}
+
+			// Same triangles with the same winding, rotated so that the smallest index leads.
+			const auto Canonicalize = [](const std::vector<uint32_t>& indices)
+			{
+				std::vector<std::array<uint32_t, 3>> triangles;
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					std::array<uint32_t, 3> triangle{ indices[i], indices[i + 1], indices[i + 2] };
+					std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+					triangles.emplace_back(triangle);
+				}
+				std::sort(triangles.begin(), triangles.end());
+				return triangles;
+			};
+			report.Check(Canonicalize(mesh.indices) == Canonicalize(output.indices), "{}: reordered triangles don't match the input", name);
+
+			// Every triangle of a culled meshlet must face away from the camera.
+			size_t culledMeshlets = 0;
+			for (int transformIndex = 0; transformIndex < 16; ++transformIndex)
+			{
+				const auto worldMatrix = RandomTransform(false);
+				const auto mirroredMatrix = RandomTransform(true);
+
+				for (int cameraIndex = 0; cameraIndex < 16; ++cameraIndex)
+				{
+					const auto direction = RandomDirection();
+					const auto distance = (float)Rand(1.0, 400.0);
+					XMFLOAT3 cameraPosition;
+					XMStoreFloat3(&cameraPosition, worldMatrix.r[3] + XMLoadFloat3(&direction) * distance);
+					const auto camera = XMLoadFloat3(&cameraPosition);
+
+					bool conservative = true;
+					bool mirroredCulled = false;
+					for (const auto& meshlet : output.meshlets)
+					{
+						mirroredCulled = mirroredCulled || IsConeCulled(meshlet, mirroredMatrix, cameraPosition);
+
+						if (!IsConeCulled(meshlet, worldMatrix, cameraPosition))
+						{
+							continue;
+						}
+
+						++culledMeshlets;
+
+						for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i += 3)
+						{
+							const auto pointA = XMVector3TransformCoord(XMLoadFloat3(&mesh.positions[output.indices[i]]), worldMatrix);
+							const auto pointB = XMVector3TransformCoord(XMLoadFloat3(&mesh.positions[output.indices[i + 1]]), worldMatrix);
+							const auto pointC = XMVector3TransformCoord(XMLoadFloat3(&mesh.positions[output.indices[i + 2]]), worldMatrix);
+							const auto normal = XMVector3Cross(pointB - pointA, pointC - pointA);
+							const auto toCamera = camera - pointA;
+							const auto tolerance = 1e-4f * XMVectorGetX(XMVector3Length(normal)) * XMVectorGetX(XMVector3Length(toCamera));
+
+							conservative = conservative && XMVectorGetX(XMVector3Dot(normal, toCamera)) <= tolerance;
+						}
+					}
+
+					report.Check(conservative, "{}: cone culled a meshlet with a front facing triangle", name);
+					report.Check(!mirroredCulled, "{}: cone culled a meshlet under a mirroring transform", name);
+				}
+			}
+
+			// Random soup has no coherent normals, the other meshes must cull something.
+			report.Check(culledMeshlets > 0 || std::string_view{ name } == "soup", "{}: no meshlets were ever cone culled", name);
+		}
+
+		report.Log();
+	}
+
+	void Benchmark()
+	{
+		VGScopedCPUStat("Meshlet Benchmark");
+
+		constexpr int cameraCount = 256;
+
+		Seed({ 8642 });
+
+		const std::pair<const char*, TestMeshes::Mesh> meshes[] = {
+			{ "sphere", TestMeshes::Sphere(512, 512) },
+			{ "terrain", TestMeshes::Terrain(512, 2.f) }
+		};
+
+		for (const auto& [name, mesh] : meshes)
+		{
+			BuildOutput output;
+
+			const auto buildBegin = std::chrono::high_resolution_clock::now();
+			Build(mesh.indices, mesh.positions.data(), mesh.positions.size(), output);
+			const auto buildEnd = std::chrono::high_resolution_clock::now();
+
+			const auto triangleCount = mesh.indices.size() / 3;
+			VGLog(logRendering, "Meshlet benchmark ({}): {} triangles into {} meshlets in {:.3f} ms, {:.1f} triangles per meshlet.", name, triangleCount,
+				output.meshlets.size(), std::chrono::duration<double, std::milli>(buildEnd - buildBegin).count(), (double)triangleCount / output.meshlets.size());
+
+			// Cameras all around the mesh, outside of its bounds.
+			XMFLOAT3 center{};
+			float radius = 0.f;
+			for (const auto& position : mesh.positions)
+			{
+				center.x += position.x / mesh.positions.size();
+				center.y += position.y / mesh.positions.size();
+				center.z += position.z / mesh.positions.size();
+			}
+			for (const auto& position : mesh.positions)
+			{
+				radius = std::max(radius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&center))));
+			}
+
+			size_t rejectedTriangles = 0;
+			const auto cullBegin = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < cameraCount; ++i)
+			{
+				const auto direction = RandomDirection();
+				const auto distance = radius * (float)Rand(1.5, 4.0);
+				const XMFLOAT3 cameraPosition{ center.x + direction.x * distance, center.y + direction.y * distance, center.z + direction.z * distance };
+
+				for (const auto& meshlet : output.meshlets)
+				{
+					if (IsConeCulled(meshlet, XMMatrixIdentity(), cameraPosition))
+					{
+						rejectedTriangles += meshlet.indexCount / 3;
+					}
+				}
+			}
+			const auto cullEnd = std::chrono::high_resolution_clock::now();
+
+			const auto cullMilliseconds = std::chrono::duration<double, std::milli>(cullEnd - cullBegin).count();
+			VGLog(logRendering, "Meshlet benchmark ({}): cone culling rejected {:.1f}% of triangles on average, {:.1f} meshlet tests/ms.", name,
+				100.0 * rejectedTriangles / (triangleCount * cameraCount), (double)output.meshlets.size() * cameraCount / cullMilliseconds);
+		}
+	}
+}
\ No newline at end of file
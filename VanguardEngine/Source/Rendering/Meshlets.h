@@ -0,0 +1,36 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Splits mesh subsets into small clusters of triangles, each with a bounding sphere and a normal cone, so that culling can
+// reject parts of a mesh. Meshlets are contiguous index ranges of their subset, drawing the whole subset is unaffected.
+namespace Meshlets
+{
+	constexpr size_t maxVertices = 64;
+	constexpr size_t maxTriangles = 124;
+	constexpr float coneWeight = 0.25f;  // Trades spatial compactness for tighter normal cones.
+
+	struct BuildOutput
+	{
+		std::vector<MeshletData> meshlets;
+		std::vector<uint32_t> indices;  // Input triangles reordered so that each meshlet is a contiguous range.
+	};
+
+	// Triangles must be counter-clockwise, normal cones face the same way as the front faces.
+	void Build(std::span<const uint32_t> indices, const XMFLOAT3* positions, size_t vertexCount, BuildOutput& output);
+
+	// CPU reference of the culling shader's normal cone test. True if every triangle in the meshlet faces away from the camera.
+	bool IsConeCulled(const MeshletData& meshlet, const XMMATRIX& worldMatrix, const XMFLOAT3& cameraPosition);
+
+	// Headless checks of the meshlet build and the cone test, on procedural meshes.
+	void Test();
+	// CPU-only measurement of meshlet build throughput and the fraction of triangles rejected by cone culling, results are logged.
+	void Benchmark();
+}
\ No newline at end of file
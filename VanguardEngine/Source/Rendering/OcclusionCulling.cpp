@@ -6,12 +6,21 @@
 #include <Rendering/RenderPass.h>
 #include <Utility/Math.h>
 
-#include <cmath>
+#include <algorithm>
 
 uint32_t OcclusionCulling::GetMipLevels(RenderGraph& graph)
+{
+	const auto levels = SinglePassDownsampler::ComputeLevels(GetHiZSize(graph));
+	const auto requestedLevels = std::max((uint32_t)*CvarGet("hiZPyramidLevels", int), 2u);  // The downsampler generates at least one mip.
+	return std::min({ levels, requestedLevels, SinglePassDownsampler::maxLevels });
+}
+
+XMUINT2 OcclusionCulling::GetHiZSize(RenderGraph& graph)
 {
 	const auto [backBufferWidth, backBufferHeight] = graph.GetBackBufferResolution(device);
-	return std::min((int)std::floor(std::log2(std::max(backBufferWidth, backBufferHeight))) + 1, *CvarGet("hiZPyramidLevels", int));
+
+	// Previous power of 2 to ensure conservative culling.
+	return { PreviousPowerOf2(backBufferWidth), PreviousPowerOf2(backBufferHeight) };
 }
 
 void OcclusionCulling::Initialize(RenderDevice* inDevice)
@@ -19,10 +28,9 @@ void OcclusionCulling::Initialize(RenderDevice* inDevice)
 	CvarCreate("hiZPyramidLevels", "Maximum number of mipmaps to generate for the depth pyramid, used in occlusion culling", 16);
 
 	device = inDevice;
-	lastFrameHiZ.id = 0;
+	hiZ.id = 0;
 
-	hiZLayout = RenderPipelineLayout{}
-		.ComputeShader({ "GenerateHiZ", "Main" });  // Similar to generate mips, but enough differences to warrant a new shader.
+	hiZDownsampler.Initialize(device, DownsampleReduction::Minimum, true);
 
 #if ENABLE_EDITOR
 	debugOverlayLayout = RenderPipelineLayout{}
@@ -31,9 +39,9 @@ void OcclusionCulling::Initialize(RenderDevice* inDevice)
 #endif
 }
 
-void OcclusionCulling::Render(RenderGraph& graph, bool cameraFrozen, const RenderResource depthStencilTag)
+RenderResource OcclusionCulling::Render(RenderGraph& graph, bool cameraFrozen, const RenderResource depthStencilTag)
 {
-	const auto [backBufferWidth, backBufferHeight] = graph.GetBackBufferResolution(device);
+	const auto hiZSize = GetHiZSize(graph);
 	auto hiZMipLevels = GetMipLevels(graph);
 
 	TextureView hiZView{};
@@ -47,62 +55,31 @@ void OcclusionCulling::Render(RenderGraph& graph, bool cameraFrozen, const Rende
 
 	auto& hiZPass = graph.AddPass("Hierarchical Z Pass", ExecutionQueue::Compute, !cameraFrozen);  // Disable Hi-Z updates when frozen.
 	auto hiZTag = hiZPass.Create(TransientTextureDescription{
-		// Previous power of 2 to ensure conservative culling.
-		.width = PreviousPowerOf2(backBufferWidth),
-		.height = PreviousPowerOf2(backBufferHeight),
+		.width = hiZSize.x,
+		.height = hiZSize.y,
 		.format = DXGI_FORMAT_R32_FLOAT,
 		.mipMapping = true
 	}, VGText("Hi-Z Depth pyramid"));
+	const auto counterTag = hiZDownsampler.ImportCounter(graph);
 	hiZPass.Read(depthStencilTag, ResourceBind::SRV);
 	hiZPass.Write(hiZTag, hiZView);
-	hiZPass.Bind([&, hiZTag, depthStencilTag, hiZMipLevels, hiZViewNames](CommandList& list, RenderPassResources& resources)
+	hiZPass.Write(counterTag, ResourceBind::UAV);
+	hiZPass.Bind([&, hiZTag, depthStencilTag, counterTag, hiZSize, hiZViewNames](CommandList& list, RenderPassResources& resources)
 	{
-		list.BindPipeline(hiZLayout);
-
-		struct {
-			uint32_t mipBase;
-			uint32_t mipCount;
-			XMFLOAT2 texelSize;
-			uint32_t outputTextureIndices[4];
-			uint32_t inputTextureIndex;
-		} bindData;
-
-		auto& depthComponent = device->GetResourceManager().Get(resources.GetTexture(depthStencilTag));
-		const auto mipDispatches = static_cast<uint32_t>(std::ceil(hiZMipLevels / 4.f));
-		for (int i = 0; i < mipDispatches; ++i)
+		// The whole pyramid in one dispatch, the depth is resampled into the first level.
+		std::vector<uint32_t> levelTextures;
+		levelTextures.reserve(hiZViewNames.size());
+		for (const auto& viewName : hiZViewNames)
 		{
-			const auto baseMipWidth = NextPowerOf2(depthComponent.description.width) >> i * 4;
-			const auto baseMipHeight = NextPowerOf2(depthComponent.description.height) >> i * 4;
-
-			bindData.mipBase = i * 4;  // Starting mip.
-			bindData.mipCount = std::min(hiZMipLevels - bindData.mipBase, 4u);  // How many mips to generate (0, 4].
-			bindData.texelSize = { 2.f / baseMipWidth, 2.f / baseMipHeight };
-
-			// First dispatch we read from the depth source.
-			if (i == 0)
-				bindData.inputTextureIndex = resources.Get(depthStencilTag);
-			else
-				bindData.inputTextureIndex = resources.Get(hiZTag, hiZViewNames[i * 4 - 1]);
-
-			for (int j = 0; j < bindData.mipCount; ++j)
-			{
-				bindData.outputTextureIndices[j] = resources.Get(hiZTag, hiZViewNames[i * 4 + j]);
-			}
-
-			list.BindConstants("bindData", bindData);
-
-			const auto dispatchX = std::max((uint32_t)std::ceil(baseMipWidth / (2.f * 8.f)), 1u);
-			const auto dispatchY = std::max((uint32_t)std::ceil(baseMipHeight / (2.f * 8.f)), 1u);
-			const auto dispatchZ = 1;
-
-			list.Dispatch(dispatchX, dispatchY, dispatchZ);
-			list.UAVBarrier(resources.GetTexture(hiZTag));
-			list.FlushBarriers();
+			levelTextures.emplace_back(resources.Get(hiZTag, viewName));
 		}
+
+		hiZDownsampler.Downsample(list, resources.Get(depthStencilTag), resources.Get(counterTag), hiZSize, levelTextures);
 	});
 
-	++swapCount;
-	lastFrameHiZ = hiZTag;
+	hiZ = hiZTag;
+
+	return hiZTag;
 }
 
 RenderResource OcclusionCulling::RenderDebugOverlay(RenderGraph& graph, int mipLevel, const RenderResource cameraBufferTag)
@@ -115,7 +92,7 @@ RenderResource OcclusionCulling::RenderDebugOverlay(RenderGraph& graph, int mipL
 	const auto debugOverlayTag = overlayPass.Create(TransientTextureDescription{
 		.format = DXGI_FORMAT_R16G16B16A16_FLOAT
 	}, VGText("Occlusion culling debug overlay"));
-	overlayPass.Read(lastFrameHiZ, hiZView);
+	overlayPass.Read(hiZ, hiZView);
 	overlayPass.Read(cameraBufferTag, ResourceBind::SRV);
 	overlayPass.Output(debugOverlayTag, OutputBind::RTV, LoadType::Preserve);
 	overlayPass.Bind([&, debugOverlayTag, cameraBufferTag](CommandList& list, RenderPassResources& resources)
@@ -129,7 +106,7 @@ RenderResource OcclusionCulling::RenderDebugOverlay(RenderGraph& graph, int mipL
 			uint32_t cameraIndex;
 		} bindData;
 
-		bindData.hiZTexture = resources.Get(lastFrameHiZ);
+		bindData.hiZTexture = resources.Get(hiZ);
 		bindData.cameraBuffer = resources.Get(cameraBufferTag);
 		bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
 
@@ -5,6 +5,7 @@
 #include <Rendering/Base.h>
 #include <Rendering/RenderPipeline.h>
 #include <Rendering/RenderGraphResource.h>
+#include <Rendering/SinglePassDownsampler.h>
 
 class RenderDevice;
 class RenderGraph;
@@ -13,10 +14,9 @@ class OcclusionCulling
 {
 private:
 	RenderDevice* device;
-	uint32_t swapCount = 0;
-	RenderResource lastFrameHiZ;
+	RenderResource hiZ;  // Built this frame, from the depth of the early culling phase.
 
-	RenderPipelineLayout hiZLayout;
+	SinglePassDownsampler hiZDownsampler;  // Min reduction of the resampled depth.
 
 #if ENABLE_EDITOR
 	// Debugging visualizations.
@@ -25,17 +25,11 @@ private:
 
 	// How many total levels we want, not mips to generate.
 	uint32_t GetMipLevels(RenderGraph& graph);
+	XMUINT2 GetHiZSize(RenderGraph& graph);
 
 public:
 	void Initialize(RenderDevice* inDevice);
-	RenderResource GetLastFrameHiZ();
-	void Render(RenderGraph& graph, bool cameraFrozen, const RenderResource depthStencilTag);
+	// Returns the depth pyramid, for testing the late culling phase against this frame's depth.
+	RenderResource Render(RenderGraph& graph, bool cameraFrozen, const RenderResource depthStencilTag);
 	RenderResource RenderDebugOverlay(RenderGraph& graph, int mipLevel, const RenderResource cameraBufferTag);
-};
-
-inline RenderResource OcclusionCulling::GetLastFrameHiZ()
-{
-	VGAssert(swapCount % 2 == 0, "Occlusion culling Render() called before GetLastFrameHiZ().");
-	++swapCount;
-	return lastFrameHiZ;
-}
\ No newline at end of file
+};
\ No newline at end of file
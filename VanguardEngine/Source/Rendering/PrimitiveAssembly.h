@@ -76,4 +76,17 @@ public:
 			return reinterpret_cast<uint8_t*>(arg.data());
 		}, vertexStream.at(std::string{ name }));
 	}
+
+	// Calls the function with the name and span of every vertex stream, spans can be replaced with streams of the same type.
+	template <typename Function>
+	void ForEachVertexStream(Function&& function)
+	{
+		for (auto& [name, stream] : vertexStream)
+		{
+			std::visit([&](auto& view)
+			{
+				function(std::string_view{ name }, view);
+			}, stream);
+		}
+	}
 };
\ No newline at end of file
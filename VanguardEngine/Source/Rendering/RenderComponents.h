@@ -7,16 +7,18 @@
 #include <Rendering/ShaderStructs.h>
 
 #include <vector>
+#include <array>
 
 struct PrimitiveOffset
 {
 	size_t index = 0;
 	size_t position = 0;
 	size_t extra = 0;
+	size_t meshlet = 0;  // In meshlets, not bytes.
 
 	PrimitiveOffset operator+(const PrimitiveOffset& other) const
 	{
-		return { index + other.index, position + other.position, extra + other.extra };
+		return { index + other.index, position + other.position, extra + other.extra, meshlet + other.meshlet };
 	}
 
 	PrimitiveOffset& operator+=(const PrimitiveOffset& other)
@@ -26,6 +28,24 @@ struct PrimitiveOffset
 	}
 };
 
+constexpr size_t maxMeshLods = 4;  // Including the full detail level.
+
+struct MeshLod
+{
+	uint32_t indexOffset;  // In indices, relative to the first index of the subset.
+	uint32_t indexCount;
+	float error;  // Object space distance the simplified surface may deviate from the full detail surface.
+};
+
+// Object space bounds of a mesh subset. The sphere is centered on the geometry rather than the object origin.
+struct BoundingVolume
+{
+	XMFLOAT3 boxMin;
+	XMFLOAT3 boxMax;
+	XMFLOAT3 sphereCenter;
+	float sphereRadius;
+};
+
 // #TODO: Array of mesh materials bound to vertex/index offsets to enable multiple materials per mesh.
 struct MeshComponent
 {
@@ -34,7 +54,10 @@ struct MeshComponent
 		PrimitiveOffset localOffset;
 		size_t indices;
 		size_t materialIndex;
-		float boundingSphereRadius;
+		BoundingVolume bounds;
+		size_t meshlets = 0;  // Zero if the subset wasn't split into meshlets.
+		std::array<MeshLod, maxMeshLods> lods{};  // First entry is the full detail level.
+		size_t lodCount = 0;  // Zero if no levels were generated, the subset is only drawn at full detail.
 	};
 
 	std::vector<Subset> subsets;
@@ -18,11 +18,11 @@ void RenderGraph::BuildAdjacencyLists()
 	{
 		const auto& outer = passes[i];
 
-		for (int j = 0; j < passes.size(); ++j)
+		// Dependencies only point to passes declared later, so passes execute in declaration order. A pass that reads a resource
+		// before a later pass writes it gets a read-to-write edge and sees the previous contents, which is how persistent resources
+		// carry data across frames without forming a cycle.
+		for (int j = i + 1; j < passes.size(); ++j)
 		{
-			if (i == j)
-				continue;
-
 			const auto& inner = passes[j];
 
 			std::vector<RenderResource> intersection;
@@ -53,7 +53,12 @@ void RenderGraph::BuildAdjacencyLists()
 				std::set_intersection(outer->writes.cbegin(), outer->writes.cend(), preservingWrites.cbegin(), preservingWrites.cend(), std::back_inserter(intersection));
 			}
 
-			// If there's a write-to-read or write-to-write dependency, create an edge.
+			if (intersection.size() == 0)
+			{
+				std::set_intersection(outer->reads.cbegin(), outer->reads.cend(), inner->writes.cbegin(), inner->writes.cend(), std::back_inserter(intersection));
+			}
+
+			// If there's a write-to-read, write-to-write or read-to-write dependency, create an edge.
 			if (intersection.size() > 0)
 			{
 				adjacencyLists[i].emplace_back(j);
@@ -62,42 +67,22 @@ void RenderGraph::BuildAdjacencyLists()
 	}
 }
 
-void RenderGraph::DepthFirstSearch(size_t node, std::vector<bool>& visited, std::stack<size_t>& stack)
-{
-	if (visited[node])
-		return;
-
-	visited[node] = true;
-
-	for (const auto adjacentNode : adjacencyLists[node])
-	{
-		DepthFirstSearch(adjacentNode, visited, stack);
-	}
-
-	stack.push(node);
-}
-
 void RenderGraph::TopologicalSort()
 {
 	VGScopedCPUStat("Topological Sort");
 
 	sorted.reserve(passes.size());  // Most passes are unlikely to be trimmed.
 
-	std::vector<bool> visited(passes.size(), false);
-	std::stack<size_t> stack;
-
-	for (int i = 0; i < passes.size(); ++i)
+	// Every edge points to a later pass, so declaration order is already a topological order. Keeping it is what makes passes
+	// that read before a later write see the previous contents.
+	for (size_t i = 0; i < passes.size(); ++i)
 	{
-		if (!visited[i])
+		for (const auto adjacentPass : adjacencyLists[i])
 		{
-			DepthFirstSearch(i, visited, stack);
+			VGAssert(adjacentPass > i, "Render graph edges must point to later passes.");
 		}
-	}
 
-	while (stack.size() > 0)
-	{
-		sorted.push_back(stack.top());
-		stack.pop();
+		sorted.push_back(i);
 	}
 }
 
@@ -10,7 +10,6 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
-#include <stack>
 #include <string_view>
 
 class CommandList;
@@ -41,7 +40,6 @@ private:
 
 private:
 	void BuildAdjacencyLists();
-	void DepthFirstSearch(size_t node, std::vector<bool>& visited, std::stack<size_t>& stack);
 	void TopologicalSort();
 	void BuildDepthMap();
 
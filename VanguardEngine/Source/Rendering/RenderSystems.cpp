@@ -2,6 +2,7 @@
 
 #include <Rendering/RenderSystems.h>
 #include <Rendering/ShaderStructs.h>
+#include <Rendering/SceneBvh.h>
 
 #include <imgui.h>
 
@@ -121,4 +122,27 @@ void TimeOfDaySystem::Update(entt::registry& registry, float deltaTime)
 			break;
 		}
 	});
+}
+
+void SceneBvhSystem::Update(entt::registry& registry)
+{
+	VGScopedCPUStat("Scene BVH System");
+
+	// Nothing queried the scene yet, don't pay for keeping it up to date.
+	if (auto* bvh = registry.try_ctx<SceneBvh>())
+	{
+		bvh->Update(registry);
+	}
+}
+
+SceneBvh& SceneBvhSystem::Get(entt::registry& registry)
+{
+	auto* bvh = registry.try_ctx<SceneBvh>();
+	if (!bvh)
+	{
+		bvh = &registry.set<SceneBvh>(registry);
+		bvh->Update(registry);
+	}
+
+	return *bvh;
 }
\ No newline at end of file
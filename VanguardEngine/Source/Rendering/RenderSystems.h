@@ -5,6 +5,8 @@
 #include <Rendering/Base.h>
 #include <Rendering/Renderer.h>
 #include <Rendering/CommandList.h>
+#include <Rendering/RenderPass.h>
+#include <Rendering/ClusteredLightCulling.h>
 #include <Core/CoreComponents.h>
 #include <Rendering/RenderComponents.h>
 #include <entt/entt.hpp>
@@ -13,11 +15,16 @@
 
 class Renderer;
 class CommandList;
+class SceneBvh;
 
 struct MeshSystem
 {
+	// Draws the culled meshes of a view, the argument and counter buffers are the mesh culling outputs shared by every view.
 	template <typename T>
-	static void Render(Renderer& renderer, const entt::registry& registry, CommandList& list, T& bindData, BufferHandle indirectRenderArgs);
+	static void Render(Renderer& renderer, const entt::registry& registry, CommandList& list, T& bindData, uint32_t view, BufferHandle indirectRenderArgs, BufferHandle indirectRenderCounts);
+	// Draws both culling phases, binding each phase's visible instances. The pass must read every buffer of both phases.
+	template <typename T>
+	static void Render(Renderer& renderer, const entt::registry& registry, CommandList& list, T& bindData, uint32_t view, RenderPassResources& resources, const MeshCullPhases& phases);
 };
 
 struct CameraSystem
@@ -30,13 +37,21 @@ struct TimeOfDaySystem
 	static void Update(entt::registry& registry, float deltaTime);
 };
 
+struct SceneBvhSystem
+{
+	// Keeps the scene BVH up to date once it exists.
+	static void Update(entt::registry& registry);
+	// Scene BVH of the registry, built on first use. Queries see the scene as of the last update.
+	static SceneBvh& Get(entt::registry& registry);
+};
+
 // Hacky macro-based reflection solution since std::reflect isn't out yet.
 VGMakeMemberCheck(materialIndex);
 
 // #TODO: Find a better solution than making this a template.
 
 template <typename T>
-void MeshSystem::Render(Renderer& renderer, const entt::registry& registry, CommandList& list, T& bindData, BufferHandle indirectRenderArgs)
+void MeshSystem::Render(Renderer& renderer, const entt::registry& registry, CommandList& list, T& bindData, uint32_t view, BufferHandle indirectRenderArgs, BufferHandle indirectRenderCounts)
 {
 	auto& indexBuffer = renderer.device->GetResourceManager().Get(renderer.meshFactory->indexBuffer);
 	D3D12_INDEX_BUFFER_VIEW indexView{
@@ -46,11 +61,36 @@ void MeshSystem::Render(Renderer& renderer, const entt::registry& registry, Comm
 	};
 	list.Native()->IASetIndexBuffer(&indexView);
 
-	bindData.cameraIndex = 0;  // #TODO: Support multiple cameras.
+	const auto& renderView = renderer.views.Get(view);
+	VGAssert(renderView.meshSlot != RenderViewSet::invalidSlot, "View doesn't draw meshes.");
+
+	bindData.cameraIndex = renderView.cameraIndex;
 	list.BindConstants("bindData", bindData);
 
-	auto& indirectBuffer = Renderer::Get().device->GetResourceManager().Get(indirectRenderArgs);
-	auto& counterBuffer = Renderer::Get().device->GetResourceManager().Get(indirectBuffer.counterBuffer);
+	auto& indirectBuffer = renderer.device->GetResourceManager().Get(indirectRenderArgs);
+	auto& counterBuffer = renderer.device->GetResourceManager().Get(indirectRenderCounts);
+
+	const auto argumentOffset = renderer.viewCullLayout.ArgumentIndex(renderView.meshSlot) * sizeof(MeshIndirectArgument);
+	const auto countOffset = renderer.viewCullLayout.DrawCountIndex(renderView.meshSlot) * sizeof(uint32_t);
 
-	list.Native()->ExecuteIndirect(Renderer::Get().meshIndirectCommandSignature.Get(), Renderer::Get().renderableCount, indirectBuffer.Native(), 0, counterBuffer.Native(), 0);
+	list.Native()->ExecuteIndirect(renderer.meshIndirectCommandSignature.Get(), renderer.viewCullLayout.TemplateCount(), indirectBuffer.Native(), argumentOffset, counterBuffer.Native(), countOffset);
+
+	// Meshlets that survived culling, one draw each.
+	if (renderer.viewCullLayout.meshletDrawCapacity > 0)
+	{
+		const auto meshletArgumentOffset = renderer.viewCullLayout.MeshletArgumentIndex(renderView.meshSlot) * sizeof(MeshIndirectArgument);
+		const auto meshletCountOffset = renderer.viewCullLayout.MeshletDrawCountIndex(renderView.meshSlot) * sizeof(uint32_t);
+
+		list.Native()->ExecuteIndirect(renderer.meshIndirectCommandSignature.Get(), renderer.viewCullLayout.meshletDrawCapacity, indirectBuffer.Native(), meshletArgumentOffset, counterBuffer.Native(), meshletCountOffset);
+	}
+}
+
+template <typename T>
+void MeshSystem::Render(Renderer& renderer, const entt::registry& registry, CommandList& list, T& bindData, uint32_t view, RenderPassResources& resources, const MeshCullPhases& phases)
+{
+	for (const auto& phase : { phases.early, phases.late })
+	{
+		bindData.visibleInstanceBuffer = resources.Get(phase.visibleInstances);
+		Render(renderer, registry, list, bindData, view, resources.GetBuffer(phase.arguments), resources.GetBuffer(phase.counters));
+	}
 }
\ No newline at end of file
@@ -0,0 +1,289 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/RenderView.h>
+#include <Rendering/MeshLods.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+
+Camera RenderViewSet::CreateCamera(const XMFLOAT3& position, const XMMATRIX& view, const XMMATRIX& projection, const XMMATRIX& lastFrameView,
+	const XMMATRIX& lastFrameProjection, float nearPlane, float farPlane, float fieldOfView, float aspectRatio)
+{
+	return Camera{
+		.position = XMFLOAT4{ position.x, position.y, position.z, 0.f },
+		.view = view,
+		.projection = projection,
+		.inverseView = XMMatrixInverse(nullptr, view),
+		.inverseProjection = XMMatrixInverse(nullptr, projection),
+		.lastFrameView = lastFrameView,
+		.lastFrameProjection = lastFrameProjection,
+		.lastFrameInverseView = XMMatrixInverse(nullptr, lastFrameView),
+		.lastFrameInverseProjection = XMMatrixInverse(nullptr, lastFrameProjection),
+		.nearPlane = nearPlane,
+		.farPlane = farPlane,
+		.fieldOfView = fieldOfView,
+		.aspectRatio = aspectRatio
+	};
+}
+
+void RenderViewSet::Clear()
+{
+	views.clear();
+	cameras.clear();
+	meshViews.clear();
+}
+
+uint32_t RenderViewSet::Add(RenderViewType type, const Camera& camera, uint32_t width, uint32_t height, bool meshes, bool occlusion, bool clusteredLighting, const Camera* cullCamera)
+{
+	VGAssert(cameras.size() + (cullCamera ? 2 : 1) <= maxCameras, "Exceeded the maximum number of view cameras.");
+
+	const auto viewIndex = static_cast<uint32_t>(views.size());
+
+	auto& view = views.emplace_back();
+	view.type = type;
+	view.cameraIndex = static_cast<uint32_t>(cameras.size());
+	view.cullCameraIndex = view.cameraIndex;
+	view.meshSlot = invalidSlot;
+	view.width = width;
+	view.height = height;
+	view.occlusion = meshes && occlusion;
+	view.clusteredLighting = clusteredLighting;
+
+	cameras.emplace_back(camera);
+
+	if (cullCamera)
+	{
+		view.cullCameraIndex = static_cast<uint32_t>(cameras.size());
+		cameras.emplace_back(*cullCamera);
+	}
+
+	if (meshes)
+	{
+		view.meshSlot = static_cast<uint32_t>(meshViews.size());
+		meshViews.emplace_back(viewIndex);
+	}
+
+	return viewIndex;
+}
+
+const RenderView* RenderViewSet::Find(RenderViewType type) const
+{
+	const auto iterator = std::find_if(views.begin(), views.end(), [type](const auto& view) { return view.type == type; });
+	return iterator != views.end() ? &*iterator : nullptr;
+}
+
+std::vector<MeshCullView> RenderViewSet::GetCullViews(float lodPixelError) const
+{
+	std::vector<MeshCullView> cullViews;
+	cullViews.reserve(meshViews.size());
+
+	for (const auto viewIndex : meshViews)
+	{
+		const auto& view = views[viewIndex];
+		const auto& camera = cameras[view.cullCameraIndex];
+		cullViews.emplace_back(MeshCullView{ view.cullCameraIndex, view.occlusion ? 1u : 0u, MeshLods::ComputeLodScale(static_cast<float>(view.width), camera.fieldOfView, lodPixelError) });
+	}
+
+	return cullViews;
+}
+
+ViewCullLayout RenderViewSet::GetCullLayout(uint32_t batchCount, uint32_t instanceCount, uint32_t meshletDrawCapacity, uint32_t lodCount) const
+{
+	return { static_cast<uint32_t>(meshViews.size()), batchCount, instanceCount, meshletDrawCapacity, std::max(lodCount, 1u) };
+}
+
+void RenderViewSet::Test()
+{
+	VGScopedCPUStat("Render View Test");
+
+	Seed({ 2468 });
+
+	TestReport report{ logRendering, VGText("Render view") };
+
+	const auto TestCamera = [](float x)
+	{
+		const auto view = XMMatrixTranslation(x, 0.f, 0.f);
+		const auto projection = XMMatrixPerspectiveFovRH(1.f, 1.f, 0.1f, 100.f);
+		return CreateCamera({ x, 0.f, 0.f }, view, projection, view, projection, 0.1f, 100.f, 1.f, 1.f);
+	};
+
+	// Split screen main view culled with a frozen camera, a shadow view without meshes and a reflection probe.
+	RenderViewSet set;
+	const auto frozenCamera = TestCamera(1.f);
+	const auto main = set.Add(RenderViewType::Main, TestCamera(0.f), 960, 1080, true, true, true, &frozenCamera);
+	const auto shadow = set.Add(RenderViewType::Shadow, TestCamera(2.f), 2048, 2048, false, false, false);
+	const auto split = set.Add(RenderViewType::SplitScreen, TestCamera(3.f), 960, 1080, true, true, true);
+	const auto probe = set.Add(RenderViewType::ReflectionProbe, TestCamera(4.f), 128, 128, true, false, false);
+
+	report.Check(set.GetCount() == 4 && set.GetCameras().size() == 5, "view or camera count mismatch");
+	report.Check(set.Get(main).cameraIndex == 0 && set.Get(main).cullCameraIndex == 1, "main view camera indices");
+	report.Check(set.Get(shadow).cameraIndex == 2 && set.Get(shadow).meshSlot == invalidSlot, "shadow view shouldn't draw meshes");
+	report.Check(set.Get(split).cameraIndex == set.Get(split).cullCameraIndex, "split screen view should cull with its render camera");
+	report.Check(set.Get(probe).occlusion == false, "probe view doesn't use occlusion");
+	report.Check(set.Find(RenderViewType::Shadow) == &set.Get(shadow), "finding the shadow view");
+
+	// Each test camera is offset along x by the index it should be stored at.
+	for (uint32_t i = 0; i < set.GetCount(); ++i)
+	{
+		const auto& view = set.Get(i);
+		report.Check(set.GetCameras()[view.cameraIndex].position.x == static_cast<float>(view.cameraIndex), "render camera stored at the wrong index");
+		report.Check(set.GetCameras()[view.cullCameraIndex].position.x == static_cast<float>(view.cullCameraIndex), "cull camera stored at the wrong index");
+	}
+
+	const auto cullViews = set.GetCullViews(1.f);
+	report.Check(set.GetMeshViews() == std::vector<uint32_t>{ main, split, probe }, "mesh views out of order");
+	report.Check(cullViews.size() == 3 && cullViews[0].cameraIndex == 1 && cullViews[1].cameraIndex == 3 && cullViews[2].cameraIndex == 4, "cull view cameras");
+	report.Check(cullViews.size() == 3 && cullViews[0].occlusion == 1 && cullViews[2].occlusion == 0, "cull view occlusion flags");
+	report.Check(cullViews.size() == 3 && cullViews[0].lodScale > 0.f && set.GetCullViews(0.f)[0].lodScale == 0.f, "cull view lod scale");
+
+	// Random batches, the same shape as InstanceBuilder::Batch() produces. Some instances are split into meshlets.
+	std::vector<uint32_t> firstInstances;
+	std::vector<uint32_t> instanceBatches;
+	std::vector<uint32_t> instanceMeshlets;
+	const auto batchCount = static_cast<uint32_t>(Rand(20, 60));
+	for (uint32_t batch = 0; batch < batchCount; ++batch)
+	{
+		firstInstances.emplace_back(static_cast<uint32_t>(instanceBatches.size()));
+		instanceBatches.resize(instanceBatches.size() + Rand(1, 40), batch);
+		instanceMeshlets.resize(instanceBatches.size(), Rand(0, 3) == 0 ? static_cast<uint32_t>(Rand(2, 12)) : 0);
+	}
+
+	const auto instanceCount = static_cast<uint32_t>(instanceBatches.size());
+	const auto meshletDrawCapacity = static_cast<uint32_t>(Rand(50, 400));  // Small enough to overflow sometimes.
+	const auto lodCount = static_cast<uint32_t>(Rand(1, static_cast<int>(maxMeshLods)));
+	const auto layout = set.GetCullLayout(batchCount, instanceCount, meshletDrawCapacity, lodCount);
+	const auto viewCount = layout.viewCount;
+
+	std::vector<std::vector<uint8_t>> visibility(viewCount, std::vector<uint8_t>(instanceCount));
+	std::vector<std::vector<uint32_t>> instanceLods(viewCount, std::vector<uint32_t>(instanceCount));
+	for (uint32_t slot = 0; slot < viewCount; ++slot)
+	{
+		// Vary the density per view so that empty and full batches both appear.
+		const auto density = Rand(0, 100);
+		for (uint32_t instance = 0; instance < instanceCount; ++instance)
+		{
+			visibility[slot][instance] = Rand(0, 99) < density;
+			instanceLods[slot][instance] = static_cast<uint32_t>(Rand(0, static_cast<int>(lodCount) - 1));
+		}
+	}
+
+	std::vector<uint32_t> counters(layout.CounterCount(), 0);
+	std::vector<uint32_t> visibleInstances(layout.VisibleInstanceCount(), invalidSlot);
+	std::vector<MeshIndirectArgument> arguments(layout.ArgumentCount());
+	std::vector<std::pair<uint32_t, uint32_t>> candidates(layout.CandidateCapacity());  // Instance, view.
+
+	// Culling, one thread per instance testing every view. Visible full detail instances with meshlets are queued instead of batched.
+	for (uint32_t instance = 0; instance < instanceCount; ++instance)
+	{
+		const auto batch = instanceBatches[instance];
+		for (uint32_t slot = 0; slot < viewCount; ++slot)
+		{
+			if (visibility[slot][instance])
+			{
+				const auto lod = instanceLods[slot][instance];
+				if (instanceMeshlets[instance] > 1 && lod == 0)
+				{
+					const auto candidate = counters[layout.CandidateCountIndex()]++;
+					report.Check(candidate < layout.CandidateCapacity(), "meshlet candidates exceed the capacity");
+					candidates[candidate] = { instance, slot };
+					visibleInstances[layout.CandidateInstanceIndex(candidate)] = instance;
+					continue;
+				}
+
+				const auto index = layout.VisibleInstanceIndex(slot, lod) + firstInstances[batch] + counters[layout.InstanceCountIndex(slot, batch, lod)]++;
+				report.Check(visibleInstances[index] == invalidSlot, "visible instance written twice");
+				visibleInstances[index] = instance;
+			}
+		}
+	}
+
+	// Compaction, one thread per view and batch template.
+	for (uint32_t index = 0; index < viewCount * layout.TemplateCount(); ++index)
+	{
+		const auto slot = index / layout.TemplateCount();
+		const auto batch = index % layout.TemplateCount() / lodCount;
+		const auto lod = index % lodCount;
+		const auto count = counters[layout.InstanceCountIndex(slot, batch, lod)];
+		if (count > 0)
+		{
+			auto& argument = arguments[layout.ArgumentIndex(slot) + counters[layout.DrawCountIndex(slot)]++];
+			argument.batchId = layout.VisibleInstanceIndex(slot, lod) + firstInstances[batch];
+			argument.draw.InstanceCount = count;
+			argument.draw.StartIndexLocation = lod;  // Stands in for the level's index range.
+		}
+	}
+
+	// Meshlet culling, every meshlet survives here. Draws past the capacity are dropped.
+	std::vector<uint32_t> expectedMeshletDraws(viewCount, 0);
+	for (uint32_t candidate = 0; candidate < counters[layout.CandidateCountIndex()]; ++candidate)
+	{
+		const auto [instance, slot] = candidates[candidate];
+		expectedMeshletDraws[slot] += instanceMeshlets[instance];
+
+		for (uint32_t meshlet = 0; meshlet < instanceMeshlets[instance]; ++meshlet)
+		{
+			const auto draw = counters[layout.MeshletDrawCountIndex(slot)]++;
+			if (draw < meshletDrawCapacity)
+			{
+				auto& argument = arguments[layout.MeshletArgumentIndex(slot) + draw];
+				argument.batchId = layout.CandidateInstanceIndex(candidate);
+				argument.draw.InstanceCount = 1;
+			}
+		}
+	}
+
+	for (uint32_t slot = 0; slot < viewCount; ++slot)
+	{
+		const auto drawCount = counters[layout.DrawCountIndex(slot)];
+		report.Check(drawCount <= layout.TemplateCount(), "draw count exceeds the view's argument range");
+		report.Check(counters[layout.MeshletDrawCountIndex(slot)] == expectedMeshletDraws[slot], "meshlet draw count mismatch");
+		report.Check(layout.MeshletArgumentIndex(slot) + meshletDrawCapacity == (slot + 1 < viewCount ? layout.ArgumentIndex(slot + 1) : layout.ArgumentCount()), "meshlet arguments overlap the next view");
+
+		std::vector<uint8_t> drawn(instanceCount, 0);
+		for (uint32_t draw = 0; draw < drawCount; ++draw)
+		{
+			const auto& argument = arguments[layout.ArgumentIndex(slot) + draw];
+			const auto lod = argument.draw.StartIndexLocation;
+			const auto begin = argument.batchId;
+			const auto end = begin + argument.draw.InstanceCount;
+			report.Check(begin >= layout.VisibleInstanceIndex(slot, lod) && end <= layout.VisibleInstanceIndex(slot, lod) + instanceCount, "draw reads outside of the view's instance range");
+
+			for (auto i = begin; i < end && i < visibleInstances.size(); ++i)
+			{
+				const auto instance = visibleInstances[i];
+				if (instance < instanceCount)
+				{
+					drawn[instance] = 1;
+					report.Check(firstInstances[instanceBatches[instance]] + layout.VisibleInstanceIndex(slot, lod) == begin, "instance drawn in the wrong batch");
+					report.Check(instanceLods[slot][instance] == lod, "instance drawn at the wrong level of detail");
+				}
+			}
+		}
+
+		const auto meshletDrawCount = std::min(counters[layout.MeshletDrawCountIndex(slot)], meshletDrawCapacity);
+		for (uint32_t draw = 0; draw < meshletDrawCount; ++draw)
+		{
+			const auto& argument = arguments[layout.MeshletArgumentIndex(slot) + draw];
+			report.Check(argument.batchId >= layout.CandidateInstanceIndex(0) && argument.batchId < layout.VisibleInstanceCount(), "meshlet draw reads outside of the candidate range");
+
+			const auto instance = visibleInstances[argument.batchId];
+			if (instance < instanceCount)
+			{
+				report.Check(drawn[instance] != 1, "instance drawn both batched and as meshlets");
+				drawn[instance] = 2;
+			}
+		}
+
+		// Dropped meshlet draws can hide an instance entirely, only check the views that fit.
+		if (counters[layout.MeshletDrawCountIndex(slot)] <= meshletDrawCapacity)
+		{
+			for (auto& state : drawn)
+				state = state > 0;
+			report.Check(drawn == visibility[slot], "drawn instances don't match the view's visibility");
+		}
+	}
+
+	report.Log(fmt::format(" over {} views, {} batches with {} levels, {} instances and {} meshlet candidates", viewCount,
+		batchCount, lodCount, instanceCount, counters[layout.CandidateCountIndex()]));
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+enum class RenderViewType
+{
+	Main,
+	Shadow,
+	ReflectionProbe,
+	SplitScreen
+};
+
+struct RenderView
+{
+	RenderViewType type;
+	uint32_t cameraIndex;  // Camera the view is rendered with.
+	uint32_t cullCameraIndex;  // Camera the view is culled with, differs from the render camera while the camera is frozen.
+	uint32_t meshSlot;  // Position in the mesh culling buffers, invalid if the view doesn't draw meshes.
+	uint32_t width;
+	uint32_t height;
+	bool occlusion;  // Culled in two phases: early draws last frame's visible set without a hi-z test, late tests the rest against this frame's hi-z of the early depth. Only the view that builds the pyramid can use it.
+	bool clusteredLighting;
+};
+
+// Culling phases of views with occlusion culling, must match MeshCulling.hlsl.
+constexpr uint32_t meshCullEarlyPhase = 0;
+constexpr uint32_t meshCullLatePhase = 1;
+
+// Placement of every mesh view's data in the buffers shared by the single culling dispatch. Must match MeshCulling.hlsl.
+// Each batch has one argument template per level of detail, instances are drawn with the template of the level they select.
+struct ViewCullLayout
+{
+	uint32_t viewCount = 0;  // Views that draw meshes.
+	uint32_t batchCount = 0;
+	uint32_t instanceCount = 0;
+	uint32_t meshletDrawCapacity = 0;  // Per view, meshlets beyond this are dropped.
+	uint32_t lodCount = 1;  // Templates per batch.
+
+	uint32_t TemplateIndex(uint32_t batch, uint32_t lod) const { return batch * lodCount + lod; }
+	uint32_t TemplateCount() const { return batchCount * lodCount; }
+
+	// Counters hold the compacted draw count of each view, then the meshlet draw count of each view, then the number of instances
+	// queued for meshlet culling, followed by the visible instance count of each view's batch templates.
+	uint32_t DrawCountIndex(uint32_t slot) const { return slot; }
+	uint32_t MeshletDrawCountIndex(uint32_t slot) const { return viewCount + slot; }
+	uint32_t CandidateCountIndex() const { return 2 * viewCount; }
+	uint32_t InstanceCountIndex(uint32_t slot, uint32_t batch, uint32_t lod) const { return 2 * viewCount + 1 + slot * TemplateCount() + TemplateIndex(batch, lod); }
+	uint32_t CounterCount() const { return 2 * viewCount + 1 + viewCount * TemplateCount(); }
+
+	// Each view owns a full range of arguments, the worst case is every template being visible, followed by its meshlet draws.
+	uint32_t ArgumentIndex(uint32_t slot) const { return slot * (TemplateCount() + meshletDrawCapacity); }
+	uint32_t MeshletArgumentIndex(uint32_t slot) const { return ArgumentIndex(slot) + TemplateCount(); }
+	uint32_t ArgumentCount() const { return viewCount * (TemplateCount() + meshletDrawCapacity); }
+
+	// Each view owns a full copy of the instance ranges for every level, batches keep their offset within it. Instances queued
+	// for meshlet culling are stored after every view's copies, one entry per candidate.
+	uint32_t VisibleInstanceIndex(uint32_t slot, uint32_t lod) const { return (slot * lodCount + lod) * instanceCount; }
+	uint32_t CandidateInstanceIndex(uint32_t candidate) const { return viewCount * lodCount * instanceCount + candidate; }
+	uint32_t CandidateCapacity() const { return viewCount * instanceCount; }
+	uint32_t VisibleInstanceCount() const { return viewCount * (lodCount + 1) * instanceCount; }
+};
+
+// Every view rendered in a frame, and the cameras they use. Rebuilt each frame before the camera buffer is written.
+class RenderViewSet
+{
+public:
+	static constexpr uint32_t invalidSlot = std::numeric_limits<uint32_t>::max();
+	static constexpr uint32_t maxCameras = 16;
+
+private:
+	std::vector<RenderView> views;
+	std::vector<Camera> cameras;
+	std::vector<uint32_t> meshViews;  // View index of each mesh slot.
+
+public:
+	static Camera CreateCamera(const XMFLOAT3& position, const XMMATRIX& view, const XMMATRIX& projection, const XMMATRIX& lastFrameView,
+		const XMMATRIX& lastFrameProjection, float nearPlane, float farPlane, float fieldOfView, float aspectRatio);
+
+	void Clear();
+
+	// Returns the view index. Meshes are culled with the cull camera when provided, otherwise with the render camera.
+	uint32_t Add(RenderViewType type, const Camera& camera, uint32_t width, uint32_t height, bool meshes, bool occlusion, bool clusteredLighting, const Camera* cullCamera = nullptr);
+
+	const RenderView& Get(uint32_t view) const { return views[view]; }
+	// First view of the type, or null.
+	const RenderView* Find(RenderViewType type) const;
+	size_t GetCount() const { return views.size(); }
+
+	const std::vector<Camera>& GetCameras() const { return cameras; }
+	const std::vector<uint32_t>& GetMeshViews() const { return meshViews; }
+	// Levels of detail are selected so that their error covers at most the pixel error, zero disables them.
+	std::vector<MeshCullView> GetCullViews(float lodPixelError) const;
+	ViewCullLayout GetCullLayout(uint32_t batchCount, uint32_t instanceCount, uint32_t meshletDrawCapacity, uint32_t lodCount) const;
+
+	// Headless check of view setup and the culling layout, emulating the culling and compaction dispatches on the CPU.
+	static void Test();
+};
\ No newline at end of file
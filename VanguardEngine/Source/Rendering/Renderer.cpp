@@ -3,15 +3,31 @@
 #include <Rendering/Renderer.h>
 #include <Rendering/Resource.h>
 #include <Core/CoreComponents.h>
+#include <Core/TransformHierarchy.h>
 #include <Rendering/RenderComponents.h>
 #include <Rendering/RenderSystems.h>
+#include <Rendering/SceneBvh.h>
 #include <Rendering/CommandList.h>
 #include <Rendering/RenderGraph.h>
 #include <Rendering/RenderPass.h>
 #include <Rendering/ShaderStructs.h>
 #include <Core/Config.h>
 #include <Rendering/RenderUtils.h>
+#include <Rendering/Meshlets.h>
+#include <Rendering/MeshLods.h>
+#include <Rendering/MeshOrder.h>
+#include <Rendering/VertexQuantization.h>
+#include <Rendering/MeshBounds.h>
+#include <Rendering/ClusterReference.h>
+#include <Rendering/LightHierarchy.h>
+#include <Rendering/CloudReconstruction.h>
+#include <Rendering/AtmosphereReference.h>
+#include <Rendering/EnvironmentSchedule.h>
+#include <Rendering/SinglePassDownsampler.h>
+#include <Rendering/TextureMips.h>
+#include <Rendering/BlockCompression.h>
 #include <Editor/Editor.h>
+#include <Asset/AssetLoader.h>
 #include <Utility/Math.h>
 
 #include <vector>
@@ -20,6 +36,8 @@
 #include <cmath>
 #include <algorithm>
 #include <execution>
+#include <limits>
+#include <string_view>
 
 void Renderer::CreateRootSignature()
 {
@@ -43,78 +61,25 @@ void Renderer::CreateRootSignature()
 	}
 }
 
-std::vector<MeshRenderable> Renderer::UpdateObjects(const entt::registry& registry)
+const std::vector<MeshRenderable>& Renderer::UpdateObjects(const entt::registry& registry)
 {
 	VGScopedCPUStat("Update Instance Buffer");
 
-	const auto instanceView = registry.view<const TransformComponent, const MeshComponent>();
+	InstanceBuilder::Build(registry, instances);
 
-	std::vector<MeshRenderable> renderables;
-	renderables.reserve(instanceView.size_hint());
-	std::vector<ObjectData> objectData;
-	objectData.reserve(instanceView.size_hint());
+	device->GetResourceManager().Write(instanceBuffer, instances.objects);
 
-	size_t index = 0;
-	std::for_each(std::execution::seq, instanceView.begin(), instanceView.end(), [this, &registry, &index, &renderables, &objectData](auto entity)
-	{
-		const auto& transform = registry.get<TransformComponent>(entity);
-		const auto& mesh = registry.get<MeshComponent>(entity);
-
-		for (const auto& subset : mesh.subsets)
-		{
-			const auto maxScale = std::max(std::max(transform.scale.x, transform.scale.y), transform.scale.z);
-
-			MeshRenderable renderable{
-				.positionOffset = (uint32_t)(mesh.globalOffset.position + subset.localOffset.position),
-				.extraOffset = (uint32_t)(mesh.globalOffset.extra + subset.localOffset.extra),
-				.indexOffset = (uint32_t)(mesh.globalOffset.index + subset.localOffset.index) / sizeof(uint32_t),
-				.indexCount = (uint32_t)subset.indices,
-				.materialIndex = (uint32_t)subset.materialIndex,
-				.batchId = (uint32_t)index,  // every object in separate batch for now...
-				.boundingSphereRadius = subset.boundingSphereRadius * maxScale
-			};
-			renderables.emplace_back(renderable);
-
-			const auto scaling = XMVectorSet(transform.scale.x, transform.scale.y, transform.scale.z, 0.f);
-			const auto translation = XMVectorSet(transform.translation.x, transform.translation.y, transform.translation.z, 0.f);
-
-			const auto scalingMat = XMMatrixScalingFromVector(scaling);
-			const auto rotationMat = XMMatrixRotationX(-transform.rotation.x) * XMMatrixRotationY(-transform.rotation.y) * XMMatrixRotationZ(-transform.rotation.z);
-			const auto translationMat = XMMatrixTranslationFromVector(translation);
-
-			ObjectData instance;
-			instance.worldMatrix = scalingMat * rotationMat * translationMat;
-			instance.vertexMetadata = mesh.metadata;
-			instance.materialIndex = renderable.materialIndex;
-			instance.boundingSphereRadius = renderable.boundingSphereRadius;
-
-			// Apply offsets
-			const auto old = instance.vertexMetadata.channelOffsets[0][0];
-			for (int i = 0; i < vertexChannels / 4 + 1; ++i)
-			{
-				instance.vertexMetadata.channelOffsets[i].AddAll(renderable.extraOffset);
-			}
-			instance.vertexMetadata.channelOffsets[0][0] = old + renderable.positionOffset;
-
-			objectData.emplace_back(instance);
-
-			++index;
-		}
-	});
-
-	device->GetResourceManager().Write(instanceBuffer, objectData);
-
-	return renderables;
+	return instances.renderables;
 }
 
-void Renderer::UpdateCameraBuffer(const entt::registry& registry)
+void Renderer::UpdateViews(const entt::registry& registry)
 {
-	VGScopedCPUStat("Update Camera Buffer");
+	VGScopedCPUStat("Update Views");
 
-	XMFLOAT3 translation;
-	float nearPlane;
-	float farPlane;
-	float fieldOfView;
+	XMFLOAT3 translation{};
+	float nearPlane = 0.f;
+	float farPlane = 0.f;
+	float fieldOfView = 0.f;
 	registry.view<const TransformComponent, const CameraComponent>().each([&](auto entity, const auto& transform, const auto& camera)
 	{
 		// #TODO: Support more than one camera.
@@ -125,46 +90,34 @@ void Renderer::UpdateCameraBuffer(const entt::registry& registry)
 	});
 
 	auto& backBuffer = device->GetResourceManager().Get(device->GetBackBuffer());
+	const auto width = static_cast<uint32_t>(backBuffer.description.width);
+	const auto height = static_cast<uint32_t>(backBuffer.description.height);
+	const auto aspectRatio = static_cast<float>(width) / static_cast<float>(height);
 
-	std::vector<Camera> cameras;
+	views.Clear();
 
 	// Standard spectator camera.
-	cameras.emplace_back(Camera{
-		.position = XMFLOAT4{ translation.x, translation.y, translation.z, 0.f },
-		.view = globalViewMatrix,
-		.projection = globalProjectionMatrix,
-		.inverseView = XMMatrixInverse(nullptr, globalViewMatrix),
-		.inverseProjection = XMMatrixInverse(nullptr, globalProjectionMatrix),
-		.lastFrameView = globalLastFrameViewMatrix,
-		.lastFrameProjection = globalLastFrameProjectionMatrix,
-		.lastFrameInverseView = XMMatrixInverse(nullptr, globalLastFrameViewMatrix),
-		.lastFrameInverseProjection = XMMatrixInverse(nullptr, globalLastFrameProjectionMatrix),
-		.nearPlane = nearPlane,
-		.farPlane = farPlane,
-		.fieldOfView = fieldOfView,
-		.aspectRatio = static_cast<float>(backBuffer.description.width) / static_cast<float>(backBuffer.description.height)
-	});
-
-	// Frozen perspective camera.
-	const auto translationVector = XMMatrixInverse(nullptr, frozenView).r[3];
-	XMStoreFloat3(&translation, translationVector);
-	cameras.emplace_back(Camera{
-		.position = XMFLOAT4{ translation.x, translation.y, translation.z, 0.f },
-		.view = frozenView,
-		.projection = frozenProjection,
-		.inverseView = XMMatrixInverse(nullptr, frozenView),
-		.inverseProjection = XMMatrixInverse(nullptr, frozenProjection),
-		.lastFrameView = frozenView,
-		.lastFrameProjection = frozenProjection,
-		.lastFrameInverseView = XMMatrixInverse(nullptr, frozenView),
-		.lastFrameInverseProjection = XMMatrixInverse(nullptr, frozenProjection),
-		.nearPlane = nearPlane,
-		.farPlane = farPlane,
-		.fieldOfView = fieldOfView,
-		.aspectRatio = static_cast<float>(backBuffer.description.width) / static_cast<float>(backBuffer.description.height)
-	});
-
-	const auto solarZenithAngle = registry.get<TimeOfDayComponent>(atmosphere.sunLight).solarZenithAngle;
+	const auto spectatorCamera = RenderViewSet::CreateCamera(translation, globalViewMatrix, globalProjectionMatrix, globalLastFrameViewMatrix,
+		globalLastFrameProjectionMatrix, nearPlane, farPlane, fieldOfView, aspectRatio);
+
+	if (cameraFrozen)
+	{
+		// Frozen perspective camera, the spectator keeps moving while culling stays in place.
+		XMFLOAT3 frozenTranslation;
+		XMStoreFloat3(&frozenTranslation, XMMatrixInverse(nullptr, frozenView).r[3]);
+		const auto frozenCamera = RenderViewSet::CreateCamera(frozenTranslation, frozenView, frozenProjection, frozenView, frozenProjection,
+			nearPlane, farPlane, fieldOfView, aspectRatio);
+
+		mainView = views.Add(RenderViewType::Main, spectatorCamera, width, height, true, true, true, &frozenCamera);
+	}
+
+	else
+	{
+		mainView = views.Add(RenderViewType::Main, spectatorCamera, width, height, true, true, true);
+	}
+
+	// The cloud shadow map isn't rendered every frame, the sun camera must match the angle it was rendered at.
+	const auto solarZenithAngle = clouds.ScheduleUpdates(registry.get<TimeOfDayComponent>(atmosphere.sunLight).solarZenithAngle);
 
 	// Sun-view orthographic camera. In kilometers instead of meters for precision. Shadow map is not accurate otherwise.
 	const float sunNearPlane = 1;
@@ -175,28 +128,23 @@ void Renderer::UpdateCameraBuffer(const entt::registry& registry)
 	const auto sunUpward = XMVector4Transform(XMVectorSet(1.f, 0.f, 0.f, 0.f), sunRotationMatrix);
 	auto sunPosition = XMVectorSet(0, 0, sunHeight, 0);
 	sunPosition = XMVector4Transform(sunPosition, sunRotationMatrix);
-	XMFLOAT4 sunPositionFloat;
-	XMStoreFloat4(&sunPositionFloat, sunPosition);
+	XMFLOAT3 sunPositionFloat;
+	XMStoreFloat3(&sunPositionFloat, sunPosition);
 	auto sunView = XMMatrixLookAtRH(sunPosition, sunPosition + sunForward, sunUpward);
-	const auto viewSize = *CvarGet("cloudShadowMapResolution", int) * *CvarGet("cloudShadowMapScale", float);
+	const auto shadowMapResolution = *CvarGet("cloudShadowMapResolution", int);
+	const auto viewSize = shadowMapResolution * *CvarGet("cloudShadowMapScale", float);
 	auto sunProjection = XMMatrixOrthographicRH(viewSize, viewSize, sunNearPlane, sunFarPlane);
-	cameras.emplace_back(Camera{
-		.position = sunPositionFloat,
-		.view = sunView,
-		.projection = sunProjection,
-		.inverseView = XMMatrixInverse(nullptr, sunView),
-		.inverseProjection = XMMatrixInverse(nullptr, sunProjection),
-		.lastFrameView = XMMatrixIdentity(),  // We should never need last frame matrices for this camera.
-		.lastFrameProjection = XMMatrixIdentity(),
-		.lastFrameInverseView = XMMatrixIdentity(),
-		.lastFrameInverseProjection = XMMatrixIdentity(),
-		.nearPlane = sunNearPlane,
-		.farPlane = sunFarPlane,
-		.fieldOfView = 0,
-		.aspectRatio = static_cast<float>(backBuffer.description.width) / static_cast<float>(backBuffer.description.height)
-	});
-
-	device->GetResourceManager().Write(cameraBuffer, cameras);
+	// We should never need last frame matrices for this camera.
+	const auto sunCamera = RenderViewSet::CreateCamera(sunPositionFloat, sunView, sunProjection, XMMatrixIdentity(), XMMatrixIdentity(), sunNearPlane, sunFarPlane, 0, aspectRatio);
+
+	// Only the cloud shadow map is rendered from the sun for now, meshes aren't drawn.
+	views.Add(RenderViewType::Shadow, sunCamera, shadowMapResolution, shadowMapResolution, false, false, false);
+
+	device->GetResourceManager().Write(cameraBuffer, views.GetCameras());
+	device->GetResourceManager().Write(cullViewBuffer, views.GetCullViews(*CvarGet("lodPixelError", float)));
+
+	const auto meshletDrawCapacity = *CvarGet("meshletCulling", int) > 0 ? static_cast<uint32_t>(*CvarGet("maxMeshletDraws", int)) : 0u;
+	viewCullLayout = views.GetCullLayout(static_cast<uint32_t>(batchCount), static_cast<uint32_t>(renderableCount), meshletDrawCapacity, lodCount);
 }
 
 void Renderer::CreatePipelines()
@@ -204,6 +152,12 @@ void Renderer::CreatePipelines()
 	meshCullLayout = RenderPipelineLayout{}
 		.ComputeShader({ "MeshCulling", "Main" });
 
+	meshCullCompactionLayout = RenderPipelineLayout{}
+		.ComputeShader({ "MeshCulling", "CompactionMain" });
+
+	meshletCullLayout = RenderPipelineLayout{}
+		.ComputeShader({ "MeshCulling", "MeshletMain" });
+
 	prepassLayout = RenderPipelineLayout{}
 		.VertexShader({ "Prepass", "VSMain" })
 		.DepthEnabled(true, true);
@@ -219,52 +173,6 @@ void Renderer::CreatePipelines()
 		.DepthEnabled(false);
 }
 
-BufferHandle Renderer::CreateLightBuffer(const entt::registry& registry)
-{
-	VGScopedCPUStat("Create Light Buffer");
-
-	const auto lightView = registry.view<const TransformComponent, const LightComponent>();
-	const auto viewSize = lightView.size_hint();
-
-	BufferDescription lightBufferDescription;
-	lightBufferDescription.updateRate = ResourceFrequency::Dynamic;
-	lightBufferDescription.bindFlags = BindFlag::ShaderResource;
-	lightBufferDescription.accessFlags = AccessFlag::CPUWrite;
-	lightBufferDescription.size = viewSize;
-	lightBufferDescription.stride = sizeof(Light);
-
-	const auto bufferHandle = device->GetResourceManager().Create(lightBufferDescription, VGText("Light buffer"));
-	device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), bufferHandle);
-
-	std::vector<Light> lights{};
-	lights.reserve(viewSize);
-
-	size_t index = 0;
-	lightView.each([&](auto entity, const auto& transform, const auto& light)
-	{
-		const auto direction = XMVector3Rotate(XMVectorSet(1.f, 0.f, 0.f, 0.f), XMQuaternionRotationRollPitchYaw(transform.rotation.x, transform.rotation.y, -transform.rotation.z));
-		XMFLOAT3 directionUnpacked;
-		XMStoreFloat3(&directionUnpacked, direction);
-
-		Light instance{
-			.position = transform.translation,
-			.type = static_cast<uint32_t>(light.type),
-			.color = light.color,
-			.luminance = 1.f,  // #TEMP
-			.direction = directionUnpacked
-		};
-
-		lights.emplace_back(instance);
-		++index;
-	});
-
-	device->GetResourceManager().Write(bufferHandle, lights);
-
-	VGAssert(viewSize == index, "Mismatched entity count during buffer creation.");
-
-	return bufferHandle;
-}
-
 Renderer::~Renderer()
 {
 	RenderUtils::Get().Destroy();
@@ -277,7 +185,19 @@ void Renderer::Initialize(std::unique_ptr<WindowFrame>&& inWindow, std::unique_p
 {
 	VGScopedCPUStat("Renderer Initialize");
 
-	CvarCreate("meshCulling", "Controls compute-based mesh culling, 0=disabled, 1=frustum, 2=frustum+occlusion", 2);
+	CvarCreate("meshCulling", "Controls compute-based mesh culling, 0=disabled, 1=frustum, 2=frustum+two phase occlusion against the current frame's depth", 2);
+	CvarCreate("meshletCulling", "Culls the meshlets of visible meshes individually with frustum, normal cone and occlusion tests, 0=disabled, 1=enabled", 1);
+	CvarCreate("maxMeshletDraws", "Maximum number of meshlet draws per view, meshlets beyond this are dropped", 1 << 16);
+	CvarCreate("lodLevels", "Levels of detail generated for imported meshes, including full detail. Applies to meshes loaded afterwards", 4);
+	CvarCreate("textureMipFilter", "Generates the mips of imported material textures, 0=on the GPU at load, 1=box filter at import, 2=Kaiser filter at import. Applies to models loaded afterwards", 2);
+	CvarCreate("textureCompression", "Block compresses imported material textures, 0=uncompressed, 1=fast (BC1 or BC3 base color), 2=BC7 base color. Normals are BC5, masks BC1 or BC4. Needs mips generated at import, applies to models loaded afterwards", 2);
+	CvarCreate("lodBaseError", "Simplification error allowed for the first level of detail relative to the mesh size, each further level allows 4x more. Applies to meshes loaded afterwards", 0.01f);
+	CvarCreate("vertexQuantization", "Stores normals, tangents, texcoords and colors of imported meshes in compact formats, the bitangent is derived. Applies to meshes loaded afterwards. 0=float", 1);
+	CvarCreate("cookedModels", "Loads the cooked model next to a glTF source instead of importing it, if it's up to date, and cooks imported sources. 0=always import", 1);
+	CvarCreate("lodPixelError", "Screen space error in pixels that selecting a simplified level of detail may introduce, 0=always full detail", 1.f);
+	CvarCreate("environmentUpdateGranularity", "Work per frame while updating the sky luminance and image based lighting maps, 0=whole update in one frame, 1=one cube face, 2=one mip", 1);
+	CvarCreate("environmentSunThreshold", "Change in solar zenith angle, in radians, that starts an update of the sky luminance and image based lighting maps", 0.004f);
+	CvarCreate("environmentCameraThreshold", "Camera movement, in meters, that starts an update of the sky luminance and image based lighting maps", 100.f);
 	CvarCreate("freeze", "Toggles freezing the camera in place, while still allowing for free fly movement. Used for debugging culling", +[]()
 	{
 		Renderer::Get().FreezeCamera();
@@ -286,12 +206,132 @@ void Renderer::Initialize(std::unique_ptr<WindowFrame>&& inWindow, std::unique_p
 	{
 		Renderer::Get().ReloadShaderPipelines();
 	});
+	CvarCreate("testRenderViews", "Checks view setup and the per-view mesh culling layout against a CPU emulation of the culling dispatch, results are logged", +[]()
+	{
+		RenderViewSet::Test();
+	});
+	CvarCreate("benchmarkTransformHierarchy", "Measures CPU transform hierarchy propagation for deep and wide synthetic hierarchies, results are logged", +[]()
+	{
+		TransformHierarchy::Benchmark();
+	});
+	CvarCreate("testSceneBvh", "Compares scene BVH frustum, sphere and ray queries against brute force through refits and rebuilds, results are logged", +[]()
+	{
+		SceneBvh::Test();
+	});
+	CvarCreate("benchmarkSceneBvh", "Measures scene BVH build, refit and query throughput for 100k and 1M synthetic renderables, results are logged", +[]()
+	{
+		SceneBvh::Benchmark();
+	});
+	CvarCreate("testMeshlets", "Checks meshlet building and the normal cone test on procedural meshes, results are logged", +[]()
+	{
+		Meshlets::Test();
+	});
+	CvarCreate("benchmarkMeshlets", "Measures meshlet build throughput and the fraction of triangles rejected by normal cone culling, results are logged", +[]()
+	{
+		Meshlets::Benchmark();
+	});
+	CvarCreate("testMeshBounds", "Checks that mesh bounding volumes contain their geometry and measures their tightness on procedural meshes, results are logged", +[]()
+	{
+		MeshBounds::Test();
+	});
+	CvarCreate("testMeshLods", "Checks level of detail generation and selection on procedural meshes, results are logged", +[]()
+	{
+		MeshLods::Test();
+	});
+	CvarCreate("benchmarkMeshLods", "Measures level of detail generation, triangle reduction per level and triangles saved by selection, results are logged", +[]()
+	{
+		MeshLods::Benchmark();
+	});
+	CvarCreate("testMeshOrder", "Checks that vertex cache, overdraw and vertex fetch reordering keep the drawn triangles and improve the ACMR and overfetch, results are logged", +[]()
+	{
+		MeshOrder::Test();
+	});
+	CvarCreate("benchmarkMeshOrder", "Measures vertex cache, overdraw and vertex fetch reordering throughput and the ACMR, overfetch and overdraw before and after on procedural meshes, results are logged", +[]()
+	{
+		MeshOrder::Benchmark();
+	});
+	CvarCreate("testVertexQuantization", "Checks quantized vertex normals, tangents, texcoords and colors against their error bounds, standalone and laid out in a mesh, and the memory saved, results are logged", +[]()
+	{
+		VertexQuantization::Test();
+	});
+	CvarCreate("testClusteredLighting", "Checks the cluster grid, froxel bounds and light binning of the CPU reference against brute force, results are logged", +[]()
+	{
+		ClusterReference::Test();
+	});
+	CvarCreate("benchmarkClusteredLighting", "Measures CPU froxel bounds and light binning cost and bin occupancy across froxel sizes and bin capacities with synthetic lights, results are logged", +[]()
+	{
+		ClusterReference::Benchmark();
+	});
+	CvarCreate("testLightHierarchy", "Checks the Morton radix sort, light node bounds and that hierarchical light binning matches flat binning, results are logged", +[]()
+	{
+		LightHierarchy::Test();
+	});
+	CvarCreate("benchmarkLightHierarchy", "Measures light radix sort throughput against std::sort and node rejection rates during binning with synthetic lights, results are logged", +[]()
+	{
+		LightHierarchy::Benchmark();
+	});
+	CvarCreate("testCloudReconstruction", "Checks the cloud update pattern, history reprojection and rejection, and depth aware upsampling on a synthetic cloud layer, results are logged", +[]()
+	{
+		CloudReconstruction::Test();
+	});
+	CvarCreate("testEnvironmentSchedule", "Checks the slices of amortized sky luminance and image based lighting updates and the update policy, results are logged", +[]()
+	{
+		EnvironmentSchedule::Test();
+	});
+	CvarCreate("benchmarkEnvironmentSchedule", "Measures the sky luminance and image based lighting work per frame of each update granularity over a simulated day, results are logged", +[]()
+	{
+		EnvironmentSchedule::Benchmark();
+	});
+	CvarCreate("testSinglePassDownsampler", "Checks the thread group mapping of single pass mip chain generation with each reduction, emulated on the CPU, results are logged", +[]()
+	{
+		SinglePassDownsampler::Test();
+	});
+	CvarCreate("testTextureMips", "Checks the level sizes, filters, gamma correct filtering and normal renormalization of CPU mip generation on synthetic images, results are logged", +[]()
+	{
+		TextureMips::Test();
+	});
+	CvarCreate("testBlockCompression", "Checks the block layouts, endpoint precision and encode quality of CPU texture block compression on synthetic images, results are logged", +[]()
+	{
+		BlockCompression::Test();
+	});
+	CvarCreate("benchmarkBlockCompression", "Measures the encode quality (PSNR) and serial and parallel throughput of each block compression format on synthetic images, results are logged", +[]()
+	{
+		BlockCompression::Benchmark();
+	});
+	CvarCreate("benchmarkModelLoad", "Measures the time to upload ready data of the engine's models, importing the glTF source against mapping a cooked model, results are logged", +[]()
+	{
+		AssetLoader::Benchmark();
+	});
+	CvarCreate("benchmarkModelLoadParallel", "Measures the time to import the engine's models one after another against all at once on worker threads, results are logged", +[]()
+	{
+		AssetLoader::BenchmarkParallel();
+	});
+	CvarCreate("testAtmosphereReference", "Checks the LUT parameterizations, physical bounds of the CPU precomputed atmosphere LUTs and the LUT cache round trip, results are logged", +[]()
+	{
+		AtmosphereReference::Test();
+	});
+	CvarCreate("benchmarkAtmosphereReference", "Measures the CPU atmosphere precompute per stage and scattering order, and each order's contribution to sky radiance, results are logged", +[]()
+	{
+		AtmosphereReference::Benchmark();
+	});
+	CvarCreate("validateAtmosphereLuts", "Reads back the GPU atmosphere LUTs and compares them against the CPU reference, stalls while the reference is computed, results are logged", +[]()
+	{
+		Renderer::Get().atmosphere.ValidateLuts();
+	});
+	CvarCreate("benchmarkLightBuffer", "Measures CPU light buffer update cost for 20k lights with varying amounts of change, results are logged", +[]()
+	{
+		LightBuffer::Benchmark();
+	});
+	CvarCreate("benchmarkInstanceBuild", "Measures CPU instance buffer build throughput for 10k, 100k and 1M synthetic instances, results are logged", +[]()
+	{
+		InstanceBuilder::Benchmark();
+	});
 	
 	constexpr size_t maxVertices = 32 * 1024 * 1024;
 
 	window = std::move(inWindow);
 	device = std::move(inDevice);
-	meshFactory = std::make_unique<MeshFactory>(device.get(), maxVertices, maxVertices);
+	meshFactory = std::make_unique<MeshFactory>(device.get(), maxVertices, maxVertices, maxVertices / 64);
 	materialFactory = std::make_unique<MaterialFactory>(device.get(), 1024 * 8);
 	renderGraphResources.SetDevice(device.get());
 
@@ -310,11 +350,26 @@ void Renderer::Initialize(std::unique_ptr<WindowFrame>&& inWindow, std::unique_p
 	cameraBufferDesc.updateRate = ResourceFrequency::Static;
 	cameraBufferDesc.bindFlags = BindFlag::ShaderResource;
 	cameraBufferDesc.accessFlags = AccessFlag::CPUWrite;
-	cameraBufferDesc.size = 3;  // #TODO: Better camera management.
+	cameraBufferDesc.size = RenderViewSet::maxCameras;
 	cameraBufferDesc.stride = sizeof(Camera);
 
 	cameraBuffer = device->GetResourceManager().Create(cameraBufferDesc, VGText("Camera buffer"));
 
+	cullViewBuffer = device->GetResourceManager().Create(BufferDescription{
+		.updateRate = ResourceFrequency::Static,
+		.bindFlags = BindFlag::ShaderResource,
+		.accessFlags = AccessFlag::CPUWrite,
+		.size = RenderViewSet::maxCameras,
+		.stride = sizeof(MeshCullView)
+	}, VGText("Mesh cull view buffer"));
+
+	lightBuffer.Initialize(device.get());
+
+	// Models attach their meshes over several frames after loading asynchronously, the batches are rebuilt for each change.
+	registry.on_construct<MeshComponent>().connect<&Renderer::OnMeshChanged>(*this);
+	registry.on_update<MeshComponent>().connect<&Renderer::OnMeshChanged>(*this);
+	registry.on_destroy<MeshComponent>().connect<&Renderer::OnMeshChanged>(*this);
+
 	userInterface = std::make_unique<UserInterfaceManager>(device.get());
 
 	CreateRootSignature();
@@ -325,6 +380,8 @@ void Renderer::Initialize(std::unique_ptr<WindowFrame>&& inWindow, std::unique_p
 	atmosphere.Initialize(device.get(), registry);
 	clusteredCulling.Initialize(device.get());
 	ibl.Initialize(device.get());
+	environmentSchedule.Initialize({ Atmosphere::luminanceTextureSize, ImageBasedLighting::irradianceTextureSize, ImageBasedLighting::prefilterTextureSize,
+		ImageBasedLighting::prefilterLevels });
 	bloom.Initialize(device.get());
 	occlusionCulling.Initialize(device.get());
 	clouds.Initialize(device.get());
@@ -363,6 +420,14 @@ void Renderer::Initialize(std::unique_ptr<WindowFrame>&& inWindow, std::unique_p
 		.stride = sizeof(MeshIndirectArgument),
 		.uavCounter = true
 	}, VGText("Mesh indirect render argument buffer"));
+
+	batchInstanceBuffer = device->GetResourceManager().Create(BufferDescription{
+		.updateRate = ResourceFrequency::Static,
+		.bindFlags = BindFlag::ShaderResource,
+		.accessFlags = AccessFlag::CPUWrite,
+		.size = 1024 * 1024 * 8,
+		.stride = sizeof(BatchedInstance)
+	}, VGText("Batch instance buffer"));
 }
 
 void Renderer::Render(entt::registry& registry)
@@ -377,167 +442,307 @@ void Renderer::Render(entt::registry& registry)
 		shouldReloadShaders = false;
 	}
 
-	// Only run once for now since this becomes the bottleneck running every frame with 100k+ objects.
-	static bool objectsUpdated = false;
-	if (!objectsUpdated)
+	// Only rebuilt when meshes change, since this becomes the bottleneck running every frame with 100k+ objects. Models load
+	// asynchronously, so this happens again as each one is attached.
+	if (objectsDirty)
 	{
-		objectsUpdated = true;
-		const auto renderables = UpdateObjects(registry);
+		objectsDirty = false;
+		const auto& renderables = UpdateObjects(registry);
 		renderableCount = renderables.size();
 
+		InstanceBuilder::Batch(renderables, batches);
+		batchCount = batches.batches.size();
+
+		VGLog(logRendering, "Instanced {} renderables into {} draws.", renderableCount, batchCount);
+
+		lodCount = 1;
+		for (const auto& batch : batches.batches)
+		{
+			lodCount = std::max(lodCount, batch.lodCount);
+		}
+
+		// One template per batch and level of detail. Batches with fewer levels pad with levels that are never selected.
 		std::vector<MeshIndirectArgument> drawArguments;
-		drawArguments.reserve(renderables.size());
+		drawArguments.reserve(batches.batches.size() * lodCount);
 
-		for (const auto& renderable : renderables)
+		for (const auto& batch : batches.batches)
 		{
-			drawArguments.emplace_back(MeshIndirectArgument{
-				.batchId = renderable.batchId,
-				.draw = {
-					.IndexCountPerInstance = renderable.indexCount,
-					.InstanceCount = 1,
-					.StartIndexLocation = renderable.indexOffset,
-					.BaseVertexLocation = 0,
-					.StartInstanceLocation = 0
-				}
-			});
+			for (uint32_t lod = 0; lod < lodCount; ++lod)
+			{
+				const auto generated = lod < batch.lodCount;
+				drawArguments.emplace_back(MeshIndirectArgument{
+					.batchId = batch.firstInstance,
+					.draw = {
+						.IndexCountPerInstance = generated ? batch.lods[lod].indexCount : batch.indexCount,
+						.InstanceCount = 0,  // Incremented for each visible instance during culling.
+						.StartIndexLocation = generated ? batch.lods[lod].indexOffset : batch.indexOffset,
+						.BaseVertexLocation = 0,
+						.StartInstanceLocation = 0
+					},
+					.lodError = generated ? batch.lods[lod].error : (lod == 0 ? 0.f : std::numeric_limits<float>::max())
+				});
+			}
 		}
 
 		device->GetResourceManager().Write(meshIndirectRenderArgs, drawArguments);
+		device->GetResourceManager().Write(batchInstanceBuffer, batches.instances);
+
+		// Instances were renumbered, so the first late culling phase tests every instance against an empty hi-z.
+		const std::vector<uint32_t> visibilityWords((renderableCount + 31) / 32 + 1, 0);
+		if (meshVisibilityBuffer.handle != entt::null)
+		{
+			// The old buffer may still be in use by frames in flight.
+			device->GetResourceManager().AddFrameResource(device->GetFrameIndex(), meshVisibilityBuffer);
+		}
+
+		meshVisibilityBuffer = device->GetResourceManager().Create(BufferDescription{
+			.updateRate = ResourceFrequency::Static,
+			.bindFlags = BindFlag::UnorderedAccess | BindFlag::ShaderResource,
+			.accessFlags = AccessFlag::CPUWrite,
+			.size = visibilityWords.size(),
+			.stride = sizeof(uint32_t)
+		}, VGText("Mesh visibility buffer"));
+		device->GetResourceManager().Write(meshVisibilityBuffer, visibilityWords);
 	}
 	
-	UpdateCameraBuffer(registry);
+	UpdateViews(registry);
 
 	RenderGraph graph{ &renderGraphResources };
 	
-	const auto lightBuffer = CreateLightBuffer(registry);
+	lightBuffer.Update(registry);
 
 	MeshResources meshResources;
 	meshResources.positionTag = graph.Import(meshFactory->vertexPositionBuffer);
 	meshResources.extraTag = graph.Import(meshFactory->vertexExtraBuffer);
+	auto meshletBufferTag = graph.Import(meshFactory->meshletBuffer);
 
 	RenderResource materialBufferTag = graph.Import(materialFactory->materialBuffer);
 
 	auto backBufferTag = graph.Import(device->GetBackBuffer());
 	auto cameraBufferTag = graph.Import(cameraBuffer);
+	auto cullViewBufferTag = graph.Import(cullViewBuffer);
 	auto instanceBufferTag = graph.Import(instanceBuffer);
-	auto lightBufferTag = graph.Import(lightBuffer);
+	auto lightBufferTag = graph.Import(lightBuffer.GetBuffer());
+	auto lightOrderTag = graph.Import(lightBuffer.GetOrderBuffer());
+	auto lightNodeTag = graph.Import(lightBuffer.GetNodeBuffer());
 	auto meshIndirectRenderArgsTag = graph.Import(meshIndirectRenderArgs);
+	auto batchInstanceBufferTag = graph.Import(batchInstanceBuffer);
+	auto meshVisibilityTag = graph.Import(meshVisibilityBuffer);
 
 	graph.Tag(backBufferTag, ResourceTag::BackBuffer);
 
-	auto lastFrameHiZ = occlusionCulling.GetLastFrameHiZ();
-
-	auto& meshCullPass = graph.AddPass("Mesh Culling Pass", ExecutionQueue::Compute);
-	auto meshIndirectCulledRenderArgsTag = meshCullPass.Create(TransientBufferDescription{
-		.updateRate = ResourceFrequency::Static,  // Need unordered-access.
-		.size = 1024 * 1024 * 8,
-		.stride = sizeof(MeshIndirectArgument),
-		.uavCounter = true
-	}, VGText("Mesh indirect culled render argument buffer"));
-	meshCullPass.Read(meshIndirectRenderArgsTag, ResourceBind::SRV);
-	meshCullPass.Write(meshIndirectCulledRenderArgsTag, ResourceBind::UAV);
-	meshCullPass.Read(instanceBufferTag, ResourceBind::SRV);
-	meshCullPass.Read(cameraBufferTag, ResourceBind::SRV);
-	if (*CvarGet("meshCulling", int) > 1 && lastFrameHiZ.id != 0)  // 0 first frame.
-		meshCullPass.Read(lastFrameHiZ, ResourceBind::SRV);
-	meshCullPass.Bind([&](CommandList& list, RenderPassResources& resources)
-	{
-		const auto meshCulling = *CvarGet("meshCulling", int);
-
-		if (meshCulling > 0)
+	// Every view that draws meshes is culled in the same dispatch, each writing its own range of the shared buffers. Views with
+	// occlusion culling are culled twice: the early phase draws what was visible last frame, the late phase tests the rest against
+	// a hi-z built from that depth and draws what became visible.
+	const auto AddMeshCullPass = [&](std::string_view name, uint32_t phase, RenderResource hiZTag)
+	{
+		BufferView meshCullCounterView{};
+		meshCullCounterView.UAV("uav_visible");
+		meshCullCounterView.UAV("uav_nonvisible", 0, 0, HeapType::NonVisible);
+
+		auto& meshCullPass = graph.AddPass(name, ExecutionQueue::Compute);
+		MeshCullResources meshCullResources;
+		meshCullResources.counters = meshCullPass.Create(TransientBufferDescription{
+			.updateRate = ResourceFrequency::Static,  // Need unordered-access.
+			.size = std::max(viewCullLayout.CounterCount(), 1u),
+			.format = DXGI_FORMAT_R32_UINT
+		}, VGText("Mesh cull counter buffer"));
+		meshCullResources.arguments = meshCullPass.Create(TransientBufferDescription{
+			.updateRate = ResourceFrequency::Static,  // Need unordered-access.
+			.size = std::max(viewCullLayout.ArgumentCount(), 1u),
+			.stride = sizeof(MeshIndirectArgument)
+		}, VGText("Mesh indirect culled render argument buffer"));
+		meshCullResources.visibleInstances = meshCullPass.Create(TransientBufferDescription{
+			.updateRate = ResourceFrequency::Static,  // Need unordered-access.
+			.size = std::max(viewCullLayout.VisibleInstanceCount(), 1u),
+			.stride = sizeof(uint32_t)
+		}, VGText("Visible instance buffer"));
+		const auto meshletCandidateTag = meshCullPass.Create(TransientBufferDescription{
+			.updateRate = ResourceFrequency::Static,  // Need unordered-access.
+			.size = std::max(viewCullLayout.CandidateCapacity(), 1u),
+			.stride = sizeof(uint32_t) * 2
+		}, VGText("Meshlet candidate buffer"));
+		meshCullPass.Read(meshIndirectRenderArgsTag, ResourceBind::SRV);
+		meshCullPass.Read(batchInstanceBufferTag, ResourceBind::SRV);
+		meshCullPass.Write(meshCullResources.counters, meshCullCounterView);
+		meshCullPass.Write(meshCullResources.arguments, ResourceBind::UAV);
+		meshCullPass.Write(meshCullResources.visibleInstances, ResourceBind::UAV);
+		meshCullPass.Write(meshletCandidateTag, ResourceBind::UAV);
+		meshCullPass.Write(meshVisibilityTag, ResourceBind::UAV);
+		meshCullPass.Read(meshletBufferTag, ResourceBind::SRV);
+		meshCullPass.Read(instanceBufferTag, ResourceBind::SRV);
+		meshCullPass.Read(cameraBufferTag, ResourceBind::SRV);
+		meshCullPass.Read(cullViewBufferTag, ResourceBind::SRV);
+		if (phase == meshCullLatePhase)
+			meshCullPass.Read(hiZTag, ResourceBind::SRV);
+		meshCullPass.Bind([&, meshCullResources, meshletCandidateTag, phase, hiZTag](CommandList& list, RenderPassResources& resources)
 		{
-			list.BindPipeline(meshCullLayout);
+			const auto meshCulling = *CvarGet("meshCulling", int);
+
+			// Fresh draw and instance counts of zero for every view.
+			RenderUtils::Get().ClearUAV(list, resources.GetBuffer(meshCullResources.counters), resources.Get(meshCullResources.counters, "uav_visible"), resources.GetDescriptor(meshCullResources.counters, "uav_nonvisible"));
+			list.UAVBarrier(resources.GetBuffer(meshCullResources.counters));
+			list.FlushBarriers();
+
+			// Only occlusion culled views have late draws. While frozen the hi-z isn't rebuilt, so the visibility from the moment
+			// of freezing is kept and the early phase keeps drawing it.
+			if (phase == meshCullLatePhase && (meshCulling < 2 || cameraFrozen))
+				return;
 
 			struct {
-				uint32_t inputBuffer;
+				uint32_t batchInstanceBuffer;
+				uint32_t batchArgumentBuffer;
+				uint32_t counterBuffer;
 				uint32_t outputBuffer;
+				uint32_t visibleInstanceBuffer;
 				uint32_t objectBuffer;
 				uint32_t cameraBuffer;
-				uint32_t cameraIndex;
-				uint32_t drawCount;
+				uint32_t viewBuffer;
+				uint32_t viewCount;
+				uint32_t instanceCount;
+				uint32_t batchCount;
 				uint32_t cullingLevel;
 				uint32_t hiZTexture;
 				uint32_t hiZMipLevels;
+				uint32_t meshletBuffer;
+				uint32_t candidateBuffer;
+				uint32_t meshletDrawCapacity;
+				uint32_t meshletGroupCount;
+				uint32_t lodCount;
+				uint32_t visibilityBuffer;
+				uint32_t phase;
 			} bindData;
 
-			bindData.inputBuffer = resources.Get(meshIndirectRenderArgsTag);
-			bindData.outputBuffer = resources.Get(meshIndirectCulledRenderArgsTag);
+			bindData.batchInstanceBuffer = resources.Get(batchInstanceBufferTag);
+			bindData.batchArgumentBuffer = resources.Get(meshIndirectRenderArgsTag);
+			bindData.counterBuffer = resources.Get(meshCullResources.counters, "uav_visible");
+			bindData.outputBuffer = resources.Get(meshCullResources.arguments);
+			bindData.visibleInstanceBuffer = resources.Get(meshCullResources.visibleInstances);
 			bindData.objectBuffer = resources.Get(instanceBufferTag);
 			bindData.cameraBuffer = resources.Get(cameraBufferTag);
-			bindData.cameraIndex = cameraFrozen ? 1 : 0;  // #TODO: Support multiple cameras.
-			bindData.drawCount = renderableCount;
-			bindData.cullingLevel = meshCulling;
-			bindData.hiZTexture = (meshCulling > 1 && lastFrameHiZ.id != 0) ? resources.Get(lastFrameHiZ) : 0;
+			bindData.viewBuffer = resources.Get(cullViewBufferTag);
+			bindData.viewCount = viewCullLayout.viewCount;
+			bindData.instanceCount = viewCullLayout.instanceCount;
+			bindData.batchCount = viewCullLayout.batchCount;
+			bindData.cullingLevel = meshCulling;  // Level 0 still runs to build the instance lists, with every instance visible.
+			bindData.hiZTexture = phase == meshCullLatePhase ? resources.Get(hiZTag) : 0;
 			bindData.hiZMipLevels = *CvarGet("hiZPyramidLevels", int);
+			bindData.meshletBuffer = resources.Get(meshletBufferTag);
+			bindData.candidateBuffer = resources.Get(meshletCandidateTag);
+			bindData.meshletDrawCapacity = viewCullLayout.meshletDrawCapacity;
+			bindData.meshletGroupCount = 1024;  // Enough to fill the GPU, groups loop over the candidates.
+			bindData.lodCount = viewCullLayout.lodCount;
+			bindData.visibilityBuffer = resources.Get(meshVisibilityTag);
+			bindData.phase = phase;
 
-			if (lastFrameHiZ.id == 0)
-				bindData.cullingLevel = 1;  // Can't use hi-z first frame.
+			constexpr auto groupSize = 64;
 
+			list.BindPipeline(meshCullLayout);
 			list.BindConstants("bindData", bindData);
+			list.Dispatch(std::ceil((float)bindData.instanceCount / groupSize), 1, 1);
 
-			constexpr auto groupSize = 64;
-			const auto dispatchX = std::ceil((float)bindData.drawCount / groupSize);
+			list.UAVBarrier(resources.GetBuffer(meshCullResources.counters));
+			list.FlushBarriers();
 
-			list.Dispatch(dispatchX, 1, 1);
-		}
+			// Compact the batches with at least one visible instance, for every view.
+			list.BindPipeline(meshCullCompactionLayout);
+			list.BindConstants("bindData", bindData);
+			list.Dispatch(std::ceil((float)(bindData.viewCount * viewCullLayout.TemplateCount()) / groupSize), 1, 1);
 
-		else
+			// Cull the meshlets of every queued instance. The candidate count is only known on the GPU.
+			if (bindData.meshletDrawCapacity > 0 && meshCulling > 0)
+			{
+				list.BindPipeline(meshletCullLayout);
+				list.BindConstants("bindData", bindData);
+				list.Dispatch(bindData.meshletGroupCount, 1, 1);
+			}
+		});
+
+		return meshCullResources;
+	};
+
+	// Both phases draw into the same depth, the late phase on top of the early phase.
+	const auto BindPrepass = [&](RenderPass& prePass, const MeshCullResources& meshCullResources)
+	{
+		prePass.Read(instanceBufferTag, ResourceBind::SRV);
+		prePass.Read(meshCullResources.visibleInstances, ResourceBind::SRV);
+		prePass.Read(cameraBufferTag, ResourceBind::SRV);
+		prePass.Read(meshResources.positionTag, ResourceBind::SRV);
+		prePass.Read(meshCullResources.arguments, ResourceBind::Indirect);
+		prePass.Read(meshCullResources.counters, ResourceBind::Indirect);
+		prePass.Bind([&, meshCullResources](CommandList& list, RenderPassResources& resources)
 		{
-			list.Copy(resources.GetBuffer(meshIndirectCulledRenderArgsTag), resources.GetBuffer(meshIndirectRenderArgsTag));
+			struct {
+				uint32_t batchId;
+				uint32_t objectBuffer;
+				uint32_t visibleInstanceBuffer;
+				uint32_t cameraBuffer;
+				uint32_t cameraIndex;
+				uint32_t vertexPositionBuffer;
+			} bindData;
 
-			// Need to update the counter resource as well.
+			bindData.objectBuffer = resources.Get(instanceBufferTag);
+			bindData.visibleInstanceBuffer = resources.Get(meshCullResources.visibleInstances);
+			bindData.cameraBuffer = resources.Get(cameraBufferTag);
+			bindData.vertexPositionBuffer = resources.Get(meshResources.positionTag);
 
-			auto& argsBuffer = device->GetResourceManager().Get(resources.GetBuffer(meshIndirectCulledRenderArgsTag));
+			list.BindPipeline(prepassLayout);
 
-			// Transition the counter buffer to copy destination here so we don't transition it in the direct list inside of Write().
-			// #TODO: Need to find a much better solution for this.
-			list.TransitionBarrier(argsBuffer.counterBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
-			list.FlushBarriers();
+			MeshSystem::Render(Renderer::Get(), registry, list, bindData, mainView, resources.GetBuffer(meshCullResources.arguments), resources.GetBuffer(meshCullResources.counters));
+		});
+	};
 
-			device->GetResourceManager().Write(argsBuffer.counterBuffer, (uint32_t)renderableCount);
-		}
-	});
-	
-	auto& prePass = graph.AddPass("Prepass", ExecutionQueue::Graphics);
-	auto depthStencilTag = prePass.Create(TransientTextureDescription{
+	MeshCullPhases meshCullPhases;
+	meshCullPhases.early = AddMeshCullPass("Early Mesh Culling Pass", meshCullEarlyPhase, {});
+
+	auto& earlyPrepass = graph.AddPass("Early Prepass", ExecutionQueue::Graphics);
+	const auto depthStencilTag = earlyPrepass.Create(TransientTextureDescription{
 		.format = DXGI_FORMAT_R24G8_TYPELESS
 	}, VGText("Depth stencil"));
-	prePass.Read(instanceBufferTag, ResourceBind::SRV);
-	prePass.Read(cameraBufferTag, ResourceBind::SRV);
-	prePass.Read(meshResources.positionTag, ResourceBind::SRV);
-	prePass.Read(meshIndirectCulledRenderArgsTag, ResourceBind::Indirect);
-	prePass.Output(depthStencilTag, OutputBind::DSV, LoadType::Clear);
-	prePass.Bind([&](CommandList& list, RenderPassResources& resources)
-	{
-		struct {
-			uint32_t batchId;
-			uint32_t objectBuffer;
-			uint32_t cameraBuffer;
-			uint32_t cameraIndex;
-			uint32_t vertexPositionBuffer;
-		} bindData;
+	earlyPrepass.Output(depthStencilTag, OutputBind::DSV, LoadType::Clear);
+	BindPrepass(earlyPrepass, meshCullPhases.early);
 
-		bindData.objectBuffer = resources.Get(instanceBufferTag);
-		bindData.cameraBuffer = resources.Get(cameraBufferTag);
-		bindData.vertexPositionBuffer = resources.Get(meshResources.positionTag);
+	// #TODO: Don't have this here.
+	const auto hiZTag = occlusionCulling.Render(graph, cameraFrozen, depthStencilTag);
 
-		list.BindPipeline(prepassLayout);
+	meshCullPhases.late = AddMeshCullPass("Late Mesh Culling Pass", meshCullLatePhase, hiZTag);
 
-		MeshSystem::Render(Renderer::Get(), registry, list, bindData, resources.GetBuffer(meshIndirectCulledRenderArgsTag));
-	});
+	auto& latePrepass = graph.AddPass("Late Prepass", ExecutionQueue::Graphics);
+	latePrepass.Output(depthStencilTag, OutputBind::DSV, LoadType::Preserve);
+	BindPrepass(latePrepass, meshCullPhases.late);
 
 	// #TODO: Don't have this here.
-	const auto clusterResources = clusteredCulling.Render(graph, registry, cameraBufferTag, depthStencilTag, lightBufferTag, instanceBufferTag, meshResources, meshIndirectCulledRenderArgsTag);
+	const LightResources lightResources{
+		.lights = lightBufferTag,
+		.order = lightOrderTag,
+		.nodes = lightNodeTag,
+		.nodeCount = lightBuffer.GetNodeCount(),
+		.data = lightBuffer.GetLights()
+	};
+
+	const auto clusterResources = clusteredCulling.Render(graph, registry, mainView, cameraBufferTag, depthStencilTag, lightResources, instanceBufferTag, meshResources, meshCullPhases);
 	
 	// #TODO: Don't have this here.
 	const auto atmosphereResources = atmosphere.ImportResources(graph);
-	const auto [luminanceTexture, atmosphereIrradiance] = atmosphere.RenderEnvironmentMap(graph, atmosphereResources, cameraBufferTag, registry);
+	atmosphere.UpdateLuts(graph, atmosphereResources);
 
-	// #TODO: Don't have this here.
-	const auto iblResources = ibl.UpdateLuts(graph, luminanceTexture, cameraBufferTag);
+	// The sky luminance and image based lighting maps are only updated once the sun or camera moved enough, over several frames.
+	const EnvironmentUpdateSettings environmentSettings{
+		.granularity = static_cast<EnvironmentUpdateGranularity>(std::clamp(*CvarGet("environmentUpdateGranularity", int), 0, 2)),
+		.sunThreshold = *CvarGet("environmentSunThreshold", float),
+		.cameraThreshold = *CvarGet("environmentCameraThreshold", float)
+	};
+	const auto& environmentCamera = views.GetCameras()[0];  // Matches the camera index of the luminance pass.
+	const auto environmentUpdate = environmentSchedule.Update(EnvironmentInputs{
+		.solarZenithAngle = registry.get<TimeOfDayComponent>(atmosphere.sunLight).solarZenithAngle,
+		.cameraPosition = { environmentCamera.position.x, environmentCamera.position.y, environmentCamera.position.z },
+		.lutVersion = atmosphere.GetLutVersion()
+	}, environmentSettings);
+
+	const auto [luminanceTexture, atmosphereIrradiance] = atmosphere.RenderEnvironmentMap(graph, atmosphereResources, cameraBufferTag, registry, environmentUpdate);
 
 	// #TODO: Don't have this here.
-	occlusionCulling.Render(graph, cameraFrozen, depthStencilTag);
+	const auto iblResources = ibl.UpdateLuts(graph, luminanceTexture, environmentUpdate);
 
 	// #TODO: Don't have this here.
 	const auto cloudResources = clouds.Render(graph, registry, atmosphere, cameraBufferTag, depthStencilTag, atmosphereIrradiance);
@@ -560,12 +765,17 @@ void Renderer::Render(entt::registry& registry)
 	forwardPass.Read(iblResources.brdfTag, ResourceBind::SRV);
 	forwardPass.Read(atmosphereIrradiance, ResourceBind::SRV);
 	forwardPass.Read(cloudResources.cloudsShadowMap, ResourceBind::SRV);
-	forwardPass.Read(meshIndirectCulledRenderArgsTag, ResourceBind::Indirect);
+	for (const auto& phase : { meshCullPhases.early, meshCullPhases.late })
+	{
+		forwardPass.Read(phase.visibleInstances, ResourceBind::SRV);
+		forwardPass.Read(phase.arguments, ResourceBind::Indirect);
+		forwardPass.Read(phase.counters, ResourceBind::Indirect);
+	}
 	forwardPass.Output(outputHDRTag, OutputBind::RTV, LoadType::Clear);
 	forwardPass.Bind([&](CommandList& list, RenderPassResources& resources)
 	{
 		ClusterData clusterData;
-		auto& gridInfo = clusteredCulling.GetGridInfo();
+		auto& gridInfo = clusteredCulling.GetGridInfo(mainView);
 		clusterData.lightListBuffer = resources.Get(clusterResources.lightList);
 		clusterData.lightInfoBuffer = resources.Get(clusterResources.lightInfo);
 		clusterData.froxelSize = *CvarGet("clusteredFroxelSize", int);
@@ -583,6 +793,7 @@ void Renderer::Render(entt::registry& registry)
 		struct {
 			uint32_t batchId;
 			uint32_t objectBuffer;
+			uint32_t visibleInstanceBuffer;
 			uint32_t cameraBuffer;
 			uint32_t cameraIndex;
 			uint32_t vertexPositionBuffer;
@@ -592,7 +803,7 @@ void Renderer::Render(entt::registry& registry)
 			uint32_t atmosphereIrradianceBuffer;
 			uint32_t cloudsShadowMap;
 			float globalWeatherCoverage;
-			float padding;
+			uint32_t sunCameraIndex;
 			ClusterData clusterData;
 			IblData iblData;
 		} bindData;
@@ -606,6 +817,7 @@ void Renderer::Render(entt::registry& registry)
 		bindData.atmosphereIrradianceBuffer = resources.Get(atmosphereIrradiance);
 		bindData.cloudsShadowMap = resources.Get(cloudResources.cloudsShadowMap);
 		bindData.globalWeatherCoverage = clouds.coverage;  // #TODO: Scale by precipitation?
+		bindData.sunCameraIndex = views.Find(RenderViewType::Shadow)->cameraIndex;
 		bindData.clusterData = clusterData;
 		bindData.iblData = iblData;
 
@@ -614,7 +826,7 @@ void Renderer::Render(entt::registry& registry)
 
 			list.BindPipeline(forwardOpaqueLayout);
 
-			MeshSystem::Render(Renderer::Get(), registry, list, bindData, resources.GetBuffer(meshIndirectCulledRenderArgsTag));
+			MeshSystem::Render(Renderer::Get(), registry, list, bindData, mainView, resources, meshCullPhases);
 		}
 	});
 
@@ -16,23 +16,16 @@
 #include <Rendering/Atmosphere.h>
 #include <Rendering/ClusteredLightCulling.h>
 #include <Rendering/ImageBasedLighting.h>
+#include <Rendering/EnvironmentSchedule.h>
 #include <Rendering/Bloom.h>
 #include <Rendering/OcclusionCulling.h>
 #include <Rendering/Clouds.h>
+#include <Rendering/InstanceBuilder.h>
+#include <Rendering/LightBuffer.h>
+#include <Rendering/RenderView.h>
 
 #include <entt/entt.hpp>
 
-struct MeshRenderable
-{
-	uint32_t positionOffset;
-	uint32_t extraOffset;
-	uint32_t indexOffset;
-	uint32_t indexCount;
-	uint32_t materialIndex;
-	uint32_t batchId;
-	float boundingSphereRadius;
-};
-
 class CommandList;
 
 class Renderer : public Singleton<Renderer>
@@ -49,11 +42,18 @@ public:
 	Atmosphere atmosphere;
 	ClusteredLightCulling clusteredCulling;
 	ImageBasedLighting ibl;
+	EnvironmentSchedule environmentSchedule;
 	Bloom bloom;
 	OcclusionCulling occlusionCulling;
 	Clouds clouds;
 
 	size_t renderableCount;
+	size_t batchCount;  // Upper bound on indirect draws after culling.
+	uint32_t lodCount = 1;  // Argument templates per batch, the most levels of detail of any batch.
+
+	RenderViewSet views;  // Rebuilt every frame.
+	uint32_t mainView = 0;
+	ViewCullLayout viewCullLayout;
 
 	ResourcePtr<ID3D12RootSignature> rootSignature;
 	ResourcePtr<ID3D12CommandSignature> meshIndirectCommandSignature;
@@ -63,26 +63,36 @@ private:
 
 	BufferHandle instanceBuffer;
 	BufferHandle cameraBuffer;
+	BufferHandle cullViewBuffer;
+	LightBuffer lightBuffer;
+
+	InstanceBuildOutput instances;  // Persistent to reuse the allocations.
+	InstanceBatchOutput batches;
 
 	RenderPipelineLayout meshCullLayout;
+	RenderPipelineLayout meshCullCompactionLayout;
+	RenderPipelineLayout meshletCullLayout;
 	RenderPipelineLayout prepassLayout;
 	RenderPipelineLayout forwardOpaqueLayout;
 	RenderPipelineLayout postProcessLayout;
 
-	BufferHandle meshIndirectRenderArgs;
+	BufferHandle meshIndirectRenderArgs;  // One per batch, culling writes a copy for each view with the visible instance counts.
+	BufferHandle batchInstanceBuffer;
+	BufferHandle meshVisibilityBuffer;  // One bit per instance, set if the occlusion culled view drew it last frame.
 
 	bool cameraFrozen = false;
 	XMMATRIX frozenView;
 	XMMATRIX frozenProjection;
 
 	bool shouldReloadShaders = false;
+	bool objectsDirty = true;  // Meshes were added, replaced or removed since the batches were built.
 
 private:
+	void OnMeshChanged(entt::registry& registry, entt::entity entity) { objectsDirty = true; }
 	void CreateRootSignature();
-	std::vector<MeshRenderable> UpdateObjects(const entt::registry& registry);
-	void UpdateCameraBuffer(const entt::registry& registry);
+	const std::vector<MeshRenderable>& UpdateObjects(const entt::registry& registry);
+	void UpdateViews(const entt::registry& registry);
 	void CreatePipelines();
-	BufferHandle CreateLightBuffer(const entt::registry& registry);
 
 public:
 	~Renderer();
@@ -114,11 +114,85 @@ inline uint32_t GetResourceFormatSize(DXGI_FORMAT format)
 	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
 	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
 		return 32;
+
+	// Block compressed formats are the average size of a texel in a 4x4 block.
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
 	}
 
 	return 0;
 }
 
+inline bool IsResourceFormatBlockCompressed(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Returns the size in bytes of a row of texels, or of a row of 4x4 blocks for block compressed formats.
+inline uint32_t GetResourceFormatRowSize(DXGI_FORMAT format, uint32_t width)
+{
+	if (IsResourceFormatBlockCompressed(format))
+	{
+		return (width + 3) / 4 * GetResourceFormatSize(format) * 2;  // 16 texels per block.
+	}
+
+	return width * GetResourceFormatSize(format) / 8;
+}
+
+// Returns the number of rows of texels, or of 4x4 blocks for block compressed formats.
+inline uint32_t GetResourceFormatRowCount(DXGI_FORMAT format, uint32_t height)
+{
+	return IsResourceFormatBlockCompressed(format) ? (height + 3) / 4 : height;
+}
+
 inline bool IsResourceFormatSRGB(DXGI_FORMAT format)
 {
 	switch (format)
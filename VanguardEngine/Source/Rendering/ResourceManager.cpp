@@ -281,6 +281,7 @@ void ResourceManager::Initialize(RenderDevice* inDevice, size_t bufferedFrames)
 	frameBuffers.resize(frameCount);
 	frameTextures.resize(frameCount);
 	frameDescriptors.resize(frameCount);
+	frameReadbacks.resize(frameCount);
 
 	constexpr auto uploadResourceSize = 1024 * 1024 * 512;
 
@@ -464,8 +465,9 @@ const TextureHandle ResourceManager::Create(const TextureDescription& descriptio
 		}
 	}
 
-	// Mipmapping requires a UAV.
-	if (description.bindFlags & BindFlag::UnorderedAccess || description.mipMapping)
+	// Mipmapping requires a UAV, unless the format is block compressed, which can't be written on the GPU. Their mips are always
+	// written from the CPU.
+	if (description.bindFlags & BindFlag::UnorderedAccess || (description.mipMapping && !IsResourceFormatBlockCompressed(description.format)))
 	{
 		resourceDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 	}
@@ -588,7 +590,7 @@ const TextureHandle ResourceManager::CreateFromSwapChain(void* surface, const st
 	return handle;
 }
 
-void ResourceManager::Write(BufferHandle target, const std::vector<uint8_t>& source, size_t targetOffset)
+void ResourceManager::Write(BufferHandle target, std::span<const uint8_t> source, size_t targetOffset)
 {
 	auto& component = Get(target);
 
@@ -654,9 +656,12 @@ void ResourceManager::Write(TextureHandle target, const std::vector<uint8_t>& so
 
 	auto& component = Get(target);
 
+	// Rows of blocks for block compressed formats.
+	const auto rowSize = GetResourceFormatRowSize(component.description.format, component.description.width);
+	const auto rows = GetResourceFormatRowCount(component.description.format, component.description.height);
+
 	VGAssert(component.description.accessFlags & AccessFlag::CPUWrite, "Failed to write to texture, no CPU write access.");
-	VGAssert(component.description.width * component.description.height * component.description.depth * (GetResourceFormatSize(component.description.format) / 8) >= source.size(),
-		"Failed to write to texture, source is larger than target.");
+	VGAssert(rowSize * rows * component.description.depth >= source.size(), "Failed to write to texture, source is larger than target.");
 
 	const auto frameIndex = device->GetFrameIndex();
 
@@ -679,33 +684,27 @@ void ResourceManager::Write(TextureHandle target, const std::vector<uint8_t>& so
 	// Check conditions could be improved, but we essentially need to check if the source data's rows aren't aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
 	// If they aren't, we need to pad the source data.
 	// https://docs.microsoft.com/en-us/windows/win32/direct3d12/upload-and-readback-of-texture-data
-	if ((component.description.width * GetResourceFormatSize(component.description.format) / 8) % D3D12_TEXTURE_DATA_PITCH_ALIGNMENT != 0)
+	if (rowSize % D3D12_TEXTURE_DATA_PITCH_ALIGNMENT != 0)
 	{
 		VGScopedCPUStat("Source Padding");
 
 		// Log a message since this isn't a cheap and should probably be avoided.
 		VGLog(logRendering, "Texture write misalignment, padding out source data.");
 
-		alignedSource.resize(
-			sourceCopyDesc.PlacedFootprint.Footprint.RowPitch *
-			component.description.height *
-			component.description.depth *
-			(GetResourceFormatSize(component.description.format) / 8));
+		const auto rowPitch = sourceCopyDesc.PlacedFootprint.Footprint.RowPitch;
+		alignedSource.resize(rowPitch * rows * component.description.depth);
 
 		VGAssert(source.size() < alignedSource.size(), "Expected different aligned size, something probably broke with texture writes.");
 
 		// #TODO: Assuming a full resource write here.
 		for (int i = 0; i < component.description.depth; ++i)
 		{
-			for (int j = 0; j < component.description.height; ++j)
+			for (uint32_t j = 0; j < rows; ++j)
 			{
-				const auto rowSize = sourceCopyDesc.PlacedFootprint.Footprint.RowPitch;
-				const auto sliceSize = rowSize * component.description.height;
-
-				const auto destOffset = j * rowSize + i * sliceSize;
-				const auto sourceOffset = j * component.description.width + i * component.description.width * component.description.height;
+				const auto destOffset = j * rowPitch + i * rowPitch * rows;
+				const auto sourceOffset = j * rowSize + i * rowSize * rows;
 
-				std::memcpy(alignedSource.data() + destOffset, source.data() + sourceOffset, component.description.width);
+				std::memcpy(alignedSource.data() + destOffset, source.data() + sourceOffset, rowSize);
 			}
 		}
 
@@ -776,6 +775,58 @@ void ResourceManager::Write(TextureHandle target, const std::vector<uint8_t>& so
 	}
 }
 
+void ResourceManager::Write(TextureHandle target, std::span<const uint8_t> source, uint32_t mip)
+{
+	VGScopedCPUStat("Texture Mip Write");
+
+	auto& component = Get(target);
+
+	VGAssert(component.description.accessFlags & AccessFlag::CPUWrite, "Failed to write to texture, no CPU write access.");
+	VGAssert(component.description.depth == 1, "Failed to write to texture mip, only 2D textures are supported.");
+
+	const auto frameIndex = device->GetFrameIndex();
+	uploadOffsets[frameIndex] = AlignedSize(uploadOffsets[frameIndex], D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	D3D12_TEXTURE_COPY_LOCATION sourceCopyDesc{};
+	sourceCopyDesc.pResource = uploadResources[frameIndex]->GetResource();
+	sourceCopyDesc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+
+	const D3D12_RESOURCE_DESC targetDescription = component.Native()->GetDesc();
+	VGAssert(mip < targetDescription.MipLevels, "Failed to write to texture, mip out of range.");
+
+	uint32_t rows;
+	uint64_t rowSize;
+	uint64_t requiredCopySize;
+	device->Native()->GetCopyableFootprints(&targetDescription, mip, 1, uploadOffsets[frameIndex], &sourceCopyDesc.PlacedFootprint, &rows, &rowSize, &requiredCopySize);
+
+	VGAssert(source.size() == rows * rowSize, "Failed to write to texture, source doesn't match the mip size.");
+	VGAssert(uploadOffsets[frameIndex] + requiredCopySize <= uploadResources[frameIndex]->GetResource()->GetDesc().Width, "Failed to write to texture, exhausted frame upload heap.");
+
+	// Rows are copied individually, since small mips are always narrower than the pitch alignment.
+	auto* uploadPtr = static_cast<uint8_t*>(uploadPtrs[frameIndex]) + uploadOffsets[frameIndex];
+	for (uint32_t i = 0; i < rows; ++i)
+	{
+		std::memcpy(uploadPtr + i * sourceCopyDesc.PlacedFootprint.Footprint.RowPitch, source.data() + i * rowSize, rowSize);
+	}
+
+	// Ensure we're in the proper state.
+	if (component.state != D3D12_RESOURCE_STATE_COPY_DEST)
+	{
+		device->GetDirectList().TransitionBarrier(target, D3D12_RESOURCE_STATE_COPY_DEST);
+		device->GetDirectList().FlushBarriers();
+	}
+
+	D3D12_TEXTURE_COPY_LOCATION targetCopyDesc{};
+	targetCopyDesc.pResource = component.Native();
+	targetCopyDesc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	targetCopyDesc.SubresourceIndex = mip;
+
+	auto* targetCommandList = device->GetDirectList().Native();
+	targetCommandList->CopyTextureRegion(&targetCopyDesc, 0, 0, 0, &sourceCopyDesc, nullptr);
+
+	uploadOffsets[frameIndex] += requiredCopySize;
+}
+
 void ResourceManager::GenerateMipmaps(CommandList& list, TextureHandle texture)
 {
 	VGScopedCPUStat("Generate mipmaps");
@@ -783,6 +834,7 @@ void ResourceManager::GenerateMipmaps(CommandList& list, TextureHandle texture)
 
 	auto& textureComponent = Get(texture);
 	VGAssert(textureComponent.description.mipMapping, "Textures must have mipmapping enabled in order to generate mipmaps.");
+	VGAssert(!IsResourceFormatBlockCompressed(textureComponent.description.format), "Block compressed textures can't generate mipmaps.");
 
 	// Transition to UAV state.
 	list.TransitionBarrier(texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
@@ -799,6 +851,74 @@ void ResourceManager::GenerateMipmaps(CommandList& list, TextureHandle texture)
 	}
 }
 
+void ResourceManager::Read(CommandList& list, TextureHandle source, std::function<void(std::vector<uint8_t>&&)> callback)
+{
+	VGScopedCPUStat("Texture Read");
+
+	auto& component = Get(source);
+
+	VGAssert(!component.description.array, "Failed to read texture, arrays are unsupported.");
+
+	TextureReadback readback;
+	readback.callback = std::move(callback);
+
+	D3D12_RESOURCE_DESC sourceDescriptionCopy = component.Native()->GetDesc();
+
+	uint64_t requiredCopySize;
+	device->Native()->GetCopyableFootprints(&sourceDescriptionCopy, 0, 1, 0, &readback.footprint, &readback.rows, &readback.rowSize, &requiredCopySize);
+
+	D3D12_RESOURCE_DESC resourceDesc{};
+	resourceDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDesc.Width = requiredCopySize;
+	resourceDesc.Height = 1;
+	resourceDesc.DepthOrArraySize = 1;
+	resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+	resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;  // Buffers are always row major.
+	resourceDesc.MipLevels = 1;
+	resourceDesc.SampleDesc.Count = 1;
+	resourceDesc.SampleDesc.Quality = 0;
+	resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	D3D12MA::ALLOCATION_DESC allocationDesc{};
+	allocationDesc.HeapType = D3D12_HEAP_TYPE_READBACK;
+	allocationDesc.Flags = D3D12MA::ALLOCATION_FLAG_NONE;
+
+	ID3D12Resource* rawResource = nullptr;
+	D3D12MA::Allocation* allocationHandle = nullptr;
+
+	// Readback heap resources must always be in copy destination state.
+	auto result = device->allocator->CreateResource(&allocationDesc, &resourceDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, &allocationHandle, IID_PPV_ARGS(&rawResource));
+	if (FAILED(result))
+	{
+		VGLogError(logRendering, "Failed to allocate readback resource: {}", result);
+
+		return;
+	}
+
+	rawResource->Release();
+
+	readback.buffer.Reset(allocationHandle);
+	SetResourceName(readback.buffer, VGText("Readback heap"));
+
+	list.TransitionBarrier(source, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	list.FlushBarriers();
+
+	D3D12_TEXTURE_COPY_LOCATION sourceCopyDesc{};
+	sourceCopyDesc.pResource = component.Native();
+	sourceCopyDesc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	sourceCopyDesc.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION targetCopyDesc{};
+	targetCopyDesc.pResource = readback.buffer->GetResource();
+	targetCopyDesc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	targetCopyDesc.PlacedFootprint = readback.footprint;
+
+	list.Native()->CopyTextureRegion(&targetCopyDesc, 0, 0, 0, &sourceCopyDesc, nullptr);
+
+	frameReadbacks[device->GetFrameIndex()].emplace_back(std::move(readback));
+}
+
 void ResourceManager::CleanupFrameResources(size_t frame)
 {
 	VGScopedCPUStat("Cleanup Frame Resources");
@@ -827,4 +947,37 @@ void ResourceManager::CleanupFrameResources(size_t frame)
 	}
 
 	frameDescriptors[frameIndex].clear();
+
+	for (auto& readback : frameReadbacks[frameIndex])
+	{
+		VGScopedCPUStat("Complete Texture Read");
+
+		const auto& footprint = readback.footprint.Footprint;
+		const auto readSize = static_cast<size_t>(footprint.RowPitch) * readback.rows * footprint.Depth;
+
+		void* mappedPtr = nullptr;
+		D3D12_RANGE readRange{ 0, readSize };
+
+		auto result = readback.buffer->GetResource()->Map(0, &readRange, &mappedPtr);
+		if (FAILED(result))
+		{
+			VGLogError(logRendering, "Failed to map readback resource: {}", result);
+
+			continue;
+		}
+
+		// Remove the row pitch alignment.
+		std::vector<uint8_t> data(readback.rowSize * readback.rows * footprint.Depth);
+		for (uint32_t i = 0; i < readback.rows * footprint.Depth; ++i)
+		{
+			std::memcpy(data.data() + i * readback.rowSize, static_cast<uint8_t*>(mappedPtr) + i * footprint.RowPitch, readback.rowSize);
+		}
+
+		D3D12_RANGE writeRange{ 0, 0 };
+		readback.buffer->GetResource()->Unmap(0, &writeRange);
+
+		readback.callback(std::move(data));
+	}
+
+	frameReadbacks[frameIndex].clear();
 }
\ No newline at end of file
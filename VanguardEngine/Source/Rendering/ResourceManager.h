@@ -11,9 +11,11 @@
 
 #include <vector>
 #include <memory>
+#include <functional>
 #include <string_view>
 #include <iterator>
 #include <ranges>
+#include <span>
 
 class RenderDevice;
 class CommandList;
@@ -43,6 +45,18 @@ private:
 	std::vector<std::vector<BufferHandle>> frameBuffers;
 	std::vector<std::vector<DescriptorHandle>> frameDescriptors;
 
+	struct TextureReadback
+	{
+		ResourcePtr<D3D12MA::Allocation> buffer;  // Readback heap.
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+		uint32_t rows;
+		uint64_t rowSize;
+		std::function<void(std::vector<uint8_t>&&)> callback;
+	};
+
+	// Completed once the GPU has finished their frame.
+	std::vector<std::vector<TextureReadback>> frameReadbacks;
+
 	size_t ComputeBufferWidth(const BufferDescription& description) const;
 
 	void CreateResourceViews(BufferComponent& target);
@@ -97,14 +111,22 @@ public:
 	void Write(TextureHandle target, const T& source);
 
 	// Writing a raw buffer of bytes.
-	void Write(BufferHandle target, const std::vector<uint8_t>& source, size_t targetOffset = 0);
+	void Write(BufferHandle target, std::span<const uint8_t> source, size_t targetOffset = 0);
+	void Write(BufferHandle target, const std::vector<uint8_t>& source, size_t targetOffset = 0) { Write(target, std::span<const uint8_t>{ source }, targetOffset); }
 	void Write(TextureHandle target, const std::vector<uint8_t>& source);
+	// Writes a single mip of a 2D texture, from tightly packed rows.
+	void Write(TextureHandle target, std::span<const uint8_t> source, uint32_t mip);
+	void Write(TextureHandle target, const std::vector<uint8_t>& source, uint32_t mip) { Write(target, std::span<const uint8_t>{ source }, mip); }
 
 	void Destroy(BufferHandle handle);
 	void Destroy(TextureHandle handle);
 
 	void GenerateMipmaps(CommandList& list, TextureHandle texture);
 
+	// Copies the first mip of a non-array texture back to the CPU. The callback receives tightly packed rows once the GPU has
+	// finished the frame, during the cleanup of that frame's resources.
+	void Read(CommandList& list, TextureHandle source, std::function<void(std::vector<uint8_t>&&)> callback);
+
 	void AddFrameResource(size_t frameIndex, const BufferHandle handle);
 	void AddFrameResource(size_t frameIndex, const TextureHandle handle);
 	void AddFrameDescriptor(size_t frameIndex, DescriptorHandle handle);
@@ -0,0 +1,1013 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/SceneBvh.h>
+#include <Rendering/RenderComponents.h>
+#include <Rendering/MeshBounds.h>
+#include <Core/CoreComponents.h>
+#include <Utility/Random.h>
+#include <Utility/Math.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <execution>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr float emptyBound = std::numeric_limits<float>::max();
+
+	float Component(const XMFLOAT3& vector, int axis)
+	{
+		return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+	}
+
+	XMVECTOR LoadLanes(const float* lanes)
+	{
+		return XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(lanes));
+	}
+
+	float SurfaceArea(FXMVECTOR min, FXMVECTOR max)
+	{
+		XMFLOAT3 extent;
+		XMStoreFloat3(&extent, XMVectorSubtract(max, min));
+
+		if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f)
+		{
+			return 0.f;  // Empty.
+		}
+
+		return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	// Same world matrix as the instance builder.
+	XMMATRIX GetWorldMatrix(const entt::registry& registry, entt::entity entity, const TransformComponent& transform)
+	{
+		const auto* worldTransform = registry.try_get<WorldTransformComponent>(entity);
+		return worldTransform ? worldTransform->worldMatrix : ComposeTransformMatrix(transform.scale, transform.rotation, transform.translation);
+	}
+
+	// World space box around every subset's object space box.
+	void ComputeBounds(const XMMATRIX& worldMatrix, const MeshComponent& mesh, XMFLOAT3& min, XMFLOAT3& max)
+	{
+		if (mesh.subsets.empty())
+		{
+			XMStoreFloat3(&min, worldMatrix.r[3]);
+			XMStoreFloat3(&max, worldMatrix.r[3]);
+			return;
+		}
+
+		auto boxMin = XMVectorReplicate(emptyBound);
+		auto boxMax = XMVectorReplicate(-emptyBound);
+
+		for (const auto& subset : mesh.subsets)
+		{
+			XMFLOAT3 subsetMin;
+			XMFLOAT3 subsetMax;
+			MeshBounds::TransformBox(subset.bounds, worldMatrix, subsetMin, subsetMax);
+			boxMin = XMVectorMin(boxMin, XMLoadFloat3(&subsetMin));
+			boxMax = XMVectorMax(boxMax, XMLoadFloat3(&subsetMax));
+		}
+
+		XMStoreFloat3(&min, boxMin);
+		XMStoreFloat3(&max, boxMax);
+	}
+
+	void ComputeBounds(const entt::registry& registry, entt::entity entity, const TransformComponent& transform, const MeshComponent& mesh, XMFLOAT3& min, XMFLOAT3& max)
+	{
+		ComputeBounds(GetWorldMatrix(registry, entity, transform), mesh, min, max);
+	}
+
+	// Planes of the clip space inequalities -w <= x <= w, -w <= y <= w and 0 <= z <= w, inside is positive.
+	void ExtractFrustumPlanes(const XMMATRIX& viewProjection, XMFLOAT4 planes[6])
+	{
+		const auto columns = XMMatrixTranspose(viewProjection);
+		XMStoreFloat4(&planes[0], XMVectorAdd(columns.r[3], columns.r[0]));
+		XMStoreFloat4(&planes[1], XMVectorSubtract(columns.r[3], columns.r[0]));
+		XMStoreFloat4(&planes[2], XMVectorAdd(columns.r[3], columns.r[1]));
+		XMStoreFloat4(&planes[3], XMVectorSubtract(columns.r[3], columns.r[1]));
+		XMStoreFloat4(&planes[4], columns.r[2]);
+		XMStoreFloat4(&planes[5], XMVectorSubtract(columns.r[3], columns.r[2]));
+	}
+
+	// Conservative, only rejects boxes entirely behind one of the planes.
+	bool BoxInFrustum(const XMFLOAT4 planes[6], const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			const auto& plane = planes[i];
+			const auto x = plane.x > 0.f ? max.x : min.x;
+			const auto y = plane.y > 0.f ? max.y : min.y;
+			const auto z = plane.z > 0.f ? max.z : min.z;
+
+			// Same evaluation order as the node test, so a primitive can't pass where its ancestors failed.
+			if (((plane.x * x + plane.y * y) + plane.z * z) + plane.w < 0.f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool BoxInSphere(const XMFLOAT3& center, float radiusSquared, const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		const auto dx = std::max({ min.x - center.x, center.x - max.x, 0.f });
+		const auto dy = std::max({ min.y - center.y, center.y - max.y, 0.f });
+		const auto dz = std::max({ min.z - center.z, center.z - max.z, 0.f });
+
+		return (dx * dx + dy * dy) + dz * dz <= radiusSquared;
+	}
+
+	// Returns the entry distance, or a negative value on a miss.
+	float RayBox(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, float maxDistance, const XMFLOAT3& min, const XMFLOAT3& max)
+	{
+		const auto tx1 = (min.x - origin.x) * inverseDirection.x;
+		const auto tx2 = (max.x - origin.x) * inverseDirection.x;
+		const auto ty1 = (min.y - origin.y) * inverseDirection.y;
+		const auto ty2 = (max.y - origin.y) * inverseDirection.y;
+		const auto tz1 = (min.z - origin.z) * inverseDirection.z;
+		const auto tz2 = (max.z - origin.z) * inverseDirection.z;
+
+		const auto tMin = std::max({ std::min(tx1, tx2), std::min(ty1, ty2), std::min(tz1, tz2), 0.f });
+		const auto tMax = std::min({ std::max(tx1, tx2), std::max(ty1, ty2), std::max(tz1, tz2), maxDistance });
+
+		return tMax >= tMin ? tMin : -1.f;
+	}
+
+	// Zero direction components are nudged so that the slabs produce infinities instead of NaNs.
+	XMFLOAT3 InverseDirection(const XMFLOAT3& direction)
+	{
+		constexpr float epsilon = 1e-20f;
+		const auto Inverse = [](float value) { return 1.f / (std::abs(value) < epsilon ? (value < 0.f ? -epsilon : epsilon) : value); };
+
+		return { Inverse(direction.x), Inverse(direction.y), Inverse(direction.z) };
+	}
+
+	// Binned SAH split of the primitive range along the axis of largest centroid extent, returns the first primitive of the right side.
+	template <typename T>
+	uint32_t SplitRange(std::vector<T>& primitives, uint32_t begin, uint32_t end)
+	{
+		constexpr int binCount = 16;
+
+		// Centroids are doubled, which doesn't affect the split.
+		auto centroidMin = XMVectorReplicate(emptyBound);
+		auto centroidMax = XMVectorReplicate(-emptyBound);
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto centroid = XMVectorAdd(XMLoadFloat3(&primitives[i].min), XMLoadFloat3(&primitives[i].max));
+			centroidMin = XMVectorMin(centroidMin, centroid);
+			centroidMax = XMVectorMax(centroidMax, centroid);
+		}
+
+		XMFLOAT3 low;
+		XMFLOAT3 extent;
+		XMStoreFloat3(&low, centroidMin);
+		XMStoreFloat3(&extent, XMVectorSubtract(centroidMax, centroidMin));
+
+		const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		const auto axisMin = Component(low, axis);
+		const auto axisExtent = Component(extent, axis);
+
+		if (axisExtent <= 0.f)
+		{
+			return (begin + end) / 2;  // Every centroid coincides, any split is as good as another.
+		}
+
+		const auto Centroid = [axis](const T& primitive)
+		{
+			return Component(primitive.min, axis) + Component(primitive.max, axis);
+		};
+
+		const auto binScale = binCount / axisExtent;
+		const auto BinIndex = [&](const T& primitive)
+		{
+			return std::min(static_cast<int>((Centroid(primitive) - axisMin) * binScale), binCount - 1);
+		};
+
+		XMVECTOR binMin[binCount];
+		XMVECTOR binMax[binCount];
+		uint32_t binCounts[binCount] = {};
+		std::fill(std::begin(binMin), std::end(binMin), XMVectorReplicate(emptyBound));
+		std::fill(std::begin(binMax), std::end(binMax), XMVectorReplicate(-emptyBound));
+
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto bin = BinIndex(primitives[i]);
+			binMin[bin] = XMVectorMin(binMin[bin], XMLoadFloat3(&primitives[i].min));
+			binMax[bin] = XMVectorMax(binMax[bin], XMLoadFloat3(&primitives[i].max));
+			++binCounts[bin];
+		}
+
+		// Right side costs of splitting before each bin.
+		float rightCosts[binCount] = {};
+		auto rightMin = XMVectorReplicate(emptyBound);
+		auto rightMax = XMVectorReplicate(-emptyBound);
+		uint32_t rightCount = 0;
+		for (int i = binCount - 1; i > 0; --i)
+		{
+			rightMin = XMVectorMin(rightMin, binMin[i]);
+			rightMax = XMVectorMax(rightMax, binMax[i]);
+			rightCount += binCounts[i];
+			rightCosts[i] = SurfaceArea(rightMin, rightMax) * rightCount;
+		}
+
+		int bestSplit = 0;
+		auto bestCost = std::numeric_limits<float>::max();
+		auto leftMin = XMVectorReplicate(emptyBound);
+		auto leftMax = XMVectorReplicate(-emptyBound);
+		uint32_t leftCount = 0;
+		for (int i = 1; i < binCount; ++i)
+		{
+			leftMin = XMVectorMin(leftMin, binMin[i - 1]);
+			leftMax = XMVectorMax(leftMax, binMax[i - 1]);
+			leftCount += binCounts[i - 1];
+
+			const auto cost = SurfaceArea(leftMin, leftMax) * leftCount + rightCosts[i];
+			if (leftCount > 0 && leftCount < end - begin && cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		if (bestSplit > 0)
+		{
+			const auto middle = std::partition(primitives.begin() + begin, primitives.begin() + end, [&](const auto& primitive)
+			{
+				return BinIndex(primitive) < bestSplit;
+			});
+
+			return static_cast<uint32_t>(middle - primitives.begin());
+		}
+
+		// Everything landed in one bin, fall back to a median split.
+		const auto middle = (begin + end) / 2;
+		std::nth_element(primitives.begin() + begin, primitives.begin() + middle, primitives.begin() + end, [&](const auto& left, const auto& right)
+		{
+			return Centroid(left) < Centroid(right);
+		});
+
+		return middle;
+	}
+}
+
+void SceneBvh::OnStructureChanged(entt::registry& registry, entt::entity entity)
+{
+	registry.ctx<SceneBvh>().structureDirty = true;
+}
+
+SceneBvh::Tree SceneBvh::Build(std::vector<Primitive> primitives)
+{
+	VGScopedCPUStat("Build Scene BVH");
+
+	Tree tree;
+	tree.primitives = std::move(primitives);
+	tree.primitiveNodes.resize(tree.primitives.size());
+
+	if (tree.primitives.empty())
+	{
+		return tree;
+	}
+
+	Node emptyNode;
+	std::fill(std::begin(emptyNode.minX), std::end(emptyNode.minX), emptyBound);
+	std::fill(std::begin(emptyNode.minY), std::end(emptyNode.minY), emptyBound);
+	std::fill(std::begin(emptyNode.minZ), std::end(emptyNode.minZ), emptyBound);
+	std::fill(std::begin(emptyNode.maxX), std::end(emptyNode.maxX), -emptyBound);
+	std::fill(std::begin(emptyNode.maxY), std::end(emptyNode.maxY), -emptyBound);
+	std::fill(std::begin(emptyNode.maxZ), std::end(emptyNode.maxZ), -emptyBound);
+	std::fill(std::begin(emptyNode.children), std::end(emptyNode.children), invalidIndex);
+	std::fill(std::begin(emptyNode.counts), std::end(emptyNode.counts), 0);
+
+	struct Task
+	{
+		uint32_t begin;
+		uint32_t end;
+		uint32_t parent;
+		uint32_t lane;
+	};
+
+	// Depth-first with an explicit stack, degenerate splits can't overflow the call stack.
+	std::vector<Task> tasks{ { 0, static_cast<uint32_t>(tree.primitives.size()), invalidIndex, 0 } };
+	while (!tasks.empty())
+	{
+		const auto task = tasks.back();
+		tasks.pop_back();
+
+		const auto nodeIndex = static_cast<uint32_t>(tree.nodes.size());
+		tree.nodes.emplace_back(emptyNode);
+		tree.parents.emplace_back(task.parent);
+
+		if (task.parent != invalidIndex)
+		{
+			tree.nodes[task.parent].children[task.lane] = nodeIndex;
+		}
+
+		// Two levels of binary splits give the four children.
+		std::pair<uint32_t, uint32_t> ranges[4];
+		uint32_t rangeCount = 0;
+
+		if (task.end - task.begin <= leafSize)
+		{
+			ranges[rangeCount++] = { task.begin, task.end };  // Only a root can be this small.
+		}
+
+		else
+		{
+			const auto middle = SplitRange(tree.primitives, task.begin, task.end);
+			for (const auto [begin, end] : { std::pair{ task.begin, middle }, std::pair{ middle, task.end } })
+			{
+				if (end - begin > leafSize)
+				{
+					const auto split = SplitRange(tree.primitives, begin, end);
+					ranges[rangeCount++] = { begin, split };
+					ranges[rangeCount++] = { split, end };
+				}
+
+				else
+				{
+					ranges[rangeCount++] = { begin, end };
+				}
+			}
+		}
+
+		for (uint32_t lane = 0; lane < rangeCount; ++lane)
+		{
+			const auto [begin, end] = ranges[lane];
+			if (end - begin <= leafSize)
+			{
+				tree.nodes[nodeIndex].children[lane] = begin;
+				tree.nodes[nodeIndex].counts[lane] = end - begin;
+				std::fill(tree.primitiveNodes.begin() + begin, tree.primitiveNodes.begin() + end, nodeIndex);
+			}
+
+			else
+			{
+				tasks.emplace_back(Task{ begin, end, nodeIndex, lane });
+			}
+		}
+	}
+
+	Refit(tree, std::vector<uint8_t>(tree.nodes.size(), 1));
+
+	return tree;
+}
+
+void SceneBvh::Refit(Tree& tree, const std::vector<uint8_t>& dirty)
+{
+	// Children always follow their parents, so a reverse sweep sees refit children first.
+	for (auto i = tree.nodes.size(); i-- > 0;)
+	{
+		if (!dirty[i])
+		{
+			continue;
+		}
+
+		auto& node = tree.nodes[i];
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (node.children[lane] == invalidIndex)
+			{
+				continue;
+			}
+
+			auto min = XMVectorReplicate(emptyBound);
+			auto max = XMVectorReplicate(-emptyBound);
+
+			if (node.counts[lane] > 0)
+			{
+				for (auto j = node.children[lane]; j < node.children[lane] + node.counts[lane]; ++j)
+				{
+					min = XMVectorMin(min, XMLoadFloat3(&tree.primitives[j].min));
+					max = XMVectorMax(max, XMLoadFloat3(&tree.primitives[j].max));
+				}
+			}
+
+			else
+			{
+				const auto& child = tree.nodes[node.children[lane]];
+				const auto HorizontalMin = [](const float* lanes) { return std::min({ lanes[0], lanes[1], lanes[2], lanes[3] }); };
+				const auto HorizontalMax = [](const float* lanes) { return std::max({ lanes[0], lanes[1], lanes[2], lanes[3] }); };
+				min = XMVectorSet(HorizontalMin(child.minX), HorizontalMin(child.minY), HorizontalMin(child.minZ), 0.f);
+				max = XMVectorSet(HorizontalMax(child.maxX), HorizontalMax(child.maxY), HorizontalMax(child.maxZ), 0.f);
+			}
+
+			const auto oldArea = SurfaceArea(XMVectorSet(node.minX[lane], node.minY[lane], node.minZ[lane], 0.f), XMVectorSet(node.maxX[lane], node.maxY[lane], node.maxZ[lane], 0.f));
+			tree.cost += SurfaceArea(min, max) - oldArea;
+
+			node.minX[lane] = XMVectorGetX(min);
+			node.minY[lane] = XMVectorGetY(min);
+			node.minZ[lane] = XMVectorGetZ(min);
+			node.maxX[lane] = XMVectorGetX(max);
+			node.maxY[lane] = XMVectorGetY(max);
+			node.maxZ[lane] = XMVectorGetZ(max);
+		}
+	}
+}
+
+void SceneBvh::Gather(const entt::registry& registry, std::vector<Primitive>& primitives)
+{
+	const auto view = registry.view<const TransformComponent, const MeshComponent>();
+	primitives.reserve(view.size_hint());
+
+	view.each([&](auto entity, const auto& transform, const auto& mesh)
+	{
+		auto& primitive = primitives.emplace_back(Primitive{ entity });
+		const auto worldMatrix = GetWorldMatrix(registry, entity, transform);
+		XMStoreFloat4x4(&primitive.world, worldMatrix);
+		ComputeBounds(worldMatrix, mesh, primitive.min, primitive.max);
+	});
+}
+
+void SceneBvh::Adopt(bool wait)
+{
+	if (!pendingBuild.valid())
+	{
+		return;
+	}
+
+	if (!wait && pendingBuild.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready)
+	{
+		return;
+	}
+
+	auto result = pendingBuild.get();
+	if (pendingGeneration == generation)
+	{
+		tree = std::move(result);
+		builtCost = tree.cost;
+		++backgroundRebuilds;
+	}
+}
+
+SceneBvh::SceneBvh(entt::registry& registry)
+{
+	registry.on_construct<MeshComponent>().connect<&SceneBvh::OnStructureChanged>();
+	registry.on_destroy<MeshComponent>().connect<&SceneBvh::OnStructureChanged>();
+	registry.on_construct<TransformComponent>().connect<&SceneBvh::OnStructureChanged>();
+	registry.on_destroy<TransformComponent>().connect<&SceneBvh::OnStructureChanged>();
+}
+
+void SceneBvh::Update(const entt::registry& registry)
+{
+	VGScopedCPUStat("Update Scene BVH");
+
+	movedCount = 0;
+
+	if (structureDirty)
+	{
+		std::vector<Primitive> primitives;
+		Gather(registry, primitives);
+
+		tree = Build(std::move(primitives));
+		builtCost = tree.cost;
+		++generation;
+		structureDirty = false;
+
+		return;
+	}
+
+	// Primitives moved since the snapshot was taken are picked up by the refit below.
+	Adopt(false);
+
+	movedPrimitives.assign(tree.primitives.size(), 0);
+
+	{
+		VGScopedCPUStat("Detect Moved");
+
+		// Comparing world matrices is far cheaper than transforming every subset's bounds, only moved primitives recompute them.
+		const auto view = registry.view<const TransformComponent, const MeshComponent>();
+		std::for_each(std::execution::par, tree.primitives.begin(), tree.primitives.end(), [&](auto& primitive)
+		{
+			const auto [transform, mesh] = view.get<const TransformComponent, const MeshComponent>(primitive.entity);
+
+			const auto worldMatrix = GetWorldMatrix(registry, primitive.entity, transform);
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, worldMatrix);
+
+			if (std::memcmp(&world, &primitive.world, sizeof(world)) != 0)
+			{
+				primitive.world = world;
+				ComputeBounds(worldMatrix, mesh, primitive.min, primitive.max);
+				movedPrimitives[&primitive - tree.primitives.data()] = 1;
+			}
+		});
+	}
+
+	dirtyNodes.assign(tree.nodes.size(), 0);
+
+	for (size_t i = 0; i < movedPrimitives.size(); ++i)
+	{
+		if (movedPrimitives[i])
+		{
+			++movedCount;
+
+			// Stop at the first ancestor already marked, the rest of the path is marked as well.
+			for (auto node = tree.primitiveNodes[i]; node != invalidIndex && !dirtyNodes[node]; node = tree.parents[node])
+			{
+				dirtyNodes[node] = 1;
+			}
+		}
+	}
+
+	if (movedCount > 0)
+	{
+		VGScopedCPUStat("Refit");
+
+		Refit(tree, dirtyNodes);
+	}
+
+	if (!pendingBuild.valid() && tree.cost > builtCost * rebuildThreshold)
+	{
+		pendingBuild = std::async(std::launch::async, &SceneBvh::Build, tree.primitives);
+		pendingGeneration = generation;
+	}
+}
+
+void SceneBvh::Flush()
+{
+	Adopt(true);
+}
+
+void SceneBvh::QueryFrustum(const XMMATRIX& viewProjection, std::vector<entt::entity>& results) const
+{
+	if (tree.nodes.empty())
+	{
+		return;
+	}
+
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(viewProjection, planes);
+
+	const auto zero = XMVectorZero();
+
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty())
+	{
+		const auto& node = tree.nodes[stack.back()];
+		stack.pop_back();
+
+		const auto minX = LoadLanes(node.minX);
+		const auto minY = LoadLanes(node.minY);
+		const auto minZ = LoadLanes(node.minZ);
+		const auto maxX = LoadLanes(node.maxX);
+		const auto maxY = LoadLanes(node.maxY);
+		const auto maxZ = LoadLanes(node.maxZ);
+
+		auto outside = XMVectorFalseInt();
+		for (const auto& plane : planes)
+		{
+			const auto a = XMVectorReplicate(plane.x);
+			const auto b = XMVectorReplicate(plane.y);
+			const auto c = XMVectorReplicate(plane.z);
+			const auto d = XMVectorReplicate(plane.w);
+
+			// Corner furthest along the plane normal.
+			const auto x = XMVectorSelect(minX, maxX, XMVectorGreater(a, zero));
+			const auto y = XMVectorSelect(minY, maxY, XMVectorGreater(b, zero));
+			const auto z = XMVectorSelect(minZ, maxZ, XMVectorGreater(c, zero));
+
+			// Unfused to match the primitive test exactly.
+			const auto distance = XMVectorAdd(XMVectorAdd(XMVectorAdd(XMVectorMultiply(a, x), XMVectorMultiply(b, y)), XMVectorMultiply(c, z)), d);
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, zero));
+		}
+
+		uint32_t outsideLanes[4];
+		XMStoreInt4(outsideLanes, outside);
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (outsideLanes[lane] || node.children[lane] == invalidIndex)
+			{
+				continue;
+			}
+
+			if (node.counts[lane] > 0)
+			{
+				for (auto i = node.children[lane]; i < node.children[lane] + node.counts[lane]; ++i)
+				{
+					const auto& primitive = tree.primitives[i];
+					if (BoxInFrustum(planes, primitive.min, primitive.max))
+					{
+						results.emplace_back(primitive.entity);
+					}
+				}
+			}
+
+			else
+			{
+				stack.emplace_back(node.children[lane]);
+			}
+		}
+	}
+}
+
+void SceneBvh::QuerySphere(const XMFLOAT3& center, float radius, std::vector<entt::entity>& results) const
+{
+	if (tree.nodes.empty())
+	{
+		return;
+	}
+
+	const auto zero = XMVectorZero();
+	const auto centerX = XMVectorReplicate(center.x);
+	const auto centerY = XMVectorReplicate(center.y);
+	const auto centerZ = XMVectorReplicate(center.z);
+	const auto radiusSquared = XMVectorReplicate(radius * radius);
+
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty())
+	{
+		const auto& node = tree.nodes[stack.back()];
+		stack.pop_back();
+
+		// Distance from the center to the closest point of each box.
+		const auto dx = XMVectorMax(XMVectorMax(XMVectorSubtract(LoadLanes(node.minX), centerX), XMVectorSubtract(centerX, LoadLanes(node.maxX))), zero);
+		const auto dy = XMVectorMax(XMVectorMax(XMVectorSubtract(LoadLanes(node.minY), centerY), XMVectorSubtract(centerY, LoadLanes(node.maxY))), zero);
+		const auto dz = XMVectorMax(XMVectorMax(XMVectorSubtract(LoadLanes(node.minZ), centerZ), XMVectorSubtract(centerZ, LoadLanes(node.maxZ))), zero);
+		const auto distanceSquared = XMVectorAdd(XMVectorAdd(XMVectorMultiply(dx, dx), XMVectorMultiply(dy, dy)), XMVectorMultiply(dz, dz));
+
+		uint32_t hitLanes[4];
+		XMStoreInt4(hitLanes, XMVectorLessOrEqual(distanceSquared, radiusSquared));
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (!hitLanes[lane] || node.children[lane] == invalidIndex)
+			{
+				continue;
+			}
+
+			if (node.counts[lane] > 0)
+			{
+				for (auto i = node.children[lane]; i < node.children[lane] + node.counts[lane]; ++i)
+				{
+					const auto& primitive = tree.primitives[i];
+					if (BoxInSphere(center, radius * radius, primitive.min, primitive.max))
+					{
+						results.emplace_back(primitive.entity);
+					}
+				}
+			}
+
+			else
+			{
+				stack.emplace_back(node.children[lane]);
+			}
+		}
+	}
+}
+
+entt::entity SceneBvh::QueryRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float* hitDistance) const
+{
+	if (tree.nodes.empty())
+	{
+		return entt::null;
+	}
+
+	XMFLOAT3 normalized;
+	XMStoreFloat3(&normalized, XMVector3Normalize(XMLoadFloat3(&direction)));
+	const auto inverseDirection = InverseDirection(normalized);
+
+	const auto zero = XMVectorZero();
+	const auto originX = XMVectorReplicate(origin.x);
+	const auto originY = XMVectorReplicate(origin.y);
+	const auto originZ = XMVectorReplicate(origin.z);
+	const auto inverseX = XMVectorReplicate(inverseDirection.x);
+	const auto inverseY = XMVectorReplicate(inverseDirection.y);
+	const auto inverseZ = XMVectorReplicate(inverseDirection.z);
+
+	entt::entity closest = entt::null;
+	auto closestDistance = maxDistance;
+
+	// Entry distances are kept with the nodes, anything entered beyond the closest hit is skipped when popped.
+	std::vector<std::pair<uint32_t, float>> stack{ { 0, 0.f } };
+	while (!stack.empty())
+	{
+		const auto [nodeIndex, entry] = stack.back();
+		stack.pop_back();
+
+		if (entry > closestDistance)
+		{
+			continue;
+		}
+
+		const auto& node = tree.nodes[nodeIndex];
+
+		const auto tx1 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.minX), originX), inverseX);
+		const auto tx2 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.maxX), originX), inverseX);
+		const auto ty1 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.minY), originY), inverseY);
+		const auto ty2 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.maxY), originY), inverseY);
+		const auto tz1 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.minZ), originZ), inverseZ);
+		const auto tz2 = XMVectorMultiply(XMVectorSubtract(LoadLanes(node.maxZ), originZ), inverseZ);
+
+		const auto tMin = XMVectorMax(XMVectorMax(XMVectorMin(tx1, tx2), XMVectorMin(ty1, ty2)), XMVectorMax(XMVectorMin(tz1, tz2), zero));
+		const auto tMax = XMVectorMin(XMVectorMin(XMVectorMax(tx1, tx2), XMVectorMax(ty1, ty2)), XMVectorMin(XMVectorMax(tz1, tz2), XMVectorReplicate(closestDistance)));
+
+		uint32_t hitLanes[4];
+		XMFLOAT4 entries;
+		XMStoreInt4(hitLanes, XMVectorGreaterOrEqual(tMax, tMin));
+		XMStoreFloat4(&entries, tMin);
+		const float entryLanes[] = { entries.x, entries.y, entries.z, entries.w };
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (!hitLanes[lane] || node.children[lane] == invalidIndex)
+			{
+				continue;
+			}
+
+			if (node.counts[lane] > 0)
+			{
+				for (auto i = node.children[lane]; i < node.children[lane] + node.counts[lane]; ++i)
+				{
+					const auto& primitive = tree.primitives[i];
+					const auto distance = RayBox(origin, inverseDirection, closestDistance, primitive.min, primitive.max);
+					if (distance >= 0.f && (distance < closestDistance || closest == entt::null))
+					{
+						closest = primitive.entity;
+						closestDistance = distance;
+					}
+				}
+			}
+
+			else
+			{
+				stack.emplace_back(node.children[lane], entryLanes[lane]);
+			}
+		}
+	}
+
+	if (hitDistance && closest != entt::null)
+	{
+		*hitDistance = closestDistance;
+	}
+
+	return closest;
+}
+
+void SceneBvh::Test()
+{
+	VGScopedCPUStat("Scene BVH Test");
+
+	constexpr size_t entityCount = 20'000;
+	constexpr int queryCount = 200;
+
+	Seed({ 1234 });
+
+	entt::registry registry;
+	auto& bvh = registry.set<SceneBvh>(registry);
+
+	const auto RandomPoint = [](float range)
+	{
+		return XMFLOAT3{ (float)Rand(-range, range), (float)Rand(-range, range), (float)Rand(-range, range) };
+	};
+
+	std::vector<entt::entity> entities;
+	for (size_t i = 0; i < entityCount; ++i)
+	{
+		const auto entity = registry.create();
+		const auto scale = (float)Rand(0.5, 2.0);
+		registry.emplace<TransformComponent>(entity, TransformComponent{
+			.scale = { scale, scale, scale },
+			.rotation = { 0.f, 0.f, 0.f },
+			.translation = RandomPoint(1000.f)
+		});
+
+		MeshComponent mesh;
+		mesh.subsets.emplace_back(PrimitiveOffset{}, 36, 0, MeshBounds::FromRadius((float)Rand(0.5, 8.0)));
+		registry.emplace<MeshComponent>(entity, std::move(mesh));
+
+		entities.emplace_back(entity);
+	}
+
+	TestReport report{ logRendering, VGText("Scene BVH") };
+
+	const auto Verify = [&](const char* stage)
+	{
+		std::vector<std::pair<entt::entity, std::pair<XMFLOAT3, XMFLOAT3>>> bounds;
+		registry.view<const TransformComponent, const MeshComponent>().each([&](auto entity, const auto& transform, const auto& mesh)
+		{
+			XMFLOAT3 min;
+			XMFLOAT3 max;
+			ComputeBounds(registry, entity, transform, mesh, min, max);
+			bounds.emplace_back(entity, std::pair{ min, max });
+		});
+
+		report.Check(bvh.GetPrimitiveCount() == bounds.size(), "{}: tracking {} primitives, expected {}", stage, bvh.GetPrimitiveCount(), bounds.size());
+
+		const auto Compare = [&](const char* query, std::vector<entt::entity>& actual, std::vector<entt::entity>& expected)
+		{
+			std::sort(actual.begin(), actual.end());
+			std::sort(expected.begin(), expected.end());
+			report.Check(actual == expected, "{}: {} query returned {} results, expected {}", stage, query, actual.size(), expected.size());
+		};
+
+		for (int i = 0; i < queryCount; ++i)
+		{
+			const auto eye = RandomPoint(1200.f);
+			const auto target = RandomPoint(500.f);
+			const auto view = XMMatrixLookAtRH(XMLoadFloat3(&eye), XMLoadFloat3(&target), XMVectorSet(0.f, 0.f, 1.f, 0.f));
+			const auto projection = XMMatrixPerspectiveFovRH((float)Rand(0.3, 1.5), 16.f / 9.f, 0.1f, (float)Rand(100.0, 3000.0));
+			const auto viewProjection = view * projection;
+
+			XMFLOAT4 planes[6];
+			ExtractFrustumPlanes(viewProjection, planes);
+
+			std::vector<entt::entity> actual;
+			std::vector<entt::entity> expected;
+			bvh.QueryFrustum(viewProjection, actual);
+			for (const auto& [entity, box] : bounds)
+			{
+				if (BoxInFrustum(planes, box.first, box.second))
+					expected.emplace_back(entity);
+			}
+
+			Compare("frustum", actual, expected);
+		}
+
+		for (int i = 0; i < queryCount; ++i)
+		{
+			const auto center = RandomPoint(1000.f);
+			const auto radius = (float)Rand(1.0, 200.0);
+
+			std::vector<entt::entity> actual;
+			std::vector<entt::entity> expected;
+			bvh.QuerySphere(center, radius, actual);
+			for (const auto& [entity, box] : bounds)
+			{
+				if (BoxInSphere(center, radius * radius, box.first, box.second))
+					expected.emplace_back(entity);
+			}
+
+			Compare("sphere", actual, expected);
+		}
+
+		for (int i = 0; i < queryCount; ++i)
+		{
+			const auto origin = RandomPoint(1200.f);
+			const auto target = RandomPoint(1000.f);
+			const XMFLOAT3 direction{ target.x - origin.x, target.y - origin.y, target.z - origin.z };
+			constexpr float maxDistance = 5000.f;
+
+			XMFLOAT3 normalized;
+			XMStoreFloat3(&normalized, XMVector3Normalize(XMLoadFloat3(&direction)));
+			const auto inverseDirection = InverseDirection(normalized);
+
+			auto expectedDistance = -1.f;
+			for (const auto& [entity, box] : bounds)
+			{
+				const auto distance = RayBox(origin, inverseDirection, maxDistance, box.first, box.second);
+				if (distance >= 0.f && (expectedDistance < 0.f || distance < expectedDistance))
+					expectedDistance = distance;
+			}
+
+			auto actualDistance = -1.f;
+			const auto hit = bvh.QueryRay(origin, direction, maxDistance, &actualDistance);
+
+			// Ties between overlapping bounds can resolve to either entity, so compare distances.
+			const auto matches = (hit == entt::null) == (expectedDistance < 0.f) && (hit == entt::null || std::abs(actualDistance - expectedDistance) <= 1e-3f);
+			report.Check(matches, "{}: ray query hit at {}, expected {}", stage, actualDistance, expectedDistance);
+		}
+	};
+
+	bvh.Update(registry);
+	Verify("build");
+
+	// Small moves are refit in place.
+	for (size_t i = 0; i < entities.size(); i += 10)
+	{
+		auto& transform = registry.get<TransformComponent>(entities[i]);
+		transform.translation.x += (float)Rand(-20.0, 20.0);
+	}
+
+	bvh.Update(registry);
+	Verify("refit");
+
+	report.Check(bvh.movedCount == (entities.size() + 9) / 10, "refit {} primitives, expected only the {} moved", bvh.movedCount, (entities.size() + 9) / 10);
+
+	// Scattering everything loosens the tree enough to rebuild in the background.
+	for (const auto entity : entities)
+	{
+		registry.get<TransformComponent>(entity).translation = RandomPoint(1000.f);
+	}
+
+	bvh.Update(registry);
+	Verify("scattered refit");
+
+	bvh.Flush();
+	bvh.Update(registry);
+	Verify("background rebuild");
+
+	report.Check(bvh.backgroundRebuilds > 0, "scattering the scene didn't trigger a background rebuild");
+
+	for (size_t i = 0; i < entities.size(); i += 7)
+	{
+		registry.destroy(entities[i]);
+	}
+
+	bvh.Update(registry);
+	Verify("structural change");
+
+	report.Log();
+}
+
+void SceneBvh::Benchmark()
+{
+	VGScopedCPUStat("Scene BVH Benchmark");
+
+	constexpr size_t entityCounts[] = { 100'000, 1'000'000 };
+	constexpr int queryCount = 1000;
+
+	const auto Time = [](auto&& function)
+	{
+		const auto begin = std::chrono::high_resolution_clock::now();
+		function();
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	};
+
+	Seed({ 5678 });
+
+	for (const auto entityCount : entityCounts)
+	{
+		entt::registry registry;
+		auto& bvh = registry.set<SceneBvh>(registry);
+
+		// Same density at every size.
+		const auto range = 10.0 * std::cbrt((double)entityCount);
+
+		std::vector<entt::entity> entities;
+		for (size_t i = 0; i < entityCount; ++i)
+		{
+			const auto entity = registry.create();
+			registry.emplace<TransformComponent>(entity, TransformComponent{
+				.scale = { 1.f, 1.f, 1.f },
+				.rotation = { 0.f, 0.f, 0.f },
+				.translation = { (float)Rand(-range, range), (float)Rand(-range, range), (float)Rand(-range, range) }
+			});
+
+			MeshComponent mesh;
+			mesh.subsets.emplace_back(PrimitiveOffset{}, 36, 0, MeshBounds::FromRadius((float)Rand(0.5, 4.0)));
+			registry.emplace<MeshComponent>(entity, std::move(mesh));
+
+			entities.emplace_back(entity);
+		}
+
+		const auto buildTime = Time([&]() { bvh.Update(registry); });
+
+		for (size_t i = 0; i < entities.size(); i += 100)
+		{
+			registry.get<TransformComponent>(entities[i]).translation.z += 1.f;
+		}
+
+		const auto refitTime = Time([&]() { bvh.Update(registry); });
+
+		std::vector<entt::entity> results;
+		size_t frustumResults = 0;
+		size_t sphereResults = 0;
+		size_t rayHits = 0;
+
+		const auto frustumTime = Time([&]()
+		{
+			for (int i = 0; i < queryCount; ++i)
+			{
+				const auto eye = XMVectorSet((float)Rand(-range, range), (float)Rand(-range, range), (float)Rand(-range, range), 0.f);
+				const auto target = XMVectorSet((float)Rand(-range, range), (float)Rand(-range, range), (float)Rand(-range, range), 0.f);
+				const auto view = XMMatrixLookAtRH(eye, target, XMVectorSet(0.f, 0.f, 1.f, 0.f));
+				const auto projection = XMMatrixPerspectiveFovRH(1.f, 16.f / 9.f, 0.1f, (float)range * 0.5f);
+
+				results.clear();
+				bvh.QueryFrustum(view * projection, results);
+				frustumResults += results.size();
+			}
+		});
+
+		const auto sphereTime = Time([&]()
+		{
+			for (int i = 0; i < queryCount; ++i)
+			{
+				results.clear();
+				bvh.QuerySphere({ (float)Rand(-range, range), (float)Rand(-range, range), (float)Rand(-range, range) }, 50.f, results);
+				sphereResults += results.size();
+			}
+		});
+
+		const auto rayTime = Time([&]()
+		{
+			for (int i = 0; i < queryCount; ++i)
+			{
+				const XMFLOAT3 origin{ (float)Rand(-range, range), (float)Rand(-range, range), (float)Rand(-range, range) };
+				const XMFLOAT3 direction{ (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0), (float)Rand(-1.0, 1.0) };
+				if (bvh.QueryRay(origin, direction, (float)range * 4.f) != entt::null)
+					++rayHits;
+			}
+		});
+
+		VGLog(logRendering, "Scene BVH benchmark: {} primitives, build {:.3f} ms, 1% refit {:.3f} ms ({} moved).",
+			bvh.GetPrimitiveCount(), buildTime, refitTime, bvh.movedCount);
+		VGLog(logRendering, "Scene BVH benchmark: {:.1f} frustum queries/ms ({} avg results), {:.1f} sphere queries/ms ({} avg results), {:.1f} ray queries/ms ({} hits).",
+			queryCount / frustumTime, frustumResults / queryCount, queryCount / sphereTime, sphereResults / queryCount, queryCount / rayTime, rayHits);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Utility/Math.h>
+
+#include <entt/entt.hpp>
+
+#include <vector>
+#include <future>
+#include <limits>
+#include <cstdint>
+
+// Dynamic 4-wide bounding volume hierarchy over the world bounds of every renderable. Moved entities are refit in place,
+// once refitting has loosened the tree enough a binned SAH rebuild runs in the background. Lives in the registry context.
+class SceneBvh
+{
+private:
+	static constexpr uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+	static constexpr uint32_t leafSize = 4;
+	static constexpr float rebuildThreshold = 1.5f;  // Refit cost relative to the built cost that triggers a rebuild.
+
+	struct Primitive
+	{
+		entt::entity entity;
+		XMFLOAT3 min;
+		XMFLOAT3 max;
+		XMFLOAT4X4 world;  // As of the last bounds update, moves are detected by comparing it.
+	};
+
+	// Bounds of the four children are stored as structure of arrays, so they can be tested at once.
+	struct alignas(16) Node
+	{
+		float minX[4];
+		float minY[4];
+		float minZ[4];
+		float maxX[4];
+		float maxY[4];
+		float maxZ[4];
+		uint32_t children[4];  // Node index of inner children, first primitive of leaf children, invalid if empty.
+		uint32_t counts[4];  // Primitive count of leaf children, 0 for inner children.
+	};
+
+	struct Tree
+	{
+		std::vector<Node> nodes;  // Parents always precede their children.
+		std::vector<uint32_t> parents;
+		std::vector<Primitive> primitives;  // Each leaf child owns a contiguous range.
+		std::vector<uint32_t> primitiveNodes;  // Node holding the leaf of each primitive.
+		float cost = 0.f;  // Sum of child surface areas, grows as refitting loosens the tree.
+	};
+
+	bool structureDirty = true;
+	Tree tree;
+	float builtCost = 0.f;
+	std::vector<uint8_t> movedPrimitives;
+	std::vector<uint8_t> dirtyNodes;
+
+	std::future<Tree> pendingBuild;
+	uint32_t generation = 0;  // Incremented on synchronous rebuilds, invalidating background builds started before.
+	uint32_t pendingGeneration = 0;
+
+	static void OnStructureChanged(entt::registry& registry, entt::entity entity);
+
+	static Tree Build(std::vector<Primitive> primitives);
+	static void Refit(Tree& tree, const std::vector<uint8_t>& dirty);
+	static void Gather(const entt::registry& registry, std::vector<Primitive>& primitives);
+
+	void Adopt(bool wait);
+
+public:
+	size_t movedCount = 0;  // Primitives refit during the last update.
+	size_t backgroundRebuilds = 0;
+
+	// Connects to the registry's signals, the BVH needs to outlive them.
+	SceneBvh(entt::registry& registry);
+
+	// Refits moved renderables, rebuilds synchronously if renderables were added or removed.
+	void Update(const entt::registry& registry);
+
+	// Blocks until a pending background rebuild completes, and adopts it.
+	void Flush();
+
+	// Appends every renderable whose bounds intersect the frustum of a row-vector view projection matrix.
+	void QueryFrustum(const XMMATRIX& viewProjection, std::vector<entt::entity>& results) const;
+	void QuerySphere(const XMFLOAT3& center, float radius, std::vector<entt::entity>& results) const;
+	// Closest renderable whose bounds are hit within maxDistance, or null.
+	entt::entity QueryRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float* hitDistance = nullptr) const;
+
+	size_t GetPrimitiveCount() const { return tree.primitives.size(); }
+
+	// Headless comparison of every query type against brute force, through refits, rebuilds and structural changes.
+	static void Test();
+	// CPU-only measurement of build, refit and query throughput over synthetic scenes, results are logged.
+	static void Benchmark();
+};
\ No newline at end of file
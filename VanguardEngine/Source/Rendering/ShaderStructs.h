@@ -49,6 +49,15 @@ struct Light
 	float padding;
 };
 
+struct LightNode
+{
+	XMFLOAT3 center;
+	float radius;
+	uint32_t firstLight;
+	uint32_t lightCount;
+	uint32_t padding[2];
+};
+
 static const uint32_t vertexChannelPosition = 0;
 static const uint32_t vertexChannelNormal = 1;
 static const uint32_t vertexChannelTexcoord = 2;
@@ -57,6 +66,13 @@ static const uint32_t vertexChannelBitangent = 4;
 static const uint32_t vertexChannelColor = 5;
 static const uint32_t vertexChannels = 6;
 
+// Encodings of vertex channels in the extras buffer, see VertexQuantization.
+static const uint32_t vertexFormatFloat = 0;  // 32 bit floats, as imported.
+static const uint32_t vertexFormatOctahedral = 1;  // Unit vector, octahedral snorm16x2.
+static const uint32_t vertexFormatOctahedralSign = 2;  // Unit vector and a sign, octahedral snorm16x2 with the sign in the lowest bit of y.
+static const uint32_t vertexFormatHalf = 3;  // 16 bit floats, two per channel.
+static const uint32_t vertexFormatUnorm8 = 4;  // RGBA unorm8.
+
 struct uint128_t
 {
 	uint32_t values[4];
@@ -69,7 +85,8 @@ struct uint128_t
 struct VertexMetadata
 {
 	uint32_t activeChannels;  // Bit mask of vertex attributes.
-	uint32_t padding[3];
+	uint32_t channelFormats;  // 4 bits per channel, vertex formats.
+	uint32_t padding[2];
 	uint128_t channelStrides[vertexChannels / 4 + 1];
 	uint128_t channelOffsets[vertexChannels / 4 + 1];
 };
@@ -104,14 +121,37 @@ struct ObjectData
 {
 	XMMATRIX worldMatrix;
 	VertexMetadata vertexMetadata;
+	XMFLOAT3 boundingSphereCenter;  // World space.
+	float boundingSphereRadius;  // World space.
 	uint32_t materialIndex;
-	float boundingSphereRadius;
-	XMFLOAT2 padding;
+	uint32_t meshletOffset;
+	uint32_t meshletCount;
+	uint32_t padding;
+};
+
+struct MeshletData
+{
+	XMFLOAT3 center;  // Object space bounding sphere.
+	float radius;
+	XMFLOAT3 coneApex;
+	float coneCutoff;
+	XMFLOAT3 coneAxis;
+	uint32_t indexOffset;  // Relative to the first index of the subset.
+	uint32_t indexCount;
+	XMFLOAT3 padding;
 };
 
 struct MeshIndirectArgument
 {
 	uint32_t batchId;
 	D3D12_DRAW_INDEXED_ARGUMENTS draw;
-	XMFLOAT2 padding;
+	float lodError;  // Only read by culling from the batch templates, object space error of the template's level.
+	float padding;
+};
+
+struct MeshCullView
+{
+	uint32_t cameraIndex;
+	uint32_t occlusion;
+	float lodScale;  // Zero draws every instance at full detail.
 };
\ No newline at end of file
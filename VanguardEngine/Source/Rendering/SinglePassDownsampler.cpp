@@ -0,0 +1,379 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/SinglePassDownsampler.h>
+#include <Rendering/Device.h>
+#include <Rendering/RenderGraph.h>
+#include <Rendering/CommandList.h>
+#include <Utility/TestReport.h>
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+namespace
+{
+	float Reduce(DownsampleReduction reduction, float a, float b, float c, float d, uint32_t level)
+	{
+		switch (reduction)
+		{
+		case DownsampleReduction::Minimum: return std::min(std::min(a, b), std::min(c, d));
+		case DownsampleReduction::Maximum: return std::max(std::max(a, b), std::max(c, d));
+		case DownsampleReduction::KarisAverage:
+			if (level == 1)
+			{
+				// Single channel, the value is its own luminance.
+				const float weightA = 1.f / (1.f + a);
+				const float weightB = 1.f / (1.f + b);
+				const float weightC = 1.f / (1.f + c);
+				const float weightD = 1.f / (1.f + d);
+
+				return (a * weightA + b * weightB + c * weightC + d * weightD) / (weightA + weightB + weightC + weightD);
+			}
+			[[fallthrough]];
+		default: return (a + b + c + d) * 0.25f;
+		}
+	}
+
+	// CPU emulation of SinglePassDownsample.hlsl on a single channel, threads of a group run one after another between the
+	// barriers. Texel writes are counted to check that the groups cover each level exactly once.
+	struct DownsampleEmulation
+	{
+		static constexpr uint32_t tileSize = SinglePassDownsampler::tileSize;
+		static constexpr uint32_t groupLevels = SinglePassDownsampler::groupLevels;
+
+		DownsampleReduction reduction;
+		bool resampleSource;
+		XMUINT2 size;
+		uint32_t levelCount;
+		const std::vector<float>* source;  // Same size as the first level, resampling is a copy.
+
+		std::vector<std::vector<float>> levels;
+		std::vector<std::vector<uint32_t>> writes;
+		uint32_t counter = 0;
+		uint32_t tails = 0;  // Groups that finished the chain.
+		bool readUnwritten = false;  // Loaded a texel of a base level before it was written.
+
+		void Reset()
+		{
+			levels.assign(levelCount, {});
+			writes.assign(levelCount, {});
+			for (uint32_t i = 0; i < levelCount; ++i)
+			{
+				const auto levelSize = LevelSize(i);
+				levels[i].assign(levelSize.x * levelSize.y, 0.f);
+				writes[i].assign(levelSize.x * levelSize.y, 0);
+			}
+
+			tails = 0;
+			readUnwritten = false;
+		}
+
+		XMUINT2 LevelSize(uint32_t level) const
+		{
+			return { std::max(size.x >> level, 1u), std::max(size.y >> level, 1u) };
+		}
+
+		void WriteLevel(uint32_t level, const XMUINT2& texel, float value)
+		{
+			const auto levelSize = LevelSize(level);
+			if (texel.x < levelSize.x && texel.y < levelSize.y)
+			{
+				levels[level][texel.x + texel.y * levelSize.x] = value;
+				++writes[level][texel.x + texel.y * levelSize.x];
+			}
+		}
+
+		float LoadBase(uint32_t baseLevel, const XMUINT2& texel)
+		{
+			const auto levelSize = LevelSize(baseLevel);
+			const XMUINT2 clampedTexel = { std::min(texel.x, levelSize.x - 1), std::min(texel.y, levelSize.y - 1) };
+			const auto index = clampedTexel.x + clampedTexel.y * levelSize.x;
+
+			if (baseLevel > 0)
+			{
+				readUnwritten |= writes[baseLevel][index] == 0;
+				return levels[baseLevel][index];
+			}
+
+			const auto value = (*source)[index];
+			if (resampleSource)
+			{
+				WriteLevel(0, texel, value);
+			}
+
+			return value;
+		}
+
+		XMUINT2 ClampToLevel(uint32_t level, const XMUINT2& tileOrigin, const XMUINT2& texel) const
+		{
+			const auto levelSize = LevelSize(level);
+			const XMUINT2 last = { levelSize.x - 1, levelSize.y - 1 };
+			return { std::min(texel.x, last.x - std::min(tileOrigin.x, last.x)), std::min(texel.y, last.y - std::min(tileOrigin.y, last.y)) };
+		}
+
+		void DownsampleTile(uint32_t baseLevel, const XMUINT2& tile)
+		{
+			const auto lastLevel = std::min(baseLevel + groupLevels, levelCount - 1);
+
+			std::array<std::array<float, 4>, 256> quads;
+			for (uint32_t threadIndex = 0; threadIndex < 256; ++threadIndex)
+			{
+				const XMUINT2 thread = { threadIndex % 16, threadIndex / 16 };
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					const XMUINT2 offset = { i % 2, i / 2 };
+					const XMUINT2 base = { tile.x * tileSize + thread.x * 4 + offset.x * 2, tile.y * tileSize + thread.y * 4 + offset.y * 2 };
+
+					const auto a = LoadBase(baseLevel, base);
+					const auto b = LoadBase(baseLevel, { base.x + 1, base.y });
+					const auto c = LoadBase(baseLevel, { base.x, base.y + 1 });
+					const auto d = LoadBase(baseLevel, { base.x + 1, base.y + 1 });
+
+					quads[threadIndex][i] = Reduce(reduction, a, b, c, d, baseLevel + 1);
+					WriteLevel(baseLevel + 1, { tile.x * (tileSize / 2) + thread.x * 2 + offset.x, tile.y * (tileSize / 2) + thread.y * 2 + offset.y }, quads[threadIndex][i]);
+				}
+			}
+
+			if (lastLevel < baseLevel + 2)
+			{
+				return;
+			}
+
+			std::array<float, 256> groupLevelA;
+			std::array<float, 64> groupLevelB;
+
+			for (uint32_t threadIndex = 0; threadIndex < 256; ++threadIndex)
+			{
+				const XMUINT2 thread = { threadIndex % 16, threadIndex / 16 };
+				const auto& quad = quads[threadIndex];
+				const auto quadClamp = ClampToLevel(baseLevel + 1, { tile.x * (tileSize / 2) + thread.x * 2, tile.y * (tileSize / 2) + thread.y * 2 }, { 1, 1 });
+				const auto value = Reduce(reduction, quad[0], quad[quadClamp.x], quad[2 * quadClamp.y], quad[quadClamp.x + 2 * quadClamp.y], baseLevel + 2);
+				WriteLevel(baseLevel + 2, { tile.x * (tileSize / 4) + thread.x, tile.y * (tileSize / 4) + thread.y }, value);
+				groupLevelA[threadIndex] = value;
+			}
+
+			uint32_t width = 16;
+			for (uint32_t level = baseLevel + 3; level <= lastLevel; ++level)
+			{
+				const auto levelWidth = width / 2;
+				const bool fromA = (level - baseLevel) % 2 == 1;
+				const float* input = fromA ? groupLevelA.data() : groupLevelB.data();
+				float* output = fromA ? groupLevelB.data() : groupLevelA.data();
+
+				for (uint32_t threadIndex = 0; threadIndex < levelWidth * levelWidth; ++threadIndex)
+				{
+					const XMUINT2 texel = { threadIndex % levelWidth, threadIndex / levelWidth };
+					const XMUINT2 child = { texel.x * 2, texel.y * 2 };
+					const auto clampChild = ClampToLevel(level - 1, { tile.x * width, tile.y * width }, { child.x + 1, child.y + 1 });
+
+					const auto reduced = Reduce(reduction, input[child.y * width + child.x], input[child.y * width + clampChild.x],
+						input[clampChild.y * width + child.x], input[clampChild.y * width + clampChild.x], level);
+					WriteLevel(level, { tile.x * levelWidth + texel.x, tile.y * levelWidth + texel.y }, reduced);
+					output[threadIndex] = reduced;
+				}
+
+				width = levelWidth;
+			}
+		}
+
+		void Group(const XMUINT2& groupId, uint32_t groupCount)
+		{
+			DownsampleTile(0, groupId);
+
+			if (levelCount <= groupLevels + 1)
+			{
+				return;
+			}
+
+			const auto previousCount = counter++;
+			if (previousCount != groupCount - 1)
+			{
+				return;
+			}
+
+			counter = 0;
+			++tails;
+			DownsampleTile(groupLevels, { 0, 0 });
+		}
+	};
+}
+
+SinglePassDownsampler::~SinglePassDownsampler()
+{
+	if (device)
+	{
+		device->GetResourceManager().Destroy(counterBuffer);
+	}
+}
+
+void SinglePassDownsampler::Initialize(RenderDevice* inDevice, DownsampleReduction reduction, bool resampleSource)
+{
+	device = inDevice;
+
+	layout = RenderPipelineLayout{}
+		.ComputeShader({ "Utils/SinglePassDownsample", "Main" })
+		.Macro({ "REDUCTION", static_cast<uint32_t>(reduction) })
+		.Macro({ "RESAMPLE_SOURCE", resampleSource ? 1 : 0 });
+
+	counterBuffer = device->GetResourceManager().Create(BufferDescription{
+		.updateRate = ResourceFrequency::Static,  // Unordered access.
+		.bindFlags = BindFlag::UnorderedAccess | BindFlag::ShaderResource,
+		.accessFlags = AccessFlag::CPUWrite,
+		.size = 1,
+		.stride = sizeof(uint32_t)
+	}, VGText("Single pass downsample counter"));
+
+	// Starts at zero, the last group of each dispatch resets it.
+	device->GetResourceManager().Write(counterBuffer, std::vector<uint32_t>{ 0 });
+}
+
+RenderResource SinglePassDownsampler::ImportCounter(RenderGraph& graph)
+{
+	return graph.Import(counterBuffer);
+}
+
+void SinglePassDownsampler::Downsample(CommandList& list, uint32_t sourceTexture, uint32_t counter, const XMUINT2& size, std::span<const uint32_t> levelTextures)
+{
+	VGAssert(levelTextures.size() >= 2 && levelTextures.size() <= std::min(maxLevels, ComputeLevels(size)), "Invalid downsample level count.");
+	VGAssert(std::max(size.x, size.y) <= tileSize << groupLevels, "Downsample source is too large for the last group to finish the chain.");
+
+	struct {
+		uint32_t sourceTexture;
+		uint32_t counterBuffer;
+		uint32_t groupCount;
+		uint32_t levelCount;
+		XMUINT2 size;
+		XMUINT2 groups;
+		uint32_t levelTextures[16];
+	} bindData{};
+
+	const auto groups = ComputeDispatch(size);
+
+	bindData.sourceTexture = sourceTexture;
+	bindData.counterBuffer = counter;
+	bindData.groupCount = groups.x * groups.y;
+	bindData.levelCount = static_cast<uint32_t>(levelTextures.size());
+	bindData.size = size;
+	bindData.groups = groups;
+	std::copy(levelTextures.begin(), levelTextures.end(), bindData.levelTextures);
+
+	list.BindPipeline(layout);
+	list.BindConstants("bindData", bindData);
+	list.Dispatch(groups.x, groups.y, 1);
+}
+
+XMUINT2 SinglePassDownsampler::ComputeDispatch(const XMUINT2& size)
+{
+	return { (size.x + tileSize - 1) / tileSize, (size.y + tileSize - 1) / tileSize };
+}
+
+uint32_t SinglePassDownsampler::ComputeLevels(const XMUINT2& size)
+{
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(size.x, size.y)))) + 1;
+}
+
+void SinglePassDownsampler::Test()
+{
+	VGScopedCPUStat("Single Pass Downsampler Test");
+
+	TestReport report{ logRendering, VGText("Single pass downsampler") };
+
+	constexpr DownsampleReduction reductions[] = { DownsampleReduction::Minimum, DownsampleReduction::Maximum, DownsampleReduction::Average, DownsampleReduction::KarisAverage };
+	// Single group, partial tiles, odd sizes, one texel wide levels, the largest source, and the hi-Z and bloom chains of 1080p.
+	constexpr XMUINT2 sizes[] = { { 2, 2 }, { 64, 64 }, { 65, 33 }, { 100, 7 }, { 1, 300 }, { 300, 2 }, { 4096, 64 }, { 1024, 512 }, { 960, 540 } };
+
+	std::mt19937 generator{ 5 };
+	std::uniform_real_distribution<float> distribution{ 0.f, 4.f };
+
+	for (const auto& size : sizes)
+	{
+		std::vector<float> source(size.x * size.y);
+		std::generate(source.begin(), source.end(), [&]() { return distribution(generator); });
+
+		const auto groups = ComputeDispatch(size);
+		std::vector<XMUINT2> groupIds;
+		for (uint32_t y = 0; y < groups.y; ++y)
+		{
+			for (uint32_t x = 0; x < groups.x; ++x)
+			{
+				groupIds.push_back({ x, y });
+			}
+		}
+
+		const auto fullLevels = ComputeLevels(size);
+		for (const auto levelCount : { 2u, std::min(groupLevels + 1, fullLevels), std::min(groupLevels + 2, fullLevels), fullLevels })
+		{
+			for (const auto reduction : reductions)
+			{
+				// Reducing each level separately, children past the edge of a level one texel wide are clamped.
+				std::vector<std::vector<float>> expected(levelCount);
+				expected[0] = source;
+				for (uint32_t level = 1; level < levelCount; ++level)
+				{
+					const XMUINT2 childSize = { std::max(size.x >> (level - 1), 1u), std::max(size.y >> (level - 1), 1u) };
+					const XMUINT2 levelSize = { std::max(size.x >> level, 1u), std::max(size.y >> level, 1u) };
+					expected[level].resize(levelSize.x * levelSize.y);
+
+					for (uint32_t y = 0; y < levelSize.y; ++y)
+					{
+						for (uint32_t x = 0; x < levelSize.x; ++x)
+						{
+							const auto x0 = 2 * x;
+							const auto y0 = 2 * y;
+							const auto x1 = std::min(x0 + 1, childSize.x - 1);
+							const auto y1 = std::min(y0 + 1, childSize.y - 1);
+							const auto& children = expected[level - 1];
+
+							expected[level][x + y * levelSize.x] = Reduce(reduction, children[x0 + y0 * childSize.x], children[x1 + y0 * childSize.x],
+								children[x0 + y1 * childSize.x], children[x1 + y1 * childSize.x], level);
+						}
+					}
+				}
+
+				for (const bool resampleSource : { false, true })
+				{
+					DownsampleEmulation emulation{ reduction, resampleSource, size, levelCount, &source };
+
+					// Groups finish in any order, and the counter must be reset for the next dispatch.
+					for (uint32_t dispatch = 0; dispatch < 2; ++dispatch)
+					{
+						emulation.Reset();
+						std::shuffle(groupIds.begin(), groupIds.end(), generator);
+						for (const auto& groupId : groupIds)
+						{
+							emulation.Group(groupId, static_cast<uint32_t>(groupIds.size()));
+						}
+
+						bool once = true;
+						bool matches = true;
+						for (uint32_t level = 0; level < levelCount; ++level)
+						{
+							const uint32_t expectedWrites = level > 0 || resampleSource ? 1 : 0;
+							once &= std::all_of(emulation.writes[level].begin(), emulation.writes[level].end(), [&](auto count) { return count == expectedWrites; });
+
+							if (level > 0)
+							{
+								for (size_t i = 0; i < expected[level].size(); ++i)
+								{
+									// Min and max are exact, averages only differ by the summation order of the compiler.
+									const auto tolerance = reduction == DownsampleReduction::Minimum || reduction == DownsampleReduction::Maximum ? 0.f : 1e-5f;
+									matches &= std::abs(emulation.levels[level][i] - expected[level][i]) <= tolerance;
+								}
+							}
+						}
+
+						report.Check(once, "{}x{}, {} levels: texels weren't written exactly once", size.x, size.y, levelCount);
+						report.Check(matches, "{}x{}, {} levels: levels don't match reducing each level separately", size.x, size.y, levelCount);
+						report.Check(!emulation.readUnwritten, "{}x{}, {} levels: base level texels were read before they were written", size.x, size.y, levelCount);
+						report.Check(emulation.counter == 0, "{}x{}, {} levels: counter wasn't reset", size.x, size.y, levelCount);
+						report.Check(emulation.tails == (levelCount > groupLevels + 1 ? 1 : 0), "{}x{}, {} levels: the chain wasn't finished by exactly one group", size.x, size.y, levelCount);
+					}
+				}
+			}
+		}
+	}
+
+	report.Log();
+}
\ No newline at end of file
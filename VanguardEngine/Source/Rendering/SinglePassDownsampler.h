@@ -0,0 +1,60 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ResourceHandle.h>
+#include <Rendering/RenderPipeline.h>
+#include <Rendering/RenderGraphResource.h>
+
+#include <span>
+#include <cstdint>
+
+class RenderDevice;
+class RenderGraph;
+class CommandList;
+
+// Must match REDUCTION in SinglePassDownsample.hlsl.
+enum class DownsampleReduction : uint32_t
+{
+	Minimum,
+	Maximum,
+	Average,
+	KarisAverage  // Luminance weighted average on the first generated level, to suppress fireflies, plain average after.
+};
+
+// Generates a mip chain in one dispatch, see Utils/SinglePassDownsample.hlsl. Each thread group reduces a tile of the first
+// level through the next groupLevels levels, and the last group to finish reduces the rest of the chain. Groups count their
+// completion in a persistent counter, which the last group resets for the next dispatch. Levels are floor(size / 2) like
+// regular mips, odd sizes drop their last row or column.
+class SinglePassDownsampler
+{
+public:
+	static constexpr uint32_t tileSize = 64;  // Texels of the first level reduced by each group.
+	static constexpr uint32_t groupLevels = 6;
+	static constexpr uint32_t maxLevels = 2 * groupLevels + 1;  // Including the first level, which is at most 4096 texels wide.
+
+private:
+	RenderDevice* device = nullptr;
+	RenderPipelineLayout layout;
+	BufferHandle counterBuffer;
+
+public:
+	~SinglePassDownsampler();
+	// Resampling reads the source with bilinear filtering at the first level's resolution and writes the first level, otherwise
+	// the source is the first level.
+	void Initialize(RenderDevice* inDevice, DownsampleReduction reduction, bool resampleSource);
+
+	// The counter must be written by the pass that downsamples, only chains longer than groupLevels + 1 levels access it.
+	RenderResource ImportCounter(RenderGraph& graph);
+	// Reduces the chain of levelTextures, the UAV of each level including the first. The pass must read the source and write
+	// every level.
+	void Downsample(CommandList& list, uint32_t sourceTexture, uint32_t counter, const XMUINT2& size, std::span<const uint32_t> levelTextures);
+
+	static XMUINT2 ComputeDispatch(const XMUINT2& size);
+	// Levels of a full chain, including the first.
+	static uint32_t ComputeLevels(const XMUINT2& size);
+
+	// Headless checks of the thread and group mapping of the shader, emulated on the CPU, against reducing each level separately.
+	static void Test();
+};
\ No newline at end of file
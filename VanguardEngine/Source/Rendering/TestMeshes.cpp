@@ -0,0 +1,97 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/TestMeshes.h>
+#include <Utility/Random.h>
+
+#include <utility>
+#include <cmath>
+
+namespace TestMeshes
+{
+	Mesh Sphere(uint32_t rings, uint32_t segments)
+	{
+		Mesh mesh;
+
+		for (uint32_t ring = 0; ring <= rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment <= segments; ++segment)
+			{
+				const auto theta = XM_PI * ring / rings;
+				const auto phi = XM_2PI * segment / segments;
+				mesh.positions.emplace_back(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+			}
+		}
+
+		const auto AddTriangle = [&mesh](uint32_t a, uint32_t b, uint32_t c)
+		{
+			const auto pointA = XMLoadFloat3(&mesh.positions[a]);
+			const auto pointB = XMLoadFloat3(&mesh.positions[b]);
+			const auto pointC = XMLoadFloat3(&mesh.positions[c]);
+			const auto normal = XMVector3Cross(pointB - pointA, pointC - pointA);
+
+			// Wind counter-clockwise when seen from outside.
+			if (XMVectorGetX(XMVector3Dot(normal, pointA + pointB + pointC)) < 0.f)
+			{
+				std::swap(b, c);
+			}
+
+			mesh.indices.insert(mesh.indices.end(), { a, b, c });
+		};
+
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			for (uint32_t segment = 0; segment < segments; ++segment)
+			{
+				const auto first = ring * (segments + 1) + segment;
+				const auto second = first + segments + 1;
+				AddTriangle(first, second, second + 1);
+				AddTriangle(first, second + 1, first + 1);
+			}
+		}
+
+		return mesh;
+	}
+
+	Mesh Terrain(uint32_t size, float amplitude)
+	{
+		Mesh mesh;
+
+		for (uint32_t y = 0; y <= size; ++y)
+		{
+			for (uint32_t x = 0; x <= size; ++x)
+			{
+				const auto height = std::sin(x * 0.3f) * std::cos(y * 0.2f) * amplitude + (float)Rand(0.0, 0.1) * amplitude;
+				mesh.positions.emplace_back((float)x, (float)y, height);
+			}
+		}
+
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				const auto first = y * (size + 1) + x;
+				const auto second = first + size + 1;
+				mesh.indices.insert(mesh.indices.end(), { first, first + 1, second + 1, first, second + 1, second });
+			}
+		}
+
+		return mesh;
+	}
+
+	Mesh Soup(size_t vertexCount, size_t triangleCount)
+	{
+		Mesh mesh;
+
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			mesh.positions.emplace_back((float)Rand(-10.0, 10.0), (float)Rand(-10.0, 10.0), (float)Rand(-10.0, 10.0));
+		}
+
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+		{
+			mesh.indices.emplace_back(static_cast<uint32_t>(Rand(0, static_cast<int>(vertexCount) - 1)));
+		}
+
+		return mesh;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <vector>
+#include <cstdint>
+
+// Procedural geometry for the headless geometry processing tests and benchmarks. Triangles are counter-clockwise seen
+// from the front, matching imported assets before their winding is reversed.
+namespace TestMeshes
+{
+	struct Mesh
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	// Unit sphere, facing outwards.
+	Mesh Sphere(uint32_t rings, uint32_t segments);
+	// Heightfield facing +Z with unit spacing, a flat grid when the amplitude is zero.
+	Mesh Terrain(uint32_t size, float amplitude);
+	// Random triangles between random vertices, without coherent normals or connectivity.
+	Mesh Soup(size_t vertexCount, size_t triangleCount);
+}
\ No newline at end of file
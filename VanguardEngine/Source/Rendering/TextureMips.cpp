@@ -0,0 +1,462 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/TextureMips.h>
+#include <Utility/TestReport.h>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <execution>
+#include <random>
+#include <cmath>
+
+namespace TextureMips
+{
+	namespace
+	{
+		constexpr float kaiserWidth = 3.f;  // Radius in texels of the destination level.
+		constexpr float kaiserAlpha = 4.f;
+
+		// Source texels contributing to each destination texel along one axis, edges are clamped.
+		struct Kernel
+		{
+			struct Taps
+			{
+				uint32_t first;
+				uint32_t count;
+			};
+
+			std::vector<Taps> taps;  // Per destination texel.
+			std::vector<uint32_t> sources;
+			std::vector<float> weights;  // Normalized per destination texel.
+		};
+
+		float BesselI0(float x)
+		{
+			float sum = 1.f;
+			float term = 1.f;
+			for (int i = 1; i < 32 && term > sum * 1e-8f; ++i)
+			{
+				const float factor = x / (2.f * i);
+				term *= factor * factor;
+				sum += term;
+			}
+
+			return sum;
+		}
+
+		float KaiserWeight(float x)
+		{
+			if (std::abs(x) >= kaiserWidth)
+			{
+				return 0.f;
+			}
+
+			const float sinc = x == 0.f ? 1.f : std::sin(XM_PI * x) / (XM_PI * x);
+			const float t = x / kaiserWidth;
+			return sinc * BesselI0(kaiserAlpha * std::sqrt(1.f - t * t)) / BesselI0(kaiserAlpha);
+		}
+
+		Kernel BuildKernel(uint32_t sourceSize, uint32_t destinationSize, Filter filter)
+		{
+			Kernel kernel;
+			kernel.taps.reserve(destinationSize);
+
+			const float scale = static_cast<float>(sourceSize) / destinationSize;  // Source texels per destination texel.
+			const float radius = filter == Filter::Box ? scale * 0.5f : kaiserWidth * scale;
+
+			for (uint32_t i = 0; i < destinationSize; ++i)
+			{
+				const float center = (i + 0.5f) * scale;
+				const auto first = static_cast<int32_t>(std::floor(center - radius));
+				const auto last = static_cast<int32_t>(std::ceil(center + radius));
+				const auto begin = static_cast<uint32_t>(kernel.weights.size());
+
+				float total = 0.f;
+				for (int32_t j = first; j < last; ++j)
+				{
+					float weight;
+					if (filter == Filter::Box)
+					{
+						// Coverage of the source texel by the footprint.
+						weight = std::max(std::min(j + 1.f, center + radius) - std::max(static_cast<float>(j), center - radius), 0.f);
+					}
+
+					else
+					{
+						weight = KaiserWeight((j + 0.5f - center) / scale);
+					}
+
+					if (weight != 0.f)
+					{
+						kernel.sources.emplace_back(static_cast<uint32_t>(std::clamp(j, 0, static_cast<int32_t>(sourceSize) - 1)));
+						kernel.weights.emplace_back(weight);
+						total += weight;
+					}
+				}
+
+				const auto count = static_cast<uint32_t>(kernel.weights.size()) - begin;
+				for (uint32_t j = 0; j < count; ++j)
+				{
+					kernel.weights[begin + j] /= total;
+				}
+
+				kernel.taps.push_back({ begin, count });
+			}
+
+			return kernel;
+		}
+
+		float SRGBToLinear(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float LinearToSRGB(float value)
+		{
+			return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+		}
+
+		uint8_t Quantize(float value)
+		{
+			return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+		}
+
+		template <typename Function>
+		void ForEachRow(uint32_t rows, Function&& function)
+		{
+			std::vector<uint32_t> indices(rows);
+			std::iota(indices.begin(), indices.end(), 0);
+			std::for_each(std::execution::par, indices.begin(), indices.end(), function);
+		}
+
+		void Decode(const uint8_t* source, uint32_t width, uint32_t height, Content content, std::vector<XMFLOAT4>& output)
+		{
+			std::array<float, 256> table;
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				table[i] = content == Content::SRGB ? SRGBToLinear(i / 255.f) : content == Content::Normal ? i / 127.5f - 1.f : i / 255.f;
+			}
+
+			output.resize(width * height);
+			ForEachRow(height, [&](uint32_t y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					const auto* texel = source + (x + y * width) * 4;
+					output[x + y * width] = { table[texel[0]], table[texel[1]], table[texel[2]], texel[3] / 255.f };
+				}
+			});
+		}
+
+		// Separable, the horizontal pass filters every source row, then the vertical pass accumulates whole rows at a time.
+		void FilterLevel(const std::vector<XMFLOAT4>& source, uint32_t width, uint32_t height, std::vector<XMFLOAT4>& output, uint32_t outputWidth,
+			uint32_t outputHeight, Filter filter)
+		{
+			const auto horizontal = BuildKernel(width, outputWidth, filter);
+			const auto vertical = BuildKernel(height, outputHeight, filter);
+
+			std::vector<XMFLOAT4> intermediate(outputWidth * height);
+			ForEachRow(height, [&](uint32_t y)
+			{
+				const auto* sourceRow = source.data() + y * width;
+				for (uint32_t x = 0; x < outputWidth; ++x)
+				{
+					const auto& taps = horizontal.taps[x];
+					XMVECTOR sum = XMVectorZero();
+					for (uint32_t i = taps.first; i < taps.first + taps.count; ++i)
+					{
+						sum = XMVectorMultiplyAdd(XMLoadFloat4(&sourceRow[horizontal.sources[i]]), XMVectorReplicate(horizontal.weights[i]), sum);
+					}
+
+					XMStoreFloat4(&intermediate[x + y * outputWidth], sum);
+				}
+			});
+
+			output.assign(outputWidth * outputHeight, { 0.f, 0.f, 0.f, 0.f });
+			ForEachRow(outputHeight, [&](uint32_t y)
+			{
+				auto* outputRow = output.data() + y * outputWidth;
+				const auto& taps = vertical.taps[y];
+				for (uint32_t i = taps.first; i < taps.first + taps.count; ++i)
+				{
+					const auto* intermediateRow = intermediate.data() + vertical.sources[i] * outputWidth;
+					const auto weight = XMVectorReplicate(vertical.weights[i]);
+					for (uint32_t x = 0; x < outputWidth; ++x)
+					{
+						XMStoreFloat4(&outputRow[x], XMVectorMultiplyAdd(XMLoadFloat4(&intermediateRow[x]), weight, XMLoadFloat4(&outputRow[x])));
+					}
+				}
+			});
+		}
+
+		// Renormalizes normals in place, so that the next level is filtered from unit vectors.
+		void Encode(std::vector<XMFLOAT4>& level, Content content, Image& output)
+		{
+			output.data.resize(output.width * output.height * 4);
+			ForEachRow(output.height, [&](uint32_t y)
+			{
+				for (uint32_t x = 0; x < output.width; ++x)
+				{
+					auto& value = level[x + y * output.width];
+					auto* texel = output.data.data() + (x + y * output.width) * 4;
+
+					if (content == Content::Normal)
+					{
+						auto normal = XMLoadFloat4(&value);
+						const auto lengthSquared = XMVectorGetX(XMVector3LengthSq(normal));
+						normal = lengthSquared > 1e-12f ? XMVectorScale(normal, 1.f / std::sqrt(lengthSquared)) : XMVectorSet(0.f, 0.f, 1.f, 0.f);
+						value = { XMVectorGetX(normal), XMVectorGetY(normal), XMVectorGetZ(normal), value.w };
+
+						texel[0] = Quantize(value.x * 0.5f + 0.5f);
+						texel[1] = Quantize(value.y * 0.5f + 0.5f);
+						texel[2] = Quantize(value.z * 0.5f + 0.5f);
+					}
+
+					else if (content == Content::SRGB)
+					{
+						texel[0] = Quantize(LinearToSRGB(std::max(value.x, 0.f)));
+						texel[1] = Quantize(LinearToSRGB(std::max(value.y, 0.f)));
+						texel[2] = Quantize(LinearToSRGB(std::max(value.z, 0.f)));
+					}
+
+					else
+					{
+						texel[0] = Quantize(value.x);
+						texel[1] = Quantize(value.y);
+						texel[2] = Quantize(value.z);
+					}
+
+					texel[3] = Quantize(value.w);
+				}
+			});
+		}
+	}
+
+	uint32_t ComputeLevels(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	}
+
+	std::vector<Image> Generate(const uint8_t* base, uint32_t width, uint32_t height, Content content, Filter filter)
+	{
+		VGScopedCPUStat("Generate Texture Mips");
+
+		std::vector<Image> levels;
+		levels.reserve(ComputeLevels(width, height) - 1);
+
+		std::vector<XMFLOAT4> current;
+		std::vector<XMFLOAT4> next;
+		Decode(base, width, height, content, current);
+
+		while (width > 1 || height > 1)
+		{
+			auto& level = levels.emplace_back();
+			level.width = std::max(width / 2, 1u);
+			level.height = std::max(height / 2, 1u);
+
+			FilterLevel(current, width, height, next, level.width, level.height, filter);
+			Encode(next, content, level);
+
+			std::swap(current, next);
+			width = level.width;
+			height = level.height;
+		}
+
+		return levels;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Texture Mips Test");
+
+		TestReport report{ logRendering, VGText("Texture mips") };
+
+		constexpr Filter filters[] = { Filter::Box, Filter::Kaiser };
+		constexpr Content contents[] = { Content::Linear, Content::SRGB, Content::Normal };
+
+		const auto CreateImage = [](uint32_t width, uint32_t height, auto&& function)
+		{
+			Image image{ width, height };
+			image.data.resize(width * height * 4);
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					const std::array<uint8_t, 4> texel = function(x, y);
+					std::copy(texel.begin(), texel.end(), image.data.begin() + (x + y * width) * 4);
+				}
+			}
+
+			return image;
+		};
+
+		const auto Texel = [](const Image& image, uint32_t x, uint32_t y, uint32_t channel)
+		{
+			return image.data[(x + y * image.width) * 4 + channel];
+		};
+
+		// Level sizes of odd, thin and power of 2 images, down to 1x1.
+		{
+			for (const auto [width, height] : { std::pair{ 37u, 8u }, std::pair{ 1u, 100u }, std::pair{ 64u, 64u }, std::pair{ 2u, 1u } })
+			{
+				const auto image = CreateImage(width, height, [](auto, auto) { return std::array<uint8_t, 4>{ 10, 20, 30, 40 }; });
+				const auto levels = Generate(image.data.data(), width, height, Content::Linear, Filter::Box);
+
+				bool sizes = levels.size() == ComputeLevels(width, height) - 1;
+				for (size_t i = 0; i < levels.size() && sizes; ++i)
+				{
+					sizes &= levels[i].width == std::max(width >> (i + 1), 1u) && levels[i].height == std::max(height >> (i + 1), 1u);
+					sizes &= levels[i].data.size() == levels[i].width * levels[i].height * 4;
+				}
+
+				report.Check(sizes, "sizes: levels don't halve down to 1x1");
+			}
+		}
+
+		// Constant images stay constant with every filter, including the negative lobes of the Kaiser filter.
+		{
+			const std::array<uint8_t, 4> color = { 200, 90, 17, 255 };
+			const std::array<uint8_t, 4> normal = { 128, 128, 255, 200 };  // Encoded (0, 0, 1).
+
+			for (const auto content : contents)
+			{
+				const auto& value = content == Content::Normal ? normal : color;
+				const auto image = CreateImage(45, 29, [&](auto, auto) { return value; });
+
+				for (const auto filter : filters)
+				{
+					bool constant = true;
+					for (const auto& level : Generate(image.data.data(), image.width, image.height, content, filter))
+					{
+						for (size_t i = 0; i < level.data.size(); ++i)
+						{
+							constant &= std::abs(level.data[i] - value[i % 4]) <= 1;
+						}
+					}
+
+					report.Check(constant, "constant: constant image changed");
+				}
+			}
+		}
+
+		// Box filtering of even sizes is the 2x2 average, like the GPU generated mips.
+		{
+			std::mt19937 generator{ 11 };
+			std::uniform_int_distribution<int> distribution{ 0, 255 };
+			const auto image = CreateImage(64, 32, [&](auto, auto)
+			{
+				return std::array<uint8_t, 4>{ (uint8_t)distribution(generator), (uint8_t)distribution(generator), (uint8_t)distribution(generator), (uint8_t)distribution(generator) };
+			});
+
+			const auto levels = Generate(image.data.data(), image.width, image.height, Content::Linear, Filter::Box);
+
+			bool matches = true;
+			for (uint32_t y = 0; y < levels[0].height; ++y)
+			{
+				for (uint32_t x = 0; x < levels[0].width; ++x)
+				{
+					for (uint32_t channel = 0; channel < 4; ++channel)
+					{
+						const auto sum = Texel(image, 2 * x, 2 * y, channel) + Texel(image, 2 * x + 1, 2 * y, channel) + Texel(image, 2 * x, 2 * y + 1, channel) + Texel(image, 2 * x + 1, 2 * y + 1, channel);
+						matches &= std::abs(Texel(levels[0], x, y, channel) - sum / 4.f) <= 0.5f + 1e-3f;
+					}
+				}
+			}
+
+			report.Check(matches, "box: first level isn't the 2x2 average");
+		}
+
+		// Smooth gradients are reproduced away from the clamped edges, and neither filter shifts the image.
+		{
+			const auto image = CreateImage(128, 4, [](auto x, auto) { return std::array<uint8_t, 4>{ (uint8_t)(x * 2), 0, 0, 255 }; });
+
+			for (const auto filter : filters)
+			{
+				const auto levels = Generate(image.data.data(), image.width, image.height, Content::Linear, filter);
+
+				bool matches = true;
+				for (uint32_t x = 4; x < levels[0].width - 4; ++x)
+				{
+					// Centered between source texels 2x and 2x + 1.
+					matches &= std::abs(Texel(levels[0], x, 0, 0) - (4.f * x + 1.f)) <= 1.f;
+				}
+
+				report.Check(matches, "{}: gradient isn't preserved", filter == Filter::Box ? "box gradient" : "Kaiser gradient");
+			}
+		}
+
+		// Color of sRGB textures is averaged in linear space, alpha isn't converted.
+		{
+			const auto image = CreateImage(16, 16, [](auto x, auto y) -> std::array<uint8_t, 4>
+			{
+				const uint8_t value = (x + y) % 2 == 0 ? 0 : 255;
+				return { value, value, value, value };
+			});
+
+			const auto levels = Generate(image.data.data(), image.width, image.height, Content::SRGB, Filter::Box);
+			const auto expectedColor = Quantize(LinearToSRGB(0.5f));  // 188, rather than 128 when averaged in sRGB space.
+			report.Check(Texel(levels[0], 3, 5, 0) == expectedColor && Texel(levels[0], 3, 5, 2) == expectedColor, "sRGB: color wasn't averaged in linear space");
+			report.Check(std::abs(Texel(levels[0], 3, 5, 3) - 127.5f) <= 0.5f, "sRGB: alpha wasn't averaged linearly");
+		}
+
+		// Normals are renormalized, opposing tilts average to straight up instead of shrinking.
+		{
+			const auto tilt = static_cast<uint8_t>(std::round((0.70710678f * 0.5f + 0.5f) * 255.f));
+			const auto image = CreateImage(32, 32, [&](auto x, auto y) -> std::array<uint8_t, 4>
+			{
+				return { (x + y) % 2 == 0 ? tilt : static_cast<uint8_t>(255 - tilt), 128, tilt, 255 };
+			});
+
+			for (const auto filter : filters)
+			{
+				const auto levels = Generate(image.data.data(), image.width, image.height, Content::Normal, filter);
+
+				bool unit = true;
+				bool straight = true;
+				for (const auto& level : levels)
+				{
+					for (uint32_t i = 0; i < level.width * level.height; ++i)
+					{
+						const float x = level.data[i * 4] / 127.5f - 1.f;
+						const float y = level.data[i * 4 + 1] / 127.5f - 1.f;
+						const float z = level.data[i * 4 + 2] / 127.5f - 1.f;
+						unit &= std::abs(std::sqrt(x * x + y * y + z * z) - 1.f) <= 0.02f;
+						straight &= level.data[i * 4 + 2] >= 254;
+					}
+				}
+
+				report.Check(unit, "normal: normals aren't unit length");
+				report.Check(straight, "normal: opposing normals didn't average to straight up");
+			}
+		}
+
+		// The Kaiser filter attenuates detail that the smaller levels can still represent less than the box filter.
+		{
+			const auto image = CreateImage(256, 4, [](auto x, auto) -> std::array<uint8_t, 4>
+			{
+				const auto value = static_cast<uint8_t>(std::round(128.f + 80.f * std::sin(2.f * XM_PI * x / 16.f)));  // Four texels per period in the second level.
+				return { value, value, value, 255 };
+			});
+
+			const auto Amplitude = [&](Filter filter)
+			{
+				const auto levels = Generate(image.data.data(), image.width, image.height, Content::Linear, filter);
+				const auto& level = levels[1];
+				uint8_t minimum = 255;
+				uint8_t maximum = 0;
+				for (uint32_t x = 8; x < level.width - 8; ++x)
+				{
+					minimum = std::min(minimum, Texel(level, x, 0, 0));
+					maximum = std::max(maximum, Texel(level, x, 0, 0));
+				}
+
+				return (maximum - minimum) / 2.f;
+			};
+
+			report.Check(Amplitude(Filter::Kaiser) > Amplitude(Filter::Box) + 2.f, "Kaiser: Kaiser filter isn't sharper than the box filter");
+		}
+
+		report.Log();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+
+#include <vector>
+#include <cstdint>
+
+// CPU mip chain generation for imported textures, so that loads upload complete chains instead of generating them on the GPU.
+// Levels are floor(size / 2) like D3D mips, each is filtered from the previous level with a separable kernel scaled to the
+// footprint of the level's texels, so odd sizes are weighted correctly instead of dropping texels. Filtering happens in float
+// and linear space, levels are only quantized on output.
+namespace TextureMips
+{
+	enum class Filter : uint32_t
+	{
+		Box,  // Averages the footprint, matches the GPU generated mips of even sizes.
+		Kaiser  // Kaiser windowed sinc, three texels of the level wide, keeps more detail in the smaller levels.
+	};
+
+	enum class Content : uint32_t
+	{
+		Linear,
+		SRGB,  // Color is filtered in linear space, alpha is always linear.
+		Normal  // Tangent space normals in RGB, renormalized in every level.
+	};
+
+	// Tightly packed R8G8B8A8 texels.
+	struct Image
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> data;
+	};
+
+	// Including the base level.
+	uint32_t ComputeLevels(uint32_t width, uint32_t height);
+	// Returns the levels below the base, down to 1x1. Rows of each level are filtered in parallel.
+	std::vector<Image> Generate(const uint8_t* base, uint32_t width, uint32_t height, Content content, Filter filter);
+
+	// Headless checks of the level sizes, filters, gamma correct filtering and normal renormalization, on synthetic images.
+	void Test();
+}
\ No newline at end of file
@@ -0,0 +1,363 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Rendering/VertexQuantization.h>
+#include <Rendering/MeshFactory.h>
+#include <Rendering/TestMeshes.h>
+#include <Utility/Random.h>
+#include <Utility/TestReport.h>
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace VertexQuantization
+{
+	namespace
+	{
+		uint32_t PackSnorm16(float value)
+		{
+			const auto quantized = static_cast<int32_t>(std::round(std::clamp(value, -1.f, 1.f) * 32767.f));
+			return static_cast<uint32_t>(quantized) & 0xFFFF;
+		}
+
+		float UnpackSnorm16(uint32_t value)
+		{
+			return std::max(static_cast<int16_t>(value & 0xFFFF) / 32767.f, -1.f);
+		}
+
+		float SignNotZero(float value)
+		{
+			return value >= 0.f ? 1.f : -1.f;
+		}
+
+		XMFLOAT3 Normalize(const XMFLOAT3& vector)
+		{
+			const auto length = std::sqrt(vector.x * vector.x + vector.y * vector.y + vector.z * vector.z);
+			return length > 0.f ? XMFLOAT3{ vector.x / length, vector.y / length, vector.z / length } : XMFLOAT3{ 0.f, 0.f, 1.f };
+		}
+
+		float Dot(const XMFLOAT3& left, const XMFLOAT3& right)
+		{
+			return left.x * right.x + left.y * right.y + left.z * right.z;
+		}
+
+		XMFLOAT3 Cross(const XMFLOAT3& left, const XMFLOAT3& right)
+		{
+			return { left.y * right.z - left.z * right.y, left.z * right.x - left.x * right.z, left.x * right.y - left.y * right.x };
+		}
+
+		// Angle between vectors, in degrees. Acos of the dot product can't resolve the small angles measured.
+		float AngleBetween(const XMFLOAT3& left, const XMFLOAT3& right)
+		{
+			const auto cross = Cross(left, right);
+			return std::atan2(std::sqrt(Dot(cross, cross)), Dot(left, right)) * 180.f / XM_PI;
+		}
+
+		XMFLOAT3 RandomUnitVector()
+		{
+			const auto z = static_cast<float>(Rand(-1.0, 1.0));
+			const auto phi = static_cast<float>(Rand(0.0, XM_2PI));
+			const auto radius = std::sqrt(std::max(1.f - z * z, 0.f));
+
+			return { radius * std::cos(phi), radius * std::sin(phi), z };
+		}
+	}
+
+	uint32_t EncodeOctahedral(const XMFLOAT3& vector)
+	{
+		// Project onto the octahedron, then fold the lower hemisphere over the upper one.
+		const auto l1 = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+		auto x = l1 > 0.f ? vector.x / l1 : 0.f;
+		auto y = l1 > 0.f ? vector.y / l1 : 0.f;
+		if (vector.z < 0.f)
+		{
+			const auto foldedX = (1.f - std::abs(y)) * SignNotZero(x);
+			const auto foldedY = (1.f - std::abs(x)) * SignNotZero(y);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		return PackSnorm16(x) | (PackSnorm16(y) << 16);
+	}
+
+	XMFLOAT3 DecodeOctahedral(uint32_t packed)
+	{
+		XMFLOAT3 result{ UnpackSnorm16(packed), UnpackSnorm16(packed >> 16), 0.f };
+		result.z = 1.f - std::abs(result.x) - std::abs(result.y);
+		const auto fold = std::clamp(-result.z, 0.f, 1.f);
+		result.x += result.x >= 0.f ? -fold : fold;
+		result.y += result.y >= 0.f ? -fold : fold;
+
+		return Normalize(result);
+	}
+
+	uint32_t EncodeTangent(const XMFLOAT4& tangent)
+	{
+		// Losing the lowest bit of y costs at most a step of the snorm.
+		const auto packed = EncodeOctahedral({ tangent.x, tangent.y, tangent.z }) & ~(1u << 16);
+		return packed | (tangent.w < 0.f ? 1u << 16 : 0u);
+	}
+
+	XMFLOAT4 DecodeTangent(uint32_t packed)
+	{
+		const auto vector = DecodeOctahedral(packed);
+		return { vector.x, vector.y, vector.z, packed & (1u << 16) ? -1.f : 1.f };
+	}
+
+	uint32_t EncodeHalf(const XMFLOAT2& value)
+	{
+		return DirectX::PackedVector::XMConvertFloatToHalf(value.x) | (DirectX::PackedVector::XMConvertFloatToHalf(value.y) << 16);
+	}
+
+	XMFLOAT2 DecodeHalf(uint32_t packed)
+	{
+		return {
+			DirectX::PackedVector::XMConvertHalfToFloat(static_cast<DirectX::PackedVector::HALF>(packed & 0xFFFF)),
+			DirectX::PackedVector::XMConvertHalfToFloat(static_cast<DirectX::PackedVector::HALF>(packed >> 16))
+		};
+	}
+
+	uint32_t EncodeUnorm8(const XMFLOAT4& color)
+	{
+		const auto Pack = [](float value)
+		{
+			return static_cast<uint32_t>(std::round(std::clamp(value, 0.f, 1.f) * 255.f));
+		};
+
+		return Pack(color.x) | (Pack(color.y) << 8) | (Pack(color.z) << 16) | (Pack(color.w) << 24);
+	}
+
+	XMFLOAT4 DecodeUnorm8(uint32_t packed)
+	{
+		return {
+			(packed & 0xFF) / 255.f,
+			((packed >> 8) & 0xFF) / 255.f,
+			((packed >> 16) & 0xFF) / 255.f,
+			(packed >> 24) / 255.f
+		};
+	}
+
+	uint32_t GetSize(uint32_t format, uint32_t floatSize)
+	{
+		return format == vertexFormatFloat ? floatSize : sizeof(uint32_t);
+	}
+
+	uint32_t Encode(uint32_t format, const float* value, uint32_t floatSize, uint8_t* output)
+	{
+		const auto components = floatSize / sizeof(float);
+		XMFLOAT4 vector{ 0.f, 0.f, 0.f, 1.f };
+		std::memcpy(&vector, value, std::min<size_t>(floatSize, sizeof(vector)));
+
+		uint32_t packed = 0;
+		switch (format)
+		{
+		case vertexFormatFloat: std::memcpy(output, value, floatSize); return floatSize;
+		case vertexFormatOctahedral: packed = EncodeOctahedral({ vector.x, vector.y, vector.z }); break;
+		case vertexFormatOctahedralSign: packed = EncodeTangent(components > 3 ? vector : XMFLOAT4{ vector.x, vector.y, vector.z, 1.f }); break;
+		case vertexFormatHalf: packed = EncodeHalf({ vector.x, vector.y }); break;
+		case vertexFormatUnorm8: packed = EncodeUnorm8(vector); break;
+		default: VGAssert(false, "Unknown vertex format."); break;
+		}
+
+		std::memcpy(output, &packed, sizeof(packed));
+
+		return sizeof(packed);
+	}
+
+	XMFLOAT4 Decode(uint32_t format, const uint8_t* data, uint32_t floatSize)
+	{
+		XMFLOAT4 result{ 0.f, 0.f, 0.f, 1.f };
+		uint32_t packed = 0;
+		if (format != vertexFormatFloat)
+		{
+			std::memcpy(&packed, data, sizeof(packed));
+		}
+
+		switch (format)
+		{
+		case vertexFormatFloat: std::memcpy(&result, data, std::min<size_t>(floatSize, sizeof(result))); break;
+		case vertexFormatOctahedral: { const auto vector = DecodeOctahedral(packed); result = { vector.x, vector.y, vector.z, 1.f }; break; }
+		case vertexFormatOctahedralSign: result = DecodeTangent(packed); break;
+		case vertexFormatHalf: { const auto value = DecodeHalf(packed); result = { value.x, value.y, 0.f, 1.f }; break; }
+		case vertexFormatUnorm8: result = DecodeUnorm8(packed); break;
+		default: VGAssert(false, "Unknown vertex format."); break;
+		}
+
+		return result;
+	}
+
+	void Test()
+	{
+		VGScopedCPUStat("Vertex Quantization Test");
+
+		Seed({ 1357 });
+
+		// Octahedral snorm16 is within 0.005 degrees, the tangent's sign bit doubles the step in y.
+		constexpr float maxNormalError = 0.01f;
+		constexpr float maxTangentError = 0.02f;
+		// Relative step of a half, with a floor for denormals near zero.
+		constexpr float maxHalfError = 1.f / 2048.f;
+		constexpr float minHalfError = 1e-7f;
+		constexpr float maxUnorm8Error = 0.5f / 255.f + 1e-6f;
+
+		TestReport report{ logRendering, VGText("Vertex quantization") };
+
+		// Axes, the folding seam and random directions.
+		std::vector<XMFLOAT3> directions = {
+			{ 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f },
+			Normalize({ 1.f, 1.f, 0.f }), Normalize({ -1.f, 1.f, 0.f }), Normalize({ 1.f, -1.f, -1e-4f }), Normalize({ -1.f, -1.f, -1.f })
+		};
+
+		for (int i = 0; i < 100000; ++i)
+		{
+			directions.emplace_back(RandomUnitVector());
+		}
+
+		float normalError = 0.f;
+		float tangentError = 0.f;
+		bool signsMatch = true;
+		for (size_t i = 0; i < directions.size(); ++i)
+		{
+			const auto& direction = directions[i];
+			normalError = std::max(normalError, AngleBetween(direction, DecodeOctahedral(EncodeOctahedral(direction))));
+
+			const auto sign = i % 2 == 0 ? 1.f : -1.f;
+			const auto tangent = DecodeTangent(EncodeTangent({ direction.x, direction.y, direction.z, sign }));
+			tangentError = std::max(tangentError, AngleBetween(direction, { tangent.x, tangent.y, tangent.z }));
+			signsMatch &= tangent.w == sign;
+		}
+
+		report.Check(normalError <= maxNormalError, "normal: octahedral round trip exceeded its error bound");
+		report.Check(tangentError <= maxTangentError, "tangent: octahedral round trip exceeded its error bound");
+		report.Check(signsMatch, "tangent: bitangent sign wasn't kept");
+
+		bool halfInBounds = true;
+		for (int i = 0; i < 100000; ++i)
+		{
+			const XMFLOAT2 texcoord{ static_cast<float>(Rand(-maxHalfTexcoord, maxHalfTexcoord)), static_cast<float>(Rand(-maxHalfTexcoord, maxHalfTexcoord)) };
+			const auto decoded = DecodeHalf(EncodeHalf(texcoord));
+			halfInBounds &= std::abs(decoded.x - texcoord.x) <= std::abs(texcoord.x) * maxHalfError + minHalfError;
+			halfInBounds &= std::abs(decoded.y - texcoord.y) <= std::abs(texcoord.y) * maxHalfError + minHalfError;
+		}
+
+		report.Check(halfInBounds, "texcoord: half round trip exceeded its error bound");
+
+		bool unorm8InBounds = true;
+		for (int i = 0; i < 100000; ++i)
+		{
+			const XMFLOAT4 color{ static_cast<float>(Rand(0.0, 1.0)), static_cast<float>(Rand(0.0, 1.0)), static_cast<float>(Rand(0.0, 1.0)), static_cast<float>(Rand(0.0, 1.0)) };
+			const auto decoded = DecodeUnorm8(EncodeUnorm8(color));
+			unorm8InBounds &= std::abs(decoded.x - color.x) <= maxUnorm8Error && std::abs(decoded.y - color.y) <= maxUnorm8Error;
+			unorm8InBounds &= std::abs(decoded.z - color.z) <= maxUnorm8Error && std::abs(decoded.w - color.w) <= maxUnorm8Error;
+		}
+
+		report.Check(unorm8InBounds, "color: unorm8 round trip exceeded its error bound");
+		report.Check(DecodeUnorm8(EncodeUnorm8({ -1.f, 2.f, 0.f, 1.f })).x == 0.f && DecodeUnorm8(EncodeUnorm8({ -1.f, 2.f, 0.f, 1.f })).y == 1.f, "color: unorm8 didn't clamp");
+
+		// Lay out a sphere with every extra channel, then decode it the way the vertex shaders do.
+		const auto sphere = TestMeshes::Sphere(32, 64);
+		const auto vertexCount = sphere.positions.size();
+
+		auto positions = sphere.positions;
+		auto indices = sphere.indices;
+		std::vector<XMFLOAT3> normals(vertexCount);
+		std::vector<XMFLOAT2> texcoords(vertexCount);
+		std::vector<XMFLOAT4> tangents(vertexCount);
+		std::vector<XMFLOAT3> bitangents(vertexCount);
+		std::vector<XMFLOAT4> colors(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			normals[i] = Normalize(positions[i]);
+			const auto tangent = Normalize(Cross(std::abs(normals[i].z) < 0.9f ? XMFLOAT3{ 0.f, 0.f, 1.f } : XMFLOAT3{ 1.f, 0.f, 0.f }, normals[i]));
+			const auto sign = i % 3 == 0 ? -1.f : 1.f;  // Mirrored texcoords.
+			tangents[i] = { tangent.x, tangent.y, tangent.z, 1.f };
+			const auto bitangent = Cross(normals[i], tangent);
+			bitangents[i] = { bitangent.x * sign, bitangent.y * sign, bitangent.z * sign };
+			texcoords[i] = { static_cast<float>(Rand(0.0, maxHalfTexcoord)), static_cast<float>(Rand(0.0, maxHalfTexcoord)) };
+			colors[i] = { static_cast<float>(Rand(0.0, 1.0)), static_cast<float>(Rand(0.0, 1.0)), static_cast<float>(Rand(0.0, 1.0)), 1.f };
+		}
+
+		std::vector<PrimitiveAssembly> assemblies(1);
+		assemblies[0].AddIndexStream(std::span{ indices });
+		assemblies[0].AddVertexStream("POSITION", std::span{ positions });
+		assemblies[0].AddVertexStream("NORMAL", std::span{ normals });
+		assemblies[0].AddVertexStream("TEXCOORD_0", std::span{ texcoords });
+		assemblies[0].AddVertexStream("TANGENT", std::span{ tangents });
+		assemblies[0].AddVertexStream("BITANGENT", std::span{ bitangents });
+		assemblies[0].AddVertexStream("COLOR_0", std::span{ colors });
+
+		const std::vector<uint32_t> materials = { 0 };
+		const std::vector<BoundingVolume> bounds(1);
+		const std::vector<std::vector<MeshletData>> meshlets(1);
+		const std::vector<std::vector<MeshLod>> lods(1);
+
+		const auto floatData = MeshFactory::BuildMeshData(assemblies, materials, bounds, meshlets, lods, false);
+		auto quantizedData = MeshFactory::BuildMeshData(assemblies, materials, bounds, meshlets, lods, true);
+		const auto& metadata = quantizedData.metadata;
+
+		const auto Load = [&](uint32_t channel, uint32_t floatSize, size_t vertex)
+		{
+			const auto format = (metadata.channelFormats >> (channel * 4)) & 0xF;
+			const auto stride = quantizedData.metadata.channelStrides[channel / 4][channel % 4];
+			const auto offset = quantizedData.metadata.channelOffsets[channel / 4][channel % 4];
+			return Decode(format, quantizedData.vertexExtraData.data() + vertex * stride + offset, floatSize);
+		};
+
+		report.Check(floatData.metadata.channelFormats == vertexFormatFloat, "mesh: float layout has quantized channels");
+		report.Check(!(metadata.activeChannels & (1 << vertexChannelBitangent)), "mesh: bitangent is stored rather than derived");
+		report.Check(quantizedData.vertexExtraData.size() == vertexCount * 4 * sizeof(uint32_t), "mesh: quantized vertex isn't 16 bytes");
+
+		float meshNormalError = 0.f;
+		float meshTangentError = 0.f;
+		float meshBitangentError = 0.f;
+		float meshTexcoordError = 0.f;
+		float meshColorError = 0.f;
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			const auto normal = Load(vertexChannelNormal, sizeof(XMFLOAT3), i);
+			const auto tangent = Load(vertexChannelTangent, sizeof(XMFLOAT4), i);
+			const auto texcoord = Load(vertexChannelTexcoord, sizeof(XMFLOAT2), i);
+			const auto color = Load(vertexChannelColor, sizeof(XMFLOAT4), i);
+			const XMFLOAT3 normal3{ normal.x, normal.y, normal.z };
+			const XMFLOAT3 tangent3{ tangent.x, tangent.y, tangent.z };
+
+			// Matches LoadVertexBitangent.
+			auto bitangent = Cross(normal3, tangent3);
+			bitangent = { bitangent.x * tangent.w, bitangent.y * tangent.w, bitangent.z * tangent.w };
+
+			meshNormalError = std::max(meshNormalError, AngleBetween(normals[i], normal3));
+			meshTangentError = std::max(meshTangentError, AngleBetween({ tangents[i].x, tangents[i].y, tangents[i].z }, tangent3));
+			meshBitangentError = std::max(meshBitangentError, AngleBetween(bitangents[i], Normalize(bitangent)));
+			meshTexcoordError = std::max({ meshTexcoordError, std::abs(texcoord.x - texcoords[i].x), std::abs(texcoord.y - texcoords[i].y) });
+			meshColorError = std::max({ meshColorError, std::abs(color.x - colors[i].x), std::abs(color.y - colors[i].y), std::abs(color.z - colors[i].z), std::abs(color.w - colors[i].w) });
+		}
+
+		report.Check(meshNormalError <= maxNormalError, "mesh: normals exceeded their error bound");
+		report.Check(meshTangentError <= maxTangentError, "mesh: tangents exceeded their error bound");
+		report.Check(meshBitangentError <= maxNormalError + maxTangentError, "mesh: derived bitangents don't match");
+		report.Check(meshTexcoordError <= maxHalfTexcoord * maxHalfError, "mesh: texcoords exceeded their error bound");
+		report.Check(meshColorError <= maxUnorm8Error, "mesh: colors exceeded their error bound");
+
+		const auto floatSize = floatData.vertexExtraData.size() / vertexCount;
+		const auto quantizedSize = quantizedData.vertexExtraData.size() / vertexCount;
+
+		// Tiled texcoords keep their precision as floats.
+		for (auto& texcoord : texcoords)
+		{
+			texcoord.x *= 4.f;
+		}
+
+		quantizedData = MeshFactory::BuildMeshData(assemblies, materials, bounds, meshlets, lods, true);
+		report.Check(((metadata.channelFormats >> (vertexChannelTexcoord * 4)) & 0xF) == vertexFormatFloat, "mesh: out of range texcoords were quantized");
+		report.Check(Load(vertexChannelTexcoord, sizeof(XMFLOAT2), 1).x == texcoords[1].x, "mesh: float texcoords changed");
+
+		VGLog(logRendering, "Vertex quantization max errors: normal {:.4f} deg, tangent {:.4f} deg, texcoord {:.6f}, color {:.5f}.", normalError, tangentError, meshTexcoordError, meshColorError);
+		VGLog(logRendering, "Vertex extras: {} bytes as floats, {} bytes quantized per vertex ({:.0f}% saved).", floatSize, quantizedSize,
+			100.f * (1.f - static_cast<float>(quantizedSize) / floatSize));
+
+		report.Log();
+	}
+}
\ No newline at end of file
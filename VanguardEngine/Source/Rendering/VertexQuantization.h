@@ -0,0 +1,40 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Rendering/Base.h>
+#include <Rendering/ShaderStructs.h>
+
+#include <cstdint>
+
+// Compact encodings of the vertex extras, picked per channel at import and decoded in VertexAssembly.hlsli. Normals and
+// tangents are octahedral unit vectors, the bitangent is derived from them with a sign stored in the tangent, texcoords are
+// half floats and colors are unorm8. Every quantized channel is 4 bytes, so loads stay aligned. Decoders are the CPU reference
+// of the shader's.
+namespace VertexQuantization
+{
+	// Texcoords further from zero than this stay floats, half floats have a step of at most 2^-9 within it.
+	constexpr float maxHalfTexcoord = 4.f;
+
+	uint32_t EncodeOctahedral(const XMFLOAT3& vector);
+	XMFLOAT3 DecodeOctahedral(uint32_t packed);
+	// The sign is w, negative if w is.
+	uint32_t EncodeTangent(const XMFLOAT4& tangent);
+	XMFLOAT4 DecodeTangent(uint32_t packed);
+	uint32_t EncodeHalf(const XMFLOAT2& value);
+	XMFLOAT2 DecodeHalf(uint32_t packed);
+	// Clamped to [0, 1].
+	uint32_t EncodeUnorm8(const XMFLOAT4& color);
+	XMFLOAT4 DecodeUnorm8(uint32_t packed);
+
+	// Bytes of a channel in the format, given its size as floats.
+	uint32_t GetSize(uint32_t format, uint32_t floatSize);
+	// Encodes a channel stored as floatSize bytes of floats, tangents without a w are positive. Returns the bytes written.
+	uint32_t Encode(uint32_t format, const float* value, uint32_t floatSize, uint8_t* output);
+	// Missing components are zero, except for w, which is one.
+	XMFLOAT4 Decode(uint32_t format, const uint8_t* data, uint32_t floatSize);
+
+	// Headless encode and decode round trips against their error bounds, and of a mesh laid out by the mesh factory.
+	// Logs the memory saved per vertex.
+	void Test();
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <utility>
+#include <cstdint>
+
+// Read only memory mapping of a whole file. Pages are read in by the OS on first access, nothing is copied when opening.
+class MappedFile
+{
+private:
+	void* file = nullptr;
+	void* mapping = nullptr;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept { Swap(other); }
+	~MappedFile() { Close(); }
+
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			Swap(other);
+		}
+
+		return *this;
+	}
+
+	// Closes the current mapping first. Fails if the file is missing or empty.
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	std::span<const uint8_t> GetData() const { return { data, size }; }
+
+private:
+	void Swap(MappedFile& other) noexcept
+	{
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+	}
+};
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <limits>
 #include <algorithm>
+#include <cmath>
 
 using namespace DirectX;
 
@@ -49,4 +50,96 @@ inline constexpr float RemapRange(float value, float inMin, float inMax, float o
 inline constexpr float RemapRangeClamped(float value, float inMin, float inMax, float outMin, float outMax)
 {
 	return std::clamp(RemapRange(value, inMin, inMax, outMin, outMax), outMin, outMax);
+}
+
+// Equivalent to scaling * XMMatrixRotationX(-x) * XMMatrixRotationY(-y) * XMMatrixRotationZ(-z) * translation, the engine's transform convention.
+inline XMMATRIX ComposeTransformMatrix(const XMFLOAT3& scale, const XMFLOAT3& rotation, const XMFLOAT3& translation)
+{
+	const auto scalingMat = XMMatrixScaling(scale.x, scale.y, scale.z);
+	const auto rotationMat = XMMatrixRotationX(-rotation.x) * XMMatrixRotationY(-rotation.y) * XMMatrixRotationZ(-rotation.z);
+	const auto translationMat = XMMatrixTranslation(translation.x, translation.y, translation.z);
+
+	return scalingMat * rotationMat * translationMat;
+}
+
+// Composes four transforms at once, same convention as ComposeTransformMatrix. Each row of the input matrices holds
+// the xyz of one transform. The work is done in structure of arrays form, with a single sin/cos evaluation per axis.
+inline void ComposeTransformMatricesX4(FXMMATRIX scales, CXMMATRIX rotations, CXMMATRIX translations, XMMATRIX* output)
+{
+	const auto scale = XMMatrixTranspose(scales);
+	const auto rotation = XMMatrixTranspose(rotations);
+	const auto translation = XMMatrixTranspose(translations);
+
+	XMVECTOR sinX, cosX, sinY, cosY, sinZ, cosZ;
+	XMVectorSinCos(&sinX, &cosX, XMVectorNegate(rotation.r[0]));
+	XMVectorSinCos(&sinY, &cosY, XMVectorNegate(rotation.r[1]));
+	XMVectorSinCos(&sinZ, &cosZ, XMVectorNegate(rotation.r[2]));
+
+	const auto sinXsinY = XMVectorMultiply(sinX, sinY);
+	const auto cosXsinY = XMVectorMultiply(cosX, sinY);
+
+	// Rows of the rotation matrix, one lane per transform. Each row is pre-multiplied by its axis scale.
+	XMMATRIX row0{
+		XMVectorMultiply(XMVectorMultiply(cosY, cosZ), scale.r[0]),
+		XMVectorMultiply(XMVectorMultiply(cosY, sinZ), scale.r[0]),
+		XMVectorMultiply(XMVectorNegate(sinY), scale.r[0]),
+		XMVectorZero()
+	};
+	XMMATRIX row1{
+		XMVectorMultiply(XMVectorNegativeMultiplySubtract(cosX, sinZ, XMVectorMultiply(sinXsinY, cosZ)), scale.r[1]),
+		XMVectorMultiply(XMVectorMultiplyAdd(sinXsinY, sinZ, XMVectorMultiply(cosX, cosZ)), scale.r[1]),
+		XMVectorMultiply(XMVectorMultiply(sinX, cosY), scale.r[1]),
+		XMVectorZero()
+	};
+	XMMATRIX row2{
+		XMVectorMultiply(XMVectorMultiplyAdd(cosXsinY, cosZ, XMVectorMultiply(sinX, sinZ)), scale.r[2]),
+		XMVectorMultiply(XMVectorNegativeMultiplySubtract(sinX, cosZ, XMVectorMultiply(cosXsinY, sinZ)), scale.r[2]),
+		XMVectorMultiply(XMVectorMultiply(cosX, cosY), scale.r[2]),
+		XMVectorZero()
+	};
+	XMMATRIX row3{
+		translation.r[0],
+		translation.r[1],
+		translation.r[2],
+		XMVectorSplatOne()
+	};
+
+	// Back to array of structures, lane i becomes row r of transform i.
+	row0 = XMMatrixTranspose(row0);
+	row1 = XMMatrixTranspose(row1);
+	row2 = XMMatrixTranspose(row2);
+	row3 = XMMatrixTranspose(row3);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		output[i].r[0] = row0.r[i];
+		output[i].r[1] = row1.r[i];
+		output[i].r[2] = row2.r[i];
+		output[i].r[3] = row3.r[i];
+	}
+}
+
+// Inverse of the rotation part of ComposeTransformMatrix, extracts engine Euler angles from a pure rotation matrix.
+inline XMFLOAT3 DecomposeRotationMatrix(FXMMATRIX rotation)
+{
+	XMFLOAT3X3 m;
+	XMStoreFloat3x3(&m, rotation);
+
+	const auto y = std::asin(std::clamp(-m._13, -1.f, 1.f));
+	float x = 0.f;
+	float z = 0.f;
+
+	// Gimbal lock, x and z rotate about the same axis so fold everything into z.
+	if (std::abs(std::cos(y)) > 1e-4f)
+	{
+		x = std::atan2(m._23, m._33);
+		z = std::atan2(m._12, m._11);
+	}
+
+	else
+	{
+		z = std::atan2(-m._21, m._22);
+	}
+
+	return { -x, -y, -z };
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#pragma once
+
+#include <Core/Logging.h>
+#include <Utility/StringTools.h>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+// Tallies the checks of a headless test. Failed checks are logged as they happen, Log reports the totals once the test is done.
+class TestReport
+{
+private:
+	const std::shared_ptr<spdlog::logger>& logger;
+	const wchar_t* name;
+	size_t checks = 0;
+	size_t failures = 0;
+
+public:
+	TestReport(const std::shared_ptr<spdlog::logger>& inLogger, const wchar_t* inName) : logger(inLogger), name(inName) {}
+
+	// The failure message is only formatted if the check failed. Returns whether it passed.
+	template <typename... Args>
+	bool Check(bool passed, fmt::format_string<Args...> format, Args&&... args)
+	{
+		++checks;
+		if (!passed)
+		{
+			++failures;
+			VGLogError(logger, "{} test: {}.", name, Str2WideStr(fmt::format(format, std::forward<Args>(args)...)));
+		}
+
+		return passed;
+	}
+
+	// Details are appended to the message of a passing test.
+	void Log(std::string_view details = {}) const
+	{
+		if (failures > 0)
+		{
+			VGLogError(logger, "{} test failed {} of {} checks.", name, failures, checks);
+		}
+
+		else
+		{
+			VGLog(logger, "{} test passed {} checks{}.", name, checks, Str2WideStr(std::string{ details }));
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,70 @@
+// Copyright (c) 2019-2022 Andrew Depke
+
+#include <Utility/MappedFile.h>
+
+#define NOMINMAX
+#include <Windows.h>
+
+#include <Core/Logging.h>  // spdlog leaks Windows.h, include it after.
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	VGScopedCPUStat("Map File");
+
+	Close();
+
+	const auto fileHandle = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		::CloseHandle(fileHandle);
+
+		return false;
+	}
+
+	const auto mappingHandle = ::CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+	{
+		VGLogWarning(logUtility, "Failed to create a mapping of '{}': {}.", path.generic_wstring(), GetPlatformError());
+		::CloseHandle(fileHandle);
+
+		return false;
+	}
+
+	const auto* view = ::MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		VGLogWarning(logUtility, "Failed to map a view of '{}': {}.", path.generic_wstring(), GetPlatformError());
+		::CloseHandle(mappingHandle);
+		::CloseHandle(fileHandle);
+
+		return false;
+	}
+
+	file = fileHandle;
+	mapping = mappingHandle;
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+	{
+		::UnmapViewOfFile(data);
+		::CloseHandle(mapping);
+		::CloseHandle(file);
+	}
+
+	file = nullptr;
+	mapping = nullptr;
+	data = nullptr;
+	size = 0;
+}
\ No newline at end of file